@@ -50,9 +50,7 @@ static const pdex_mon_t bulbasaur = {
   .charged_move_ids  = bulb_charged_move_ids,
   .charged_moves_cnt = 1,
   .form_idx          = 0,
-  .next_form         = NULL,
-  .hh_name           = 0,
-  .hh_dex_num        = 0
+  .next_form         = NULL
 };
 
 
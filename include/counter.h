@@ -0,0 +1,139 @@
+/* -*- mode: c; -*- */
+
+#ifndef _COUNTER_H
+#define _COUNTER_H
+
+/* ========================================================================= */
+
+#include "cupstore.h"
+#include "matchup.h"
+#include "moveset.h"
+#include "pokemon.h"
+#include "store.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Finding the best counters to an opposing team: the `k' species of a cup
+ * with the highest mean Battle Rating against every member of the team, in
+ * each shield scenario, each species with its best moveset.
+ * <p>
+ * Most candidates are hopeless on typing and stats alone, so before anything
+ * is simulated each moveset gets a cheap upper bound on its score
+ * ( see `counter_bound' ).
+ * Candidates are simulated in batches, highest bound first, and the search
+ * stops as soon as no remaining bound reaches the `k'th best score found so
+ * far; the result is exactly what simulating every candidate would give.
+ * <p>
+ * Species are ordered by score, then by their order in the cup's index, and
+ * a species' best moveset is the first of its highest scoring ones to be
+ * simulated.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * An upper bound on `matchup_battle( mon, opp, scenario )', from each side's
+ * damage against the other ( `get_pvp_damage', so stats, STAB and
+ * `DAMAGE_MODIFIERS' ), move durations, and energy.
+ * <p>
+ * After `T' turns `mon' has used at most `ceil( T / turns )' Fast Moves, and
+ * can have turned no more than their energy into Charged Move damage, at its
+ * best damage per energy; `opp's shields are ignored, since it can't shield
+ * while it waits out a Fast Move.
+ * Meanwhile `opp' never idles and only uses Charged Moves once it has the
+ * energy for them, which puts a floor under the Fast Moves it has landed,
+ * and so the Charged Moves that got past `mon's shields.
+ * The bound is the best rating these allow over every possible battle
+ * length.
+ * Like `simulate_battle', it assumes that neither side's stats are buffed.
+ */
+uint16_t counter_bound( const pvp_pokemon_t * mon,
+                        const pvp_pokemon_t * opp,
+                        uint8_t               scenario
+                      );
+
+
+/* ------------------------------------------------------------------------- */
+
+struct counter_opts_s {
+  stats_t           ivs;        /* Used by every candidate */
+  uint16_t          scenarios;  /* See `matchup_scenario_mask' */
+  bool              prune;      /* Skip dominated movesets, see `moveset.h' */
+  matchup_cache_t * cache;      /* `NULL' to simulate everything */
+  uint32_t          nthreads;   /* 0 for one per core */
+};
+typedef struct counter_opts_s  counter_opts_t;
+
+/* Dominance pruning is off: only bounds prune, and results are exact */
+#define COUNTER_OPTS_DEFAULT                                                  \
+  {                                                                           \
+    .ivs       = { .attack = 15, .stamina = 15, .defense = 15 },              \
+    .scenarios = MATCHUP_STANDARD_SCENARIOS_M,                                \
+    .prune     = false,                                                       \
+    .cache     = NULL,                                                        \
+    .nthreads  = 0                                                            \
+  }
+
+/* Candidates simulated at once, between checks of the `k'th best score */
+#define COUNTER_BATCH_SIZE  32
+
+
+struct counter_s {
+  uint16_t  dex_number;
+  uint8_t   form_idx;
+  uint8_t   level;    /* Highest whole level under the CP cap */
+  moveset_t moveset;
+  float     score;    /* Mean Battle Rating against the team, 0 - 1000 */
+};
+typedef struct counter_s  counter_t;
+
+struct counter_search_s {
+  uint32_t    ncounters;    /* `k', or every species if there are fewer */
+  counter_t * counters;     /* Best first */
+  uint32_t    nspecies;     /* Eligible species */
+  uint32_t    ncandidates;  /* Their movesets */
+  uint32_t    nsimulated;   /* Movesets that were battled */
+};
+typedef struct counter_search_s  counter_search_t;
+
+#define COUNTER_SEARCH_INIT                                                   \
+  { .ncounters = 0, .counters = NULL, .nspecies = 0, .ncandidates = 0,        \
+    .nsimulated = 0 }
+
+
+/**
+ * Find the `k' best counters in `cup->pool' to the `nteam' Pokemon of
+ * `team', in the league given by `cup->cp_cap'.
+ * Pokedex and Move data are read from the store the cup's index was built
+ * on; `opts' may be `NULL' for the defaults.
+ * Species that can't be brought under the CP cap, or that have no fast or
+ * charged moves, are left out.
+ * Returns `STORE_ERROR_NOT_FOUND' if no Pokemon are eligible, or
+ * `STORE_ERROR_BAD_VALUE' for an empty team, `k = 0', or no scenarios.
+ */
+int  counter_search( counter_search_t     * search,
+                     const cup_t          * cup,
+                     const pvp_pokemon_t  * team,
+                     uint32_t               nteam,
+                     uint32_t               k,
+                     const counter_opts_t * opts
+                   );
+
+void counter_search_free( counter_search_t * search );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* counter.h */
+
+/* vim: set filetype=c : */
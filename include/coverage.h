@@ -0,0 +1,132 @@
+/* -*- mode: c; -*- */
+
+#ifndef _COVERAGE_H
+#define _COVERAGE_H
+
+/* ========================================================================= */
+
+#include "matchup.h"
+#include "store.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Team building as a coverage problem: which 3 Pokemon jointly beat the
+ * largest weighted share of the meta.
+ * <p>
+ * Each row of a `matchup_matrix_t' becomes a bitset of the columns it beats,
+ * in every scenario, so a team's wins are the OR of its members' sets.
+ * Column weights are rounded to `COVERAGE_WEIGHT_BITS' bits and split into
+ * planes, one per bit, so that a set's weight is a handful of popcounts:
+ * the plane for bit `p' holds the columns whose weight has that bit set, and
+ * counts `2^p' each.
+ * Unweighted metas need just one plane.
+ * <p>
+ * Two searches are offered:
+ *   Greedy - Adds the member with the largest gain three times, then swaps
+ *            members for other rows while any swap covers more.
+ *   Exact  - Starts from the greedy team and branches over every team,
+ *            skipping those that can't beat the best found so far.
+ *            A member never adds more than it covers alone, and covers less
+ *            the more its teammates already cover, which bounds each branch.
+ * Both score candidates on every thread.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+#define COVERAGE_WEIGHT_BITS  8
+#define COVERAGE_WEIGHT_MAX   ( ( 1 << COVERAGE_WEIGHT_BITS ) - 1 )
+
+struct coverage_s {
+  uint32_t   nrows;
+  uint32_t   ncols;
+  uint8_t    nscenarios;
+  size_t     nwords;    /* Per row, each scenario starting on a new word */
+  uint64_t * wins;      /* `nrows' sets of `nwords' */
+  uint8_t    nplanes;
+  uint64_t * planes;    /* Interleaved, word `i' of plane `p' is at
+                         * `i * nplanes + p' */
+  uint64_t   total;     /* Weight of every column, in every scenario */
+};
+typedef struct coverage_s  coverage_t;
+
+#define COVERAGE_INIT                                                         \
+  { .nrows = 0, .ncols = 0, .nscenarios = 0, .nwords = 0, .wins = NULL,       \
+    .nplanes = 0, .planes = NULL, .total = 0 }
+
+/* Words of row `R's set */
+#define coverage_row( COV, R )                                                \
+  ( (const uint64_t *) ( ( COV )->wins + (size_t) ( R ) * ( COV )->nwords ) )
+
+
+/**
+ * Build win sets from `matrix': row `r' beats column `c' in a scenario if
+ * its rating is above `threshold', usually `MATCHUP_RATING_TIE'.
+ * `weights' has one entry per column, or is `NULL' to count each the same;
+ * negative weights count as 0, and all zero weights as even.
+ */
+int  coverage_init( coverage_t             * cov,
+                    const matchup_matrix_t * matrix,
+                    const float            * weights,
+                    uint16_t                 threshold
+                  );
+
+void coverage_free( coverage_t * cov );
+
+/* Weight of the columns any of `n' rows beat, `n' is 1 to 3. */
+uint64_t coverage_weight( const coverage_t * cov,
+                          const uint32_t   * rows,
+                          uint8_t            n
+                        );
+
+
+/* ------------------------------------------------------------------------- */
+
+typedef enum { COVERAGE_GREEDY, COVERAGE_EXACT } coverage_mode_t;
+
+struct coverage_opts_s {
+  coverage_mode_t mode;
+  uint32_t        max_swaps;  /* Local search after the greedy picks */
+  uint32_t        nthreads;   /* 0 for one per core */
+};
+typedef struct coverage_opts_s  coverage_opts_t;
+
+#define COVERAGE_OPTS_DEFAULT                                                 \
+  { .mode = COVERAGE_EXACT, .max_swaps = 64, .nthreads = 0 }
+
+struct coverage_team_s {
+  uint32_t members[3];  /* Rows, ascending */
+  uint64_t weight;      /* Of the columns they beat, see `coverage_weight' */
+  float    share;       /* `weight' over `total', 0 - 1 */
+  uint64_t nscored;     /* Teams and partial teams weighed */
+};
+typedef struct coverage_team_s  coverage_team_t;
+
+
+/**
+ * Find the team covering the most weight.
+ * Among teams of equal weight the exact search returns the one with the
+ * lowest rows, so results don't depend on the number of threads.
+ * `opts' may be `NULL' for the defaults.
+ * Fewer than 3 rows is `STORE_ERROR_BAD_VALUE'.
+ */
+int coverage_search( const coverage_t      * cov,
+                     const coverage_opts_t * opts,
+                     coverage_team_t       * team
+                   );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* coverage.h */
+
+/* vim: set filetype=c : */
@@ -6,21 +6,30 @@
 /* ========================================================================= */
 
 #include "store.h"
+#include "dense_index.h"
 #include "pokedex.h"
 #include "moves.h"
 #include "ptypes.h"
+#include "util/strmap.h"
 #include <stdlib.h>
 #include <stdint.h>
 
 
 /* ------------------------------------------------------------------------- */
 
+/**
+ * Every `cstore' shares the same index, see `cstore_init'.
+ * `mons' and `moves' are in the order of `dense', so a Pokemon or move is
+ * found by key with two array lookups.
+ */
 struct cstore_aux_s {
-  uint16_t        mons_cnt;
-  uint16_t        moves_cnt;
-  pdex_mon_t   *  mons_by_name;
-  store_move_t *  moves_by_id;
-  store_move_t *  moves_by_name;
+  uint16_t         mons_cnt;
+  uint16_t         moves_cnt;
+  dense_index_t    dense;
+  pdex_mon_t    ** mons;     /* By `mon_idx' */
+  store_move_t  ** moves;    /* By `move_idx' */
+  strmap_t         mons_by_name;   /* Base forms only */
+  strmap_t         moves_by_name;
 };
 typedef struct cstore_aux_s  cstore_aux_t;
 
@@ -33,6 +42,17 @@ typedef store_t cstore_t;
 
 bool cstore_has( store_t * cstore, store_key_t key );
 int  cstore_get( store_t * cstore, store_key_t key, void ** val );
+int  cstore_get_many( store_t           *  cstore,
+                      const store_key_t *  keys,
+                      size_t               n,
+                      void              ** vals,
+                      int               *  status
+                    );
+int  cstore_each( store_t       * cstore,
+                  store_type_t    val_type,
+                  store_each_cb   cb,
+                  void          * ctx
+                );
 int  cstore_get_str( store_t * cstore, const char *, void ** val );
 int  cstore_get_str_t( store_t      *  cstore,
                        store_type_t    val_type,
@@ -43,6 +63,14 @@ int  cstore_init( store_t * cstore, void * pokedex );
 void cstore_free( store_t * cstore );
 
 
+/* The shared `dense_index_t', which stays valid until the last `free'. */
+  static inline const dense_index_t *
+cstore_dense_index( cstore_t * cstore )
+{
+  return & as_csa( cstore )->dense;
+}
+
+
 /* ------------------------------------------------------------------------- */
 
 int cstore_get_pokemon( cstore_t   *  cstore,
@@ -98,10 +126,13 @@ cstore_set( store_t * cstore, store_key_t key, void * val )
 #define def_cstore()                                                        \
   {                                                                         \
     .name      = "Game Master Static",                                      \
-    .flags     = SF_OFFICIAL_DATA_M | SF_STANDARD_KEY_M | SF_TYPED_M |      \
-                 SF_GET_STRING_M | SF_GET_TYPED_STRING_M,                   \
+    .flags     = SF_THREAD_SAFE_M | SF_OFFICIAL_DATA_M |                    \
+                 SF_STANDARD_KEY_M | SF_TYPED_M | SF_GET_STRING_M |         \
+                 SF_GET_TYPED_STRING_M,                                     \
     .has       = cstore_has,                                                \
     .get       = cstore_get,                                                \
+    .get_many  = cstore_get_many,                                           \
+    .each      = cstore_each,                                               \
     .get_str   = cstore_get_str,                                            \
     .get_str_t = cstore_get_str_t,                                          \
     .add       = cstore_add,                                                \
@@ -122,6 +153,8 @@ static store_t CSTORE = def_cstore();
 #define CS_has( KEY )       cstore_has( & CSTORE, ( KEY ) )
 #define CS_get( KEY, VAL )                                                    \
   cstore_get( & CSTORE, ( KEY ), (void **) ( VAL ) )
+#define CS_get_many( KEYS, N, VALS, STATUS )                                  \
+  cstore_get_many( & CSTORE, ( KEYS ), ( N ), (void **) ( VALS ), ( STATUS ) )
 #define CS_get_str( KEY, VAL )                                                \
   cstore_get_str( & CSTORE, ( KEY ), (void **) ( VAL ) )
 #define CS_get_str_t( TYPE, KEY, VAL )                                        \
@@ -0,0 +1,115 @@
+/* -*- mode: c; -*- */
+
+#ifndef _CUP_H
+#define _CUP_H
+
+/* ========================================================================= */
+
+#include "filter_index.h"
+#include "store.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A small query language for cup/format eligibility, compiled to a flat
+ * program that runs over the bitsets of a `filter_index_t'.
+ * <p>
+ * Queries combine terms with `&' ( or `,', `and' ), `|' ( or `+', `or' ),
+ * `!' ( or `not', `no' ), and parentheses; `!' binds tightest and `|'
+ * loosest.
+ * Words are not case sensitive.
+ * <pre>
+ *   all                      Every Pokemon
+ *   tag:legendary            `PDEX_TAG_NAMES'
+ *   type:fairy               `PTYPE_NAMES'
+ *   region:kanto             `REGIONS'
+ *   family:bulbasaur         Family of a Pokemon, by name or Dex #
+ *   mon:medicham             Every form of a species, by name or Dex #
+ *   dex:1-251                A range of Dex #s, or a single one
+ *   move:counter             Learners of a move, by name or ID
+ *   fast:fighting            Pokemon with a fast move of a type
+ *   charged:fairy            Pokemon with a charged move of a type
+ * </pre>
+ * A bare word is tried as a region, type, and then tag, so the format
+ * "Kanto + Johto, no legendaries, no Fairy or Steel types" reads
+ * <pre>
+ *   ( kanto + johto ), no legendary, no mythic, no ( fairy | steel )
+ * </pre>
+ * <p>
+ * Programs are postfix: operands push a set and operators pop their
+ * arguments.
+ * They are evaluated one word at a time on a stack of words, so no
+ * intermediate sets are ever allocated.
+ * A program points into the index it was compiled against, and must be
+ * recompiled if that index is rebuilt.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Queries nested, or needing a stack, deeper than this are rejected */
+#define CUP_MAX_DEPTH  32
+
+typedef enum {
+  CUP_OP_SET,    /* Push `set' */
+  CUP_OP_RANGE,  /* Push dense indices `lo' to `hi - 1' */
+  CUP_OP_NOT,
+  CUP_OP_AND,
+  CUP_OP_OR
+} cup_opcode_t;
+
+struct cup_op_s {
+  cup_opcode_t op;
+  union {
+    const uint64_t * set;
+    struct { uint32_t lo, hi; };
+  };
+};
+typedef struct cup_op_s  cup_op_t;
+
+struct cup_program_s {
+  cup_op_t * ops;
+  uint32_t   nops;
+  uint32_t   cap;
+};
+typedef struct cup_program_s  cup_program_t;
+
+#define CUP_PROGRAM_INIT  { .ops = NULL, .nops = 0, .cap = 0 }
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Compile `query' against `idx', names are looked up in `idx->store'.
+ * Returns `STORE_ERROR_BAD_VALUE' for a malformed query or unknown names, and
+ * if `err_pos' is not `NULL' it is set to the offset of the offending word.
+ * On failure `prog' is left empty.
+ */
+int  cup_compile( const filter_index_t * idx,
+                  const char           * query,
+                  cup_program_t        * prog,
+                  size_t               * err_pos
+                );
+
+void cup_program_free( cup_program_t * prog );
+
+/* Write the set of matching Pokemon to `out', which holds `idx->nwords'. */
+void cup_program_eval( const filter_index_t * idx,
+                       const cup_program_t  * prog,
+                       uint64_t             * out
+                     );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* cup.h */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,193 @@
+/* -*- mode: c; -*- */
+
+#ifndef _CUPSTORE_H
+#define _CUPSTORE_H
+
+/* ========================================================================= */
+
+#include "cup.h"
+#include "filter_index.h"
+#include "store.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A "Cup" store holds PvP formats: a CP cap, and a query in the language of
+ * `cup.h' deciding which Pokemon are eligible.
+ * <p>
+ * Each cup's pool of eligible Pokemon is computed the first time the cup is
+ * fetched, and reused by every later `get' until the Pokedex store changes.
+ * Pools are cached against `store_version' of the Pokedex store, so editing
+ * an `overlay_store' beneath the cups rebuilds its `filter_index_t' and
+ * recomputes pools on the next `get'.
+ * That rebuild clears `index' and `pool' in every cup handed out before it,
+ * so fetch a cup again after changing the Pokedex.
+ * <p>
+ * Cups are keyed by insertion order with `cup_store_key', or found by name
+ * with `get_str'.
+ * `get' updates the cache, so this store is not `SF_THREAD_SAFE'; fetch the
+ * cups you need before sharing them with other threads.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+struct cup_s {
+  char                 * name;
+  char                 * query;
+  uint16_t               cp_cap;
+  /* Filled by the store on `get' */
+  const filter_index_t * index;      /* `pool' is over `index->nmons' */
+  const uint64_t       * pool;
+  uint32_t               pool_size;
+};
+typedef struct cup_s  cup_t;
+
+
+struct cup_entry_s {
+  cup_t           cup;
+  cup_program_t   program;
+  uint64_t      * pool;
+  bool            fresh;    /* `pool' is current */
+};
+typedef struct cup_entry_s  cup_entry_t;
+
+
+struct cupstore_aux_s {
+  store_t         * base;
+  filter_index_t    index;
+  bool              indexed;
+  uint32_t          index_version;   /* Of `base' */
+  cup_entry_t    ** cups;
+  uint32_t          cnt;
+  uint32_t          cap;
+};
+typedef struct cupstore_aux_s  cupstore_aux_t;
+
+#define as_cupsa( STORE_PTR )  ( (cupstore_aux_t *) ( STORE_PTR )->aux )
+
+typedef store_t  cupstore_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline store_key_t
+cup_store_key( uint32_t cup_idx )
+{
+  store_key_t key = {
+    .key_type = STORE_NUM,
+    .val_type = STORE_CUP,
+    .data_f   = cup_idx
+  };
+  return key;
+}
+
+
+/* Some common formats, see `cupstore_add_defaults'. */
+struct cup_def_s {
+  const char * name;
+  uint16_t     cp_cap;
+  const char * query;
+};
+
+static const struct cup_def_s CUP_DEFAULTS[] = {
+  { "GREAT_LEAGUE",  1500,  "all" },
+  { "ULTRA_LEAGUE",  2500,  "all" },
+  { "MASTER_LEAGUE", 10000, "all" },
+  { "KANTO_CUP",     1500,  "kanto, no mythic" },
+  { "JOHTO_CUP",     1500,  "johto, no legendary, no mythic" }
+};
+
+
+/* ------------------------------------------------------------------------- */
+
+bool cupstore_has( store_t * cupstore, store_key_t key );
+int  cupstore_get( store_t * cupstore, store_key_t key, void ** val );
+int  cupstore_get_str( store_t * cupstore, const char * name, void ** val );
+int  cupstore_get_str_t( store_t      *  cupstore,
+                         store_type_t    val_type,
+                         const char   *  name,
+                         void         ** val
+                       );
+int  cupstore_each( store_t       * cupstore,
+                    store_type_t    val_type,
+                    store_each_cb   cb,
+                    void          * ctx
+                  );
+/**
+ * `val' is a `cup_t' whose `name', `query', and `cp_cap' are copied.
+ * `add' takes the next key, `cup_store_key( count )', and fails on a
+ * duplicate name; malformed queries are `STORE_ERROR_BAD_VALUE'.
+ */
+int  cupstore_add( store_t * cupstore, store_key_t key, void * val );
+int  cupstore_set( store_t * cupstore, store_key_t key, void * val );
+/* `base' is the `store_t' providing Pokedex data */
+int  cupstore_init( store_t * cupstore, void * base );
+void cupstore_free( store_t * cupstore );
+
+
+/* ------------------------------------------------------------------------- */
+
+int cupstore_add_cup( cupstore_t * cupstore,
+                      const char * name,
+                      uint16_t     cp_cap,
+                      const char * query
+                    );
+
+/* Add every cup in `CUP_DEFAULTS'. */
+int cupstore_add_defaults( cupstore_t * cupstore );
+
+  static inline uint32_t
+cupstore_count( cupstore_t * cupstore )
+{
+  return as_cupsa( cupstore )->cnt;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline int
+cupstore_export( store_t      * cupstore,
+                 store_sink_t   sink_type,
+                 void         * target
+               )
+{
+  return STORE_ERROR_NOT_DEFINED;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+#define def_cupstore()                                                        \
+  {                                                                           \
+    .name      = "Cup",                                                       \
+    .flags     = SF_WRITABLE_M | SF_CUSTOM_DATA_M | SF_STANDARD_KEY_M |       \
+                 SF_TYPED_M | SF_GET_STRING_M | SF_GET_TYPED_STRING_M,        \
+    .has       = cupstore_has,                                                \
+    .get       = cupstore_get,                                                \
+    .get_many  = store_get_many_generic,                                      \
+    .each      = cupstore_each,                                               \
+    .get_str   = cupstore_get_str,                                            \
+    .get_str_t = cupstore_get_str_t,                                          \
+    .add       = cupstore_add,                                                \
+    .set       = cupstore_set,                                                \
+    .export    = cupstore_export,                                             \
+    .init      = cupstore_init,                                               \
+    .free      = cupstore_free,                                               \
+    .aux       = NULL                                                         \
+  }
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* cupstore.h */
+
+/* vim: set filetype=c : */
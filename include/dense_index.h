@@ -0,0 +1,152 @@
+/* -*- mode: c; -*- */
+
+#ifndef _DENSE_INDEX_H
+#define _DENSE_INDEX_H
+
+/* ========================================================================= */
+
+#include "moves.h"
+#include "pokedex.h"
+#include "store.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Dense, contiguous indices for every Pokemon ( and form ) and every move in
+ * a store, with array lookups in both directions.
+ * <p>
+ * `mon_idx' runs from 0 to `nmons - 1' in order of Dex # then form, so the
+ * forms of a species are always adjacent.
+ * `move_idx' runs from 0 to `nmoves - 1' in order of move ID.
+ * Tables over every species or every move ( damage tables, rankings, matchup
+ * matrices ) can then be plain arrays indexed by these, rather than hash maps
+ * keyed on `store_key_t'.
+ * <p>
+ * Any store that implements `each' can be indexed with `dense_index_init'.
+ * The index holds keys, not values, so it is only current for the
+ * `store_version' it was built from; `cstore' builds one from its static
+ * data that never goes stale, see `cstore_dense_index'.
+ * An initialized index is read only and may be shared between threads.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Marks move IDs that aren't in the store in `move_idx' */
+#define DENSE_IDX_NONE  UINT16_MAX
+
+struct dense_index_s {
+  uint32_t   nmons;
+  uint16_t   max_dex;
+  uint32_t * dex_start;     /* `max_dex + 2' entries, see `dense_mon_idx' */
+  uint16_t * dex;           /* `mon_idx' -> Dex # */
+  uint8_t  * form;          /* `mon_idx' -> form index */
+  uint16_t   nmoves;
+  uint16_t   max_move_id;
+  uint16_t * move_idx;      /* Move ID -> `move_idx', or `DENSE_IDX_NONE' */
+  uint16_t * move_id;       /* `move_idx' -> move ID */
+  uint32_t   version;       /* `store_version' of the indexed store */
+};
+typedef struct dense_index_s  dense_index_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Index every Pokemon and move in `store' using `store_each'. */
+int  dense_index_init( dense_index_t * idx, store_t * store );
+
+/**
+ * Index the given keys, for stores which already have them on hand.
+ * `mon_keys' are packed as `dex << 8 | form', and neither list needs to be
+ * sorted.
+ */
+int  dense_index_init_keys( dense_index_t  * idx,
+                            const uint32_t * mon_keys,
+                            uint32_t         nmons,
+                            const uint16_t * move_ids,
+                            uint16_t         nmoves
+                          );
+
+void dense_index_free( dense_index_t * idx );
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * The forms of Dex # `dex' occupy `mon_idx'
+ * `dex_start[dex]' to `dex_start[dex + 1] - 1', so finding a form is one
+ * subtraction; forms missing from the store are `STORE_ERROR_NOT_FOUND'.
+ */
+  static inline int
+dense_mon_idx( const dense_index_t * idx,
+               uint16_t              dex_num,
+               uint8_t               form_idx,
+               uint32_t            * mon_idx
+             )
+{
+  if ( idx->max_dex < dex_num ) return STORE_ERROR_NOT_FOUND;
+  uint32_t lo = idx->dex_start[dex_num];
+  uint32_t hi = idx->dex_start[dex_num + 1];
+  uint32_t i  = lo + form_idx;
+  /* Forms are numbered from 0 without gaps, unless a store skipped some */
+  if ( ( hi <= i ) || ( idx->form[i] != form_idx ) )
+    {
+      for ( i = lo; ( i < hi ) && ( idx->form[i] != form_idx ); i++ );
+      if ( i == hi ) return STORE_ERROR_NOT_FOUND;
+    }
+  if ( mon_idx != NULL ) *mon_idx = i;
+  return STORE_SUCCESS;
+}
+
+/* Number of forms of Dex # `dex' in the store, possibly 0. */
+  static inline uint32_t
+dense_forms_cnt( const dense_index_t * idx, uint16_t dex_num )
+{
+  if ( idx->max_dex < dex_num ) return 0;
+  return idx->dex_start[dex_num + 1] - idx->dex_start[dex_num];
+}
+
+  static inline store_key_t
+dense_mon_key( const dense_index_t * idx, uint32_t mon_idx )
+{
+  return dex_form_store_key( idx->dex[mon_idx], idx->form[mon_idx] );
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline int
+dense_move_idx( const dense_index_t * idx,
+                uint16_t              move_id,
+                uint16_t            * move_idx
+              )
+{
+  if ( ( idx->max_move_id < move_id ) ||
+       ( idx->move_idx[move_id] == DENSE_IDX_NONE ) )
+    {
+      return STORE_ERROR_NOT_FOUND;
+    }
+  if ( move_idx != NULL ) *move_idx = idx->move_idx[move_id];
+  return STORE_SUCCESS;
+}
+
+  static inline store_key_t
+dense_move_key( const dense_index_t * idx, uint16_t move_idx )
+{
+  return move_id_store_key( idx->move_id[move_idx] );
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* dense_index.h */
+
+/* vim: set filetype=c : */
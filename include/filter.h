@@ -26,6 +26,8 @@ pragma_ignore( "-Wpointer-to-int-cast" );
 
 /**
  * Filters/predicates to narrow rosters and gm_stores.
+ * To filter every Pokemon in a store at once, `filter_index.h' is much faster
+ * and accepts these predicates for anything it can't index.
  */
 typedef bool (*base_mon_pred_fn)( base_pokemon_t *, void * );
 typedef bool (*pdex_mon_pred_fn)( pdex_mon_t *, void * );
@@ -0,0 +1,227 @@
+/* -*- mode: c; -*- */
+
+#ifndef _FILTER_INDEX_H
+#define _FILTER_INDEX_H
+
+/* ========================================================================= */
+
+#include "dense_index.h"
+#include "pokedex.h"
+#include "ptypes.h"
+#include "store.h"
+#include "util/bitset.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Bitset indexed filters over every Pokemon ( and form ) in a store.
+ * <p>
+ * Bits are the `mon_idx' of a `dense_index_t', in order of Dex # then form,
+ * and one bitset over those indices is built for every tag, type, region,
+ * and family when the index is initialized.
+ * These double as inverted indices for questions like "which species learn
+ * Counter" or "every Steel type with a Fairy charged move": there is a set of
+ * learners for every move, and sets of Pokemon with a fast or charged move of
+ * each type.
+ * Members of a family are also kept as a list, see
+ * `filter_index_family_members'.
+ * A `pdex_filter_t' is then evaluated a word at a time with AND/OR/NOT,
+ * rather than calling predicates from `filter.h' for each Pokemon.
+ * <p>
+ * Anything the bitsets can't express may be given as a `pred', which is only
+ * called for Pokemon that passed the other criteria.
+ * Predicates made by `DEF_PDEX_MON_FILTER_*' ( `pdex_mon_*_pred' ) fit.
+ * <p>
+ * The index holds keys rather than `pdex_mon_t' pointers, and fetches
+ * Pokemon from the store when needed, so the store must outlive the index.
+ * An initialized index is read only and may be shared between threads.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+struct filter_index_s {
+  store_t       * store;
+  uint32_t        nmons;
+  size_t          nwords;          /* Words in each set */
+  dense_index_t   dense;
+  uint16_t        nfamilies;
+  uint16_t      * families;        /* Sorted */
+  uint32_t      * family_start;    /* `nfamilies + 1' offsets into... */
+  uint32_t      * family_members;  /* ...`mon_idx's grouped by family */
+  /* Sets, carved from `sets' */
+  uint64_t      * all;
+  uint64_t      * tags;            /* `NUM_PDEX_TAGS' sets */
+  uint64_t      * types;           /* `NUM_PTYPES' sets */
+  uint64_t      * fast_types;      /* `NUM_PTYPES' sets, by move type */
+  uint64_t      * charged_types;   /* `NUM_PTYPES' sets, by move type */
+  uint64_t      * regions;         /* `NUM_REGIONS' sets */
+  uint64_t      * family_sets;     /* `nfamilies' sets */
+  uint64_t      * learners;        /* `dense.nmoves' sets, by `move_idx' */
+  uint64_t      * sets;
+};
+typedef struct filter_index_s  filter_index_t;
+
+
+typedef bool ( * pdex_filter_pred_fn )( const pdex_mon_t *, void * );
+
+/**
+ * Criteria left as 0 ( or `NULL' ) match every Pokemon, the rest must all
+ * hold.
+ * `regions' is a mask of `region_e' values, as `1 << R_KANTO', etc.
+ * `learns' is a move ID, legacy moves count.
+ */
+struct pdex_filter_s {
+  pdex_tag_mask_t       tags_any;
+  pdex_tag_mask_t       tags_none;
+  ptype_mask_t          types_any;
+  ptype_mask_t          types_all;
+  ptype_mask_t          fast_types_any;
+  ptype_mask_t          charged_types_any;
+  uint8_t               regions;
+  uint16_t              family;
+  uint16_t              learns;
+  pdex_filter_pred_fn   pred;
+  void                * pred_arg;
+};
+typedef struct pdex_filter_s  pdex_filter_t;
+
+#define PDEX_FILTER_ANY                                                       \
+  {                                                                           \
+    .tags_any          = TAG_NONE_M,                                          \
+    .tags_none         = TAG_NONE_M,                                          \
+    .types_any         = PT_NONE_M,                                           \
+    .types_all         = PT_NONE_M,                                           \
+    .fast_types_any    = PT_NONE_M,                                           \
+    .charged_types_any = PT_NONE_M,                                           \
+    .regions           = 0,                                                   \
+    .family            = 0,                                                   \
+    .learns            = 0,                                                   \
+    .pred              = NULL,                                                \
+    .pred_arg          = NULL                                                 \
+  }
+
+
+/* ------------------------------------------------------------------------- */
+
+int  filter_index_init( filter_index_t * idx, store_t * store );
+void filter_index_free( filter_index_t * idx );
+
+/* Allocate a cleared set sized for `idx', release it with `free'. */
+  static inline uint64_t *
+filter_index_alloc_set( const filter_index_t * idx )
+{
+  return bitset_alloc( idx->nmons );
+}
+
+/**
+ * Find the dense index of a Pokemon.
+ * Returns `STORE_ERROR_NOT_FOUND' if it wasn't in the store.
+ */
+  static inline int
+filter_index_find( const filter_index_t * idx,
+                   uint16_t               dex_num,
+                   uint8_t                form_idx,
+                   uint32_t             * mon_idx
+                 )
+{
+  return dense_mon_idx( & idx->dense, dex_num, form_idx, mon_idx );
+}
+
+/* Fetch the Pokemon at a dense index from the store. */
+int filter_index_get( const filter_index_t  * idx,
+                      uint32_t                mon_idx,
+                      pdex_mon_t           ** mon
+                    );
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * The precomputed sets, for combining by hand with `bitset_*'.
+ * `filter_index_family_set' and `filter_index_learner_set' return `NULL' for
+ * unknown families and moves.
+ */
+  static inline const uint64_t *
+filter_index_tag_set( const filter_index_t * idx, pdex_tag_t tag )
+{
+  return idx->tags + ( tag * idx->nwords );
+}
+
+  static inline const uint64_t *
+filter_index_type_set( const filter_index_t * idx, ptype_t type )
+{
+  return idx->types + ( type * idx->nwords );
+}
+
+  static inline const uint64_t *
+filter_index_region_set( const filter_index_t * idx, region_e region )
+{
+  return idx->regions + ( region * idx->nwords );
+}
+
+/* Pokemon with a fast move of type `type' */
+  static inline const uint64_t *
+filter_index_fast_type_set( const filter_index_t * idx, ptype_t type )
+{
+  return idx->fast_types + ( type * idx->nwords );
+}
+
+/* Pokemon with a charged move of type `type' */
+  static inline const uint64_t *
+filter_index_charged_type_set( const filter_index_t * idx, ptype_t type )
+{
+  return idx->charged_types + ( type * idx->nwords );
+}
+
+const uint64_t * filter_index_family_set( const filter_index_t * idx,
+                                          uint16_t               family
+                                        );
+
+/* Pokemon which learn `move_id', as a fast or charged move. */
+const uint64_t * filter_index_learner_set( const filter_index_t * idx,
+                                           uint16_t               move_id
+                                         );
+
+/**
+ * Point `members' at the `mon_idx' of every member of `family', in order, and
+ * return how many there are ( 0 for unknown families ).
+ */
+uint32_t filter_index_family_members( const filter_index_t *  idx,
+                                      uint16_t                family,
+                                      const uint32_t       ** members
+                                    );
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Write the set of Pokemon matching `filter' to `out', which must hold
+ * `idx->nwords' words.
+ * Fails only if `filter->pred' is given and a Pokemon can't be fetched.
+ */
+int filter_index_eval( const filter_index_t * idx,
+                       const pdex_filter_t  * filter,
+                       uint64_t             * out
+                     );
+
+  static inline size_t
+filter_index_count( const filter_index_t * idx, const uint64_t * set )
+{
+  return bitset_count( set, idx->nwords );
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* filter_index.h */
+
+/* vim: set filetype=c : */
@@ -15,13 +15,13 @@
 
 /* ------------------------------------------------------------------------- */
 
+/**
+ * The tables are handed over by the parser and never modified afterwards, so
+ * lookups may run concurrently ( `SF_THREAD_SAFE' ).
+ * Lookups by Dex # or move ID are array reads, see `gm_tables_t'.
+ */
 struct gm_store_aux_s {
-  uint16_t       mons_cnt;
-  uint16_t       moves_cnt;
-  pdex_mon_t   * mons_by_name;
-  pdex_mon_t   * mons_by_dex;
-  store_move_t * moves_by_name;
-  store_move_t * moves_by_id;
+  gm_tables_t tables;
 };
 typedef struct gm_store_aux_s  gm_store_aux_t;
 
@@ -77,6 +77,17 @@ move_id_to_gmskey( uint16_t move_id )
 
 bool gm_store_has( store_t * gm_store, store_key_t key );
 int  gm_store_get( store_t * gm_store, store_key_t key, void ** val );
+int  gm_store_get_many( store_t           *  gm_store,
+                        const store_key_t *  keys,
+                        size_t               n,
+                        void              ** vals,
+                        int               *  status
+                      );
+int  gm_store_each( store_t       * gm_store,
+                    store_type_t    val_type,
+                    store_each_cb   cb,
+                    void          * ctx
+                  );
 int  gm_store_get_str( store_t * gm_store, const char *, void ** val );
 int  gm_store_get_str_t( store_t      *  gm_store,
                          store_type_t    val_type,
@@ -125,6 +136,8 @@ int gm_store_export( gm_store_t   * gm_store,
 int gm_store_export_json( gm_store_t * gm_store, FILE * ostream );
 int gm_store_export_c( gm_store_t * gm_store, FILE * ostream );
 int gm_store_export_sql( gm_store_t * gm_store, const char * db_name );
+/* See `snapstore.h' */
+int gm_store_export_snapshot( gm_store_t * gm_store, FILE * ostream );
 
 
 /* ------------------------------------------------------------------------- */
@@ -132,10 +145,13 @@ int gm_store_export_sql( gm_store_t * gm_store, const char * db_name );
 #define def_gm_store()                                                        \
   {                                                                           \
     .name      = "Game Master",                                               \
-    .flags     = SF_OFFICIAL_DATA_M | SF_STANDARD_KEY_M | SF_TYPED_M |        \
-                 SF_GET_STRING_M | SF_GET_TYPED_STRING_M | SF_EXPORTABLE_M,   \
+    .flags     = SF_THREAD_SAFE_M | SF_OFFICIAL_DATA_M | SF_STANDARD_KEY_M |  \
+                 SF_TYPED_M | SF_GET_STRING_M | SF_GET_TYPED_STRING_M |       \
+                 SF_EXPORTABLE_M,                                             \
     .has       = gm_store_has,                                                \
     .get       = gm_store_get,                                                \
+    .get_many  = gm_store_get_many,                                           \
+    .each      = gm_store_each,                                               \
     .get_str   = gm_store_get_str,                                            \
     .get_str_t = gm_store_get_str_t,                                          \
     .add       = gm_store_add,                                                \
@@ -156,6 +172,10 @@ static store_t GM_STORE = def_gm_store();
 #define GM_has( KEY )       gm_store_has( & GM_STORE, ( KEY ) )
 #define GM_get( KEY, VAL )                                                    \
   gm_store_get( & GM_STORE, ( KEY ), (void **) ( VAL ) )
+#define GM_get_many( KEYS, N, VALS, STATUS )                                  \
+  gm_store_get_many( & GM_STORE, ( KEYS ), ( N ), (void **) ( VALS ),         \
+                     ( STATUS )                                               \
+                   )
 #define GM_get_str( KEY, VAL )                                                \
   gm_store_get_str( & GM_STORE, ( KEY ), (void **) ( VAL ) )
 #define GM_get_str_t( TYPE, KEY, VAL )                                        \
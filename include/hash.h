@@ -1,26 +0,0 @@
-/* -*- mode: c; -*- */
-
-#ifndef _HASH_H
-#define _HASH_H
-
-/* ========================================================================= */
-
-#include "ext/uthash.h"
-
-
-/* ------------------------------------------------------------------------- */
-
-static const UT_hash_handle HH_NULL = {
-  NULL, NULL, NULL, NULL, NULL, NULL, 0, 0
-};
-
-
-/* ------------------------------------------------------------------------- */
-
-
-
-/* ========================================================================= */
-
-#endif /* hash.h */
-
-/* vim: set filetype=c : */
@@ -0,0 +1,178 @@
+/* -*- mode: c; -*- */
+
+#ifndef _LADDER_H
+#define _LADDER_H
+
+/* ========================================================================= */
+
+#include "player.h"
+#include "pokemon.h"
+#include "store.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A GO Battle League style ladder: a population of players, each bringing a
+ * team drawn from a meta, repeatedly paired off by rating to play 3v3
+ * battles.
+ * <p>
+ * Play goes in rounds.
+ * Each round every player's rating is jittered a little, players are sorted
+ * on that, and neighbours are paired, so opponents are close in rating but
+ * not always the same; with an odd population one player sits out.
+ * The round's battles are then simulated in parallel, and ratings, records,
+ * and per team statistics are updated once they are all done.
+ * All of the randomness comes from the ladder's own seed, and none of it is
+ * drawn by the workers, so a seed replays the same ladder on any number of
+ * threads.
+ * <p>
+ * The simulator is deterministic, so any two teams always play the same
+ * battle.  With few enough meta teams each result is kept once it has been
+ * simulated, and a long ladder only ever simulates each pairing once.
+ * <p>
+ * Ratings are either Elo, or Glicko with every round as a rating period:
+ * deviations grow by `glicko_c' each round, up to the initial deviation,
+ * and shrink with every battle.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Meta teams up to this many get their results kept, `nteams ^ 2' bytes */
+#define LADDER_CACHE_MAX_TEAMS  4096
+
+typedef enum { LADDER_ELO, LADDER_GLICKO } ladder_rating_t;
+
+struct ladder_opts_s {
+  ladder_rating_t   rating;
+  double            initial_rating;
+  double            elo_k;           /* Most an Elo rating moves per battle */
+  double            glicko_rd;       /* Initial, and largest, deviation */
+  double            glicko_c;        /* Deviation growth per round */
+  double            jitter;          /* Most a rating is moved to pair */
+  uint64_t          seed;
+  uint32_t          nthreads;        /* 0 for one per core */
+  uint32_t          report_every;    /* Rounds between stats, 0 for never */
+  FILE            * stats;           /* For `ladder_write_stats' */
+};
+typedef struct ladder_opts_s  ladder_opts_t;
+
+#define LADDER_OPTS_DEFAULT                                                   \
+  {                                                                           \
+    .rating         = LADDER_GLICKO,                                          \
+    .initial_rating = 1500.0,                                                 \
+    .elo_k          = 32.0,                                                   \
+    .glicko_rd      = 350.0,                                                  \
+    .glicko_c       = 15.0,                                                   \
+    .jitter         = 50.0,                                                   \
+    .seed           = 0,                                                      \
+    .nthreads       = 0,                                                      \
+    .report_every   = 0,                                                      \
+    .stats          = NULL                                                    \
+  }
+
+
+struct ladder_player_s {
+  player_t player;  /* Roster is the team, in order, lead first */
+  uint32_t team;    /* Meta team */
+  double   rating;
+  double   rd;      /* Glicko deviation */
+  uint32_t draws;
+};
+typedef struct ladder_player_s  ladder_player_t;
+
+struct ladder_team_stats_s {
+  uint32_t players;
+  uint64_t battles;
+  uint64_t wins;
+  uint64_t draws;
+};
+typedef struct ladder_team_stats_s  ladder_team_stats_t;
+
+/* A player's place in the round's pairing order */
+struct ladder_slot_s {
+  double   key;     /* Jittered rating */
+  uint32_t player;
+};
+typedef struct ladder_slot_s  ladder_slot_t;
+
+struct ladder_s {
+  ladder_opts_t         opts;
+  uint32_t              nteams;
+  pvp_pokemon_t       * teams;     /* 3 per meta team */
+  ladder_team_stats_t * stats;     /* Per meta team */
+  uint32_t              nplayers;
+  ladder_player_t     * players;
+  uint64_t              prng;
+  uint32_t              round;
+  uint64_t              nbattles;
+  uint64_t              nsimulated;
+  /* Per round */
+  ladder_slot_t       * slots;     /* Paired off in twos, P1 first */
+  uint8_t             * outcomes;  /* Per pair */
+  /* Per pairing of meta teams, with few enough of them */
+  _Atomic uint8_t     * results;
+};
+typedef struct ladder_s  ladder_t;
+
+#define LADDER_INIT                                                           \
+  {                                                                           \
+    .opts = LADDER_OPTS_DEFAULT, .nteams = 0, .teams = NULL, .stats = NULL,   \
+    .nplayers = 0, .players = NULL, .prng = 0, .round = 0, .nbattles = 0,     \
+    .nsimulated = 0, .slots = NULL, .outcomes = NULL, .results = NULL         \
+  }
+
+/* Wins over battles, with draws as half a win */
+#define ladder_team_win_rate( STATS )                                         \
+  ( ( ( STATS )->battles == 0 ) ? 0.0 :                                       \
+    ( ( STATS )->wins + 0.5 * ( STATS )->draws ) / ( STATS )->battles )
+
+
+/**
+ * Set up `nplayers' players, each with one of the `nteams' meta teams in
+ * `teams' ( 3 per team, lead first ), drawn with `weights' ( `NULL' for
+ * even ).
+ * `opts' may be `NULL' for the defaults.
+ * Returns `STORE_ERROR_BAD_VALUE' for fewer than 2 players, no teams, or
+ * weights with nothing positive.
+ */
+int  ladder_init( ladder_t            * ladder,
+                  roster_pokemon_t    * teams,
+                  uint32_t              nteams,
+                  const float         * weights,
+                  uint32_t              nplayers,
+                  store_t             * store,
+                  const ladder_opts_t * opts
+                );
+
+void ladder_free( ladder_t * ladder );
+
+/**
+ * Play `nrounds' rounds, writing stats to `opts.stats' every
+ * `opts.report_every' rounds.
+ */
+int  ladder_run( ladder_t * ladder, uint32_t nrounds );
+
+/**
+ * Write a CSV row per meta team: the round, team, players, battles, wins,
+ * draws, win rate, and the mean rating of its players.
+ * With `header' the column names are written first.
+ */
+int  ladder_write_stats( const ladder_t * ladder, FILE * ostream, bool header );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* ladder.h */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,177 @@
+/* -*- mode: c; -*- */
+
+#ifndef _MATCHUP_H
+#define _MATCHUP_H
+
+/* ========================================================================= */
+
+#include "matchup_cache.h"
+#include "pokemon.h"
+#include "store.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * 1v1 matchups, simulated in bulk.
+ * <p>
+ * A matchup is scored with PvPoke's "Battle Rating":
+ *   500 * ( Fraction of the opponent's HP dealt ) +
+ *   500 * ( Fraction of our own HP remaining )
+ * so 1000 is a flawless win, 0 a flawless loss, and anything over 500 a win.
+ * <p>
+ * Battles are run by `simulate_battle' with Naive AIs on both sides, so a
+ * matchup depends only on the two Pokemon and each side's shields.
+ * The shield counts form a "scenario", numbered `shields_p1 * 3 + shields_p2'
+ * so that sets of scenarios fit in a `uint16_t' mask.
+ */
+
+#define MATCHUP_NSCENARIOS  9
+
+#define matchup_scenario( S1, S2 )  ( (uint8_t) ( ( S1 ) * 3 + ( S2 ) ) )
+#define matchup_scenario_s1( SC )   ( (uint8_t) ( ( SC ) / 3 ) )
+#define matchup_scenario_s2( SC )   ( (uint8_t) ( ( SC ) % 3 ) )
+#define matchup_scenario_mask( SC ) ( (uint16_t) ( 1 << ( SC ) ) )
+
+/* The even shield scenarios PvPoke ranks on: 0v0, 1v1, and 2v2 */
+#define MATCHUP_STANDARD_SCENARIOS_M                                          \
+  ( matchup_scenario_mask( matchup_scenario( 0, 0 ) ) |                       \
+    matchup_scenario_mask( matchup_scenario( 1, 1 ) ) |                       \
+    matchup_scenario_mask( matchup_scenario( 2, 2 ) ) )
+#define MATCHUP_ALL_SCENARIOS_M  ( (uint16_t) 0x1ff )
+
+#define MATCHUP_RATING_MAX  1000
+#define MATCHUP_RATING_TIE  500
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Simulate `p1' against `p2' and return `p1's Battle Rating.
+ * Neither Pokemon is modified, their HP and energy are reset for the battle.
+ */
+uint16_t matchup_battle( const pvp_pokemon_t * p1,
+                         const pvp_pokemon_t * p2,
+                         uint8_t               scenario
+                       );
+
+
+/* ------------------------------------------------------------------------- */
+
+struct matchup_opts_s {
+  uint16_t          scenarios;  /* Mask of `matchup_scenario_mask's */
+  uint32_t          nthreads;   /* 0 for one per core */
+  matchup_cache_t * cache;      /* `NULL' to simulate everything */
+};
+typedef struct matchup_opts_s  matchup_opts_t;
+
+#define MATCHUP_OPTS_DEFAULT                                                  \
+  { .scenarios = MATCHUP_STANDARD_SCENARIOS_M, .nthreads = 0, .cache = NULL }
+
+
+/**
+ * Battle Ratings of every "row" Pokemon against every "column" Pokemon.
+ * <p>
+ * Ratings are stored row major, with all scenarios of a row side by side:
+ * `ratings[( row * nscenarios + s ) * ncols + col]', where `s' indexes
+ * `scenarios'.
+ * A row's results against the whole column list, in every scenario, are
+ * then one contiguous run of `nscenarios * ncols' ratings, which is the
+ * access pattern of team building and ranking.
+ * <p>
+ * A built matrix is read only and may be shared between threads.
+ */
+struct matchup_matrix_s {
+  uint32_t   nrows;
+  uint32_t   ncols;
+  uint8_t    nscenarios;
+  uint8_t    scenarios[MATCHUP_NSCENARIOS];  /* Ascending */
+  uint16_t * ratings;
+};
+typedef struct matchup_matrix_s  matchup_matrix_t;
+
+#define MATCHUP_MATRIX_INIT                                                   \
+  { .nrows = 0, .ncols = 0, .nscenarios = 0, .scenarios = { 0 },              \
+    .ratings = NULL }
+
+
+/**
+ * Simulate every row against every column in each scenario of `opts', using
+ * `opts->nthreads' threads; `opts' may be `NULL' for the defaults.
+ * With `opts->cache' matchups it holds are copied rather than simulated, and
+ * new ones are added to it, by the workers as they go.
+ * Returns `STORE_ERROR_BAD_VALUE' for an empty scenario mask, or
+ * `STORE_ERROR_NOMEM'.
+ */
+int  matchup_matrix_build( matchup_matrix_t     * matrix,
+                           const pvp_pokemon_t  * rows,
+                           uint32_t               nrows,
+                           const pvp_pokemon_t  * cols,
+                           uint32_t               ncols,
+                           const matchup_opts_t * opts
+                         );
+
+/**
+ * Replace `n' columns of a built matrix: column `col_idx[i]' is simulated
+ * again with `cols[i]' as the opponent, in the scenarios it was built with.
+ * Every other rating is kept, so swapping a few opponents costs only their
+ * battles.
+ * `rows' must be the rows the matrix was built from, `cache' may be `NULL'.
+ */
+int  matchup_matrix_update_cols( matchup_matrix_t    * matrix,
+                                 const pvp_pokemon_t * rows,
+                                 const uint32_t      * col_idx,
+                                 const pvp_pokemon_t * cols,
+                                 uint32_t              n,
+                                 uint32_t              nthreads,
+                                 matchup_cache_t     * cache
+                               );
+
+void matchup_matrix_free( matchup_matrix_t * matrix );
+
+/* Index of `scenario' in `matrix->scenarios', or -1 if it wasn't built. */
+int  matchup_matrix_scenario_idx( const matchup_matrix_t * matrix,
+                                  uint8_t                  scenario
+                                );
+
+
+  static inline size_t
+matchup_matrix_row_len( const matchup_matrix_t * matrix )
+{
+  return (size_t) matrix->nscenarios * matrix->ncols;
+}
+
+/* Row `row' against every column in scenario index `s'. */
+  static inline const uint16_t *
+matchup_matrix_row( const matchup_matrix_t * matrix,
+                    uint32_t                 row,
+                    uint8_t                  s
+                  )
+{
+  return matrix->ratings +
+         ( (size_t) row * matrix->nscenarios + s ) * matrix->ncols;
+}
+
+  static inline uint16_t
+matchup_matrix_get( const matchup_matrix_t * matrix,
+                    uint32_t                 row,
+                    uint8_t                  s,
+                    uint32_t                 col
+                  )
+{
+  return matchup_matrix_row( matrix, row, s )[col];
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* matchup.h */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,255 @@
+/* -*- mode: c; -*- */
+
+#ifndef _MATCHUP_CACHE_H
+#define _MATCHUP_CACHE_H
+
+/* ========================================================================= */
+
+#include "pokemon.h"
+#include "store.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Battle Ratings addressed by the content of the matchup: both Pokemon's
+ * stats, level, types and moves, the shields each side has, and the AI.
+ * <p>
+ * The same matchup comes up again and again, between ranking runs, team
+ * builder runs, and different leagues with overlapping pools, and costume
+ * forms battle exactly like their base form.
+ * A cache passed to `matchup_matrix_build' ( see `matchup_opts_t' ) skips
+ * every battle it has already seen.
+ * <p>
+ * A matchup is identified by a 128 bit hash of its key rather than the key
+ * itself, so a slot is two 64 bit words: the first half of the hash, then
+ * the rest of the hash beside the rating.
+ * Slots are claimed with a compare and swap on the first word and published
+ * by storing the second, so any number of threads may look up and insert at
+ * once without locks; a slot being written reads as a miss.
+ * Ratings never change for a key, so inserting a key twice keeps the first.
+ * <p>
+ * The table doesn't grow while it is shared: `matchup_cache_reserve' resizes
+ * it between builds ( builds reserve room for every cell first ), and
+ * inserts into a table that is 3/4 full are dropped and counted.
+ * <p>
+ * A second, persistent tier is a file written by `matchup_cache_save' and
+ * `mmap'ed read only by `matchup_cache_load', checked after the in-process
+ * table on every lookup.
+ * Files carry a "data version" ( for example the timestamp of the Game
+ * Master the Pokedex was parsed from ) and only load into a cache with the
+ * same version, so stale ratings are never read after a balance change.
+ * Like snapshots ( see `snapstore.h' ) a file is replaced by renaming, and
+ * processes mapping the old one keep reading it undisturbed.
+ */
+
+/* Battles are all run with `naive_ai', but the AI is part of the key */
+#define MATCHUP_AI_NAIVE  0
+
+#define MATCHUP_CACHE_MAGIC       "CPKMCHC"
+#define MATCHUP_CACHE_VERSION     1
+#define MATCHUP_CACHE_BYTE_ORDER  0x01020304
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * The parts of a `pvp_pokemon_t' that decide its battles: stats, level,
+ * types, and moves.
+ * Two Pokemon with equal keys always battle the same way, whatever their
+ * species, so results can be reused between them.
+ * Every byte is a named field, keys may be hashed and compared as memory.
+ */
+struct matchup_mon_key_s {
+  stats_t  stats;
+  uint8_t  level;
+  uint8_t  reserved0;    /* Always 0 */
+  uint32_t types;
+  uint16_t move_ids[3];  /* Fast, then Charged */
+  uint16_t reserved1;    /* Always 0 */
+};
+typedef struct matchup_mon_key_s  matchup_mon_key_t;
+
+  static inline matchup_mon_key_t
+matchup_mon_key( const pvp_pokemon_t * mon )
+{
+  return (matchup_mon_key_t) {
+    .stats     = mon->stats,
+    .level     = mon->level,
+    .reserved0 = 0,
+    .types     = (uint32_t) mon->types,
+    .move_ids  = { mon->fast_move.move_id,
+                   mon->charged_moves[0].move_id,
+                   mon->charged_moves[1].move_id
+                 },
+    .reserved1 = 0
+  };
+}
+
+
+struct matchup_cache_key_s {
+  matchup_mon_key_t mon1;
+  matchup_mon_key_t mon2;
+  uint8_t           scenario;
+  uint8_t           ai;           /* `MATCHUP_AI_NAIVE' */
+  uint8_t           reserved[6];  /* Always 0 */
+};
+typedef struct matchup_cache_key_s  matchup_cache_key_t;
+
+_Static_assert( sizeof( matchup_cache_key_t ) == 48,
+                "matchup_cache_key_t must be 48 bytes"
+              );
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * `tag' is the first half of the hash, never 0, or 0 for an empty slot.
+ * `val' is `MATCHUP_CACHE_VALID_M', the low 47 bits of the second half of
+ * the hash, and the rating in the low 16 bits; 0 until it is written.
+ */
+#define MATCHUP_CACHE_VALID_M  ( (uint64_t) 1 << 63 )
+
+struct matchup_cache_slot_s {
+  _Atomic uint64_t tag;
+  _Atomic uint64_t val;
+};
+typedef struct matchup_cache_slot_s  matchup_cache_slot_t;
+
+/* The same slots in a file */
+struct matchup_cache_file_slot_s {
+  uint64_t tag;
+  uint64_t val;
+};
+typedef struct matchup_cache_file_slot_s  matchup_cache_file_slot_t;
+
+/* Slots follow the header, `cap' of them */
+struct matchup_cache_header_s {
+  char     magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t data_version;
+  uint64_t size;          /* Total size of the file in bytes */
+  uint32_t cap;           /* Power of 2 */
+  uint32_t cnt;
+};
+typedef struct matchup_cache_header_s  matchup_cache_header_t;
+
+_Static_assert( sizeof( matchup_cache_header_t ) == 40,
+                "matchup_cache_header_t must be 40 bytes"
+              );
+
+
+struct matchup_cache_s {
+  matchup_cache_slot_t            * slots;
+  uint32_t                          cap;           /* 0 or a power of 2 */
+  atomic_uint_fast32_t              cnt;
+  uint64_t                          data_version;
+  /* Persistent tier, `NULL' if none is loaded */
+  const matchup_cache_header_t    * file;
+  const matchup_cache_file_slot_t * file_slots;
+  /* Counters, see `matchup_cache_stats' */
+  atomic_uint_fast64_t              hits;
+  atomic_uint_fast64_t              file_hits;
+  atomic_uint_fast64_t              misses;
+  atomic_uint_fast64_t              dropped;
+};
+typedef struct matchup_cache_s  matchup_cache_t;
+
+#define MATCHUP_CACHE_INIT                                                    \
+  { .slots = NULL, .cap = 0, .cnt = 0, .data_version = 0, .file = NULL,       \
+    .file_slots = NULL, .hits = 0, .file_hits = 0, .misses = 0,               \
+    .dropped = 0 }
+
+
+struct matchup_cache_stats_s {
+  uint64_t hits;          /* Found in the in-process table */
+  uint64_t file_hits;     /* Found in the persistent tier */
+  uint64_t misses;
+  uint64_t dropped;       /* Inserts into a full table */
+  uint32_t entries;       /* In the in-process table */
+  uint32_t file_entries;
+  uint32_t cap;
+};
+typedef struct matchup_cache_stats_s  matchup_cache_stats_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+/* `data_version' is written to, and checked against, cache files. */
+void matchup_cache_init( matchup_cache_t * cache, uint64_t data_version );
+/* Frees the table and unmaps any file. */
+void matchup_cache_free( matchup_cache_t * cache );
+
+/**
+ * Make room for `cnt' ratings in the in-process table in total.
+ * Not thread safe: no other thread may use the cache meanwhile.
+ */
+int  matchup_cache_reserve( matchup_cache_t * cache, uint32_t cnt );
+
+/* Returns `false' on a miss, counting hits and misses. */
+bool matchup_cache_get( matchup_cache_t         * cache,
+                        const matchup_mon_key_t * mon1,
+                        const matchup_mon_key_t * mon2,
+                        uint8_t                   scenario,
+                        uint16_t                * rating
+                      );
+
+/**
+ * Add a rating, keeping any rating already held for the matchup.
+ * Returns `STORE_ERROR_NOMEM' if the table could not be created; once a
+ * table exists inserts never fail, though they are dropped when it is full.
+ * Only the first insert creates a table, reserve room in advance when
+ * inserting from several threads.
+ */
+int  matchup_cache_put( matchup_cache_t         * cache,
+                        const matchup_mon_key_t * mon1,
+                        const matchup_mon_key_t * mon2,
+                        uint8_t                   scenario,
+                        uint16_t                  rating
+                      );
+
+void matchup_cache_stats( const matchup_cache_t * cache,
+                          matchup_cache_stats_t * stats
+                        );
+void matchup_cache_reset_stats( matchup_cache_t * cache );
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Write every rating of both tiers as a cache file.
+ * Not thread safe, like `matchup_cache_reserve'.
+ */
+int matchup_cache_write( const matchup_cache_t * cache, FILE * ostream );
+
+/**
+ * Write a cache file to `fpath', through a temporary file that replaces it
+ * once complete.
+ */
+int matchup_cache_save( const matchup_cache_t * cache, const char * fpath );
+
+/**
+ * Map the cache file at `fpath' as the persistent tier, replacing any loaded
+ * before.
+ * Returns `STORE_ERROR_NOT_FOUND' if there is no file, and
+ * `STORE_ERROR_BAD_VALUE' if it is malformed or holds another data version;
+ * either way the cache is left as it was.
+ */
+int matchup_cache_load( matchup_cache_t * cache, const char * fpath );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* matchup_cache.h */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,224 @@
+/* -*- mode: c; -*- */
+
+#ifndef _MATCHUP_FILE_H
+#define _MATCHUP_FILE_H
+
+/* ========================================================================= */
+
+#include "matchup.h"
+#include "store.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A binary file format for `matchup_matrix_t's, read in place with `mmap'.
+ * <p>
+ * An all vs. all matrix of a league holds millions of ratings, so rather
+ * than loading one whole, `matchup_file_open' maps it and the queries read
+ * only the pages they need:
+ *   - A row scan gives every rating of one Pokemon, "all matchups of X".
+ *   - A column scan gives every rating against one Pokemon, "who beats Y".
+ * <p>
+ * Ratings are stored in tiles of `MATCHUP_FILE_TILE_ROWS' by
+ * `MATCHUP_FILE_TILE_COLS' cells of one scenario, 4 KiB each, aligned to
+ * pages in the file.
+ * A row major matrix reads columns one cell per page, and a column major one
+ * rows; with tiles either scan uses every page it reads 32 or 64 times over.
+ * Tiles are laid out band by band ( `MATCHUP_FILE_TILE_ROWS' rows ), tile
+ * column by tile column, scenario by scenario: a row scan reads one band
+ * front to back, and a column scan reads a run of tiles from each band, so
+ * both move through the file in one direction.
+ * Tiles on the bottom and right edges are padded with 0s.
+ * <p>
+ * The header names the Pokemon and moveset of each row and column, see
+ * `matchup_file_mon_t', and carries a "data version" like cache files do
+ * ( see `matchup_cache.h' ) so ratings from another Game Master are never
+ * read by mistake.
+ */
+
+#define MATCHUP_FILE_MAGIC       "CPKMTRX"
+#define MATCHUP_FILE_VERSION     1
+#define MATCHUP_FILE_BYTE_ORDER  0x01020304
+
+#define MATCHUP_FILE_TILE_ROWS   32
+#define MATCHUP_FILE_TILE_COLS   64
+#define MATCHUP_FILE_TILE_SIZE                                                \
+  ( sizeof( uint16_t ) * MATCHUP_FILE_TILE_ROWS * MATCHUP_FILE_TILE_COLS )
+
+/* Tiles begin at a multiple of this offset in the file */
+#define MATCHUP_FILE_ALIGN       4096
+
+
+/* ------------------------------------------------------------------------- */
+
+/* The Pokemon of a row or column */
+struct matchup_file_mon_s {
+  uint16_t dex_number;
+  uint8_t  form_idx;
+  uint8_t  level;
+  uint16_t fast_move_id;
+  uint16_t charged_move_ids[2];  /* Second is 0 for one charged move */
+  uint16_t reserved;             /* Always 0 */
+};
+typedef struct matchup_file_mon_s  matchup_file_mon_t;
+
+_Static_assert( sizeof( matchup_file_mon_t ) == 12,
+                "matchup_file_mon_t must be 12 bytes"
+              );
+
+
+/**
+ * Followed by `nrows' then `ncols' `matchup_file_mon_t's, and the tiles at
+ * `tiles_offset'.
+ */
+struct matchup_file_header_s {
+  char     magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t data_version;
+  uint64_t size;                            /* Total size of the file */
+  uint32_t nrows;
+  uint32_t ncols;
+  uint8_t  nscenarios;
+  uint8_t  scenarios[MATCHUP_NSCENARIOS];   /* As in `matchup_matrix_t' */
+  uint16_t tile_rows;                       /* `MATCHUP_FILE_TILE_ROWS' */
+  uint16_t tile_cols;                       /* `MATCHUP_FILE_TILE_COLS' */
+  uint16_t reserved;                        /* Always 0 */
+  uint64_t tiles_offset;
+};
+typedef struct matchup_file_header_s  matchup_file_header_t;
+
+_Static_assert( sizeof( matchup_file_header_t ) == 64,
+                "matchup_file_header_t must be 64 bytes"
+              );
+
+
+/* An open file, read only and safe to share between threads. */
+struct matchup_file_s {
+  const matchup_file_header_t * header;
+  const matchup_file_mon_t    * rows;
+  const matchup_file_mon_t    * cols;
+  const uint16_t              * tiles;
+  uint32_t                      nbands;      /* Bands of tiles */
+  uint32_t                      ntile_cols;  /* Tiles per band and scenario */
+};
+typedef struct matchup_file_s  matchup_file_t;
+
+#define MATCHUP_FILE_INIT                                                     \
+  { .header = NULL, .rows = NULL, .cols = NULL, .tiles = NULL, .nbands = 0,   \
+    .ntile_cols = 0 }
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Write `matrix' as a matrix file, with `rows' and `cols' naming its rows
+ * and columns.
+ */
+int  matchup_file_write( const matchup_matrix_t   * matrix,
+                         const matchup_file_mon_t * rows,
+                         const matchup_file_mon_t * cols,
+                         uint64_t                   data_version,
+                         FILE                     * ostream
+                       );
+
+/**
+ * Write a matrix file to `fpath', through a temporary file that replaces it
+ * once complete.
+ */
+int  matchup_file_save( const matchup_matrix_t   * matrix,
+                        const matchup_file_mon_t * rows,
+                        const matchup_file_mon_t * cols,
+                        uint64_t                   data_version,
+                        const char               * fpath
+                      );
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Map the matrix file at `fpath'.
+ * Returns `STORE_ERROR_NOT_FOUND' if there is no file, and
+ * `STORE_ERROR_BAD_VALUE' if it is malformed or holds another data version.
+ */
+int  matchup_file_open( matchup_file_t * file,
+                        const char     * fpath,
+                        uint64_t         data_version
+                      );
+
+void matchup_file_close( matchup_file_t * file );
+
+
+/* The tile holding `row' and `col' in scenario index `s' */
+  static inline const uint16_t *
+matchup_file_tile( const matchup_file_t * file,
+                   uint32_t               row,
+                   uint8_t                s,
+                   uint32_t               col
+                 )
+{
+  size_t tile = ( (size_t) ( row / MATCHUP_FILE_TILE_ROWS ) *
+                  file->ntile_cols + col / MATCHUP_FILE_TILE_COLS ) *
+                file->header->nscenarios + s;
+  return file->tiles + tile * MATCHUP_FILE_TILE_ROWS * MATCHUP_FILE_TILE_COLS;
+}
+
+/* Arguments are as `matchup_matrix_get' */
+  static inline uint16_t
+matchup_file_get( const matchup_file_t * file,
+                  uint32_t               row,
+                  uint8_t                s,
+                  uint32_t               col
+                )
+{
+  return matchup_file_tile( file, row, s, col )[
+           ( row % MATCHUP_FILE_TILE_ROWS ) * MATCHUP_FILE_TILE_COLS +
+           col % MATCHUP_FILE_TILE_COLS
+         ];
+}
+
+/**
+ * Copy every rating of `row' to `ratings', `ratings[s * ncols + col]', the
+ * layout of a `matchup_matrix_row'.
+ */
+void matchup_file_row( const matchup_file_t * file,
+                       uint32_t               row,
+                       uint16_t             * ratings
+                     );
+
+/* Copy every rating against `col' to `ratings', `ratings[s * nrows + row]'. */
+void matchup_file_col( const matchup_file_t * file,
+                       uint32_t               col,
+                       uint16_t             * ratings
+                     );
+
+/* Read the whole file into a new matrix, free it with `matchup_matrix_free'. */
+int  matchup_file_read_matrix( const matchup_file_t * file,
+                               matchup_matrix_t     * matrix
+                             );
+
+/**
+ * Find `mon' in `mons', one of `file->rows' or `file->cols'.
+ * Returns `false' if it isn't there.
+ */
+bool matchup_file_find( const matchup_file_mon_t * mons,
+                        uint32_t                   n,
+                        const matchup_file_mon_t * mon,
+                        uint32_t                 * idx
+                      );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* matchup_file.h */
+
+/* vim: set filetype=c : */
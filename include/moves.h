@@ -5,8 +5,6 @@
 
 /* ========================================================================= */
 
-#include "ext/uthash.h"
-#include "hash.h"
 #include "ptypes.h"
 #include "store.h"
 #include <stdbool.h>
@@ -194,8 +192,6 @@ struct store_move_s {
   uint8_t        pve_energy;
   uint8_t        pvp_energy;
   buff_t         buff;
-  UT_hash_handle hh_name;
-  UT_hash_handle hh_move_id;
 };
 typedef struct store_move_s  store_move_t;
 
@@ -209,9 +205,7 @@ static const store_move_t NO_MOVE_STORE = {
   .pvp_power  = 1,
   .pve_energy = 1,
   .pvp_energy = 1,
-  .buff       = NO_BUFF,
-  .hh_name    = HH_NULL,
-  .hh_move_id = HH_NULL
+  .buff       = NO_BUFF
 };
 
 
@@ -288,6 +282,44 @@ pvp_fast_move_from_store_move( store_move_t * stored )
 }
 
 
+/* ------------------------------------------------------------------------- */
+
+/* Whether two buffs have the same effect, all "no buff"s are equal. */
+  static inline bool
+buff_equal( buff_t a, buff_t b )
+{
+  if ( ( a.chance == bc_0000 ) || ( b.chance == bc_0000 ) )
+    {
+      return a.chance == b.chance;
+    }
+  return ( a.chance == b.chance ) &&
+         ( a.atk_buff.target  == b.atk_buff.target  ) &&
+         ( a.atk_buff.debuffp == b.atk_buff.debuffp ) &&
+         ( a.atk_buff.amount  == b.atk_buff.amount  ) &&
+         ( a.def_buff.target  == b.def_buff.target  ) &&
+         ( a.def_buff.debuffp == b.def_buff.debuffp ) &&
+         ( a.def_buff.amount  == b.def_buff.amount  );
+}
+
+/**
+ * Whether the PvP stats of `a' and `b' are the same, so that they only differ
+ * by name and ID.
+ */
+bool store_move_pvp_equal( const store_move_t * a, const store_move_t * b );
+
+/**
+ * Whether `a' is strictly better than `b' in PvP, so a Pokemon that knows
+ * both would never want `b'.
+ * Both must be the same type and kind of move.
+ * A Fast Move must deal at least as much damage and generate at least as much
+ * energy per turn, a Charged Move must have at least as much power for at
+ * most as much energy and the same buff; one of these must be strictly
+ * better.
+ * Equal moves do not dominate each other.
+ */
+bool store_move_dominates( const store_move_t * a, const store_move_t * b );
+
+
 /* ------------------------------------------------------------------------- */
 
 int fprint_buff( FILE * stream, const buff_t * buff );
@@ -0,0 +1,157 @@
+/* -*- mode: c; -*- */
+
+#ifndef _MOVESET_H
+#define _MOVESET_H
+
+/* ========================================================================= */
+
+#include "cupstore.h"
+#include "matchup.h"
+#include "pokedex.h"
+#include "pokemon.h"
+#include "store.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Choosing a species' moveset for a league.
+ * <p>
+ * A species with `F' Fast Moves and `C' Charged Moves has `F * C( C, 2 )'
+ * movesets, most of which are hopeless: a move that is the same type as
+ * another but worse by every measure ( see `store_move_dominates' ) is never
+ * worth carrying.
+ * Movesets are first pruned by these cheap comparisons, without battling,
+ * and only the survivors are simulated.
+ * <p>
+ * A moveset is dominated when another moveset's Fast Move and Charged Moves
+ * are each equal to or better than its own, and one is better; pruning keeps
+ * exactly the movesets that aren't.
+ * Moves with equal PvP stats count as equal, the one listed first is kept.
+ * Pruning never empties a species.
+ * <p>
+ * Survivors of every species in a cup are battled against a meta together,
+ * as one `matchup_matrix_t', and each species' best moveset is the one with
+ * the highest mean Battle Rating.
+ * A `matchup_cache_t' carried between calls keeps every rating, so running
+ * the same species against a changed meta, or in another league, only
+ * simulates matchups that are new.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+struct moveset_s {
+  uint16_t fast_move_id;
+  uint16_t charged_move_ids[2];  /* Second is 0 for one charged move */
+};
+typedef struct moveset_s  moveset_t;
+
+
+/* Every moveset of `pdex', pruned or not. */
+  static inline uint32_t
+moveset_count( const pdex_mon_t * pdex )
+{
+  uint32_t nc = pdex->charged_moves_cnt;
+  return pdex->fast_moves_cnt * ( ( nc == 1 ) ? 1 : ( nc * ( nc - 1 ) / 2 ) );
+}
+
+
+/**
+ * Write the movesets of `pdex' to `movesets', which must have room for
+ * `moveset_count( pdex )' of them, and their number to `n'.
+ * With `prune' dominated movesets are left out.
+ * Movesets are in Pokedex order: by Fast Move, then by pairs of Charged
+ * Moves.
+ * Move data is read from `store', which must have `SF_STANDARD_KEY'.
+ */
+int moveset_candidates( store_t          * store,
+                        const pdex_mon_t * pdex,
+                        bool               prune,
+                        moveset_t        * movesets,
+                        uint32_t         * n
+                      );
+
+
+/* ------------------------------------------------------------------------- */
+
+struct moveset_opts_s {
+  stats_t           ivs;        /* Used by every Pokemon */
+  uint16_t          scenarios;  /* See `matchup_scenario_mask' */
+  bool              prune;      /* Simulate only undominated movesets */
+  const float     * weights;    /* Per meta Pokemon, `NULL' for even */
+  matchup_cache_t * cache;      /* `NULL' to simulate everything */
+  uint32_t          nthreads;   /* 0 for one per core */
+};
+typedef struct moveset_opts_s  moveset_opts_t;
+
+#define MOVESET_OPTS_DEFAULT                                                  \
+  {                                                                           \
+    .ivs       = { .attack = 15, .stamina = 15, .defense = 15 },              \
+    .scenarios = MATCHUP_STANDARD_SCENARIOS_M,                                \
+    .prune     = true,                                                        \
+    .weights   = NULL,                                                        \
+    .cache     = NULL,                                                        \
+    .nthreads  = 0                                                            \
+  }
+
+
+/* The best moveset of one species */
+struct moveset_best_s {
+  uint16_t  dex_number;
+  uint8_t   form_idx;
+  uint8_t   level;       /* Highest whole level under the CP cap */
+  moveset_t moveset;
+  float     score;       /* Mean Battle Rating against the meta, 0 - 1000 */
+  uint32_t  nmovesets;   /* Every moveset of the species */
+  uint32_t  nsimulated;  /* Movesets that survived pruning */
+};
+typedef struct moveset_best_s  moveset_best_t;
+
+/* Results for one league, species in Pokedex order */
+struct moveset_league_s {
+  uint16_t         cp_cap;
+  uint32_t         nspecies;
+  moveset_best_t * best;
+  uint32_t         nmovesets;   /* Totals over every species */
+  uint32_t         nsimulated;
+};
+typedef struct moveset_league_s  moveset_league_t;
+
+#define MOVESET_LEAGUE_INIT                                                   \
+  { .cp_cap = 0, .nspecies = 0, .best = NULL, .nmovesets = 0,                 \
+    .nsimulated = 0 }
+
+
+/**
+ * Find the best moveset of every species in `cup->pool' against the `nmeta'
+ * Pokemon of `meta', in the league given by `cup->cp_cap'.
+ * Pokedex and Move data are read from the store the cup's index was built
+ * on; `opts' may be `NULL' for the defaults.
+ * Species that can't be brought under the CP cap, or that have no fast or
+ * charged moves, are left out.
+ * Returns `STORE_ERROR_NOT_FOUND' if no Pokemon are eligible, or
+ * `STORE_ERROR_BAD_VALUE' for an empty meta or bad weights.
+ */
+int  moveset_optimize( moveset_league_t     * league,
+                       const cup_t          * cup,
+                       const pvp_pokemon_t  * meta,
+                       uint32_t               nmeta,
+                       const moveset_opts_t * opts
+                     );
+
+void moveset_league_free( moveset_league_t * league );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* moveset.h */
+
+/* vim: set filetype=c : */
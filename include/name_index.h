@@ -0,0 +1,84 @@
+/* -*- mode: c; -*- */
+
+#ifndef _NAME_INDEX_H
+#define _NAME_INDEX_H
+
+/* ========================================================================= */
+
+#include "store.h"
+#include "util/bktree.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Fuzzy lookup of Pokemon and Move names in a store, for user input and
+ * OCR'd rosters where "galarain stunfsk" should still find `STUNFISK'.
+ * <p>
+ * The index is built once with `store_each', holding one BK-tree for each of
+ * Pokemon and Moves.
+ * Pokemon forms are indexed both as "<NAME>_<FORM>" and "<FORM>_<NAME>", and
+ * the base form is also indexed by its plain name.
+ * <p>
+ * Queries are normalized the same way as store names: upper-cased, with runs
+ * of anything else than letters and digits squeezed to a single '_'.
+ * <p>
+ * Trees only hold keys, and values are fetched from the store on each hit,
+ * so the store must outlive the index.
+ * An index over an `SF_THREAD_SAFE' store may be queried from any thread.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Longer names are truncated when normalized. */
+#define NAME_INDEX_MAX_LEN  64
+
+
+struct name_index_s {
+  store_t  * store;
+  bktree_t   mons;
+  bktree_t   moves;
+};
+typedef struct name_index_s  name_index_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Copy `name' to `buffer' in normalized form, `buffer' must hold
+ * `NAME_INDEX_MAX_LEN + 1' bytes.
+ * Returns the length of the normalized name.
+ */
+size_t name_index_normalize( const char * name, char * buffer );
+
+int  name_index_init( name_index_t * idx, store_t * store );
+void name_index_free( name_index_t * idx );
+
+/**
+ * Find the `STORE_POKEDEX' or `STORE_MOVE' value with the name nearest to
+ * `name', allowing at most `max_dist' edits.
+ * `dist' may be `NULL', otherwise it is set to the number of edits.
+ * Returns `STORE_ERROR_NOT_FOUND' if nothing is close enough.
+ */
+int name_index_lookup( const name_index_t  *  idx,
+                       store_type_t           val_type,
+                       const char          *  name,
+                       int                    max_dist,
+                       void                ** val,
+                       int                 *  dist
+                     );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* name_index.h */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,187 @@
+/* -*- mode: c; -*- */
+
+#ifndef _NASH_H
+#define _NASH_H
+
+/* ========================================================================= */
+
+#include "ai/ai.h"
+#include "matchup.h"
+#include "pokemon.h"
+#include "store.h"
+#include "team_builder.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Picking a lead is a simultaneous move, zero sum game: each side commits to
+ * a lead without seeing the other's, and whatever one side's lead wins the
+ * other's loses.
+ * Given the row player's payoffs, an equilibrium is a pair of mixed
+ * strategies neither side can improve on alone; its value is what the row
+ * player expects to get.
+ * <p>
+ * Three solvers are offered:
+ *   LP         - Exact, a dense simplex on the column player's linear
+ *                program, with the row player's strategy read off its duals.
+ *                Best for games of up to a few dozen strategies a side.
+ *   Regret     - Regret Matching+, alternating updates and linearly weighted
+ *                averages.
+ *   Fictitious - Fictitious Play, each side best responding to the other's
+ *                history, at `O( nrows + ncols )' per iteration.
+ * The iterative solvers stop once the equilibrium they have is within
+ * `tolerance' of exact, so they scale to hundreds of strategies a side.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+struct nash_game_s {
+  uint32_t   nrows;
+  uint32_t   ncols;
+  double   * payoff;  /* Row player's, row major */
+};
+typedef struct nash_game_s  nash_game_t;
+
+#define NASH_GAME_INIT  { .nrows = 0, .ncols = 0, .payoff = NULL }
+
+#define nash_payoff( GAME, R, C )                                             \
+  ( ( GAME )->payoff[(size_t) ( R ) * ( GAME )->ncols + ( C )] )
+
+
+/* A `nrows' by `ncols' game of zeroes. */
+int  nash_game_init( nash_game_t * game, uint32_t nrows, uint32_t ncols );
+
+/**
+ * The game played by `rows' of `matrix' against every column in `scenario',
+ * with Battle Ratings scaled to 0 - 1.
+ * `rows' may be `NULL' to take every row.
+ * Returns `STORE_ERROR_BAD_VALUE' if `scenario' wasn't built, or the game
+ * would be empty.
+ */
+int  nash_game_from_matrix( nash_game_t            * game,
+                            const matchup_matrix_t * matrix,
+                            uint8_t                  scenario,
+                            const uint32_t         * rows,
+                            uint32_t                 nrows
+                          );
+
+void nash_game_free( nash_game_t * game );
+
+
+/* ------------------------------------------------------------------------- */
+
+typedef enum {
+  NASH_AUTO,        /* LP for small games, Regret otherwise */
+  NASH_LP,
+  NASH_REGRET,
+  NASH_FICTITIOUS
+} nash_method_t;
+
+struct nash_opts_s {
+  nash_method_t method;
+  uint32_t      max_iters;   /* For the iterative solvers */
+  double        tolerance;   /* Stop once `gap' is this small */
+  uint32_t      lp_max;      /* `NASH_AUTO' strategies per side for the LP */
+};
+typedef struct nash_opts_s  nash_opts_t;
+
+#define NASH_OPTS_DEFAULT                                                     \
+  {                                                                           \
+    .method    = NASH_AUTO,                                                   \
+    .max_iters = 10000,                                                       \
+    .tolerance = 1e-4,                                                        \
+    .lp_max    = 64                                                           \
+  }
+
+struct nash_eq_s {
+  double   * row;    /* Mixed strategies, each summing to 1 */
+  double   * col;
+  double     value;  /* Row player's expected payoff */
+  double     gap;    /* What best responses would gain, 0 if exact */
+  uint32_t   iters;  /* Pivots, for the LP */
+};
+typedef struct nash_eq_s  nash_eq_t;
+
+#define NASH_EQ_INIT                                                          \
+  { .row = NULL, .col = NULL, .value = 0.0, .gap = 0.0, .iters = 0 }
+
+
+/**
+ * Solve `game', filling `eq'.
+ * `opts' may be `NULL' for the defaults.
+ * Iterative solvers that run out of iterations still succeed, with the best
+ * equilibrium they found; check `eq->gap'.
+ * Returns `STORE_ERROR_BAD_VALUE' for an empty game.
+ */
+int  nash_solve( const nash_game_t * game,
+                 const nash_opts_t * opts,
+                 nash_eq_t         * eq
+               );
+
+void nash_eq_free( nash_eq_t * eq );
+
+/**
+ * The row that does best against the column player's mixed strategy `col',
+ * with its expected payoff in `value' ( which may be `NULL' ).
+ * Ties go to the lowest row.
+ */
+uint32_t nash_best_row( const nash_game_t * game,
+                        const double      * col,
+                        double            * value
+                      );
+
+/* The column holding the row player to the least, like `nash_best_row'. */
+uint32_t nash_best_col( const nash_game_t * game,
+                        const double      * row,
+                        double            * value
+                      );
+
+
+/* ------------------------------------------------------------------------- */
+
+struct nash_select_opts_s {
+  team_builder_opts_t team;    /* Picks the members, and scores leads */
+  nash_opts_t         nash;
+  bool                sample;  /* Draw the lead, or take the likeliest */
+  uint64_t            seed;    /* Advanced by every draw */
+};
+typedef struct nash_select_opts_s  nash_select_opts_t;
+
+#define NASH_SELECT_OPTS_DEFAULT                                              \
+  {                                                                           \
+    .team   = TEAM_BUILDER_OPTS_DEFAULT,                                      \
+    .nash   = NASH_OPTS_DEFAULT,                                              \
+    .sample = false,                                                          \
+    .seed   = 0                                                               \
+  }
+
+
+/**
+ * A `select_team_fn' which takes the members `team_builder_select_team'
+ * would, then picks the lead by playing the lead game: our 3 members
+ * against every Pokemon in `their_roster', in the lead scenario.
+ * The lead goes in `team[0]', the others keep their roles.
+ * `aux' may point to a `nash_select_opts_t'.
+ */
+ai_status_t nash_select_team( roster_t      * our_roster,
+                              roster_t      * their_roster,
+                              pvp_pokemon_t * team,
+                              store_t       * store,
+                              void          * aux
+                            );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* nash.h */
+
+/* vim: set filetype=c : */
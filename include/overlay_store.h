@@ -0,0 +1,173 @@
+/* -*- mode: c; -*- */
+
+#ifndef _OVERLAY_STORE_H
+#define _OVERLAY_STORE_H
+
+/* ========================================================================= */
+
+#include "ext/uthash.h"
+#include "store.h"
+#include "pokedex.h"
+#include "moves.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * An "Overlay" store layers a small set of modified values over another
+ * store, for "what if" experiments like giving a move +1 energy.
+ * <p>
+ * Values written with `add'/`set' are copied into the overlay, the base store
+ * is never modified.
+ * Lookups check the overlay's hash table first and fall through to the base
+ * on a miss, so each lookup costs one extra hash probe.
+ * Many overlays can share a single base, and if the base is `SF_THREAD_SAFE'
+ * they may each live in their own thread.
+ * <p>
+ * NOTE: Only the `pdex_mon_t'/`store_move_t' structs are copied, strings,
+ *       move lists, and `next_form' still point into the base, so the base
+ *       must outlive the overlay.
+ *       Following `next_form' leads to the base's forms, not the overlay's;
+ *       fetch other forms by key instead.
+ * <p>
+ * An overlay is modified in place and is not `SF_THREAD_SAFE' itself, so
+ * write to it from one thread, or finish writing before sharing it.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Values are stored in the same block as the entry. */
+struct overlay_entry_s {
+  uint64_t         key;       /* See `overlay_key' */
+  union {
+    pdex_mon_t     mon;
+    store_move_t   move;
+  };
+  UT_hash_handle   hh;
+};
+typedef struct overlay_entry_s  overlay_entry_t;
+
+
+struct overlay_store_aux_s {
+  store_t         * base;
+  overlay_entry_t * entries;
+};
+typedef struct overlay_store_aux_s  overlay_store_aux_t;
+
+#define as_ovsa( STORE_PTR )  ( (overlay_store_aux_t *) ( STORE_PTR )->aux )
+
+typedef store_t  overlay_store_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline uint64_t
+overlay_key( store_key_t key )
+{
+  return ( ( (uint64_t) key.key_type ) << 40 ) |
+         ( ( (uint64_t) key.val_type ) << 32 ) |
+         key.data_f;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+bool overlay_store_has( store_t * overlay_store, store_key_t key );
+int  overlay_store_get( store_t * overlay_store, store_key_t key, void ** val );
+int  overlay_store_each( store_t       * overlay_store,
+                         store_type_t    val_type,
+                         store_each_cb   cb,
+                         void          * ctx
+                       );
+int  overlay_store_get_str( store_t    *  overlay_store,
+                            const char *  key,
+                            void       ** val
+                          );
+int  overlay_store_get_str_t( store_t      *  overlay_store,
+                              store_type_t    val_type,
+                              const char   *  key,
+                              void         ** val
+                            );
+/* Fails if the key is already present in the overlay or the base */
+int  overlay_store_add( store_t * overlay_store, store_key_t key, void * val );
+/* Fails if the key is not present in the overlay or the base */
+int  overlay_store_set( store_t * overlay_store, store_key_t key, void * val );
+/* `base' is the `store_t' to layer over, it must already be initialized */
+int  overlay_store_init( store_t * overlay_store, void * base );
+void overlay_store_free( store_t * overlay_store );
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Fetch a writable copy of a Pokemon/Move in the overlay, copying it from the
+ * base the first time.
+ * The value may then be modified directly:
+ *   store_move_t * move = NULL;
+ *   overlay_store_edit_move( & overlay, 13, & move );
+ *   move->pvp_energy++;
+ * Each call counts as a change for `store_version', so fetch the value again
+ * for every round of edits.
+ */
+int overlay_store_edit_pokemon( overlay_store_t *  overlay_store,
+                                uint16_t           dex_num,
+                                uint8_t            form_idx,
+                                pdex_mon_t      ** mon
+                              );
+
+int overlay_store_edit_move( overlay_store_t *  overlay_store,
+                             uint16_t           move_id,
+                             store_move_t    ** move
+                           );
+
+/* Remove all overlay values, returning to the base store's data. */
+void overlay_store_reset( overlay_store_t * overlay_store );
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline int
+overlay_store_export( store_t      * overlay_store,
+                      store_sink_t   sink_type,
+                      void         * target
+                    )
+{
+  return STORE_ERROR_NOT_DEFINED;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+#define def_overlay_store()                                                   \
+  {                                                                           \
+    .name      = "Overlay",                                                   \
+    .flags     = SF_WRITABLE_M | SF_CUSTOM_DATA_M | SF_STANDARD_KEY_M |       \
+                 SF_TYPED_M | SF_GET_STRING_M | SF_GET_TYPED_STRING_M,        \
+    .has       = overlay_store_has,                                           \
+    .get       = overlay_store_get,                                           \
+    .get_many  = store_get_many_generic,                                      \
+    .each      = overlay_store_each,                                          \
+    .get_str   = overlay_store_get_str,                                       \
+    .get_str_t = overlay_store_get_str_t,                                     \
+    .add       = overlay_store_add,                                           \
+    .set       = overlay_store_set,                                           \
+    .export    = overlay_store_export,                                        \
+    .init      = overlay_store_init,                                          \
+    .free      = overlay_store_free,                                          \
+    .aux       = NULL                                                         \
+  }
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* overlay_store.h */
+
+/* vim: set filetype=c : */
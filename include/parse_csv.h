@@ -5,15 +5,12 @@
 
 /* ========================================================================= */
 
-#include <assert.h>
-#include "moves.h"
 #include "pokedex.h"
-#include "ptypes.h"
-#include "util/macros.h"
 #include "pokemon.h"
-#include "gm_store.h"
+#include "store.h"
+#include "util/csv.h"
 #include <stdint.h>
-#include <string.h>
+#include <stdlib.h>
 
 
 /* ------------------------------------------------------------------------- */
@@ -29,6 +26,15 @@
  * <p>
  * The only real hiccup is that Pokebattler writes a pokemon's form with it's
  * name, so "Galarian Stunfisk" has the field `pokemon = STUNFISK_GALARIAN_FORM'
+ * <p>
+ * Files are memory mapped and parsed in place: fields are sliced rather than
+ * copied, and the only allocations are the roster itself, sized by counting
+ * lines before parsing.
+ *
+ * Example data:
+ *
+ * id,importedId,pokemon,name,cp,level,individualAttack,individualDefense,individualStamina,quickMove,cinematicMove,shiny,lucky,cinematicMove2
+ * 5616504,,STUNFISK_GALARIAN_FORM,,1235,20,15,15,15,MUD_SHOT_FAST,EARTHQUAKE,false,false,ROCK_SLIDE
  */
 
 enum pokebattler_field_e {
@@ -45,116 +51,91 @@ enum pokebattler_field_e {
   PBF_CHARGED1,
   PBF_SHINY,
   PBF_LUCKY,
-  PBF_CHARGED2
+  PBF_CHARGED2,
+  PBF_NUM_FIELDS
 };
 
+
+/* ------------------------------------------------------------------------- */
+
 /**
- * Okay this is the annoying part.
- * We have to split the form name out of this field.
- * The easiest way to do this is to pull the name until the first '_'
- * character, treating a handful of Pokemon as edge cases explicitly.
- * This definitely isn't ideal, but the alternative would be an incredibly
- * costly regex search of the entire store for a lot of pokemon.
- *
- * The edge cases are:
- *   - NIDORAN_FEMALE
- *   - NIDORAN_MALE
- *   - MR_MIME
- *   - HO_OH
- *   - MIME_JR
- *   - PORYGON_Z
- *
- * The trickier of these are those with Shadow forms.
- * Be cautious because if Shadow Ho-Oh is ever released, you're going to need
- * to update this.
+ * Resolve a Pokebattler species name such as `STUNFISK_GALARIAN_FORM',
+ * `VENUSAUR_SHADOW_FORM', or `HO_OH' to a Pokedex entry in `store'.
+ * <p>
+ * Rather than keeping a list of species with '_' in their names, every split
+ * point is tried against the store from left to right, the whole name first.
+ * Shadow/Purified variants share their regular form's entry.
  */
-static const char * PBF_SPACED_NAMES = {
-  "NIDORAN_FEMALE", "NIDORAN_MALE", "MR_MIME", "HO_OH", "MIME_JR", "PORYGON_Z"
-};
-
-  int
-parse_pokebattler_name( const char     * str,
-                              uint16_t * dex_number,
-                              uint8_t  * form_idx,
-                              store_t  * gm_store
-                      )
-{
+int parse_pokebattler_name( const char        *  str,
+                            size_t               len,
+                            store_t           *  store,
+                            const pdex_mon_t  ** mon
+                          );
 
-}
+/**
+ * Parse one line of a Pokebattler export into `mon' and `base'.
+ * The line ends at `len', or at the first newline.
+ * `mon->base' is set to `base'.
+ */
+int parse_csv_pokemon( const char       * line,
+                       size_t             len,
+                       store_t          * store,
+                       roster_pokemon_t * mon,
+                       base_pokemon_t   * base
+                     );
 
 /**
- * Example data:
- *
- * id,importedId,pokemon,name,cp,level,individualAttack,individualDefense,individualStamina,quickMove,cinematicMove,shiny,lucky,cinematicMove2
- * 5616504,,STUNFISK_GALARIAN_FORM,,1235,20,15,15,15,MUD_SHOT_FAST,EARTHQUAKE,false,false,ROCK_SLIDE
+ * Parse a whole Pokebattler export held in `buffer', appending its Pokemon to
+ * `roster'.
+ * The header line is optional, blank lines are skipped.
+ * <p>
+ * `roster' must not already own any `roster_bases', the new Pokemon's bases
+ * are placed in a single block owned by the roster; release them with
+ * `roster_free'.
+ * On failure `roster' is left as it was.
  */
-  int
-parse_csv_pokemon( char             * line,
-                   roster_pokemon_t * mon,
-                   store_t          * gm_store
-                 )
-{
-  assert( line != NULL );
-  assert( mon != NULL );
-  assert( mon->base != NULL );
-  assert( gm_store != NULL );
-
-  const char         * fields[PBF_CHARGED2 + 1];
-        uint8_t        i                        = 0;
-        int            rsl                      = STORE_FAILURE;
-        pdex_mon_t   * pdex_mon                 = NULL;
-        store_move_t * move                     = NULL;
-
-  /* Initialize existing data */
-  mon->base->pdex_mon      = NULL;
-
-  /* Slice fields on commas */
-  for ( const char * tok = strtok( line, "," );
-        ( tok != NULL ) && ( *tok != NULL );
-        tok = strtok( NULL, ",\n" )
-      ) fields[i++] = tok;
-  assert( i == ( PBF_CHARGED2 + 1 ) );
-
-  /* The easy stuff */
-  mon->base->level       = atof( fields[PBF_LEVEL] );
-  mon->base->ivs.attack  = atoi( fields[PBF_IV_ATK] );
-  mon->base->ivs.defense = atoi( fields[PBF_IV_DEF] );
-  mon->base->ivs.stamina = atoi( fields[PBF_IV_STA] );
-
-  /* Strip `_FAST' suffix from fast move names */
-  fields[PBF_FAST_MOVE][strlen( fields[PBF_FAST_MOVE] ) - 6] = '\0';
-  rsl = gm_store_get_move_by_name( gm_store, fields[PBF_FAST_MOVE], & move );
-  assert( rsl == STORE_SUCCESS );
-  mon->fast_move_id = move->move_id;
-  move = NULL;
-
-  rsl = gm_store_get_move_by_name( gm_store, fields[PBF_CHARGED1], & move );
-  assert( rsl == STORE_SUCCESS );
-  mon->charged_move_ids[0] = move->move_id;
-  move = NULL;
-
-  /* Tokenizer should put an empty string for missing fields */
-  if ( fields[PBF_CHARGED2][0] != '\0' )
-    {
-      rsl = gm_store_get_move_by_name( gm_store, fields[PBF_CHARGED2], & move );
-      assert( rsl == STORE_SUCCESS );
-      mon->charged_move_ids[1] = move->move_id;
-      move = NULL;
-    }
-  else
-    {
-      mon->charged_move_ids[1] = 0;
-    }
-
-}
+int parse_csv_roster_buffer( const char * buffer,
+                             size_t       len,
+                             store_t    * store,
+                             roster_t   * roster
+                           );
 
+/* Memory map `fpath' and parse it with `parse_csv_roster_buffer'. */
+int parse_csv_roster( const char * fpath, store_t * store, roster_t * roster );
 
 
+/* ------------------------------------------------------------------------- */
 
+/**
+ * Parse a CalcyIV export, following the same rules for `roster' as
+ * `parse_csv_roster_buffer'.
+ * <p>
+ * Columns are found by name from the header line, which is required, and
+ * either ',' or ';' separated files are accepted.
+ * Pokemon are found by Dex # ( "Nr" ) and "Form", or by "Name" if there is
+ * no Dex #.
+ * IVs are rounded to the nearest whole number when CalcyIV only knows a
+ * range.
+ * Move names are OCR'd by CalcyIV, so those which don't match exactly are
+ * looked up with a `name_index_t', allowing a few typos.
+ */
+int parse_calcy_roster_buffer( const char * buffer,
+                               size_t       len,
+                               store_t    * store,
+                               roster_t   * roster
+                             );
 
-/* ========================================================================= */
+int parse_calcy_roster( const char * fpath,
+                        store_t    * store,
+                        roster_t   * roster
+                      );
 
 
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
 
 #endif /* parse_csv.h */
 
@@ -6,11 +6,13 @@
 /* ========================================================================= */
 
 #include "ext/jsmn.h"
-#include "ext/uthash.h"
 #include "moves.h"
 #include "ptypes.h"
 #include "util/jsmn_iterator_stack.h"
 #include "util/json_util.h"
+#include "util/arena.h"
+#include "util/strmap.h"
+#include "util/strpool.h"
 #include <pokedex.h>
 #ifdef NO_PCRE
 #include <regex.h>
@@ -68,6 +70,49 @@ void gm_regexes_free( gm_regexes_t * grs );
 
 /* ------------------------------------------------------------------------- */
 
+/**
+ * Everything the parser extracts, handed over to `gm_store' whole.
+ * <p>
+ * Records carry no hash handles.
+ * Pokemon and moves are found by Dex # and move ID through plain arrays, and
+ * by name through `strmap_t's that sit beside the records.
+ * Every name is interned in `names', and every Pokemon's move lists are
+ * packed into `move_ids' ( fast moves, then charged moves ), so scanning the
+ * Pokedex walks a few contiguous blocks rather than thousands of small heap
+ * allocations.
+ * The records themselves are carved from `records', which is released whole.
+ */
+struct gm_tables_s {
+  arena_t           records;        /* Every `pdex_mon_t' and `store_move_t' */
+  strpool_t         names;
+  int16_t       *   move_ids;
+  uint32_t          move_ids_cnt;
+  uint32_t          move_ids_cap;
+  pdex_mon_t    **  mons_by_dex;    /* Base forms, `NULL' for gaps */
+  uint16_t          mons_len;       /* Largest Dex # + 1 */
+  uint16_t          mons_cnt;       /* Base forms */
+  store_move_t  **  moves_by_id;    /* `NULL' for gaps */
+  uint16_t          moves_len;      /* Largest move ID + 1 */
+  uint16_t          moves_cnt;
+  strmap_t          mons_by_name;   /* Base forms */
+  strmap_t          moves_by_name;
+};
+typedef struct gm_tables_s  gm_tables_t;
+
+void gm_tables_init( gm_tables_t * tables );
+/* Frees every record along with the tables. */
+void gm_tables_free( gm_tables_t * tables );
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Where a parsed Pokemon's move lists sit in `move_ids' */
+struct gm_move_span_s {
+  pdex_mon_t * mon;
+  uint32_t     offset;
+};
+typedef struct gm_move_span_s  gm_move_span_t;
+
 struct gm_parser_s {
   char               *  buffer;
   size_t                buffer_len;
@@ -76,14 +121,15 @@ struct gm_parser_s {
   gm_regexes_t          regs;
   jsmn_file_parser_t *  fparser;
   jsmnis_t              iter_stack;
-  store_move_t       *  moves_by_name;
-  store_move_t       *  moves_by_id;
-  pdex_mon_t         *  mons_by_name;
-  pdex_mon_t         *  mons_by_dex;
+  gm_tables_t           tables;
+  /* `move_ids' moves while it grows, lists are linked once it is done */
+  gm_move_span_t     *  spans;
+  uint32_t              spans_cnt;
+  uint32_t              spans_cap;
   pdex_mon_t         ** incomplete_mon;
   jsmntok_t          ** incomplete_fam;
-  uint8_t               incomplete_idx;
-  uint8_t               incomplete_size;
+  uint16_t              incomplete_idx;
+  uint16_t              incomplete_size;
 };
 typedef struct gm_parser_s  gm_parser_t;
 
@@ -117,10 +163,14 @@ uint16_t parse_pvp_charged_move( const char         *  json,
 uint16_t parse_gm_dex_num( const char * json, jsmntok_t * token );
 buff_t   parse_gm_buff( const char * json, jsmni_t * iter );
 stats_t  parse_gm_stats( const char * json, jsmnis_t * iter_stack );
+/**
+ * Names are interned in `tables->names', and move lists are appended to
+ * `tables->move_ids' with `mon->fast_move_ids' and `mon->charged_move_ids'
+ * left `NULL'; `add_mon_data' keeps or drops them.
+ */
 uint16_t parse_pdex_mon( const char   *  json,
                          jsmnis_t     *  iter_stack,
-                         store_move_t *  moves_by_name,
-                         pdex_mon_t   *  mons_by_name,
+                         gm_tables_t  *  tables,
                          jsmntok_t    ** incomplete_fam_tok,
                          pdex_mon_t   *  mon
                        );
@@ -130,6 +180,7 @@ uint16_t parse_pdex_mon( const char   *  json,
 
 /**
  * Write parsed data to store.
+ * `name' is interned, and may be freed by the caller afterwards.
  */
 void add_pvp_charged_move_data( gm_parser_t        * gm_parser,
                                 char               * name,
@@ -139,10 +190,10 @@ void add_pvp_fast_move_data( gm_parser_t     * gm_parser,
                              char            * name,
                              pvp_fast_move_t * move
                            );
-uint16_t lookup_move_id( store_move_t * moves, const char * name );
-uint16_t lookup_move_idn( store_move_t * moves,
-                          const char   * name,
-                          int16_t        n
+uint16_t lookup_move_id( const strmap_t * moves_by_name, const char * name );
+uint16_t lookup_move_idn( const strmap_t * moves_by_name,
+                          const char     * name,
+                          int16_t          n
                         );
 
 
@@ -156,8 +207,11 @@ uint16_t lookup_move_idn( store_move_t * moves,
  */
 bool add_mon_data( gm_parser_t * gm_parser, pdex_mon_t * mon );
 
-uint16_t lookup_dex( pdex_mon_t * mons, const char * name );
-uint16_t lookup_dexn( pdex_mon_t * mons, const char * name, size_t n );
+uint16_t lookup_dex( const strmap_t * mons_by_name, const char * name );
+uint16_t lookup_dexn( const strmap_t * mons_by_name,
+                      const char     * name,
+                      size_t           n
+                    );
 
 
 /* ------------------------------------------------------------------------- */
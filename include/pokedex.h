@@ -5,8 +5,6 @@
 
 /* ========================================================================== */
 
-#include "ext/uthash.h"
-#include "hash.h"
 #include "moves.h"
 #include "ptypes.h"
 #include "store.h"
@@ -108,9 +106,6 @@ struct pdex_mon_s {
   uint8_t             charged_moves_cnt;
   uint8_t             form_idx;
   struct pdex_mon_s * next_form;
-  /* For hash table */
-  UT_hash_handle      hh_name;
-  UT_hash_handle      hh_dex_num;
 };
 typedef struct pdex_mon_s  pdex_mon_t;
 
@@ -127,8 +122,7 @@ static const pdex_mon_t PDEX_NULL = {
   .charged_move_ids  = NULL,
   .charged_moves_cnt = 0,
   .form_idx          = 0,
-  .hh_name           = HH_NULL,
-  .hh_dex_num        = HH_NULL
+  .next_form         = NULL
 };
 
 
@@ -160,7 +154,7 @@ void pdex_mon_free( pdex_mon_t * mon );
 
 /**
  * This is the "store" key, it may change in different contexts.
- * For example the parser uses `UT_hash_handle' keys directly.
+ * For example the parser indexes Pokemon by Dex # and name directly.
  */
   static inline store_key_t
 pdex_store_key( pdex_mon_t * mon )
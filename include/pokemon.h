@@ -94,11 +94,24 @@ typedef enum { M_CHARGED1, M_CHARGED2, M_FAST } pmove_idx_t;
 struct roster_s {
   roster_pokemon_t * roster_pokemon;
   size_t             roster_length;
+  size_t             roster_capacity;  /* Allocated `roster_pokemon' */
+  base_pokemon_t   * roster_bases;     /* Owned by the roster, or `NULL' */
 };
 typedef struct roster_s  roster_t;
 
+/**
+ * Copies `mon' into the roster, growing it geometrically.
+ * The `base' pointer is copied as is, and is not owned by the roster.
+ * Returns `NULL' if the roster could not grow, leaving it unchanged.
+ */
 roster_t * roster_append( roster_t * roster, roster_pokemon_t * mon );
 
+/* Make room for at least `n' Pokemon in total, returns false on failure */
+bool roster_reserve( roster_t * roster, size_t n );
+
+/* Free `roster_pokemon' and `roster_bases', leaving an empty roster */
+void roster_free( roster_t * roster );
+
 
 /* ------------------------------------------------------------------------- */
 
@@ -141,6 +154,22 @@ void pvp_pokemon_init( pvp_pokemon_t    * mon,
                        store_t          * store
                      );
 
+/**
+ * Initialize `n' Pokemon at once, fetching moves in batches of
+ * `PVP_INIT_BATCH_SIZE' Pokemon with `store_get_many'.
+ * Unlike `pvp_pokemon_init' this returns an error code rather than asserting,
+ * and an unset second charged move is always cleared.
+ */
+#ifndef PVP_INIT_BATCH_SIZE
+#define PVP_INIT_BATCH_SIZE  256
+#endif
+
+int pvp_pokemon_init_many( pvp_pokemon_t    * mons,
+                           roster_pokemon_t * rmons,
+                           size_t             n,
+                           store_t          * store
+                         );
+
 
 /* ------------------------------------------------------------------------- */
 
@@ -175,6 +204,16 @@ const_fn uint16_t get_cp_from_stats( stats_t base, stats_t ivs, float level );
 const_fn stats_t  get_effective_stats( stats_t base, stats_t ivs, float level );
 const_fn uint16_t get_hp_from_stam_lv( uint16_t stam, float lv );
 
+/**
+ * Highest level, counting half levels, at which `base' with `ivs' is within
+ * `cp_cap', or 0 if even level 1 is over it.
+ * `pvp_pokemon_t' only holds whole levels, so battles truncate this, while
+ * IV ranks use it as is.
+ */
+const_fn float    get_max_level_for_cp( stats_t base, stats_t ivs,
+                                        uint16_t cp_cap
+                                      );
+
 uint16_t get_pvp_damage( pmove_idx_t     attack_idx,
                          pvp_pokemon_t * attacker,
                          pvp_pokemon_t * defender
@@ -0,0 +1,187 @@
+/* -*- mode: c; -*- */
+
+#ifndef _RANKING_H
+#define _RANKING_H
+
+/* ========================================================================= */
+
+#include "cupstore.h"
+#include "matchup.h"
+#include "moveset.h"
+#include "pokemon.h"
+#include "store.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Ranks every Pokemon eligible for a cup, in the style of PvPoke.
+ * <p>
+ * Each eligible species is raised to the highest level its IVs allow under
+ * the cup's CP cap, and entered once per moveset it can learn; with `prune'
+ * movesets that are dominated by another are skipped ( see `moveset.h' ).
+ * Every moveset ( the rows ) battles one representative moveset of every
+ * species ( the columns ) in each shield scenario, filling a
+ * `matchup_matrix_t'.
+ * <p>
+ * A row's score is its mean Battle Rating over the scenarios, each a mean
+ * over opponents weighted by how well those opponents themselves score, so
+ * beating strong Pokemon counts for more than beating weak ones.
+ * Scores and weights are iterated until no score moves by more than
+ * `epsilon'; every iteration reads the same matrix, so nothing is simulated
+ * twice.
+ * <p>
+ * A species is represented by its best moveset.
+ * Opponents start out with the first moveset their Pokedex entry lists, and
+ * once scores settle any species whose best moveset differs has its column
+ * simulated again with that moveset, and scores are iterated again; this is
+ * repeated at most `max_rounds' times.
+ * <p>
+ * See `rankstore.h' for keeping the results.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+struct ranking_opts_s {
+  stats_t           ivs;           /* Used by every Pokemon */
+  uint16_t          max_movesets;  /* Per species, 0 for all */
+  bool              prune;         /* Skip dominated movesets */
+  uint16_t          scenarios;     /* See `matchup_scenario_mask' */
+  uint32_t          max_iters;     /* Per round */
+  float             epsilon;       /* Largest change in a score to stop at */
+  float             exponent;      /* Opponent weight is `(score/best)^exp' */
+  uint8_t           max_rounds;    /* Opponent moveset updates */
+  uint32_t          nthreads;      /* 0 for one per core */
+  matchup_cache_t * cache;         /* `NULL' to simulate everything */
+};
+typedef struct ranking_opts_s  ranking_opts_t;
+
+#define RANKING_OPTS_DEFAULT                                                  \
+  {                                                                           \
+    .ivs          = { .attack = 15, .stamina = 15, .defense = 15 },           \
+    .max_movesets = 0,                                                        \
+    .prune        = true,                                                     \
+    .scenarios    = MATCHUP_STANDARD_SCENARIOS_M,                             \
+    .max_iters    = 64,                                                       \
+    .epsilon      = 0.01,                                                     \
+    .exponent     = 4.0,                                                      \
+    .max_rounds   = 2,                                                        \
+    .nthreads     = 0,                                                        \
+    .cache        = NULL                                                      \
+  }
+
+
+/* One species and moveset, a row of the matrix */
+struct ranking_entry_s {
+  uint16_t dex_number;
+  uint8_t  form_idx;
+  uint8_t  level;
+  uint16_t fast_move_id;
+  uint16_t charged_move_ids[2];  /* Second is 0 for one charged move */
+  uint32_t species;              /* Index into `species' */
+  float    score;                /* 0 - 1000 */
+  float    scenario_scores[MATCHUP_NSCENARIOS];  /* By matrix scenario idx */
+};
+typedef struct ranking_entry_s  ranking_entry_t;
+
+/* Entries of one species are contiguous */
+struct ranking_species_s {
+  uint32_t first;     /* Entries `first' to `first + nentries - 1' */
+  uint32_t nentries;
+  uint32_t best;      /* Entry with the highest score */
+  uint32_t opponent;  /* Entry in this species' matrix column */
+  uint32_t rank;      /* 0 is best */
+};
+typedef struct ranking_species_s  ranking_species_t;
+
+
+struct ranking_s {
+  stats_t             ivs;
+  uint16_t            cp_cap;
+  uint32_t            nentries;
+  ranking_entry_t   * entries;
+  uint32_t            nspecies;
+  ranking_species_t * species;
+  uint32_t          * order;     /* Species, best first */
+  matchup_matrix_t    matrix;    /* Entries by species */
+  uint32_t            iterations;
+  uint8_t             rounds;
+  bool                converged;
+};
+typedef struct ranking_s  ranking_t;
+
+#define RANKING_INIT                                                          \
+  {                                                                           \
+    .ivs        = { .attack = 0, .stamina = 0, .defense = 0 },                \
+    .cp_cap     = 0,                                                          \
+    .nentries   = 0,                                                          \
+    .entries    = NULL,                                                       \
+    .nspecies   = 0,                                                          \
+    .species    = NULL,                                                       \
+    .order      = NULL,                                                       \
+    .matrix     = MATCHUP_MATRIX_INIT,                                        \
+    .iterations = 0,                                                          \
+    .rounds     = 0,                                                          \
+    .converged  = false                                                       \
+  }
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Rank the Pokemon in `cup->pool', reading Pokedex and Move data from the
+ * store its index was built on.
+ * `opts' may be `NULL' for the defaults.
+ * Species that can't be brought under the CP cap, or that have no fast or
+ * charged moves, are left out.
+ * Returns `STORE_ERROR_NOT_FOUND' if no Pokemon are eligible.
+ */
+int  ranking_build( ranking_t            * ranking,
+                    const cup_t          * cup,
+                    const ranking_opts_t * opts
+                  );
+
+void ranking_free( ranking_t * ranking );
+
+/**
+ * Score every entry against the current matrix, with opponents weighted by
+ * `weights' ( per species, `NULL' for even ), writing each entry's score.
+ * This is one iteration of `ranking_build', exposed for re-weighting a built
+ * ranking without simulating anything, for example by a meta's usage.
+ */
+int  ranking_score( ranking_t   * ranking,
+                    const float * weights,
+                    uint32_t      nthreads
+                  );
+
+/**
+ * Write the matrix as a matrix file ( see `matchup_file.h' ), its rows
+ * naming every entry and its columns the opponent moveset of each species.
+ */
+int  ranking_save_matrix( const ranking_t * ranking,
+                          uint64_t          data_version,
+                          const char      * fpath
+                        );
+
+/* The best entry of the species ranked `rank' */
+  static inline const ranking_entry_t *
+ranking_get_rank( const ranking_t * ranking, uint32_t rank )
+{
+  if ( ranking->nspecies <= rank ) return NULL;
+  return ranking->entries + ranking->species[ranking->order[rank]].best;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* ranking.h */
+
+/* vim: set filetype=c : */
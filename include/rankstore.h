@@ -0,0 +1,192 @@
+/* -*- mode: c; -*- */
+
+#ifndef _RANKSTORE_H
+#define _RANKSTORE_H
+
+/* ========================================================================= */
+
+#include "matchup.h"
+#include "pokemon.h"
+#include "ranking.h"
+#include "store.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A "Ranking" store holds the ranked Pokemon of one format, as produced by
+ * `ranking_build' or imported from elsewhere.
+ * <p>
+ * Each species is a `STORE_PVP_POKEMON_RANKING' keyed by Dex # and form with
+ * `mon_rank_store_key', holding its score and its movesets best first.
+ * Movesets may also be fetched on their own as `STORE_PVP_MOVE_RANKING' with
+ * `moveset_rank_store_key'.
+ * <p>
+ * Species are ranked in the order they are added, so `add' them best first;
+ * `rankstore_get_rank' fetches by rank and `each' visits in rank order.
+ * Values are copied into the store, and stay valid until the store is
+ * modified or freed.
+ * This store is not `SF_THREAD_SAFE'.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Movesets beyond this many per species are dropped */
+#define RANKSTORE_MAX_MOVESETS  UINT8_MAX
+
+struct pvp_moveset_rank_s {
+  uint16_t fast_move_id;
+  uint16_t charged_move_ids[2];  /* Second is 0 for one charged move */
+  float    score;
+};
+typedef struct pvp_moveset_rank_s  pvp_moveset_rank_t;
+
+struct pvp_mon_rank_s {
+  uint16_t             dex_number;
+  uint8_t              form_idx;
+  uint8_t              level;
+  stats_t              ivs;
+  uint32_t             rank;       /* Set by the store, 0 is best */
+  float                score;      /* 0 - 1000 */
+  uint16_t             scenarios;  /* Mask of scenarios with scores */
+  float                scenario_scores[MATCHUP_NSCENARIOS];  /* By scenario */
+  uint8_t              nmovesets;
+  pvp_moveset_rank_t * movesets;   /* Best first */
+};
+typedef struct pvp_mon_rank_s  pvp_mon_rank_t;
+
+
+struct rankstore_aux_s {
+  pvp_mon_rank_t * mons;    /* By rank */
+  uint32_t       * by_key;  /* Ranks, sorted by Dex # and form */
+  uint32_t         cnt;
+  uint32_t         cap;
+};
+typedef struct rankstore_aux_s  rankstore_aux_t;
+
+#define as_rksa( STORE_PTR )  ( (rankstore_aux_t *) ( STORE_PTR )->aux )
+
+typedef store_t  rankstore_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline store_key_t
+mon_rank_store_key( uint16_t dex_num, uint8_t form_idx )
+{
+  return (store_key_t) {
+    .key_type = STORE_NUM,
+    .val_type = STORE_PVP_POKEMON_RANKING,
+    .data_h0  = dex_num,
+    .data_q2  = form_idx,
+    .data_q3  = 0
+  };
+}
+
+/* The `moveset_idx'th best moveset of a species */
+  static inline store_key_t
+moveset_rank_store_key( uint16_t dex_num,
+                        uint8_t  form_idx,
+                        uint8_t  moveset_idx
+                      )
+{
+  return (store_key_t) {
+    .key_type = STORE_NUM,
+    .val_type = STORE_PVP_MOVE_RANKING,
+    .data_h0  = dex_num,
+    .data_q2  = form_idx,
+    .data_q3  = moveset_idx
+  };
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+bool rankstore_has( store_t * rankstore, store_key_t key );
+int  rankstore_get( store_t * rankstore, store_key_t key, void ** val );
+int  rankstore_each( store_t       * rankstore,
+                     store_type_t    val_type,
+                     store_each_cb   cb,
+                     void          * ctx
+                   );
+/**
+ * `val' is a `pvp_mon_rank_t' for the species in `key', which is ranked
+ * below every species already in the store.
+ * Adding a species twice is `STORE_ERROR_BAD_VALUE'.
+ */
+int  rankstore_add( store_t * rankstore, store_key_t key, void * val );
+/* Replace a species' value, keeping its rank. */
+int  rankstore_set( store_t * rankstore, store_key_t key, void * val );
+/* `unused' should be `NULL' */
+int  rankstore_init( store_t * rankstore, void * unused );
+void rankstore_free( store_t * rankstore );
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Add every species of `ranking', best first, each with all of its movesets
+ * ( up to `RANKSTORE_MAX_MOVESETS' ).
+ */
+int rankstore_add_ranking( rankstore_t * rankstore, const ranking_t * ranking );
+
+/* Fetch the species ranked `rank' */
+int rankstore_get_rank( rankstore_t     *  rankstore,
+                        uint32_t           rank,
+                        pvp_mon_rank_t  ** val
+                      );
+
+  static inline uint32_t
+rankstore_count( rankstore_t * rankstore )
+{
+  return as_rksa( rankstore )->cnt;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline int
+rankstore_export( store_t      * rankstore,
+                  store_sink_t   sink_type,
+                  void         * target
+                )
+{
+  return STORE_ERROR_NOT_DEFINED;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+#define def_rankstore()                                                       \
+  {                                                                           \
+    .name      = "Ranking",                                                   \
+    .flags     = SF_WRITABLE_M | SF_CUSTOM_DATA_M | SF_STANDARD_KEY_M |       \
+                 SF_TYPED_M,                                                  \
+    .has       = rankstore_has,                                               \
+    .get       = rankstore_get,                                               \
+    .get_many  = store_get_many_generic,                                      \
+    .each      = rankstore_each,                                              \
+    .get_str   = NULL,                                                        \
+    .get_str_t = NULL,                                                        \
+    .add       = rankstore_add,                                               \
+    .set       = rankstore_set,                                               \
+    .export    = rankstore_export,                                            \
+    .init      = rankstore_init,                                              \
+    .free      = rankstore_free,                                              \
+    .aux       = NULL                                                         \
+  }
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* rankstore.h */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,149 @@
+/* -*- mode: c; -*- */
+
+#ifndef _REPLICATOR_H
+#define _REPLICATOR_H
+
+/* ========================================================================= */
+
+#include "matchup.h"
+#include "store.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * How a meta shifts over a season, by replicator dynamics on a matchup
+ * matrix: each generation a species' usage grows in proportion to how well
+ * it does against the current meta.
+ * <p>
+ * The payoff of species `i' against species `j' is the mean Battle Rating,
+ * scaled to 0 - 1, of `i's row against column `j' over the chosen scenarios;
+ * a species' fitness is its expected payoff against the meta's usage.
+ * Each generation
+ *   usage[i] *= ( 1 - rate ) + rate * fitness[i] / mean_fitness
+ * where `rate = 1' is the classic discrete map, and smaller rates take
+ * smaller, steadier steps.
+ * Nothing is simulated: matrices come from `matchup_matrix_build', a ranking,
+ * or a matrix file read with `matchup_file_read_matrix'.
+ * <p>
+ * Usage that falls under `extinct' is set to 0, and since a species with no
+ * usage never comes back, its row and column are dropped.
+ * The payoffs of the species still in play are kept packed together, so each
+ * generation is a dense product over just them, split into tiles of rows
+ * for the threads and of columns to stay in cache.
+ * <p>
+ * Usage is checkpointed every `checkpoint_every' generations, and the whole
+ * run can be saved and later resumed with `replicator_load'.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Rows each thread claims at once, and columns summed at once */
+#define REPLICATOR_TILE_ROWS  64
+#define REPLICATOR_TILE_COLS  512
+
+struct replicator_opts_s {
+  uint16_t scenarios;         /* See `matchup_scenario_mask' */
+  float    rate;              /* 0 - 1 */
+  float    extinct;           /* Usage under this is dropped */
+  float    tolerance;         /* Converged once usage moves no more, in L1 */
+  uint32_t checkpoint_every;  /* 0 for no checkpoints */
+  uint32_t nthreads;          /* 0 for one per core */
+};
+typedef struct replicator_opts_s  replicator_opts_t;
+
+#define REPLICATOR_OPTS_DEFAULT                                               \
+  {                                                                           \
+    .scenarios        = MATCHUP_STANDARD_SCENARIOS_M,                         \
+    .rate             = 1.0,                                                  \
+    .extinct          = 1e-6,                                                 \
+    .tolerance        = 1e-6,                                                 \
+    .checkpoint_every = 1,                                                    \
+    .nthreads         = 0                                                     \
+  }
+
+struct replicator_s {
+  replicator_opts_t   opts;
+  uint32_t            n;
+  float             * payoff;       /* `n' by `n' */
+  float             * usage;        /* Per species, sums to 1 */
+  float             * fitness;      /* Against the last generation's usage */
+  uint32_t            generation;
+  bool                converged;
+  /* Species still in play, and their payoffs packed together */
+  uint32_t            nactive;
+  uint32_t          * active;
+  float             * dense;        /* `nactive' by `nactive' */
+  float             * scratch;      /* Packed usage and fitness */
+  /* Usage at each checkpoint */
+  uint32_t            ncheckpoints;
+  uint32_t            checkpoint_cap;
+  uint32_t          * checkpoint_gens;
+  float             * checkpoints;  /* `ncheckpoints' by `n' */
+};
+typedef struct replicator_s  replicator_t;
+
+#define REPLICATOR_INIT                                                       \
+  {                                                                           \
+    .opts = REPLICATOR_OPTS_DEFAULT, .n = 0, .payoff = NULL, .usage = NULL,   \
+    .fitness = NULL, .generation = 0, .converged = false, .nactive = 0,       \
+    .active = NULL, .dense = NULL, .scratch = NULL, .ncheckpoints = 0,        \
+    .checkpoint_cap = 0, .checkpoint_gens = NULL, .checkpoints = NULL         \
+  }
+
+/* Usage at checkpoint `I' */
+#define replicator_checkpoint( REP, I )                                       \
+  ( (const float *) ( ( REP )->checkpoints + (size_t) ( I ) * ( REP )->n ) )
+
+
+/**
+ * Start at generation 0 from `usage' ( per species, `NULL' for even ).
+ * Species are the columns of `matrix'; `rows' gives the row playing each of
+ * them, for example a ranking's best entry per species, or is `NULL' when
+ * row `i' plays column `i'.
+ * `opts' may be `NULL' for the defaults.
+ * Returns `STORE_ERROR_BAD_VALUE' if no chosen scenario was built, `rows' is
+ * `NULL' for a matrix that isn't square, or `usage' has nothing positive.
+ */
+int  replicator_init( replicator_t            * rep,
+                      const matchup_matrix_t  * matrix,
+                      const uint32_t          * rows,
+                      const float             * usage,
+                      const replicator_opts_t * opts
+                    );
+
+void replicator_free( replicator_t * rep );
+
+/**
+ * Evolve for `ngenerations', stopping early once converged.
+ * Returns the generations run, or -1 if memory ran out.
+ */
+int  replicator_run( replicator_t * rep, uint32_t ngenerations );
+
+/**
+ * Save the current generation, usage, and checkpoints to `fpath'.
+ * Load them into a `rep' made by `replicator_init' on the same matrix to
+ * pick up where the saved run left off.
+ */
+int  replicator_save( const replicator_t * rep, const char * fpath );
+
+/**
+ * Returns `STORE_ERROR_NOT_FOUND' if there is no such file, or
+ * `STORE_ERROR_BAD_VALUE' if it isn't a save of this many species.
+ */
+int  replicator_load( replicator_t * rep, const char * fpath );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* replicator.h */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,245 @@
+/* -*- mode: c; -*- */
+
+#ifndef _ROSTERSTORE_H
+#define _ROSTERSTORE_H
+
+/* ========================================================================= */
+
+#include "pokedex.h"
+#include "pokemon.h"
+#include "store.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A "Roster" store holds a player's Pokemon collection, imported from
+ * CalcyIV or Pokebattler exports.
+ * <p>
+ * Rows are held as parallel arrays ( columns ) rather than as
+ * `roster_pokemon_t's, which is both smaller and faster to scan; roster wide
+ * queries such as `rosterstore_query_iv_rank' never build a
+ * `roster_pokemon_t' at all.
+ * Species, Family, and Move indices are built on first use, and rebuilt after
+ * rows are added or changed.
+ * <p>
+ * `get' returns a `roster_pokemon_t', which is built the first time its row
+ * is requested and stays valid until the store is modified or freed.
+ * Rows are keyed by their index with `roster_row_store_key'.
+ * <p>
+ * Pokedex and Move data come from another store, which must outlive the
+ * roster.
+ * This store is not `SF_THREAD_SAFE'.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A "Compressed Sparse Row" index from a key ( Dex #, Family, or Move ID ) to
+ * the rows which have it.
+ * Rows for `keys[i]' are `rows[offsets[i]]' to `rows[offsets[i + 1] - 1]'.
+ */
+struct roster_index_s {
+  uint32_t   nkeys;
+  uint16_t * keys;     /* Sorted */
+  uint32_t * offsets;  /* `nkeys + 1' long */
+  uint32_t * rows;
+};
+typedef struct roster_index_s  roster_index_t;
+
+
+struct rosterstore_aux_s {
+  store_t          * base;
+  uint32_t           cnt;
+  uint32_t           cap;
+  /* Columns */
+  uint16_t         * dex;
+  uint8_t          * form;
+  uint8_t          * lvi;       /* ( Level - 1 ) * 2 */
+  uint16_t         * ivs;       /* Attack, Defense, Stamina as 4 bit nibbles */
+  uint16_t         * fast;
+  uint16_t         * charged1;
+  uint16_t         * charged2;  /* 0 if none */
+  /* Indices */
+  bool               indexed;
+  roster_index_t     by_species;
+  roster_index_t     by_family;
+  roster_index_t     by_move;
+  /* Rows built by `get', and a bitmap of which are current */
+  roster_pokemon_t * rows;
+  base_pokemon_t   * bases;
+  uint64_t         * built;
+};
+typedef struct rosterstore_aux_s  rosterstore_aux_t;
+
+#define as_rsa( STORE_PTR )  ( (rosterstore_aux_t *) ( STORE_PTR )->aux )
+
+typedef store_t  rosterstore_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline store_key_t
+roster_row_store_key( uint32_t row )
+{
+  store_key_t key = {
+    .key_type = STORE_NUM,
+    .val_type = STORE_ROSTER,
+    .data_f   = row
+  };
+  return key;
+}
+
+#define rosterstore_ivs_pack( IVS )                                           \
+  ( (uint16_t) ( ( ( IVS ).attack << 8 ) | ( ( IVS ).defense << 4 ) |         \
+                 ( IVS ).stamina ) )
+
+  static inline stats_t
+rosterstore_ivs_unpack( uint16_t packed_ivs )
+{
+  stats_t ivs = {
+    .attack  = ( packed_ivs >> 8 ) & 0xf,
+    .stamina = packed_ivs & 0xf,
+    .defense = ( packed_ivs >> 4 ) & 0xf
+  };
+  return ivs;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+bool rosterstore_has( store_t * rosterstore, store_key_t key );
+int  rosterstore_get( store_t * rosterstore, store_key_t key, void ** val );
+int  rosterstore_each( store_t       * rosterstore,
+                       store_type_t    val_type,
+                       store_each_cb   cb,
+                       void          * ctx
+                     );
+/* `key' must be the next row, `roster_row_store_key( cnt )' */
+int  rosterstore_add( store_t * rosterstore, store_key_t key, void * val );
+int  rosterstore_set( store_t * rosterstore, store_key_t key, void * val );
+/* `base' is the `store_t' providing Pokedex and Move data */
+int  rosterstore_init( store_t * rosterstore, void * base );
+void rosterstore_free( store_t * rosterstore );
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Append every Pokemon in `roster', the roster is not modified. */
+int rosterstore_add_roster( rosterstore_t * rosterstore, roster_t * roster );
+
+int rosterstore_import_calcy( rosterstore_t * rosterstore, const char * fpath );
+int rosterstore_import_pokebattler( rosterstore_t * rosterstore,
+                                    const char    * fpath
+                                  );
+
+  static inline uint32_t
+rosterstore_count( rosterstore_t * rosterstore )
+{
+  return as_rsa( rosterstore )->cnt;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Find the rows of a species ( any form ), family, or which know a move.
+ * `rows' points into the index and is valid until the store is modified.
+ * Returns `STORE_ERROR_NOT_FOUND' if there are no such rows.
+ */
+int rosterstore_rows_by_species( rosterstore_t   *  rosterstore,
+                                 uint16_t           dex_num,
+                                 const uint32_t  ** rows,
+                                 uint32_t        *  nrows
+                               );
+
+int rosterstore_rows_by_family( rosterstore_t   *  rosterstore,
+                                uint16_t           family,
+                                const uint32_t  ** rows,
+                                uint32_t        *  nrows
+                              );
+
+int rosterstore_rows_by_move( rosterstore_t   *  rosterstore,
+                              uint16_t           move_id,
+                              const uint32_t  ** rows,
+                              uint32_t        *  nrows
+                            );
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Rank every IV combination of `mon' by stat product at the highest level
+ * that fits under `cp_cap', as is usual for PvP.
+ * `ranks' is indexed by `rosterstore_ivs_pack' and must hold 4096 entries;
+ * the best IVs are rank 1, and IVs that can't fit under the cap rank 0.
+ */
+void rank_ivs_stat_product( const pdex_mon_t * mon,
+                            uint16_t           cp_cap,
+                            uint16_t         * ranks
+                          );
+
+/**
+ * Write the rows whose IVs rank at most `max_rank' for `cp_cap' to `rows',
+ * for example every Pokemon in the bag which is rank 100 or better for
+ * `GREAT_LEAGUE'.
+ * Rows are written in order, up to `nrows' of them.
+ * Returns the total number of matching rows, which may exceed `nrows'.
+ * <p>
+ * Each species' ranks are computed once per query.
+ */
+uint32_t rosterstore_query_iv_rank( rosterstore_t * rosterstore,
+                                    uint16_t        cp_cap,
+                                    uint16_t        max_rank,
+                                    uint32_t      * rows,
+                                    uint32_t        nrows
+                                  );
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline int
+rosterstore_export( store_t      * rosterstore,
+                    store_sink_t   sink_type,
+                    void         * target
+                  )
+{
+  return STORE_ERROR_NOT_DEFINED;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+#define def_rosterstore()                                                     \
+  {                                                                           \
+    .name      = "Roster",                                                    \
+    .flags     = SF_WRITABLE_M | SF_CUSTOM_DATA_M | SF_STANDARD_KEY_M |       \
+                 SF_TYPED_M,                                                  \
+    .has       = rosterstore_has,                                             \
+    .get       = rosterstore_get,                                             \
+    .get_many  = store_get_many_generic,                                      \
+    .each      = rosterstore_each,                                            \
+    .get_str   = NULL,                                                        \
+    .get_str_t = NULL,                                                        \
+    .add       = rosterstore_add,                                             \
+    .set       = rosterstore_set,                                             \
+    .export    = rosterstore_export,                                          \
+    .init      = rosterstore_init,                                            \
+    .free      = rosterstore_free,                                            \
+    .aux       = NULL                                                         \
+  }
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* rosterstore.h */
+
+/* vim: set filetype=c : */
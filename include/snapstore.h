@@ -0,0 +1,347 @@
+/* -*- mode: c; -*- */
+
+#ifndef _SNAPSTORE_H
+#define _SNAPSTORE_H
+
+/* ========================================================================= */
+
+#include "store.h"
+#include "pokedex.h"
+#include "moves.h"
+#include "ptypes.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A "Snapshot" store is backed by a single binary file which is `mmap'ed
+ * when the store is initialized.
+ * This lets us update Pokedex/Move data without recompiling `cstore_data.c',
+ * and because the file is mapped read-only, any number of processes share
+ * the same pages through the page cache.
+ * <p>
+ * The file is laid out as a fixed header followed by sections, every section
+ * starts on an 8 byte boundary and is addressed by an offset relative to the
+ * start of the file:
+ *   - Pokedex records ( fixed size, all forms, grouped by dex number ).
+ *   - Move records ( fixed size ).
+ *   - Move ID pool, an `int16_t' array referenced by Pokedex records.
+ *   - String pool, NULL terminated strings referenced by offset.
+ *   - Open addressing hash indices for dex/form, move ID, and names.
+ * <p>
+ * Data is written in host byte order, `byte_order' guards against loading
+ * a snapshot produced on a machine with different endianness.
+ */
+
+#define SNAPSTORE_MAGIC       "CPKSNAP"
+#define SNAPSTORE_VERSION     1
+#define SNAPSTORE_BYTE_ORDER  0x01020304
+
+/* Hash index slots hold `record index + 1', so `0' marks an empty slot */
+#define SNAPSTORE_EMPTY_SLOT  0
+
+
+/* ------------------------------------------------------------------------- */
+
+struct snap_header_s {
+  char     magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t size;               /* Total size of the file in bytes */
+  uint32_t mons_cnt;           /* Includes all forms */
+  uint32_t mons_off;
+  uint32_t moves_cnt;
+  uint32_t moves_off;
+  uint32_t move_ids_cnt;
+  uint32_t move_ids_off;
+  uint32_t strings_size;
+  uint32_t strings_off;
+  uint32_t mon_idx_cap;        /* Power of 2, shared by both Pokedex indices */
+  uint32_t mon_key_idx_off;
+  uint32_t mon_name_idx_off;
+  uint32_t move_idx_cap;       /* Power of 2, shared by both Move indices */
+  uint32_t move_key_idx_off;
+  uint32_t move_name_idx_off;
+};
+typedef struct snap_header_s  snap_header_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Offsets for strings are relative to `strings_off', and offsets for move
+ * lists are indices into the move ID pool.
+ * `next_form' is the record index of the next form + 1, or `0' if there are
+ * no more forms.
+ */
+struct snap_mon_s {
+  uint32_t name;
+  uint32_t form_name;
+  uint32_t fast_move_ids;
+  uint32_t charged_move_ids;
+  uint32_t types;
+  uint32_t next_form;
+  uint16_t dex_number;
+  uint16_t family;
+  uint16_t attack;
+  uint16_t stamina;
+  uint16_t defense;
+  uint16_t tags;
+  uint8_t  fast_moves_cnt;
+  uint8_t  charged_moves_cnt;
+  uint8_t  form_idx;
+  uint8_t  _pad;
+};
+typedef struct snap_mon_s  snap_mon_t;
+
+_Static_assert( sizeof( snap_mon_t ) == 40, "snap_mon_t must be 40 bytes" );
+
+
+struct snap_move_s {
+  uint32_t name;
+  uint16_t move_id;
+  uint16_t cooldown;
+  uint8_t  type;
+  uint8_t  is_fast;
+  uint8_t  pve_power;
+  uint8_t  pvp_power;
+  uint8_t  pve_energy;
+  uint8_t  pvp_energy;
+  uint8_t  buff_chance;
+  uint8_t  buff_atk;     /* `stat_buff_t' bits */
+  uint8_t  buff_def;     /* `stat_buff_t' bits */
+  uint8_t  _pad[3];
+};
+typedef struct snap_move_s  snap_move_t;
+
+_Static_assert( sizeof( snap_move_t ) == 20, "snap_move_t must be 20 bytes" );
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A single mapped snapshot file.
+ * Lookups probe the indices and compare keys against `mon_recs' and
+ * `move_recs' in place, opening a snapshot reads nothing but the header.
+ * <p>
+ * Store values are `pdex_mon_t' and `store_move_t', which hold pointers, so
+ * a record is resolved into one the first time it is returned.
+ * Its strings and move lists still point into the mapping, only the small
+ * struct itself lives on the heap, in `mons' or `moves' at the record's
+ * index, and it stays there until the snapshot is closed.
+ * Untouched records cost a `NULL' slot and nothing else.
+ */
+struct snapstore_snap_s {
+  uint32_t                   mons_cnt;
+  uint32_t                   moves_cnt;
+  void                     * map;
+  size_t                     map_size;
+  const snap_header_t      * header;
+  const snap_mon_t         * mon_recs;
+  const snap_move_t        * move_recs;
+  pdex_mon_t   * _Atomic   * mons;   /* Resolved records, by record index */
+  store_move_t * _Atomic   * moves;  /* Resolved records, by record index */
+  struct snapstore_snap_s  * retired_next;
+};
+typedef struct snapstore_snap_s  snapstore_snap_t;
+
+
+/**
+ * Readers load `snap' once per lookup and never lock.
+ * `snapstore_reload' maps a new file and publishes it with a single atomic
+ * pointer swap, RCU style, so a reader sees either the old snapshot or the
+ * new one, never a mix.
+ * <p>
+ * Readers may still hold pointers into a replaced snapshot, so it is kept on
+ * `retired' until `snapstore_reclaim' or `snapstore_free'.
+ */
+struct snapstore_aux_s {
+  snapstore_snap_t * _Atomic   snap;
+  snapstore_snap_t           * retired;
+  pthread_mutex_t              lock;     /* Serializes writers */
+};
+typedef struct snapstore_aux_s  snapstore_aux_t;
+
+#define as_ssa( STORE_PTR )  ( (snapstore_aux_t *) ( STORE_PTR )->aux )
+
+  static inline snapstore_snap_t *
+snapstore_snap( store_t * snapstore )
+{
+  return atomic_load_explicit( & as_ssa( snapstore )->snap,
+                               memory_order_acquire
+                             );
+}
+
+typedef store_t  snapstore_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+bool snapstore_has( store_t * snapstore, store_key_t key );
+int  snapstore_get( store_t * snapstore, store_key_t key, void ** val );
+int  snapstore_each( store_t       * snapstore,
+                     store_type_t    val_type,
+                     store_each_cb   cb,
+                     void          * ctx
+                   );
+int  snapstore_get_str( store_t * snapstore, const char *, void ** val );
+int  snapstore_get_str_t( store_t      *  snapstore,
+                          store_type_t    val_type,
+                          const char   *  key,
+                          void         ** val
+                        );
+/* `fpath' is the path to a snapshot file */
+int  snapstore_init( store_t * snapstore, void * fpath );
+void snapstore_free( store_t * snapstore );
+
+/**
+ * Map the snapshot at `fpath' and replace the current one with it.
+ * This is safe to call while other threads are reading from the store.
+ * On success the store's `store_version' is bumped, on failure the current
+ * snapshot is left in place.
+ */
+int  snapstore_reload( store_t * snapstore, const char * fpath );
+
+/**
+ * Unmap snapshots replaced by `snapstore_reload'.
+ * Only call this once no reader can be holding a value fetched before the
+ * most recent reload.
+ */
+void snapstore_reclaim( store_t * snapstore );
+
+
+/* ------------------------------------------------------------------------- */
+
+int snapstore_get_pokemon( snapstore_t *  snapstore,
+                           uint16_t       dex_num,
+                           uint8_t        form_idx,
+                           pdex_mon_t  ** mon
+                         );
+
+int snapstore_get_pokemon_by_name( snapstore_t *  snapstore,
+                                   const char  *  name,
+                                   pdex_mon_t  ** mon
+                                 );
+
+
+/* ------------------------------------------------------------------------- */
+
+int snapstore_get_move( snapstore_t  *  snapstore,
+                        uint16_t        move_id,
+                        store_move_t ** move
+                      );
+
+int snapstore_get_move_by_name( snapstore_t  *  snapstore,
+                                const char   *  name,
+                                store_move_t ** move
+                              );
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Write a snapshot file from arrays of Pokedex and Move data.
+ * `mons' should only hold "base" forms ( `form_idx == 0' ), other forms are
+ * collected by following `next_form'.
+ * <p>
+ * This is used by other stores to implement the `SS_SNAPSHOT' sink.
+ */
+int snapstore_write( FILE          *  ostream,
+                     pdex_mon_t   **  mons,
+                     uint32_t         mons_cnt,
+                     store_move_t **  moves,
+                     uint32_t         moves_cnt
+                   );
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline int
+snapstore_export( store_t      * snapstore,
+                  store_sink_t   sink_type,
+                  void         * target
+                )
+{
+  return STORE_ERROR_NOT_DEFINED;
+}
+
+  static inline int
+snapstore_add( store_t * snapstore, store_key_t key, void * val )
+{
+  return STORE_ERROR_NOT_WRITABLE;
+}
+
+  static inline int
+snapstore_set( store_t * snapstore, store_key_t key, void * val )
+{
+  return STORE_ERROR_NOT_WRITABLE;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+#define def_snapstore()                                                       \
+  {                                                                           \
+    .name      = "Game Master Snapshot",                                      \
+    .flags     = SF_THREAD_SAFE_M | SF_OFFICIAL_DATA_M | SF_STANDARD_KEY_M |  \
+                 SF_TYPED_M | SF_GET_STRING_M | SF_GET_TYPED_STRING_M,        \
+    .has       = snapstore_has,                                               \
+    .get       = snapstore_get,                                               \
+    .get_many  = store_get_many_generic,                                      \
+    .each      = snapstore_each,                                              \
+    .get_str   = snapstore_get_str,                                           \
+    .get_str_t = snapstore_get_str_t,                                         \
+    .add       = snapstore_add,                                               \
+    .set       = snapstore_set,                                               \
+    .export    = snapstore_export,                                            \
+    .init      = snapstore_init,                                              \
+    .free      = snapstore_free,                                              \
+    .aux       = NULL                                                         \
+  }
+
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef SNAPSTORE_GLOBAL_STORE
+
+static store_t SNAPSTORE = def_snapstore();
+
+#define SNAP_has( KEY )       snapstore_has( & SNAPSTORE, ( KEY ) )
+#define SNAP_get( KEY, VAL )                                                  \
+  snapstore_get( & SNAPSTORE, ( KEY ), (void **) ( VAL ) )
+#define SNAP_get_str( KEY, VAL )                                              \
+  snapstore_get_str( & SNAPSTORE, ( KEY ), (void **) ( VAL ) )
+#define SNAP_get_str_t( TYPE, KEY, VAL )                                      \
+  snapstore_get_str_t( & SNAPSTORE, ( TYPE ), ( KEY ), (void **) ( VAL ) )
+#define SNAP_init( FPATH )    snapstore_init( & SNAPSTORE, (void *) ( FPATH ) )
+#define SNAP_free()           snapstore_free( & SNAPSTORE )
+#define SNAP_reload( FPATH )  snapstore_reload( & SNAPSTORE, ( FPATH ) )
+
+#define SNAP_get_pokemon( DEX, FORM, VAL )                                    \
+  snapstore_get_pokemon( & SNAPSTORE, ( DEX ), ( FORM ), ( VAL ) )
+#define SNAP_get_pokemon_by_name( NAME, VAL )                                 \
+  snapstore_get_pokemon_by_name( & SNAPSTORE, ( NAME ), ( VAL ) )
+
+#define SNAP_get_move( MOVE_IDX, VAL )                                        \
+  snapstore_get_move( & SNAPSTORE, ( MOVE_IDX ), ( VAL ) )
+#define SNAP_get_move_by_name( NAME, VAL )                                    \
+  snapstore_get_move_by_name( & SNAPSTORE, ( NAME ), ( VAL ) )
+
+#endif
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* snapstore.h */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,225 @@
+/* -*- mode: c; -*- */
+
+#ifndef _SQLSTORE_H
+#define _SQLSTORE_H
+
+/* ========================================================================= */
+
+#include "ext/uthash.h"
+#include "store.h"
+#include "pokedex.h"
+#include "moves.h"
+#include "ptypes.h"
+#include <sqlite3.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A store backed by a SQLite database.
+ * <p>
+ * The Pokedex and Moves are kept in three tables: `pokedex' is keyed by
+ * dex number and form index, `moves' by move ID, and `pokedex_moves' holds
+ * one row per learnable move ( negative IDs are legacy, same as
+ * `pdex_mon_t' ).
+ * These tables live alongside anything else in the database, so they may be
+ * added to `data/poketables.db' and queried together with its PvPoke tables.
+ * <p>
+ * Statements are prepared the first time they are used and are reused for
+ * the life of the store.
+ * Decoded `pdex_mon_t' and `store_move_t' values are held in an LRU cache of
+ * `lru_cap' entries, so repeated lookups never touch SQLite.
+ * <p>
+ * NOTE: A pointer returned by `get' is owned by the cache, and is only valid
+ *       until its entry is evicted, which happens after `lru_cap' other
+ *       values have been loaded.
+ *       Nothing is evicted during a `get_many', so all of its values are
+ *       valid when it returns, however many there are; the cache shrinks
+ *       back to `lru_cap' when the next value is loaded.
+ *       Values are decoded one row at a time so `next_form' is always
+ *       `NULL', fetch other forms by key instead.
+ *       Lookups update the cache, so this store is not `SF_THREAD_SAFE'.
+ */
+
+#ifndef SQLSTORE_LRU_CAP
+#define SQLSTORE_LRU_CAP     1024
+#endif
+
+
+/* ------------------------------------------------------------------------- */
+
+typedef enum {
+  SQLS_GET_MON,
+  SQLS_GET_MON_MOVES,
+  SQLS_GET_MON_BY_NAME,
+  SQLS_GET_MOVE,
+  SQLS_GET_MOVE_BY_NAME,
+  SQLS_EACH_MON,
+  SQLS_EACH_MOVE,
+  SQLS_STMT_CNT
+} sqlstore_stmt_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Strings and move lists are allocated in the same block as the entry.
+ */
+struct sqlstore_entry_s {
+  uint32_t         key;
+  union {
+    pdex_mon_t     mon;
+    store_move_t   move;
+  };
+  UT_hash_handle   hh;
+};
+typedef struct sqlstore_entry_s  sqlstore_entry_t;
+
+
+struct sqlstore_aux_s {
+  sqlite3          * db;
+  sqlite3_stmt     * stmts[SQLS_STMT_CNT];
+  sqlstore_entry_t * lru;      /* Least recently used first */
+  uint32_t           lru_cap;
+  bool               pinned;   /* Eviction is held off during `get_many' */
+  uint32_t           hits;
+  uint32_t           misses;
+};
+typedef struct sqlstore_aux_s  sqlstore_aux_t;
+
+#define as_sqla( STORE_PTR )  ( (sqlstore_aux_t *) ( STORE_PTR )->aux )
+
+typedef store_t  sqlstore_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+bool sqlstore_has( store_t * sqlstore, store_key_t key );
+int  sqlstore_get( store_t * sqlstore, store_key_t key, void ** val );
+int  sqlstore_get_many( store_t           *  sqlstore,
+                        const store_key_t *  keys,
+                        size_t               n,
+                        void              ** vals,
+                        int               *  status
+                      );
+int  sqlstore_each( store_t       * sqlstore,
+                    store_type_t    val_type,
+                    store_each_cb   cb,
+                    void          * ctx
+                  );
+int  sqlstore_get_str( store_t * sqlstore, const char *, void ** val );
+int  sqlstore_get_str_t( store_t      *  sqlstore,
+                         store_type_t    val_type,
+                         const char   *  key,
+                         void         ** val
+                       );
+/* `db_path' is the path to a SQLite database */
+int  sqlstore_init( store_t * sqlstore, void * db_path );
+void sqlstore_free( store_t * sqlstore );
+
+
+/* ------------------------------------------------------------------------- */
+
+int sqlstore_get_pokemon( sqlstore_t  *  sqlstore,
+                          uint16_t       dex_num,
+                          uint8_t        form_idx,
+                          pdex_mon_t  ** mon
+                        );
+
+int sqlstore_get_pokemon_by_name( sqlstore_t  *  sqlstore,
+                                  const char  *  name,
+                                  pdex_mon_t  ** mon
+                                );
+
+
+/* ------------------------------------------------------------------------- */
+
+int sqlstore_get_move( sqlstore_t   *  sqlstore,
+                       uint16_t        move_id,
+                       store_move_t ** move
+                     );
+
+int sqlstore_get_move_by_name( sqlstore_t   *  sqlstore,
+                               const char   *  name,
+                               store_move_t ** move
+                             );
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Write Pokedex and Move data to the database at `db_path', creating the
+ * tables if they do not exist, and replacing any rows they already hold.
+ * This is done in a single transaction, so if the write fails the old rows
+ * are left as they were.
+ * `mons' should only hold "base" forms, other forms are collected by
+ * following `next_form'.
+ * <p>
+ * This is used by other stores to implement the `SS_SQL' sink.
+ */
+int sqlstore_write( const char    *  db_path,
+                    pdex_mon_t   **  mons,
+                    uint32_t         mons_cnt,
+                    store_move_t **  moves,
+                    uint32_t         moves_cnt
+                  );
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline int
+sqlstore_export( store_t      * sqlstore,
+                 store_sink_t   sink_type,
+                 void         * target
+               )
+{
+  return STORE_ERROR_NOT_DEFINED;
+}
+
+  static inline int
+sqlstore_add( store_t * sqlstore, store_key_t key, void * val )
+{
+  return STORE_ERROR_NOT_WRITABLE;
+}
+
+  static inline int
+sqlstore_set( store_t * sqlstore, store_key_t key, void * val )
+{
+  return STORE_ERROR_NOT_WRITABLE;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+#define def_sqlstore()                                                        \
+  {                                                                           \
+    .name      = "SQLite",                                                    \
+    .flags     = SF_STANDARD_KEY_M | SF_TYPED_M | SF_GET_STRING_M |           \
+                 SF_GET_TYPED_STRING_M,                                       \
+    .has       = sqlstore_has,                                                \
+    .get       = sqlstore_get,                                                \
+    .get_many  = sqlstore_get_many,                                           \
+    .each      = sqlstore_each,                                               \
+    .get_str   = sqlstore_get_str,                                            \
+    .get_str_t = sqlstore_get_str_t,                                          \
+    .add       = sqlstore_add,                                                \
+    .set       = sqlstore_set,                                                \
+    .export    = sqlstore_export,                                             \
+    .init      = sqlstore_init,                                               \
+    .free      = sqlstore_free,                                               \
+    .aux       = NULL                                                         \
+  }
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* sqlstore.h */
+
+/* vim: set filetype=c : */
@@ -8,6 +8,7 @@
 #include "util/bits.h"
 #include "util/enumflags.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* ------------------------------------------------------------------------- */
@@ -52,6 +53,17 @@ typedef enum {
 
 /* ------------------------------------------------------------------------- */
 
+/**
+ * `SF_THREAD_SAFE' means that the "read" members ( `has', `get', `get_many',
+ * `get_str', and `get_str_t' ) may be called from any number of threads at
+ * once without locking, and that values they return stay valid until the
+ * store is freed.
+ * `init' and `free' must still be called by one thread while no readers are
+ * running.
+ * Writable stores with this flag must publish changes by swapping in a new
+ * version of their data rather than modifying it in place, so readers never
+ * see a half written value.
+ */
 DEFINE_ENUM_WITH_FLAGS( store_flag,
     SF_NONE, SF_WRITABLE, SF_THREAD_SAFE, SF_OFFICIAL_DATA, SF_CUSTOM_DATA,
     SF_EXPORTABLE, SF_STANDARD_KEY, SF_TYPED, SF_GET_STRING,
@@ -86,11 +98,11 @@ _Static_assert( sizeof( store_type_t ) == 1, "store_type_t must be 1 byte" );
 /* ------------------------------------------------------------------------- */
 
 typedef enum {
-  SS_UNKNOWN, SS_C, SS_JSON, SS_SQL
+  SS_UNKNOWN, SS_C, SS_JSON, SS_SQL, SS_SNAPSHOT
 } store_sink_t;
 
 static const char * STORE_SINK_NAMES[] = {
-  "SS_UNKNOWN", "SS_C", "SS_JSON", "SS_SQL"
+  "SS_UNKNOWN", "SS_C", "SS_JSON", "SS_SQL", "SS_SNAPSHOT"
 };
 
 
@@ -136,6 +148,20 @@ typedef int  ( * store_add_fn )( struct store_s *, store_key_t, void * );
 typedef int  ( * store_set_fn )( struct store_s *, store_key_t, void * );
 /* For `SF_EXPORTABLE' */
 typedef int ( * store_export_fn )( struct store_s *, store_sink_t, void * );
+/* Optional, see `store_get_many' */
+typedef int  ( * store_get_many_fn )( struct store_s *,
+                                      const store_key_t *,
+                                      size_t,
+                                      void **,
+                                      int *
+                                    );
+/* Optional, see `store_each' */
+typedef int  ( * store_each_cb )( void *, store_key_t, void * );
+typedef int  ( * store_each_fn )( struct store_s *,
+                                  store_type_t,
+                                  store_each_cb,
+                                  void *
+                                );
 
 
 /* ------------------------------------------------------------------------- */
@@ -145,6 +171,8 @@ struct store_s {
   store_flag_mask_t   flags;
   store_has_fn        has;
   store_get_fn        get;
+  store_get_many_fn   get_many;
+  store_each_fn       each;
   store_get_str_fn    get_str;
   store_get_str_t_fn  get_str_t;
   store_add_fn        add;
@@ -153,11 +181,94 @@ struct store_s {
   store_init_fn       init;
   store_free_fn       free;
   void              * aux;
+  uint32_t            version;  /* See `store_version' */
 };
 
 typedef struct store_s  store_t;
 
 
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Fetch the values for `n' keys, writing them to `vals'.
+ * If `status' is not `NULL' the result of each lookup is written to it.
+ * Returns `STORE_SUCCESS' if every lookup succeeded, otherwise the status of
+ * the first lookup that failed; later keys are still fetched.
+ * <p>
+ * This is just a loop over `get', for stores that don't have anything
+ * smarter to offer.
+ */
+  static inline int
+store_get_many_generic( store_t           *  store,
+                        const store_key_t *  keys,
+                        size_t               n,
+                        void              ** vals,
+                        int               *  status
+                      )
+{
+  int rsl = STORE_SUCCESS;
+  for ( size_t i = 0; i < n; i++ )
+    {
+      int s = store->get( store, keys[i], vals + i );
+      if ( status != NULL ) status[i] = s;
+      if ( ( s != STORE_SUCCESS ) && ( rsl == STORE_SUCCESS ) ) rsl = s;
+    }
+  return rsl;
+}
+
+/* Uses the store's `get_many' if it has one, or falls back to a loop. */
+  static inline int
+store_get_many( store_t           *  store,
+                const store_key_t *  keys,
+                size_t               n,
+                void              ** vals,
+                int               *  status
+              )
+{
+  if ( store->get_many != NULL )
+    return store->get_many( store, keys, n, vals, status );
+  return store_get_many_generic( store, keys, n, vals, status );
+}
+
+
+/**
+ * Call `cb( ctx, key, val )' for every value of type `val_type' in a store,
+ * for example every form of every Pokemon for `STORE_POKEDEX'.
+ * Iteration stops early if `cb' returns anything other than `STORE_SUCCESS',
+ * and that status is returned.
+ * <p>
+ * Stores that can't enumerate their values leave `each' as `NULL'.
+ */
+  static inline int
+store_each( store_t       * store,
+            store_type_t    val_type,
+            store_each_cb   cb,
+            void          * ctx
+          )
+{
+  if ( store->each == NULL ) return STORE_ERROR_NOT_DEFINED;
+  return store->each( store, val_type, cb, ctx );
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Stores bump their version whenever their contents change, through a
+ * successful `add' or `set', or a reload such as `snapstore_reload', so
+ * anything derived from a store ( indices, cached query results ) can tell
+ * when it has gone stale by saving the version it was built from.
+ * Only stores whose contents never change stay at version 0.
+ */
+  static inline uint32_t
+store_version( const store_t * store )
+{
+  return store->version;
+}
+
+#define store_touch( STORE_PTR )  ( (void) ( ( STORE_PTR )->version++ ) )
+
+
 /* ------------------------------------------------------------------------- */
 
 
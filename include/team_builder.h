@@ -0,0 +1,131 @@
+/* -*- mode: c; -*- */
+
+#ifndef _TEAM_BUILDER_H
+#define _TEAM_BUILDER_H
+
+/* ========================================================================= */
+
+#include "ai/ai.h"
+#include "matchup.h"
+#include "pokemon.h"
+#include "store.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Picks the best 3 Pokemon from a roster against a meta.
+ * <p>
+ * Teams are scored on a `matchup_matrix_t' with the roster as rows and the
+ * meta as columns: against each meta Pokemon, in each scenario, a team is
+ * as good as its best answer, and a team's score is the weighted mean of
+ * those best answers.
+ * <p>
+ * Every 3 member team is considered, but most are never scored.
+ * Rows are searched strongest first, and the best any team could do with
+ * the members chosen so far is bounded by taking the best remaining answer
+ * to every column; once that bound falls below the k-th best team found,
+ * the whole branch is skipped.
+ * Workers share the best k-th score any of them has seen, so a strong team
+ * found by one thread prunes the others.
+ * <p>
+ * Each of the `k' best teams is then ordered into roles:
+ *   Lead       - Plays the opening, with shields up.
+ *   Safe Swap  - Covers the meta Pokemon that beat the lead.
+ *   Closer     - Plays the end game, with shields down.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+struct team_builder_opts_s {
+  uint32_t          k;                /* Teams to return */
+  const float     * weights;          /* Per meta Pokemon, `NULL' for even */
+  uint8_t           lead_scenario;    /* See `matchup_scenario' */
+  uint8_t           swap_scenario;
+  uint8_t           closer_scenario;
+  uint32_t          nthreads;         /* 0 for one per core */
+  matchup_cache_t * cache;            /* For `team_builder_select_team' */
+};
+typedef struct team_builder_opts_s  team_builder_opts_t;
+
+#define TEAM_BUILDER_OPTS_DEFAULT                                             \
+  {                                                                           \
+    .k               = 1,                                                     \
+    .weights         = NULL,                                                  \
+    .lead_scenario   = matchup_scenario( 2, 2 ),                              \
+    .swap_scenario   = matchup_scenario( 1, 1 ),                              \
+    .closer_scenario = matchup_scenario( 0, 0 ),                              \
+    .nthreads        = 0,                                                     \
+    .cache           = NULL                                                   \
+  }
+
+
+/* Roles index `members' */
+typedef enum { TEAM_LEAD, TEAM_SWAP, TEAM_CLOSER } team_role_t;
+
+struct team_pick_s {
+  uint32_t members[3];    /* Matrix rows, by `team_role_t' */
+  float    score;         /* Mean best answer, 0 - 1000 */
+  float    role_scores[3];
+};
+typedef struct team_pick_s  team_pick_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Fill `teams' with the `opts->k' best teams, best first, and set `nteams'
+ * to how many were found ( fewer if the roster is small ).
+ * Teams with equal scores are ordered by their rows, so results don't
+ * depend on the number of threads.
+ * `opts' may be `NULL' for the defaults.
+ * Rosters of fewer than 3 are `STORE_ERROR_BAD_VALUE'.
+ */
+int team_builder_search( const matchup_matrix_t    * matrix,
+                         const team_builder_opts_t * opts,
+                         team_pick_t               * teams,
+                         uint32_t                  * nteams
+                       );
+
+/**
+ * Order `members' into roles, filling `pick'.
+ * This is done for every team `team_builder_search' returns, it is exposed
+ * for ordering teams picked by other means.
+ */
+void team_builder_assign_roles( const matchup_matrix_t    * matrix,
+                                const team_builder_opts_t * opts,
+                                const uint32_t              members[3],
+                                team_pick_t               * pick
+                              );
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A `select_team_fn' which picks the best team from `our_roster' against
+ * `their_roster', with the lead in `team[0]'.
+ * `aux' may point to a `team_builder_opts_t'.
+ * With fewer than 3 Pokemon on either side this falls back to taking the
+ * first 3, like `naive_ai_select_team'.
+ */
+ai_status_t team_builder_select_team( roster_t      * our_roster,
+                                      roster_t      * their_roster,
+                                      pvp_pokemon_t * team,
+                                      store_t       * store,
+                                      void          * aux
+                                    );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* team_builder.h */
+
+/* vim: set filetype=c : */
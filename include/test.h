@@ -15,6 +15,25 @@ bool test_battle( void );
 bool test_naive_ai( void );
 bool test_filter( void );
 bool test_fuzzy( void );
+bool test_snapstore( void );
+bool test_sqlstore( void );
+bool test_overlay_store( void );
+bool test_name_index( void );
+bool test_parse_csv( void );
+bool test_rosterstore( void );
+bool test_filter_index( void );
+bool test_cupstore( void );
+bool test_dense_index( void );
+bool test_team_builder( void );
+bool test_ranking( void );
+bool test_moveset( void );
+bool test_matchup_cache( void );
+bool test_matchup_file( void );
+bool test_counter( void );
+bool test_coverage( void );
+bool test_nash( void );
+bool test_replicator( void );
+bool test_ladder( void );
 bool test_all( void );
 
 
@@ -0,0 +1,88 @@
+/* -*- mode: c; -*- */
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+/* ========================================================================= */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A bump allocator for records that all live and die together.
+ * <p>
+ * Allocations are carved from large blocks, so filling a table of small
+ * records costs a handful of `malloc' calls, and tearing it down costs one
+ * `free' per block rather than a walk over every record.
+ * Individual allocations can't be freed, except for the most recent one
+ * ( see `arena_pop' ).
+ * <p>
+ * Define `ARENA_USE_MALLOC' to give every allocation its own `malloc' call
+ * instead, so tools like Valgrind and ASan can see each record's bounds.
+ * This is the default for `-fsanitize=address' builds.
+ */
+
+#if defined( __SANITIZE_ADDRESS__ ) && ( ! defined( ARENA_USE_MALLOC ) )
+#  define ARENA_USE_MALLOC
+#endif
+
+/* Allocations larger than this get a block to themselves */
+#define ARENA_BLOCK_SIZE  65536
+
+
+/* ------------------------------------------------------------------------- */
+
+struct arena_block_s {
+  struct arena_block_s * next;
+  size_t                 used;
+  size_t                 cap;
+  max_align_t            data[];
+};
+typedef struct arena_block_s  arena_block_t;
+
+
+struct arena_s {
+  arena_block_t * blocks;   /* Newest first */
+  size_t          last;     /* Offset of the newest allocation in `blocks' */
+  size_t          bytes;    /* Total handed out, after alignment */
+};
+typedef struct arena_s  arena_t;
+
+#define ARENA_INIT  { .blocks = NULL, .last = 0, .bytes = 0 }
+
+
+/* ------------------------------------------------------------------------- */
+
+void arena_init( arena_t * arena );
+/* Releases every allocation at once. */
+void arena_free( arena_t * arena );
+
+/**
+ * Returns `size' bytes aligned for any type, or `NULL' on failure.
+ * Memory is NOT zeroed, use `arena_calloc' for that.
+ */
+void * arena_alloc( arena_t * arena, size_t size );
+void * arena_calloc( arena_t * arena, size_t size );
+
+/**
+ * Give back `ptr' if it is the newest allocation, so a record that turns out
+ * to be unwanted right after it was built doesn't waste space.
+ * Returns false ( and does nothing ) for any other pointer.
+ */
+bool arena_pop( arena_t * arena, void * ptr );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* arena.h */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,205 @@
+/* -*- mode: c; -*- */
+
+#ifndef _BITSET_H
+#define _BITSET_H
+
+/* ========================================================================= */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Fixed size bitsets held as arrays of 64 bit words.
+ * <p>
+ * Sets are plain `uint64_t' arrays so they can be carved out of a single
+ * block, and every operation takes the number of words explicitly.
+ * Bits past the end of a set are always kept clear, so counts and iteration
+ * never need a final mask; `bitset_not' is the only operation that could set
+ * them and it takes `nbits' for that reason.
+ * <p>
+ * Binary operations write to `dst', which may alias either argument.
+ */
+
+#define BITSET_WORD_BITS  64
+
+#define bitset_nwords( NBITS )                                                \
+  ( ( (size_t) ( NBITS ) + BITSET_WORD_BITS - 1 ) / BITSET_WORD_BITS )
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Returns a cleared set, or `NULL'. */
+  static inline uint64_t *
+bitset_alloc( size_t nbits )
+{
+  return (uint64_t *) calloc( bitset_nwords( nbits ) + ( nbits == 0 ),
+                              sizeof( uint64_t )
+                            );
+}
+
+
+  static inline void
+bitset_set( uint64_t * set, size_t bit )
+{
+  set[bit / BITSET_WORD_BITS] |= ( (uint64_t) 1 ) << ( bit % BITSET_WORD_BITS );
+}
+
+
+  static inline void
+bitset_clear( uint64_t * set, size_t bit )
+{
+  set[bit / BITSET_WORD_BITS] &=
+    ~ ( ( (uint64_t) 1 ) << ( bit % BITSET_WORD_BITS ) );
+}
+
+
+  static inline bool
+bitset_test( const uint64_t * set, size_t bit )
+{
+  return !! ( set[bit / BITSET_WORD_BITS] &
+              ( ( (uint64_t) 1 ) << ( bit % BITSET_WORD_BITS ) ) );
+}
+
+
+  static inline void
+bitset_zero( uint64_t * set, size_t nwords )
+{
+  memset( set, 0, sizeof( uint64_t ) * nwords );
+}
+
+
+  static inline void
+bitset_copy( uint64_t * dst, const uint64_t * src, size_t nwords )
+{
+  memcpy( dst, src, sizeof( uint64_t ) * nwords );
+}
+
+
+/* Set bits `0' to `nbits - 1', clearing the rest of the last word. */
+  static inline void
+bitset_fill( uint64_t * set, size_t nbits )
+{
+  size_t nwords = bitset_nwords( nbits );
+  memset( set, 0xff, sizeof( uint64_t ) * nwords );
+  if ( ( nbits % BITSET_WORD_BITS ) != 0 )
+    {
+      set[nwords - 1] = ( ( (uint64_t) 1 ) << ( nbits % BITSET_WORD_BITS ) ) -
+                        1;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline void
+bitset_and( uint64_t       * dst,
+            const uint64_t * a,
+            const uint64_t * b,
+            size_t           nwords
+          )
+{
+  for ( size_t i = 0; i < nwords; i++ ) dst[i] = a[i] & b[i];
+}
+
+
+  static inline void
+bitset_or( uint64_t       * dst,
+           const uint64_t * a,
+           const uint64_t * b,
+           size_t           nwords
+         )
+{
+  for ( size_t i = 0; i < nwords; i++ ) dst[i] = a[i] | b[i];
+}
+
+
+/* `a & ~b' */
+  static inline void
+bitset_andnot( uint64_t       * dst,
+               const uint64_t * a,
+               const uint64_t * b,
+               size_t           nwords
+             )
+{
+  for ( size_t i = 0; i < nwords; i++ ) dst[i] = a[i] & ~ b[i];
+}
+
+
+  static inline void
+bitset_not( uint64_t * dst, const uint64_t * a, size_t nbits )
+{
+  size_t nwords = bitset_nwords( nbits );
+  for ( size_t i = 0; i < nwords; i++ ) dst[i] = ~ a[i];
+  if ( ( nbits % BITSET_WORD_BITS ) != 0 )
+    {
+      dst[nwords - 1] &= ( ( (uint64_t) 1 ) << ( nbits % BITSET_WORD_BITS ) ) -
+                         1;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline size_t
+bitset_count( const uint64_t * set, size_t nwords )
+{
+  size_t cnt = 0;
+  for ( size_t i = 0; i < nwords; i++ ) cnt += __builtin_popcountll( set[i] );
+  return cnt;
+}
+
+
+  static inline bool
+bitset_empty( const uint64_t * set, size_t nwords )
+{
+  for ( size_t i = 0; i < nwords; i++ ) if ( set[i] != 0 ) return false;
+  return true;
+}
+
+
+/**
+ * Returns the first set bit at or after `from', or `SIZE_MAX' if there are
+ * none.
+ */
+  static inline size_t
+bitset_next( const uint64_t * set, size_t nwords, size_t from )
+{
+  size_t i = from / BITSET_WORD_BITS;
+  if ( nwords <= i ) return SIZE_MAX;
+
+  uint64_t word = set[i] & ( ~ (uint64_t) 0 << ( from % BITSET_WORD_BITS ) );
+  while ( word == 0 )
+    {
+      if ( ++i == nwords ) return SIZE_MAX;
+      word = set[i];
+    }
+  return ( i * BITSET_WORD_BITS ) + __builtin_ctzll( word );
+}
+
+
+/**
+ * Loop over the set bits of `SET' in increasing order, with `BIT' declared as
+ * a `size_t' holding the current bit.
+ * Ex: bitset_foreach( bit, matches, nwords ) { printf( "%zu\n", bit ); }
+ */
+#define bitset_foreach( BIT, SET, NWORDS )                                    \
+  for ( size_t BIT = bitset_next( ( SET ), ( NWORDS ), 0 );                   \
+        BIT != SIZE_MAX;                                                      \
+        BIT = bitset_next( ( SET ), ( NWORDS ), BIT + 1 )                     \
+      )
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* bitset.h */
+
+/* vim: set filetype=c : */
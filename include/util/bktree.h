@@ -0,0 +1,98 @@
+/* -*- mode: c; -*- */
+
+#ifndef _BKTREE_H
+#define _BKTREE_H
+
+/* ========================================================================= */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A Burkhard-Keller tree over Levenshtein Distance, for finding the strings
+ * nearest to a ( possibly misspelled ) query without scoring all of them.
+ * <p>
+ * Every child hangs off its parent by its distance to the parent, so by the
+ * triangle inequality a search within `r' of the query only needs to visit
+ * children whose edge is within `r' of the parent's distance to the query.
+ * Nodes live in a single array, children are linked by index.
+ * <p>
+ * Keys are copied, `data' is just carried along for the caller.
+ */
+
+/* Longer keys are rejected, this keeps edges in a byte */
+#define BKTREE_MAX_KEY_LEN  255
+
+
+/* ------------------------------------------------------------------------- */
+
+struct bktree_node_s {
+  char     * key;
+  void     * data;
+  uint32_t   child;      /* Index of first child, 0 for none */
+  uint32_t   sibling;    /* Index of next sibling, 0 for none */
+  uint8_t    len;
+  uint8_t    edge;       /* Distance to parent */
+  uint8_t    max_edge;   /* Largest `edge' of any child */
+};
+typedef struct bktree_node_s  bktree_node_t;
+
+
+struct bktree_s {
+  bktree_node_t * nodes;   /* `nodes[0]' is the root */
+  uint32_t        cnt;
+  uint32_t        cap;
+};
+typedef struct bktree_s  bktree_t;
+
+#define BKTREE_INIT  { .nodes = NULL, .cnt = 0, .cap = 0 }
+
+
+struct bktree_match_s {
+  const char * key;
+  void       * data;
+  int          dist;
+};
+typedef struct bktree_match_s  bktree_match_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+void bktree_init( bktree_t * tree );
+void bktree_free( bktree_t * tree );
+
+/**
+ * Returns 0 on success, 1 if the key was already in the tree ( the existing
+ * `data' is kept ), or -1 on failure.
+ */
+int bktree_insert( bktree_t * tree, const char * key, void * data );
+
+/**
+ * Find up to `nmatches' keys within `max_dist' of `query', nearest first.
+ * Ties are kept in the order they were found.
+ * Returns the number of matches written to `matches'.
+ * <p>
+ * Once `matches' is full the search radius shrinks to the worst match found
+ * so far, so asking for a single match is the fastest query.
+ */
+size_t bktree_find( const bktree_t       * tree,
+                    const char           * query,
+                    int                    max_dist,
+                    bktree_match_t       * matches,
+                    size_t                 nmatches
+                  );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* bktree.h */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,188 @@
+/* -*- mode: c; -*- */
+
+#ifndef _CSV_H
+#define _CSV_H
+
+/* ========================================================================= */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Helpers for slicing CSV lines in place.
+ * Fields point into the input, so nothing is copied until a value is
+ * actually needed.
+ */
+
+/* A slice of the input, which is not NUL terminated. */
+struct csv_field_s {
+  const char * str;
+  size_t       len;
+};
+typedef struct csv_field_s  csv_field_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Slice `line' on `delim' into `fields', stopping at `end' or a newline.
+ * Quoted fields may contain delimiters, their quotes are stripped but `""'
+ * escapes are left as is.
+ * Returns the number of fields found, which may be more than `nfields'.
+ */
+  static size_t
+csv_split( const char  * line,
+           const char  * end,
+           char          delim,
+           csv_field_t * fields,
+           size_t        nfields
+         )
+{
+  size_t       n     = 0;
+  const char * start = line;
+  bool         quote = false;
+  const char * c     = line;
+
+  for ( ; ( c < end ) && ( quote || ( *c != '\n' ) ); c++ )
+    {
+      if ( *c == '"' )
+        {
+          quote = ! quote;
+        }
+      else if ( ( *c == delim ) && ( ! quote ) )
+        {
+          if ( n < nfields ) fields[n] = (csv_field_t) { start, c - start };
+          n++;
+          start = c + 1;
+        }
+    }
+
+  /* Drop the '\r' of "\r\n" line endings */
+  if ( ( start < c ) && ( c[-1] == '\r' ) ) c--;
+  if ( n < nfields ) fields[n] = (csv_field_t) { start, c - start };
+  n++;
+
+  for ( size_t i = 0; i < n && i < nfields; i++ )
+    {
+      if ( ( 2 <= fields[i].len ) && ( fields[i].str[0] == '"' ) &&
+           ( fields[i].str[fields[i].len - 1] == '"' )
+         )
+        {
+          fields[i].str++;
+          fields[i].len -= 2;
+        }
+    }
+
+  return n;
+}
+
+
+/* Returns the start of the line after `line', or `end'. */
+  static inline const char *
+csv_next_line( const char * line, const char * end )
+{
+  const char * eol = (const char *) memchr( line, '\n', end - line );
+  return ( eol == NULL ) ? end : eol + 1;
+}
+
+
+  static inline bool
+csv_line_blank( const char * line, const char * end )
+{
+  for ( ; ( line < end ) && ( *line != '\n' ); line++ )
+    {
+      if ( ( *line != ' ' ) && ( *line != '\r' ) && ( *line != '\t' ) )
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+
+/* Upper bound on the number of records, for sizing allocations. */
+  static inline size_t
+csv_count_lines( const char * buffer, size_t len )
+{
+  const char * end = buffer + len;
+  size_t       n   = 1;
+  for ( const char * c = buffer;
+        ( c = (const char *) memchr( c, '\n', end - c ) ) != NULL;
+        c++
+      ) n++;
+  return n;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+  static inline bool
+csv_field_eq( csv_field_t field, const char * str )
+{
+  return ( strlen( str ) == field.len ) &&
+         ( memcmp( field.str, str, field.len ) == 0 );
+}
+
+
+  static inline bool
+csv_parse_uint( csv_field_t field, uint32_t * out )
+{
+  uint32_t val = 0;
+  if ( ( field.len == 0 ) || ( 9 < field.len ) ) return false;
+  for ( size_t i = 0; i < field.len; i++ )
+    {
+      if ( ( field.str[i] < '0' ) || ( '9' < field.str[i] ) ) return false;
+      val = ( val * 10 ) + ( field.str[i] - '0' );
+    }
+  *out = val;
+  return true;
+}
+
+
+/**
+ * Copy `field' to `buffer' and NUL terminate it.
+ * Fails if it doesn't fit in `size' bytes.
+ */
+  static inline bool
+csv_copy( csv_field_t field, char * buffer, size_t size )
+{
+  if ( size <= field.len ) return false;
+  memcpy( buffer, field.str, field.len );
+  buffer[field.len] = '\0';
+  return true;
+}
+
+
+/**
+ * Parse a decimal number, accepting either '.' or ',' as the decimal mark
+ * since some locales export "25,5".
+ */
+  static inline bool
+csv_parse_float( csv_field_t field, float * out )
+{
+  char   buffer[32];
+  char * end = NULL;
+  if ( ( field.len == 0 ) || ! csv_copy( field, buffer, sizeof( buffer ) ) )
+    {
+      return false;
+    }
+  for ( char * c = buffer; *c != '\0'; c++ ) if ( *c == ',' ) *c = '.';
+  *out = strtof( buffer, & end );
+  return *end == '\0';
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* csv.h */
+
+/* vim: set filetype=c : */
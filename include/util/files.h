@@ -6,6 +6,7 @@
 /* ========================================================================= */
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 
@@ -15,6 +16,18 @@ bool   file_exists( const char * fpath );
 long   file_size( const char * fpath );
 size_t fread_malloc( const char * fpath, char ** buffer );
 
+/* Writes a file's contents, returning a `store_status_t' */
+typedef int ( * fwrite_cb_t )( FILE * ostream, const void * ctx );
+
+/**
+ * Writes `fpath' with `writer' by way of a temporary file beside it, which is
+ * only renamed into place once `writer' and `fclose' succeed.
+ * On failure the temporary is removed and `fpath' is left as it was.
+ * Returns the `store_status_t' from `writer', or `STORE_ERROR_FAIL' if the
+ * temporary can't be opened, closed, or renamed.
+ */
+int fwrite_atomic( const char * fpath, fwrite_cb_t writer, const void * ctx );
+
 
 /* ------------------------------------------------------------------------- */
 
@@ -6,66 +6,327 @@
 /* ========================================================================= */
 
 #include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <limits.h>
 
 
 /* ------------------------------------------------------------------------- */
 
+/* Strings up to this length are scored without allocating */
+#ifndef FUZZY_STACK_LEN
+#define FUZZY_STACK_LEN  128
+#endif
+
 /**
- * Find the Levenshtein Distance between two string.
- * Results are cached.
+ * Levenshtein Distance between `s' and `t' with the usual two row DP, giving
+ * up once the distance is known to be greater than `max'.
+ * Returns the distance, or `max + 1' if it exceeds `max'.
+ * <p>
+ * Prefer `levenshtein_bounded', this is only used for strings too long for
+ * `lev_pattern_t'.
  */
   static int
-levenshtein( const char * s, const char * t )
+levenshtein_dp( const char * s,
+                size_t       slen,
+                const char * t,
+                size_t       tlen,
+                int          max
+              )
 {
   assert( s != NULL );
   assert( t != NULL );
+  assert( 0 <= max );
 
-	size_t slen = strlen( s );
-  size_t tlen = strlen( t );
-	int dist[slen + 1][tlen + 1];
+  int   buf[2 * FUZZY_STACK_LEN + 2];
+  int * prev = buf;
+  int * curr = NULL;
+  int   rsl  = max + 1;
+
+  if ( (size_t) max < ( ( slen < tlen ) ? tlen - slen : slen - tlen ) )
+    {
+      return max + 1;
+    }
+
+  if ( FUZZY_STACK_LEN < tlen )
+    {
+      prev = (int *) malloc( sizeof( int ) * 2 * ( tlen + 1 ) );
+      if ( prev == NULL ) return max + 1;
+    }
+  curr = prev + tlen + 1;
+
+  for ( size_t j = 0; j <= tlen; j++ ) prev[j] = (int) j;
 
-	for ( size_t i = 0; i <= slen; i++ )
+  for ( size_t i = 1; i <= slen; i++ )
     {
-      for ( size_t j = 0; j <= tlen; j++ )
+      int row_min = curr[0] = (int) i;
+      for ( size_t j = 1; j <= tlen; j++ )
         {
-          dist[i][j] = -1;
+          int x = prev[j - 1] + ( s[i - 1] != t[j - 1] );
+          if ( prev[j] + 1 < x )     x = prev[j] + 1;
+          if ( curr[j - 1] + 1 < x ) x = curr[j - 1] + 1;
+          curr[j] = x;
+          if ( x < row_min ) row_min = x;
         }
+      if ( max < row_min ) goto done;
+      int * tmp = prev;
+      prev = curr;
+      curr = tmp;
     }
+  rsl = ( prev[tlen] <= max ) ? prev[tlen] : max + 1;
 
-	int
- distance( size_t i, size_t j )
-  {
-		if ( 0 <= dist[i][j] ) return dist[i][j];
-
-		int x = -1;
-		if ( i == slen )
-      {
-        x = tlen - j;
-      }
-		else if ( j == tlen )
-      {
-        x = slen - i;
-      }
-		else if ( s[i] == t[j] )
-      {
-        x = distance( i + 1, j + 1 );
-      }
-		else
-      {
-        x = distance( i + 1, j + 1 );
-
-        int y = -1;
-        if ( ( y = distance( i, j + 1 ) ) < x ) x = y;
-        if ( ( y = distance( i + 1, j ) ) < x ) x = y;
-        x++;
-      }
-		return dist[i][j] = x;
-	}
-
-	return distance( 0, 0 );
+done:
+  if ( FUZZY_STACK_LEN < tlen ) free( ( prev < curr ) ? prev : curr );
+  return rsl;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Myers' bit-parallel Levenshtein Distance ( in Hyyro's formulation ).
+ * A column of the DP table is held as bit-vectors of +1/-1 vertical deltas,
+ * so each character of the text costs a handful of word operations rather
+ * than a row of cells.
+ * <p>
+ * The pattern must fit in a machine word, which covers every Pokemon and
+ * Move name.
+ * Build a pattern once and score it against as many strings as you like.
+ */
+#define LEV_PATTERN_MAX_LEN  64
+
+struct lev_pattern_s {
+  uint64_t peq[256];  /* Bit `i' of `peq[c]' is set if `pattern[i] == c' */
+  size_t   len;
+};
+typedef struct lev_pattern_s  lev_pattern_t;
+
+
+/* Returns false if `pattern' is longer than `LEV_PATTERN_MAX_LEN'. */
+  static bool
+lev_pattern_init( lev_pattern_t * pat, const char * pattern, size_t len )
+{
+  assert( pat != NULL );
+  assert( pattern != NULL );
+  if ( LEV_PATTERN_MAX_LEN < len ) return false;
+  memset( pat->peq, 0, sizeof( pat->peq ) );
+  for ( size_t i = 0; i < len; i++ )
+    {
+      pat->peq[(unsigned char) pattern[i]] |= ( (uint64_t) 1 ) << i;
+    }
+  pat->len = len;
+  return true;
+}
+
+
+/**
+ * Distance from the pattern to `t', or `max + 1' if it exceeds `max'.
+ * Each column can only lower the distance by one, so we stop as soon as the
+ * remaining text can't bring it back within `max'.
+ */
+  static int
+lev_pattern_dist( const lev_pattern_t * pat,
+                  const char          * t,
+                  size_t                tlen,
+                  int                   max
+                )
+{
+  assert( pat != NULL );
+  assert( t != NULL );
+  assert( 0 <= max );
+
+  size_t m = pat->len;
+  if ( (size_t) max < ( ( m < tlen ) ? tlen - m : m - tlen ) ) return max + 1;
+  if ( m == 0 ) return (int) tlen;
+
+  uint64_t pv    = ~( (uint64_t) 0 );
+  uint64_t mv    = 0;
+  uint64_t hb    = ( (uint64_t) 1 ) << ( m - 1 );
+  int      score = (int) m;
+
+  for ( size_t j = 0; j < tlen; j++ )
+    {
+      uint64_t eq = pat->peq[(unsigned char) t[j]];
+      uint64_t xv = eq | mv;
+      uint64_t xh = ( ( ( eq & pv ) + pv ) ^ pv ) | eq;
+      uint64_t ph = mv | ~( xh | pv );
+      uint64_t mh = pv & xh;
+      score += ( ( ph & hb ) != 0 ) - ( ( mh & hb ) != 0 );
+      if ( max < score - (int) ( tlen - j - 1 ) ) return max + 1;
+      ph = ( ph << 1 ) | 1;
+      mh <<= 1;
+      pv = mh | ~( xv | ph );
+      mv = ph & xv;
+    }
+
+  return ( score <= max ) ? score : max + 1;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Candidates scored per pass of `lev_pattern_dist_many' */
+#define LEV_LANES  4
+
+typedef uint64_t  lev_vu64_t __attribute__(( vector_size( 8 * LEV_LANES ) ));
+typedef int64_t   lev_vi64_t __attribute__(( vector_size( 8 * LEV_LANES ) ));
+
+/**
+ * Score the pattern against each of `strings', filling `dists' with the
+ * distance or `max + 1'.
+ * <p>
+ * This is `lev_pattern_dist' run on `LEV_LANES' strings at a time, one per
+ * vector lane, using GCC's vector extensions so the compiler can emit
+ * whatever SIMD the target has.
+ * Lanes whose string has ended are masked off, and a pass stops once every
+ * lane is finished or beyond `max'.
+ */
+  static void
+lev_pattern_dist_many( const lev_pattern_t *  pat,
+                       const char          ** strings,
+                       size_t                 nstrings,
+                       int                    max,
+                       int                 *  dists
+                     )
+{
+  assert( pat != NULL );
+  assert( strings != NULL );
+  assert( dists != NULL );
+  assert( 0 <= max );
+
+  size_t m = pat->len;
+  size_t i = 0;
+
+  if ( m == 0 )
+    {
+      for ( ; i < nstrings; i++ )
+        {
+          size_t len = strlen( strings[i] );
+          dists[i] = ( len <= (size_t) max ) ? (int) len : max + 1;
+        }
+      return;
+    }
+
+  for ( ; i + LEV_LANES <= nstrings; i += LEV_LANES )
+    {
+      const char * t[LEV_LANES];
+      lev_vi64_t   tlen;
+      size_t       longest = 0;
+      for ( int k = 0; k < LEV_LANES; k++ )
+        {
+          t[k]    = strings[i + k];
+          tlen[k] = (int64_t) strlen( t[k] );
+          if ( longest < (size_t) tlen[k] ) longest = (size_t) tlen[k];
+        }
+
+      lev_vu64_t one   = ( (lev_vu64_t) {} ) + 1;
+      lev_vu64_t pv    = ~( (lev_vu64_t) {} );
+      lev_vu64_t mv    = {};
+      lev_vi64_t score = ( (lev_vi64_t) {} ) + (int64_t) m;
+      lev_vi64_t vmax  = ( (lev_vi64_t) {} ) + max;
+      uint64_t   sh    = m - 1;
+
+      for ( size_t j = 0; j < longest; j++ )
+        {
+          lev_vu64_t eq;
+          for ( int k = 0; k < LEV_LANES; k++ )
+            {
+              eq[k] = ( (int64_t) j < tlen[k] )
+                      ? pat->peq[(unsigned char) t[k][j]]
+                      : 0;
+            }
+          /* All ones in lanes which still have characters left */
+          lev_vu64_t on = (lev_vu64_t) ( ( (lev_vi64_t) {} ) + (int64_t) j <
+                                         tlen
+                                       );
+          lev_vu64_t xv = eq | mv;
+          lev_vu64_t xh = ( ( ( eq & pv ) + pv ) ^ pv ) | eq;
+          lev_vu64_t ph = mv | ~( xh | pv );
+          lev_vu64_t mh = pv & xh;
+          score += (lev_vi64_t) ( ( ph >> sh ) & one & on );
+          score -= (lev_vi64_t) ( ( mh >> sh ) & one & on );
+          ph = ( ph << 1 ) | 1;
+          mh <<= 1;
+          pv = ( ( mh | ~( xv | ph ) ) & on ) | ( pv & ~on );
+          mv = ( ( ph & xv ) & on ) | ( mv & ~on );
+
+          /* Stop once no lane can come back within `max' */
+          lev_vi64_t left = tlen - (int64_t) ( j + 1 );
+          lev_vi64_t done = ( ( score - left ) > vmax ) | ( left <= 0 );
+          bool       all  = true;
+          for ( int k = 0; k < LEV_LANES; k++ ) all &= ( done[k] != 0 );
+          if ( all ) break;
+        }
+
+      for ( int k = 0; k < LEV_LANES; k++ )
+        {
+          size_t d = ( m < (size_t) tlen[k] ) ? (size_t) tlen[k] - m
+                                              : m - (size_t) tlen[k];
+          dists[i + k] = ( ( (size_t) max < d ) || ( max < score[k] ) )
+                         ? max + 1
+                         : (int) score[k];
+        }
+    }
+
+  for ( ; i < nstrings; i++ )
+    {
+      dists[i] = lev_pattern_dist( pat, strings[i], strlen( strings[i] ), max );
+    }
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Levenshtein Distance between `s' and `t', giving up once the distance is
+ * known to be greater than `max'.
+ * Returns the distance, or `max + 1' if it exceeds `max'.
+ */
+  static int
+levenshtein_bounded( const char * s,
+                     size_t       slen,
+                     const char * t,
+                     size_t       tlen,
+                     int          max
+                   )
+{
+  lev_pattern_t pat;
+  /* Distance is symmetric, so the shorter string makes the pattern */
+  if ( tlen < slen )
+    {
+      const char * tmp = s;
+      s = t;
+      t = tmp;
+      size_t tmp_len = slen;
+      slen = tlen;
+      tlen = tmp_len;
+    }
+  if ( ! lev_pattern_init( & pat, s, slen ) )
+    {
+      return levenshtein_dp( s, slen, t, tlen, max );
+    }
+  return lev_pattern_dist( & pat, t, tlen, max );
+}
+
+
+/**
+ * Find the Levenshtein Distance between two string.
+ */
+  static int
+levenshtein( const char * s, const char * t )
+{
+  assert( s != NULL );
+  assert( t != NULL );
+  size_t slen = strlen( s );
+  size_t tlen = strlen( t );
+  return levenshtein_bounded( s,
+                              slen,
+                              t,
+                              tlen,
+                              (int) ( ( slen < tlen ) ? tlen : slen )
+                            );
 }
 
 
@@ -104,20 +365,38 @@ rank_lev_dist( const char   *  s,
   assert( strings != NULL );
   assert( sranked != NULL );
   assert( dranked != NULL );
-  assert( nstrings <= nranked );
+  assert( nranked <= nstrings );
 
          int          shortest  = INT_MAX;
+         int        * dists     = (int *) malloc( sizeof( int ) * nstrings );
   struct lev_pair_s * lev_dists =
     (struct lev_pair_s *) malloc( sizeof( struct lev_pair_s ) * nstrings );
 
+  assert( dists != NULL );
   assert( lev_dists != NULL );
 
+  /* Score every string at once against the query */
+  lev_pattern_t pat;
+  if ( lev_pattern_init( & pat, s, strlen( s ) ) )
+    {
+      lev_pattern_dist_many( & pat, strings, nstrings, INT_MAX - 1, dists );
+    }
+  else
+    {
+      for ( size_t i = 0; i < nstrings; i++ )
+        {
+          dists[i] = levenshtein( s, strings[i] );
+        }
+    }
+
   for ( size_t i = 0; i < nstrings; i++ )
     {
       lev_dists[i].str = strings[i];
-      lev_dists[i].dst = levenshtein( s, strings[i] );
+      lev_dists[i].dst = dists[i];
       if ( lev_dists[i].dst < shortest ) shortest = lev_dists[i].dst;
     }
+  free( dists );
+  dists = NULL;
 
   qsort( (void *) lev_dists,
          nstrings,
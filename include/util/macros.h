@@ -295,7 +295,7 @@
   __extension__(                                                              \
   {                                                                           \
     __auto_type _lo = ( lo );                                                 \
-    __auto_type _hi = ( lo );                                                 \
+    __auto_type _hi = ( hi );                                                 \
     __auto_type _x  = ( x );                                                  \
     _lo < _x && _x < _hi;                                                     \
   }                                                                           \
@@ -305,7 +305,7 @@
   __extension__(                                                              \
   {                                                                           \
     __auto_type _lo = ( lo );                                                 \
-    __auto_type _hi = ( lo );                                                 \
+    __auto_type _hi = ( hi );                                                 \
     __auto_type _x  = ( x );                                                  \
     _lo <= _x && _x <= _hi;                                                   \
   }                                                                           \
@@ -0,0 +1,66 @@
+/* -*- mode: c; -*- */
+
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+/* ========================================================================= */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * A minimal "parallel for" over POSIX threads.
+ * <p>
+ * The range `[0, n)' is split into chunks of `chunk' items which workers
+ * claim one at a time from a shared atomic counter, so uneven work ( some
+ * battles run much longer than others ) balances itself.
+ * The calling thread works too, so `nthreads = 1' never starts a thread.
+ * <p>
+ * `fn' is called as `fn( ctx, begin, end, thread )' for each claimed chunk,
+ * `thread' runs from 0 to `nthreads - 1' and is stable for a worker, so
+ * callers can hand each worker its own scratch space.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+typedef void ( * parallel_fn )( void     * ctx,
+                                uint32_t   begin,
+                                uint32_t   end,
+                                uint32_t   thread
+                              );
+
+/* One per online core, and at least 1. */
+uint32_t parallel_default_threads( void );
+
+/**
+ * `nthreads = 0' uses `parallel_default_threads', `chunk = 0' picks a chunk
+ * size giving each thread several chunks.
+ * Returns 0 once every item is done, or -1 if memory for the workers could
+ * not be allocated, in which case nothing was run.
+ * Threads that fail to start are not an error, the rest pick up their work.
+ */
+int parallel_for( uint32_t      n,
+                  uint32_t      chunk,
+                  uint32_t      nthreads,
+                  parallel_fn   fn,
+                  void        * ctx
+                );
+
+/* The thread count `parallel_for' would use for `n' items. */
+uint32_t parallel_threads( uint32_t n, uint32_t nthreads );
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* parallel.h */
+
+/* vim: set filetype=c : */
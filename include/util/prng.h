@@ -0,0 +1,70 @@
+/* -*- mode: c; -*- */
+
+#ifndef _PRNG_H
+#define _PRNG_H
+
+/* ========================================================================= */
+
+#include <stdint.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * SplitMix64, a small seedable generator for simulations that must replay
+ * exactly from a seed.
+ * <p>
+ * The whole state is one `uint64_t', which callers own, so each run, or
+ * each thread, can keep its own stream; any value is a valid seed.
+ * Not for anything security related.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * The SplitMix64 finalizer on its own, a cheap bijective mix of all 64 bits.
+ * Also good for hashing, but its output is baked into `matchup_cache' files,
+ * so it must never change.
+ */
+  static inline uint64_t
+prng_mix( uint64_t z )
+{
+  z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9;
+  z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111eb;
+  return z ^ ( z >> 31 );
+}
+
+
+  static inline uint64_t
+prng_next( uint64_t * state )
+{
+  return prng_mix( * state += 0x9e3779b97f4a7c15 );
+}
+
+
+/* Uniform in [0, 1). */
+  static inline double
+prng_double( uint64_t * state )
+{
+  return ( prng_next( state ) >> 11 ) * 0x1.0p-53;
+}
+
+
+/* Uniform in [0, n), `n' must be positive. */
+  static inline uint32_t
+prng_below( uint64_t * state, uint32_t n )
+{
+  return (uint32_t) ( ( ( prng_next( state ) >> 32 ) * n ) >> 32 );
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* prng.h */
+
+/* vim: set filetype=c : */
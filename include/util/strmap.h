@@ -0,0 +1,96 @@
+/* -*- mode: c; -*- */
+
+#ifndef _STRMAP_H
+#define _STRMAP_H
+
+/* ========================================================================= */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * An open addressing hash map from strings to pointers.
+ * <p>
+ * This replaces `UT_hash_handle's embedded in records: the map lives beside
+ * the records rather than inside them, so records stay small, and a record
+ * can be indexed by any number of maps ( or none ) without changing its
+ * layout.
+ * <p>
+ * Keys are NOT copied, they must outlive the map; interning them with
+ * `strpool_t' is the usual way to arrange that.
+ * Lookups take a length, so keys can be found straight from a JSON token
+ * without copying it first.
+ * A map is not modified by lookups, so once filled it may be read from any
+ * number of threads.
+ */
+
+
+/* ------------------------------------------------------------------------- */
+
+struct strmap_slot_s {
+  const char * key;     /* `NULL' for empty slots */
+  void       * val;
+  uint32_t     hash;
+  uint32_t     len;
+};
+typedef struct strmap_slot_s  strmap_slot_t;
+
+
+struct strmap_s {
+  strmap_slot_t * slots;
+  uint32_t        cap;    /* Always 0 or a power of 2 */
+  uint32_t        cnt;
+};
+typedef struct strmap_s  strmap_t;
+
+#define STRMAP_INIT  { .slots = NULL, .cap = 0, .cnt = 0 }
+
+
+/* ------------------------------------------------------------------------- */
+
+void strmap_init( strmap_t * map );
+void strmap_free( strmap_t * map );
+
+/* Make room for `cnt' keys in total, so filling the map never rehashes. */
+int strmap_reserve( strmap_t * map, uint32_t cnt );
+
+/**
+ * Returns 0 on success, 1 if the key was already in the map ( the existing
+ * `val' is kept ), or -1 on failure.
+ */
+int strmap_putn( strmap_t * map, const char * key, size_t len, void * val );
+
+/* Returns `NULL' if `key' is not in the map. */
+void * strmap_getn( const strmap_t * map, const char * key, size_t len );
+
+/* FNV-1a, exposed for `strpool_t' */
+uint32_t strmap_hash( const char * key, size_t len );
+
+
+  static inline int
+strmap_put( strmap_t * map, const char * key, void * val )
+{
+  return strmap_putn( map, key, strlen( key ), val );
+}
+
+  static inline void *
+strmap_get( const strmap_t * map, const char * key )
+{
+  return strmap_getn( map, key, strlen( key ) );
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* strmap.h */
+
+/* vim: set filetype=c : */
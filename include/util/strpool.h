@@ -0,0 +1,87 @@
+/* -*- mode: c; -*- */
+
+#ifndef _STRPOOL_H
+#define _STRPOOL_H
+
+/* ========================================================================= */
+
+#include "util/strmap.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Interned strings, packed end to end in a few large blocks.
+ * <p>
+ * Interning the same string twice returns the same pointer, so names that
+ * repeat across records ( form names like "BASE" and "ALOLA" ) are stored
+ * once, and every name sits next to its neighbours rather than in its own
+ * small heap allocation.
+ * Strings never move once interned, and are all released together by
+ * `strpool_free'.
+ */
+
+/* Strings longer than this get a block to themselves */
+#define STRPOOL_BLOCK_SIZE  16384
+
+
+/* ------------------------------------------------------------------------- */
+
+struct strpool_block_s {
+  struct strpool_block_s * next;
+  size_t                   used;
+  size_t                   cap;
+  char                     data[];
+};
+typedef struct strpool_block_s  strpool_block_t;
+
+
+struct strpool_s {
+  strpool_block_t * blocks;   /* Newest first */
+  strmap_t          strs;     /* Each string maps to itself */
+  size_t            bytes;    /* Total of interned strings, with NULs */
+};
+typedef struct strpool_s  strpool_t;
+
+#define STRPOOL_INIT  { .blocks = NULL, .strs = STRMAP_INIT, .bytes = 0 }
+
+
+/* ------------------------------------------------------------------------- */
+
+void strpool_init( strpool_t * pool );
+void strpool_free( strpool_t * pool );
+
+/**
+ * Intern the first `len' characters of `str', which needn't be terminated.
+ * Returns the pooled copy, or `NULL' on failure.
+ * Pooled strings are shared, and must not be modified or freed.
+ */
+char * strpool_internn( strpool_t * pool, const char * str, size_t len );
+
+  static inline char *
+strpool_intern( strpool_t * pool, const char * str )
+{
+  return strpool_internn( pool, str, strlen( str ) );
+}
+
+/* Returns the pooled copy of `str', or `NULL' if it was never interned. */
+  static inline char *
+strpool_findn( const strpool_t * pool, const char * str, size_t len )
+{
+  return (char *) strmap_getn( & pool->strs, str, len );
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================= */
+
+#endif /* strpool.h */
+
+/* vim: set filetype=c : */
@@ -141,9 +141,9 @@ handle_faints( bool p1_mon_alive, bool p2_mon_alive, pvp_battle_t * battle )
       battle->p1_action = decide_action( true, battle );
       battle->p2_action = decide_action( false, battle );
       /* Wait for both to pick */
-      while ( ( 0 < swap_timeout-- )        &&
-              ( battle->p1_action == WAIT ) ||
-              ( battle->p2_action == WAIT )
+      while ( ( 0 < swap_timeout-- )          &&
+              ( ( battle->p1_action == WAIT ) ||
+                ( battle->p2_action == WAIT ) )
             )
         {
           eval_turn( battle );
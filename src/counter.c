@@ -0,0 +1,724 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "counter.h"
+#include "cupstore.h"
+#include "filter_index.h"
+#include "matchup.h"
+#include "moveset.h"
+#include "pokemon.h"
+#include "util/bitset.h"
+#include "util/macros.h"
+#include "util/parallel.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+/* What one side of a battle can do to the other. */
+struct counter_side_s {
+  uint32_t hp;
+  uint32_t turns;           /* Between Fast Moves */
+  uint32_t fast_damage;
+  uint32_t fast_energy;
+  uint8_t  ncharged;
+  uint32_t charged_damage[2];
+  uint32_t charged_energy[2];
+  uint32_t min_energy;      /* Of the Charged Moves */
+  uint32_t max_energy;
+  uint32_t min_damage;
+};
+typedef struct counter_side_s  counter_side_t;
+
+
+  static counter_side_t
+counter_side( const pvp_pokemon_t * mon, const pvp_pokemon_t * opp )
+{
+  /* `get_pvp_damage' wants mutable Pokemon, and reads their buffs */
+  pvp_pokemon_t  atk  = * mon;
+  pvp_pokemon_t  def  = * opp;
+  counter_side_t side = {
+    .hp          = max( get_hp_from_stam_lv( mon->stats.stamina, mon->level ),
+                        1
+                      ),
+    .turns       = max( (uint32_t) mon->fast_move.turns, 1 ),
+    .fast_damage = 0,
+    .fast_energy = mon->fast_move.energy,
+    .ncharged    = 0,
+    .min_energy  = UINT32_MAX,
+    .max_energy  = 0,
+    .min_damage  = UINT32_MAX
+  };
+  atk.buffs = NO_BUFF_STATE;
+  def.buffs = NO_BUFF_STATE;
+
+  side.fast_damage = get_pvp_damage( M_FAST, & atk, & def );
+  for ( uint8_t c = 0; c < 2; c++ )
+    {
+      if ( ( c == 1 ) && ( mon->charged_moves[1].move_id == 0 ) ) break;
+      uint32_t damage = get_pvp_damage( ( c == 0 ) ? M_CHARGED1 : M_CHARGED2,
+                                        & atk, & def
+                                      );
+      uint32_t energy = mon->charged_moves[c].energy;
+      side.charged_damage[c] = damage;
+      side.charged_energy[c] = energy;
+      side.min_energy        = min( side.min_energy, energy );
+      side.max_energy        = max( side.max_energy, energy );
+      side.min_damage        = min( side.min_damage, damage );
+      side.ncharged++;
+    }
+  return side;
+}
+
+
+/**
+ * The most damage `x' can deal with `nfast' Fast Moves.
+ * Every Charged Move that lands was paid for with energy.
+ * Shields don't lower this: a defender still busy with a Fast Move waits
+ * rather than shielding, so none are sure to be used.
+ */
+  static uint32_t
+counter_max_damage( const counter_side_t * x, uint32_t nfast )
+{
+  uint32_t damage = nfast * x->fast_damage;
+  uint32_t energy = nfast * x->fast_energy;
+  if ( x->ncharged == 0 ) return damage;
+
+  uint32_t charged = 0;
+  for ( uint8_t c = 0; c < x->ncharged; c++ )
+    {
+      charged = max( charged,
+                     x->charged_damage[c] * energy / x->charged_energy[c]
+                   );
+    }
+  return damage + charged;
+}
+
+
+/**
+ * The least damage `y' can deal with `nfast' Fast Moves, against `shields'.
+ * `y' only skips a Charged Move it has the energy for to shield, so before
+ * each Fast Move it had less energy than its cheapest Charged Move; all but
+ * that and one Fast Move's worth of its energy went into Charged Moves.
+ */
+  static uint32_t
+counter_min_damage( const counter_side_t * y,
+                    uint32_t               nfast,
+                    uint8_t                shields
+                  )
+{
+  uint32_t damage = nfast * y->fast_damage;
+  if ( y->ncharged == 0 ) return damage;
+
+  uint32_t energy = nfast * y->fast_energy;
+  uint32_t held   = y->min_energy + y->fast_energy;
+  if ( energy < held ) return damage;
+  uint32_t nused  = ( energy - held ) / y->max_energy;
+  if ( nused <= shields ) return damage;
+  return damage + ( nused - shields ) * y->min_damage;
+}
+
+
+/**
+ * Fewest Fast Moves `y' can have used in `nturns' turns: it is always busy,
+ * for `turns' turns per Fast Move and one per Charged Move, and each
+ * Charged Move costs at least `min_energy'.
+ */
+  static bool
+counter_covers( const counter_side_t * y, uint32_t nfast, uint32_t nturns )
+{
+  uint32_t ncharged = ( y->ncharged == 0 ) ? 0 :
+                      nfast * y->fast_energy / y->min_energy;
+  return nturns <= nfast * y->turns + ncharged;
+}
+
+
+  uint16_t
+counter_bound( const pvp_pokemon_t * mon,
+               const pvp_pokemon_t * opp,
+               uint8_t               scenario
+             )
+{
+  assert( mon != NULL );
+  assert( opp != NULL );
+  assert( scenario < MATCHUP_NSCENARIOS );
+
+  const counter_side_t x       = counter_side( mon, opp );
+  const counter_side_t y       = counter_side( opp, mon );
+  const uint8_t        shields = matchup_scenario_s1( scenario );
+  uint32_t             best    = 0;
+
+  /* Free Charged Moves can be used every turn, in any number */
+  if ( ( ( 0 < x.ncharged ) && ( x.min_energy == 0 ) ) ||
+       ( ( 0 < y.ncharged ) && ( y.min_energy == 0 ) ) )
+    {
+      return MATCHUP_RATING_MAX;
+    }
+
+  /* `mon' always damages `opp', so the loop ends */
+  uint32_t yfast = 0;
+  for ( uint32_t t = 1; ; t++ )
+    {
+      uint32_t xfast = ( t + x.turns - 1 ) / x.turns;
+      while ( ! counter_covers( & y, yfast, t ) ) yfast++;
+
+      uint32_t dealt = min( counter_max_damage( & x, xfast ), y.hp );
+      uint32_t taken = min( counter_min_damage( & y, yfast, shields ), x.hp );
+      /* Rounded as in `matchup_battle' */
+      uint32_t rating = ( 500 * dealt ) / y.hp + ( 500 * ( x.hp - taken ) ) /
+                                                 x.hp;
+      best = max( best, rating );
+
+      /* Dealing more can't raise the rating, and `mon' is surely down */
+      if ( ( y.hp <= dealt ) || ( x.hp <= taken ) ) break;
+    }
+
+  return (uint16_t) best;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* One moveset of one species */
+struct counter_cand_s {
+  moveset_t moveset;
+  uint32_t  species;  /* Index into `counter_job_t's species */
+  uint32_t  bound;    /* Sum over the team and scenarios */
+};
+typedef struct counter_cand_s  counter_cand_t;
+
+struct counter_species_s {
+  const pdex_mon_t * pdex;
+  uint8_t            level;
+  int64_t            sum;      /* Of ratings, -1 until simulated */
+  uint32_t           best;     /* Candidate */
+  uint32_t           heap;     /* Position in the heap, or `UINT32_MAX' */
+};
+typedef struct counter_species_s  counter_species_t;
+
+struct counter_job_s {
+  const pvp_pokemon_t * mons;      /* By candidate */
+  counter_cand_t      * cands;
+  const pvp_pokemon_t * team;
+  uint32_t              nteam;
+  const uint8_t       * scenarios;
+  uint8_t               nscenarios;
+};
+typedef struct counter_job_s  counter_job_t;
+
+
+  static int
+counter_reserve( counter_cand_t ** cands, uint32_t * cap, uint32_t n )
+{
+  if ( n <= * cap ) return STORE_SUCCESS;
+  uint32_t         ncap = max( n, max( * cap * 2, 64 ) );
+  counter_cand_t * tmp  = realloc( * cands, sizeof( counter_cand_t ) * ncap );
+  if ( tmp == NULL ) return STORE_ERROR_NOMEM;
+  * cands = tmp;
+  * cap   = ncap;
+  return STORE_SUCCESS;
+}
+
+
+/* Enter every eligible species of `cup', and a candidate per moveset. */
+  static int
+counter_enter( counter_search_t     *  search,
+               const cup_t          *  cup,
+               const counter_opts_t *  opts,
+               counter_species_t    *  species,
+               counter_cand_t       ** cands
+             )
+{
+  const filter_index_t * index   = cup->index;
+  moveset_t            * scratch = NULL;
+  uint32_t               cap     = 0;
+  int                    rsl     = STORE_SUCCESS;
+
+  for ( uint32_t i = 0; i < index->nmons; i++ )
+    {
+      if ( ! bitset_test( cup->pool, i ) ) continue;
+
+      pdex_mon_t * pdex = NULL;
+      rsl = filter_index_get( index, i, & pdex );
+      if ( rsl != STORE_SUCCESS ) break;
+      if ( ( pdex->fast_moves_cnt == 0 ) || ( pdex->charged_moves_cnt == 0 ) )
+        {
+          continue;
+        }
+      uint8_t level =
+        (uint8_t) get_max_level_for_cp( pdex->base_stats, opts->ivs,
+                                        cup->cp_cap
+                                      );
+      if ( level == 0 ) continue;
+
+      uint32_t    n   = 0;
+      moveset_t * tmp = realloc( scratch,
+                                 sizeof( moveset_t ) * moveset_count( pdex )
+                               );
+      if ( tmp == NULL )
+        {
+          rsl = STORE_ERROR_NOMEM;
+          break;
+        }
+      scratch = tmp;
+      rsl = moveset_candidates( index->store, pdex, opts->prune, scratch,
+                                & n
+                              );
+      if ( rsl != STORE_SUCCESS ) break;
+      rsl = counter_reserve( cands, & cap, search->ncandidates + n );
+      if ( rsl != STORE_SUCCESS ) break;
+
+      for ( uint32_t m = 0; m < n; m++ )
+        {
+          ( * cands )[search->ncandidates++] = (counter_cand_t) {
+            .moveset = scratch[m],
+            .species = search->nspecies,
+            .bound   = 0
+          };
+        }
+      species[search->nspecies++] = (counter_species_t) {
+        .pdex  = pdex,
+        .level = level,
+        .sum   = -1,
+        .best  = 0,
+        .heap  = UINT32_MAX
+      };
+    }
+
+  free( scratch );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  return ( search->nspecies == 0 ) ? STORE_ERROR_NOT_FOUND : STORE_SUCCESS;
+}
+
+
+/* Build a `pvp_pokemon_t' for every candidate. */
+  static int
+counter_init_mons( const counter_search_t  * search,
+                   const counter_opts_t    * opts,
+                   store_t                 * store,
+                   const counter_species_t * species,
+                   const counter_cand_t    * cands,
+                   pvp_pokemon_t           * mons
+                 )
+{
+  roster_pokemon_t * rmons = (roster_pokemon_t *)
+    malloc( sizeof( roster_pokemon_t ) * search->ncandidates );
+  base_pokemon_t   * bases = (base_pokemon_t *)
+    malloc( sizeof( base_pokemon_t ) * search->nspecies );
+  int                rsl   = STORE_SUCCESS;
+
+  if ( ( rmons == NULL ) || ( bases == NULL ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+
+  for ( uint32_t s = 0; s < search->nspecies; s++ )
+    {
+      bases[s] = (base_pokemon_t) {
+        .pdex_mon = species[s].pdex,
+        .level    = species[s].level,
+        .ivs      = opts->ivs
+      };
+    }
+  for ( uint32_t c = 0; c < search->ncandidates; c++ )
+    {
+      const moveset_t * moveset = & cands[c].moveset;
+      rmons[c] = (roster_pokemon_t) {
+        .base             = bases + cands[c].species,
+        .fast_move_id     = moveset->fast_move_id,
+        .charged_move_ids = { moveset->charged_move_ids[0],
+                              moveset->charged_move_ids[1]
+                            }
+      };
+    }
+
+  rsl = pvp_pokemon_init_many( mons, rmons, search->ncandidates, store );
+
+done:
+  free( rmons );
+  free( bases );
+  return rsl;
+}
+
+
+  static void
+counter_bound_cands( void * vjob, uint32_t begin, uint32_t end, uint32_t t )
+{
+  counter_job_t * job = (counter_job_t *) vjob;
+  for ( uint32_t c = begin; c < end; c++ )
+    {
+      uint32_t bound = 0;
+      for ( uint32_t o = 0; o < job->nteam; o++ )
+        {
+          for ( uint8_t s = 0; s < job->nscenarios; s++ )
+            {
+              bound += counter_bound( job->mons + c, job->team + o,
+                                      job->scenarios[s]
+                                    );
+            }
+        }
+      job->cands[c].bound = bound;
+    }
+}
+
+
+struct counter_order_s {
+  uint32_t bound;
+  uint32_t cand;
+};
+
+/* Highest bound first, ties in candidate order */
+  static int
+counter_order_cmp( const void * a, const void * b )
+{
+  const struct counter_order_s * oa = (const struct counter_order_s *) a;
+  const struct counter_order_s * ob = (const struct counter_order_s *) b;
+  if ( oa->bound != ob->bound ) return ( oa->bound < ob->bound ) ? 1 : -1;
+  return ( oa->cand > ob->cand ) - ( oa->cand < ob->cand );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * The `k' best species so far, as a heap with the worst on top.
+ * Species order by score, then by index.
+ */
+struct counter_heap_s {
+  counter_species_t * species;
+  uint32_t          * heap;
+  uint32_t            cnt;
+  uint32_t            k;
+};
+typedef struct counter_heap_s  counter_heap_t;
+
+
+  static bool
+counter_better( const counter_species_t * species, uint32_t a, uint32_t b )
+{
+  if ( species[a].sum != species[b].sum )
+    {
+      return species[b].sum < species[a].sum;
+    }
+  return a < b;
+}
+
+
+  static void
+counter_heap_set( counter_heap_t * h, uint32_t i, uint32_t s )
+{
+  h->heap[i]         = s;
+  h->species[s].heap = i;
+}
+
+
+  static void
+counter_heap_up( counter_heap_t * h, uint32_t i )
+{
+  uint32_t s = h->heap[i];
+  while ( 0 < i )
+    {
+      uint32_t p = ( i - 1 ) / 2;
+      if ( ! counter_better( h->species, h->heap[p], s ) ) break;
+      counter_heap_set( h, i, h->heap[p] );
+      i = p;
+    }
+  counter_heap_set( h, i, s );
+}
+
+
+  static void
+counter_heap_down( counter_heap_t * h, uint32_t i )
+{
+  uint32_t s = h->heap[i];
+  for ( ;; )
+    {
+      uint32_t c = i * 2 + 1;
+      if ( h->cnt <= c ) break;
+      if ( ( c + 1 < h->cnt ) &&
+           counter_better( h->species, h->heap[c], h->heap[c + 1] ) )
+        {
+          c++;
+        }
+      if ( ! counter_better( h->species, s, h->heap[c] ) ) break;
+      counter_heap_set( h, i, h->heap[c] );
+      i = c;
+    }
+  counter_heap_set( h, i, s );
+}
+
+
+/* Species `s' has a new, higher, sum. */
+  static void
+counter_heap_update( counter_heap_t * h, uint32_t s )
+{
+  if ( h->species[s].heap != UINT32_MAX )
+    {
+      counter_heap_down( h, h->species[s].heap );
+    }
+  else if ( h->cnt < h->k )
+    {
+      h->cnt++;
+      counter_heap_set( h, h->cnt - 1, s );
+      counter_heap_up( h, h->cnt - 1 );
+    }
+  else if ( counter_better( h->species, s, h->heap[0] ) )
+    {
+      h->species[h->heap[0]].heap = UINT32_MAX;
+      counter_heap_set( h, 0, s );
+      counter_heap_down( h, 0 );
+    }
+}
+
+
+/* The sum a candidate must reach to matter, or -1 while there is room. */
+  static int64_t
+counter_heap_min( const counter_heap_t * h )
+{
+  return ( h->cnt < h->k ) ? -1 : h->species[h->heap[0]].sum;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Simulate the `n' candidates `picked' against the team, and enter them. */
+  static int
+counter_simulate( counter_heap_t       * h,
+                  const counter_job_t  * job,
+                  const uint32_t       * picked,
+                  uint32_t               n,
+                  const counter_opts_t * opts
+                )
+{
+  pvp_pokemon_t    batch[COUNTER_BATCH_SIZE];
+  matchup_matrix_t matrix = MATCHUP_MATRIX_INIT;
+  for ( uint32_t i = 0; i < n; i++ ) batch[i] = job->mons[picked[i]];
+
+  const matchup_opts_t mopts = {
+    .scenarios = opts->scenarios,
+    .nthreads  = opts->nthreads,
+    .cache     = opts->cache
+  };
+  int rsl = matchup_matrix_build( & matrix, batch, n, job->team, job->nteam,
+                                  & mopts
+                                );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      const counter_cand_t * cand = job->cands + picked[i];
+      counter_species_t    * mon  = h->species + cand->species;
+      int64_t                sum  = 0;
+      for ( uint8_t s = 0; s < matrix.nscenarios; s++ )
+        {
+          const uint16_t * row = matchup_matrix_row( & matrix, i, s );
+          for ( uint32_t o = 0; o < matrix.ncols; o++ ) sum += row[o];
+        }
+      if ( mon->sum < sum )
+        {
+          mon->sum  = sum;
+          mon->best = picked[i];
+          counter_heap_update( h, cand->species );
+        }
+    }
+
+  matchup_matrix_free( & matrix );
+  return STORE_SUCCESS;
+}
+
+
+/* Write the heap's species to `search->counters', best first. */
+  static int
+counter_collect( counter_search_t     * search,
+                 counter_heap_t       * h,
+                 const counter_cand_t * cands,
+                 uint32_t               ncells
+               )
+{
+  search->counters = (counter_t *)
+    malloc( sizeof( counter_t ) * max( h->cnt, 1 ) );
+  if ( search->counters == NULL ) return STORE_ERROR_NOMEM;
+
+  /* Popping the worst off the top fills the list from the back */
+  search->ncounters = h->cnt;
+  while ( 0 < h->cnt )
+    {
+      uint32_t                  s   = h->heap[0];
+      const counter_species_t * mon = h->species + s;
+      search->counters[h->cnt - 1] = (counter_t) {
+        .dex_number = mon->pdex->dex_number,
+        .form_idx   = mon->pdex->form_idx,
+        .level      = mon->level,
+        .moveset    = cands[mon->best].moveset,
+        .score      = (float) ( (double) mon->sum / ncells )
+      };
+      h->species[s].heap = UINT32_MAX;
+      h->cnt--;
+      if ( 0 < h->cnt )
+        {
+          counter_heap_set( h, 0, h->heap[h->cnt] );
+          counter_heap_down( h, 0 );
+        }
+    }
+  return STORE_SUCCESS;
+}
+
+
+  int
+counter_search( counter_search_t     * search,
+                const cup_t          * cup,
+                const pvp_pokemon_t  * team,
+                uint32_t               nteam,
+                uint32_t               k,
+                const counter_opts_t * opts
+              )
+{
+  assert( search != NULL );
+  assert( cup != NULL );
+  assert( cup->index != NULL );
+  assert( ( team != NULL ) || ( nteam == 0 ) );
+
+  const counter_opts_t defaults = COUNTER_OPTS_DEFAULT;
+  if ( opts == NULL ) opts = & defaults;
+
+  * search = (counter_search_t) COUNTER_SEARCH_INIT;
+  if ( ( nteam == 0 ) || ( k == 0 ) ) return STORE_ERROR_BAD_VALUE;
+
+  uint8_t scenarios[MATCHUP_NSCENARIOS];
+  uint8_t nscenarios = 0;
+  for ( uint8_t s = 0; s < MATCHUP_NSCENARIOS; s++ )
+    {
+      if ( opts->scenarios & matchup_scenario_mask( s ) )
+        {
+          scenarios[nscenarios++] = s;
+        }
+    }
+  if ( nscenarios == 0 ) return STORE_ERROR_BAD_VALUE;
+
+  counter_species_t      * species = NULL;
+  counter_cand_t         * cands   = NULL;
+  pvp_pokemon_t          * mons    = NULL;
+  struct counter_order_s * order   = NULL;
+  uint32_t               * heap    = NULL;
+  int                      rsl     = STORE_SUCCESS;
+
+  species = (counter_species_t *)
+    malloc( sizeof( counter_species_t ) * max( cup->pool_size, 1 ) );
+  if ( species == NULL )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+  rsl = counter_enter( search, cup, opts, species, & cands );
+  if ( rsl != STORE_SUCCESS ) goto done;
+
+  mons  = (pvp_pokemon_t *)
+    malloc( sizeof( pvp_pokemon_t ) * search->ncandidates );
+  order = (struct counter_order_s *)
+    malloc( sizeof( struct counter_order_s ) * search->ncandidates );
+  heap  = (uint32_t *)
+    malloc( sizeof( uint32_t ) * min( k, search->nspecies ) );
+  if ( ( mons == NULL ) || ( order == NULL ) || ( heap == NULL ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+  rsl = counter_init_mons( search, opts, cup->index->store, species, cands,
+                           mons
+                         );
+  if ( rsl != STORE_SUCCESS ) goto done;
+
+  /* Bound every candidate, and visit them highest bound first */
+  counter_job_t job = {
+    .mons       = mons,
+    .cands      = cands,
+    .team       = team,
+    .nteam      = nteam,
+    .scenarios  = scenarios,
+    .nscenarios = nscenarios
+  };
+  if ( parallel_for( search->ncandidates, 0, opts->nthreads,
+                     counter_bound_cands, & job
+                   ) != 0 )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+  for ( uint32_t c = 0; c < search->ncandidates; c++ )
+    {
+      order[c] = (struct counter_order_s) {
+        .bound = cands[c].bound,
+        .cand  = c
+      };
+    }
+  qsort( order, search->ncandidates, sizeof( struct counter_order_s ),
+         counter_order_cmp
+       );
+
+  /**
+   * Simulate until no bound reaches the `k'th best sum, skipping candidates
+   * that can't beat their own species' best either.
+   */
+  counter_heap_t h = {
+    .species = species,
+    .heap    = heap,
+    .cnt     = 0,
+    .k       = min( k, search->nspecies )
+  };
+  uint32_t picked[COUNTER_BATCH_SIZE];
+  uint32_t next = 0;
+  for ( ;; )
+    {
+      int64_t  need = counter_heap_min( & h );
+      uint32_t n    = 0;
+      while ( ( next < search->ncandidates ) && ( n < COUNTER_BATCH_SIZE ) &&
+              ( need <= (int64_t) order[next].bound ) )
+        {
+          const counter_cand_t * cand = cands + order[next].cand;
+          if ( species[cand->species].sum < (int64_t) cand->bound )
+            {
+              picked[n++] = order[next].cand;
+            }
+          next++;
+        }
+      if ( n == 0 ) break;
+      rsl = counter_simulate( & h, & job, picked, n, opts );
+      if ( rsl != STORE_SUCCESS ) goto done;
+      search->nsimulated += n;
+    }
+
+  rsl = counter_collect( search, & h, cands, nteam * nscenarios );
+
+done:
+  free( species );
+  free( cands );
+  free( mons );
+  free( order );
+  free( heap );
+  if ( rsl != STORE_SUCCESS ) counter_search_free( search );
+  return rsl;
+}
+
+
+  void
+counter_search_free( counter_search_t * search )
+{
+  assert( search != NULL );
+  free( search->counters );
+  * search = (counter_search_t) COUNTER_SEARCH_INIT;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,594 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "coverage.h"
+#include "matchup.h"
+#include "util/bitset.h"
+#include "util/macros.h"
+#include "util/parallel.h"
+#include <assert.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Weight of `a | b | c', pass a set more than once to weigh fewer.
+ * The word loops are kept simple enough for the compiler to vectorize, and
+ * unweighted metas skip the plane loop entirely.
+ */
+  static inline uint64_t
+cov_weight3( const coverage_t * cov,
+             const uint64_t   * a,
+             const uint64_t   * b,
+             const uint64_t   * c
+           )
+{
+  const uint64_t * plane  = cov->planes;
+  uint64_t         weight = 0;
+  if ( cov->nplanes == 1 )
+    {
+      for ( size_t i = 0; i < cov->nwords; i++ )
+        {
+          weight += __builtin_popcountll( ( a[i] | b[i] | c[i] ) & plane[i] );
+        }
+      return weight;
+    }
+  for ( size_t i = 0; i < cov->nwords; i++ )
+    {
+      const uint64_t u = a[i] | b[i] | c[i];
+      for ( uint8_t p = 0; p < cov->nplanes; p++, plane++ )
+        {
+          weight += ( (uint64_t) __builtin_popcountll( u & * plane ) ) << p;
+        }
+    }
+  return weight;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+coverage_init( coverage_t             * cov,
+               const matchup_matrix_t * matrix,
+               const float            * weights,
+               uint16_t                 threshold
+             )
+{
+  assert( cov != NULL );
+  assert( matrix != NULL );
+  assert( ( matrix->ratings != NULL ) || ( matrix->nrows == 0 ) ||
+          ( matrix->ncols == 0 )
+        );
+
+  * cov = (coverage_t) COVERAGE_INIT;
+
+  /* Each scenario starts on a new word */
+  const size_t swords = bitset_nwords( matrix->ncols );
+  const size_t sbits  = swords * BITSET_WORD_BITS;
+
+  float heaviest = 0.0;
+  if ( weights != NULL )
+    {
+      for ( uint32_t c = 0; c < matrix->ncols; c++ )
+        {
+          if ( heaviest < weights[c] ) heaviest = weights[c];
+        }
+    }
+
+  cov->nrows      = matrix->nrows;
+  cov->ncols      = matrix->ncols;
+  cov->nscenarios = matrix->nscenarios;
+  cov->nwords     = swords * matrix->nscenarios;
+  cov->nplanes    = ( 0.0 < heaviest ) ? COVERAGE_WEIGHT_BITS : 1;
+  cov->wins       =
+    (uint64_t *) calloc( max( (size_t) cov->nrows * cov->nwords, 1 ),
+                         sizeof( uint64_t )
+                       );
+  cov->planes     =
+    (uint64_t *) calloc( max( cov->nwords * cov->nplanes, 1 ),
+                         sizeof( uint64_t )
+                       );
+  if ( ( cov->wins == NULL ) || ( cov->planes == NULL ) )
+    {
+      coverage_free( cov );
+      return STORE_ERROR_NOMEM;
+    }
+
+  for ( uint32_t c = 0; c < matrix->ncols; c++ )
+    {
+      uint32_t w = 1;
+      if ( 0.0 < heaviest )
+        {
+          w = ( weights[c] <= 0.0 ) ? 0
+            : (uint32_t) lroundf( weights[c] / heaviest * COVERAGE_WEIGHT_MAX );
+        }
+      for ( uint8_t s = 0; s < matrix->nscenarios; s++ )
+        {
+          size_t i = s * swords + c / BITSET_WORD_BITS;
+          for ( uint8_t p = 0; p < cov->nplanes; p++ )
+            {
+              if ( ( w >> p ) & 1 )
+                {
+                  cov->planes[i * cov->nplanes + p] |=
+                    ( (uint64_t) 1 ) << ( c % BITSET_WORD_BITS );
+                }
+            }
+          cov->total += w;
+        }
+    }
+
+  for ( uint32_t r = 0; r < matrix->nrows; r++ )
+    {
+      uint64_t * set = cov->wins + (size_t) r * cov->nwords;
+      for ( uint8_t s = 0; s < matrix->nscenarios; s++ )
+        {
+          const uint16_t * row = matchup_matrix_row( matrix, r, s );
+          for ( uint32_t c = 0; c < matrix->ncols; c++ )
+            {
+              if ( threshold < row[c] ) bitset_set( set, s * sbits + c );
+            }
+        }
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+  void
+coverage_free( coverage_t * cov )
+{
+  assert( cov != NULL );
+  free( cov->wins );
+  free( cov->planes );
+  * cov = (coverage_t) COVERAGE_INIT;
+}
+
+
+  uint64_t
+coverage_weight( const coverage_t * cov, const uint32_t * rows, uint8_t n )
+{
+  assert( cov != NULL );
+  assert( rows != NULL );
+  assert( ( 0 < n ) && ( n <= 3 ) );
+
+  const uint64_t * a = coverage_row( cov, rows[0] );
+  const uint64_t * b = ( 1 < n ) ? coverage_row( cov, rows[1] ) : a;
+  const uint64_t * c = ( 2 < n ) ? coverage_row( cov, rows[2] ) : b;
+  return cov_weight3( cov, a, b, c );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+struct cov_best_s {
+  uint64_t weight;
+  uint32_t rows[3];  /* Ascending */
+};
+typedef struct cov_best_s  cov_best_t;
+
+#define COV_BEST_NONE  { .weight = 0, .rows = { UINT32_MAX, UINT32_MAX,       \
+                                                UINT32_MAX } }
+
+struct cov_job_s {
+  const coverage_t     * cov;
+  /* `cov_weigh_rows' */
+  const uint64_t       * a;
+  const uint64_t       * b;
+  uint64_t             * out;       /* Per row */
+  /* `cov_search_first' */
+  const uint32_t       * order;     /* Rows, most covered alone first */
+  const uint64_t       * solo;      /* Per row */
+  uint64_t             * scratch;   /* Per thread */
+  size_t                 nscratch;
+  cov_best_t           * best;      /* Per thread */
+  uint64_t             * nscored;   /* Per thread */
+  atomic_uint_fast64_t   threshold;
+};
+typedef struct cov_job_s  cov_job_t;
+
+
+/* `a' is better than `b': covering more, or tied with lower rows. */
+  static inline bool
+cov_better( const cov_best_t * a, const cov_best_t * b )
+{
+  if ( a->weight != b->weight ) return b->weight < a->weight;
+  for ( uint8_t i = 0; i < 3; i++ )
+    {
+      if ( a->rows[i] != b->rows[i] ) return a->rows[i] < b->rows[i];
+    }
+  return false;
+}
+
+
+  static inline void
+cov_sort3( uint32_t rows[3] )
+{
+  uint32_t tmp;
+  if ( rows[1] < rows[0] ) { tmp = rows[0]; rows[0] = rows[1]; rows[1] = tmp; }
+  if ( rows[2] < rows[1] ) { tmp = rows[1]; rows[1] = rows[2]; rows[2] = tmp; }
+  if ( rows[1] < rows[0] ) { tmp = rows[0]; rows[0] = rows[1]; rows[1] = tmp; }
+}
+
+
+/* `out[r]' is the weight of `a | b | row r'. */
+  static void
+cov_weigh_rows( void * vjob, uint32_t begin, uint32_t end, uint32_t t )
+{
+  cov_job_t * job = (cov_job_t *) vjob;
+  for ( uint32_t r = begin; r < end; r++ )
+    {
+      job->out[r] = cov_weight3( job->cov, job->a, job->b,
+                                 coverage_row( job->cov, r )
+                               );
+    }
+}
+
+
+  static int
+cov_weigh_all( cov_job_t      * job,
+               const uint64_t * a,
+               const uint64_t * b,
+               uint32_t         nthreads,
+               uint64_t       * nscored
+             )
+{
+  job->a = a;
+  job->b = b;
+  if ( parallel_for( job->cov->nrows, 0, nthreads, cov_weigh_rows, job )
+       != 0 )
+    {
+      return STORE_ERROR_NOMEM;
+    }
+  * nscored += job->cov->nrows;
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Add the row with the largest gain three times, then make the best swap of
+ * a member for another row until none covers more, or `max_swaps' are made.
+ * Ties go to the lowest row.
+ */
+  static int
+cov_greedy( cov_job_t             * job,
+            const coverage_opts_t * opts,
+            const uint64_t        * none,
+            cov_best_t            * best,
+            uint64_t              * nscored
+          )
+{
+  const coverage_t * cov     = job->cov;
+  uint32_t           members[3];
+  uint64_t           weight  = 0;
+  int                rsl     = STORE_SUCCESS;
+
+  for ( uint8_t k = 0; k < 3; k++ )
+    {
+      const uint64_t * a = ( 0 < k ) ? coverage_row( cov, members[0] ) : none;
+      const uint64_t * b = ( 1 < k ) ? coverage_row( cov, members[1] ) : a;
+      rsl = cov_weigh_all( job, a, b, opts->nthreads, nscored );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+
+      bool found = false;
+      for ( uint32_t r = 0; r < cov->nrows; r++ )
+        {
+          if ( ( 0 < k ) && ( r == members[0] ) ) continue;
+          if ( ( 1 < k ) && ( r == members[1] ) ) continue;
+          if ( ( ! found ) || ( weight < job->out[r] ) )
+            {
+              members[k] = r;
+              weight     = job->out[r];
+              found      = true;
+            }
+        }
+    }
+
+  for ( uint32_t swap = 0; swap < opts->max_swaps; swap++ )
+    {
+      uint64_t most = weight;
+      uint8_t  slot = 3;
+      uint32_t row  = 0;
+      for ( uint8_t m = 0; m < 3; m++ )
+        {
+          rsl = cov_weigh_all( job,
+                               coverage_row( cov, members[( m + 1 ) % 3] ),
+                               coverage_row( cov, members[( m + 2 ) % 3] ),
+                               opts->nthreads, nscored
+                             );
+          if ( rsl != STORE_SUCCESS ) return rsl;
+          for ( uint32_t r = 0; r < cov->nrows; r++ )
+            {
+              if ( ( most < job->out[r] ) && ( r != members[0] ) &&
+                   ( r != members[1] ) && ( r != members[2] ) )
+                {
+                  most = job->out[r];
+                  slot = m;
+                  row  = r;
+                }
+            }
+        }
+      if ( slot == 3 ) break;
+      members[slot] = row;
+      weight        = most;
+    }
+
+  best->weight = weight;
+  memcpy( best->rows, members, sizeof( members ) );
+  cov_sort3( best->rows );
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static inline bool
+cov_pruned( cov_job_t * job, uint64_t bound )
+{
+  return bound < atomic_load_explicit( & job->threshold,
+                                       memory_order_relaxed
+                                     );
+}
+
+
+  static inline void
+cov_raise( cov_job_t * job, uint64_t weight )
+{
+  uint_fast64_t seen = atomic_load_explicit( & job->threshold,
+                                             memory_order_relaxed
+                                           );
+  while ( ( seen < weight ) &&
+          ( ! atomic_compare_exchange_weak_explicit( & job->threshold,
+                                                     & seen,
+                                                     weight,
+                                                     memory_order_relaxed,
+                                                     memory_order_relaxed
+                                                   ) ) );
+}
+
+
+/**
+ * Search every team whose first member is `order[i]' for `i' in
+ * `[begin, end)', teammates coming from later in `order'.
+ * A teammate's gain over `order[i]' alone bounds its gain over any pair that
+ * includes it, and suffix maxima of those gains bound whole branches.
+ */
+  static void
+cov_search_first( void * vjob, uint32_t begin, uint32_t end, uint32_t t )
+{
+  cov_job_t        * job   = (cov_job_t *) vjob;
+  const coverage_t * cov   = job->cov;
+  const uint32_t     n     = cov->nrows;
+  const uint32_t   * order = job->order;
+  uint64_t         * gain  = job->scratch + t * job->nscratch;
+  uint64_t         * sufg  = gain + n;
+  uint64_t         * pair  = sufg + n + 1;
+  cov_best_t       * best  = job->best + t;
+  uint64_t           cnt   = 0;
+
+  for ( uint32_t i = begin; i < end; i++ )
+    {
+      const uint64_t * ri = coverage_row( cov, order[i] );
+      const uint64_t   wi = job->solo[order[i]];
+      if ( cov_pruned( job, wi + job->solo[order[i + 1]] +
+                            job->solo[order[i + 2]] ) )
+        {
+          continue;
+        }
+
+      uint64_t top1 = 0;
+      uint64_t top2 = 0;
+      for ( uint32_t l = i + 1; l < n; l++ )
+        {
+          gain[l] = cov_weight3( cov, ri, ri, coverage_row( cov, order[l] ) ) -
+                    wi;
+          if ( top1 < gain[l] )      { top2 = top1; top1 = gain[l]; }
+          else if ( top2 < gain[l] ) { top2 = gain[l]; }
+        }
+      cnt += n - i - 1;
+      if ( cov_pruned( job, wi + top1 + top2 ) ) continue;
+
+      sufg[n] = 0;
+      for ( uint32_t l = n - 1; i < l; l-- )
+        {
+          sufg[l] = max( gain[l], sufg[l + 1] );
+        }
+
+      for ( uint32_t j = i + 1; j < n - 1; j++ )
+        {
+          const uint64_t wij = wi + gain[j];
+          if ( cov_pruned( job, wij + sufg[j + 1] ) ) continue;
+          bitset_or( pair, ri, coverage_row( cov, order[j] ), cov->nwords );
+          for ( uint32_t l = j + 1; l < n; l++ )
+            {
+              if ( cov_pruned( job, wij + sufg[l] ) ) break;
+              if ( cov_pruned( job, wij + gain[l] ) ) continue;
+              cov_best_t team = {
+                .weight = cov_weight3( cov, pair, pair,
+                                       coverage_row( cov, order[l] )
+                                     ),
+                .rows   = { order[i], order[j], order[l] }
+              };
+              cnt++;
+              if ( cov_pruned( job, team.weight ) ) continue;
+              cov_sort3( team.rows );
+              if ( cov_better( & team, best ) )
+                {
+                  * best = team;
+                  cov_raise( job, team.weight );
+                }
+            }
+        }
+    }
+
+  job->nscored[t] += cnt;
+}
+
+
+struct cov_solo_s {
+  uint64_t weight;
+  uint32_t row;
+};
+
+  static int
+cov_solo_cmp( const void * a, const void * b )
+{
+  const struct cov_solo_s * sa = (const struct cov_solo_s *) a;
+  const struct cov_solo_s * sb = (const struct cov_solo_s *) b;
+  if ( sa->weight != sb->weight ) return ( sa->weight < sb->weight ) ? 1 : -1;
+  return ( sa->row < sb->row ) ? -1 : ( sa->row > sb->row );
+}
+
+
+/**
+ * Visit rows most covered alone first, so good teams are found early, and
+ * seed the shared threshold with the greedy team.
+ */
+  static int
+cov_exact( cov_job_t             * job,
+           const coverage_opts_t * opts,
+           const uint64_t        * none,
+           cov_best_t            * best,
+           uint64_t              * nscored
+         )
+{
+  const coverage_t  * cov      = job->cov;
+  const uint32_t      n        = cov->nrows;
+  const uint32_t      nthreads = parallel_threads( n - 2, opts->nthreads );
+  const size_t        nscratch = 2 * (size_t) n + 1 + cov->nwords;
+  uint64_t          * solo     = (uint64_t *) malloc( sizeof( uint64_t ) * n );
+  uint32_t          * order    = (uint32_t *) malloc( sizeof( uint32_t ) * n );
+  struct cov_solo_s * sorted   =
+    (struct cov_solo_s *) malloc( sizeof( struct cov_solo_s ) * n );
+  uint64_t          * scratch  =
+    (uint64_t *) malloc( sizeof( uint64_t ) * nscratch * nthreads );
+  cov_best_t        * bests    =
+    (cov_best_t *) malloc( sizeof( cov_best_t ) * nthreads );
+  uint64_t          * counts   =
+    (uint64_t *) calloc( nthreads, sizeof( uint64_t ) );
+  int                 rsl      = STORE_SUCCESS;
+
+  if ( ( solo == NULL ) || ( order == NULL ) || ( sorted == NULL ) ||
+       ( scratch == NULL ) || ( bests == NULL ) || ( counts == NULL ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+
+  rsl = cov_greedy( job, opts, none, best, nscored );
+  if ( rsl != STORE_SUCCESS ) goto done;
+
+  rsl = cov_weigh_all( job, none, none, opts->nthreads, nscored );
+  if ( rsl != STORE_SUCCESS ) goto done;
+  for ( uint32_t r = 0; r < n; r++ )
+    {
+      solo[r]   = job->out[r];
+      sorted[r] = (struct cov_solo_s) { .weight = solo[r], .row = r };
+    }
+  qsort( sorted, n, sizeof( struct cov_solo_s ), cov_solo_cmp );
+  for ( uint32_t i = 0; i < n; i++ ) order[i] = sorted[i].row;
+
+  for ( uint32_t t = 0; t < nthreads; t++ )
+    {
+      bests[t] = (cov_best_t) COV_BEST_NONE;
+    }
+  job->order    = order;
+  job->solo     = solo;
+  job->scratch  = scratch;
+  job->nscratch = nscratch;
+  job->best     = bests;
+  job->nscored  = counts;
+  atomic_init( & job->threshold, best->weight );
+
+  /* Early first members have far more teammates to try, so go one by one */
+  if ( parallel_for( n - 2, 1, nthreads, cov_search_first, job ) != 0 )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+  for ( uint32_t t = 0; t < nthreads; t++ )
+    {
+      if ( cov_better( bests + t, best ) ) * best = bests[t];
+      * nscored += counts[t];
+    }
+
+done:
+  free( solo );
+  free( order );
+  free( sorted );
+  free( scratch );
+  free( bests );
+  free( counts );
+  return rsl;
+}
+
+
+  int
+coverage_search( const coverage_t      * cov,
+                 const coverage_opts_t * opts,
+                 coverage_team_t       * team
+               )
+{
+  assert( cov != NULL );
+  assert( team != NULL );
+
+  const coverage_opts_t defaults = COVERAGE_OPTS_DEFAULT;
+  if ( opts == NULL ) opts = & defaults;
+
+  if ( cov->nrows < 3 ) return STORE_ERROR_BAD_VALUE;
+
+  cov_best_t   best    = COV_BEST_NONE;
+  uint64_t     nscored = 0;
+  cov_job_t    job     = { .cov = cov };
+  uint64_t   * none    = bitset_alloc( cov->nwords * BITSET_WORD_BITS );
+  uint64_t   * out     =
+    (uint64_t *) malloc( sizeof( uint64_t ) * cov->nrows );
+  int          rsl     = STORE_SUCCESS;
+
+  if ( ( none == NULL ) || ( out == NULL ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+  job.out = out;
+
+  if ( opts->mode == COVERAGE_EXACT )
+    {
+      rsl = cov_exact( & job, opts, none, & best, & nscored );
+    }
+  else
+    {
+      rsl = cov_greedy( & job, opts, none, & best, & nscored );
+    }
+  if ( rsl != STORE_SUCCESS ) goto done;
+
+  * team = (coverage_team_t) {
+    .members = { best.rows[0], best.rows[1], best.rows[2] },
+    .weight  = best.weight,
+    .share   = ( cov->total == 0 ) ? 0.0
+               : (float) ( (double) best.weight / cov->total ),
+    .nscored = nscored
+  };
+
+done:
+  free( none );
+  free( out );
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
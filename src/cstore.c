@@ -3,11 +3,12 @@
 /* ========================================================================== */
 
 #include "cstore.h"
-#include "ext/uthash.h"
 #include "moves.h"
 #include "pokedex.h"
 #include "store.h"
+#include "util/strmap.h"
 #include <assert.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -24,60 +25,169 @@ extern uint16_t     NUM_MOVES;
 
 /* -------------------------------------------------------------------------- */
 
-  int
-cstore_init( store_t * cstore, void * _unused_ )
+/**
+ * The global `POKEDEX' and `MOVES' data never changes, so there only needs to
+ * be one index no matter how many `cstore's are initialized
+ * ( `CSTORE_GLOBAL_STORE' gives each translation unit its own ).
+ * Every `cstore' shares it, the first `init' builds it, and the last `free'
+ * clears it.
+ * <p>
+ * Once built the index is never modified, and `strmap_t' lookups don't write
+ * to the table, so readers don't need to take `CSTORE_LOCK'.
+ */
+static cstore_aux_t    CSTORE_INDEX = {
+  .mons_cnt      = 0,
+  .moves_cnt     = 0,
+  .mons          = NULL,
+  .moves         = NULL,
+  .mons_by_name  = STRMAP_INIT,
+  .moves_by_name = STRMAP_INIT
+};
+static uint32_t        CSTORE_REFS  = 0;
+static pthread_mutex_t CSTORE_LOCK  = PTHREAD_MUTEX_INITIALIZER;
+
+
+  static void
+cstore_index_clear( cstore_aux_t * index )
 {
-  assert( cstore != NULL );
-  cstore->aux = (void *) malloc( sizeof( cstore_aux_t ) );
-  assert( cstore->aux != NULL );
+  strmap_free( & index->mons_by_name );
+  strmap_free( & index->moves_by_name );
+  dense_index_free( & index->dense );
+  free( index->mons );
+  free( index->moves );
+  index->mons  = NULL;
+  index->moves = NULL;
+}
+
+
+/**
+ * `POKEDEX' holds base forms, mostly but not entirely in Dex # order, so we
+ * give every form a dense index and lay out pointers in that order.
+ */
+  static int
+cstore_index_build( cstore_aux_t * index )
+{
+  uint32_t   nforms   = 0;
+  uint32_t * mon_keys = NULL;
+  uint16_t * move_ids = NULL;
+  int        rsl      = STORE_SUCCESS;
 
-  as_csa( cstore )->mons_by_name  = NULL;
-  as_csa( cstore )->mons_cnt      = NUM_POKEMON;
+  strmap_init( & index->mons_by_name );
+  index->mons_cnt = NUM_POKEMON;
 
-  as_csa( cstore )->moves_by_name = NULL;
-  as_csa( cstore )->moves_by_id   = NULL;
-  as_csa( cstore )->moves_cnt     = NUM_MOVES;
+  strmap_init( & index->moves_by_name );
+  index->moves_cnt = NUM_MOVES;
 
   for ( int i = 0; i < NUM_POKEMON; i++ )
     {
-      HASH_ADD_KEYPTR( hh_name,
-                       as_csa( cstore )->mons_by_name,
-                       POKEDEX[i]->name,
-                       strlen( POKEDEX[i]->name ),
-                       POKEDEX[i]
-                     );
+      for ( pdex_mon_t * m = POKEDEX[i]; m != NULL; m = m->next_form )
+        {
+          nforms++;
+        }
+    }
+
+  mon_keys = (uint32_t *) malloc( sizeof( uint32_t ) * max( nforms, 1 ) );
+  move_ids = (uint16_t *) malloc( sizeof( uint16_t ) * max( NUM_MOVES, 1 ) );
+  if ( ( mon_keys == NULL ) || ( move_ids == NULL ) )
+    {
+      free( mon_keys );
+      free( move_ids );
+      return STORE_ERROR_NOMEM;
+    }
+
+  nforms = 0;
+  for ( int i = 0; i < NUM_POKEMON; i++ )
+    {
+      for ( pdex_mon_t * m = POKEDEX[i]; m != NULL; m = m->next_form )
+        {
+          mon_keys[nforms++] = ( (uint32_t) m->dex_number << 8 ) |
+                               m->form_idx;
+        }
+    }
+  for ( int i = 0; i < NUM_MOVES; i++ ) move_ids[i] = MOVES[i].move_id;
+
+  rsl = dense_index_init_keys( & index->dense,
+                               mon_keys,
+                               nforms,
+                               move_ids,
+                               NUM_MOVES
+                             );
+  free( mon_keys );
+  free( move_ids );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+
+  index->mons  = (pdex_mon_t **) malloc( sizeof( pdex_mon_t * ) *
+                                         max( index->dense.nmons, 1 )
+                                       );
+  index->moves = (store_move_t **) malloc( sizeof( store_move_t * ) *
+                                           max( index->dense.nmoves, 1 )
+                                         );
+  if ( ( index->mons == NULL ) || ( index->moves == NULL ) ||
+       ( strmap_reserve( & index->mons_by_name, NUM_POKEMON ) != 0 ) ||
+       ( strmap_reserve( & index->moves_by_name, NUM_MOVES ) != 0 ) )
+    {
+      cstore_index_clear( index );
+      return STORE_ERROR_NOMEM;
+    }
+
+  for ( int i = 0; i < NUM_POKEMON; i++ )
+    {
+      for ( pdex_mon_t * m = POKEDEX[i]; m != NULL; m = m->next_form )
+        {
+          uint32_t mon_idx = 0;
+          rsl = dense_mon_idx( & index->dense,
+                               m->dex_number,
+                               m->form_idx,
+                               & mon_idx
+                             );
+          assert( rsl == STORE_SUCCESS );
+          index->mons[mon_idx] = m;
+        }
+      /* Room was reserved, so this can't fail */
+      strmap_put( & index->mons_by_name, POKEDEX[i]->name, POKEDEX[i] );
     }
 
   for ( int i = 0; i < NUM_MOVES; i++ )
     {
-      HASH_ADD_KEYPTR( hh_name,
-                       as_csa( cstore )->moves_by_name,
-                       MOVES[i].name,
-                       strlen( MOVES[i].name ),
-                       &( MOVES[i] )
-                     );
-      HASH_ADD( hh_move_id,
-                as_csa( cstore )->moves_by_id,
-                move_id,
-                sizeof( uint16_t ),
-                &( MOVES[i] )
-              );
+      strmap_put( & index->moves_by_name, MOVES[i].name, MOVES + i );
+      index->moves[index->dense.move_idx[MOVES[i].move_id]] = MOVES + i;
     }
 
   return STORE_SUCCESS;
 }
 
 
+  int
+cstore_init( store_t * cstore, void * _unused_ )
+{
+  assert( cstore != NULL );
+
+  int rsl = STORE_SUCCESS;
+  pthread_mutex_lock( & CSTORE_LOCK );
+  if ( CSTORE_REFS == 0 ) rsl = cstore_index_build( & CSTORE_INDEX );
+  if ( rsl == STORE_SUCCESS ) CSTORE_REFS++;
+  pthread_mutex_unlock( & CSTORE_LOCK );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+
+  cstore->aux = (void *) & CSTORE_INDEX;
+
+  return STORE_SUCCESS;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   void
 cstore_free( store_t * cstore )
 {
   assert( cstore != NULL );
-  HASH_CLEAR( hh_name, as_csa( cstore )->mons_by_name );
-  HASH_CLEAR( hh_name, as_csa( cstore )->moves_by_name );
-  HASH_CLEAR( hh_move_id, as_csa( cstore )->moves_by_id );
-  free( cstore->aux );
+  if ( cstore->aux == NULL ) return;
+
+  pthread_mutex_lock( & CSTORE_LOCK );
+  assert( 0 < CSTORE_REFS );
+  if ( --CSTORE_REFS == 0 ) cstore_index_clear( & CSTORE_INDEX );
+  pthread_mutex_unlock( & CSTORE_LOCK );
+
   cstore->aux = NULL;
 }
 
@@ -100,37 +210,17 @@ cstore_get_pokemon( cstore_t   *  cstore,
                     pdex_mon_t ** val
                   )
 {
-  pdex_mon_t * mon = NULL;
-  /**
-   * Everything except for Meltan and Melmetal are perfectly sequential, and
-   * their indices are simply their dex # - 1
-   */
-  if ( ( REGIONS[0].dex_start <= dex_num ) &&
-       ( dex_num <= REGIONS[NUM_REGIONS - 2].dex_end )
-     )
-    {
-      mon = POKEDEX[dex_num - 1];
-    }
-  else
-    {
-      mon = POKEDEX[dex_num - REGIONS[NUM_REGIONS - 1].dex_start
-                            + REGIONS[NUM_REGIONS - 2].dex_end
-                   ];
-    }
-  assert( dex_num == mon->dex_number );
-
-  for ( uint8_t f = 0; f < form_idx; f++ )
+  uint32_t mon_idx = 0;
+  if ( dense_mon_idx( & as_csa( cstore )->dense,
+                      dex_num,
+                      form_idx,
+                      & mon_idx
+                    ) != STORE_SUCCESS )
     {
-      if ( mon->next_form == NULL )
-        {
-          *val = NULL;
-          return STORE_ERROR_NOT_FOUND;
-        }
-      mon = mon->next_form;
+      if ( val != NULL ) *val = NULL;
+      return STORE_ERROR_NOT_FOUND;
     }
-  assert( form_idx == mon->form_idx );
-
-  *val = mon;
+  if ( val != NULL ) *val = as_csa( cstore )->mons[mon_idx];
   return STORE_SUCCESS;
 }
 
@@ -143,13 +233,7 @@ cstore_get_pokemon_by_name( store_t    *  cstore,
                             pdex_mon_t ** val
                           )
 {
-  pdex_mon_t * mon = NULL;
-  HASH_FIND( hh_name,
-             as_csa( cstore )->mons_by_name,
-             name,
-             strlen( name ),
-             mon
-           );
+  pdex_mon_t * mon = strmap_get( & as_csa( cstore )->mons_by_name, name );
   if ( val != NULL ) *val = mon;
   return ( mon != NULL ) ? STORE_SUCCESS : STORE_ERROR_NOT_FOUND;
 }
@@ -157,18 +241,18 @@ cstore_get_pokemon_by_name( store_t    *  cstore,
 
 /* -------------------------------------------------------------------------- */
 
- int
-cstore_get_move( store_t * cstore, uint16_t move_id, store_move_t ** val)
+  int
+cstore_get_move( store_t * cstore, uint16_t move_id, store_move_t ** val )
 {
-  store_move_t * move = NULL;
-  HASH_FIND( hh_move_id,
-             as_csa( cstore )->moves_by_id,
-             & move_id,
-             sizeof( uint16_t ),
-             move
-           );
-  if ( val != NULL ) *val = move;
-  return ( move != NULL ) ? STORE_SUCCESS : STORE_ERROR_NOT_FOUND;
+  uint16_t move_idx = 0;
+  if ( dense_move_idx( & as_csa( cstore )->dense, move_id, & move_idx ) !=
+       STORE_SUCCESS )
+    {
+      if ( val != NULL ) *val = NULL;
+      return STORE_ERROR_NOT_FOUND;
+    }
+  if ( val != NULL ) *val = as_csa( cstore )->moves[move_idx];
+  return STORE_SUCCESS;
 }
 
 
@@ -180,13 +264,7 @@ cstore_get_move_by_name( store_t      *  cstore,
                          store_move_t ** val
                        )
 {
-  store_move_t * move = NULL;
-  HASH_FIND( hh_name,
-             as_csa( cstore )->moves_by_name,
-             name,
-             strlen( name ),
-             move
-           );
+  store_move_t * move = strmap_get( & as_csa( cstore )->moves_by_name, name );
   if ( val != NULL ) *val = move;
   return ( move != NULL ) ? STORE_SUCCESS : STORE_ERROR_NOT_FOUND;
 }
@@ -222,6 +300,111 @@ cstore_get( store_t * cstore, store_key_t key, void ** val )
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Rosters tend to be sorted by species, so runs of identical keys are common.
+ * We remember the last key we looked up and skip the lookup for repeats.
+ */
+  int
+cstore_get_many( store_t           *  cstore,
+                 const store_key_t *  keys,
+                 size_t               n,
+                 void              ** vals,
+                 int               *  status
+               )
+{
+  assert( cstore != NULL );
+  assert( ( keys != NULL ) || ( n == 0 ) );
+  assert( ( vals != NULL ) || ( n == 0 ) );
+
+  int         rsl  = STORE_SUCCESS;
+  int         s    = STORE_ERROR_BAD_VALUE;
+  store_key_t last = { .key_type = STORE_UNKNOWN };
+
+  for ( size_t i = 0; i < n; i++ )
+    {
+      if ( ( i != 0 )                               &&
+           ( keys[i].key_type == last.key_type )    &&
+           ( keys[i].val_type == last.val_type )    &&
+           ( keys[i].data_f   == last.data_f )
+         )
+        {
+          vals[i] = vals[i - 1];
+        }
+      else if ( ( keys[i].key_type == STORE_NUM  ) &&
+                ( keys[i].val_type == STORE_MOVE )
+              )
+        {
+          s = cstore_get_move( cstore,
+                               keys[i].data_h0,
+                               (store_move_t **) ( vals + i )
+                             );
+        }
+      else if ( ( keys[i].key_type == STORE_NUM  )    &&
+                ( keys[i].val_type == STORE_POKEDEX )
+              )
+        {
+          s = cstore_get_pokemon( cstore,
+                                  keys[i].data_h0,
+                                  keys[i].data_q2,
+                                  (pdex_mon_t **) ( vals + i )
+                                );
+        }
+      else
+        {
+          vals[i] = NULL;
+          s       = STORE_ERROR_BAD_VALUE;
+        }
+      last = keys[i];
+      if ( status != NULL ) status[i] = s;
+      if ( ( s != STORE_SUCCESS ) && ( rsl == STORE_SUCCESS ) ) rsl = s;
+    }
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+cstore_each( store_t       * cstore,
+             store_type_t    val_type,
+             store_each_cb   cb,
+             void          * ctx
+           )
+{
+  assert( cstore != NULL );
+  assert( cb != NULL );
+
+  cstore_aux_t * csa = as_csa( cstore );
+  int            rsl = STORE_SUCCESS;
+
+  /* In dense index order, by Dex # and form, or by move ID */
+  if ( val_type == STORE_POKEDEX )
+    {
+      for ( uint32_t i = 0; i < csa->dense.nmons; i++ )
+        {
+          rsl = cb( ctx, pdex_store_key( csa->mons[i] ), csa->mons[i] );
+          if ( rsl != STORE_SUCCESS ) return rsl;
+        }
+      return STORE_SUCCESS;
+    }
+
+  if ( val_type == STORE_MOVE )
+    {
+      for ( uint16_t i = 0; i < csa->dense.nmoves; i++ )
+        {
+          rsl = cb( ctx, move_store_key( csa->moves[i] ), csa->moves[i] );
+          if ( rsl != STORE_SUCCESS ) return rsl;
+        }
+      return STORE_SUCCESS;
+    }
+
+  return STORE_ERROR_BAD_VALUE;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   int
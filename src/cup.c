@@ -0,0 +1,547 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "cup.h"
+#include "filter_index.h"
+#include "moves.h"
+#include "name_index.h"
+#include "pokedex.h"
+#include "ptypes.h"
+#include "store.h"
+#include <assert.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+typedef enum {
+  CUP_TOK_END,
+  CUP_TOK_LPAREN,
+  CUP_TOK_RPAREN,
+  CUP_TOK_AND,
+  CUP_TOK_OR,
+  CUP_TOK_NOT,
+  CUP_TOK_WORD,
+  CUP_TOK_BAD
+} cup_token_t;
+
+struct cup_parser_s {
+  const filter_index_t * idx;
+  cup_program_t        * prog;
+  const char           * pos;    /* Start of the next token */
+  const char           * word;   /* Start of the current token */
+  size_t                 len;    /* Length of the current token */
+  cup_token_t            tok;
+  uint32_t               depth;  /* Of the stack when the program runs */
+  uint32_t               nest;   /* Of `(' and `!' being parsed */
+};
+
+
+  static inline bool
+cup_word_char( char c )
+{
+  return isalnum( (unsigned char) c ) || ( c == '_' ) || ( c == ':' ) ||
+         ( c == '-' ) || ( c == '.' ) || ( c == '\'' );
+}
+
+
+  static bool
+cup_word_is( const struct cup_parser_s * p, const char * kw )
+{
+  return ( strlen( kw ) == p->len ) &&
+         ( strncasecmp( p->word, kw, p->len ) == 0 );
+}
+
+
+  static void
+cup_next( struct cup_parser_s * p )
+{
+  while ( isspace( (unsigned char) *p->pos ) ) p->pos++;
+  p->word = p->pos;
+  p->len  = 1;
+
+  switch ( *p->pos )
+    {
+    case '\0': p->tok = CUP_TOK_END;    p->len = 0; return;
+    case '(':  p->tok = CUP_TOK_LPAREN; p->pos++;   return;
+    case ')':  p->tok = CUP_TOK_RPAREN; p->pos++;   return;
+    case '&':
+    case ',':  p->tok = CUP_TOK_AND;    p->pos++;   return;
+    case '|':
+    case '+':  p->tok = CUP_TOK_OR;     p->pos++;   return;
+    case '!':  p->tok = CUP_TOK_NOT;    p->pos++;   return;
+    default:   break;
+    }
+
+  if ( ! cup_word_char( *p->pos ) )
+    {
+      p->tok = CUP_TOK_BAD;
+      return;
+    }
+  while ( cup_word_char( *p->pos ) ) p->pos++;
+  p->len = p->pos - p->word;
+
+  if ( cup_word_is( p, "and" ) )      p->tok = CUP_TOK_AND;
+  else if ( cup_word_is( p, "or" ) )  p->tok = CUP_TOK_OR;
+  else if ( cup_word_is( p, "not" ) ) p->tok = CUP_TOK_NOT;
+  else if ( cup_word_is( p, "no" ) )  p->tok = CUP_TOK_NOT;
+  else                                p->tok = CUP_TOK_WORD;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+cup_emit( struct cup_parser_s * p, cup_op_t op )
+{
+  cup_program_t * prog = p->prog;
+
+  if ( ( op.op == CUP_OP_SET ) || ( op.op == CUP_OP_RANGE ) )
+    {
+      if ( CUP_MAX_DEPTH <= p->depth ) return false;
+      p->depth++;
+    }
+  else if ( op.op != CUP_OP_NOT )
+    {
+      p->depth--;
+    }
+
+  if ( prog->nops == prog->cap )
+    {
+      uint32_t   cap = ( prog->cap == 0 ) ? 16 : prog->cap * 2;
+      cup_op_t * tmp = realloc( prog->ops, sizeof( cup_op_t ) * cap );
+      if ( tmp == NULL ) return false;
+      prog->ops = tmp;
+      prog->cap = cap;
+    }
+  prog->ops[prog->nops++] = op;
+
+  return true;
+}
+
+
+/* First dense index whose Dex # is at least `dex_num'. */
+  static uint32_t
+cup_dex_lower_bound( const filter_index_t * idx, uint32_t dex_num )
+{
+  if ( idx->dense.max_dex < dex_num ) return idx->nmons;
+  return idx->dense.dex_start[dex_num];
+}
+
+
+  static bool
+cup_parse_uint( const char * str, uint32_t * out )
+{
+  char * end = NULL;
+  if ( ! isdigit( (unsigned char) *str ) ) return false;
+  *out = strtoul( str, & end, 10 );
+  return *end == '\0';
+}
+
+
+/* Find a Pokemon by Dex # or by name. */
+  static const pdex_mon_t *
+cup_find_mon( const filter_index_t * idx, const char * name )
+{
+  char         norm[NAME_INDEX_MAX_LEN + 1];
+  pdex_mon_t * mon = NULL;
+  uint32_t     dex = 0;
+  int          rsl = STORE_ERROR_NOT_FOUND;
+
+  if ( cup_parse_uint( name, & dex ) )
+    {
+      /* Only ask the store for Pokemon it is known to have */
+      if ( ( UINT16_MAX < dex ) ||
+           ( dense_forms_cnt( & idx->dense, dex ) == 0 ) )
+        {
+          return NULL;
+        }
+      rsl = idx->store->get( idx->store,
+                             dex_form_store_key( dex, 0 ),
+                             (void **) & mon
+                           );
+    }
+  else if ( idx->store->get_str_t != NULL )
+    {
+      name_index_normalize( name, norm );
+      rsl = idx->store->get_str_t( idx->store,
+                                   STORE_POKEDEX,
+                                   norm,
+                                   (void **) & mon
+                                 );
+    }
+
+  return ( rsl == STORE_SUCCESS ) ? mon : NULL;
+}
+
+
+/* Find a move ID by name or number, `0' if the store doesn't have it. */
+  static uint16_t
+cup_find_move( const filter_index_t * idx, const char * name )
+{
+  char           norm[NAME_INDEX_MAX_LEN + 1];
+  store_move_t * move = NULL;
+  uint32_t       id   = 0;
+
+  if ( cup_parse_uint( name, & id ) )
+    {
+      return ( ( id <= UINT16_MAX ) &&
+               ( dense_move_idx( & idx->dense, id, NULL ) == STORE_SUCCESS )
+             ) ? id : 0;
+    }
+  if ( idx->store->get_str_t == NULL ) return 0;
+  name_index_normalize( name, norm );
+  if ( idx->store->get_str_t( idx->store,
+                              STORE_MOVE,
+                              norm,
+                              (void **) & move
+                            ) != STORE_SUCCESS )
+    {
+      return 0;
+    }
+  return move->move_id;
+}
+
+
+  static bool
+cup_find_type( const char * name, ptype_t * type )
+{
+  for ( uint8_t t = 1; t < NUM_PTYPES; t++ )
+    {
+      if ( strcasecmp( name, get_ptype_name( t ) ) == 0 )
+        {
+          *type = t;
+          return true;
+        }
+    }
+  return false;
+}
+
+
+/**
+ * Resolve a word such as `type:fairy' to an operand.
+ * `kind' is empty for bare words.
+ */
+  static bool
+cup_term( struct cup_parser_s * p, const char * kind, char * val )
+{
+  const filter_index_t * idx  = p->idx;
+  const bool             bare = ( *kind == '\0' );
+  cup_op_t               op   = { .op = CUP_OP_SET, .set = NULL };
+
+  if ( bare && ( strcasecmp( val, "all" ) == 0 ) )
+    {
+      op.set = idx->all;
+      return cup_emit( p, op );
+    }
+
+  if ( bare || ( strcasecmp( kind, "region" ) == 0 ) )
+    {
+      for ( uint8_t r = 0; r < NUM_REGIONS; r++ )
+        {
+          if ( strcasecmp( val, REGIONS[r].name ) == 0 )
+            {
+              op.set = filter_index_region_set( idx, r );
+              return cup_emit( p, op );
+            }
+        }
+    }
+
+  if ( bare || ( strcasecmp( kind, "type" ) == 0 ) )
+    {
+      ptype_t type = PT_NONE;
+      if ( cup_find_type( val, & type ) )
+        {
+          op.set = filter_index_type_set( idx, type );
+          return cup_emit( p, op );
+        }
+    }
+
+  if ( bare || ( strcasecmp( kind, "tag" ) == 0 ) )
+    {
+      for ( uint8_t t = 1; t < NUM_PDEX_TAGS; t++ )
+        {
+          if ( strcasecmp( val, get_pdex_tag_name( t ) ) == 0 )
+            {
+              op.set = filter_index_tag_set( idx, t );
+              return cup_emit( p, op );
+            }
+        }
+    }
+
+  if ( bare ) return false;
+
+  if ( strcasecmp( kind, "family" ) == 0 )
+    {
+      const pdex_mon_t * mon = cup_find_mon( idx, val );
+      if ( mon == NULL ) return false;
+      op.set = filter_index_family_set( idx, mon->family );
+      if ( op.set == NULL )
+        {
+          op = (cup_op_t) { .op = CUP_OP_RANGE, .lo = 0, .hi = 0 };
+        }
+      return cup_emit( p, op );
+    }
+
+  if ( strcasecmp( kind, "move" ) == 0 )
+    {
+      uint16_t move_id = cup_find_move( idx, val );
+      if ( move_id == 0 ) return false;
+      /* A move the store knows by name may still be missing from the index */
+      op.set = filter_index_learner_set( idx, move_id );
+      if ( op.set == NULL )
+        {
+          op = (cup_op_t) { .op = CUP_OP_RANGE, .lo = 0, .hi = 0 };
+        }
+      return cup_emit( p, op );
+    }
+
+  if ( ( strcasecmp( kind, "fast" ) == 0 ) ||
+       ( strcasecmp( kind, "charged" ) == 0 ) )
+    {
+      ptype_t type = PT_NONE;
+      if ( ! cup_find_type( val, & type ) ) return false;
+      op.set = ( tolower( (unsigned char) *kind ) == 'f' )
+               ? filter_index_fast_type_set( idx, type )
+               : filter_index_charged_type_set( idx, type );
+      return cup_emit( p, op );
+    }
+
+  if ( ( strcasecmp( kind, "mon" ) == 0 ) ||
+       ( strcasecmp( kind, "species" ) == 0 ) )
+    {
+      const pdex_mon_t * mon = cup_find_mon( idx, val );
+      if ( mon == NULL ) return false;
+      op.op = CUP_OP_RANGE;
+      op.lo = cup_dex_lower_bound( idx, mon->dex_number );
+      op.hi = cup_dex_lower_bound( idx, mon->dex_number + 1 );
+      return cup_emit( p, op );
+    }
+
+  if ( strcasecmp( kind, "dex" ) == 0 )
+    {
+      uint32_t lo   = 0;
+      uint32_t hi   = 0;
+      char   * dash = strchr( val, '-' );
+      if ( dash != NULL ) *dash = '\0';
+      if ( ! cup_parse_uint( val, & lo ) ) return false;
+      if ( dash == NULL )                  hi = lo;
+      else if ( ! cup_parse_uint( dash + 1, & hi ) ) return false;
+      if ( hi < lo ) return false;
+      op.op = CUP_OP_RANGE;
+      op.lo = cup_dex_lower_bound( idx, lo );
+      op.hi = cup_dex_lower_bound( idx, hi + 1 );
+      return cup_emit( p, op );
+    }
+
+  return false;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+static bool cup_parse_or( struct cup_parser_s * p );
+
+  static bool
+cup_parse_primary( struct cup_parser_s * p )
+{
+  char buffer[NAME_INDEX_MAX_LEN + 1];
+
+  if ( p->tok == CUP_TOK_LPAREN )
+    {
+      if ( CUP_MAX_DEPTH <= p->nest ) return false;
+      p->nest++;
+      cup_next( p );
+      if ( ! cup_parse_or( p ) ) return false;
+      if ( p->tok != CUP_TOK_RPAREN ) return false;
+      p->nest--;
+      cup_next( p );
+      return true;
+    }
+
+  if ( ( p->tok != CUP_TOK_WORD ) || ( NAME_INDEX_MAX_LEN < p->len ) )
+    {
+      return false;
+    }
+  memcpy( buffer, p->word, p->len );
+  buffer[p->len] = '\0';
+
+  char * colon = strchr( buffer, ':' );
+  bool   ok    = false;
+  if ( colon == NULL )
+    {
+      ok = cup_term( p, "", buffer );
+    }
+  else
+    {
+      *colon = '\0';
+      ok = cup_term( p, buffer, colon + 1 );
+    }
+  if ( ok ) cup_next( p );
+
+  return ok;
+}
+
+
+  static bool
+cup_parse_unary( struct cup_parser_s * p )
+{
+  if ( p->tok != CUP_TOK_NOT ) return cup_parse_primary( p );
+  /* `!' doesn't grow the stack, so only this bounds the recursion */
+  if ( CUP_MAX_DEPTH <= p->nest ) return false;
+  p->nest++;
+  cup_next( p );
+  if ( ! cup_parse_unary( p ) ) return false;
+  p->nest--;
+  return cup_emit( p, (cup_op_t) { .op = CUP_OP_NOT } );
+}
+
+
+  static bool
+cup_parse_and( struct cup_parser_s * p )
+{
+  if ( ! cup_parse_unary( p ) ) return false;
+  while ( p->tok == CUP_TOK_AND )
+    {
+      cup_next( p );
+      if ( ! cup_parse_unary( p ) ) return false;
+      if ( ! cup_emit( p, (cup_op_t) { .op = CUP_OP_AND } ) ) return false;
+    }
+  return true;
+}
+
+
+  static bool
+cup_parse_or( struct cup_parser_s * p )
+{
+  if ( ! cup_parse_and( p ) ) return false;
+  while ( p->tok == CUP_TOK_OR )
+    {
+      cup_next( p );
+      if ( ! cup_parse_and( p ) ) return false;
+      if ( ! cup_emit( p, (cup_op_t) { .op = CUP_OP_OR } ) ) return false;
+    }
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+cup_compile( const filter_index_t * idx,
+             const char           * query,
+             cup_program_t        * prog,
+             size_t               * err_pos
+           )
+{
+  assert( idx != NULL );
+  assert( query != NULL );
+  assert( prog != NULL );
+
+  struct cup_parser_s p = {
+    .idx   = idx,
+    .prog  = prog,
+    .pos   = query,
+    .depth = 0,
+    .nest  = 0
+  };
+
+  *prog = (cup_program_t) CUP_PROGRAM_INIT;
+  cup_next( & p );
+  if ( cup_parse_or( & p ) && ( p.tok == CUP_TOK_END ) )
+    {
+      assert( p.depth == 1 );
+      return STORE_SUCCESS;
+    }
+
+  if ( err_pos != NULL ) *err_pos = p.word - query;
+  cup_program_free( prog );
+  return STORE_ERROR_BAD_VALUE;
+}
+
+
+  void
+cup_program_free( cup_program_t * prog )
+{
+  assert( prog != NULL );
+  free( prog->ops );
+  *prog = (cup_program_t) CUP_PROGRAM_INIT;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Bits `lo' to `hi - 1' that fall in word `w'. */
+  static inline uint64_t
+cup_range_word( uint32_t lo, uint32_t hi, size_t w )
+{
+  const size_t base = w * BITSET_WORD_BITS;
+  if ( ( hi <= base ) || ( base + BITSET_WORD_BITS <= lo ) ) return 0;
+
+  size_t   a    = ( lo <= base ) ? 0 : lo - base;
+  size_t   b    = ( base + BITSET_WORD_BITS <= hi ) ? BITSET_WORD_BITS
+                                                    : hi - base;
+  uint64_t high = ( b == BITSET_WORD_BITS ) ? ~ (uint64_t) 0
+                                            : ( ( (uint64_t) 1 ) << b ) - 1;
+  return high & ~ ( ( ( (uint64_t) 1 ) << a ) - 1 );
+}
+
+
+  void
+cup_program_eval( const filter_index_t * idx,
+                  const cup_program_t  * prog,
+                  uint64_t             * out
+                )
+{
+  assert( idx != NULL );
+  assert( prog != NULL );
+  assert( out != NULL );
+
+  uint64_t stack[CUP_MAX_DEPTH];
+
+  for ( size_t w = 0; w < idx->nwords; w++ )
+    {
+      uint32_t sp = 0;
+      for ( uint32_t i = 0; i < prog->nops; i++ )
+        {
+          const cup_op_t * op = prog->ops + i;
+          switch ( op->op )
+            {
+            case CUP_OP_SET:
+              stack[sp++] = op->set[w];
+              break;
+            case CUP_OP_RANGE:
+              stack[sp++] = cup_range_word( op->lo, op->hi, w );
+              break;
+            case CUP_OP_NOT:
+              stack[sp - 1] = ~ stack[sp - 1];
+              break;
+            case CUP_OP_AND:
+              sp--;
+              stack[sp - 1] &= stack[sp];
+              break;
+            case CUP_OP_OR:
+              sp--;
+              stack[sp - 1] |= stack[sp];
+              break;
+            }
+        }
+      /* `NOT' may have set bits past the last Pokemon */
+      out[w] = ( sp == 0 ) ? 0 : ( stack[0] & idx->all[w] );
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
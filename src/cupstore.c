@@ -0,0 +1,367 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "cup.h"
+#include "cupstore.h"
+#include "filter_index.h"
+#include "store.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+cupstore_init( store_t * cupstore, void * base )
+{
+  assert( cupstore != NULL );
+  assert( base != NULL );
+
+  cupstore->aux = calloc( 1, sizeof( cupstore_aux_t ) );
+  if ( cupstore->aux == NULL ) return STORE_ERROR_NOMEM;
+  as_cupsa( cupstore )->base = (store_t *) base;
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static void
+cup_entry_free( cup_entry_t * entry )
+{
+  if ( entry == NULL ) return;
+  free( entry->cup.name );
+  free( entry->cup.query );
+  free( entry->pool );
+  cup_program_free( & entry->program );
+  free( entry );
+}
+
+
+  void
+cupstore_free( store_t * cupstore )
+{
+  assert( cupstore != NULL );
+  cupstore_aux_t * csa = as_cupsa( cupstore );
+  if ( csa == NULL ) return;
+
+  for ( uint32_t i = 0; i < csa->cnt; i++ ) cup_entry_free( csa->cups[i] );
+  free( csa->cups );
+  if ( csa->indexed ) filter_index_free( & csa->index );
+  free( csa );
+  cupstore->aux = NULL;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Rebuild the index if the Pokedex store has changed since it was built.
+ * Programs point into the index, so every cup is recompiled and every pool
+ * goes stale.
+ * Cups already handed out have their `index' and `pool' cleared rather than
+ * left pointing at freed memory, and are filled again by the next `get'.
+ * A cup whose query no longer compiles is left without a program.
+ */
+  static int
+cupstore_refresh( cupstore_aux_t * csa )
+{
+  if ( csa->indexed &&
+       ( csa->index_version == store_version( csa->base ) ) )
+    {
+      return STORE_SUCCESS;
+    }
+
+  if ( csa->indexed ) filter_index_free( & csa->index );
+  csa->indexed = false;
+  int rsl = filter_index_init( & csa->index, csa->base );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  csa->indexed       = true;
+  csa->index_version = store_version( csa->base );
+
+  for ( uint32_t i = 0; i < csa->cnt; i++ )
+    {
+      cup_entry_t * entry = csa->cups[i];
+      cup_program_free( & entry->program );
+      free( entry->pool );
+      entry->pool          = NULL;
+      entry->fresh         = false;
+      entry->cup.index     = NULL;
+      entry->cup.pool      = NULL;
+      entry->cup.pool_size = 0;
+      cup_compile( & csa->index, entry->cup.query, & entry->program, NULL );
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+  static cup_entry_t *
+cupstore_find( cupstore_aux_t * csa, const char * name, uint32_t * cup_idx )
+{
+  for ( uint32_t i = 0; i < csa->cnt; i++ )
+    {
+      if ( strcmp( csa->cups[i]->cup.name, name ) == 0 )
+        {
+          if ( cup_idx != NULL ) *cup_idx = i;
+          return csa->cups[i];
+        }
+    }
+  return NULL;
+}
+
+
+/* Build a new entry from `cup', compiling its query. */
+  static int
+cup_entry_new( cupstore_aux_t * csa, const cup_t * cup, cup_entry_t ** out )
+{
+  if ( ( cup == NULL ) || ( cup->name == NULL ) || ( cup->query == NULL ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  int rsl = cupstore_refresh( csa );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+
+  cup_entry_t * entry = (cup_entry_t *) calloc( 1, sizeof( cup_entry_t ) );
+  if ( entry == NULL ) return STORE_ERROR_NOMEM;
+
+  rsl = cup_compile( & csa->index, cup->query, & entry->program, NULL );
+  if ( rsl != STORE_SUCCESS )
+    {
+      free( entry );
+      return rsl;
+    }
+
+  entry->cup.name   = strdup( cup->name );
+  entry->cup.query  = strdup( cup->query );
+  entry->cup.cp_cap = cup->cp_cap;
+  if ( ( entry->cup.name == NULL ) || ( entry->cup.query == NULL ) )
+    {
+      cup_entry_free( entry );
+      return STORE_ERROR_NOMEM;
+    }
+
+  *out = entry;
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+cupstore_has( store_t * cupstore, store_key_t key )
+{
+  assert( cupstore != NULL );
+  return ( key.key_type == STORE_NUM ) && ( key.val_type == STORE_CUP ) &&
+         ( key.data_f < as_cupsa( cupstore )->cnt );
+}
+
+
+  int
+cupstore_get( store_t * cupstore, store_key_t key, void ** val )
+{
+  assert( cupstore != NULL );
+  cupstore_aux_t * csa = as_cupsa( cupstore );
+
+  if ( val != NULL ) *val = NULL;
+  if ( ( key.key_type != STORE_NUM ) || ( key.val_type != STORE_CUP ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( csa->cnt <= key.data_f ) return STORE_ERROR_NOT_FOUND;
+  if ( val == NULL ) return STORE_SUCCESS;
+
+  int rsl = cupstore_refresh( csa );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+
+  cup_entry_t * entry = csa->cups[key.data_f];
+  if ( ! entry->fresh )
+    {
+      if ( entry->program.nops == 0 ) return STORE_ERROR_BAD_VALUE;
+      if ( entry->pool == NULL )
+        {
+          entry->pool = filter_index_alloc_set( & csa->index );
+          if ( entry->pool == NULL ) return STORE_ERROR_NOMEM;
+        }
+      cup_program_eval( & csa->index, & entry->program, entry->pool );
+      entry->cup.index     = & csa->index;
+      entry->cup.pool      = entry->pool;
+      entry->cup.pool_size = filter_index_count( & csa->index, entry->pool );
+      entry->fresh         = true;
+    }
+
+  *val = (void *) & entry->cup;
+  return STORE_SUCCESS;
+}
+
+
+  int
+cupstore_get_str( store_t * cupstore, const char * name, void ** val )
+{
+  assert( cupstore != NULL );
+  assert( name != NULL );
+
+  uint32_t i = 0;
+  if ( cupstore_find( as_cupsa( cupstore ), name, & i ) == NULL )
+    {
+      if ( val != NULL ) *val = NULL;
+      return STORE_ERROR_NOT_FOUND;
+    }
+  return cupstore_get( cupstore, cup_store_key( i ), val );
+}
+
+
+  int
+cupstore_get_str_t( store_t      *  cupstore,
+                    store_type_t    val_type,
+                    const char   *  name,
+                    void         ** val
+                  )
+{
+  if ( val_type != STORE_CUP ) return STORE_ERROR_BAD_VALUE;
+  return cupstore_get_str( cupstore, name, val );
+}
+
+
+  int
+cupstore_each( store_t       * cupstore,
+               store_type_t    val_type,
+               store_each_cb   cb,
+               void          * ctx
+             )
+{
+  assert( cupstore != NULL );
+  assert( cb != NULL );
+
+  if ( val_type != STORE_CUP ) return STORE_ERROR_BAD_VALUE;
+
+  for ( uint32_t i = 0; i < as_cupsa( cupstore )->cnt; i++ )
+    {
+      void        * val = NULL;
+      store_key_t   key = cup_store_key( i );
+      int           rsl = cupstore_get( cupstore, key, & val );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+      rsl = cb( ctx, key, val );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+cupstore_add( store_t * cupstore, store_key_t key, void * val )
+{
+  assert( cupstore != NULL );
+  cupstore_aux_t * csa   = as_cupsa( cupstore );
+  cup_entry_t    * entry = NULL;
+  const cup_t    * cup   = (const cup_t *) val;
+
+  if ( ( key.key_type != STORE_NUM ) || ( key.val_type != STORE_CUP ) ||
+       ( key.data_f != csa->cnt ) || ( cup == NULL ) || ( cup->name == NULL )
+     )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( cupstore_find( csa, cup->name, NULL ) != NULL )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  if ( csa->cnt == csa->cap )
+    {
+      uint32_t       cap = ( csa->cap == 0 ) ? 8 : csa->cap * 2;
+      cup_entry_t ** tmp = realloc( csa->cups, sizeof( cup_entry_t * ) * cap );
+      if ( tmp == NULL ) return STORE_ERROR_NOMEM;
+      csa->cups = tmp;
+      csa->cap  = cap;
+    }
+
+  int rsl = cup_entry_new( csa, cup, & entry );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  csa->cups[csa->cnt++] = entry;
+  store_touch( cupstore );
+
+  return STORE_SUCCESS;
+}
+
+
+  int
+cupstore_set( store_t * cupstore, store_key_t key, void * val )
+{
+  assert( cupstore != NULL );
+  cupstore_aux_t * csa   = as_cupsa( cupstore );
+  cup_entry_t    * entry = NULL;
+  const cup_t    * cup   = (const cup_t *) val;
+  uint32_t         other = 0;
+
+  if ( ! cupstore_has( cupstore, key ) ) return STORE_ERROR_NOT_FOUND;
+  if ( ( cup != NULL ) && ( cup->name != NULL ) &&
+       ( cupstore_find( csa, cup->name, & other ) != NULL ) &&
+       ( other != key.data_f ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  int rsl = cup_entry_new( csa, cup, & entry );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  cup_entry_free( csa->cups[key.data_f] );
+  csa->cups[key.data_f] = entry;
+  store_touch( cupstore );
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+cupstore_add_cup( cupstore_t * cupstore,
+                  const char * name,
+                  uint16_t     cp_cap,
+                  const char * query
+                )
+{
+  cup_t cup = {
+    .name   = (char *) name,
+    .query  = (char *) query,
+    .cp_cap = cp_cap
+  };
+  return cupstore_add( cupstore,
+                       cup_store_key( cupstore_count( cupstore ) ),
+                       & cup
+                     );
+}
+
+
+  int
+cupstore_add_defaults( cupstore_t * cupstore )
+{
+  for ( size_t i = 0; i < array_size( CUP_DEFAULTS ); i++ )
+    {
+      int rsl = cupstore_add_cup( cupstore,
+                                  CUP_DEFAULTS[i].name,
+                                  CUP_DEFAULTS[i].cp_cap,
+                                  CUP_DEFAULTS[i].query
+                                );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+    }
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,244 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "dense_index.h"
+#include "moves.h"
+#include "pokedex.h"
+#include "store.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Keys gathered by `store_each' */
+struct dense_keys_s {
+  uint32_t * mon_keys;
+  uint32_t   nmons;
+  uint32_t   mons_cap;
+  uint16_t * move_ids;
+  uint32_t   nmoves;
+  uint32_t   moves_cap;
+};
+
+
+  static int
+dense_collect_mon_cb( void * ctx, store_key_t key, void * val )
+{
+  struct dense_keys_s * keys = (struct dense_keys_s *) ctx;
+  const pdex_mon_t    * mon  = (const pdex_mon_t *) val;
+
+  if ( keys->nmons == keys->mons_cap )
+    {
+      uint32_t   cap = ( keys->mons_cap == 0 ) ? 1024 : keys->mons_cap * 2;
+      uint32_t * tmp = realloc( keys->mon_keys, sizeof( uint32_t ) * cap );
+      if ( tmp == NULL ) return STORE_ERROR_NOMEM;
+      keys->mon_keys = tmp;
+      keys->mons_cap = cap;
+    }
+  keys->mon_keys[keys->nmons++] = ( (uint32_t) mon->dex_number << 8 ) |
+                                  mon->form_idx;
+
+  return STORE_SUCCESS;
+}
+
+
+  static int
+dense_collect_move_cb( void * ctx, store_key_t key, void * val )
+{
+  struct dense_keys_s * keys = (struct dense_keys_s *) ctx;
+  const store_move_t  * move = (const store_move_t *) val;
+
+  if ( keys->nmoves == keys->moves_cap )
+    {
+      uint32_t   cap = ( keys->moves_cap == 0 ) ? 512 : keys->moves_cap * 2;
+      uint16_t * tmp = realloc( keys->move_ids, sizeof( uint16_t ) * cap );
+      if ( tmp == NULL ) return STORE_ERROR_NOMEM;
+      keys->move_ids  = tmp;
+      keys->moves_cap = cap;
+    }
+  keys->move_ids[keys->nmoves++] = move->move_id;
+
+  return STORE_SUCCESS;
+}
+
+
+  static int
+cmp_u32( const void * a, const void * b )
+{
+  uint32_t x = * (const uint32_t *) a;
+  uint32_t y = * (const uint32_t *) b;
+  return ( x > y ) - ( x < y );
+}
+
+
+  static int
+cmp_u16( const void * a, const void * b )
+{
+  return * (const uint16_t *) a - * (const uint16_t *) b;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+dense_index_init( dense_index_t * idx, store_t * store )
+{
+  assert( idx != NULL );
+  assert( store != NULL );
+
+  struct dense_keys_s keys;
+  memset( & keys, 0, sizeof( struct dense_keys_s ) );
+
+  int rsl = store_each( store, STORE_POKEDEX, dense_collect_mon_cb, & keys );
+  if ( rsl == STORE_SUCCESS )
+    {
+      rsl = store_each( store, STORE_MOVE, dense_collect_move_cb, & keys );
+    }
+  if ( ( rsl == STORE_SUCCESS ) && ( UINT16_MAX <= keys.nmoves ) )
+    {
+      rsl = STORE_ERROR_BAD_VALUE;
+    }
+  if ( rsl == STORE_SUCCESS )
+    {
+      rsl = dense_index_init_keys( idx,
+                                   keys.mon_keys,
+                                   keys.nmons,
+                                   keys.move_ids,
+                                   (uint16_t) keys.nmoves
+                                 );
+    }
+  if ( rsl == STORE_SUCCESS ) idx->version = store_version( store );
+
+  free( keys.mon_keys );
+  free( keys.move_ids );
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+dense_index_init_keys( dense_index_t  * idx,
+                       const uint32_t * mon_keys,
+                       uint32_t         nmons,
+                       const uint16_t * move_ids,
+                       uint16_t         nmoves
+                     )
+{
+  assert( idx != NULL );
+  assert( ( mon_keys != NULL ) || ( nmons == 0 ) );
+  assert( ( move_ids != NULL ) || ( nmoves == 0 ) );
+
+  memset( idx, 0, sizeof( dense_index_t ) );
+
+  /* Sorted copies double as the reverse lookups once duplicates are gone */
+  uint32_t * keys = (uint32_t *) malloc( sizeof( uint32_t ) * max( nmons, 1 ) );
+  idx->move_id    = (uint16_t *) malloc( sizeof( uint16_t ) *
+                                         max( nmoves, 1 )
+                                       );
+  if ( ( keys == NULL ) || ( idx->move_id == NULL ) )
+    {
+      free( keys );
+      dense_index_free( idx );
+      return STORE_ERROR_NOMEM;
+    }
+  if ( 0 < nmons )
+    {
+      memcpy( keys, mon_keys, sizeof( uint32_t ) * nmons );
+    }
+  if ( 0 < nmoves )
+    {
+      memcpy( idx->move_id, move_ids, sizeof( uint16_t ) * nmoves );
+    }
+  qsort( keys, nmons, sizeof( uint32_t ), cmp_u32 );
+  qsort( idx->move_id, nmoves, sizeof( uint16_t ), cmp_u16 );
+
+  for ( uint32_t i = 0; i < nmons; i++ )
+    {
+      if ( ( i == 0 ) || ( keys[i] != keys[idx->nmons - 1] ) )
+        {
+          keys[idx->nmons++] = keys[i];
+        }
+    }
+  for ( uint16_t i = 0; i < nmoves; i++ )
+    {
+      if ( ( i == 0 ) || ( idx->move_id[i] != idx->move_id[idx->nmoves - 1] ) )
+        {
+          idx->move_id[idx->nmoves++] = idx->move_id[i];
+        }
+    }
+
+  idx->max_dex     = ( idx->nmons == 0 ) ? 0 : keys[idx->nmons - 1] >> 8;
+  idx->max_move_id = ( idx->nmoves == 0 ) ? 0
+                                          : idx->move_id[idx->nmoves - 1];
+
+  size_t n = max( idx->nmons, 1 );
+  idx->dex       = (uint16_t *) malloc( sizeof( uint16_t ) * n );
+  idx->form      = (uint8_t *) malloc( sizeof( uint8_t ) * n );
+  idx->dex_start = (uint32_t *) malloc( sizeof( uint32_t ) *
+                                        ( idx->max_dex + 2 )
+                                      );
+  idx->move_idx  = (uint16_t *) malloc( sizeof( uint16_t ) *
+                                        ( idx->max_move_id + 1 )
+                                      );
+  if ( ( idx->dex == NULL ) || ( idx->form == NULL ) ||
+       ( idx->dex_start == NULL ) || ( idx->move_idx == NULL ) )
+    {
+      free( keys );
+      dense_index_free( idx );
+      return STORE_ERROR_NOMEM;
+    }
+
+  /* `dex_start[d]' is the first `mon_idx' whose Dex # is at least `d' */
+  uint32_t d = 0;
+  for ( uint32_t i = 0; i < idx->nmons; i++ )
+    {
+      idx->dex[i]  = keys[i] >> 8;
+      idx->form[i] = keys[i] & 0xff;
+      while ( d <= idx->dex[i] ) idx->dex_start[d++] = i;
+    }
+  while ( d <= (uint32_t) idx->max_dex + 1 ) idx->dex_start[d++] = idx->nmons;
+
+  for ( uint32_t m = 0; m <= idx->max_move_id; m++ )
+    {
+      idx->move_idx[m] = DENSE_IDX_NONE;
+    }
+  for ( uint16_t i = 0; i < idx->nmoves; i++ )
+    {
+      idx->move_idx[idx->move_id[i]] = i;
+    }
+
+  free( keys );
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  void
+dense_index_free( dense_index_t * idx )
+{
+  assert( idx != NULL );
+  free( idx->dex_start );
+  free( idx->dex );
+  free( idx->form );
+  free( idx->move_idx );
+  free( idx->move_id );
+  memset( idx, 0, sizeof( dense_index_t ) );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,573 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "dense_index.h"
+#include "filter_index.h"
+#include "pokedex.h"
+#include "ptypes.h"
+#include "store.h"
+#include "util/bitset.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+/* What we need of each Pokemon, gathered by `store_each'. */
+struct filter_rec_s {
+  uint16_t        dex;
+  uint8_t         form;
+  uint16_t        family;
+  pdex_tag_mask_t tags;
+  ptype_mask_t    types;
+  uint32_t        moves_off;     /* Into `filter_recs_s.move_ids' */
+  uint8_t         fast_cnt;      /* Fast moves come first */
+  uint8_t         charged_cnt;
+};
+
+/* Stores may reuse the values they hand to `each', so we copy move lists. */
+struct filter_recs_s {
+  struct filter_rec_s * recs;
+  uint32_t              cnt;
+  uint32_t              cap;
+  uint16_t            * move_ids;
+  uint32_t              move_ids_cnt;
+  uint32_t              move_ids_cap;
+};
+
+/* And of each move */
+struct filter_move_s {
+  uint16_t move_id;
+  ptype_t  type;
+};
+
+struct filter_moves_s {
+  struct filter_move_s * moves;
+  uint32_t               cnt;
+  uint32_t               cap;
+};
+
+
+  static int
+filter_push_move_ids( struct filter_recs_s * recs,
+                      const int16_t        * ids,
+                      uint8_t                cnt
+                    )
+{
+  if ( recs->move_ids_cap < recs->move_ids_cnt + cnt )
+    {
+      uint32_t   cap = ( recs->move_ids_cap == 0 ) ? 4096
+                                                   : recs->move_ids_cap * 2;
+      uint16_t * tmp = NULL;
+      while ( cap < recs->move_ids_cnt + cnt ) cap *= 2;
+      tmp = realloc( recs->move_ids, sizeof( uint16_t ) * cap );
+      if ( tmp == NULL ) return STORE_ERROR_NOMEM;
+      recs->move_ids     = tmp;
+      recs->move_ids_cap = cap;
+    }
+  /* Negative IDs are legacy moves, which are still learned */
+  for ( uint8_t i = 0; i < cnt; i++ )
+    {
+      recs->move_ids[recs->move_ids_cnt++] = abs( ids[i] );
+    }
+  return STORE_SUCCESS;
+}
+
+
+  static int
+filter_collect_cb( void * ctx, store_key_t key, void * val )
+{
+  struct filter_recs_s * recs = (struct filter_recs_s *) ctx;
+  const pdex_mon_t     * mon  = (const pdex_mon_t *) val;
+
+  if ( recs->cnt == recs->cap )
+    {
+      uint32_t              cap = ( recs->cap == 0 ) ? 1024 : recs->cap * 2;
+      struct filter_rec_s * tmp = realloc( recs->recs,
+                                           sizeof( struct filter_rec_s ) * cap
+                                         );
+      if ( tmp == NULL ) return STORE_ERROR_NOMEM;
+      recs->recs = tmp;
+      recs->cap  = cap;
+    }
+
+  recs->recs[recs->cnt] = (struct filter_rec_s) {
+    .dex         = mon->dex_number,
+    .form        = mon->form_idx,
+    .family      = mon->family,
+    .tags        = mon->tags,
+    .types       = mon->types,
+    .moves_off   = recs->move_ids_cnt,
+    .fast_cnt    = mon->fast_moves_cnt,
+    .charged_cnt = mon->charged_moves_cnt
+  };
+
+  int rsl = filter_push_move_ids( recs,
+                                  mon->fast_move_ids,
+                                  mon->fast_moves_cnt
+                                );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  rsl = filter_push_move_ids( recs,
+                              mon->charged_move_ids,
+                              mon->charged_moves_cnt
+                            );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  recs->cnt++;
+
+  return STORE_SUCCESS;
+}
+
+
+  static int
+filter_collect_move_cb( void * ctx, store_key_t key, void * val )
+{
+  struct filter_moves_s * moves = (struct filter_moves_s *) ctx;
+  const store_move_t    * move  = (const store_move_t *) val;
+
+  if ( moves->cnt == moves->cap )
+    {
+      uint32_t               cap = ( moves->cap == 0 ) ? 512 : moves->cap * 2;
+      struct filter_move_s * tmp = realloc( moves->moves,
+                                            sizeof( struct filter_move_s ) *
+                                            cap
+                                          );
+      if ( tmp == NULL ) return STORE_ERROR_NOMEM;
+      moves->moves = tmp;
+      moves->cap   = cap;
+    }
+  moves->moves[moves->cnt++] = (struct filter_move_s) {
+    .move_id = move->move_id,
+    .type    = move->type
+  };
+
+  return STORE_SUCCESS;
+}
+
+
+  static int
+cmp_filter_rec( const void * a, const void * b )
+{
+  const struct filter_rec_s * x = (const struct filter_rec_s *) a;
+  const struct filter_rec_s * y = (const struct filter_rec_s *) b;
+  if ( x->dex != y->dex ) return ( x->dex < y->dex ) ? -1 : 1;
+  return ( x->form > y->form ) - ( x->form < y->form );
+}
+
+
+  static int
+cmp_u16( const void * a, const void * b )
+{
+  return * (const uint16_t *) a - * (const uint16_t *) b;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Position of `family' in `idx->families', or `-1'. */
+  static int32_t
+filter_family_pos( const filter_index_t * idx, uint16_t family )
+{
+  uint16_t * found = bsearch( & family,
+                              idx->families,
+                              idx->nfamilies,
+                              sizeof( uint16_t ),
+                              cmp_u16
+                            );
+  return ( found == NULL ) ? -1 : (int32_t) ( found - idx->families );
+}
+
+
+  int
+filter_index_init( filter_index_t * idx, store_t * store )
+{
+  assert( idx != NULL );
+  assert( store != NULL );
+
+  struct filter_recs_s    recs;
+  struct filter_moves_s   moves;
+  uint32_t              * keys       = NULL;
+  uint16_t              * move_ids   = NULL;
+  ptype_t               * move_types = NULL;   /* By `move_idx' */
+  int                     rsl        = STORE_SUCCESS;
+
+  memset( & recs, 0, sizeof( struct filter_recs_s ) );
+  memset( & moves, 0, sizeof( struct filter_moves_s ) );
+  memset( idx, 0, sizeof( filter_index_t ) );
+  idx->store = store;
+
+  rsl = store_each( store, STORE_POKEDEX, filter_collect_cb, & recs );
+  if ( rsl != STORE_SUCCESS ) goto cleanup;
+  rsl = store_each( store, STORE_MOVE, filter_collect_move_cb, & moves );
+  if ( rsl != STORE_SUCCESS ) goto cleanup;
+  if ( UINT16_MAX <= moves.cnt )
+    {
+      rsl = STORE_ERROR_BAD_VALUE;
+      goto cleanup;
+    }
+  qsort( recs.recs, recs.cnt, sizeof( struct filter_rec_s ), cmp_filter_rec );
+
+  size_t n = max( recs.cnt, 1 );
+  idx->nmons          = recs.cnt;
+  idx->nwords         = bitset_nwords( n );
+  idx->families       = (uint16_t *) malloc( sizeof( uint16_t ) * n );
+  idx->family_members = (uint32_t *) malloc( sizeof( uint32_t ) * n );
+  keys                = (uint32_t *) malloc( sizeof( uint32_t ) * n );
+  move_ids            = (uint16_t *) malloc( sizeof( uint16_t ) *
+                                             max( moves.cnt, 1 )
+                                           );
+  if ( ( idx->families == NULL ) || ( idx->family_members == NULL ) ||
+       ( keys == NULL ) || ( move_ids == NULL ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto cleanup;
+    }
+
+  for ( uint32_t i = 0; i < recs.cnt; i++ )
+    {
+      keys[i] = ( (uint32_t) recs.recs[i].dex << 8 ) | recs.recs[i].form;
+    }
+  for ( uint32_t i = 0; i < moves.cnt; i++ )
+    {
+      move_ids[i] = moves.moves[i].move_id;
+    }
+  rsl = dense_index_init_keys( & idx->dense,
+                               keys,
+                               recs.cnt,
+                               move_ids,
+                               (uint16_t) moves.cnt
+                             );
+  if ( rsl != STORE_SUCCESS ) goto cleanup;
+  /* Stores list each Pokemon once, so bit `i' is still `recs[i]' */
+  assert( idx->dense.nmons == recs.cnt );
+
+  move_types = (ptype_t *) malloc( sizeof( ptype_t ) *
+                                   max( idx->dense.nmoves, 1 )
+                                 );
+  if ( move_types == NULL )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto cleanup;
+    }
+  for ( uint32_t i = 0; i < moves.cnt; i++ )
+    {
+      move_types[idx->dense.move_idx[moves.moves[i].move_id]] =
+        moves.moves[i].type;
+    }
+
+  /* Unique families, sorted */
+  for ( uint32_t i = 0; i < recs.cnt; i++ )
+    {
+      idx->families[i] = recs.recs[i].family;
+    }
+  qsort( idx->families, recs.cnt, sizeof( uint16_t ), cmp_u16 );
+  for ( uint32_t i = 0; i < recs.cnt; i++ )
+    {
+      if ( ( i == 0 ) ||
+           ( idx->families[i] != idx->families[idx->nfamilies - 1] ) )
+        {
+          idx->families[idx->nfamilies++] = idx->families[i];
+        }
+    }
+
+  /* Every set lives in one block */
+  size_t nsets = 1 + NUM_PDEX_TAGS + ( 3 * NUM_PTYPES ) + NUM_REGIONS +
+                 idx->nfamilies + idx->dense.nmoves;
+  idx->sets = (uint64_t *) calloc( nsets * idx->nwords, sizeof( uint64_t ) );
+  idx->family_start = (uint32_t *) calloc( idx->nfamilies + 1,
+                                           sizeof( uint32_t )
+                                         );
+  if ( ( idx->sets == NULL ) || ( idx->family_start == NULL ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto cleanup;
+    }
+  idx->all           = idx->sets;
+  idx->tags          = idx->all + idx->nwords;
+  idx->types         = idx->tags + ( NUM_PDEX_TAGS * idx->nwords );
+  idx->fast_types    = idx->types + ( NUM_PTYPES * idx->nwords );
+  idx->charged_types = idx->fast_types + ( NUM_PTYPES * idx->nwords );
+  idx->regions       = idx->charged_types + ( NUM_PTYPES * idx->nwords );
+  idx->family_sets   = idx->regions + ( NUM_REGIONS * idx->nwords );
+  idx->learners      = idx->family_sets + ( idx->nfamilies * idx->nwords );
+
+  bitset_fill( idx->all, idx->nmons );
+  for ( uint32_t i = 0; i < recs.cnt; i++ )
+    {
+      const struct filter_rec_s * rec = recs.recs + i;
+
+      /* Bit `n' of a mask is enum value `n + 1', see `to_mask' */
+      for ( uint32_t m = rec->tags; m != 0; m &= m - 1 )
+        {
+          uint64_t * set = idx->tags + ( ( __builtin_ctz( m ) + 1 ) *
+                                         idx->nwords );
+          bitset_set( set, i );
+        }
+      for ( uint32_t m = rec->types; m != 0; m &= m - 1 )
+        {
+          uint64_t * set = idx->types + ( ( __builtin_ctz( m ) + 1 ) *
+                                          idx->nwords );
+          bitset_set( set, i );
+        }
+      for ( uint8_t r = 0; r < NUM_REGIONS; r++ )
+        {
+          if ( ( REGIONS[r].dex_start <= rec->dex ) &&
+               ( rec->dex <= REGIONS[r].dex_end ) )
+            {
+              bitset_set( idx->regions + ( r * idx->nwords ), i );
+            }
+        }
+      bitset_set( (uint64_t *) filter_index_family_set( idx, rec->family ), i );
+      idx->family_start[filter_family_pos( idx, rec->family ) + 1]++;
+
+      /* Moves the store doesn't have are skipped */
+      for ( uint16_t j = 0; j < rec->fast_cnt + rec->charged_cnt; j++ )
+        {
+          uint16_t move_idx = 0;
+          if ( dense_move_idx( & idx->dense,
+                               recs.move_ids[rec->moves_off + j],
+                               & move_idx
+                             ) != STORE_SUCCESS )
+            {
+              continue;
+            }
+          bitset_set( idx->learners + ( move_idx * idx->nwords ), i );
+          uint64_t * by_type = ( j < rec->fast_cnt ) ? idx->fast_types
+                                                     : idx->charged_types;
+          bitset_set( by_type + ( move_types[move_idx] * idx->nwords ), i );
+        }
+    }
+
+  /* Members of each family, in `mon_idx' order */
+  for ( uint16_t f = 0; f < idx->nfamilies; f++ )
+    {
+      idx->family_start[f + 1] += idx->family_start[f];
+    }
+  for ( uint32_t i = 0; i < recs.cnt; i++ )
+    {
+      int32_t f = filter_family_pos( idx, recs.recs[i].family );
+      idx->family_members[idx->family_start[f]++] = i;
+    }
+  for ( uint16_t f = idx->nfamilies; 0 < f; f-- )
+    {
+      idx->family_start[f] = idx->family_start[f - 1];
+    }
+  idx->family_start[0] = 0;
+
+cleanup:
+  free( recs.recs );
+  free( recs.move_ids );
+  free( moves.moves );
+  free( keys );
+  free( move_ids );
+  free( move_types );
+  if ( rsl != STORE_SUCCESS ) filter_index_free( idx );
+
+  return rsl;
+}
+
+
+  void
+filter_index_free( filter_index_t * idx )
+{
+  assert( idx != NULL );
+  dense_index_free( & idx->dense );
+  free( idx->families );
+  free( idx->family_start );
+  free( idx->family_members );
+  free( idx->sets );
+  memset( idx, 0, sizeof( filter_index_t ) );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+filter_index_get( const filter_index_t  * idx,
+                  uint32_t                mon_idx,
+                  pdex_mon_t           ** mon
+                )
+{
+  assert( idx != NULL );
+  assert( mon != NULL );
+
+  if ( idx->nmons <= mon_idx ) return STORE_ERROR_NOT_FOUND;
+  return idx->store->get( idx->store,
+                          dense_mon_key( & idx->dense, mon_idx ),
+                          (void **) mon
+                        );
+}
+
+
+  const uint64_t *
+filter_index_family_set( const filter_index_t * idx, uint16_t family )
+{
+  assert( idx != NULL );
+
+  int32_t f = filter_family_pos( idx, family );
+  if ( f < 0 ) return NULL;
+  return idx->family_sets + ( f * idx->nwords );
+}
+
+
+  uint32_t
+filter_index_family_members( const filter_index_t *  idx,
+                             uint16_t                family,
+                             const uint32_t       ** members
+                           )
+{
+  assert( idx != NULL );
+  assert( members != NULL );
+
+  int32_t f = filter_family_pos( idx, family );
+  if ( f < 0 )
+    {
+      *members = NULL;
+      return 0;
+    }
+  *members = idx->family_members + idx->family_start[f];
+  return idx->family_start[f + 1] - idx->family_start[f];
+}
+
+
+  const uint64_t *
+filter_index_learner_set( const filter_index_t * idx, uint16_t move_id )
+{
+  assert( idx != NULL );
+
+  uint16_t move_idx = 0;
+  if ( dense_move_idx( & idx->dense, move_id, & move_idx ) != STORE_SUCCESS )
+    {
+      return NULL;
+    }
+  return idx->learners + ( move_idx * idx->nwords );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+filter_index_eval( const filter_index_t * idx,
+                   const pdex_filter_t  * filter,
+                   uint64_t             * out
+                 )
+{
+  assert( idx != NULL );
+  assert( filter != NULL );
+  assert( out != NULL );
+
+  const uint64_t * family = NULL;
+  const uint64_t * learns = NULL;
+  const size_t     nwords = idx->nwords;
+
+  if ( filter->family != 0 )
+    {
+      family = filter_index_family_set( idx, filter->family );
+      if ( family == NULL )
+        {
+          bitset_zero( out, nwords );
+          return STORE_SUCCESS;
+        }
+    }
+  if ( filter->learns != 0 )
+    {
+      learns = filter_index_learner_set( idx, filter->learns );
+      if ( learns == NULL )
+        {
+          bitset_zero( out, nwords );
+          return STORE_SUCCESS;
+        }
+    }
+
+  /* One pass over the words, folding every criterion into each in turn */
+  for ( size_t w = 0; w < nwords; w++ )
+    {
+      uint64_t word = idx->all[w];
+      uint64_t any  = 0;
+
+      if ( filter->tags_any != TAG_NONE_M )
+        {
+          for ( uint32_t m = filter->tags_any; m != 0; m &= m - 1 )
+            {
+              any |= idx->tags[( __builtin_ctz( m ) + 1 ) * nwords + w];
+            }
+          word &= any;
+        }
+      for ( uint32_t m = filter->tags_none; m != 0; m &= m - 1 )
+        {
+          word &= ~ idx->tags[( __builtin_ctz( m ) + 1 ) * nwords + w];
+        }
+      if ( filter->types_any != PT_NONE_M )
+        {
+          any = 0;
+          for ( uint32_t m = filter->types_any; m != 0; m &= m - 1 )
+            {
+              any |= idx->types[( __builtin_ctz( m ) + 1 ) * nwords + w];
+            }
+          word &= any;
+        }
+      for ( uint32_t m = filter->types_all; m != 0; m &= m - 1 )
+        {
+          word &= idx->types[( __builtin_ctz( m ) + 1 ) * nwords + w];
+        }
+      if ( filter->fast_types_any != PT_NONE_M )
+        {
+          any = 0;
+          for ( uint32_t m = filter->fast_types_any; m != 0; m &= m - 1 )
+            {
+              any |= idx->fast_types[( __builtin_ctz( m ) + 1 ) * nwords + w];
+            }
+          word &= any;
+        }
+      if ( filter->charged_types_any != PT_NONE_M )
+        {
+          any = 0;
+          for ( uint32_t m = filter->charged_types_any; m != 0; m &= m - 1 )
+            {
+              any |= idx->charged_types[( __builtin_ctz( m ) + 1 ) * nwords +
+                                        w];
+            }
+          word &= any;
+        }
+      if ( filter->regions != 0 )
+        {
+          any = 0;
+          for ( uint32_t m = filter->regions; m != 0; m &= m - 1 )
+            {
+              if ( NUM_REGIONS <= __builtin_ctz( m ) ) break;
+              any |= idx->regions[__builtin_ctz( m ) * nwords + w];
+            }
+          word &= any;
+        }
+      if ( family != NULL ) word &= family[w];
+      if ( learns != NULL ) word &= learns[w];
+
+      out[w] = word;
+    }
+
+  /* The slow path, only for those that are left */
+  if ( filter->pred != NULL )
+    {
+      pdex_mon_t * mon = NULL;
+      bitset_foreach( i, out, nwords )
+        {
+          int rsl = filter_index_get( idx, i, & mon );
+          if ( rsl != STORE_SUCCESS ) return rsl;
+          if ( ! filter->pred( mon, filter->pred_arg ) ) bitset_clear( out, i );
+        }
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
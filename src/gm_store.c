@@ -2,13 +2,15 @@
 
 /* ========================================================================== */
 
-#include "ext/uthash.h"
 #include "defs/cstore_template.h"
 #include "gm_store.h"
 #include "moves.h"
 #include "parse_gm.h"
 #include "pokedex.h"
+#include "snapstore.h"
+#include "sqlstore.h"
 #include "store.h"
+#include "util/strmap.h"
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -25,25 +27,15 @@ gm_store_init( store_t * gm_store, void * vgm_parser )
   assert( vgm_parser != NULL );
 
   gm_parser_t * gm_parser = (gm_parser_t *) vgm_parser;
+  /* Move lists must already point into the pool */
+  assert( gm_parser->spans_cnt == 0 );
 
   gm_store->aux = (gm_store_aux_t *) malloc( sizeof( gm_store_aux_t ) );
-  assert( gm_store->aux != NULL );
-
-  as_gmsa( gm_store )->mons_by_name = gm_parser->mons_by_name;
-  as_gmsa( gm_store )->mons_by_dex  = gm_parser->mons_by_dex;
-  as_gmsa( gm_store )->mons_cnt =
-    HASH_CNT( hh_name, as_gmsa( gm_store )->mons_by_name );
-  assert( HASH_CNT( hh_dex_num, as_gmsa( gm_store )->mons_by_dex ) ==
-                                as_gmsa( gm_store )->mons_cnt
-        );
-
-  as_gmsa( gm_store )->moves_by_name = gm_parser->moves_by_name;
-  as_gmsa( gm_store )->moves_by_id   = gm_parser->moves_by_id;
-  as_gmsa( gm_store )->moves_cnt =
-    HASH_CNT( hh_name, as_gmsa( gm_store )->moves_by_name );
-  assert( HASH_CNT( hh_move_id, as_gmsa( gm_store )->moves_by_id ) ==
-                                as_gmsa( gm_store )->moves_cnt
-        );
+  if ( gm_store->aux == NULL ) return STORE_ERROR_NOMEM;
+
+  /* The store owns the tables now, so freeing the parser won't touch them */
+  as_gmsa( gm_store )->tables = gm_parser->tables;
+  gm_tables_init( & gm_parser->tables );
 
   return STORE_SUCCESS;
 }
@@ -54,28 +46,9 @@ gm_store_init( store_t * gm_store, void * vgm_parser )
   void
 gm_store_free( store_t * gm_store )
 {
-  /* Free the moves table */
-  store_move_t * curr_move = NULL;
-  store_move_t * tmp_move  = NULL;
-  HASH_ITER( hh_name, as_gmsa( gm_store )->moves_by_name, curr_move, tmp_move )
-    {
-      HASH_DELETE( hh_name, as_gmsa( gm_store )->moves_by_name, curr_move );
-      HASH_DELETE( hh_move_id, as_gmsa( gm_store )->moves_by_id, curr_move );
-      free( curr_move->name );
-      free( curr_move );
-    }
-  HASH_CLEAR( hh_move_id, as_gmsa( gm_store )->moves_by_id );
-  /* Free Pokedex */
-  pdex_mon_t * curr_mon = NULL;
-  pdex_mon_t * tmp_mon  = NULL;
-  HASH_ITER( hh_name, as_gmsa( gm_store )->mons_by_name, curr_mon, tmp_mon )
-    {
-      HASH_DELETE( hh_name, as_gmsa( gm_store )->mons_by_name, curr_mon );
-      HASH_DELETE( hh_dex_num, as_gmsa( gm_store )->mons_by_dex, curr_mon );
-      pdex_mon_free( curr_mon );
-    }
-  HASH_CLEAR( hh_dex_num, as_gmsa( gm_store )->mons_by_dex );
+  gm_tables_free( & as_gmsa( gm_store )->tables );
   free( gm_store->aux );
+  gm_store->aux = NULL;
 }
 
 
@@ -97,13 +70,10 @@ gm_store_get_pokemon( gm_store_t *  gm_store,
                       pdex_mon_t ** val
                       )
 {
-  pdex_mon_t * mon = NULL;
-  HASH_FIND( hh_dex_num,
-             as_gmsa( gm_store )->mons_by_dex,
-             & dex_num,
-             sizeof( uint16_t ),
-             mon
-           );
+  const gm_tables_t * tables = & as_gmsa( gm_store )->tables;
+  pdex_mon_t        * mon    = ( dex_num < tables->mons_len )
+                               ? tables->mons_by_dex[dex_num]
+                               : NULL;
 
   if ( mon == NULL )
     {
@@ -134,13 +104,9 @@ gm_store_get_pokemon_by_name( gm_store_t *  gm_store,
                               pdex_mon_t ** val
                             )
 {
-  pdex_mon_t * mon = NULL;
-  HASH_FIND( hh_name,
-             as_gmsa( gm_store )->mons_by_name,
-             name,
-             strlen( name ),
-             mon
-           );
+  pdex_mon_t * mon = strmap_get( & as_gmsa( gm_store )->tables.mons_by_name,
+                                 name
+                               );
   if ( val != NULL ) *val = mon;
   return ( mon != NULL ) ? STORE_SUCCESS : STORE_ERROR_NOT_FOUND;
 }
@@ -154,13 +120,10 @@ gm_store_get_move( gm_store_t   *  gm_store,
                    store_move_t ** val
                  )
 {
-  store_move_t * move = NULL;
-  HASH_FIND( hh_move_id,
-             as_gmsa( gm_store )->moves_by_id,
-             & move_id,
-             sizeof( uint16_t ),
-             move
-           );
+  const gm_tables_t * tables = & as_gmsa( gm_store )->tables;
+  store_move_t      * move   = ( move_id < tables->moves_len )
+                               ? tables->moves_by_id[move_id]
+                               : NULL;
   if ( val != NULL ) *val = move;
   return ( move != NULL ) ? STORE_SUCCESS : STORE_ERROR_NOT_FOUND;
 }
@@ -174,13 +137,8 @@ gm_store_get_move_by_name( gm_store_t   *  gm_store,
                            store_move_t ** val
                          )
 {
-  store_move_t * move = NULL;
-  HASH_FIND( hh_name,
-             as_gmsa( gm_store )->moves_by_name,
-             name,
-             strlen( name ),
-             move
-           );
+  store_move_t * move =
+    strmap_get( & as_gmsa( gm_store )->tables.moves_by_name, name );
   if ( val != NULL ) *val = move;
   return ( move != NULL ) ? STORE_SUCCESS : STORE_ERROR_NOT_FOUND;
 }
@@ -216,6 +174,116 @@ gm_store_get( store_t * gm_store, store_key_t key, void ** val )
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+/* Same as `cstore_get_many', repeated keys skip the lookup. */
+  int
+gm_store_get_many( store_t           *  gm_store,
+                   const store_key_t *  keys,
+                   size_t               n,
+                   void              ** vals,
+                   int               *  status
+                 )
+{
+  assert( gm_store != NULL );
+  assert( ( keys != NULL ) || ( n == 0 ) );
+  assert( ( vals != NULL ) || ( n == 0 ) );
+
+  int         rsl  = STORE_SUCCESS;
+  int         s    = STORE_ERROR_BAD_VALUE;
+  store_key_t last = { .key_type = STORE_UNKNOWN };
+
+  for ( size_t i = 0; i < n; i++ )
+    {
+      if ( ( i != 0 )                               &&
+           ( keys[i].key_type == last.key_type )    &&
+           ( keys[i].val_type == last.val_type )    &&
+           ( keys[i].data_f   == last.data_f )
+         )
+        {
+          vals[i] = vals[i - 1];
+        }
+      else if ( ( keys[i].key_type == STORE_NUM  ) &&
+                ( keys[i].val_type == STORE_MOVE )
+              )
+        {
+          s = gm_store_get_move( gm_store,
+                                 as_gmsk( keys[i] ).id,
+                                 (store_move_t **) ( vals + i )
+                               );
+        }
+      else if ( ( keys[i].key_type == STORE_NUM  )    &&
+                ( keys[i].val_type == STORE_POKEDEX )
+              )
+        {
+          s = gm_store_get_pokemon( gm_store,
+                                    as_gmsk( keys[i] ).id,
+                                    as_gmsk( keys[i] ).form_idx,
+                                    (pdex_mon_t **) ( vals + i )
+                                  );
+        }
+      else
+        {
+          vals[i] = NULL;
+          s       = STORE_ERROR_BAD_VALUE;
+        }
+      last = keys[i];
+      if ( status != NULL ) status[i] = s;
+      if ( ( s != STORE_SUCCESS ) && ( rsl == STORE_SUCCESS ) ) rsl = s;
+    }
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+gm_store_each( store_t       * gm_store,
+               store_type_t    val_type,
+               store_each_cb   cb,
+               void          * ctx
+             )
+{
+  assert( gm_store != NULL );
+  assert( cb != NULL );
+
+  const gm_tables_t * tables = & as_gmsa( gm_store )->tables;
+  int                 rsl    = STORE_SUCCESS;
+
+  /* Both tables are in key order */
+  if ( val_type == STORE_POKEDEX )
+    {
+      for ( uint16_t d = 0; d < tables->mons_len; d++ )
+        {
+          for ( pdex_mon_t * mon = tables->mons_by_dex[d];
+                mon != NULL;
+                mon = mon->next_form
+              )
+            {
+              rsl = cb( ctx, pdex_store_key( mon ), mon );
+              if ( rsl != STORE_SUCCESS ) return rsl;
+            }
+        }
+      return STORE_SUCCESS;
+    }
+
+  if ( val_type == STORE_MOVE )
+    {
+      for ( uint16_t m = 0; m < tables->moves_len; m++ )
+        {
+          store_move_t * move = tables->moves_by_id[m];
+          if ( move == NULL ) continue;
+          rsl = cb( ctx, move_store_key( move ), move );
+          if ( rsl != STORE_SUCCESS ) return rsl;
+        }
+      return STORE_SUCCESS;
+    }
+
+  return STORE_ERROR_BAD_VALUE;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   int
@@ -278,31 +346,26 @@ gm_store_get_str_t( store_t      *  gm_store,
   int
 gm_store_export_json( gm_store_t * gm_store, FILE * ostream )
 {
-  pdex_mon_t   * curr_mon;
-  pdex_mon_t   * tmp_mon;
-  store_move_t * curr_move;
-  store_move_t * tmp_move;
+  const gm_tables_t * tables = & as_gmsa( gm_store )->tables;
+  bool                first  = true;
 
   fprintf( ostream, "{ \"pokedex\": [ " );
-  HASH_ITER( hh_dex_num,
-             as_gmsa( gm_store )->mons_by_dex,
-             curr_mon,
-             tmp_mon
-           )
+  for ( uint16_t d = 0; d < tables->mons_len; d++ )
     {
-      fprint_pdex_mon_json( ostream, curr_mon );
-      if ( tmp_mon != NULL ) fprintf( ostream, ", " );
+      if ( tables->mons_by_dex[d] == NULL ) continue;
+      if ( ! first ) fprintf( ostream, ", " );
+      fprint_pdex_mon_json( ostream, tables->mons_by_dex[d] );
+      first = false;
     }
 
   fprintf( ostream, "\n],\n  \"moves\": [ " );
-  HASH_ITER( hh_move_id,
-             as_gmsa( gm_store )->moves_by_id,
-             curr_move,
-             tmp_move
-           )
+  first = true;
+  for ( uint16_t m = 0; m < tables->moves_len; m++ )
     {
-      fprint_store_move_json( ostream, curr_move );
-      if ( tmp_move != NULL ) fprintf( ostream, ", " );
+      if ( tables->moves_by_id[m] == NULL ) continue;
+      if ( ! first ) fprintf( ostream, ", " );
+      fprint_store_move_json( ostream, tables->moves_by_id[m] );
+      first = false;
     }
   fprintf( ostream, " ]\n}" );
 
@@ -315,39 +378,34 @@ gm_store_export_json( gm_store_t * gm_store, FILE * ostream )
   int
 gm_store_export_c( gm_store_t * gm_store, FILE * ostream )
 {
-  pdex_mon_t   * curr_mon  = NULL;
-  pdex_mon_t   * tmp_mon   = NULL;
-  store_move_t * curr_move = NULL;
-  store_move_t * tmp_move  = NULL;
+  const gm_tables_t * tables = & as_gmsa( gm_store )->tables;
+  bool                first  = true;
 
   fprintf( ostream, "/* -*- mode: c; -*- */\n\n%s\n", EQSEP );
   fprintf( ostream, "%s\n\n%s\n\n", INCLUDES, DASHSEP );
-  fprintf( ostream,
-           "const uint16_t NUM_POKEMON = %u;\n\n",
-           as_gmsa( gm_store )->mons_cnt
-         );
-  fprintf( ostream,
-           "const uint16_t NUM_MOVES = %u;\n\n",
-           as_gmsa( gm_store )->moves_cnt
-         );
+  fprintf( ostream, "const uint16_t NUM_POKEMON = %u;\n\n", tables->mons_cnt );
+  fprintf( ostream, "const uint16_t NUM_MOVES = %u;\n\n", tables->moves_cnt );
 
   fprintf( ostream, "\n%s\n\n", DASHSEP );
 
   fprintf( ostream, "store_move_t MOVES[] = {\n" );
   /* Define Moves */
-  HASH_ITER( hh_move_id, as_gmsa( gm_store )->moves_by_id, curr_move, tmp_move )
+  for ( uint16_t m = 0; m < tables->moves_len; m++ )
     {
-      fprint_store_move_c( ostream, curr_move );
-      if ( tmp_move != NULL ) fprintf( ostream, ", " );
+      if ( tables->moves_by_id[m] == NULL ) continue;
+      if ( ! first ) fprintf( ostream, ", " );
+      fprint_store_move_c( ostream, tables->moves_by_id[m] );
+      first = false;
     }
   fprintf( ostream, "};\n" );
 
   fprintf( ostream, "\n%s\n\n", DASHSEP );
 
   /* Define Pokemon */
-  HASH_ITER( hh_dex_num, as_gmsa( gm_store )->mons_by_dex, curr_mon, tmp_mon )
+  for ( uint16_t d = 0; d < tables->mons_len; d++ )
     {
-      fprint_pdex_mon_c( ostream, curr_mon );
+      if ( tables->mons_by_dex[d] == NULL ) continue;
+      fprint_pdex_mon_c( ostream, tables->mons_by_dex[d] );
       fprintf( ostream, ";\n" );
     }
 
@@ -355,10 +413,13 @@ gm_store_export_c( gm_store_t * gm_store, FILE * ostream )
 
   /* Create Pokedex from Pokemon */
   fprintf( ostream, "\npdex_mon_t * POKEDEX[] = {\n" );
-  HASH_ITER( hh_dex_num, as_gmsa( gm_store )->mons_by_dex, curr_mon, tmp_mon )
+  first = true;
+  for ( uint16_t d = 0; d < tables->mons_len; d++ )
     {
-      fprintf( ostream, "  & DEXMON_%u_0", curr_mon->dex_number );
-      if ( tmp_mon != NULL ) fprintf( ostream, ",\n" );
+      if ( tables->mons_by_dex[d] == NULL ) continue;
+      if ( ! first ) fprintf( ostream, ",\n" );
+      fprintf( ostream, "  & DEXMON_%u_0", d );
+      first = false;
     }
   fprintf( ostream, "\n};\n\n\n%s\n\n/* vim: set filetype=c : */\n", EQSEP );
 
@@ -366,12 +427,105 @@ gm_store_export_c( gm_store_t * gm_store, FILE * ostream )
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Collect base forms and moves into arrays for the table based sinks.
+ * `mons_by_dex' only holds base forms, writers follow `next_form'.
+ */
+  static int
+gm_store_collect( gm_store_t     *  gm_store,
+                  pdex_mon_t   ***  mons,
+                  uint16_t       *  mons_cnt,
+                  store_move_t ***  moves,
+                  uint16_t       *  moves_cnt
+                )
+{
+  const gm_tables_t * tables = & as_gmsa( gm_store )->tables;
+  uint16_t            i      = 0;
+
+  *mons_cnt  = tables->mons_cnt;
+  *moves_cnt = tables->moves_cnt;
+  *mons      = (pdex_mon_t **) malloc( sizeof( pdex_mon_t * ) *
+                                       max( *mons_cnt, 1 )
+                                     );
+  *moves     = (store_move_t **) malloc( sizeof( store_move_t * ) *
+                                         max( *moves_cnt, 1 )
+                                       );
+  if ( ( *mons == NULL ) || ( *moves == NULL ) )
+    {
+      free( *mons );
+      free( *moves );
+      return STORE_ERROR_NOMEM;
+    }
+
+  for ( uint16_t d = 0; d < tables->mons_len; d++ )
+    {
+      if ( tables->mons_by_dex[d] != NULL )
+        {
+          ( *mons )[i++] = tables->mons_by_dex[d];
+        }
+    }
+  i = 0;
+  for ( uint16_t m = 0; m < tables->moves_len; m++ )
+    {
+      if ( tables->moves_by_id[m] != NULL )
+        {
+          ( *moves )[i++] = tables->moves_by_id[m];
+        }
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+gm_store_export_snapshot( gm_store_t * gm_store, FILE * ostream )
+{
+  pdex_mon_t   ** mons      = NULL;
+  store_move_t ** moves     = NULL;
+  uint16_t        mons_cnt  = 0;
+  uint16_t        moves_cnt = 0;
+  int             status    = gm_store_collect( gm_store,
+                                                & mons,
+                                                & mons_cnt,
+                                                & moves,
+                                                & moves_cnt
+                                              );
+  if ( status != STORE_SUCCESS ) return status;
+
+  status = snapstore_write( ostream, mons, mons_cnt, moves, moves_cnt );
+
+  free( mons );
+  free( moves );
+  return status;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   int
 gm_store_export_sql( gm_store_t * gm_store, const char * db_name )
 {
-  return STORE_SUCCESS;
+  pdex_mon_t   ** mons      = NULL;
+  store_move_t ** moves     = NULL;
+  uint16_t        mons_cnt  = 0;
+  uint16_t        moves_cnt = 0;
+  int             status    = gm_store_collect( gm_store,
+                                                & mons,
+                                                & mons_cnt,
+                                                & moves,
+                                                & moves_cnt
+                                              );
+  if ( status != STORE_SUCCESS ) return status;
+
+  status = sqlstore_write( db_name, mons, mons_cnt, moves, moves_cnt );
+
+  free( mons );
+  free( moves );
+  return status;
 }
 
 
@@ -388,6 +542,8 @@ gm_store_export( gm_store_t   * gm_store,
     case SS_JSON: return gm_store_export_json( gm_store, (FILE *) target );
     case SS_C:    return gm_store_export_c( gm_store, (FILE *) target );
     case SS_SQL:  return gm_store_export_sql( gm_store, (const char *) target );
+    case SS_SNAPSHOT:
+      return gm_store_export_snapshot( gm_store, (FILE *) target );
     default:      return STORE_ERROR_NOT_DEFINED;
     }
 }
@@ -0,0 +1,462 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "ai/naive_ai.h"
+#include "battle.h"
+#include "ladder.h"
+#include "player.h"
+#include "pokemon.h"
+#include "store.h"
+#include "util/macros.h"
+#include "util/parallel.h"
+#include "util/prng.h"
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Battle outcomes, and kept results; 0 is not yet simulated */
+#define LADDER_P1_WIN     1
+#define LADDER_P2_WIN     2
+#define LADDER_DRAW       3
+#define LADDER_RESULT_M   0x3
+/* Set on a pair's outcome when its battle had to be simulated */
+#define LADDER_SIMULATED  0x4
+
+/* Pairs each worker claims at once */
+#define LADDER_PAIR_CHUNK  64
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Draw a meta team by its cumulative weight in `cum'. */
+  static uint32_t
+ladder_draw_team( uint64_t * prng, const double * cum, uint32_t n )
+{
+  double   u  = prng_double( prng ) * cum[n - 1];
+  uint32_t lo = 0;
+  uint32_t hi = n - 1;
+  while ( lo < hi )
+    {
+      uint32_t mid = lo + ( hi - lo ) / 2;
+      if ( u < cum[mid] ) hi = mid;
+      else                lo = mid + 1;
+    }
+  return lo;
+}
+
+
+  int
+ladder_init( ladder_t            * ladder,
+             roster_pokemon_t    * teams,
+             uint32_t              nteams,
+             const float         * weights,
+             uint32_t              nplayers,
+             store_t             * store,
+             const ladder_opts_t * opts
+           )
+{
+  assert( ladder != NULL );
+  assert( ( teams != NULL ) || ( nteams == 0 ) );
+  assert( store != NULL );
+
+  const ladder_opts_t defaults = LADDER_OPTS_DEFAULT;
+  if ( opts == NULL ) opts = & defaults;
+
+  * ladder      = (ladder_t) LADDER_INIT;
+  ladder->opts  = * opts;
+  ladder->prng  = opts->seed;
+  if ( ( nplayers < 2 ) || ( nteams == 0 ) ) return STORE_ERROR_BAD_VALUE;
+
+  double * cum = (double *) malloc( sizeof( double ) * nteams );
+  if ( cum == NULL ) return STORE_ERROR_NOMEM;
+  double total = 0.0;
+  for ( uint32_t t = 0; t < nteams; t++ )
+    {
+      double w = ( weights == NULL ) ? 1.0 : weights[t];
+      total += ( 0.0 < w ) ? w : 0.0;
+      cum[t] = total;
+    }
+  if ( ! ( 0.0 < total ) || isinf( total ) )
+    {
+      free( cum );
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  int rsl = STORE_ERROR_NOMEM;
+  ladder->nteams   = nteams;
+  ladder->nplayers = nplayers;
+  ladder->teams    = (pvp_pokemon_t *)
+    malloc( sizeof( pvp_pokemon_t ) * 3 * (size_t) nteams );
+  ladder->stats    = (ladder_team_stats_t *)
+    calloc( nteams, sizeof( ladder_team_stats_t ) );
+  ladder->players  = (ladder_player_t *)
+    calloc( nplayers, sizeof( ladder_player_t ) );
+  ladder->slots    = (ladder_slot_t *)
+    malloc( sizeof( ladder_slot_t ) * nplayers );
+  ladder->outcomes = (uint8_t *) malloc( nplayers / 2 );
+  if ( ( ladder->teams == NULL ) || ( ladder->stats == NULL ) ||
+       ( ladder->players == NULL ) || ( ladder->slots == NULL ) ||
+       ( ladder->outcomes == NULL ) )
+    {
+      goto done;
+    }
+  if ( nteams <= LADDER_CACHE_MAX_TEAMS )
+    {
+      ladder->results = (_Atomic uint8_t *)
+        calloc( (size_t) nteams * nteams, sizeof( _Atomic uint8_t ) );
+      if ( ladder->results == NULL ) goto done;
+    }
+
+  rsl = pvp_pokemon_init_many( ladder->teams, teams, 3 * (size_t) nteams,
+                               store
+                             );
+  if ( rsl != STORE_SUCCESS ) goto done;
+
+  for ( uint32_t p = 0; p < nplayers; p++ )
+    {
+      ladder_player_t * player = ladder->players + p;
+      player->team   = ladder_draw_team( & ladder->prng, cum, nteams );
+      player->rating = opts->initial_rating;
+      player->rd     = opts->glicko_rd;
+      /* `player_t' is packed, so its roster is filled through a copy */
+      roster_t roster = player->player.roster;
+      if ( ! roster_reserve( & roster, 3 ) )
+        {
+          rsl = STORE_ERROR_NOMEM;
+          goto done;
+        }
+      for ( uint8_t m = 0; m < 3; m++ )
+        {
+          roster_append( & roster, teams + 3 * (size_t) player->team + m );
+        }
+      player->player.roster = roster;
+      ladder->stats[player->team].players++;
+    }
+  rsl = STORE_SUCCESS;
+
+done:
+  free( cum );
+  if ( rsl != STORE_SUCCESS ) ladder_free( ladder );
+  return rsl;
+}
+
+
+  void
+ladder_free( ladder_t * ladder )
+{
+  assert( ladder != NULL );
+  if ( ladder->players != NULL )
+    {
+      for ( uint32_t p = 0; p < ladder->nplayers; p++ )
+        {
+          roster_t roster = ladder->players[p].player.roster;
+          roster_free( & roster );
+        }
+    }
+  free( ladder->teams );
+  free( ladder->stats );
+  free( ladder->players );
+  free( ladder->slots );
+  free( ladder->outcomes );
+  free( ladder->results );
+  * ladder = (ladder_t) LADDER_INIT;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Play meta team `t1' against `t2', both with 2 shields. */
+  static uint8_t
+ladder_battle( const ladder_t * ladder, uint32_t t1, uint32_t t2 )
+{
+  pvp_player_t p1     = PVP_PLAYER_NULL;
+  pvp_player_t p2     = PVP_PLAYER_NULL;
+  pvp_battle_t battle = PVP_BATTLE_NULL;
+  ai_t         ai1    = def_naive_ai();
+  ai_t         ai2    = def_naive_ai();
+
+  memcpy( p1.team, ladder->teams + 3 * (size_t) t1, sizeof( p1.team ) );
+  memcpy( p2.team, ladder->teams + 3 * (size_t) t2, sizeof( p2.team ) );
+  p1.ai     = & ai1;
+  p2.ai     = & ai2;
+  battle.p1 = & p1;
+  battle.p2 = & p2;
+
+  pvp_battle_reset( & battle );
+  simulate_battle( & battle );
+
+  pvp_player_t * winner = get_battle_winner( & battle );
+  if ( winner == NULL ) return LADDER_DRAW;
+  return ( winner == & p1 ) ? LADDER_P1_WIN : LADDER_P2_WIN;
+}
+
+
+/**
+ * Battle pairs `begin' to `end' of the round.
+ * Kept results are shared between workers; two of them may simulate the
+ * same new pairing at once, but they can only agree on its result.
+ */
+  static void
+ladder_battle_pairs( void     * vladder,
+                     uint32_t   begin,
+                     uint32_t   end,
+                     uint32_t   thread
+                   )
+{
+  ladder_t * ladder = (ladder_t *) vladder;
+  for ( uint32_t k = begin; k < end; k++ )
+    {
+      uint32_t t1 = ladder->players[ladder->slots[2 * k].player].team;
+      uint32_t t2 = ladder->players[ladder->slots[2 * k + 1].player].team;
+      _Atomic uint8_t * kept = ( ladder->results == NULL ) ? NULL :
+        ladder->results + (size_t) t1 * ladder->nteams + t2;
+      uint8_t outcome = ( kept == NULL ) ? 0 :
+        atomic_load_explicit( kept, memory_order_relaxed );
+      if ( outcome == 0 )
+        {
+          outcome = ladder_battle( ladder, t1, t2 );
+          if ( kept != NULL )
+            {
+              atomic_store_explicit( kept, outcome, memory_order_relaxed );
+            }
+          outcome |= LADDER_SIMULATED;
+        }
+      ladder->outcomes[k] = outcome;
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static int
+ladder_slot_cmp( const void * a, const void * b )
+{
+  const ladder_slot_t * sa = (const ladder_slot_t *) a;
+  const ladder_slot_t * sb = (const ladder_slot_t *) b;
+  if ( sa->key != sb->key ) return ( sa->key < sb->key ) ? -1 : 1;
+  return ( sa->player < sb->player ) ? -1 : ( sa->player > sb->player );
+}
+
+
+/* Sort players on jittered ratings, then flip a coin for who is P1. */
+  static void
+ladder_pair( ladder_t * ladder )
+{
+  for ( uint32_t p = 0; p < ladder->nplayers; p++ )
+    {
+      double noise = ( 2.0 * prng_double( & ladder->prng ) - 1.0 ) *
+                     ladder->opts.jitter;
+      ladder->slots[p] = (ladder_slot_t) {
+        .key = ladder->players[p].rating + noise, .player = p
+      };
+    }
+  qsort( ladder->slots, ladder->nplayers, sizeof( ladder_slot_t ),
+         ladder_slot_cmp
+       );
+  for ( uint32_t k = 0; k < ladder->nplayers / 2; k++ )
+    {
+      if ( prng_next( & ladder->prng ) & 1 )
+        {
+          ladder_slot_t tmp       = ladder->slots[2 * k];
+          ladder->slots[2 * k]     = ladder->slots[2 * k + 1];
+          ladder->slots[2 * k + 1] = tmp;
+        }
+    }
+}
+
+
+/* Glicko's `g', which discounts results against uncertain ratings */
+  static double
+ladder_glicko_g( double rd )
+{
+  const double q = M_LN10 / 400.0;
+  return 1.0 / sqrt( 1.0 + 3.0 * q * q * rd * rd / ( M_PI * M_PI ) );
+}
+
+
+/* Rate `self' on scoring `score' against `other', as they were before. */
+  static void
+ladder_rate( const ladder_opts_t   * opts,
+             ladder_player_t       * self,
+             const ladder_player_t * other,
+             double                  score
+           )
+{
+  if ( opts->rating == LADDER_ELO )
+    {
+      double e = 1.0 / ( 1.0 + pow( 10.0, ( other->rating - self->rating ) /
+                                          400.0
+                                  ) );
+      self->rating += opts->elo_k * ( score - e );
+      return;
+    }
+  const double q     = M_LN10 / 400.0;
+  const double g     = ladder_glicko_g( other->rd );
+  const double e     = 1.0 / ( 1.0 + pow( 10.0, g * ( other->rating -
+                                                      self->rating ) / 400.0
+                                            ) );
+  const double inv_d = q * q * g * g * e * ( 1.0 - e );
+  const double denom = 1.0 / ( self->rd * self->rd ) + inv_d;
+  self->rating += q / denom * g * ( score - e );
+  self->rd      = sqrt( 1.0 / denom );
+}
+
+
+/* Add a battle to a player's record, `wins' and `battles' stop at their max */
+  static void
+ladder_record( ladder_player_t * player, uint8_t result, bool is_p1 )
+{
+  uint8_t win = is_p1 ? LADDER_P1_WIN : LADDER_P2_WIN;
+  if ( player->player.battles < UINT16_MAX ) player->player.battles++;
+  if ( ( result == win ) && ( player->player.wins < UINT16_MAX ) )
+    {
+      player->player.wins++;
+    }
+  if ( result == LADDER_DRAW ) player->draws++;
+}
+
+
+/* Apply the round's outcomes, in pairing order. */
+  static void
+ladder_settle( ladder_t * ladder )
+{
+  for ( uint32_t k = 0; k < ladder->nplayers / 2; k++ )
+    {
+      uint8_t           outcome = ladder->outcomes[k];
+      uint8_t           result  = outcome & LADDER_RESULT_M;
+      ladder_player_t * p1      = ladder->players + ladder->slots[2 * k].player;
+      ladder_player_t * p2      =
+        ladder->players + ladder->slots[2 * k + 1].player;
+      const ladder_player_t old1 = * p1;
+      const ladder_player_t old2 = * p2;
+      double            score   = ( result == LADDER_P1_WIN ) ? 1.0 :
+                                  ( result == LADDER_DRAW ) ? 0.5 : 0.0;
+
+      ladder_rate( & ladder->opts, p1, & old2, score );
+      ladder_rate( & ladder->opts, p2, & old1, 1.0 - score );
+      ladder_record( p1, result, true );
+      ladder_record( p2, result, false );
+
+      ladder_team_stats_t * s1 = ladder->stats + p1->team;
+      ladder_team_stats_t * s2 = ladder->stats + p2->team;
+      s1->battles++;
+      s2->battles++;
+      if ( result == LADDER_P1_WIN ) s1->wins++;
+      if ( result == LADDER_P2_WIN ) s2->wins++;
+      if ( result == LADDER_DRAW )
+        {
+          s1->draws++;
+          s2->draws++;
+        }
+      ladder->nbattles++;
+      if ( outcome & LADDER_SIMULATED ) ladder->nsimulated++;
+    }
+}
+
+
+  int
+ladder_run( ladder_t * ladder, uint32_t nrounds )
+{
+  assert( ladder != NULL );
+  assert( ladder->players != NULL );
+
+  const uint32_t npairs = ladder->nplayers / 2;
+  const double   max_rd = ladder->opts.glicko_rd;
+  const double   c      = ladder->opts.glicko_c;
+
+  for ( uint32_t r = 0; r < nrounds; r++ )
+    {
+      if ( ladder->opts.rating == LADDER_GLICKO )
+        {
+          for ( uint32_t p = 0; p < ladder->nplayers; p++ )
+            {
+              double rd = ladder->players[p].rd;
+              ladder->players[p].rd = min( sqrt( rd * rd + c * c ), max_rd );
+            }
+        }
+      ladder_pair( ladder );
+      if ( parallel_for( npairs, LADDER_PAIR_CHUNK, ladder->opts.nthreads,
+                         ladder_battle_pairs, ladder
+                       ) != 0 )
+        {
+          return STORE_ERROR_NOMEM;
+        }
+      ladder_settle( ladder );
+      ladder->round++;
+
+      if ( ( ladder->opts.stats != NULL ) &&
+           ( 0 < ladder->opts.report_every ) &&
+           ( ladder->round % ladder->opts.report_every == 0 ) )
+        {
+          int rsl = ladder_write_stats( ladder, ladder->opts.stats,
+                                        ladder->round ==
+                                        ladder->opts.report_every
+                                      );
+          if ( rsl != STORE_SUCCESS ) return rsl;
+        }
+    }
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+ladder_write_stats( const ladder_t * ladder, FILE * ostream, bool header )
+{
+  assert( ladder != NULL );
+  assert( ostream != NULL );
+
+  double * ratings = (double *) calloc( ladder->nteams, sizeof( double ) );
+  if ( ratings == NULL ) return STORE_ERROR_NOMEM;
+  for ( uint32_t p = 0; p < ladder->nplayers; p++ )
+    {
+      ratings[ladder->players[p].team] += ladder->players[p].rating;
+    }
+
+  int rsl = STORE_SUCCESS;
+  if ( header &&
+       ( fputs( "round,team,players,battles,wins,draws,win_rate,rating\n",
+                ostream
+              ) < 0 ) )
+    {
+      rsl = STORE_ERROR_FAIL;
+    }
+  for ( uint32_t t = 0; ( t < ladder->nteams ) && ( rsl == STORE_SUCCESS );
+        t++ )
+    {
+      const ladder_team_stats_t * stats = ladder->stats + t;
+      double rating = ( stats->players == 0 ) ? 0.0
+                                              : ratings[t] / stats->players;
+      if ( fprintf( ostream, "%u,%u,%u,%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                    ",%.4f,%.1f\n",
+                    ladder->round, t, stats->players, stats->battles,
+                    stats->wins, stats->draws, ladder_team_win_rate( stats ),
+                    rating
+                  ) < 0 )
+        {
+          rsl = STORE_ERROR_FAIL;
+        }
+    }
+  free( ratings );
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
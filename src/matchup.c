@@ -0,0 +1,317 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "ai/naive_ai.h"
+#include "battle.h"
+#include "matchup.h"
+#include "player.h"
+#include "pokemon.h"
+#include "util/parallel.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+  uint16_t
+matchup_battle( const pvp_pokemon_t * mon1,
+                const pvp_pokemon_t * mon2,
+                uint8_t               scenario
+              )
+{
+  assert( mon1 != NULL );
+  assert( mon2 != NULL );
+  assert( scenario < MATCHUP_NSCENARIOS );
+
+  pvp_player_t p1     = PVP_PLAYER_NULL;
+  pvp_player_t p2     = PVP_PLAYER_NULL;
+  pvp_battle_t battle = PVP_BATTLE_NULL;
+  ai_t         ai1    = def_naive_ai();
+  ai_t         ai2    = def_naive_ai();
+
+  p1.team[0] = * mon1;
+  p2.team[0] = * mon2;
+  p1.ai      = & ai1;
+  p2.ai      = & ai2;
+  battle.p1  = & p1;
+  battle.p2  = & p2;
+
+  pvp_battle_reset( & battle );
+  p1.shields = matchup_scenario_s1( scenario );
+  p2.shields = matchup_scenario_s2( scenario );
+
+  const uint32_t hp1 = max( p1.team[0].hp, 1 );
+  const uint32_t hp2 = max( p2.team[0].hp, 1 );
+
+  simulate_battle( & battle );
+
+  return (uint16_t) ( ( 500 * ( hp2 - p2.team[0].hp ) ) / hp2 +
+                      ( 500 * p1.team[0].hp ) / hp1
+                    );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+struct matchup_job_s {
+  matchup_matrix_t        * matrix;
+  const pvp_pokemon_t     * rows;
+  const pvp_pokemon_t     * cols;
+  const uint32_t          * col_idx;  /* For `matchup_matrix_update_cols' */
+  uint32_t                  ncols;
+  matchup_cache_t         * cache;
+  const matchup_mon_key_t * col_keys;  /* With `cache' */
+};
+typedef struct matchup_job_s  matchup_job_t;
+
+
+/* Rate row `r' against `cols[c]', from the cache if it has the matchup. */
+  static uint16_t
+matchup_job_rate( const matchup_job_t     * job,
+                  const matchup_mon_key_t * row_key,
+                  uint32_t                  r,
+                  uint32_t                  c,
+                  uint8_t                   scenario
+                )
+{
+  uint16_t rating = 0;
+  if ( ( job->cache != NULL ) &&
+       matchup_cache_get( job->cache, row_key, job->col_keys + c, scenario,
+                          & rating
+                        ) )
+    {
+      return rating;
+    }
+  rating = matchup_battle( job->rows + r, job->cols + c, scenario );
+  if ( job->cache != NULL )
+    {
+      matchup_cache_put( job->cache, row_key, job->col_keys + c, scenario,
+                         rating
+                       );
+    }
+  return rating;
+}
+
+
+  static void
+matchup_matrix_fill( void * vjob, uint32_t begin, uint32_t end, uint32_t t )
+{
+  matchup_job_t    * job    = (matchup_job_t *) vjob;
+  matchup_matrix_t * matrix = job->matrix;
+  for ( uint32_t r = begin; r < end; r++ )
+    {
+      matchup_mon_key_t key = matchup_mon_key( job->rows + r );
+      for ( uint8_t s = 0; s < matrix->nscenarios; s++ )
+        {
+          uint16_t * out = (uint16_t *) matchup_matrix_row( matrix, r, s );
+          for ( uint32_t c = 0; c < matrix->ncols; c++ )
+            {
+              out[c] = matchup_job_rate( job, & key, r, c,
+                                         matrix->scenarios[s]
+                                       );
+            }
+        }
+    }
+}
+
+
+/**
+ * Prepare `job' to use `cache' for `ncells' more matchups of `ncols'
+ * columns: the table is grown now, since it can't be once workers share it.
+ */
+  static int
+matchup_job_cache( matchup_job_t   * job,
+                   matchup_cache_t * cache,
+                   uint32_t          ncols,
+                   size_t            ncells
+                 )
+{
+  if ( cache == NULL ) return STORE_SUCCESS;
+
+  matchup_cache_stats_t stats;
+  matchup_cache_stats( cache, & stats );
+  if ( UINT32_MAX - stats.entries < ncells ) return STORE_ERROR_NOMEM;
+  int rsl = matchup_cache_reserve( cache, stats.entries + ncells );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+
+  matchup_mon_key_t * keys = (matchup_mon_key_t *)
+    malloc( sizeof( matchup_mon_key_t ) * max( ncols, 1 ) );
+  if ( keys == NULL ) return STORE_ERROR_NOMEM;
+  for ( uint32_t c = 0; c < ncols; c++ )
+    {
+      keys[c] = matchup_mon_key( job->cols + c );
+    }
+  job->cache    = cache;
+  job->col_keys = keys;
+  return STORE_SUCCESS;
+}
+
+
+  int
+matchup_matrix_build( matchup_matrix_t     * matrix,
+                      const pvp_pokemon_t  * rows,
+                      uint32_t               nrows,
+                      const pvp_pokemon_t  * cols,
+                      uint32_t               ncols,
+                      const matchup_opts_t * opts
+                    )
+{
+  assert( matrix != NULL );
+  assert( ( rows != NULL ) || ( nrows == 0 ) );
+  assert( ( cols != NULL ) || ( ncols == 0 ) );
+
+  const matchup_opts_t defaults = MATCHUP_OPTS_DEFAULT;
+  if ( opts == NULL ) opts = & defaults;
+  if ( ( opts->scenarios & MATCHUP_ALL_SCENARIOS_M ) == 0 )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  matrix->nrows      = nrows;
+  matrix->ncols      = ncols;
+  matrix->nscenarios = 0;
+  for ( uint8_t sc = 0; sc < MATCHUP_NSCENARIOS; sc++ )
+    {
+      if ( opts->scenarios & matchup_scenario_mask( sc ) )
+        {
+          matrix->scenarios[matrix->nscenarios++] = sc;
+        }
+    }
+  matrix->ratings = (uint16_t *) malloc( sizeof( uint16_t ) *
+                                         max( (size_t) nrows *
+                                              matchup_matrix_row_len( matrix ),
+                                              1
+                                            )
+                                       );
+  if ( matrix->ratings == NULL )
+    {
+      matchup_matrix_free( matrix );
+      return STORE_ERROR_NOMEM;
+    }
+
+  matchup_job_t job = { .matrix = matrix, .rows = rows, .cols = cols };
+  int           rsl = matchup_job_cache( & job, opts->cache, ncols,
+                                         (size_t) nrows *
+                                         matchup_matrix_row_len( matrix )
+                                       );
+
+  /* Rows are a few hundred battles each, so hand them out one at a time */
+  if ( ( rsl == STORE_SUCCESS ) &&
+       ( parallel_for( nrows, 1, opts->nthreads, matchup_matrix_fill, & job )
+         != 0 ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+    }
+
+  free( (void *) job.col_keys );
+  if ( rsl != STORE_SUCCESS ) matchup_matrix_free( matrix );
+  return rsl;
+}
+
+
+  static void
+matchup_matrix_fill_cols( void     * vjob,
+                          uint32_t   begin,
+                          uint32_t   end,
+                          uint32_t   t
+                        )
+{
+  matchup_job_t    * job    = (matchup_job_t *) vjob;
+  matchup_matrix_t * matrix = job->matrix;
+  for ( uint32_t r = begin; r < end; r++ )
+    {
+      matchup_mon_key_t key = matchup_mon_key( job->rows + r );
+      for ( uint8_t s = 0; s < matrix->nscenarios; s++ )
+        {
+          uint16_t * out = (uint16_t *) matchup_matrix_row( matrix, r, s );
+          for ( uint32_t i = 0; i < job->ncols; i++ )
+            {
+              out[job->col_idx[i]] = matchup_job_rate( job, & key, r, i,
+                                                       matrix->scenarios[s]
+                                                     );
+            }
+        }
+    }
+}
+
+
+  int
+matchup_matrix_update_cols( matchup_matrix_t    * matrix,
+                            const pvp_pokemon_t * rows,
+                            const uint32_t      * col_idx,
+                            const pvp_pokemon_t * cols,
+                            uint32_t              n,
+                            uint32_t              nthreads,
+                            matchup_cache_t     * cache
+                          )
+{
+  assert( matrix != NULL );
+  assert( ( matrix->ratings != NULL ) || ( matrix->nrows == 0 ) );
+  assert( ( rows != NULL ) || ( matrix->nrows == 0 ) );
+  assert( ( ( col_idx != NULL ) && ( cols != NULL ) ) || ( n == 0 ) );
+
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      if ( matrix->ncols <= col_idx[i] ) return STORE_ERROR_BAD_VALUE;
+    }
+  if ( n == 0 ) return STORE_SUCCESS;
+
+  matchup_job_t job = {
+    .matrix  = matrix,
+    .rows    = rows,
+    .cols    = cols,
+    .col_idx = col_idx,
+    .ncols   = n
+  };
+  int rsl = matchup_job_cache( & job, cache, n,
+                               (size_t) matrix->nrows * matrix->nscenarios * n
+                             );
+  if ( ( rsl == STORE_SUCCESS ) &&
+       ( parallel_for( matrix->nrows, 0, nthreads, matchup_matrix_fill_cols,
+                       & job
+                     ) != 0 ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+    }
+  free( (void *) job.col_keys );
+  return rsl;
+}
+
+
+  void
+matchup_matrix_free( matchup_matrix_t * matrix )
+{
+  assert( matrix != NULL );
+  free( matrix->ratings );
+  matrix->ratings    = NULL;
+  matrix->nrows      = 0;
+  matrix->ncols      = 0;
+  matrix->nscenarios = 0;
+}
+
+
+  int
+matchup_matrix_scenario_idx( const matchup_matrix_t * matrix,
+                             uint8_t                  scenario
+                           )
+{
+  assert( matrix != NULL );
+  for ( uint8_t s = 0; s < matrix->nscenarios; s++ )
+    {
+      if ( matrix->scenarios[s] == scenario ) return s;
+    }
+  return -1;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,576 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "matchup_cache.h"
+#include "pokemon.h"
+#include "store.h"
+#include "util/files.h"
+#include "util/macros.h"
+#include "util/prng.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+#define MATCHUP_CACHE_MIN_CAP  1024
+
+/* Tables are reserved at most half full, and stop taking inserts at 3/4 */
+#define matchup_cache_full( CNT, CAP )  ( ( ( CAP ) / 4 ) * 3 <= ( CNT ) )
+
+
+/* -------------------------------------------------------------------------- */
+
+struct matchup_cache_hash_s {
+  uint64_t tag;
+  uint64_t val;  /* Without the rating */
+};
+typedef struct matchup_cache_hash_s  matchup_cache_hash_t;
+
+
+/* Two independently seeded 64 bit hashes of the key's words. */
+  static matchup_cache_hash_t
+matchup_cache_hash( const matchup_mon_key_t * mon1,
+                    const matchup_mon_key_t * mon2,
+                    uint8_t                   scenario
+                  )
+{
+  const matchup_cache_key_t key = {
+    .mon1     = * mon1,
+    .mon2     = * mon2,
+    .scenario = scenario,
+    .ai       = MATCHUP_AI_NAIVE,
+    .reserved = { 0 }
+  };
+  uint64_t words[sizeof( key ) / sizeof( uint64_t )];
+  uint64_t h1 = 0x9e3779b97f4a7c15ull;
+  uint64_t h2 = 0xc2b2ae3d27d4eb4full;
+
+  memcpy( words, & key, sizeof( key ) );
+  for ( size_t i = 0; i < sizeof( key ) / sizeof( uint64_t ); i++ )
+    {
+      h1 = prng_mix( h1 ^ words[i] );
+      h2 = prng_mix( h2 + words[i] );
+    }
+
+  return (matchup_cache_hash_t) {
+    .tag = ( h1 == 0 ) ? 1 : h1,
+    .val = MATCHUP_CACHE_VALID_M | ( ( h2 << 16 ) & ~ MATCHUP_CACHE_VALID_M )
+  };
+}
+
+#define matchup_cache_val_hash( VAL )  ( ( VAL ) & ~ (uint64_t) 0xffff )
+#define matchup_cache_val_rating( VAL )  ( (uint16_t) ( ( VAL ) & 0xffff ) )
+
+
+/* -------------------------------------------------------------------------- */
+
+  void
+matchup_cache_init( matchup_cache_t * cache, uint64_t data_version )
+{
+  assert( cache != NULL );
+  cache->slots        = NULL;
+  cache->cap          = 0;
+  cache->data_version = data_version;
+  cache->file         = NULL;
+  cache->file_slots   = NULL;
+  atomic_init( & cache->cnt, 0 );
+  atomic_init( & cache->hits, 0 );
+  atomic_init( & cache->file_hits, 0 );
+  atomic_init( & cache->misses, 0 );
+  atomic_init( & cache->dropped, 0 );
+}
+
+
+  static void
+matchup_cache_unmap( matchup_cache_t * cache )
+{
+  if ( cache->file != NULL )
+    {
+      munmap( (void *) cache->file, cache->file->size );
+    }
+  cache->file       = NULL;
+  cache->file_slots = NULL;
+}
+
+
+  void
+matchup_cache_free( matchup_cache_t * cache )
+{
+  assert( cache != NULL );
+  free( cache->slots );
+  matchup_cache_unmap( cache );
+  matchup_cache_init( cache, cache->data_version );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Look `hash' up among `cap' slots, returning its rating's value, or 0.
+ * Probing stops at an empty slot, tables never fill so there always is one.
+ */
+  static uint64_t
+matchup_cache_find( const matchup_cache_slot_t * slots,
+                    uint32_t                     cap,
+                    matchup_cache_hash_t         hash
+                  )
+{
+  uint32_t mask = cap - 1;
+  for ( uint32_t i = hash.tag & mask, n = 0; n < cap; i = ( i + 1 ) & mask )
+    {
+      uint64_t tag = atomic_load_explicit( & slots[i].tag,
+                                           memory_order_acquire
+                                         );
+      if ( tag == 0 ) return 0;
+      if ( tag == hash.tag )
+        {
+          uint64_t val = atomic_load_explicit( & slots[i].val,
+                                               memory_order_acquire
+                                             );
+          if ( matchup_cache_val_hash( val ) == hash.val ) return val;
+        }
+      n++;
+    }
+  return 0;
+}
+
+
+  static uint64_t
+matchup_cache_find_file( const matchup_cache_file_slot_t * slots,
+                         uint32_t                          cap,
+                         matchup_cache_hash_t              hash
+                       )
+{
+  uint32_t mask = cap - 1;
+  for ( uint32_t i = hash.tag & mask, n = 0; n < cap; i = ( i + 1 ) & mask )
+    {
+      if ( slots[i].tag == 0 ) return 0;
+      if ( ( slots[i].tag == hash.tag ) &&
+           ( matchup_cache_val_hash( slots[i].val ) == hash.val ) )
+        {
+          return slots[i].val;
+        }
+      n++;
+    }
+  return 0;
+}
+
+
+/**
+ * Claim a slot for `hash' and publish `val' in it.
+ * Returns `false' if the key was already there, or is being written by
+ * another thread.
+ */
+  static bool
+matchup_cache_insert( matchup_cache_slot_t * slots,
+                      uint32_t               cap,
+                      matchup_cache_hash_t   hash,
+                      uint64_t               val
+                    )
+{
+  uint32_t mask = cap - 1;
+  for ( uint32_t i = hash.tag & mask, n = 0; n < cap; i = ( i + 1 ) & mask )
+    {
+      uint64_t tag = 0;
+      if ( atomic_compare_exchange_strong_explicit( & slots[i].tag,
+                                                    & tag,
+                                                    hash.tag,
+                                                    memory_order_acq_rel,
+                                                    memory_order_acquire
+                                                  ) )
+        {
+          atomic_store_explicit( & slots[i].val, val, memory_order_release );
+          return true;
+        }
+      if ( tag == hash.tag )
+        {
+          uint64_t old = atomic_load_explicit( & slots[i].val,
+                                               memory_order_acquire
+                                             );
+          /* Either our key, or one still being written: leave it be */
+          if ( ( old == 0 ) || ( matchup_cache_val_hash( old ) == hash.val ) )
+            {
+              return false;
+            }
+        }
+      n++;
+    }
+  return false;
+}
+
+
+  int
+matchup_cache_reserve( matchup_cache_t * cache, uint32_t cnt )
+{
+  assert( cache != NULL );
+
+  uint32_t cap = ( cache->cap == 0 ) ? MATCHUP_CACHE_MIN_CAP : cache->cap;
+  while ( cap / 2 < cnt )
+    {
+      if ( ( UINT32_MAX / 2 ) < cap ) return STORE_ERROR_NOMEM;
+      cap *= 2;
+    }
+  if ( cap == cache->cap ) return STORE_SUCCESS;
+
+  matchup_cache_slot_t * slots = (matchup_cache_slot_t *)
+    calloc( cap, sizeof( matchup_cache_slot_t ) );
+  if ( slots == NULL ) return STORE_ERROR_NOMEM;
+
+  for ( uint32_t i = 0; i < cache->cap; i++ )
+    {
+      uint64_t val = atomic_load( & cache->slots[i].val );
+      if ( val == 0 ) continue;
+      matchup_cache_hash_t hash = {
+        .tag = atomic_load( & cache->slots[i].tag ),
+        .val = matchup_cache_val_hash( val )
+      };
+      matchup_cache_insert( slots, cap, hash, val );
+    }
+  free( cache->slots );
+  cache->slots = slots;
+  cache->cap   = cap;
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+matchup_cache_get( matchup_cache_t         * cache,
+                   const matchup_mon_key_t * mon1,
+                   const matchup_mon_key_t * mon2,
+                   uint8_t                   scenario,
+                   uint16_t                * rating
+                 )
+{
+  assert( cache != NULL );
+  assert( ( mon1 != NULL ) && ( mon2 != NULL ) );
+  assert( rating != NULL );
+
+  matchup_cache_hash_t hash = matchup_cache_hash( mon1, mon2, scenario );
+  uint64_t             val  = 0;
+
+  if ( cache->cap != 0 )
+    {
+      val = matchup_cache_find( cache->slots, cache->cap, hash );
+      if ( val != 0 )
+        {
+          atomic_fetch_add_explicit( & cache->hits, 1, memory_order_relaxed );
+          * rating = matchup_cache_val_rating( val );
+          return true;
+        }
+    }
+  if ( cache->file != NULL )
+    {
+      val = matchup_cache_find_file( cache->file_slots, cache->file->cap,
+                                     hash
+                                   );
+      if ( val != 0 )
+        {
+          atomic_fetch_add_explicit( & cache->file_hits, 1,
+                                     memory_order_relaxed
+                                   );
+          * rating = matchup_cache_val_rating( val );
+          return true;
+        }
+    }
+
+  atomic_fetch_add_explicit( & cache->misses, 1, memory_order_relaxed );
+  return false;
+}
+
+
+  int
+matchup_cache_put( matchup_cache_t         * cache,
+                   const matchup_mon_key_t * mon1,
+                   const matchup_mon_key_t * mon2,
+                   uint8_t                   scenario,
+                   uint16_t                  rating
+                 )
+{
+  assert( cache != NULL );
+  assert( ( mon1 != NULL ) && ( mon2 != NULL ) );
+
+  if ( cache->cap == 0 )
+    {
+      int rsl = matchup_cache_reserve( cache, 1 );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+    }
+
+  if ( matchup_cache_full( atomic_load_explicit( & cache->cnt,
+                                                 memory_order_relaxed
+                                               ),
+                           cache->cap
+                         ) )
+    {
+      atomic_fetch_add_explicit( & cache->dropped, 1, memory_order_relaxed );
+      return STORE_SUCCESS;
+    }
+
+  matchup_cache_hash_t hash = matchup_cache_hash( mon1, mon2, scenario );
+  if ( matchup_cache_insert( cache->slots, cache->cap, hash,
+                             hash.val | rating
+                           ) )
+    {
+      atomic_fetch_add_explicit( & cache->cnt, 1, memory_order_relaxed );
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+  void
+matchup_cache_stats( const matchup_cache_t * cache,
+                     matchup_cache_stats_t * stats
+                   )
+{
+  assert( cache != NULL );
+  assert( stats != NULL );
+  * stats = (matchup_cache_stats_t) {
+    .hits         = atomic_load( & cache->hits ),
+    .file_hits    = atomic_load( & cache->file_hits ),
+    .misses       = atomic_load( & cache->misses ),
+    .dropped      = atomic_load( & cache->dropped ),
+    .entries      = atomic_load( & cache->cnt ),
+    .file_entries = ( cache->file == NULL ) ? 0 : cache->file->cnt,
+    .cap          = cache->cap
+  };
+}
+
+
+  void
+matchup_cache_reset_stats( matchup_cache_t * cache )
+{
+  assert( cache != NULL );
+  atomic_store( & cache->hits, 0 );
+  atomic_store( & cache->file_hits, 0 );
+  atomic_store( & cache->misses, 0 );
+  atomic_store( & cache->dropped, 0 );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Add every rating in `src' to the plain `slots', counting new ones in `cnt'.
+ * Fails rather than probing forever if `slots' fills up. */
+  static int
+matchup_cache_merge( matchup_cache_file_slot_t * slots,
+                     uint32_t                    cap,
+                     const uint64_t            * src,  /* Pairs of words */
+                     uint32_t                    src_cap,
+                     uint32_t                  * cnt
+                   )
+{
+  uint32_t mask = cap - 1;
+  for ( uint32_t s = 0; s < src_cap; s++ )
+    {
+      uint64_t tag = src[s * 2];
+      uint64_t val = src[s * 2 + 1];
+      if ( ( tag == 0 ) || ( val == 0 ) ) continue;
+
+      uint32_t i = tag & mask;
+      uint32_t n = 0;
+      while ( ( slots[i].tag != 0 ) &&
+              ! ( ( slots[i].tag == tag ) &&
+                  ( matchup_cache_val_hash( slots[i].val ) ==
+                    matchup_cache_val_hash( val ) ) ) )
+        {
+          if ( cap <= ++n ) return STORE_ERROR_BAD_VALUE;
+          i = ( i + 1 ) & mask;
+        }
+      if ( slots[i].tag != 0 ) continue;
+      slots[i] = (matchup_cache_file_slot_t) { .tag = tag, .val = val };
+      ( *cnt )++;
+    }
+  return STORE_SUCCESS;
+}
+
+
+  int
+matchup_cache_write( const matchup_cache_t * cache, FILE * ostream )
+{
+  assert( cache != NULL );
+  assert( ostream != NULL );
+
+  uint32_t file_cnt = ( cache->file == NULL ) ? 0 : cache->file->cnt;
+  uint64_t total    = (uint64_t) atomic_load( & cache->cnt ) + file_cnt;
+  uint32_t cap      = MATCHUP_CACHE_MIN_CAP;
+  while ( cap / 2 < total )
+    {
+      if ( ( UINT32_MAX / 2 ) < cap ) return STORE_ERROR_NOMEM;
+      cap *= 2;
+    }
+
+  matchup_cache_file_slot_t * slots = (matchup_cache_file_slot_t *)
+    calloc( cap, sizeof( matchup_cache_file_slot_t ) );
+  if ( slots == NULL ) return STORE_ERROR_NOMEM;
+
+  /* `_Atomic uint64_t' has the same layout as `uint64_t' */
+  uint32_t cnt = 0;
+  int      rsl = matchup_cache_merge( slots, cap,
+                                      (const uint64_t *) cache->slots,
+                                      cache->cap,
+                                      & cnt
+                                    );
+  if ( ( rsl == STORE_SUCCESS ) && ( cache->file != NULL ) )
+    {
+      rsl = matchup_cache_merge( slots, cap,
+                                 (const uint64_t *) cache->file_slots,
+                                 cache->file->cap,
+                                 & cnt
+                               );
+    }
+  if ( rsl != STORE_SUCCESS )
+    {
+      free( slots );
+      return rsl;
+    }
+
+  matchup_cache_header_t header = {
+    .magic        = MATCHUP_CACHE_MAGIC,
+    .version      = MATCHUP_CACHE_VERSION,
+    .byte_order   = MATCHUP_CACHE_BYTE_ORDER,
+    .data_version = cache->data_version,
+    .size         = sizeof( matchup_cache_header_t ) +
+                    sizeof( matchup_cache_file_slot_t ) * (uint64_t) cap,
+    .cap          = cap,
+    .cnt          = cnt
+  };
+
+  if ( ( fwrite( & header, sizeof( header ), 1, ostream ) != 1 ) ||
+       ( fwrite( slots, sizeof( matchup_cache_file_slot_t ), cap, ostream )
+         != cap ) )
+    {
+      rsl = STORE_ERROR_FAIL;
+    }
+  free( slots );
+  return rsl;
+}
+
+
+  static int
+matchup_cache_fwrite( FILE * ostream, const void * cache )
+{
+  return matchup_cache_write( (const matchup_cache_t *) cache, ostream );
+}
+
+
+  int
+matchup_cache_save( const matchup_cache_t * cache, const char * fpath )
+{
+  assert( cache != NULL );
+  assert( fpath != NULL );
+  return fwrite_atomic( fpath, matchup_cache_fwrite, cache );
+}
+
+
+  static int
+matchup_cache_validate( const matchup_cache_t        * cache,
+                        const matchup_cache_header_t * header,
+                        size_t                         size
+                      )
+{
+  if ( size < sizeof( matchup_cache_header_t ) ) return STORE_ERROR_BAD_VALUE;
+  if ( memcmp( header->magic, MATCHUP_CACHE_MAGIC, sizeof( header->magic ) )
+       != 0 )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( header->version != MATCHUP_CACHE_VERSION ) return STORE_ERROR_BAD_VALUE;
+  if ( header->byte_order != MATCHUP_CACHE_BYTE_ORDER )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( header->data_version != cache->data_version )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( ( header->cap == 0 ) || ( ( header->cap & ( header->cap - 1 ) ) != 0 ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( ( header->size != size ) ||
+       ( header->size != sizeof( matchup_cache_header_t ) +
+                         sizeof( matchup_cache_file_slot_t ) *
+                         (uint64_t) header->cap ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  /* Lookups stop at empty slots, there must be some */
+  if ( header->cap / 4 * 3 < header->cnt ) return STORE_ERROR_BAD_VALUE;
+
+  /* Saves size their tables from `cnt', it has to match the slots */
+  const matchup_cache_file_slot_t * slots = (const matchup_cache_file_slot_t *)
+    ( (const char *) header + sizeof( matchup_cache_header_t ) );
+  uint32_t cnt = 0;
+  for ( uint32_t i = 0; i < header->cap; i++ ) cnt += ( slots[i].tag != 0 );
+  if ( cnt != header->cnt ) return STORE_ERROR_BAD_VALUE;
+  return STORE_SUCCESS;
+}
+
+
+  int
+matchup_cache_load( matchup_cache_t * cache, const char * fpath )
+{
+  assert( cache != NULL );
+  assert( fpath != NULL );
+
+  struct stat   st;
+  void        * map = MAP_FAILED;
+  int           fd  = open( fpath, O_RDONLY );
+
+  if ( fd == -1 )
+    {
+      if ( errno == ENOENT ) return STORE_ERROR_NOT_FOUND;
+      perror( __func__ );
+      return STORE_ERROR_FAIL;
+    }
+  if ( ( fstat( fd, & st ) != 0 ) || ( st.st_size <= 0 ) )
+    {
+      close( fd );
+      return STORE_ERROR_BAD_VALUE;
+    }
+  map = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  close( fd );
+  if ( map == MAP_FAILED )
+    {
+      perror( __func__ );
+      return STORE_ERROR_FAIL;
+    }
+
+  int rsl = matchup_cache_validate( cache, map, st.st_size );
+  if ( rsl != STORE_SUCCESS )
+    {
+      munmap( map, st.st_size );
+      return rsl;
+    }
+
+  matchup_cache_unmap( cache );
+  cache->file       = (const matchup_cache_header_t *) map;
+  cache->file_slots = (const matchup_cache_file_slot_t *)
+    ( (const char *) map + sizeof( matchup_cache_header_t ) );
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,430 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "matchup.h"
+#include "matchup_file.h"
+#include "store.h"
+#include "util/files.h"
+#include "util/macros.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+#define MATCHUP_FILE_TILE_CELLS                                               \
+  ( MATCHUP_FILE_TILE_ROWS * MATCHUP_FILE_TILE_COLS )
+
+#define matchup_file_ntiles( N, TILE )  ( ( ( N ) + ( TILE ) - 1 ) / ( TILE ) )
+
+
+/* Everything but the tiles' position follows from the dimensions. */
+  static matchup_file_header_t
+matchup_file_header( const matchup_matrix_t * matrix, uint64_t data_version )
+{
+  matchup_file_header_t header = {
+    .magic        = MATCHUP_FILE_MAGIC,
+    .version      = MATCHUP_FILE_VERSION,
+    .byte_order   = MATCHUP_FILE_BYTE_ORDER,
+    .data_version = data_version,
+    .size         = 0,
+    .nrows        = matrix->nrows,
+    .ncols        = matrix->ncols,
+    .nscenarios   = matrix->nscenarios,
+    .scenarios    = { 0 },
+    .tile_rows    = MATCHUP_FILE_TILE_ROWS,
+    .tile_cols    = MATCHUP_FILE_TILE_COLS,
+    .reserved     = 0,
+    .tiles_offset = 0
+  };
+  memcpy( header.scenarios, matrix->scenarios, sizeof( header.scenarios ) );
+
+  uint64_t offset = sizeof( matchup_file_header_t ) +
+                    sizeof( matchup_file_mon_t ) *
+                    ( (uint64_t) matrix->nrows + matrix->ncols );
+  header.tiles_offset = matchup_file_ntiles( offset, MATCHUP_FILE_ALIGN ) *
+                        MATCHUP_FILE_ALIGN;
+  header.size = header.tiles_offset +
+                MATCHUP_FILE_TILE_SIZE * matrix->nscenarios *
+                matchup_file_ntiles( (uint64_t) matrix->nrows,
+                                     MATCHUP_FILE_TILE_ROWS
+                                   ) *
+                matchup_file_ntiles( (uint64_t) matrix->ncols,
+                                     MATCHUP_FILE_TILE_COLS
+                                   );
+  return header;
+}
+
+
+  int
+matchup_file_write( const matchup_matrix_t   * matrix,
+                    const matchup_file_mon_t * rows,
+                    const matchup_file_mon_t * cols,
+                    uint64_t                   data_version,
+                    FILE                     * ostream
+                  )
+{
+  assert( matrix != NULL );
+  assert( ( rows != NULL ) || ( matrix->nrows == 0 ) );
+  assert( ( cols != NULL ) || ( matrix->ncols == 0 ) );
+  assert( ostream != NULL );
+
+  static const char pad[MATCHUP_FILE_ALIGN] = { 0 };
+
+  matchup_file_header_t header = matchup_file_header( matrix, data_version );
+  uint32_t nbands     = matchup_file_ntiles( matrix->nrows,
+                                             MATCHUP_FILE_TILE_ROWS
+                                           );
+  uint32_t ntile_cols = matchup_file_ntiles( matrix->ncols,
+                                             MATCHUP_FILE_TILE_COLS
+                                           );
+  size_t   npad       = header.tiles_offset - sizeof( header ) -
+                        sizeof( matchup_file_mon_t ) *
+                        ( (size_t) matrix->nrows + matrix->ncols );
+
+  if ( ( fwrite( & header, sizeof( header ), 1, ostream ) != 1 ) ||
+       ( ( 0 < matrix->nrows ) &&
+         ( fwrite( rows, sizeof( matchup_file_mon_t ), matrix->nrows,
+                   ostream
+                 ) != matrix->nrows ) ) ||
+       ( ( 0 < matrix->ncols ) &&
+         ( fwrite( cols, sizeof( matchup_file_mon_t ), matrix->ncols,
+                   ostream
+                 ) != matrix->ncols ) ) ||
+       ( fwrite( pad, 1, npad, ostream ) != npad ) )
+    {
+      return STORE_ERROR_FAIL;
+    }
+
+  uint16_t tile[MATCHUP_FILE_TILE_CELLS];
+  for ( uint32_t b = 0; b < nbands; b++ )
+    {
+      uint32_t row0  = b * MATCHUP_FILE_TILE_ROWS;
+      uint32_t nrows = min( matrix->nrows - row0, MATCHUP_FILE_TILE_ROWS );
+      for ( uint32_t t = 0; t < ntile_cols; t++ )
+        {
+          uint32_t col0  = t * MATCHUP_FILE_TILE_COLS;
+          uint32_t ncols = min( matrix->ncols - col0, MATCHUP_FILE_TILE_COLS );
+          for ( uint8_t s = 0; s < matrix->nscenarios; s++ )
+            {
+              memset( tile, 0, sizeof( tile ) );
+              for ( uint32_t r = 0; r < nrows; r++ )
+                {
+                  memcpy( tile + r * MATCHUP_FILE_TILE_COLS,
+                          matchup_matrix_row( matrix, row0 + r, s ) + col0,
+                          sizeof( uint16_t ) * ncols
+                        );
+                }
+              if ( fwrite( tile, sizeof( tile ), 1, ostream ) != 1 )
+                {
+                  return STORE_ERROR_FAIL;
+                }
+            }
+        }
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+/* Arguments of `matchup_file_write' for `fwrite_atomic' */
+typedef struct {
+  const matchup_matrix_t   * matrix;
+  const matchup_file_mon_t * rows;
+  const matchup_file_mon_t * cols;
+  uint64_t                   data_version;
+} matchup_file_ctx_t;
+
+
+  static int
+matchup_file_fwrite( FILE * ostream, const void * arg )
+{
+  const matchup_file_ctx_t * ctx = (const matchup_file_ctx_t *) arg;
+  return matchup_file_write( ctx->matrix, ctx->rows, ctx->cols,
+                             ctx->data_version, ostream
+                           );
+}
+
+
+  int
+matchup_file_save( const matchup_matrix_t   * matrix,
+                   const matchup_file_mon_t * rows,
+                   const matchup_file_mon_t * cols,
+                   uint64_t                   data_version,
+                   const char               * fpath
+                 )
+{
+  assert( fpath != NULL );
+  matchup_file_ctx_t ctx = {
+    .matrix       = matrix,
+    .rows         = rows,
+    .cols         = cols,
+    .data_version = data_version
+  };
+  return fwrite_atomic( fpath, matchup_file_fwrite, & ctx );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static int
+matchup_file_validate( const matchup_file_header_t * header,
+                       size_t                        size,
+                       uint64_t                      data_version
+                     )
+{
+  if ( size < sizeof( matchup_file_header_t ) ) return STORE_ERROR_BAD_VALUE;
+  if ( memcmp( header->magic, MATCHUP_FILE_MAGIC, sizeof( header->magic ) )
+       != 0 )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( ( header->version != MATCHUP_FILE_VERSION ) ||
+       ( header->byte_order != MATCHUP_FILE_BYTE_ORDER ) ||
+       ( header->data_version != data_version ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( ( header->tile_rows != MATCHUP_FILE_TILE_ROWS ) ||
+       ( header->tile_cols != MATCHUP_FILE_TILE_COLS ) ||
+       ( MATCHUP_NSCENARIOS < header->nscenarios ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  /* Scenarios index tables sized `MATCHUP_NSCENARIOS' */
+  for ( uint8_t s = 0; s < header->nscenarios; s++ )
+    {
+      if ( MATCHUP_NSCENARIOS <= header->scenarios[s] )
+        {
+          return STORE_ERROR_BAD_VALUE;
+        }
+    }
+
+  /* The header must describe exactly this file */
+  matchup_matrix_t dims = {
+    .nrows      = header->nrows,
+    .ncols      = header->ncols,
+    .nscenarios = header->nscenarios
+  };
+  matchup_file_header_t expect = matchup_file_header( & dims, data_version );
+  if ( ( header->size != size ) || ( expect.size != size ) ||
+       ( header->tiles_offset != expect.tiles_offset ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  return STORE_SUCCESS;
+}
+
+
+  int
+matchup_file_open( matchup_file_t * file,
+                   const char     * fpath,
+                   uint64_t         data_version
+                 )
+{
+  assert( file != NULL );
+  assert( fpath != NULL );
+
+  struct stat   st;
+  void        * map = MAP_FAILED;
+  int           fd  = open( fpath, O_RDONLY );
+
+  if ( fd == -1 )
+    {
+      if ( errno == ENOENT ) return STORE_ERROR_NOT_FOUND;
+      perror( __func__ );
+      return STORE_ERROR_FAIL;
+    }
+  if ( ( fstat( fd, & st ) != 0 ) || ( st.st_size <= 0 ) )
+    {
+      close( fd );
+      return STORE_ERROR_BAD_VALUE;
+    }
+  map = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  close( fd );
+  if ( map == MAP_FAILED )
+    {
+      perror( __func__ );
+      return STORE_ERROR_FAIL;
+    }
+
+  const matchup_file_header_t * header = (const matchup_file_header_t *) map;
+  int rsl = matchup_file_validate( header, st.st_size, data_version );
+  if ( rsl != STORE_SUCCESS )
+    {
+      munmap( map, st.st_size );
+      return rsl;
+    }
+
+  file->header     = header;
+  file->rows       = (const matchup_file_mon_t *) ( header + 1 );
+  file->cols       = file->rows + header->nrows;
+  file->tiles      = (const uint16_t *)
+    ( (const char *) map + header->tiles_offset );
+  file->nbands     = matchup_file_ntiles( header->nrows,
+                                          MATCHUP_FILE_TILE_ROWS
+                                        );
+  file->ntile_cols = matchup_file_ntiles( header->ncols,
+                                          MATCHUP_FILE_TILE_COLS
+                                        );
+
+  return STORE_SUCCESS;
+}
+
+
+  void
+matchup_file_close( matchup_file_t * file )
+{
+  assert( file != NULL );
+  if ( file->header != NULL )
+    {
+      munmap( (void *) file->header, file->header->size );
+    }
+  * file = (matchup_file_t) MATCHUP_FILE_INIT;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Tiles of a band are visited in file order. */
+  void
+matchup_file_row( const matchup_file_t * file,
+                  uint32_t               row,
+                  uint16_t             * ratings
+                )
+{
+  assert( file != NULL );
+  assert( file->header != NULL );
+  assert( row < file->header->nrows );
+  assert( ratings != NULL );
+
+  const matchup_file_header_t * header = file->header;
+  const uint32_t                offset = ( row % MATCHUP_FILE_TILE_ROWS ) *
+                                         MATCHUP_FILE_TILE_COLS;
+
+  for ( uint32_t t = 0; t < file->ntile_cols; t++ )
+    {
+      uint32_t col0  = t * MATCHUP_FILE_TILE_COLS;
+      uint32_t ncols = min( header->ncols - col0, MATCHUP_FILE_TILE_COLS );
+      for ( uint8_t s = 0; s < header->nscenarios; s++ )
+        {
+          memcpy( ratings + (size_t) s * header->ncols + col0,
+                  matchup_file_tile( file, row, s, col0 ) + offset,
+                  sizeof( uint16_t ) * ncols
+                );
+        }
+    }
+}
+
+
+/* Bands are visited in file order, reading `nscenarios' adjacent tiles. */
+  void
+matchup_file_col( const matchup_file_t * file,
+                  uint32_t               col,
+                  uint16_t             * ratings
+                )
+{
+  assert( file != NULL );
+  assert( file->header != NULL );
+  assert( col < file->header->ncols );
+  assert( ratings != NULL );
+
+  const matchup_file_header_t * header = file->header;
+  const uint32_t                offset = col % MATCHUP_FILE_TILE_COLS;
+
+  for ( uint32_t b = 0; b < file->nbands; b++ )
+    {
+      uint32_t row0  = b * MATCHUP_FILE_TILE_ROWS;
+      uint32_t nrows = min( header->nrows - row0, MATCHUP_FILE_TILE_ROWS );
+      for ( uint8_t s = 0; s < header->nscenarios; s++ )
+        {
+          const uint16_t * tile   = matchup_file_tile( file, row0, s, col );
+          uint16_t       * ostart = ratings + (size_t) s * header->nrows +
+                                    row0;
+          for ( uint32_t r = 0; r < nrows; r++ )
+            {
+              ostart[r] = tile[r * MATCHUP_FILE_TILE_COLS + offset];
+            }
+        }
+    }
+}
+
+
+  int
+matchup_file_read_matrix( const matchup_file_t * file,
+                          matchup_matrix_t     * matrix
+                        )
+{
+  assert( file != NULL );
+  assert( file->header != NULL );
+  assert( matrix != NULL );
+
+  const matchup_file_header_t * header = file->header;
+  size_t ncells = (size_t) header->nrows * header->nscenarios * header->ncols;
+
+  matrix->ratings = (uint16_t *) malloc( sizeof( uint16_t ) *
+                                         max( ncells, 1 )
+                                       );
+  if ( matrix->ratings == NULL ) return STORE_ERROR_NOMEM;
+  matrix->nrows      = header->nrows;
+  matrix->ncols      = header->ncols;
+  matrix->nscenarios = header->nscenarios;
+  memcpy( matrix->scenarios, header->scenarios, sizeof( matrix->scenarios ) );
+
+  /* Rows are laid out like `matchup_file_row' writes them */
+  for ( uint32_t r = 0; r < header->nrows; r++ )
+    {
+      matchup_file_row( file, r,
+                        matrix->ratings + r * matchup_matrix_row_len( matrix )
+                      );
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+  bool
+matchup_file_find( const matchup_file_mon_t * mons,
+                   uint32_t                   n,
+                   const matchup_file_mon_t * mon,
+                   uint32_t                 * idx
+                 )
+{
+  assert( ( mons != NULL ) || ( n == 0 ) );
+  assert( mon != NULL );
+  assert( idx != NULL );
+
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      if ( ( mons[i].dex_number == mon->dex_number ) &&
+           ( mons[i].form_idx == mon->form_idx ) &&
+           ( mons[i].level == mon->level ) &&
+           ( mons[i].fast_move_id == mon->fast_move_id ) &&
+           ( mons[i].charged_move_ids[0] == mon->charged_move_ids[0] ) &&
+           ( mons[i].charged_move_ids[1] == mon->charged_move_ids[1] ) )
+        {
+          * idx = i;
+          return true;
+        }
+    }
+  return false;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
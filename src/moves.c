@@ -93,6 +93,49 @@ pvp_fast_move_from_store( store_t         * store,
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+  bool
+store_move_pvp_equal( const store_move_t * a, const store_move_t * b )
+{
+  assert( a != NULL );
+  assert( b != NULL );
+  if ( ( a->type != b->type ) || ( a->is_fast != b->is_fast ) ) return false;
+  if ( ( a->pvp_power != b->pvp_power ) || ( a->pvp_energy != b->pvp_energy ) )
+    {
+      return false;
+    }
+  if ( a->is_fast ) return a->cooldown == b->cooldown;
+  return buff_equal( a->buff, b->buff );
+}
+
+
+  bool
+store_move_dominates( const store_move_t * a, const store_move_t * b )
+{
+  assert( a != NULL );
+  assert( b != NULL );
+  if ( ( a->type != b->type ) || ( a->is_fast != b->is_fast ) ) return false;
+
+  if ( a->is_fast )
+    {
+      /* Compare per turn rates without dividing: `pa / ta >= pb / tb' */
+      uint32_t ta  = max( a->cooldown, 1 );
+      uint32_t tb  = max( b->cooldown, 1 );
+      uint32_t dpa = a->pvp_power * tb, dpb = b->pvp_power * ta;
+      uint32_t epa = a->pvp_energy * tb, epb = b->pvp_energy * ta;
+      return ( dpb <= dpa ) && ( epb <= epa ) &&
+             ( ( dpb < dpa ) || ( epb < epa ) );
+    }
+
+  if ( ! buff_equal( a->buff, b->buff ) ) return false;
+  return ( b->pvp_power <= a->pvp_power ) &&
+         ( a->pvp_energy <= b->pvp_energy ) &&
+         ( ( b->pvp_power < a->pvp_power ) ||
+           ( a->pvp_energy < b->pvp_energy ) );
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   int
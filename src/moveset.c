@@ -0,0 +1,459 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "cupstore.h"
+#include "filter_index.h"
+#include "matchup.h"
+#include "moves.h"
+#include "moveset.h"
+#include "pokemon.h"
+#include "util/bitset.h"
+#include "util/macros.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+  static int
+moveset_fetch_moves( store_t        *  store,
+                     const int16_t  *  ids,
+                     uint8_t           cnt,
+                     store_move_t   ** moves
+                   )
+{
+  for ( uint8_t i = 0; i < cnt; i++ )
+    {
+      int rsl = store->get( store, move_id_store_key( abs( ids[i] ) ),
+                            (void **) & moves[i]
+                          );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+    }
+  return STORE_SUCCESS;
+}
+
+
+/**
+ * Whether move `i' is as good as move `j' for pruning: the same move, a
+ * dominating one, or one with equal stats listed earlier.
+ * Breaking ties by position keeps exactly one of a group of equal moves.
+ */
+  static bool
+moveset_covers( store_move_t * const * moves, uint8_t i, uint8_t j )
+{
+  if ( i == j ) return true;
+  if ( store_move_dominates( moves[i], moves[j] ) ) return true;
+  return ( i < j ) && store_move_pvp_equal( moves[i], moves[j] );
+}
+
+
+/* Pair `( d1, d2 )' is as good as `( c1, c2 )' in either order. */
+  static bool
+moveset_pair_covers( store_move_t * const * moves,
+                     uint8_t d1, uint8_t d2,
+                     uint8_t c1, uint8_t c2
+                   )
+{
+  return ( moveset_covers( moves, d1, c1 ) &&
+           moveset_covers( moves, d2, c2 ) ) ||
+         ( moveset_covers( moves, d1, c2 ) &&
+           moveset_covers( moves, d2, c1 ) );
+}
+
+
+/**
+ * Whether the pair of charged moves `( c1, c2 )' is dominated by another
+ * pair of the `nc' charged moves.
+ * Pairs are compared rather than single moves: a dominated move is still
+ * worth carrying when every better move is already in the pair.
+ */
+  static bool
+moveset_pair_dominated( store_move_t * const * moves,
+                        uint8_t                nc,
+                        uint8_t                c1,
+                        uint8_t                c2
+                      )
+{
+  for ( uint8_t d1 = 0; d1 < nc; d1++ )
+    {
+      for ( uint8_t d2 = d1 + 1; d2 < nc; d2++ )
+        {
+          if ( ( d1 == c1 ) && ( d2 == c2 ) ) continue;
+          if ( moveset_pair_covers( moves, d1, d2, c1, c2 ) ) return true;
+        }
+    }
+  return false;
+}
+
+
+  int
+moveset_candidates( store_t          * store,
+                    const pdex_mon_t * pdex,
+                    bool               prune,
+                    moveset_t        * movesets,
+                    uint32_t         * n
+                  )
+{
+  assert( pdex != NULL );
+  assert( ( movesets != NULL ) || ( moveset_count( pdex ) == 0 ) );
+  assert( n != NULL );
+
+  store_move_t * fast[UINT8_MAX]    = { NULL };
+  store_move_t * charged[UINT8_MAX] = { NULL };
+  uint8_t        nf                 = pdex->fast_moves_cnt;
+  uint8_t        nc                 = pdex->charged_moves_cnt;
+
+  * n = 0;
+  if ( prune )
+    {
+      if ( ( store == NULL ) || ! ( store->flags & SF_STANDARD_KEY_M ) )
+        {
+          return STORE_ERROR_BAD_VALUE;
+        }
+      int rsl = moveset_fetch_moves( store, pdex->fast_move_ids, nf, fast );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+      rsl = moveset_fetch_moves( store, pdex->charged_move_ids, nc, charged );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+    }
+
+  for ( uint8_t f = 0; f < nf; f++ )
+    {
+      bool dominated = false;
+      for ( uint8_t g = 0; prune && ( g < nf ) && ( ! dominated ); g++ )
+        {
+          dominated = ( g != f ) && moveset_covers( fast, g, f );
+        }
+      if ( dominated ) continue;
+
+      for ( uint8_t c1 = 0; c1 < nc; c1++ )
+        {
+          /* `c2 == nc' is no second move, only for a lone charged move */
+          for ( uint8_t c2 = c1 + 1; c2 <= nc; c2++ )
+            {
+              if ( ( c2 == nc ) && ( nc != 1 ) ) continue;
+              if ( prune && ( c2 < nc ) &&
+                   moveset_pair_dominated( charged, nc, c1, c2 ) )
+                {
+                  continue;
+                }
+              movesets[( * n )++] = (moveset_t) {
+                .fast_move_id     = abs( pdex->fast_move_ids[f] ),
+                .charged_move_ids = {
+                  abs( pdex->charged_move_ids[c1] ),
+                  ( c2 == nc ) ? 0 : abs( pdex->charged_move_ids[c2] )
+                }
+              };
+            }
+        }
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* One moveset to simulate, a row of the matrix */
+struct moveset_row_s {
+  moveset_t moveset;
+  uint32_t  species;  /* Index into `league->best' */
+};
+typedef struct moveset_row_s  moveset_row_t;
+
+
+  static int
+moveset_reserve( moveset_row_t ** rows, uint32_t * cap, uint32_t n )
+{
+  if ( n <= * cap ) return STORE_SUCCESS;
+  uint32_t        ncap = max( n, max( * cap * 2, 64 ) );
+  moveset_row_t * tmp  = realloc( * rows, sizeof( moveset_row_t ) * ncap );
+  if ( tmp == NULL ) return STORE_ERROR_NOMEM;
+  * rows = tmp;
+  * cap  = ncap;
+  return STORE_SUCCESS;
+}
+
+
+/**
+ * Enter every eligible species of `cup' into `league->best', and a row for
+ * each of their candidate movesets.
+ * Each species' Pokedex entry is kept in `pdexs' for building its Pokemon.
+ */
+  static int
+moveset_enter( moveset_league_t     *  league,
+               const cup_t          *  cup,
+               const moveset_opts_t *  opts,
+               const pdex_mon_t     ** pdexs,
+               moveset_row_t        ** rows,
+               uint32_t             *  nrows
+             )
+{
+  const filter_index_t * index   = cup->index;
+  moveset_t            * scratch = NULL;
+  uint32_t               cap     = 0;
+  int                    rsl     = STORE_SUCCESS;
+
+  for ( uint32_t i = 0; i < index->nmons; i++ )
+    {
+      if ( ! bitset_test( cup->pool, i ) ) continue;
+
+      pdex_mon_t * pdex = NULL;
+      rsl = filter_index_get( index, i, & pdex );
+      if ( rsl != STORE_SUCCESS ) break;
+      if ( ( pdex->fast_moves_cnt == 0 ) || ( pdex->charged_moves_cnt == 0 ) )
+        {
+          continue;
+        }
+      uint8_t level =
+        (uint8_t) get_max_level_for_cp( pdex->base_stats, opts->ivs,
+                                        cup->cp_cap
+                                      );
+      if ( level == 0 ) continue;
+
+      uint32_t    total = moveset_count( pdex );
+      uint32_t    n     = 0;
+      moveset_t * tmp   = realloc( scratch, sizeof( moveset_t ) * total );
+      if ( tmp == NULL )
+        {
+          rsl = STORE_ERROR_NOMEM;
+          break;
+        }
+      scratch = tmp;
+      rsl = moveset_candidates( index->store, pdex, opts->prune, scratch,
+                                & n
+                              );
+      if ( rsl != STORE_SUCCESS ) break;
+      rsl = moveset_reserve( rows, & cap, * nrows + n );
+      if ( rsl != STORE_SUCCESS ) break;
+
+      for ( uint32_t m = 0; m < n; m++ )
+        {
+          ( * rows )[( * nrows )++] = (moveset_row_t) {
+            .moveset = scratch[m],
+            .species = league->nspecies
+          };
+        }
+      pdexs[league->nspecies]        = pdex;
+      league->best[league->nspecies] = (moveset_best_t) {
+        .dex_number = pdex->dex_number,
+        .form_idx   = pdex->form_idx,
+        .level      = level,
+        .moveset    = scratch[0],
+        .score      = 0.0,
+        .nmovesets  = total,
+        .nsimulated = n
+      };
+      league->nspecies++;
+      league->nmovesets  += total;
+      league->nsimulated += n;
+    }
+
+  free( scratch );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  return ( league->nspecies == 0 ) ? STORE_ERROR_NOT_FOUND : STORE_SUCCESS;
+}
+
+
+/* Build a `pvp_pokemon_t' for every row. */
+  static int
+moveset_init_mons( const moveset_league_t  * league,
+                   const moveset_opts_t    * opts,
+                   store_t                 * store,
+                   const pdex_mon_t       ** pdexs,
+                   const moveset_row_t     * rows,
+                   uint32_t                  nrows,
+                   pvp_pokemon_t           * mons
+                 )
+{
+  roster_pokemon_t * rmons = (roster_pokemon_t *)
+    malloc( sizeof( roster_pokemon_t ) * nrows );
+  base_pokemon_t   * bases = (base_pokemon_t *)
+    malloc( sizeof( base_pokemon_t ) * league->nspecies );
+  int                rsl   = STORE_SUCCESS;
+
+  if ( ( rmons == NULL ) || ( bases == NULL ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+
+  for ( uint32_t s = 0; s < league->nspecies; s++ )
+    {
+      bases[s] = (base_pokemon_t) {
+        .pdex_mon = pdexs[s],
+        .level    = league->best[s].level,
+        .ivs      = opts->ivs
+      };
+    }
+  for ( uint32_t r = 0; r < nrows; r++ )
+    {
+      const moveset_t * moveset = & rows[r].moveset;
+      rmons[r] = (roster_pokemon_t) {
+        .base             = bases + rows[r].species,
+        .fast_move_id     = moveset->fast_move_id,
+        .charged_move_ids = { moveset->charged_move_ids[0],
+                              moveset->charged_move_ids[1]
+                            }
+      };
+    }
+
+  rsl = pvp_pokemon_init_many( mons, rmons, nrows, store );
+
+done:
+  free( rmons );
+  free( bases );
+  return rsl;
+}
+
+
+/**
+ * Score each row as its mean Battle Rating over the scenarios, each a mean
+ * over the meta weighted by `weights', and keep each species' best.
+ * Ties go to the moveset listed first.
+ */
+  static void
+moveset_pick( moveset_league_t       * league,
+              const moveset_row_t    * rows,
+              const matchup_matrix_t * matrix,
+              const float            * weights
+            )
+{
+  double total = matrix->ncols;
+  if ( weights != NULL )
+    {
+      total = 0.0;
+      for ( uint32_t c = 0; c < matrix->ncols; c++ ) total += weights[c];
+    }
+
+  for ( uint32_t s = 0; s < league->nspecies; s++ )
+    {
+      league->best[s].score = -1.0;
+    }
+
+  for ( uint32_t r = 0; r < matrix->nrows; r++ )
+    {
+      double score = 0.0;
+      for ( uint8_t s = 0; s < matrix->nscenarios; s++ )
+        {
+          const uint16_t * row = matchup_matrix_row( matrix, r, s );
+          double           sum = 0.0;
+          for ( uint32_t c = 0; c < matrix->ncols; c++ )
+            {
+              sum += ( ( weights == NULL ) ? 1.0 : weights[c] ) * row[c];
+            }
+          score += sum / total;
+        }
+      score /= matrix->nscenarios;
+
+      moveset_best_t * best = league->best + rows[r].species;
+      if ( best->score < score )
+        {
+          best->score   = (float) score;
+          best->moveset = rows[r].moveset;
+        }
+    }
+}
+
+
+  int
+moveset_optimize( moveset_league_t     * league,
+                  const cup_t          * cup,
+                  const pvp_pokemon_t  * meta,
+                  uint32_t               nmeta,
+                  const moveset_opts_t * opts
+                )
+{
+  assert( league != NULL );
+  assert( cup != NULL );
+  assert( cup->index != NULL );
+  assert( ( meta != NULL ) || ( nmeta == 0 ) );
+
+  const moveset_opts_t defaults = MOVESET_OPTS_DEFAULT;
+  if ( opts == NULL ) opts = & defaults;
+
+  * league = (moveset_league_t) MOVESET_LEAGUE_INIT;
+  league->cp_cap = cup->cp_cap;
+
+  if ( nmeta == 0 ) return STORE_ERROR_BAD_VALUE;
+  if ( opts->weights != NULL )
+    {
+      double total = 0.0;
+      for ( uint32_t c = 0; c < nmeta; c++ )
+        {
+          if ( opts->weights[c] < 0.0 ) return STORE_ERROR_BAD_VALUE;
+          total += opts->weights[c];
+        }
+      if ( total == 0.0 ) return STORE_ERROR_BAD_VALUE;
+    }
+
+  const pdex_mon_t ** pdexs  = NULL;
+  moveset_row_t     * rows   = NULL;
+  uint32_t            nrows  = 0;
+  pvp_pokemon_t     * mons   = NULL;
+  matchup_matrix_t    matrix = MATCHUP_MATRIX_INIT;
+  int                 rsl    = STORE_SUCCESS;
+
+  league->best = (moveset_best_t *)
+    malloc( sizeof( moveset_best_t ) * max( cup->pool_size, 1 ) );
+  pdexs = (const pdex_mon_t **)
+    malloc( sizeof( pdex_mon_t * ) * max( cup->pool_size, 1 ) );
+  if ( ( league->best == NULL ) || ( pdexs == NULL ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+
+  rsl = moveset_enter( league, cup, opts, pdexs, & rows, & nrows );
+  if ( rsl != STORE_SUCCESS ) goto done;
+
+  mons = (pvp_pokemon_t *) malloc( sizeof( pvp_pokemon_t ) * nrows );
+  if ( mons == NULL )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+  rsl = moveset_init_mons( league, opts, cup->index->store, pdexs, rows,
+                           nrows, mons
+                         );
+  if ( rsl != STORE_SUCCESS ) goto done;
+
+  const matchup_opts_t mopts = {
+    .scenarios = opts->scenarios,
+    .nthreads  = opts->nthreads,
+    .cache     = opts->cache
+  };
+  rsl = matchup_matrix_build( & matrix, mons, nrows, meta, nmeta, & mopts );
+  if ( rsl != STORE_SUCCESS ) goto done;
+
+  moveset_pick( league, rows, & matrix, opts->weights );
+
+done:
+  free( pdexs );
+  free( rows );
+  free( mons );
+  matchup_matrix_free( & matrix );
+  if ( rsl != STORE_SUCCESS ) moveset_league_free( league );
+  return rsl;
+}
+
+
+  void
+moveset_league_free( moveset_league_t * league )
+{
+  assert( league != NULL );
+  free( league->best );
+  * league = (moveset_league_t) MOVESET_LEAGUE_INIT;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
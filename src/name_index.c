@@ -0,0 +1,189 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "moves.h"
+#include "name_index.h"
+#include "pokedex.h"
+#include "store.h"
+#include "util/bktree.h"
+#include <assert.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+  size_t
+name_index_normalize( const char * name, char * buffer )
+{
+  assert( name != NULL );
+  assert( buffer != NULL );
+
+  size_t len = 0;
+  bool   sep = false;
+  for ( const char * c = name; ( *c != '\0' ) && ( len < NAME_INDEX_MAX_LEN );
+        c++ )
+    {
+      if ( isalnum( (unsigned char) *c ) )
+        {
+          if ( sep && ( 0 < len ) ) buffer[len++] = '_';
+          if ( len < NAME_INDEX_MAX_LEN )
+            {
+              buffer[len++] = (char) toupper( (unsigned char) *c );
+            }
+          sep = false;
+        }
+      else
+        {
+          sep = true;
+        }
+    }
+  buffer[len] = '\0';
+  return len;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Tree values are keys' `data_f', which are fetched from the store on a hit */
+#define name_index_data( KEY )  ( (void *) (uintptr_t) ( KEY ).data_f )
+
+
+  static int
+name_index_insert( bktree_t * tree, const char * name, store_key_t key )
+{
+  char buffer[NAME_INDEX_MAX_LEN + 1];
+  name_index_normalize( name, buffer );
+  return ( bktree_insert( tree, buffer, name_index_data( key ) ) < 0 )
+         ? STORE_ERROR_NOMEM
+         : STORE_SUCCESS;
+}
+
+
+  static int
+name_index_add_mon( void * vtree, store_key_t key, void * val )
+{
+  bktree_t   * tree = (bktree_t *) vtree;
+  pdex_mon_t * mon  = (pdex_mon_t *) val;
+  char         buffer[2 * NAME_INDEX_MAX_LEN + 2];
+  int          rsl  = STORE_SUCCESS;
+
+  if ( mon->form_idx == 0 )
+    {
+      rsl = name_index_insert( tree, mon->name, key );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+    }
+
+  if ( ( mon->form_name == NULL ) ||
+       ( strcmp( mon->form_name, "BASE" ) == 0 ) ||
+       ( strcmp( mon->form_name, "NORMAL" ) == 0 )
+     )
+    {
+      return STORE_SUCCESS;
+    }
+
+  snprintf( buffer, sizeof( buffer ), "%s_%s", mon->name, mon->form_name );
+  rsl = name_index_insert( tree, buffer, key );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  snprintf( buffer, sizeof( buffer ), "%s_%s", mon->form_name, mon->name );
+  return name_index_insert( tree, buffer, key );
+}
+
+
+  static int
+name_index_add_move( void * vtree, store_key_t key, void * val )
+{
+  return name_index_insert( (bktree_t *) vtree,
+                            ( (store_move_t *) val )->name,
+                            key
+                          );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+name_index_init( name_index_t * idx, store_t * store )
+{
+  assert( idx != NULL );
+  assert( store != NULL );
+
+  idx->store = store;
+  bktree_init( & idx->mons );
+  bktree_init( & idx->moves );
+
+  int rsl = store_each( store, STORE_POKEDEX, name_index_add_mon, & idx->mons );
+  if ( rsl == STORE_SUCCESS )
+    {
+      rsl = store_each( store, STORE_MOVE, name_index_add_move, & idx->moves );
+    }
+  if ( rsl != STORE_SUCCESS ) name_index_free( idx );
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  void
+name_index_free( name_index_t * idx )
+{
+  assert( idx != NULL );
+  bktree_free( & idx->mons );
+  bktree_free( & idx->moves );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+name_index_lookup( const name_index_t  *  idx,
+                   store_type_t           val_type,
+                   const char          *  name,
+                   int                    max_dist,
+                   void                ** val,
+                   int                 *  dist
+                 )
+{
+  assert( idx != NULL );
+  assert( name != NULL );
+
+  const bktree_t * tree = NULL;
+  if ( val_type == STORE_POKEDEX )   tree = & idx->mons;
+  else if ( val_type == STORE_MOVE ) tree = & idx->moves;
+  else                               return STORE_ERROR_BAD_VALUE;
+
+  char           buffer[NAME_INDEX_MAX_LEN + 1];
+  bktree_match_t match;
+  name_index_normalize( name, buffer );
+
+  if ( bktree_find( tree, buffer, max_dist, & match, 1 ) == 0 )
+    {
+      if ( val != NULL ) *val = NULL;
+      return STORE_ERROR_NOT_FOUND;
+    }
+
+  if ( dist != NULL ) *dist = match.dist;
+  if ( val == NULL ) return STORE_SUCCESS;
+
+  store_key_t key = {
+    .key_type = STORE_NUM,
+    .val_type = val_type,
+    .data_f   = (uint32_t) (uintptr_t) match.data
+  };
+  return idx->store->get( idx->store, key, val );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
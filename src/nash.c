@@ -0,0 +1,618 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "ai/ai.h"
+#include "matchup.h"
+#include "nash.h"
+#include "pokemon.h"
+#include "team_builder.h"
+#include "util/macros.h"
+#include "util/prng.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Pivots and probabilities smaller than this are treated as 0 */
+#define NASH_EPS  1e-9
+
+/* Regret Matching+ checks its gap this often, which costs two products */
+#define NASH_CHECK_EVERY  16
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+nash_game_init( nash_game_t * game, uint32_t nrows, uint32_t ncols )
+{
+  assert( game != NULL );
+  * game = (nash_game_t) NASH_GAME_INIT;
+  if ( ( nrows == 0 ) || ( ncols == 0 ) ) return STORE_ERROR_BAD_VALUE;
+  game->payoff = (double *) calloc( (size_t) nrows * ncols, sizeof( double ) );
+  if ( game->payoff == NULL ) return STORE_ERROR_NOMEM;
+  game->nrows = nrows;
+  game->ncols = ncols;
+  return STORE_SUCCESS;
+}
+
+
+  int
+nash_game_from_matrix( nash_game_t            * game,
+                       const matchup_matrix_t * matrix,
+                       uint8_t                  scenario,
+                       const uint32_t         * rows,
+                       uint32_t                 nrows
+                     )
+{
+  assert( game != NULL );
+  assert( matrix != NULL );
+
+  * game = (nash_game_t) NASH_GAME_INIT;
+  int s = matchup_matrix_scenario_idx( matrix, scenario );
+  if ( s < 0 ) return STORE_ERROR_BAD_VALUE;
+  if ( rows == NULL ) nrows = matrix->nrows;
+
+  int rsl = nash_game_init( game, nrows, matrix->ncols );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  for ( uint32_t i = 0; i < nrows; i++ )
+    {
+      uint32_t r = ( rows == NULL ) ? i : rows[i];
+      assert( r < matrix->nrows );
+      const uint16_t * ratings = matchup_matrix_row( matrix, r, s );
+      for ( uint32_t c = 0; c < matrix->ncols; c++ )
+        {
+          nash_payoff( game, i, c ) = ratings[c] / (double) MATCHUP_RATING_MAX;
+        }
+    }
+  return STORE_SUCCESS;
+}
+
+
+  void
+nash_game_free( nash_game_t * game )
+{
+  assert( game != NULL );
+  free( game->payoff );
+  * game = (nash_game_t) NASH_GAME_INIT;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* `out[r]' is row `r's expected payoff against `col'. */
+  static void
+nash_row_values( const nash_game_t * game, const double * col, double * out )
+{
+  for ( uint32_t r = 0; r < game->nrows; r++ )
+    {
+      const double * p = game->payoff + (size_t) r * game->ncols;
+      double         v = 0.0;
+      for ( uint32_t c = 0; c < game->ncols; c++ ) v += p[c] * col[c];
+      out[r] = v;
+    }
+}
+
+
+/* `out[c]' is the row player's expected payoff from `row' at column `c'. */
+  static void
+nash_col_values( const nash_game_t * game, const double * row, double * out )
+{
+  memset( out, 0, sizeof( double ) * game->ncols );
+  for ( uint32_t r = 0; r < game->nrows; r++ )
+    {
+      const double * p = game->payoff + (size_t) r * game->ncols;
+      const double   w = row[r];
+      if ( w == 0.0 ) continue;
+      for ( uint32_t c = 0; c < game->ncols; c++ ) out[c] += w * p[c];
+    }
+}
+
+
+  static uint32_t
+nash_argmax( const double * v, uint32_t n )
+{
+  uint32_t best = 0;
+  for ( uint32_t i = 1; i < n; i++ ) if ( v[best] < v[i] ) best = i;
+  return best;
+}
+
+
+  static uint32_t
+nash_argmin( const double * v, uint32_t n )
+{
+  uint32_t best = 0;
+  for ( uint32_t i = 1; i < n; i++ ) if ( v[i] < v[best] ) best = i;
+  return best;
+}
+
+
+/**
+ * Set `eq->value' and `eq->gap' from its strategies, `rv' and `cv' are
+ * scratch for `nrows' and `ncols' values.
+ */
+  static void
+nash_measure( const nash_game_t * game, nash_eq_t * eq, double * rv,
+              double * cv
+            )
+{
+  nash_row_values( game, eq->col, rv );
+  nash_col_values( game, eq->row, cv );
+  double value = 0.0;
+  for ( uint32_t r = 0; r < game->nrows; r++ ) value += eq->row[r] * rv[r];
+  eq->value = value;
+  eq->gap   = rv[nash_argmax( rv, game->nrows )] -
+              cv[nash_argmin( cv, game->ncols )];
+}
+
+
+  uint32_t
+nash_best_row( const nash_game_t * game, const double * col, double * value )
+{
+  assert( game != NULL );
+  assert( col != NULL );
+  uint32_t best = 0;
+  double   most = 0.0;
+  for ( uint32_t r = 0; r < game->nrows; r++ )
+    {
+      const double * p = game->payoff + (size_t) r * game->ncols;
+      double         v = 0.0;
+      for ( uint32_t c = 0; c < game->ncols; c++ ) v += p[c] * col[c];
+      if ( ( r == 0 ) || ( most < v ) )
+        {
+          best = r;
+          most = v;
+        }
+    }
+  if ( value != NULL ) * value = most;
+  return best;
+}
+
+
+  uint32_t
+nash_best_col( const nash_game_t * game, const double * row, double * value )
+{
+  assert( game != NULL );
+  assert( row != NULL );
+  uint32_t best  = 0;
+  double   least = 0.0;
+  for ( uint32_t c = 0; c < game->ncols; c++ )
+    {
+      double v = 0.0;
+      for ( uint32_t r = 0; r < game->nrows; r++ )
+        {
+          v += row[r] * nash_payoff( game, r, c );
+        }
+      if ( ( c == 0 ) || ( v < least ) )
+        {
+          best  = c;
+          least = v;
+        }
+    }
+  if ( value != NULL ) * value = least;
+  return best;
+}
+
+
+/* Scale `v' to sum to 1, dropping specks; all zeroes become uniform. */
+  static void
+nash_normalize( double * v, uint32_t n )
+{
+  double sum = 0.0;
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      if ( v[i] < NASH_EPS ) v[i] = 0.0;
+      sum += v[i];
+    }
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      v[i] = ( sum == 0.0 ) ? 1.0 / n : v[i] / sum;
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Shifting every payoff to at least 1 makes the value positive, and then the
+ * column player's strategies `y / sum( y )' for
+ *   maximize sum( y ) subject to A y <= 1, y >= 0
+ * are optimal, with `value = 1 / sum( y )'.
+ * The row player's strategy is the dual, which the final tableau holds in the
+ * objective row under the slacks.
+ * The origin is feasible and `A' is positive, so the program is bounded; game
+ * tableaus are very degenerate, so Bland's rule keeps the simplex from
+ * cycling.
+ */
+  static int
+nash_lp( const nash_game_t * game, nash_eq_t * eq )
+{
+  const uint32_t   m     = game->nrows;
+  const uint32_t   n     = game->ncols;
+  const size_t     w     = (size_t) n + m + 1;
+  double         * t     = (double *) calloc( ( m + 1 ) * w, sizeof( double ) );
+  uint32_t       * basis = (uint32_t *) malloc( sizeof( uint32_t ) * m );
+  double         * z     = t + (size_t) m * w;
+
+  if ( ( t == NULL ) || ( basis == NULL ) )
+    {
+      free( t );
+      free( basis );
+      return STORE_ERROR_NOMEM;
+    }
+
+  double low = game->payoff[0];
+  for ( size_t i = 1; i < (size_t) m * n; i++ )
+    {
+      low = min( low, game->payoff[i] );
+    }
+  const double shift = 1.0 - low;
+
+  for ( uint32_t i = 0; i < m; i++ )
+    {
+      double * row = t + i * w;
+      for ( uint32_t j = 0; j < n; j++ )
+        {
+          row[j] = nash_payoff( game, i, j ) + shift;
+        }
+      row[n + i] = 1.0;
+      row[w - 1] = 1.0;
+      basis[i]   = n + i;
+    }
+  for ( uint32_t j = 0; j < n; j++ ) z[j] = -1.0;
+
+  for ( ;; )
+    {
+      size_t e = w;
+      for ( size_t j = 0; j < w - 1; j++ )
+        {
+          if ( z[j] < -NASH_EPS )
+            {
+              e = j;
+              break;
+            }
+        }
+      if ( e == w ) break;
+
+      uint32_t l    = m;
+      double   best = 0.0;
+      for ( uint32_t i = 0; i < m; i++ )
+        {
+          double a = t[i * w + e];
+          if ( a <= NASH_EPS ) continue;
+          double ratio = t[i * w + w - 1] / a;
+          if ( ( l == m ) || ( ratio < best - NASH_EPS ) ||
+               ( ( ratio <= best + NASH_EPS ) && ( basis[i] < basis[l] ) ) )
+            {
+              l    = i;
+              best = ratio;
+            }
+        }
+      assert( l < m );
+
+      double * pivot = t + l * w;
+      double   inv   = 1.0 / pivot[e];
+      for ( size_t j = 0; j < w; j++ ) pivot[j] *= inv;
+      for ( uint32_t i = 0; i <= m; i++ )
+        {
+          double * row = t + i * w;
+          double   f   = row[e];
+          if ( ( i == l ) || ( f == 0.0 ) ) continue;
+          for ( size_t j = 0; j < w; j++ ) row[j] -= f * pivot[j];
+        }
+      basis[l] = e;
+      eq->iters++;
+    }
+
+  memset( eq->col, 0, sizeof( double ) * n );
+  for ( uint32_t i = 0; i < m; i++ )
+    {
+      if ( basis[i] < n ) eq->col[basis[i]] = t[i * w + w - 1];
+    }
+  for ( uint32_t i = 0; i < m; i++ ) eq->row[i] = z[n + i];
+  nash_normalize( eq->row, m );
+  nash_normalize( eq->col, n );
+
+  free( t );
+  free( basis );
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Play in proportion to positive regret, uniformly if there is none. */
+  static void
+nash_regret_strategy( const double * regret, uint32_t n, double * out )
+{
+  double sum = 0.0;
+  for ( uint32_t i = 0; i < n; i++ ) sum += regret[i];
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      out[i] = ( sum <= 0.0 ) ? 1.0 / n : regret[i] / sum;
+    }
+}
+
+
+/**
+ * Regret Matching+: regrets are floored at 0, the row player updates against
+ * the column player's current strategy and the column player against the
+ * row player's new one, and iteration `t' counts `t' times in the averages.
+ */
+  static int
+nash_regret( const nash_game_t * game,
+             const nash_opts_t * opts,
+             nash_eq_t         * eq
+           )
+{
+  const uint32_t   m       = game->nrows;
+  const uint32_t   n       = game->ncols;
+  double         * scratch =
+    (double *) calloc( 4 * ( (size_t) m + n ), sizeof( double ) );
+  if ( scratch == NULL ) return STORE_ERROR_NOMEM;
+
+  double * rr = scratch;     /* Regrets */
+  double * rc = rr + m;
+  double * x  = rc + n;      /* Current strategies */
+  double * y  = x + m;
+  double * ur = y + n;       /* Payoffs against them */
+  double * uc = ur + m;
+  double * sr = uc + n;      /* Weighted sums of strategies */
+  double * sc = sr + m;
+
+  /* The last iteration is always checked, so `eq' is filled in */
+  const uint32_t last = max( opts->max_iters, 1 );
+  eq->gap = INFINITY;
+  for ( uint32_t it = 1; it <= last; it++ )
+    {
+      nash_regret_strategy( rc, n, y );
+      nash_row_values( game, y, ur );
+      nash_regret_strategy( rr, m, x );
+      double ev = 0.0;
+      for ( uint32_t r = 0; r < m; r++ ) ev += x[r] * ur[r];
+      for ( uint32_t r = 0; r < m; r++ ) rr[r] = max( rr[r] + ur[r] - ev, 0.0 );
+
+      nash_regret_strategy( rr, m, x );
+      nash_col_values( game, x, uc );
+      ev = 0.0;
+      for ( uint32_t c = 0; c < n; c++ ) ev += y[c] * uc[c];
+      for ( uint32_t c = 0; c < n; c++ ) rc[c] = max( rc[c] + ev - uc[c], 0.0 );
+
+      for ( uint32_t r = 0; r < m; r++ ) sr[r] += it * x[r];
+      for ( uint32_t c = 0; c < n; c++ ) sc[c] += it * y[c];
+      eq->iters = it;
+
+      if ( ( it % NASH_CHECK_EVERY == 0 ) || ( it == last ) )
+        {
+          memcpy( eq->row, sr, sizeof( double ) * m );
+          memcpy( eq->col, sc, sizeof( double ) * n );
+          nash_normalize( eq->row, m );
+          nash_normalize( eq->col, n );
+          nash_measure( game, eq, ur, uc );
+          if ( eq->gap <= opts->tolerance ) break;
+        }
+    }
+
+  free( scratch );
+  return STORE_SUCCESS;
+}
+
+
+/**
+ * Fictitious Play: both sides best respond to the other's history at once.
+ * Running payoff totals make each iteration a row and a column of the game,
+ * and give the gap of the empirical strategies for free.
+ */
+  static int
+nash_fictitious( const nash_game_t * game,
+                 const nash_opts_t * opts,
+                 nash_eq_t         * eq
+               )
+{
+  const uint32_t   m       = game->nrows;
+  const uint32_t   n       = game->ncols;
+  double         * scratch =
+    (double *) calloc( 2 * ( (size_t) m + n ), sizeof( double ) );
+  if ( scratch == NULL ) return STORE_ERROR_NOMEM;
+
+  double   * tr = scratch;   /* Row totals against the column history */
+  double   * tc = tr + m;    /* Column totals against the row history */
+  double   * nr = tc + n;    /* Plays */
+  double   * nc = nr + m;
+  uint32_t   r  = 0;
+  uint32_t   c  = 0;
+
+  for ( uint32_t it = 1; it <= max( opts->max_iters, 1 ); it++ )
+    {
+      nr[r] += 1.0;
+      nc[c] += 1.0;
+      const double * p = game->payoff + (size_t) r * n;
+      for ( uint32_t i = 0; i < m; i++ ) tr[i] += nash_payoff( game, i, c );
+      for ( uint32_t j = 0; j < n; j++ ) tc[j] += p[j];
+      r = nash_argmax( tr, m );
+      c = nash_argmin( tc, n );
+      eq->iters = it;
+      if ( ( tr[r] - tc[c] ) / it <= opts->tolerance ) break;
+    }
+
+  memcpy( eq->row, nr, sizeof( double ) * m );
+  memcpy( eq->col, nc, sizeof( double ) * n );
+  nash_normalize( eq->row, m );
+  nash_normalize( eq->col, n );
+
+  free( scratch );
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+nash_solve( const nash_game_t * game,
+            const nash_opts_t * opts,
+            nash_eq_t         * eq
+          )
+{
+  assert( game != NULL );
+  assert( eq != NULL );
+
+  const nash_opts_t defaults = NASH_OPTS_DEFAULT;
+  if ( opts == NULL ) opts = & defaults;
+
+  * eq = (nash_eq_t) NASH_EQ_INIT;
+  if ( ( game->nrows == 0 ) || ( game->ncols == 0 ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  assert( game->payoff != NULL );
+
+  const uint32_t   m      = game->nrows;
+  const uint32_t   n      = game->ncols;
+  nash_method_t    method = opts->method;
+  int              rsl    = STORE_SUCCESS;
+  double         * rv     = (double *) malloc( sizeof( double ) * m );
+  double         * cv     = (double *) malloc( sizeof( double ) * n );
+
+  eq->row = (double *) malloc( sizeof( double ) * m );
+  eq->col = (double *) malloc( sizeof( double ) * n );
+  if ( ( eq->row == NULL ) || ( eq->col == NULL ) || ( rv == NULL ) ||
+       ( cv == NULL ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+
+  if ( method == NASH_AUTO )
+    {
+      method = ( ( m <= opts->lp_max ) && ( n <= opts->lp_max ) ) ? NASH_LP
+                                                                 : NASH_REGRET;
+    }
+  switch ( method )
+    {
+    case NASH_LP:         rsl = nash_lp( game, eq );                break;
+    case NASH_FICTITIOUS: rsl = nash_fictitious( game, opts, eq );  break;
+    default:              rsl = nash_regret( game, opts, eq );      break;
+    }
+  if ( rsl != STORE_SUCCESS ) goto done;
+  nash_measure( game, eq, rv, cv );
+
+done:
+  free( rv );
+  free( cv );
+  if ( rsl != STORE_SUCCESS ) nash_eq_free( eq );
+  return rsl;
+}
+
+
+  void
+nash_eq_free( nash_eq_t * eq )
+{
+  assert( eq != NULL );
+  free( eq->row );
+  free( eq->col );
+  * eq = (nash_eq_t) NASH_EQ_INIT;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* The likeliest entry, lowest first on ties, or one drawn from `p'. */
+  static uint32_t
+nash_pick( const double * p, uint32_t n, bool sample, uint64_t * state )
+{
+  if ( ! sample ) return nash_argmax( p, n );
+  double u = prng_double( state );
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      if ( u < p[i] ) return i;
+      u -= p[i];
+    }
+  return nash_argmax( p, n );
+}
+
+
+  ai_status_t
+nash_select_team( roster_t      * our_roster,
+                  roster_t      * their_roster,
+                  pvp_pokemon_t * team, /* EXACTLY 3 ELEMENTS */
+                  store_t       * store,
+                  void          * aux
+                )
+{
+  const nash_select_opts_t defaults = NASH_SELECT_OPTS_DEFAULT;
+  const nash_select_opts_t * opts   = ( aux == NULL )
+                                      ? & defaults
+                                      : (nash_select_opts_t *) aux;
+
+  ai_status_t rsl = team_builder_select_team( our_roster, their_roster, team,
+                                              store,
+                                              (void *) & opts->team
+                                            );
+  if ( rsl != AI_SUCCESS ) return rsl;
+  /* `team_builder_select_team' fell back to the first 3 */
+  if ( ( our_roster->roster_length < 3 ) || ( their_roster == NULL ) ||
+       ( their_roster->roster_length == 0 )
+     )
+    {
+      return AI_SUCCESS;
+    }
+
+  const uint8_t        scenario = opts->team.lead_scenario;
+  const matchup_opts_t mopts    = {
+    .scenarios = matchup_scenario_mask( scenario ),
+    .nthreads  = opts->team.nthreads,
+    .cache     = opts->team.cache
+  };
+
+  const size_t     ntheirs = their_roster->roster_length;
+  pvp_pokemon_t  * mons    =
+    (pvp_pokemon_t *) malloc( sizeof( pvp_pokemon_t ) * ntheirs );
+  matchup_matrix_t matrix  = MATCHUP_MATRIX_INIT;
+  nash_game_t      game    = NASH_GAME_INIT;
+  nash_eq_t        eq      = NASH_EQ_INIT;
+  int              srsl    = STORE_SUCCESS;
+
+  if ( mons == NULL ) return AI_ERROR_NOMEM;
+
+  srsl = pvp_pokemon_init_many( mons, their_roster->roster_pokemon, ntheirs,
+                                store
+                              );
+  if ( srsl != STORE_SUCCESS ) goto done;
+  srsl = matchup_matrix_build( & matrix, team, 3, mons, ntheirs, & mopts );
+  if ( srsl != STORE_SUCCESS ) goto done;
+  srsl = nash_game_from_matrix( & game, & matrix, scenario, NULL, 3 );
+  if ( srsl != STORE_SUCCESS ) goto done;
+  srsl = nash_solve( & game, & opts->nash, & eq );
+  if ( srsl != STORE_SUCCESS ) goto done;
+
+  uint64_t seed = opts->seed;
+  uint32_t lead = nash_pick( eq.row, 3, opts->sample, & seed );
+  if ( aux != NULL ) ( (nash_select_opts_t *) aux )->seed = seed;
+
+  pvp_pokemon_t first = team[lead];
+  for ( uint32_t i = lead; 0 < i; i-- ) team[i] = team[i - 1];
+  team[0] = first;
+
+done:
+  if ( srsl == STORE_ERROR_NOMEM )       rsl = AI_ERROR_NOMEM;
+  else if ( srsl != STORE_SUCCESS )      rsl = AI_ERROR_FAIL;
+  nash_eq_free( & eq );
+  nash_game_free( & game );
+  matchup_matrix_free( & matrix );
+  free( mons );
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
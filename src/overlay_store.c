@@ -0,0 +1,373 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "ext/uthash.h"
+#include "moves.h"
+#include "overlay_store.h"
+#include "pokedex.h"
+#include "store.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+overlay_store_init( store_t * overlay_store, void * base )
+{
+  assert( overlay_store != NULL );
+  assert( base != NULL );
+
+  overlay_store->aux = malloc( sizeof( overlay_store_aux_t ) );
+  if ( overlay_store->aux == NULL ) return STORE_ERROR_NOMEM;
+
+  as_ovsa( overlay_store )->base    = (store_t *) base;
+  as_ovsa( overlay_store )->entries = NULL;
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  void
+overlay_store_reset( overlay_store_t * overlay_store )
+{
+  assert( overlay_store != NULL );
+  overlay_entry_t * curr = NULL;
+  overlay_entry_t * tmp  = NULL;
+  HASH_ITER( hh, as_ovsa( overlay_store )->entries, curr, tmp )
+    {
+      HASH_DEL( as_ovsa( overlay_store )->entries, curr );
+      free( curr );
+    }
+  store_touch( overlay_store );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  void
+overlay_store_free( store_t * overlay_store )
+{
+  assert( overlay_store != NULL );
+  if ( overlay_store->aux == NULL ) return;
+  overlay_store_reset( overlay_store );
+  free( overlay_store->aux );
+  overlay_store->aux = NULL;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static overlay_entry_t *
+overlay_find( overlay_store_t * overlay_store, store_key_t key )
+{
+  overlay_entry_t * entry = NULL;
+  uint64_t          okey  = overlay_key( key );
+  HASH_FIND( hh,
+             as_ovsa( overlay_store )->entries,
+             & okey,
+             sizeof( uint64_t ),
+             entry
+           );
+  return entry;
+}
+
+
+/**
+ * Overlay values are returned by pointer like any other store, so they are
+ * updated in place rather than replaced.
+ */
+  static int
+overlay_put( overlay_store_t * overlay_store, store_key_t key, void * val )
+{
+  overlay_entry_t * entry = overlay_find( overlay_store, key );
+
+  if ( entry == NULL )
+    {
+      entry = (overlay_entry_t *) calloc( 1, sizeof( overlay_entry_t ) );
+      if ( entry == NULL ) return STORE_ERROR_NOMEM;
+      entry->key = overlay_key( key );
+      HASH_ADD( hh,
+                as_ovsa( overlay_store )->entries,
+                key,
+                sizeof( uint64_t ),
+                entry
+              );
+    }
+
+  if ( key.val_type == STORE_POKEDEX )
+    {
+      entry->mon = * (pdex_mon_t *) val;
+    }
+  else
+    {
+      entry->move = * (store_move_t *) val;
+    }
+  store_touch( overlay_store );
+
+  return STORE_SUCCESS;
+}
+
+
+  static inline bool
+overlay_key_ok( store_key_t key )
+{
+  return ( key.key_type == STORE_NUM ) &&
+         ( ( key.val_type == STORE_POKEDEX ) ||
+           ( key.val_type == STORE_MOVE )
+         );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+overlay_store_has( store_t * overlay_store, store_key_t key )
+{
+  return STORE_ERROR_NOT_FOUND != overlay_store_get( overlay_store, key, NULL );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+overlay_store_get( store_t * overlay_store, store_key_t key, void ** val )
+{
+  assert( overlay_store != NULL );
+
+  if ( ! overlay_key_ok( key ) ) return STORE_ERROR_BAD_VALUE;
+
+  overlay_entry_t * entry = overlay_find( overlay_store, key );
+  if ( entry != NULL )
+    {
+      if ( val != NULL ) *val = (void *) & entry->mon;
+      return STORE_SUCCESS;
+    }
+
+  store_t * base = as_ovsa( overlay_store )->base;
+  return base->get( base, key, val );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+struct overlay_each_ctx_s {
+  overlay_store_t * overlay_store;
+  store_each_cb     cb;
+  void            * ctx;
+};
+
+
+  static int
+overlay_each_base( void * vctx, store_key_t key, void * val )
+{
+  struct overlay_each_ctx_s * octx  = (struct overlay_each_ctx_s *) vctx;
+  overlay_entry_t           * entry = overlay_find( octx->overlay_store, key );
+  return octx->cb( octx->ctx,
+                   key,
+                   ( entry == NULL ) ? val : (void *) & entry->mon
+                 );
+}
+
+
+/**
+ * Base values are passed through, swapped for the overlay's copy if it has
+ * one, followed by values which were added to the overlay.
+ */
+  int
+overlay_store_each( store_t       * overlay_store,
+                    store_type_t    val_type,
+                    store_each_cb   cb,
+                    void          * ctx
+                  )
+{
+  assert( overlay_store != NULL );
+  assert( cb != NULL );
+
+  store_t                   * base = as_ovsa( overlay_store )->base;
+  struct overlay_each_ctx_s   octx = {
+    .overlay_store = overlay_store,
+    .cb            = cb,
+    .ctx           = ctx
+  };
+  int rsl = store_each( base, val_type, overlay_each_base, & octx );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+
+  overlay_entry_t * curr = NULL;
+  overlay_entry_t * tmp  = NULL;
+  HASH_ITER( hh, as_ovsa( overlay_store )->entries, curr, tmp )
+    {
+      store_key_t key = {
+        .key_type = ( curr->key >> 40 ) & 0xff,
+        .val_type = ( curr->key >> 32 ) & 0xff,
+        .data_f   = (uint32_t) curr->key
+      };
+      if ( ( key.val_type != val_type ) || base->has( base, key ) ) continue;
+      rsl = cb( ctx, key, (void *) & curr->mon );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Names are resolved by the base, and then we check if the overlay has a
+ * replacement for that key.
+ */
+  int
+overlay_store_get_str_t( store_t      *  overlay_store,
+                         store_type_t    val_type,
+                         const char   *  str,
+                         void         ** val
+                       )
+{
+  assert( overlay_store != NULL );
+
+  store_t * base  = as_ovsa( overlay_store )->base;
+  void    * found = NULL;
+  int       rsl   = STORE_ERROR_BAD_VALUE;
+  if ( base->get_str_t == NULL ) return STORE_ERROR_NOT_DEFINED;
+
+  rsl = base->get_str_t( base, val_type, str, & found );
+  if ( rsl != STORE_SUCCESS )
+    {
+      if ( val != NULL ) *val = NULL;
+      return rsl;
+    }
+
+  store_key_t key = ( val_type == STORE_POKEDEX )
+                    ? pdex_store_key( (pdex_mon_t *) found )
+                    : move_store_key( (store_move_t *) found );
+  overlay_entry_t * entry = overlay_find( overlay_store, key );
+  if ( val != NULL ) *val = ( entry == NULL ) ? found : (void *) & entry->mon;
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+overlay_store_get_str( store_t * overlay_store, const char * str, void ** val )
+{
+  assert( overlay_store != NULL );
+
+  if ( overlay_store_get_str_t( overlay_store,
+                                STORE_MOVE,
+                                str,
+                                val
+                              ) == STORE_SUCCESS )
+    {
+      return STORE_SUCCESS;
+    }
+  return overlay_store_get_str_t( overlay_store, STORE_POKEDEX, str, val );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+overlay_store_add( store_t * overlay_store, store_key_t key, void * val )
+{
+  assert( overlay_store != NULL );
+  if ( ! overlay_key_ok( key ) ) return STORE_ERROR_BAD_VALUE;
+  if ( val == NULL )             return STORE_ERROR_BAD_VALUE;
+  if ( overlay_store_has( overlay_store, key ) ) return STORE_ERROR_BAD_VALUE;
+  return overlay_put( overlay_store, key, val );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+overlay_store_set( store_t * overlay_store, store_key_t key, void * val )
+{
+  assert( overlay_store != NULL );
+  if ( ! overlay_key_ok( key ) ) return STORE_ERROR_BAD_VALUE;
+  if ( val == NULL )             return STORE_ERROR_BAD_VALUE;
+  if ( ! overlay_store_has( overlay_store, key ) )
+    {
+      return STORE_ERROR_NOT_FOUND;
+    }
+  return overlay_put( overlay_store, key, val );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static int
+overlay_edit( overlay_store_t *  overlay_store,
+              store_key_t        key,
+              void            ** val
+            )
+{
+  assert( overlay_store != NULL );
+  assert( val != NULL );
+
+  overlay_entry_t * entry = overlay_find( overlay_store, key );
+  void            * found = NULL;
+  int               rsl   = STORE_SUCCESS;
+
+  if ( entry == NULL )
+    {
+      store_t * base = as_ovsa( overlay_store )->base;
+      rsl = base->get( base, key, & found );
+      if ( rsl != STORE_SUCCESS )
+        {
+          *val = NULL;
+          return rsl;
+        }
+      rsl = overlay_put( overlay_store, key, found );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+      entry = overlay_find( overlay_store, key );
+    }
+  /* The caller is about to modify it */
+  store_touch( overlay_store );
+
+  *val = (void *) & entry->mon;
+  return STORE_SUCCESS;
+}
+
+
+  int
+overlay_store_edit_pokemon( overlay_store_t *  overlay_store,
+                            uint16_t           dex_num,
+                            uint8_t            form_idx,
+                            pdex_mon_t      ** mon
+                          )
+{
+  return overlay_edit( overlay_store,
+                       dex_form_store_key( dex_num, form_idx ),
+                       (void **) mon
+                     );
+}
+
+
+  int
+overlay_store_edit_move( overlay_store_t *  overlay_store,
+                         uint16_t           move_id,
+                         store_move_t    ** move
+                       )
+{
+  return overlay_edit( overlay_store,
+                       move_id_store_key( move_id ),
+                       (void **) move
+                     );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
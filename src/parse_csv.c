@@ -0,0 +1,823 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "name_index.h"
+#include "parse_csv.h"
+#include "pokedex.h"
+#include "pokemon.h"
+#include "store.h"
+#include "util/csv.h"
+#include "util/fuzzy.h"
+#include "util/macros.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Names are copied here to NUL terminate them for store lookups */
+#define CSV_NAME_LEN  64
+
+
+/* -------------------------------------------------------------------------- */
+
+/* `get_cpm_for_level' indexes `CPMS' by half levels from 1 */
+  static inline bool
+level_ok( float level )
+{
+  return ( 1.0 <= level ) &&
+         ( level <= ( sizeof( CPMS ) / sizeof( CPMS[0] ) + 1 ) / 2.0 );
+}
+
+
+/* Levels come in half steps: "20", "20.5", or "20.0" */
+  static bool
+csv_parse_level( csv_field_t field, float * out )
+{
+  const char * dot   = memchr( field.str, '.', field.len );
+  csv_field_t  whole = { field.str, ( dot == NULL ) ? field.len
+                                                    : dot - field.str };
+  uint32_t     lv    = 0;
+  float        level = 0.0;
+
+  if ( ! csv_parse_uint( whole, & lv ) ) return false;
+  level = (float) lv;
+
+  if ( dot != NULL )
+    {
+      csv_field_t frac = { dot + 1, field.len - whole.len - 1 };
+      if ( csv_field_eq( frac, "5" ) )           level += 0.5;
+      else if ( ! csv_field_eq( frac, "0" ) )    return false;
+    }
+
+  if ( ! level_ok( level ) ) return false;
+  *out = level;
+  return true;
+}
+
+
+  static bool
+csv_strip_suffix( char * str, size_t * len, const char * suffix )
+{
+  size_t slen = strlen( suffix );
+  if ( ( *len <= slen ) || ( strcmp( str + *len - slen, suffix ) != 0 ) )
+    {
+      return false;
+    }
+  *len -= slen;
+  str[*len] = '\0';
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Find the form of `dex_num' named `form'.
+ * An empty name, or "NORMAL", means the base form if nothing else matches.
+ */
+  static int
+find_form( store_t           *  store,
+           uint16_t             dex_num,
+           const char        *  form,
+           const pdex_mon_t  ** mon
+         )
+{
+  pdex_mon_t * curr = NULL;
+  bool         base = ( *form == '\0' ) || ( strcmp( form, "NORMAL" ) == 0 );
+
+  for ( uint16_t i = 0; i <= UINT8_MAX; i++ )
+    {
+      int rsl = store->get( store,
+                            dex_form_store_key( dex_num, (uint8_t) i ),
+                            (void **) & curr
+                          );
+      if ( rsl != STORE_SUCCESS ) break;
+      if ( ( i == 0 ) && ( *form == '\0' ) ) break;
+      if ( ( curr->form_name != NULL ) &&
+           ( strcmp( curr->form_name, form ) == 0 )
+         )
+        {
+          *mon = curr;
+          return STORE_SUCCESS;
+        }
+    }
+
+  if ( ! base ) return STORE_ERROR_NOT_FOUND;
+  return store->get( store,
+                     dex_form_store_key( dex_num, 0 ),
+                     (void **) mon
+                   );
+}
+
+
+  int
+parse_pokebattler_name( const char        *  str,
+                        size_t               len,
+                        store_t           *  store,
+                        const pdex_mon_t  ** mon
+                      )
+{
+  assert( str != NULL );
+  assert( store != NULL );
+  assert( mon != NULL );
+
+  char         buffer[CSV_NAME_LEN];
+  pdex_mon_t * species = NULL;
+
+  *mon = NULL;
+  if ( store->get_str_t == NULL ) return STORE_ERROR_NOT_DEFINED;
+  if ( ! csv_copy( (csv_field_t) { str, len }, buffer, CSV_NAME_LEN ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  csv_strip_suffix( buffer, & len, "_FORM" );
+  if ( ! csv_strip_suffix( buffer, & len, "_SHADOW" ) )
+    {
+      csv_strip_suffix( buffer, & len, "_PURIFIED" );
+    }
+
+  /* Try the whole name, then each split into "<SPECIES>_<FORM>" */
+  char * split = buffer + len;
+  char * from  = buffer;
+  while ( split != NULL )
+    {
+      char sep = *split;
+      *split = '\0';
+      int rsl = store->get_str_t( store,
+                                  STORE_POKEDEX,
+                                  buffer,
+                                  (void **) & species
+                                );
+      *split = sep;
+
+      if ( ( rsl == STORE_SUCCESS ) &&
+           ( find_form( store,
+                        species->dex_number,
+                        split + ( sep != '\0' ),
+                        mon
+                      ) == STORE_SUCCESS )
+         )
+        {
+          return STORE_SUCCESS;
+        }
+
+      split = memchr( from, '_', buffer + len - from );
+      if ( split != NULL ) from = split + 1;
+    }
+
+  return STORE_ERROR_NOT_FOUND;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Look up a move by name, writing 0 for an empty field if `optional'.
+ * Pokebattler suffixes fast moves with "_FAST", which our stores do not.
+ */
+  static int
+parse_csv_move( csv_field_t   field,
+                store_t     * store,
+                bool          optional,
+                uint16_t    * move_id
+              )
+{
+  char           buffer[CSV_NAME_LEN];
+  size_t         len  = field.len;
+  store_move_t * move = NULL;
+
+  if ( field.len == 0 )
+    {
+      *move_id = 0;
+      return optional ? STORE_SUCCESS : STORE_ERROR_BAD_VALUE;
+    }
+  if ( ! csv_copy( field, buffer, CSV_NAME_LEN ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  csv_strip_suffix( buffer, & len, "_FAST" );
+
+  int rsl = store->get_str_t( store, STORE_MOVE, buffer, (void **) & move );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  *move_id = move->move_id;
+  return STORE_SUCCESS;
+}
+
+
+  int
+parse_csv_pokemon( const char       * line,
+                   size_t             len,
+                   store_t          * store,
+                   roster_pokemon_t * mon,
+                   base_pokemon_t   * base
+                 )
+{
+  assert( line != NULL );
+  assert( store != NULL );
+  assert( mon != NULL );
+  assert( base != NULL );
+
+  csv_field_t fields[PBF_NUM_FIELDS];
+  uint32_t    ivs[3]   = { 0, 0, 0 };
+  uint16_t    moves[3] = { 0, 0, 0 };
+  int         rsl      = STORE_SUCCESS;
+
+  if ( store->get_str_t == NULL ) return STORE_ERROR_NOT_DEFINED;
+
+  /* Older exports lack `cinematicMove2' */
+  size_t nfields = csv_split( line, line + len, ',', fields, PBF_NUM_FIELDS );
+  if ( nfields == PBF_CHARGED2 )
+    {
+      fields[PBF_CHARGED2] = (csv_field_t) { NULL, 0 };
+    }
+  else if ( nfields != PBF_NUM_FIELDS )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  *base = BASE_MON_NULL;
+  rsl = parse_pokebattler_name( fields[PBF_POKEMON].str,
+                                fields[PBF_POKEMON].len,
+                                store,
+                                & base->pdex_mon
+                              );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+
+  if ( ! ( csv_parse_level( fields[PBF_LEVEL], & base->level ) &&
+           csv_parse_uint( fields[PBF_IV_ATK], ivs + 0 ) &&
+           csv_parse_uint( fields[PBF_IV_DEF], ivs + 1 ) &&
+           csv_parse_uint( fields[PBF_IV_STA], ivs + 2 ) &&
+           ( ivs[0] <= 15 ) && ( ivs[1] <= 15 ) && ( ivs[2] <= 15 )
+         ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  base->ivs.attack  = ivs[0];
+  base->ivs.defense = ivs[1];
+  base->ivs.stamina = ivs[2];
+
+  rsl = parse_csv_move( fields[PBF_FAST_MOVE], store, false, moves + 0 );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  rsl = parse_csv_move( fields[PBF_CHARGED1], store, false, moves + 1 );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  rsl = parse_csv_move( fields[PBF_CHARGED2], store, true, moves + 2 );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+
+  mon->base                = base;
+  mon->fast_move_id        = moves[0];
+  mon->charged_move_ids[0] = moves[1];
+  mon->charged_move_ids[1] = moves[2];
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Parse one record per line into `roster' with `parse_line', allocating
+ * everything up front.
+ * `lineno' is the line number of `buffer''s first line, for error messages.
+ */
+typedef int ( * csv_line_fn )( void             * ctx,
+                               const char       * line,
+                               size_t             len,
+                               roster_pokemon_t * mon,
+                               base_pokemon_t   * base
+                             );
+
+  static int
+csv_parse_rows( const char  * buffer,
+                size_t        len,
+                size_t        lineno,
+                roster_t    * roster,
+                csv_line_fn   parse_line,
+                void        * ctx,
+                const char  * caller
+              )
+{
+  if ( roster->roster_bases != NULL ) return STORE_ERROR_BAD_VALUE;
+  if ( len == 0 ) return STORE_SUCCESS;
+
+  /* Count lines once so that everything is allocated up front */
+  const char * end   = buffer + len;
+  size_t       nrows = csv_count_lines( buffer, len );
+
+  base_pokemon_t * bases =
+    (base_pokemon_t *) malloc( sizeof( base_pokemon_t ) * nrows );
+  if ( bases == NULL ) return STORE_ERROR_NOMEM;
+  if ( ! roster_reserve( roster, roster->roster_length + nrows ) )
+    {
+      free( bases );
+      return STORE_ERROR_NOMEM;
+    }
+
+  roster_pokemon_t * rmons = roster->roster_pokemon + roster->roster_length;
+  size_t             cnt   = 0;
+  for ( const char * line = buffer; line < end; lineno++ )
+    {
+      const char * next = csv_next_line( line, end );
+
+      if ( ! csv_line_blank( line, next ) )
+        {
+          int rsl = parse_line( ctx,
+                                line,
+                                next - line,
+                                rmons + cnt,
+                                bases + cnt
+                              );
+          if ( rsl != STORE_SUCCESS )
+            {
+              fprintf( stderr,
+                       "%s: Failed to parse line %zu ( status %d )\n",
+                       caller,
+                       lineno,
+                       rsl
+                     );
+              free( bases );
+              return rsl;
+            }
+          cnt++;
+        }
+
+      line = next;
+    }
+
+  if ( cnt == 0 )
+    {
+      free( bases );
+    }
+  else
+    {
+      roster->roster_bases   = bases;
+      roster->roster_length += cnt;
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+/* Memory map `fpath', which is left as `NULL' for an empty file. */
+  static int
+csv_map_file( const char * fpath, void ** map, size_t * size )
+{
+  struct stat st;
+  int         fd = open( fpath, O_RDONLY );
+
+  *map  = NULL;
+  *size = 0;
+
+  if ( fd == -1 )
+    {
+      perror( __func__ );
+      return STORE_ERROR_FAIL;
+    }
+  if ( fstat( fd, & st ) != 0 )
+    {
+      close( fd );
+      return STORE_ERROR_FAIL;
+    }
+  if ( st.st_size == 0 )
+    {
+      close( fd );
+      return STORE_SUCCESS;
+    }
+
+  *map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if ( *map == MAP_FAILED )
+    {
+      perror( __func__ );
+      *map = NULL;
+      return STORE_ERROR_FAIL;
+    }
+  madvise( *map, st.st_size, MADV_SEQUENTIAL );
+  *size = st.st_size;
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static int
+pokebattler_parse_line( void             * store,
+                        const char       * line,
+                        size_t             len,
+                        roster_pokemon_t * mon,
+                        base_pokemon_t   * base
+                      )
+{
+  return parse_csv_pokemon( line, len, (store_t *) store, mon, base );
+}
+
+
+  int
+parse_csv_roster_buffer( const char * buffer,
+                         size_t       len,
+                         store_t    * store,
+                         roster_t   * roster
+                       )
+{
+  assert( buffer != NULL );
+  assert( store != NULL );
+  assert( roster != NULL );
+
+  size_t lineno = 1;
+  if ( ( 3 <= len ) && ( strncmp( buffer, "id,", 3 ) == 0 ) )
+    {
+      const char * next = csv_next_line( buffer, buffer + len );
+      len    -= next - buffer;
+      buffer  = next;
+      lineno++;
+    }
+
+  return csv_parse_rows( buffer,
+                         len,
+                         lineno,
+                         roster,
+                         pokebattler_parse_line,
+                         store,
+                         __func__
+                       );
+}
+
+
+  int
+parse_csv_roster( const char * fpath, store_t * store, roster_t * roster )
+{
+  assert( fpath != NULL );
+
+  void   * map  = NULL;
+  size_t   size = 0;
+  int      rsl  = csv_map_file( fpath, & map, & size );
+  if ( ( rsl != STORE_SUCCESS ) || ( map == NULL ) ) return rsl;
+
+  rsl = parse_csv_roster_buffer( (const char *) map, size, store, roster );
+  munmap( map, size );
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * CalcyIV's column names vary between versions and languages' number
+ * formats, so columns are found by their normalized header names.
+ * "ØATT IV" normalizes to "ATT_IV" for example.
+ */
+enum calcy_column_e {
+  CC_NR, CC_NAME, CC_FORM, CC_LEVEL, CC_ATK, CC_DEF, CC_STA,
+  CC_FAST, CC_CHARGED1, CC_CHARGED2, CC_NUM_COLUMNS
+};
+
+static const char * CALCY_COLUMN_NAMES[CC_NUM_COLUMNS][3] = {
+  [CC_NR]       = { "NR", "DEX", NULL },
+  [CC_NAME]     = { "NAME", "POKEMON", NULL },
+  [CC_FORM]     = { "FORM", NULL, NULL },
+  [CC_LEVEL]    = { "LEVEL", "LVL", NULL },
+  [CC_ATK]      = { "ATT_IV", "ATK_IV", NULL },
+  [CC_DEF]      = { "DEF_IV", NULL, NULL },
+  [CC_STA]      = { "HP_IV", "STA_IV", NULL },
+  [CC_FAST]     = { "FAST_MOVE", "QUICK_MOVE", NULL },
+  [CC_CHARGED1] = { "SPECIAL_MOVE", "CHARGE_MOVE", NULL },
+  [CC_CHARGED2] = { "SPECIAL_MOVE_2", "CHARGE_MOVE_2", NULL }
+};
+
+/* Rows are sliced into at most this many fields */
+#define CALCY_MAX_FIELDS  128
+
+/* OCR'd names may be this many edits from the real one */
+#define CALCY_MAX_EDITS   3
+
+
+struct calcy_ctx_s {
+  store_t      * store;
+  name_index_t   names;
+  bool           has_names;
+  char           delim;
+  int            columns[CC_NUM_COLUMNS];  /* -1 for missing columns */
+};
+
+
+  static int
+calcy_parse_header( struct calcy_ctx_s * ctx,
+                    const char         * line,
+                    const char         * end
+                  )
+{
+  csv_field_t fields[CALCY_MAX_FIELDS];
+  char        raw[NAME_INDEX_MAX_LEN + 1];
+  char        name[NAME_INDEX_MAX_LEN + 1];
+
+  /* Some locales export with ';' rather than ',' */
+  const char * eol    = csv_next_line( line, end );
+  const char * comma  = memchr( line, ',', eol - line );
+  const char * semi   = memchr( line, ';', eol - line );
+  ctx->delim = ( ( semi != NULL ) && ( comma == NULL ) ) ? ';' : ',';
+
+  size_t n = min( csv_split( line, end, ctx->delim, fields, CALCY_MAX_FIELDS ),
+                  CALCY_MAX_FIELDS
+                );
+
+  for ( int c = 0; c < CC_NUM_COLUMNS; c++ ) ctx->columns[c] = -1;
+  for ( size_t i = 0; i < n; i++ )
+    {
+      if ( ! csv_copy( fields[i], raw, sizeof( raw ) ) ) continue;
+      name_index_normalize( raw, name );
+      for ( int c = 0; c < CC_NUM_COLUMNS; c++ )
+        {
+          for ( int a = 0; ( a < 3 ) && ( CALCY_COLUMN_NAMES[c][a] != NULL );
+                a++ )
+            {
+              if ( ( ctx->columns[c] == -1 ) &&
+                   ( strcmp( name, CALCY_COLUMN_NAMES[c][a] ) == 0 )
+                 )
+                {
+                  ctx->columns[c] = (int) i;
+                }
+            }
+        }
+    }
+
+  if ( ( ( ctx->columns[CC_NR] == -1 ) && ( ctx->columns[CC_NAME] == -1 ) ) ||
+       ( ctx->columns[CC_LEVEL] == -1 ) || ( ctx->columns[CC_ATK] == -1 ) ||
+       ( ctx->columns[CC_DEF] == -1 ) || ( ctx->columns[CC_STA] == -1 ) ||
+       ( ctx->columns[CC_FAST] == -1 ) || ( ctx->columns[CC_CHARGED1] == -1 )
+     )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+/* Look up `field' exactly, falling back to a fuzzy match for OCR typos. */
+  static int
+calcy_lookup( struct calcy_ctx_s *  ctx,
+              store_type_t          val_type,
+              csv_field_t           field,
+              void               ** val
+            )
+{
+  char raw[NAME_INDEX_MAX_LEN + 1];
+  char name[NAME_INDEX_MAX_LEN + 1];
+
+  if ( ! csv_copy( field, raw, sizeof( raw ) ) ) return STORE_ERROR_BAD_VALUE;
+  name_index_normalize( raw, name );
+  if ( ctx->store->get_str_t( ctx->store, val_type, name, val ) ==
+       STORE_SUCCESS
+     )
+    {
+      return STORE_SUCCESS;
+    }
+
+  /* Only build the index once somebody actually needs it */
+  if ( ! ctx->has_names )
+    {
+      int rsl = name_index_init( & ctx->names, ctx->store );
+      if ( rsl != STORE_SUCCESS ) return STORE_ERROR_NOT_FOUND;
+      ctx->has_names = true;
+    }
+  return name_index_lookup( & ctx->names,
+                            val_type,
+                            name,
+                            CALCY_MAX_EDITS,
+                            val,
+                            NULL
+                          );
+}
+
+
+/**
+ * Match a CalcyIV form like "Alolan" against the store's forms, allowing a
+ * couple of edits since CalcyIV's names don't always match the game master.
+ */
+  static int
+calcy_find_form( store_t           *  store,
+                 uint16_t             dex_num,
+                 csv_field_t          field,
+                 const pdex_mon_t  ** mon
+               )
+{
+  char         raw[NAME_INDEX_MAX_LEN + 1];
+  char         form[NAME_INDEX_MAX_LEN + 1];
+  pdex_mon_t * curr = NULL;
+  int          best = 3;
+
+  if ( ! csv_copy( field, raw, sizeof( raw ) ) ) return STORE_ERROR_BAD_VALUE;
+  size_t len = name_index_normalize( raw, form );
+
+  int rsl = find_form( store, dex_num, form, mon );
+  if ( rsl == STORE_SUCCESS ) return rsl;
+
+  for ( uint16_t i = 0; i <= UINT8_MAX; i++ )
+    {
+      if ( store->get( store,
+                       dex_form_store_key( dex_num, (uint8_t) i ),
+                       (void **) & curr
+                     ) != STORE_SUCCESS ) break;
+      if ( curr->form_name == NULL ) continue;
+      int d = levenshtein_bounded( form,
+                                   len,
+                                   curr->form_name,
+                                   strlen( curr->form_name ),
+                                   best - 1
+                                 );
+      if ( d < best )
+        {
+          best = d;
+          *mon = curr;
+        }
+    }
+
+  /* Unknown forms such as costumes fall back to the base form */
+  if ( best < 3 ) return STORE_SUCCESS;
+  return store->get( store, dex_form_store_key( dex_num, 0 ), (void **) mon );
+}
+
+
+  static int
+calcy_parse_line( void             * vctx,
+                  const char       * line,
+                  size_t             len,
+                  roster_pokemon_t * mon,
+                  base_pokemon_t   * base
+                )
+{
+  struct calcy_ctx_s * ctx = (struct calcy_ctx_s *) vctx;
+  csv_field_t          fields[CALCY_MAX_FIELDS];
+  csv_field_t          col[CC_NUM_COLUMNS];
+  float                vals[4]  = { 0.0, 0.0, 0.0, 0.0 };
+  store_move_t       * moves[3] = { NULL, NULL, NULL };
+  pdex_mon_t         * species  = NULL;
+  uint32_t             dex      = 0;
+  int                  rsl      = STORE_SUCCESS;
+
+  size_t n = min( csv_split( line,
+                             line + len,
+                             ctx->delim,
+                             fields,
+                             CALCY_MAX_FIELDS
+                           ),
+                  CALCY_MAX_FIELDS
+                );
+  for ( int c = 0; c < CC_NUM_COLUMNS; c++ )
+    {
+      col[c] = ( ( 0 <= ctx->columns[c] ) && ( ctx->columns[c] < (int) n ) )
+               ? fields[ctx->columns[c]]
+               : (csv_field_t) { line, 0 };
+    }
+
+  /* Species by Dex #, or by name if the export lacks it */
+  if ( csv_parse_uint( col[CC_NR], & dex ) && ( 0 < dex ) )
+    {
+      rsl = ctx->store->get( ctx->store,
+                             dex_form_store_key( dex, 0 ),
+                             (void **) & species
+                           );
+    }
+  else
+    {
+      rsl = calcy_lookup( ctx,
+                          STORE_POKEDEX,
+                          col[CC_NAME],
+                          (void **) & species
+                        );
+    }
+  if ( rsl != STORE_SUCCESS ) return rsl;
+
+  *base = BASE_MON_NULL;
+  base->pdex_mon = species;
+  if ( col[CC_FORM].len != 0 )
+    {
+      rsl = calcy_find_form( ctx->store,
+                             species->dex_number,
+                             col[CC_FORM],
+                             & base->pdex_mon
+                           );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+    }
+
+  /* IVs are averages when CalcyIV isn't sure, so take the nearest */
+  if ( ! ( csv_parse_float( col[CC_LEVEL], vals + 0 ) &&
+           csv_parse_float( col[CC_ATK], vals + 1 ) &&
+           csv_parse_float( col[CC_DEF], vals + 2 ) &&
+           csv_parse_float( col[CC_STA], vals + 3 )
+         ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  base->level = roundf( vals[0] * 2 ) / 2;
+  if ( ! level_ok( base->level ) ) return STORE_ERROR_BAD_VALUE;
+  for ( int i = 1; i < 4; i++ )
+    {
+      vals[i] = roundf( vals[i] );
+      if ( ( vals[i] < 0 ) || ( 15 < vals[i] ) ) return STORE_ERROR_BAD_VALUE;
+    }
+  base->ivs.attack  = (uint16_t) vals[1];
+  base->ivs.defense = (uint16_t) vals[2];
+  base->ivs.stamina = (uint16_t) vals[3];
+
+  for ( int i = 0; i < 3; i++ )
+    {
+      csv_field_t field = col[CC_FAST + i];
+      if ( field.len == 0 )
+        {
+          if ( i < 2 ) return STORE_ERROR_BAD_VALUE;
+          continue;
+        }
+      rsl = calcy_lookup( ctx, STORE_MOVE, field, (void **) & moves[i] );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+    }
+
+  mon->base                = base;
+  mon->fast_move_id        = moves[0]->move_id;
+  mon->charged_move_ids[0] = moves[1]->move_id;
+  mon->charged_move_ids[1] = ( moves[2] == NULL ) ? 0 : moves[2]->move_id;
+
+  return STORE_SUCCESS;
+}
+
+
+  int
+parse_calcy_roster_buffer( const char * buffer,
+                           size_t       len,
+                           store_t    * store,
+                           roster_t   * roster
+                         )
+{
+  assert( buffer != NULL );
+  assert( store != NULL );
+  assert( roster != NULL );
+
+  struct calcy_ctx_s ctx = { .store = store, .has_names = false };
+  const char       * end = buffer + len;
+  size_t             lineno = 1;
+  int                rsl    = STORE_SUCCESS;
+
+  if ( store->get_str_t == NULL ) return STORE_ERROR_NOT_DEFINED;
+
+  /* The header is required, since it's the only way to find columns */
+  while ( ( buffer < end ) && csv_line_blank( buffer, end ) )
+    {
+      buffer = csv_next_line( buffer, end );
+      lineno++;
+    }
+  if ( buffer == end ) return STORE_SUCCESS;
+  rsl = calcy_parse_header( & ctx, buffer, end );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  buffer = csv_next_line( buffer, end );
+
+  rsl = csv_parse_rows( buffer,
+                        end - buffer,
+                        lineno + 1,
+                        roster,
+                        calcy_parse_line,
+                        & ctx,
+                        __func__
+                      );
+  if ( ctx.has_names ) name_index_free( & ctx.names );
+
+  return rsl;
+}
+
+
+  int
+parse_calcy_roster( const char * fpath, store_t * store, roster_t * roster )
+{
+  assert( fpath != NULL );
+
+  void   * map  = NULL;
+  size_t   size = 0;
+  int      rsl  = csv_map_file( fpath, & map, & size );
+  if ( ( rsl != STORE_SUCCESS ) || ( map == NULL ) ) return rsl;
+
+  rsl = parse_calcy_roster_buffer( (const char *) map, size, store, roster );
+  munmap( map, size );
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -10,11 +10,13 @@
 #include "ext/jsmn_iterator.h"
 #include "util/bits.h"
 #include "util/json_util.h"
+#include "util/arena.h"
 #include "util/jsmn_iterator_stack.h"
+#include "util/strmap.h"
+#include "util/strpool.h"
 #include "pokedex.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include "ext/uthash.h"
 #include <pcre.h>
 
 
@@ -72,6 +74,92 @@ gm_regexes_free( gm_regexes_t * grs )
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+  void
+gm_tables_init( gm_tables_t * tables )
+{
+  assert( tables != NULL );
+  arena_init( & tables->records );
+  strpool_init( & tables->names );
+  tables->move_ids     = NULL;
+  tables->move_ids_cnt = 0;
+  tables->move_ids_cap = 0;
+  tables->mons_by_dex  = NULL;
+  tables->mons_len     = 0;
+  tables->mons_cnt     = 0;
+  tables->moves_by_id  = NULL;
+  tables->moves_len    = 0;
+  tables->moves_cnt    = 0;
+  strmap_init( & tables->mons_by_name );
+  strmap_init( & tables->moves_by_name );
+}
+
+
+  void
+gm_tables_free( gm_tables_t * tables )
+{
+  assert( tables != NULL );
+  /* Records aren't walked, they all go with the arena */
+  arena_free( & tables->records );
+  free( tables->mons_by_dex );
+  free( tables->moves_by_id );
+  free( tables->move_ids );
+  strmap_free( & tables->mons_by_name );
+  strmap_free( & tables->moves_by_name );
+  strpool_free( & tables->names );
+  gm_tables_init( tables );
+}
+
+
+/**
+ * Grow a table of pointers indexed by Dex # or move ID so that `id' fits,
+ * clearing the new entries.
+ */
+  static void **
+gm_tables_fit( void ** table, uint16_t * len, uint16_t id )
+{
+  if ( id < *len ) return table;
+  uint32_t new_len = max( (uint32_t) id + 1, (uint32_t) *len * 2 );
+  if ( UINT16_MAX < new_len ) new_len = UINT16_MAX;
+  assert( id < new_len );
+  void ** grown = (void **) realloc( table, sizeof( void * ) * new_len );
+  assert( grown != NULL );
+  memset( grown + *len, 0, sizeof( void * ) * ( new_len - *len ) );
+  *len = (uint16_t) new_len;
+  return grown;
+}
+
+
+/* Append `cnt' move IDs to the pool, returning where they start. */
+  static uint32_t
+gm_tables_push_move_ids( gm_tables_t   * tables,
+                         const int16_t * ids,
+                         uint32_t        cnt
+                       )
+{
+  uint32_t offset = tables->move_ids_cnt;
+  if ( tables->move_ids_cap < offset + cnt )
+    {
+      uint32_t cap = ( tables->move_ids_cap == 0 ) ? 4096
+                                                   : tables->move_ids_cap;
+      while ( cap < offset + cnt ) cap *= 2;
+      int16_t * grown = (int16_t *) realloc( tables->move_ids,
+                                             sizeof( int16_t ) * cap
+                                           );
+      assert( grown != NULL );
+      tables->move_ids     = grown;
+      tables->move_ids_cap = cap;
+    }
+  if ( 0 < cnt )
+    {
+      memcpy( tables->move_ids + offset, ids, sizeof( int16_t ) * cnt );
+    }
+  tables->move_ids_cnt += cnt;
+  return offset;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   void
@@ -92,31 +180,19 @@ gm_parser_release( gm_parser_t * gm_parser )
   gm_parser->incomplete_fam  = NULL;
   gm_parser->incomplete_idx  = 0;
   gm_parser->incomplete_size = 0;
+  free( gm_parser->spans );
+  gm_parser->spans     = NULL;
+  gm_parser->spans_cnt = 0;
+  gm_parser->spans_cap = 0;
 }
 
+/* Tables handed over to `gm_store' have already been reset, see
+ * `gm_store_init'. */
   void
 gm_parser_free( gm_parser_t * gm_parser )
 {
   gm_parser_release( gm_parser );
-  /* Free the moves table */
-  store_move_t * curr_move = NULL;
-  store_move_t * tmp_move  = NULL;
-  HASH_ITER( hh_name, gm_parser->moves_by_name, curr_move, tmp_move )
-    {
-      HASH_DELETE( hh_name, gm_parser->moves_by_name, curr_move );
-      HASH_DELETE( hh_move_id, gm_parser->moves_by_id, curr_move );
-      free( curr_move->name );
-      free( curr_move );
-    }
-  /* Free Pokedex */
-  pdex_mon_t * curr_mon = NULL;
-  pdex_mon_t * tmp_mon  = NULL;
-  HASH_ITER( hh_name, gm_parser->mons_by_name, curr_mon, tmp_mon )
-    {
-      HASH_DELETE( hh_name, gm_parser->mons_by_name, curr_mon );
-      HASH_DELETE( hh_dex_num, gm_parser->mons_by_dex, curr_mon );
-      pdex_mon_free( curr_mon );
-    }
+  gm_tables_free( & gm_parser->tables );
 }
 
   static int
@@ -158,6 +234,12 @@ gm_parser_init( gm_parser_t * gm_parser, const char * gm_fpath )
   long   read_tokens = 0;
   int    jsmn_rsl    = 0;
 
+  /* Initialize tables */
+  gm_tables_init( & gm_parser->tables );
+  gm_parser->spans     = NULL;
+  gm_parser->spans_cnt = 0;
+  gm_parser->spans_cap = 0;
+
   gm_parser->fparser =
     (jsmn_file_parser_t *) malloc( sizeof( jsmn_file_parser_t ) );
   if ( gm_parser->fparser == NULL ) return 0;
@@ -189,12 +271,6 @@ gm_parser_init( gm_parser_t * gm_parser, const char * gm_fpath )
       return 0;
     }
 
-  /* Initialize tables */
-  gm_parser->moves_by_name = NULL;
-  gm_parser->moves_by_id   = NULL;
-  gm_parser->mons_by_name  = NULL;
-  gm_parser->mons_by_dex   = NULL;
-
   gm_parser->buffer     = gm_parser->fparser->buffer;
   gm_parser->buffer_len = read_chars;
   gm_parser->tokens     = gm_parser->fparser->tokens;
@@ -363,14 +439,14 @@ parse_gm_buff( const char * json, jsmni_t * iter )
   uint16_t
 parse_pdex_mon( const char   *  json,
                 jsmnis_t     *  iter_stack,
-                store_move_t *  moves_by_name,
-                pdex_mon_t   *  mons_by_name,
+                gm_tables_t  *  tables,
                 jsmntok_t    ** incomplete_fam_tok,
                 pdex_mon_t   *  mon
               )
 {
   assert( json != NULL );
   assert( iter_stack != NULL );
+  assert( tables != NULL );
   assert( mon != NULL );
 
   const unsigned short stack_idx = iter_stack->stack_index;
@@ -378,6 +454,9 @@ parse_pdex_mon( const char   *  json,
   jsmntok_t *          val       = NULL;
   int                  idx       = jsmnis_pos( iter_stack );
   int                  rsl       = 0;
+  /* Elite moves come in separate lists, so gather before pooling */
+  int16_t              fast_ids[UINT8_MAX];
+  int16_t              charged_ids[UINT8_MAX];
 
   /* `templateId' value should already be targeted by `iter_stack' */
   assert( 0 < idx );
@@ -408,7 +487,10 @@ parse_pdex_mon( const char   *  json,
     {
       if ( jsoneq_str( json, key, "uniqueId" ) )
         {
-          mon->name = strndup( json + val->start, toklen( val ) );
+          mon->name = strpool_internn( & tables->names,
+                                       json + val->start,
+                                       toklen( val )
+                                     );
           assert( mon->name != NULL );
         }
       else if ( jsoneq_str( json, key, "type1" ) ||
@@ -428,31 +510,18 @@ parse_pdex_mon( const char   *  json,
               )
         {
           idx = mon->fast_moves_cnt;
+          assert( mon->fast_moves_cnt + val->size <= UINT8_MAX );
           mon->fast_moves_cnt += val->size;
-          if ( mon->fast_move_ids == NULL )
-            {
-              mon->fast_move_ids  = malloc( sizeof( uint16_t ) *
-                                              mon->fast_moves_cnt
-                                          );
-            }
-          else
-            {
-              mon->fast_move_ids  = realloc( mon->fast_move_ids,
-                                             sizeof( uint16_t ) *
-                                               mon->fast_moves_cnt
-                                           );
-            }
-          assert( mon->fast_move_ids != NULL );
           rsl = json[key->start] == 'e' ? -1 : 1;
           jsmnis_push_curr( iter_stack );
           while ( jsmni_next( jsmnis_curr( iter_stack ), NULL, &val, 0 ) > 0 )
             {
-              mon->fast_move_ids[idx++] = lookup_move_idn( moves_by_name,
-                                                           json + val->start,
-                                                           toklen( val ) - 5
-                                                         ) * rsl;
+              fast_ids[idx++] = lookup_move_idn( & tables->moves_by_name,
+                                                 json + val->start,
+                                                 toklen( val ) - 5
+                                               ) * rsl;
               /* Gen 6 has missing fast moves */
-              /* assert( 0 != mon->fast_move_ids[idx - 1] ); */
+              /* assert( 0 != fast_ids[idx - 1] ); */
             }
           jsmnis_pop( iter_stack );
           assert( idx == mon->fast_moves_cnt );
@@ -462,30 +531,17 @@ parse_pdex_mon( const char   *  json,
               )
         {
           idx = mon->charged_moves_cnt;
+          assert( mon->charged_moves_cnt + val->size <= UINT8_MAX );
           mon->charged_moves_cnt += val->size;
-          if ( mon->charged_move_ids == NULL )
-            {
-              mon->charged_move_ids  = malloc( sizeof( uint16_t ) *
-                                                 mon->charged_moves_cnt
-                                             );
-            }
-          else
-            {
-              mon->charged_move_ids  = realloc( mon->charged_move_ids,
-                                                sizeof( uint16_t ) *
-                                                  mon->charged_moves_cnt
-                                              );
-            }
-          assert( mon->charged_move_ids != NULL );
           rsl = json[key->start] == 'e' ? -1 : 1;
           jsmnis_push_curr( iter_stack );
           while ( jsmni_next( jsmnis_curr( iter_stack ), NULL, &val, 0 ) > 0 )
             {
-              mon->charged_move_ids[idx++] = lookup_move_idn( moves_by_name,
-                                                              json + val->start,
-                                                              toklen( val )
-                                                            ) * rsl;
-              assert( 0 != mon->charged_move_ids[idx - 1] );
+              charged_ids[idx++] = lookup_move_idn( & tables->moves_by_name,
+                                                    json + val->start,
+                                                    toklen( val )
+                                                  ) * rsl;
+              assert( 0 != charged_ids[idx - 1] );
             }
           jsmnis_pop( iter_stack );
           assert( idx == mon->charged_moves_cnt );
@@ -494,17 +550,19 @@ parse_pdex_mon( const char   *  json,
         {
           if ( strncmp( mon->name, "NIDORAN_", 8 ) != 0 )
             {
-              mon->form_name = strndup( json + val->start +
-                                          strlen( mon->name ) + 1,
-                                        toklen( val ) - strlen( mon->name ) - 1
-                                      );
+              mon->form_name =
+                strpool_internn( & tables->names,
+                                 json + val->start + strlen( mon->name ) + 1,
+                                 toklen( val ) - strlen( mon->name ) - 1
+                               );
 
             }
           else
             {
-              mon->form_name = strndup( json + val->start + 8,
-                                        toklen( val ) - 8
-                                      );
+              mon->form_name = strpool_internn( & tables->names,
+                                                json + val->start + 8,
+                                                toklen( val ) - 8
+                                              );
 
             }
           assert( mon->form_name != NULL );
@@ -522,7 +580,7 @@ parse_pdex_mon( const char   *  json,
             }
           else
             {
-              mon->family = lookup_dexn( mons_by_name,
+              mon->family = lookup_dexn( & tables->mons_by_name,
                                          json + val->start + 7,
                                          toklen( val ) - 7
                                        );
@@ -554,10 +612,13 @@ parse_pdex_mon( const char   *  json,
 
   if ( mon->form_name == NULL )
     {
-      mon->form_name = strdup( "BASE" );
+      mon->form_name = strpool_intern( & tables->names, "BASE" );
       assert( mon->form_name != NULL );
     }
 
+  gm_tables_push_move_ids( tables, fast_ids, mon->fast_moves_cnt );
+  gm_tables_push_move_ids( tables, charged_ids, mon->charged_moves_cnt );
+
   assert( mon->name != NULL );
   assert( iter_stack->stack_index == stack_idx );
   assert( mon->types != PT_NONE_M );
@@ -571,11 +632,90 @@ parse_pdex_mon( const char   *  json,
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+/* Forget the most recently parsed Pokemon. */
+  static void
+gm_parser_drop_mon( gm_parser_t * gm_parser, pdex_mon_t * mon )
+{
+  uint32_t cnt = mon->fast_moves_cnt + mon->charged_moves_cnt;
+  assert( cnt <= gm_parser->tables.move_ids_cnt );
+  gm_parser->tables.move_ids_cnt -= cnt;
+  /* Nothing else is carved from the arena while a Pokemon is parsed */
+  bool popped = arena_pop( & gm_parser->tables.records, mon );
+  assert( popped );
+  (void) popped;
+}
+
+
+/* Remember where a kept Pokemon's move lists are, see `gm_parser_link'. */
+  static void
+gm_parser_keep_mon( gm_parser_t * gm_parser, pdex_mon_t * mon )
+{
+  if ( gm_parser->spans_cnt == gm_parser->spans_cap )
+    {
+      uint32_t cap = ( gm_parser->spans_cap == 0 ) ? 1024
+                                                   : gm_parser->spans_cap * 2;
+      gm_move_span_t * spans =
+        (gm_move_span_t *) realloc( gm_parser->spans,
+                                    sizeof( gm_move_span_t ) * cap
+                                  );
+      assert( spans != NULL );
+      gm_parser->spans     = spans;
+      gm_parser->spans_cap = cap;
+    }
+  gm_parser->spans[gm_parser->spans_cnt++] = (gm_move_span_t) {
+    .mon    = mon,
+    .offset = gm_parser->tables.move_ids_cnt -
+              mon->fast_moves_cnt - mon->charged_moves_cnt
+  };
+}
+
+
+/**
+ * Point every Pokemon at its move lists, once the pool is done growing.
+ * The pool is trimmed first, since it never grows again.
+ */
+  static void
+gm_parser_link( gm_parser_t * gm_parser )
+{
+  gm_tables_t * tables = & gm_parser->tables;
+  if ( ( 0 < tables->move_ids_cnt ) &&
+       ( tables->move_ids_cnt < tables->move_ids_cap ) )
+    {
+      int16_t * trimmed = (int16_t *) realloc( tables->move_ids,
+                                               sizeof( int16_t ) *
+                                                 tables->move_ids_cnt
+                                             );
+      if ( trimmed != NULL )
+        {
+          tables->move_ids     = trimmed;
+          tables->move_ids_cap = tables->move_ids_cnt;
+        }
+    }
+
+  for ( uint32_t i = 0; i < gm_parser->spans_cnt; i++ )
+    {
+      pdex_mon_t * mon  = gm_parser->spans[i].mon;
+      int16_t    * list = tables->move_ids + gm_parser->spans[i].offset;
+      mon->fast_move_ids    = ( 0 < mon->fast_moves_cnt ) ? list : NULL;
+      mon->charged_move_ids = ( 0 < mon->charged_moves_cnt )
+                              ? list + mon->fast_moves_cnt
+                              : NULL;
+    }
+
+  free( gm_parser->spans );
+  gm_parser->spans     = NULL;
+  gm_parser->spans_cnt = 0;
+  gm_parser->spans_cap = 0;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
 /**
- * Pokedex data is stored as a hash table indexed by Dex Numbers/Names,
- * holding a linked list of "forms".
+ * Pokedex data is stored as a table indexed by Dex Numbers, and a map by
+ * Names, holding a linked list of "forms".
  * <p>
  * Unlike the data store, the parser's simpler table cannot directly jump to a
  * specific form. This is fine, because the GM Parser is not meant to be used
@@ -591,6 +731,9 @@ parse_pdex_mon( const char   *  json,
  * Similarly Unown and Spinda have a ton of identical forms that are skipped.
  * Other pokemon likely have redundant forms, but for the sake of simplicity we
  * parse them anyways, and "merge" them later when building the data store.
+ * <p>
+ * `mon' must be the last one parsed, since its move lists are still at the
+ * end of the pool; dropped forms take their lists back off of it.
  */
   bool
 add_mon_data( gm_parser_t * gm_parser, pdex_mon_t * mon )
@@ -598,30 +741,24 @@ add_mon_data( gm_parser_t * gm_parser, pdex_mon_t * mon )
   assert( gm_parser != NULL );
   assert( mon != NULL );
 
-  pdex_mon_t * stored = NULL;
-  HASH_FIND( hh_dex_num,
-             gm_parser->mons_by_dex,
-             & mon->dex_number,
-             sizeof( uint16_t ),
-             stored
-           );
+  gm_tables_t * tables = & gm_parser->tables;
+  pdex_mon_t  * stored = ( mon->dex_number < tables->mons_len )
+                         ? tables->mons_by_dex[mon->dex_number]
+                         : NULL;
 
   /* Add new pdex_mon_t if none exists yet */
   if ( stored == NULL )
     {
       mon->form_idx = 0;
-      HASH_ADD_KEYPTR( hh_name,
-                       gm_parser->mons_by_name,
-                       mon->name,
-                       strlen( mon->name ),
-                       mon
-                     );
-      HASH_ADD( hh_dex_num,
-                gm_parser->mons_by_dex,
-                dex_number,
-                sizeof( uint16_t ),
-                mon
-              );
+      tables->mons_by_dex =
+        (pdex_mon_t **) gm_tables_fit( (void **) tables->mons_by_dex,
+                                       & tables->mons_len,
+                                       mon->dex_number
+                                     );
+      tables->mons_by_dex[mon->dex_number] = mon;
+      tables->mons_cnt++;
+      strmap_put( & tables->mons_by_name, mon->name, mon );
+      gm_parser_keep_mon( gm_parser, mon );
     }
   else
     {
@@ -635,7 +772,7 @@ add_mon_data( gm_parser_t * gm_parser, pdex_mon_t * mon )
          )
         {
           stored->tags |= TAG_SHADOW_ELIGABLE_M;
-          pdex_mon_free( mon );
+          gm_parser_drop_mon( gm_parser, mon );
           return true; /* This was freed so we cannot return `false' */
         }
 
@@ -644,7 +781,7 @@ add_mon_data( gm_parser_t * gm_parser, pdex_mon_t * mon )
       if ( strcmp( stored->form_name, mon->form_name ) == 0 )
         {
           stored->family = mon->family;
-          pdex_mon_free( mon );
+          gm_parser_drop_mon( gm_parser, mon );
           return true; /* This was freed so we cannot return `false' */
         }
 
@@ -655,12 +792,13 @@ add_mon_data( gm_parser_t * gm_parser, pdex_mon_t * mon )
           if ( strcmp( stored->form_name, mon->form_name ) == 0 )
             {
               stored->family = mon->family;
-              pdex_mon_free( mon );
+              gm_parser_drop_mon( gm_parser, mon );
               return true; /* This was freed so we cannot return `false' */
             }
         }
       stored->next_form = mon;
       mon->form_idx = stored->form_idx + 1;
+      gm_parser_keep_mon( gm_parser, mon );
     }
 
   return ( 0 < mon->family );
@@ -825,6 +963,46 @@ parse_pvp_fast_move( const char      *  json,
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+  static store_move_t *
+gm_parser_find_move( gm_parser_t * gm_parser, uint16_t move_id )
+{
+  return ( move_id < gm_parser->tables.moves_len )
+         ? gm_parser->tables.moves_by_id[move_id]
+         : NULL;
+}
+
+
+/* A blank move with a pooled copy of `name', indexed by ID and name. */
+  static store_move_t *
+gm_parser_new_move( gm_parser_t * gm_parser,
+                    const char  * name,
+                    uint16_t      move_id
+                  )
+{
+  gm_tables_t  * tables = & gm_parser->tables;
+  store_move_t * move   =
+    (store_move_t *) arena_calloc( & tables->records, sizeof( store_move_t ) );
+  assert( move != NULL );
+
+  move->name    = strpool_intern( & tables->names, name );
+  move->move_id = move_id;
+  assert( move->name != NULL );
+
+  tables->moves_by_id =
+    (store_move_t **) gm_tables_fit( (void **) tables->moves_by_id,
+                                     & tables->moves_len,
+                                     move_id
+                                   );
+  tables->moves_by_id[move_id] = move;
+  tables->moves_cnt++;
+  strmap_put( & tables->moves_by_name, move->name, move );
+
+  return move;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   void
@@ -837,38 +1015,14 @@ add_pvp_charged_move_data( gm_parser_t        *  gm_parser,
   assert( move != NULL );
   assert( move_name != NULL );
 
-  store_move_t * stored = NULL;
-  HASH_FIND( hh_move_id,
-             gm_parser->moves_by_id,
-             & move->move_id,
-             sizeof( uint16_t ),
-             stored
-           );
+  store_move_t * stored = gm_parser_find_move( gm_parser, move->move_id );
 
   /* Add new store_move if none exists yet */
   if ( stored == NULL )
     {
-      stored = (store_move_t *) malloc( sizeof( store_move_t ) );
-      memset( stored, 0, sizeof( store_move_t ) );
-      assert( stored != NULL );
-
-      stored->name    = move_name;
-      stored->move_id = move->move_id;
+      stored = gm_parser_new_move( gm_parser, move_name, move->move_id );
       stored->type    = move->type;
       stored->is_fast = false;
-
-      HASH_ADD_KEYPTR( hh_name,
-                       gm_parser->moves_by_name,
-                       move_name,
-                       strlen( move_name ),
-                       stored
-                     );
-      HASH_ADD( hh_move_id,
-                gm_parser->moves_by_id,
-                move_id,
-                sizeof( uint16_t ),
-                stored
-              );
     }
 
   stored->pvp_power  = move->power;
@@ -889,38 +1043,14 @@ add_pvp_fast_move_data( gm_parser_t     *  gm_parser,
   assert( move != NULL );
   assert( move_name != NULL );
 
-  store_move_t * stored = NULL;
-  HASH_FIND( hh_move_id,
-             gm_parser->moves_by_id,
-             & move->move_id,
-             sizeof( uint16_t ),
-             stored
-           );
+  store_move_t * stored = gm_parser_find_move( gm_parser, move->move_id );
 
   /* Add new store_move if none exists yet */
   if ( stored == NULL )
     {
-      stored = (store_move_t *) malloc( sizeof( store_move_t ) );
-      memset( stored, 0, sizeof( store_move_t ) );
-      assert( stored != NULL );
-
-      stored->name = move_name;
-      stored->move_id = move->move_id;
+      stored = gm_parser_new_move( gm_parser, move_name, move->move_id );
       stored->type    = move->type;
       stored->is_fast = true;
-
-      HASH_ADD_KEYPTR( hh_name,
-                       gm_parser->moves_by_name,
-                       move_name,
-                       strlen( move_name ),
-                       stored
-                     );
-      HASH_ADD( hh_move_id,
-                gm_parser->moves_by_id,
-                move_id,
-                sizeof( uint16_t ),
-                stored
-              );
     }
 
   stored->pvp_power  = move->power;
@@ -933,27 +1063,25 @@ add_pvp_fast_move_data( gm_parser_t     *  gm_parser,
 /* -------------------------------------------------------------------------- */
 
   uint16_t
-lookup_move_id( store_move_t * moves, const char * name )
+lookup_move_id( const strmap_t * moves_by_name, const char * name )
 {
-  assert( moves != NULL );
+  assert( moves_by_name != NULL );
   assert( name != NULL );
-  store_move_t * move = NULL;
-  HASH_FIND( hh_name, moves, name, strlen( name ), move );
+  const store_move_t * move = strmap_get( moves_by_name, name );
   return ( move == NULL ) ? 0 : move->move_id;
 }
 
   uint16_t
-lookup_move_idn( store_move_t * moves, const char * name, int16_t n )
+lookup_move_idn( const strmap_t * moves_by_name, const char * name, int16_t n )
 {
-  assert( moves != NULL );
+  assert( moves_by_name != NULL );
   assert( name != NULL );
   assert( 0 != n );
-  store_move_t * move = NULL;
   /**
    * Take absolute value of move index incase the caller forgot to clear the
    * highest bit ( indicating legacy moves in a `pdex_mon_t' `move_id' list )
    */
-  HASH_FIND( hh_name, moves, name, max( n, -n ), move );
+  const store_move_t * move = strmap_getn( moves_by_name, name, max( n, -n ) );
   return ( move == NULL ) ? 0 : move->move_id;
 }
 
@@ -961,23 +1089,21 @@ lookup_move_idn( store_move_t * moves, const char * name, int16_t n )
 /* -------------------------------------------------------------------------- */
 
   uint16_t
-lookup_dex( pdex_mon_t * mons, const char * name )
+lookup_dex( const strmap_t * mons_by_name, const char * name )
 {
-  assert( mons != NULL );
+  assert( mons_by_name != NULL );
   assert( name != NULL );
-  pdex_mon_t * mon = NULL;
-  HASH_FIND( hh_name, mons, name, strlen( name ), mon );
+  const pdex_mon_t * mon = strmap_get( mons_by_name, name );
   return ( mon == NULL ) ? 0 : mon->dex_number;
 }
 
   uint16_t
-lookup_dexn( pdex_mon_t * mons, const char * name, size_t n )
+lookup_dexn( const strmap_t * mons_by_name, const char * name, size_t n )
 {
-  assert( mons != NULL );
+  assert( mons_by_name != NULL );
   assert( name != NULL );
   assert( 0 < n );
-  pdex_mon_t * mon = NULL;
-  HASH_FIND( hh_name, mons, name, n, mon );
+  const pdex_mon_t * mon = strmap_getn( mons_by_name, name, n );
   return ( mon == NULL ) ? 0 : mon->dex_number;
 }
 
@@ -993,8 +1119,8 @@ process_moves( gm_parser_t * gm_parser )
   jsmntok_t          * key          = NULL;
   jsmntok_t          * val          = NULL;
   jsmntok_t          * item         = NULL;
-  pvp_fast_move_t    * fast_move    = NULL;
-  pvp_charged_move_t * charged_move = NULL;
+  pvp_fast_move_t      fast_move;
+  pvp_charged_move_t   charged_move;
   char               * name         = NULL;
 
   assert( jsmn_rsl == 0 );
@@ -1034,32 +1160,29 @@ process_moves( gm_parser_t * gm_parser )
                         )
          )
         {
-          fast_move = (pvp_fast_move_t *) malloc( sizeof( pvp_fast_move_t ) );
-          assert( fast_move != NULL );
+          memset( & fast_move, 0, sizeof( pvp_fast_move_t ) );
           jsmn_rsl = parse_pvp_fast_move( gm_parser->buffer,
                                           &( gm_parser->iter_stack ),
                                           & name,
-                                          fast_move
+                                          & fast_move
                                         );
           assert( name != NULL );
           assert( 0 < jsmn_rsl );
-          add_pvp_fast_move_data( gm_parser, name, fast_move );
-          free( fast_move );
+          add_pvp_fast_move_data( gm_parser, name, & fast_move );
+          free( name );
         }
       else /* Charged Move */
         {
-          charged_move =
-            (pvp_charged_move_t *) malloc( sizeof( pvp_charged_move_t ) );
-          assert( charged_move != NULL );
+          memset( & charged_move, 0, sizeof( pvp_charged_move_t ) );
           jsmn_rsl = parse_pvp_charged_move( gm_parser->buffer,
                                              &( gm_parser->iter_stack ),
                                              & name,
-                                             charged_move
+                                             & charged_move
                                            );
           assert( name != NULL );
           assert( 0 < jsmn_rsl );
-          add_pvp_charged_move_data( gm_parser, name, charged_move );
-          free( charged_move );
+          add_pvp_charged_move_data( gm_parser, name, & charged_move );
+          free( name );
         }
 
       jsmnis_pop( &( gm_parser->iter_stack ) );
@@ -1095,7 +1218,7 @@ process_pokemon( gm_parser_t * gm_parser )
 {
   assert( gm_parser != NULL );
   /* Moves MUST be processed first! */
-  assert( gm_parser->moves_by_name != NULL );
+  assert( 0 < gm_parser->tables.moves_cnt );
 
   size_t       first_idx = 0;
   int          jsmn_rsl  = seek_templates_start( gm_parser );
@@ -1136,12 +1259,13 @@ process_pokemon( gm_parser_t * gm_parser )
           continue;
         }
 
-      mon = (pdex_mon_t *) malloc( sizeof( pdex_mon_t ) );
+      mon = (pdex_mon_t *) arena_alloc( & gm_parser->tables.records,
+                                        sizeof( pdex_mon_t )
+                                      );
       assert( mon != NULL );
       jsmn_rsl = parse_pdex_mon( gm_parser->buffer,
                                  &( gm_parser->iter_stack ),
-                                 gm_parser->moves_by_name,
-                                 gm_parser->mons_by_name,
+                                 & gm_parser->tables,
                                  &item,
                                  mon
                                );
@@ -1153,6 +1277,7 @@ process_pokemon( gm_parser_t * gm_parser )
         {
           if ( gm_parser->incomplete_size <= gm_parser->incomplete_idx )
             {
+              assert( gm_parser->incomplete_size <= UINT16_MAX / 2 );
               gm_parser->incomplete_size <<= 1;
               gm_parser->incomplete_mon =
                 (pdex_mon_t **) realloc( gm_parser->incomplete_mon,
@@ -1160,10 +1285,12 @@ process_pokemon( gm_parser_t * gm_parser )
                                            sizeof( pdex_mon_t * )
                                        );
               gm_parser->incomplete_fam =
-                (jsmntok_t **) realloc( gm_parser->incomplete_mon,
+                (jsmntok_t **) realloc( gm_parser->incomplete_fam,
                                         gm_parser->incomplete_size *
                                           sizeof( jsmntok_t * )
                                       );
+              assert( gm_parser->incomplete_mon != NULL );
+              assert( gm_parser->incomplete_fam != NULL );
             }
           gm_parser->incomplete_mon[gm_parser->incomplete_idx]   = mon;
           gm_parser->incomplete_fam[gm_parser->incomplete_idx++] = item;
@@ -1172,16 +1299,18 @@ process_pokemon( gm_parser_t * gm_parser )
       jsmnis_pop( &( gm_parser->iter_stack ) );
     }
 
-  for ( uint8_t i = 0; i < gm_parser->incomplete_idx; i++ )
+  for ( uint16_t i = 0; i < gm_parser->incomplete_idx; i++ )
     {
       mon = gm_parser->incomplete_mon[i];
-      mon->family = lookup_dexn( gm_parser->mons_by_name,
+      mon->family = lookup_dexn( & gm_parser->tables.mons_by_name,
                                  gm_parser->buffer +
                                    gm_parser->incomplete_fam[i]->start + 7,
                                  toklen( gm_parser->incomplete_fam[i] ) - 7
                                );
       assert( mon->family != 0 );
     }
+
+  gm_parser_link( gm_parser );
 }
 
 
@@ -1199,8 +1328,12 @@ Parse a GAME_MASTER.json file and convert it to another format.
 Example: parse_gm -e c -f ./my_gm.json
 
 Options:
-  -e FORMAT    Encode to FORMAT. One of: C, JSON, SQL.  \( Case Insensitive \)
+  -e FORMAT    Encode to FORMAT. One of: C, JSON, SQL, SNAP.
+               \( Case Insensitive \)
   -f FILE      Use FILE as GAME_MASTER.json file.
+  -o OUTPUT    Write to OUTPUT instead of STDOUT.
+               SQL exports require a database path, and default to
+               ./data/poketables.db
 
 Default export format is C, default FILE is ./data/GAME_MASTER.json
 )RAW_STRING";
@@ -1211,31 +1344,42 @@ main( int argc, char * argv[], char ** envp )
   gm_parser_t    gm_parser;
   size_t         tokens_cnt = 0;
   char         * gm_path    = NULL;
+  char         * out_path   = NULL;
+  FILE         * ostream    = stdout;
+  int            status     = STORE_SUCCESS;
   store_sink_t   export_fmt = SS_C;
   char           opt        = '\0';
 
   while ( optind < argc )
     {
-      opt = getopt( argc, argv, "he:f:" );
+      opt = getopt( argc, argv, "he:f:o:" );
       switch( opt )
         {
         case 'e':
           if ( strcasecmp( optarg, "json" ) == 0 )     export_fmt = SS_JSON;
           else if ( strcasecmp( optarg, "c" ) == 0 )   export_fmt = SS_C;
           else if ( strcasecmp( optarg, "sql" ) == 0 ) export_fmt = SS_SQL;
+          else if ( strcasecmp( optarg, "snap" ) == 0 )
+            {
+              export_fmt = SS_SNAPSHOT;
+            }
           break;
 
         case 'f':
           gm_path = optarg;
           break;
 
+        case 'o':
+          out_path = optarg;
+          break;
+
         case 'h':
           fprintf( stdout, USAGE_STR );
           return EXIT_SUCCESS;
           break;
 
         case '?':
-          if ( ( optopt == 'e' ) || ( optopt == 'f' ) )
+          if ( ( optopt == 'e' ) || ( optopt == 'f' ) || ( optopt == 'o' ) )
             {
               fprintf( stderr, "Option `-%c' requires an argument.\n", optopt );
             }
@@ -1283,14 +1427,29 @@ main( int argc, char * argv[], char ** envp )
   GM_init( & gm_parser );
   gm_parser_release( & gm_parser );
 
-  /* Prints store as a Static C Store */
-  GM_export( export_fmt, stdout );
-  pdex_mon_t * mon = NULL;
+  /* SQL writes to a database rather than a stream */
+  if ( export_fmt == SS_SQL )
+    {
+      if ( out_path == NULL ) out_path = "./data/poketables.db";
+      status = GM_export( export_fmt, out_path );
+    }
+  else
+    {
+      if ( out_path != NULL ) ostream = fopen( out_path, "w" );
+      if ( ostream == NULL )
+        {
+          perror( out_path );
+          GM_STORE.free( & GM_STORE );
+          return EXIT_FAILURE;
+        }
+      status = GM_export( export_fmt, ostream );
+      if ( ostream != stdout ) fclose( ostream );
+    }
 
   /* Cleanup */
   GM_STORE.free( & GM_STORE );
 
-  return EXIT_SUCCESS;
+  return ( status == STORE_SUCCESS ) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 #endif /* MK_PARSE_GM_BINARY */
 
@@ -14,18 +14,9 @@
 
 /* -------------------------------------------------------------------------- */
 
-  void
-pvp_pokemon_init( pvp_pokemon_t    * mon,
-                  roster_pokemon_t * rmon,
-                  store_t          * store
-                )
+  static inline void
+pvp_pokemon_init_stats( pvp_pokemon_t * mon, roster_pokemon_t * rmon )
 {
-  assert( mon != NULL );
-  assert( rmon != NULL );
-  assert( store != NULL );
-
-  int rsl = 0;
-
   mon->level = rmon->base->level;
 
   mon->stats.attack  = rmon->base->pdex_mon->base_stats.attack +
@@ -47,6 +38,24 @@ pvp_pokemon_init( pvp_pokemon_t    * mon,
   mon->cooldown  = 0;
   mon->energy    = 0;
   mon->buffs     = NO_BUFF_STATE;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  void
+pvp_pokemon_init( pvp_pokemon_t    * mon,
+                  roster_pokemon_t * rmon,
+                  store_t          * store
+                )
+{
+  assert( mon != NULL );
+  assert( rmon != NULL );
+  assert( store != NULL );
+
+  int rsl = 0;
+
+  pvp_pokemon_init_stats( mon, rmon );
 
   rsl = pvp_fast_move_from_store( store, rmon->fast_move_id, & mon->fast_move );
   assert( rsl == STORE_SUCCESS );
@@ -68,6 +77,66 @@ pvp_pokemon_init( pvp_pokemon_t    * mon,
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Every Pokemon needs 3 moves, so we collect keys for a batch of Pokemon and
+ * fetch them all with a single `store_get_many' call.
+ * A missing second charged move just repeats the key of the first, which is
+ * basically free and keeps each Pokemon's moves at a fixed offset.
+ */
+  int
+pvp_pokemon_init_many( pvp_pokemon_t    * mons,
+                       roster_pokemon_t * rmons,
+                       size_t             n,
+                       store_t          * store
+                     )
+{
+  assert( ( mons != NULL ) || ( n == 0 ) );
+  assert( ( rmons != NULL ) || ( n == 0 ) );
+  if ( store == NULL )                         return STORE_ERROR_BAD_VALUE;
+  if ( !( store->flags & SF_STANDARD_KEY_M ) ) return STORE_ERROR_BAD_VALUE;
+
+  store_key_t    keys[3 * PVP_INIT_BATCH_SIZE];
+  store_move_t * moves[3 * PVP_INIT_BATCH_SIZE];
+  int            rsl = STORE_SUCCESS;
+
+  for ( size_t b = 0; b < n; b += PVP_INIT_BATCH_SIZE )
+    {
+      size_t cnt = min( n - b, (size_t) PVP_INIT_BATCH_SIZE );
+
+      for ( size_t i = 0; i < cnt; i++ )
+        {
+          roster_pokemon_t * rmon = rmons + b + i;
+          uint16_t c1 = ( rmon->charged_move_ids[1] != 0 )
+                          ? rmon->charged_move_ids[1]
+                          : rmon->charged_move_ids[0];
+          keys[3 * i]     = move_id_store_key( rmon->fast_move_id );
+          keys[3 * i + 1] = move_id_store_key( rmon->charged_move_ids[0] );
+          keys[3 * i + 2] = move_id_store_key( c1 );
+        }
+
+      rsl = store_get_many( store, keys, 3 * cnt, (void **) moves, NULL );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+
+      for ( size_t i = 0; i < cnt; i++ )
+        {
+          pvp_pokemon_t    * mon  = mons + b + i;
+          roster_pokemon_t * rmon = rmons + b + i;
+          pvp_pokemon_init_stats( mon, rmon );
+          mon->fast_move        = pvp_fast_move_from_store_move( moves[3 * i] );
+          mon->charged_moves[0] =
+            pvp_charged_move_from_store_move( moves[3 * i + 1] );
+          mon->charged_moves[1] = ( rmon->charged_move_ids[1] != 0 )
+            ? pvp_charged_move_from_store_move( moves[3 * i + 2] )
+            : NO_MOVE_PVP_CHARGED;
+        }
+    }
+
+  return rsl;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   const_fn uint16_t
@@ -94,6 +163,29 @@ get_hp_from_stam_lv( uint16_t stam, float lv )
 }
 
 
+/* CP only grows with level, so binary search the half levels */
+  const_fn float
+get_max_level_for_cp( stats_t base, stats_t ivs, uint16_t cp_cap )
+{
+  int lo = 0;
+  int hi = (int) ( ( MAX_LEVEL - 1.0 ) * 2 );
+  if ( cp_cap < get_cp_from_stats( base, ivs, 1.0 ) ) return 0.0;
+  while ( lo < hi )
+    {
+      int mid = ( lo + hi + 1 ) / 2;
+      if ( get_cp_from_stats( base, ivs, mid / 2.0 + 1.0 ) <= cp_cap )
+        {
+          lo = mid;
+        }
+      else
+        {
+          hi = mid - 1;
+        }
+    }
+  return lo / 2.0 + 1.0;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   const_fn stats_t
@@ -137,29 +229,38 @@ get_pvp_damage( pmove_idx_t     attack_idx,
 
 /* -------------------------------------------------------------------------- */
 
-  roster_t *
-roster_append( roster_t * roster, roster_pokemon_t * mon )
+  bool
+roster_reserve( roster_t * roster, size_t n )
 {
-  assert( mon != NULL );
   assert( roster != NULL );
   assert( ( roster->roster_pokemon != NULL ) ||
           ( roster->roster_length == 0 )
           );
-  if ( ( roster->roster_pokemon == NULL ) && ( roster->roster_length == 0 ) )
-    {
-      roster->roster_pokemon =
-        (roster_pokemon_t *) malloc( sizeof( roster_pokemon_t ) );
-      roster->roster_length = 0;
-    }
-  else
+  if ( n <= roster->roster_capacity ) return true;
+
+  roster_pokemon_t * rmons =
+    (roster_pokemon_t *) realloc( roster->roster_pokemon,
+                                  sizeof( roster_pokemon_t ) * n
+                                  );
+  if ( rmons == NULL ) return false;
+  roster->roster_pokemon  = rmons;
+  roster->roster_capacity = n;
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  roster_t *
+roster_append( roster_t * roster, roster_pokemon_t * mon )
+{
+  assert( mon != NULL );
+  assert( roster != NULL );
+  if ( roster->roster_capacity <= roster->roster_length )
     {
-      roster->roster_pokemon =
-        (roster_pokemon_t *) realloc( roster->roster_pokemon,
-                                      sizeof( roster_pokemon_t ) *
-                                      ( roster->roster_length + 1)
-                                      );
+      size_t cap = max( roster->roster_length * 2, 8 );
+      if ( ! roster_reserve( roster, cap ) ) return NULL;
     }
-  assert( roster->roster_pokemon != NULL );
   memcpy( roster->roster_pokemon + roster->roster_length,
           mon,
           sizeof( roster_pokemon_t )
@@ -169,6 +270,21 @@ roster_append( roster_t * roster, roster_pokemon_t * mon )
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+  void
+roster_free( roster_t * roster )
+{
+  assert( roster != NULL );
+  free( roster->roster_pokemon );
+  free( roster->roster_bases );
+  roster->roster_pokemon  = NULL;
+  roster->roster_length   = 0;
+  roster->roster_capacity = 0;
+  roster->roster_bases    = NULL;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   int
@@ -0,0 +1,599 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "cupstore.h"
+#include "filter_index.h"
+#include "matchup.h"
+#include "matchup_file.h"
+#include "moveset.h"
+#include "pokemon.h"
+#include "ranking.h"
+#include "util/bitset.h"
+#include "util/macros.h"
+#include "util/parallel.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+  static int
+ranking_reserve( ranking_t * ranking, uint32_t * cap, uint32_t n )
+{
+  if ( n <= * cap ) return STORE_SUCCESS;
+  uint32_t          ncap = max( n, max( * cap * 2, 64 ) );
+  ranking_entry_t * tmp  =
+    realloc( ranking->entries, sizeof( ranking_entry_t ) * ncap );
+  if ( tmp == NULL ) return STORE_ERROR_NOMEM;
+  ranking->entries = tmp;
+  * cap            = ncap;
+  return STORE_SUCCESS;
+}
+
+
+/**
+ * Add an entry for every moveset of `pdex' in the order of
+ * `moveset_candidates', skipping dominated ones when `opts->prune' is set.
+ */
+  static int
+ranking_add_species( ranking_t            * ranking,
+                     uint32_t             * cap,
+                     store_t              * store,
+                     const pdex_mon_t     * pdex,
+                     uint8_t                level,
+                     const ranking_opts_t * opts
+                   )
+{
+  ranking_species_t * species  = ranking->species + ranking->nspecies;
+  uint32_t            limit    = opts->max_movesets;
+  uint32_t            n        = 0;
+  moveset_t         * movesets = (moveset_t *)
+    malloc( sizeof( moveset_t ) * moveset_count( pdex ) );
+
+  if ( movesets == NULL ) return STORE_ERROR_NOMEM;
+  int rsl = moveset_candidates( store, pdex, opts->prune, movesets, & n );
+  if ( rsl != STORE_SUCCESS ) goto done;
+  if ( ( limit != 0 ) && ( limit < n ) ) n = limit;
+  rsl = ranking_reserve( ranking, cap, ranking->nentries + n );
+  if ( rsl != STORE_SUCCESS ) goto done;
+
+  species->first    = ranking->nentries;
+  species->nentries = n;
+
+  for ( uint32_t m = 0; m < n; m++ )
+    {
+      ranking_entry_t * entry = ranking->entries + ranking->nentries;
+      memset( entry, 0, sizeof( ranking_entry_t ) );
+      entry->dex_number          = pdex->dex_number;
+      entry->form_idx            = pdex->form_idx;
+      entry->level               = level;
+      entry->fast_move_id        = movesets[m].fast_move_id;
+      entry->charged_move_ids[0] = movesets[m].charged_move_ids[0];
+      entry->charged_move_ids[1] = movesets[m].charged_move_ids[1];
+      entry->species             = ranking->nspecies;
+      ranking->nentries++;
+    }
+
+done:
+  free( movesets );
+  return rsl;
+}
+
+
+/* Enter every eligible species of `cup', filling `entries' and `species'. */
+  static int
+ranking_enter( ranking_t            * ranking,
+               const cup_t          * cup,
+               const ranking_opts_t * opts
+             )
+{
+  const filter_index_t * index = cup->index;
+  uint32_t               cap   = 0;
+
+  ranking->species = (ranking_species_t *)
+    calloc( max( cup->pool_size, 1 ), sizeof( ranking_species_t ) );
+  if ( ranking->species == NULL ) return STORE_ERROR_NOMEM;
+
+  for ( uint32_t i = 0; i < index->nmons; i++ )
+    {
+      if ( ! bitset_test( cup->pool, i ) ) continue;
+
+      pdex_mon_t * pdex = NULL;
+      int          rsl  = filter_index_get( index, i, & pdex );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+      if ( ( pdex->fast_moves_cnt == 0 ) || ( pdex->charged_moves_cnt == 0 ) )
+        {
+          continue;
+        }
+
+      uint8_t level =
+        (uint8_t) get_max_level_for_cp( pdex->base_stats, opts->ivs,
+                                        cup->cp_cap
+                                      );
+      if ( level == 0 ) continue;
+
+      rsl = ranking_add_species( ranking, & cap, index->store, pdex, level,
+                                 opts
+                               );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+      ranking->species[ranking->nspecies].opponent =
+        ranking->species[ranking->nspecies].first;
+      ranking->nspecies++;
+    }
+
+  return ( ranking->nspecies == 0 ) ? STORE_ERROR_NOT_FOUND : STORE_SUCCESS;
+}
+
+
+/* Build a `pvp_pokemon_t' for every entry. */
+  static int
+ranking_init_mons( const ranking_t * ranking,
+                   store_t         * store,
+                   pvp_pokemon_t   * mons
+                 )
+{
+  roster_pokemon_t * rmons = (roster_pokemon_t *)
+    malloc( sizeof( roster_pokemon_t ) * ranking->nentries );
+  base_pokemon_t   * bases = (base_pokemon_t *)
+    malloc( sizeof( base_pokemon_t ) * ranking->nspecies );
+  int                rsl   = STORE_SUCCESS;
+
+  if ( ( rmons == NULL ) || ( bases == NULL ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+
+  for ( uint32_t s = 0; s < ranking->nspecies; s++ )
+    {
+      const ranking_entry_t * first =
+        ranking->entries + ranking->species[s].first;
+      rsl = base_mon_from_store( store,
+                                 first->dex_number,
+                                 first->form_idx,
+                                 first->level,
+                                 ranking->ivs.attack,
+                                 ranking->ivs.stamina,
+                                 ranking->ivs.defense,
+                                 bases + s
+                               );
+      if ( rsl != STORE_SUCCESS ) goto done;
+    }
+
+  for ( uint32_t e = 0; e < ranking->nentries; e++ )
+    {
+      const ranking_entry_t * entry = ranking->entries + e;
+      rmons[e] = (roster_pokemon_t) {
+        .base             = bases + entry->species,
+        .fast_move_id     = entry->fast_move_id,
+        .charged_move_ids = { entry->charged_move_ids[0],
+                              entry->charged_move_ids[1]
+                            }
+      };
+    }
+
+  rsl = pvp_pokemon_init_many( mons, rmons, ranking->nentries, store );
+
+done:
+  free( rmons );
+  free( bases );
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+struct ranking_score_job_s {
+  ranking_t   * ranking;
+  const float * weights;
+  double        total;
+};
+typedef struct ranking_score_job_s  ranking_score_job_t;
+
+
+  static void
+ranking_score_rows( void * vjob, uint32_t begin, uint32_t end, uint32_t t )
+{
+  ranking_score_job_t    * job     = (ranking_score_job_t *) vjob;
+  ranking_t              * ranking = job->ranking;
+  const matchup_matrix_t * matrix  = & ranking->matrix;
+
+  for ( uint32_t e = begin; e < end; e++ )
+    {
+      ranking_entry_t * entry = ranking->entries + e;
+      double            score = 0.0;
+      for ( uint8_t s = 0; s < matrix->nscenarios; s++ )
+        {
+          const uint16_t * row = matchup_matrix_row( matrix, e, s );
+          double           sum = 0.0;
+          for ( uint32_t c = 0; c < matrix->ncols; c++ )
+            {
+              sum += ( ( job->weights == NULL ) ? 1.0 : job->weights[c] ) *
+                     row[c];
+            }
+          entry->scenario_scores[s] = (float) ( sum / job->total );
+          score += sum / job->total;
+        }
+      entry->score = (float) ( score / matrix->nscenarios );
+    }
+}
+
+
+  int
+ranking_score( ranking_t * ranking, const float * weights, uint32_t nthreads )
+{
+  assert( ranking != NULL );
+  assert( ranking->matrix.ratings != NULL );
+
+  ranking_score_job_t job = {
+    .ranking = ranking,
+    .weights = weights,
+    .total   = ranking->matrix.ncols
+  };
+  if ( weights != NULL )
+    {
+      job.total = 0.0;
+      for ( uint32_t c = 0; c < ranking->matrix.ncols; c++ )
+        {
+          if ( weights[c] < 0.0 ) return STORE_ERROR_BAD_VALUE;
+          job.total += weights[c];
+        }
+      if ( job.total == 0.0 ) return STORE_ERROR_BAD_VALUE;
+    }
+
+  if ( parallel_for( ranking->nentries, 0, nthreads, ranking_score_rows,
+                     & job
+                   ) != 0 )
+    {
+      return STORE_ERROR_NOMEM;
+    }
+
+  /* Pick each species' best moveset */
+  for ( uint32_t s = 0; s < ranking->nspecies; s++ )
+    {
+      ranking_species_t * species = ranking->species + s;
+      species->best = species->first;
+      for ( uint32_t e = species->first + 1;
+            e < species->first + species->nentries;
+            e++ )
+        {
+          if ( ranking->entries[species->best].score <
+               ranking->entries[e].score )
+            {
+              species->best = e;
+            }
+        }
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+/**
+ * Weight each opponent by its own score relative to the best opponent.
+ * New weights are averaged with the old ones, which keeps the iteration from
+ * see-sawing between two rankings when strong Pokemon counter each other.
+ */
+  static void
+ranking_reweight( const ranking_t * ranking, float exponent, float * weights )
+{
+  float best = 0.0;
+  for ( uint32_t s = 0; s < ranking->nspecies; s++ )
+    {
+      best = max( best, ranking->entries[ranking->species[s].opponent].score );
+    }
+  if ( best <= 0.0 ) return;
+
+  for ( uint32_t s = 0; s < ranking->nspecies; s++ )
+    {
+      float score = ranking->entries[ranking->species[s].opponent].score;
+      float w     = powf( score / best, exponent );
+      weights[s]  = ( weights[s] + w ) / 2.0;
+    }
+}
+
+
+/* Score until no entry moves by more than `epsilon'. */
+  static int
+ranking_iterate( ranking_t            * ranking,
+                 const ranking_opts_t * opts,
+                 float                * weights,
+                 float                * prev
+               )
+{
+  ranking->converged = false;
+  for ( uint32_t it = 0; it < opts->max_iters; it++ )
+    {
+      int rsl = ranking_score( ranking, weights, opts->nthreads );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+      ranking->iterations++;
+
+      float delta = 0.0;
+      for ( uint32_t e = 0; e < ranking->nentries; e++ )
+        {
+          delta   = max( delta, fabsf( ranking->entries[e].score - prev[e] ) );
+          prev[e] = ranking->entries[e].score;
+        }
+      if ( ( 0 < it ) && ( delta <= opts->epsilon ) )
+        {
+          ranking->converged = true;
+          break;
+        }
+      ranking_reweight( ranking, opts->exponent, weights );
+    }
+  return STORE_SUCCESS;
+}
+
+
+/**
+ * Swap each species' column to its best moveset, simulating only the
+ * columns that changed.
+ * Sets `changed' to the number of columns replaced.
+ */
+  static int
+ranking_update_opponents( ranking_t            * ranking,
+                          const pvp_pokemon_t  * mons,
+                          const ranking_opts_t * opts,
+                          uint32_t             * changed
+                        )
+{
+  uint32_t      * col_idx = (uint32_t *)
+    malloc( sizeof( uint32_t ) * ranking->nspecies );
+  pvp_pokemon_t * cols    = (pvp_pokemon_t *)
+    malloc( sizeof( pvp_pokemon_t ) * ranking->nspecies );
+  uint32_t        n       = 0;
+  int             rsl     = STORE_SUCCESS;
+
+  if ( ( col_idx == NULL ) || ( cols == NULL ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+
+  for ( uint32_t s = 0; s < ranking->nspecies; s++ )
+    {
+      ranking_species_t * species = ranking->species + s;
+      if ( species->best == species->opponent ) continue;
+      species->opponent = species->best;
+      col_idx[n]        = s;
+      cols[n]           = mons[species->best];
+      n++;
+    }
+
+  rsl = matchup_matrix_update_cols( & ranking->matrix, mons, col_idx, cols, n,
+                                    opts->nthreads, opts->cache
+                                  );
+
+done:
+  * changed = n;
+  free( col_idx );
+  free( cols );
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+struct ranking_sort_s {
+  float    score;
+  uint32_t species;
+};
+
+/* Best score first, then in Pokedex order */
+  static int
+ranking_sort_cmp( const void * a, const void * b )
+{
+  const struct ranking_sort_s * sa = (const struct ranking_sort_s *) a;
+  const struct ranking_sort_s * sb = (const struct ranking_sort_s *) b;
+  if ( sa->score != sb->score ) return ( sa->score < sb->score ) ? 1 : -1;
+  return ( sa->species > sb->species ) - ( sa->species < sb->species );
+}
+
+
+/* Sort species by score, filling `order' and each species' `rank'. */
+  static int
+ranking_sort( ranking_t * ranking )
+{
+  struct ranking_sort_s * sorted = (struct ranking_sort_s *)
+    malloc( sizeof( struct ranking_sort_s ) * ranking->nspecies );
+  if ( sorted == NULL ) return STORE_ERROR_NOMEM;
+
+  for ( uint32_t s = 0; s < ranking->nspecies; s++ )
+    {
+      sorted[s].score   = ranking->entries[ranking->species[s].best].score;
+      sorted[s].species = s;
+    }
+  qsort( sorted, ranking->nspecies, sizeof( struct ranking_sort_s ),
+         ranking_sort_cmp
+       );
+  for ( uint32_t r = 0; r < ranking->nspecies; r++ )
+    {
+      ranking->order[r]                        = sorted[r].species;
+      ranking->species[sorted[r].species].rank = r;
+    }
+
+  free( sorted );
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+ranking_build( ranking_t            * ranking,
+               const cup_t          * cup,
+               const ranking_opts_t * opts
+             )
+{
+  assert( ranking != NULL );
+  assert( cup != NULL );
+  assert( cup->index != NULL );
+  assert( cup->pool != NULL );
+
+  const ranking_opts_t defaults = RANKING_OPTS_DEFAULT;
+  if ( opts == NULL ) opts = & defaults;
+  if ( ( opts->scenarios & MATCHUP_ALL_SCENARIOS_M ) == 0 )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  * ranking        = (ranking_t) RANKING_INIT;
+  ranking->ivs     = opts->ivs;
+  ranking->cp_cap  = cup->cp_cap;
+
+  pvp_pokemon_t * mons    = NULL;
+  pvp_pokemon_t * cols    = NULL;
+  float         * weights = NULL;
+  float         * prev    = NULL;
+
+  int rsl = ranking_enter( ranking, cup, opts );
+  if ( rsl != STORE_SUCCESS ) goto fail;
+
+  mons    = (pvp_pokemon_t *) malloc( sizeof( pvp_pokemon_t ) *
+                                      ranking->nentries );
+  cols    = (pvp_pokemon_t *) malloc( sizeof( pvp_pokemon_t ) *
+                                      ranking->nspecies );
+  weights = (float *) malloc( sizeof( float ) * ranking->nspecies );
+  prev    = (float *) calloc( ranking->nentries, sizeof( float ) );
+  ranking->order = (uint32_t *) malloc( sizeof( uint32_t ) *
+                                        ranking->nspecies );
+  if ( ( mons == NULL ) || ( cols == NULL ) || ( weights == NULL ) ||
+       ( prev == NULL ) || ( ranking->order == NULL )
+     )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto fail;
+    }
+
+  rsl = ranking_init_mons( ranking, cup->index->store, mons );
+  if ( rsl != STORE_SUCCESS ) goto fail;
+
+  for ( uint32_t s = 0; s < ranking->nspecies; s++ )
+    {
+      cols[s]    = mons[ranking->species[s].opponent];
+      weights[s] = 1.0;
+    }
+  const matchup_opts_t mopts = {
+    .scenarios = opts->scenarios,
+    .nthreads  = opts->nthreads,
+    .cache     = opts->cache
+  };
+  rsl = matchup_matrix_build( & ranking->matrix,
+                              mons, ranking->nentries,
+                              cols, ranking->nspecies,
+                              & mopts
+                            );
+  if ( rsl != STORE_SUCCESS ) goto fail;
+
+  while ( true )
+    {
+      rsl = ranking_iterate( ranking, opts, weights, prev );
+      if ( rsl != STORE_SUCCESS ) goto fail;
+      if ( opts->max_rounds <= ranking->rounds ) break;
+
+      uint32_t changed = 0;
+      rsl = ranking_update_opponents( ranking, mons, opts, & changed );
+      if ( rsl != STORE_SUCCESS ) goto fail;
+      if ( changed == 0 ) break;
+      ranking->rounds++;
+    }
+
+  rsl = ranking_sort( ranking );
+  if ( rsl != STORE_SUCCESS ) goto fail;
+
+  free( mons );
+  free( cols );
+  free( weights );
+  free( prev );
+  return STORE_SUCCESS;
+
+fail:
+  free( mons );
+  free( cols );
+  free( weights );
+  free( prev );
+  ranking_free( ranking );
+  return rsl;
+}
+
+
+  void
+ranking_free( ranking_t * ranking )
+{
+  assert( ranking != NULL );
+  free( ranking->entries );
+  free( ranking->species );
+  free( ranking->order );
+  matchup_matrix_free( & ranking->matrix );
+  * ranking = (ranking_t) RANKING_INIT;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static matchup_file_mon_t
+ranking_file_mon( const ranking_entry_t * entry )
+{
+  return (matchup_file_mon_t) {
+    .dex_number       = entry->dex_number,
+    .form_idx         = entry->form_idx,
+    .level            = entry->level,
+    .fast_move_id     = entry->fast_move_id,
+    .charged_move_ids = { entry->charged_move_ids[0],
+                          entry->charged_move_ids[1]
+                        },
+    .reserved         = 0
+  };
+}
+
+
+  int
+ranking_save_matrix( const ranking_t * ranking,
+                     uint64_t          data_version,
+                     const char      * fpath
+                   )
+{
+  assert( ranking != NULL );
+  assert( fpath != NULL );
+
+  matchup_file_mon_t * rows = (matchup_file_mon_t *)
+    malloc( sizeof( matchup_file_mon_t ) * max( ranking->nentries, 1 ) );
+  matchup_file_mon_t * cols = (matchup_file_mon_t *)
+    malloc( sizeof( matchup_file_mon_t ) * max( ranking->nspecies, 1 ) );
+  int                  rsl  = STORE_ERROR_NOMEM;
+
+  if ( ( rows != NULL ) && ( cols != NULL ) )
+    {
+      for ( uint32_t e = 0; e < ranking->nentries; e++ )
+        {
+          rows[e] = ranking_file_mon( ranking->entries + e );
+        }
+      for ( uint32_t s = 0; s < ranking->nspecies; s++ )
+        {
+          cols[s] = ranking_file_mon( ranking->entries +
+                                      ranking->species[s].opponent
+                                    );
+        }
+      rsl = matchup_file_save( & ranking->matrix, rows, cols, data_version,
+                               fpath
+                             );
+    }
+
+  free( rows );
+  free( cols );
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
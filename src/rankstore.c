@@ -0,0 +1,408 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "matchup.h"
+#include "ranking.h"
+#include "rankstore.h"
+#include "store.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+rankstore_init( store_t * rankstore, void * unused )
+{
+  assert( rankstore != NULL );
+  rankstore->aux = calloc( 1, sizeof( rankstore_aux_t ) );
+  if ( rankstore->aux == NULL ) return STORE_ERROR_NOMEM;
+  return STORE_SUCCESS;
+}
+
+
+  void
+rankstore_free( store_t * rankstore )
+{
+  assert( rankstore != NULL );
+  rankstore_aux_t * rksa = as_rksa( rankstore );
+  if ( rksa == NULL ) return;
+
+  for ( uint32_t i = 0; i < rksa->cnt; i++ ) free( rksa->mons[i].movesets );
+  free( rksa->mons );
+  free( rksa->by_key );
+  free( rksa );
+  rankstore->aux = NULL;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#define rank_mon_key( DEX, FORM )  ( ( (uint32_t) ( DEX ) << 8 ) | ( FORM ) )
+
+
+/**
+ * Binary search `by_key' for a species, returning true if it was found.
+ * `pos' is set to its position, or where it would be inserted.
+ */
+  static bool
+rankstore_find( const rankstore_aux_t * rksa,
+                uint16_t                dex_num,
+                uint8_t                 form_idx,
+                uint32_t              * pos
+              )
+{
+  const uint32_t want = rank_mon_key( dex_num, form_idx );
+  uint32_t       lo   = 0;
+  uint32_t       hi   = rksa->cnt;
+  while ( lo < hi )
+    {
+      uint32_t               mid = lo + ( hi - lo ) / 2;
+      const pvp_mon_rank_t * mon = rksa->mons + rksa->by_key[mid];
+      uint32_t               got = rank_mon_key( mon->dex_number,
+                                                 mon->form_idx
+                                               );
+      if ( got == want )
+        {
+          * pos = mid;
+          return true;
+        }
+      if ( got < want ) lo = mid + 1;
+      else              hi = mid;
+    }
+  * pos = lo;
+  return false;
+}
+
+
+/* Copy `src' into `dst', with its own movesets. */
+  static int
+pvp_mon_rank_copy( pvp_mon_rank_t * dst, const pvp_mon_rank_t * src )
+{
+  pvp_moveset_rank_t * movesets = NULL;
+  if ( src->nmovesets != 0 )
+    {
+      if ( src->movesets == NULL ) return STORE_ERROR_BAD_VALUE;
+      movesets = (pvp_moveset_rank_t *)
+        malloc( sizeof( pvp_moveset_rank_t ) * src->nmovesets );
+      if ( movesets == NULL ) return STORE_ERROR_NOMEM;
+      memcpy( movesets, src->movesets,
+              sizeof( pvp_moveset_rank_t ) * src->nmovesets
+            );
+    }
+  * dst         = * src;
+  dst->movesets = movesets;
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+rankstore_has( store_t * rankstore, store_key_t key )
+{
+  assert( rankstore != NULL );
+  rankstore_aux_t * rksa = as_rksa( rankstore );
+  uint32_t          pos  = 0;
+
+  if ( key.key_type != STORE_NUM ) return false;
+  if ( ! rankstore_find( rksa, key.data_h0, key.data_q2, & pos ) )
+    {
+      return false;
+    }
+  if ( key.val_type == STORE_PVP_POKEMON_RANKING ) return key.data_q3 == 0;
+  if ( key.val_type == STORE_PVP_MOVE_RANKING )
+    {
+      return key.data_q3 < rksa->mons[rksa->by_key[pos]].nmovesets;
+    }
+  return false;
+}
+
+
+  int
+rankstore_get( store_t * rankstore, store_key_t key, void ** val )
+{
+  assert( rankstore != NULL );
+  rankstore_aux_t * rksa = as_rksa( rankstore );
+  uint32_t          pos  = 0;
+
+  if ( val != NULL ) * val = NULL;
+  if ( ( key.key_type != STORE_NUM ) ||
+       ( ( key.val_type != STORE_PVP_POKEMON_RANKING ) &&
+         ( key.val_type != STORE_PVP_MOVE_RANKING ) )
+     )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( ! rankstore_find( rksa, key.data_h0, key.data_q2, & pos ) )
+    {
+      return STORE_ERROR_NOT_FOUND;
+    }
+
+  pvp_mon_rank_t * mon = rksa->mons + rksa->by_key[pos];
+  if ( key.val_type == STORE_PVP_POKEMON_RANKING )
+    {
+      if ( key.data_q3 != 0 ) return STORE_ERROR_BAD_VALUE;
+      if ( val != NULL ) * val = (void *) mon;
+      return STORE_SUCCESS;
+    }
+
+  if ( mon->nmovesets <= key.data_q3 ) return STORE_ERROR_NOT_FOUND;
+  if ( val != NULL ) * val = (void *) ( mon->movesets + key.data_q3 );
+  return STORE_SUCCESS;
+}
+
+
+  int
+rankstore_get_rank( rankstore_t     *  rankstore,
+                    uint32_t           rank,
+                    pvp_mon_rank_t  ** val
+                  )
+{
+  assert( rankstore != NULL );
+  assert( val != NULL );
+  rankstore_aux_t * rksa = as_rksa( rankstore );
+  if ( rksa->cnt <= rank )
+    {
+      * val = NULL;
+      return STORE_ERROR_NOT_FOUND;
+    }
+  * val = rksa->mons + rank;
+  return STORE_SUCCESS;
+}
+
+
+  int
+rankstore_each( store_t       * rankstore,
+                store_type_t    val_type,
+                store_each_cb   cb,
+                void          * ctx
+              )
+{
+  assert( rankstore != NULL );
+  assert( cb != NULL );
+  rankstore_aux_t * rksa = as_rksa( rankstore );
+  int               rsl  = STORE_SUCCESS;
+
+  if ( ( val_type != STORE_PVP_POKEMON_RANKING ) &&
+       ( val_type != STORE_PVP_MOVE_RANKING )
+     )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  for ( uint32_t r = 0; r < rksa->cnt; r++ )
+    {
+      pvp_mon_rank_t * mon = rksa->mons + r;
+      if ( val_type == STORE_PVP_POKEMON_RANKING )
+        {
+          rsl = cb( ctx,
+                    mon_rank_store_key( mon->dex_number, mon->form_idx ),
+                    mon
+                  );
+          if ( rsl != STORE_SUCCESS ) return rsl;
+          continue;
+        }
+      for ( uint8_t m = 0; m < mon->nmovesets; m++ )
+        {
+          rsl = cb( ctx,
+                    moveset_rank_store_key( mon->dex_number, mon->form_idx,
+                                            m
+                                          ),
+                    mon->movesets + m
+                  );
+          if ( rsl != STORE_SUCCESS ) return rsl;
+        }
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+rankstore_add( store_t * rankstore, store_key_t key, void * val )
+{
+  assert( rankstore != NULL );
+  rankstore_aux_t      * rksa = as_rksa( rankstore );
+  const pvp_mon_rank_t * mon  = (const pvp_mon_rank_t *) val;
+  uint32_t               pos  = 0;
+
+  if ( ( key.key_type != STORE_NUM ) ||
+       ( key.val_type != STORE_PVP_POKEMON_RANKING ) || ( mon == NULL ) ||
+       ( key.data_h0 != mon->dex_number ) || ( key.data_q2 != mon->form_idx )
+     )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( rankstore_find( rksa, mon->dex_number, mon->form_idx, & pos ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  if ( rksa->cnt == rksa->cap )
+    {
+      uint32_t         cap  = ( rksa->cap == 0 ) ? 64 : rksa->cap * 2;
+      pvp_mon_rank_t * mons =
+        realloc( rksa->mons, sizeof( pvp_mon_rank_t ) * cap );
+      if ( mons == NULL ) return STORE_ERROR_NOMEM;
+      rksa->mons = mons;
+      uint32_t * by_key = realloc( rksa->by_key, sizeof( uint32_t ) * cap );
+      if ( by_key == NULL ) return STORE_ERROR_NOMEM;
+      rksa->by_key = by_key;
+      rksa->cap    = cap;
+    }
+
+  int rsl = pvp_mon_rank_copy( rksa->mons + rksa->cnt, mon );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  rksa->mons[rksa->cnt].rank = rksa->cnt;
+
+  memmove( rksa->by_key + pos + 1, rksa->by_key + pos,
+           sizeof( uint32_t ) * ( rksa->cnt - pos )
+         );
+  rksa->by_key[pos] = rksa->cnt;
+  rksa->cnt++;
+  store_touch( rankstore );
+
+  return STORE_SUCCESS;
+}
+
+
+  int
+rankstore_set( store_t * rankstore, store_key_t key, void * val )
+{
+  assert( rankstore != NULL );
+  rankstore_aux_t      * rksa = as_rksa( rankstore );
+  const pvp_mon_rank_t * mon  = (const pvp_mon_rank_t *) val;
+  uint32_t               pos  = 0;
+  pvp_mon_rank_t         copy;
+
+  if ( ( key.key_type != STORE_NUM ) ||
+       ( key.val_type != STORE_PVP_POKEMON_RANKING ) || ( mon == NULL ) ||
+       ( key.data_h0 != mon->dex_number ) || ( key.data_q2 != mon->form_idx )
+     )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( ! rankstore_find( rksa, mon->dex_number, mon->form_idx, & pos ) )
+    {
+      return STORE_ERROR_NOT_FOUND;
+    }
+
+  int rsl = pvp_mon_rank_copy( & copy, mon );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+
+  pvp_mon_rank_t * old = rksa->mons + rksa->by_key[pos];
+  copy.rank = old->rank;
+  free( old->movesets );
+  * old = copy;
+  store_touch( rankstore );
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+struct rankstore_sort_s {
+  float    score;
+  uint32_t entry;
+};
+
+/* Best score first, then in Pokedex order */
+  static int
+rankstore_moveset_cmp( const void * a, const void * b )
+{
+  const struct rankstore_sort_s * sa = (const struct rankstore_sort_s *) a;
+  const struct rankstore_sort_s * sb = (const struct rankstore_sort_s *) b;
+  if ( sa->score != sb->score ) return ( sa->score < sb->score ) ? 1 : -1;
+  return ( sa->entry > sb->entry ) - ( sa->entry < sb->entry );
+}
+
+
+  int
+rankstore_add_ranking( rankstore_t * rankstore, const ranking_t * ranking )
+{
+  assert( rankstore != NULL );
+  assert( ranking != NULL );
+
+  uint32_t                  most   = 0;
+  struct rankstore_sort_s * sorted = NULL;
+  pvp_moveset_rank_t        movesets[RANKSTORE_MAX_MOVESETS];
+  int                       rsl    = STORE_SUCCESS;
+
+  for ( uint32_t s = 0; s < ranking->nspecies; s++ )
+    {
+      most = max( most, ranking->species[s].nentries );
+    }
+  sorted = (struct rankstore_sort_s *)
+    malloc( sizeof( struct rankstore_sort_s ) * max( most, 1 ) );
+  if ( sorted == NULL ) return STORE_ERROR_NOMEM;
+
+  for ( uint32_t r = 0; r < ranking->nspecies; r++ )
+    {
+      const ranking_species_t * species = ranking->species + ranking->order[r];
+      const ranking_entry_t   * best    = ranking->entries + species->best;
+      pvp_mon_rank_t            mon     = {
+        .dex_number = best->dex_number,
+        .form_idx   = best->form_idx,
+        .level      = best->level,
+        .ivs        = ranking->ivs,
+        .score      = best->score,
+        .scenarios  = 0,
+        .nmovesets  = min( species->nentries, RANKSTORE_MAX_MOVESETS ),
+        .movesets   = movesets
+      };
+      memset( mon.scenario_scores, 0, sizeof( mon.scenario_scores ) );
+      for ( uint8_t s = 0; s < ranking->matrix.nscenarios; s++ )
+        {
+          uint8_t sc = ranking->matrix.scenarios[s];
+          mon.scenarios |= matchup_scenario_mask( sc );
+          mon.scenario_scores[sc] = best->scenario_scores[s];
+        }
+
+      /* `ranking_t' keeps movesets in Pokedex order */
+      for ( uint32_t e = 0; e < species->nentries; e++ )
+        {
+          sorted[e].entry = species->first + e;
+          sorted[e].score = ranking->entries[species->first + e].score;
+        }
+      qsort( sorted, species->nentries, sizeof( struct rankstore_sort_s ),
+             rankstore_moveset_cmp
+           );
+      for ( uint8_t m = 0; m < mon.nmovesets; m++ )
+        {
+          const ranking_entry_t * entry = ranking->entries + sorted[m].entry;
+          movesets[m] = (pvp_moveset_rank_t) {
+            .fast_move_id     = entry->fast_move_id,
+            .charged_move_ids = { entry->charged_move_ids[0],
+                                  entry->charged_move_ids[1]
+                                },
+            .score            = entry->score
+          };
+        }
+
+      rsl = rankstore_add( rankstore,
+                           mon_rank_store_key( mon.dex_number, mon.form_idx ),
+                           & mon
+                         );
+      if ( rsl != STORE_SUCCESS ) break;
+    }
+
+  free( sorted );
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
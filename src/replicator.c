@@ -0,0 +1,541 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "matchup.h"
+#include "replicator.h"
+#include "store.h"
+#include "util/files.h"
+#include "util/macros.h"
+#include "util/parallel.h"
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+#define REPLICATOR_MAGIC  "CPKRPLC"
+
+/* Partial sums per row, 8 floats fill an AVX register */
+#define REPLICATOR_LANES  8
+
+struct replicator_header_s {
+  char     magic[8];
+  uint32_t n;
+  uint32_t generation;
+  uint32_t ncheckpoints;
+  uint32_t converged;
+};
+typedef struct replicator_header_s  replicator_header_t;
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Collect the species with usage left, and pack their payoffs together from
+ * the full matrix.
+ */
+  static void
+replicator_pack( replicator_t * rep )
+{
+  uint32_t na = 0;
+  for ( uint32_t i = 0; i < rep->n; i++ )
+    {
+      if ( 0.0 < rep->usage[i] ) rep->active[na++] = i;
+    }
+  rep->nactive = na;
+  for ( uint32_t k = 0; k < na; k++ )
+    {
+      const float * src = rep->payoff + (size_t) rep->active[k] * rep->n;
+      float       * dst = rep->dense + (size_t) k * na;
+      for ( uint32_t l = 0; l < na; l++ )
+        {
+          dst[l] = src[rep->active[l]];
+        }
+    }
+}
+
+
+/**
+ * Drop the species whose usage just went to 0.
+ * Packed rows and columns only move towards the front, so this is done in
+ * place.
+ */
+  static void
+replicator_compact( replicator_t * rep )
+{
+  const uint32_t   na   = rep->nactive;
+  uint32_t       * keep = rep->active;  /* Reused, `k <= keep[k]' */
+  uint32_t         nk   = 0;
+
+  for ( uint32_t k = 0; k < na; k++ )
+    {
+      if ( 0.0 < rep->usage[rep->active[k]] ) keep[nk++] = k;
+    }
+  for ( uint32_t k = 0; k < nk; k++ )
+    {
+      const float * src = rep->dense + (size_t) keep[k] * na;
+      float       * dst = rep->dense + (size_t) k * nk;
+      for ( uint32_t l = 0; l < nk; l++ )
+        {
+          dst[l] = src[keep[l]];
+        }
+    }
+  /* `keep' holds packed indices, turn them back into species */
+  uint32_t k = 0;
+  for ( uint32_t i = 0; i < rep->n; i++ )
+    {
+      if ( 0.0 < rep->usage[i] ) rep->active[k++] = i;
+    }
+  assert( k == nk );
+  rep->nactive = nk;
+}
+
+
+  static int
+replicator_checkpoint_add( replicator_t * rep )
+{
+  if ( rep->ncheckpoints == rep->checkpoint_cap )
+    {
+      uint32_t cap = max( rep->checkpoint_cap * 2, 16 );
+      uint32_t * gens = (uint32_t *)
+        realloc( rep->checkpoint_gens, sizeof( uint32_t ) * cap );
+      if ( gens == NULL ) return STORE_ERROR_NOMEM;
+      rep->checkpoint_gens = gens;
+      float * usage = (float *)
+        realloc( rep->checkpoints, sizeof( float ) * cap * (size_t) rep->n );
+      if ( usage == NULL ) return STORE_ERROR_NOMEM;
+      rep->checkpoints    = usage;
+      rep->checkpoint_cap = cap;
+    }
+  rep->checkpoint_gens[rep->ncheckpoints] = rep->generation;
+  memcpy( rep->checkpoints + (size_t) rep->ncheckpoints * rep->n, rep->usage,
+          sizeof( float ) * rep->n
+        );
+  rep->ncheckpoints++;
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+replicator_init( replicator_t            * rep,
+                 const matchup_matrix_t  * matrix,
+                 const uint32_t          * rows,
+                 const float             * usage,
+                 const replicator_opts_t * opts
+               )
+{
+  assert( rep != NULL );
+  assert( matrix != NULL );
+
+  const replicator_opts_t defaults = REPLICATOR_OPTS_DEFAULT;
+  if ( opts == NULL ) opts = & defaults;
+  assert( ( 0.0 < opts->rate ) && ( opts->rate <= 1.0 ) );
+
+  * rep      = (replicator_t) REPLICATOR_INIT;
+  rep->opts  = * opts;
+
+  const uint32_t n = matrix->ncols;
+  uint8_t        scenarios[MATCHUP_NSCENARIOS];
+  uint8_t        nscenarios = 0;
+  for ( uint8_t s = 0; s < matrix->nscenarios; s++ )
+    {
+      if ( opts->scenarios & matchup_scenario_mask( matrix->scenarios[s] ) )
+        {
+          scenarios[nscenarios++] = s;
+        }
+    }
+  if ( ( nscenarios == 0 ) || ( n == 0 ) ) return STORE_ERROR_BAD_VALUE;
+  if ( ( rows == NULL ) && ( matrix->nrows != n ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  rep->n       = n;
+  rep->payoff  = (float *) malloc( sizeof( float ) * n * (size_t) n );
+  rep->dense   = (float *) malloc( sizeof( float ) * n * (size_t) n );
+  rep->usage   = (float *) malloc( sizeof( float ) * n );
+  rep->fitness = (float *) calloc( n, sizeof( float ) );
+  rep->scratch = (float *) malloc( sizeof( float ) * 2 * (size_t) n );
+  rep->active  = (uint32_t *) malloc( sizeof( uint32_t ) * n );
+  if ( ( rep->payoff == NULL ) || ( rep->dense == NULL ) ||
+       ( rep->usage == NULL ) || ( rep->fitness == NULL ) ||
+       ( rep->scratch == NULL ) || ( rep->active == NULL ) )
+    {
+      replicator_free( rep );
+      return STORE_ERROR_NOMEM;
+    }
+
+  const float scale = 1.0 / ( (float) MATCHUP_RATING_MAX * nscenarios );
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      uint32_t   row = ( rows == NULL ) ? i : rows[i];
+      float    * dst = rep->payoff + (size_t) i * n;
+      assert( row < matrix->nrows );
+      for ( uint32_t j = 0; j < n; j++ )
+        {
+          uint32_t sum = 0;
+          for ( uint8_t s = 0; s < nscenarios; s++ )
+            {
+              sum += matchup_matrix_get( matrix, row, scenarios[s], j );
+            }
+          dst[j] = sum * scale;
+        }
+    }
+
+  double total = 0.0;
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      float u = ( usage == NULL ) ? 1.0 : usage[i];
+      rep->usage[i] = ( 0.0 < u ) ? u : 0.0;
+      total += rep->usage[i];
+    }
+  if ( ! ( 0.0 < total ) || isinf( total ) )
+    {
+      replicator_free( rep );
+      return STORE_ERROR_BAD_VALUE;
+    }
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      rep->usage[i] = rep->usage[i] / total;
+    }
+  replicator_pack( rep );
+
+  if ( ( 0 < opts->checkpoint_every ) &&
+       ( replicator_checkpoint_add( rep ) != STORE_SUCCESS ) )
+    {
+      replicator_free( rep );
+      return STORE_ERROR_NOMEM;
+    }
+  return STORE_SUCCESS;
+}
+
+
+  void
+replicator_free( replicator_t * rep )
+{
+  assert( rep != NULL );
+  free( rep->payoff );
+  free( rep->dense );
+  free( rep->usage );
+  free( rep->fitness );
+  free( rep->scratch );
+  free( rep->active );
+  free( rep->checkpoint_gens );
+  free( rep->checkpoints );
+  * rep = (replicator_t) REPLICATOR_INIT;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+struct replicator_job_s {
+  const float * dense;
+  const float * usage;
+  float       * fitness;
+  uint32_t      n;
+};
+typedef struct replicator_job_s  replicator_job_t;
+
+
+/**
+ * Fitness of packed rows `begin' to `end', a tile of columns at a time so
+ * the usage being summed against stays in cache across the rows.
+ * Sums are split over `REPLICATOR_LANES' partial sums, which the compiler can
+ * keep in one vector register without reordering any additions.
+ * Each row is only ever summed by one thread, in the same order, so results
+ * don't depend on the thread count.
+ */
+  static void
+replicator_fitness_rows( void     * ctx,
+                         uint32_t   begin,
+                         uint32_t   end,
+                         uint32_t   thread
+                       )
+{
+  const replicator_job_t * job = (const replicator_job_t *) ctx;
+
+  for ( uint32_t k = begin; k < end; k++ ) job->fitness[k] = 0.0;
+  for ( uint32_t c = 0; c < job->n; c += REPLICATOR_TILE_COLS )
+    {
+      const uint32_t         len  = min( job->n - c, REPLICATOR_TILE_COLS );
+      const uint32_t         body = len - len % REPLICATOR_LANES;
+      const float * restrict x    = job->usage + c;
+      for ( uint32_t k = begin; k < end; k++ )
+        {
+          const float * restrict p = job->dense + (size_t) k * job->n + c;
+          float acc[REPLICATOR_LANES] = { 0.0 };
+          for ( uint32_t l = 0; l < body; l += REPLICATOR_LANES )
+            {
+              for ( uint32_t v = 0; v < REPLICATOR_LANES; v++ )
+                {
+                  acc[v] += p[l + v] * x[l + v];
+                }
+            }
+          for ( uint32_t l = body; l < len; l++ )
+            {
+              acc[l - body] += p[l] * x[l];
+            }
+          float sum = 0.0;
+          for ( uint32_t v = 0; v < REPLICATOR_LANES; v++ ) sum += acc[v];
+          job->fitness[k] += sum;
+        }
+    }
+}
+
+
+/**
+ * Grow each of the `x' in play by its fitness `f' against the mean `fbar',
+ * dropping the extinct unless that would drop them all.
+ * Returns how far usage moved, in L1.
+ */
+  static double
+replicator_update( replicator_t * rep, float * x, const float * f, double fbar )
+{
+  const uint32_t na    = rep->nactive;
+  const double   rate  = rep->opts.rate;
+  double         total = 0.0;
+  double         kept  = 0.0;
+
+  for ( uint32_t k = 0; k < na; k++ )
+    {
+      x[k]   = x[k] * ( ( 1.0 - rate ) + rate * f[k] / fbar );
+      total += x[k];
+      if ( rep->opts.extinct <= x[k] ) kept += x[k];
+    }
+  const float cutoff = ( 0.0 < kept ) ? rep->opts.extinct : 0.0;
+  if ( 0.0 < kept ) total = kept;
+
+  bool   culled = false;
+  double delta  = 0.0;
+  for ( uint32_t k = 0; k < na; k++ )
+    {
+      float * u    = rep->usage + rep->active[k];
+      float   next = ( cutoff <= x[k] ) ? (float) ( x[k] / total ) : 0.0;
+      delta  += fabs( (double) next - * u );
+      culled |= ( next == 0.0 );
+      * u     = next;
+    }
+  if ( culled ) replicator_compact( rep );
+  return delta;
+}
+
+
+/**
+ * Run one generation.
+ * Returns 1 if usage moved no more than `tolerance', 0 if it did, or -1 if
+ * memory ran out.
+ */
+  static int
+replicator_step( replicator_t * rep )
+{
+  const uint32_t   na  = rep->nactive;
+  float          * x   = rep->scratch;
+  float          * f   = rep->scratch + na;
+  replicator_job_t job = {
+    .dense = rep->dense, .usage = x, .fitness = f, .n = na
+  };
+
+  for ( uint32_t k = 0; k < na; k++ ) x[k] = rep->usage[rep->active[k]];
+  if ( parallel_for( na, REPLICATOR_TILE_ROWS, rep->opts.nthreads,
+                     replicator_fitness_rows, & job
+                   ) != 0 )
+    {
+      return -1;
+    }
+
+  double fbar = 0.0;
+  for ( uint32_t k = 0; k < na; k++ )
+    {
+      rep->fitness[rep->active[k]] = f[k];
+      fbar += (double) x[k] * f[k];
+    }
+  /* When nobody scores anything, nobody grows */
+  double delta = ( 0.0 < fbar ) ? replicator_update( rep, x, f, fbar ) : 0.0;
+
+  rep->generation++;
+  if ( ( 0 < rep->opts.checkpoint_every ) &&
+       ( rep->generation % rep->opts.checkpoint_every == 0 ) &&
+       ( replicator_checkpoint_add( rep ) != STORE_SUCCESS ) )
+    {
+      return -1;
+    }
+  return ( delta <= rep->opts.tolerance ) ? 1 : 0;
+}
+
+
+  int
+replicator_run( replicator_t * rep, uint32_t ngenerations )
+{
+  assert( rep != NULL );
+  assert( rep->usage != NULL );
+
+  uint32_t g = 0;
+  while ( ( g < ngenerations ) && ( ! rep->converged ) )
+    {
+      int rsl = replicator_step( rep );
+      if ( rsl < 0 ) return -1;
+      g++;
+      rep->converged = ( rsl == 1 );
+    }
+  return (int) g;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static int
+replicator_write( const replicator_t * rep, FILE * ostream )
+{
+  replicator_header_t header = {
+    .magic        = REPLICATOR_MAGIC,
+    .n            = rep->n,
+    .generation   = rep->generation,
+    .ncheckpoints = rep->ncheckpoints,
+    .converged    = rep->converged
+  };
+  const size_t nsaved = (size_t) rep->ncheckpoints * rep->n;
+
+  if ( ( fwrite( & header, sizeof( header ), 1, ostream ) != 1 ) ||
+       ( fwrite( rep->usage, sizeof( float ), rep->n, ostream ) != rep->n ) ||
+       ( fwrite( rep->checkpoint_gens, sizeof( uint32_t ), rep->ncheckpoints,
+                 ostream
+               ) != rep->ncheckpoints ) ||
+       ( fwrite( rep->checkpoints, sizeof( float ), nsaved, ostream ) !=
+         nsaved ) )
+    {
+      return STORE_ERROR_FAIL;
+    }
+  return STORE_SUCCESS;
+}
+
+
+  static int
+replicator_fwrite( FILE * ostream, const void * rep )
+{
+  return replicator_write( (const replicator_t *) rep, ostream );
+}
+
+
+  int
+replicator_save( const replicator_t * rep, const char * fpath )
+{
+  assert( rep != NULL );
+  assert( fpath != NULL );
+  return fwrite_atomic( fpath, replicator_fwrite, rep );
+}
+
+
+  static int
+replicator_read( replicator_t * rep, FILE * istream, size_t size )
+{
+  replicator_header_t   header;
+  float               * usage = NULL;
+  uint32_t            * gens  = NULL;
+  float               * saved = NULL;
+  int                   rsl   = STORE_ERROR_BAD_VALUE;
+
+  if ( ( fread( & header, sizeof( header ), 1, istream ) != 1 ) ||
+       ( memcmp( header.magic, REPLICATOR_MAGIC, sizeof( header.magic ) )
+         != 0 ) ||
+       ( header.n != rep->n ) ||
+       ( size != sizeof( header ) + sizeof( float ) * (uint64_t) rep->n +
+                 ( sizeof( uint32_t ) + sizeof( float ) * (uint64_t) rep->n ) *
+                 header.ncheckpoints ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  const size_t nsaved = (size_t) header.ncheckpoints * rep->n;
+  usage = (float *) malloc( sizeof( float ) * rep->n );
+  gens  = (uint32_t *) malloc( sizeof( uint32_t ) *
+                               max( header.ncheckpoints, 1 ) );
+  saved = (float *) malloc( sizeof( float ) * max( nsaved, 1 ) );
+  if ( ( usage == NULL ) || ( gens == NULL ) || ( saved == NULL ) )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+  if ( ( fread( usage, sizeof( float ), rep->n, istream ) != rep->n ) ||
+       ( fread( gens, sizeof( uint32_t ), header.ncheckpoints, istream ) !=
+         header.ncheckpoints ) ||
+       ( fread( saved, sizeof( float ), nsaved, istream ) != nsaved ) )
+    {
+      goto done;
+    }
+
+  double total = 0.0;
+  for ( uint32_t i = 0; i < rep->n; i++ )
+    {
+      if ( ! ( 0.0 <= usage[i] ) || isinf( usage[i] ) ) goto done;
+      total += usage[i];
+    }
+  if ( ! ( 0.0 < total ) ) goto done;
+
+  free( rep->usage );
+  free( rep->checkpoint_gens );
+  free( rep->checkpoints );
+  rep->usage           = usage;
+  rep->checkpoint_gens = gens;
+  rep->checkpoints     = saved;
+  rep->ncheckpoints    = header.ncheckpoints;
+  rep->checkpoint_cap  = max( header.ncheckpoints, 1 );
+  rep->generation      = header.generation;
+  rep->converged       = ( header.converged != 0 );
+  usage = NULL;
+  gens  = NULL;
+  saved = NULL;
+  memset( rep->fitness, 0, sizeof( float ) * rep->n );
+  replicator_pack( rep );
+  rsl = STORE_SUCCESS;
+
+done:
+  free( usage );
+  free( gens );
+  free( saved );
+  return rsl;
+}
+
+
+  int
+replicator_load( replicator_t * rep, const char * fpath )
+{
+  assert( rep != NULL );
+  assert( rep->usage != NULL );
+  assert( fpath != NULL );
+
+  struct stat st;
+  FILE * istream = fopen( fpath, "rb" );
+  if ( istream == NULL )
+    {
+      if ( errno == ENOENT ) return STORE_ERROR_NOT_FOUND;
+      perror( __func__ );
+      return STORE_ERROR_FAIL;
+    }
+  int rsl = STORE_ERROR_BAD_VALUE;
+  if ( fstat( fileno( istream ), & st ) == 0 )
+    {
+      rsl = replicator_read( rep, istream, (size_t) st.st_size );
+    }
+  fclose( istream );
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
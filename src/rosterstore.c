@@ -0,0 +1,678 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "parse_csv.h"
+#include "pokedex.h"
+#include "pokemon.h"
+#include "rosterstore.h"
+#include "store.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+#define NUM_IV_COMBOS  4096
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+rosterstore_init( store_t * rosterstore, void * base )
+{
+  assert( rosterstore != NULL );
+  assert( base != NULL );
+
+  rosterstore->aux = calloc( 1, sizeof( rosterstore_aux_t ) );
+  if ( rosterstore->aux == NULL ) return STORE_ERROR_NOMEM;
+  as_rsa( rosterstore )->base = (store_t *) base;
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static void
+roster_index_free( roster_index_t * idx )
+{
+  free( idx->keys );
+  free( idx->offsets );
+  free( idx->rows );
+  memset( idx, 0, sizeof( roster_index_t ) );
+}
+
+
+/* Drop indices and built rows after a modification. */
+  static void
+rosterstore_invalidate( rosterstore_aux_t * rsa )
+{
+  roster_index_free( & rsa->by_species );
+  roster_index_free( & rsa->by_family );
+  roster_index_free( & rsa->by_move );
+  rsa->indexed = false;
+  free( rsa->rows );
+  free( rsa->bases );
+  free( rsa->built );
+  rsa->rows  = NULL;
+  rsa->bases = NULL;
+  rsa->built = NULL;
+}
+
+
+  void
+rosterstore_free( store_t * rosterstore )
+{
+  assert( rosterstore != NULL );
+  rosterstore_aux_t * rsa = as_rsa( rosterstore );
+  if ( rsa == NULL ) return;
+
+  rosterstore_invalidate( rsa );
+  free( rsa->dex );
+  free( rsa->form );
+  free( rsa->lvi );
+  free( rsa->ivs );
+  free( rsa->fast );
+  free( rsa->charged1 );
+  free( rsa->charged2 );
+  free( rsa );
+  rosterstore->aux = NULL;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#define rs_grow_column( COL, CAP )                                            \
+  do {                                                                        \
+    void * _tmp = realloc( ( COL ), sizeof( *( COL ) ) * ( CAP ) );           \
+    if ( _tmp == NULL ) return STORE_ERROR_NOMEM;                             \
+    ( COL ) = _tmp;                                                           \
+  } while ( 0 )
+
+  static int
+rosterstore_reserve( rosterstore_aux_t * rsa, uint32_t n )
+{
+  if ( n <= rsa->cap ) return STORE_SUCCESS;
+  uint32_t cap = max( n, max( rsa->cap * 2, 64 ) );
+  rs_grow_column( rsa->dex, cap );
+  rs_grow_column( rsa->form, cap );
+  rs_grow_column( rsa->lvi, cap );
+  rs_grow_column( rsa->ivs, cap );
+  rs_grow_column( rsa->fast, cap );
+  rs_grow_column( rsa->charged1, cap );
+  rs_grow_column( rsa->charged2, cap );
+  rsa->cap = cap;
+  return STORE_SUCCESS;
+}
+
+#undef rs_grow_column
+
+
+  static int
+rosterstore_put( rosterstore_aux_t * rsa,
+                 uint32_t            row,
+                 roster_pokemon_t  * rmon
+               )
+{
+  if ( ( rmon->base == NULL ) || ( rmon->base->pdex_mon == NULL ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  const base_pokemon_t * base = rmon->base;
+
+  rsa->dex[row]      = base->pdex_mon->dex_number;
+  rsa->form[row]     = base->pdex_mon->form_idx;
+  rsa->lvi[row]      = (uint8_t) ( ( base->level - 1.0 ) * 2 );
+  rsa->ivs[row]      = rosterstore_ivs_pack( base->ivs );
+  rsa->fast[row]     = rmon->fast_move_id;
+  rsa->charged1[row] = rmon->charged_move_ids[0];
+  rsa->charged2[row] = rmon->charged_move_ids[1];
+  rosterstore_invalidate( rsa );
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static inline bool
+rosterstore_key_ok( rosterstore_aux_t * rsa, store_key_t key )
+{
+  return ( key.key_type == STORE_NUM ) && ( key.val_type == STORE_ROSTER ) &&
+         ( key.data_f < rsa->cnt );
+}
+
+
+  bool
+rosterstore_has( store_t * rosterstore, store_key_t key )
+{
+  assert( rosterstore != NULL );
+  return rosterstore_key_ok( as_rsa( rosterstore ), key );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+rosterstore_get( store_t * rosterstore, store_key_t key, void ** val )
+{
+  assert( rosterstore != NULL );
+  rosterstore_aux_t * rsa = as_rsa( rosterstore );
+  uint32_t            row = key.data_f;
+
+  if ( val != NULL ) *val = NULL;
+  if ( ( key.key_type != STORE_NUM ) || ( key.val_type != STORE_ROSTER ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( rsa->cnt <= row ) return STORE_ERROR_NOT_FOUND;
+  if ( val == NULL ) return STORE_SUCCESS;
+
+  if ( rsa->rows == NULL )
+    {
+      rsa->rows  = (roster_pokemon_t *) malloc( sizeof( roster_pokemon_t ) *
+                                                rsa->cnt
+                                              );
+      rsa->bases = (base_pokemon_t *) malloc( sizeof( base_pokemon_t ) *
+                                              rsa->cnt
+                                            );
+      rsa->built = (uint64_t *) calloc( ( rsa->cnt + 63 ) / 64,
+                                        sizeof( uint64_t )
+                                      );
+      if ( ( rsa->rows == NULL ) || ( rsa->bases == NULL ) ||
+           ( rsa->built == NULL ) )
+        {
+          rosterstore_invalidate( rsa );
+          return STORE_ERROR_NOMEM;
+        }
+    }
+
+  if ( ! ( rsa->built[row / 64] & ( ( (uint64_t) 1 ) << ( row % 64 ) ) ) )
+    {
+      base_pokemon_t * base = rsa->bases + row;
+      int rsl = rsa->base->get( rsa->base,
+                                dex_form_store_key( rsa->dex[row],
+                                                    rsa->form[row]
+                                                  ),
+                                (void **) & base->pdex_mon
+                              );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+      base->level = ( rsa->lvi[row] / 2.0 ) + 1.0;
+      base->ivs   = rosterstore_ivs_unpack( rsa->ivs[row] );
+      rsa->rows[row].base                = base;
+      rsa->rows[row].fast_move_id        = rsa->fast[row];
+      rsa->rows[row].charged_move_ids[0] = rsa->charged1[row];
+      rsa->rows[row].charged_move_ids[1] = rsa->charged2[row];
+      rsa->built[row / 64] |= ( (uint64_t) 1 ) << ( row % 64 );
+    }
+
+  *val = (void *) ( rsa->rows + row );
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+rosterstore_each( store_t       * rosterstore,
+                  store_type_t    val_type,
+                  store_each_cb   cb,
+                  void          * ctx
+                )
+{
+  assert( rosterstore != NULL );
+  assert( cb != NULL );
+
+  if ( val_type != STORE_ROSTER ) return STORE_ERROR_BAD_VALUE;
+
+  for ( uint32_t i = 0; i < as_rsa( rosterstore )->cnt; i++ )
+    {
+      void        * val = NULL;
+      store_key_t   key = roster_row_store_key( i );
+      int           rsl = rosterstore_get( rosterstore, key, & val );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+      rsl = cb( ctx, key, val );
+      if ( rsl != STORE_SUCCESS ) return rsl;
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+rosterstore_add( store_t * rosterstore, store_key_t key, void * val )
+{
+  assert( rosterstore != NULL );
+  rosterstore_aux_t * rsa = as_rsa( rosterstore );
+
+  if ( ( key.key_type != STORE_NUM ) || ( key.val_type != STORE_ROSTER ) ||
+       ( key.data_f != rsa->cnt ) || ( val == NULL )
+     )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  int rsl = rosterstore_reserve( rsa, rsa->cnt + 1 );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+  rsl = rosterstore_put( rsa, rsa->cnt, (roster_pokemon_t *) val );
+  if ( rsl == STORE_SUCCESS )
+    {
+      rsa->cnt++;
+      store_touch( rosterstore );
+    }
+
+  return rsl;
+}
+
+
+  int
+rosterstore_set( store_t * rosterstore, store_key_t key, void * val )
+{
+  assert( rosterstore != NULL );
+  rosterstore_aux_t * rsa = as_rsa( rosterstore );
+
+  if ( val == NULL ) return STORE_ERROR_BAD_VALUE;
+  if ( ! rosterstore_key_ok( rsa, key ) ) return STORE_ERROR_NOT_FOUND;
+
+  int rsl = rosterstore_put( rsa, key.data_f, (roster_pokemon_t *) val );
+  if ( rsl == STORE_SUCCESS ) store_touch( rosterstore );
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+rosterstore_add_roster( rosterstore_t * rosterstore, roster_t * roster )
+{
+  assert( rosterstore != NULL );
+  assert( roster != NULL );
+  rosterstore_aux_t * rsa = as_rsa( rosterstore );
+
+  int rsl = rosterstore_reserve( rsa, rsa->cnt + roster->roster_length );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+
+  for ( size_t i = 0; i < roster->roster_length; i++ )
+    {
+      rsl = rosterstore_put( rsa, rsa->cnt, roster->roster_pokemon + i );
+      if ( rsl != STORE_SUCCESS ) break;
+      rsa->cnt++;
+    }
+  store_touch( rosterstore );
+
+  return rsl;
+}
+
+
+  static int
+rosterstore_import( rosterstore_t * rosterstore,
+                    const char    * fpath,
+                    int ( * parse )( const char *, store_t *, roster_t * )
+                  )
+{
+  assert( rosterstore != NULL );
+  assert( fpath != NULL );
+
+  roster_t roster = { .roster_pokemon = NULL, .roster_length = 0 };
+  int      rsl    = parse( fpath, as_rsa( rosterstore )->base, & roster );
+  if ( rsl == STORE_SUCCESS )
+    {
+      rsl = rosterstore_add_roster( rosterstore, & roster );
+    }
+  roster_free( & roster );
+
+  return rsl;
+}
+
+
+  int
+rosterstore_import_calcy( rosterstore_t * rosterstore, const char * fpath )
+{
+  return rosterstore_import( rosterstore, fpath, parse_calcy_roster );
+}
+
+
+  int
+rosterstore_import_pokebattler( rosterstore_t * rosterstore,
+                                const char    * fpath
+                              )
+{
+  return rosterstore_import( rosterstore, fpath, parse_csv_roster );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Pairs are packed as `key << 32 | row' so sorting groups them by key. */
+  static int
+cmp_u64( const void * a, const void * b )
+{
+  uint64_t x = * (const uint64_t *) a;
+  uint64_t y = * (const uint64_t *) b;
+  return ( x > y ) - ( x < y );
+}
+
+
+  static int
+roster_index_build( roster_index_t * idx, uint64_t * pairs, uint32_t npairs )
+{
+  qsort( pairs, npairs, sizeof( uint64_t ), cmp_u64 );
+
+  uint32_t nkeys = 0;
+  for ( uint32_t i = 0; i < npairs; i++ )
+    {
+      if ( ( i == 0 ) || ( ( pairs[i] >> 32 ) != ( pairs[i - 1] >> 32 ) ) )
+        {
+          nkeys++;
+        }
+    }
+
+  idx->keys    = (uint16_t *) malloc( sizeof( uint16_t ) * max( nkeys, 1 ) );
+  idx->offsets = (uint32_t *) malloc( sizeof( uint32_t ) * ( nkeys + 1 ) );
+  idx->rows    = (uint32_t *) malloc( sizeof( uint32_t ) * max( npairs, 1 ) );
+  if ( ( idx->keys == NULL ) || ( idx->offsets == NULL ) ||
+       ( idx->rows == NULL ) )
+    {
+      roster_index_free( idx );
+      return STORE_ERROR_NOMEM;
+    }
+
+  idx->nkeys = 0;
+  for ( uint32_t i = 0; i < npairs; i++ )
+    {
+      if ( ( i == 0 ) || ( ( pairs[i] >> 32 ) != ( pairs[i - 1] >> 32 ) ) )
+        {
+          idx->keys[idx->nkeys]    = (uint16_t) ( pairs[i] >> 32 );
+          idx->offsets[idx->nkeys] = i;
+          idx->nkeys++;
+        }
+      idx->rows[i] = (uint32_t) pairs[i];
+    }
+  idx->offsets[nkeys] = npairs;
+
+  return STORE_SUCCESS;
+}
+
+
+  static int
+rosterstore_index( rosterstore_aux_t * rsa )
+{
+  if ( rsa->indexed ) return STORE_SUCCESS;
+
+  uint32_t     n     = rsa->cnt;
+  uint64_t   * pairs = (uint64_t *) malloc( sizeof( uint64_t ) *
+                                            max( 3 * n, 1 )
+                                          );
+  pdex_mon_t * mon   = NULL;
+  uint32_t     np    = 0;
+  int          rsl   = STORE_SUCCESS;
+  if ( pairs == NULL ) return STORE_ERROR_NOMEM;
+
+#define rs_pair( KEY, ROW )  ( ( ( (uint64_t) ( KEY ) ) << 32 ) | ( ROW ) )
+
+  for ( uint32_t i = 0; i < n; i++ ) pairs[i] = rs_pair( rsa->dex[i], i );
+  rsl = roster_index_build( & rsa->by_species, pairs, n );
+
+  for ( uint32_t i = 0; ( i < n ) && ( rsl == STORE_SUCCESS ); i++ )
+    {
+      rsl = rsa->base->get( rsa->base,
+                            dex_form_store_key( rsa->dex[i], rsa->form[i] ),
+                            (void **) & mon
+                          );
+      pairs[i] = rs_pair( ( rsl == STORE_SUCCESS ) ? mon->family : 0, i );
+    }
+  if ( rsl == STORE_SUCCESS )
+    {
+      rsl = roster_index_build( & rsa->by_family, pairs, n );
+    }
+
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      pairs[np++] = rs_pair( rsa->fast[i], i );
+      pairs[np++] = rs_pair( rsa->charged1[i], i );
+      if ( ( rsa->charged2[i] != 0 ) &&
+           ( rsa->charged2[i] != rsa->charged1[i] ) )
+        {
+          pairs[np++] = rs_pair( rsa->charged2[i], i );
+        }
+    }
+  if ( rsl == STORE_SUCCESS )
+    {
+      rsl = roster_index_build( & rsa->by_move, pairs, np );
+    }
+
+#undef rs_pair
+
+  free( pairs );
+  if ( rsl != STORE_SUCCESS )
+    {
+      rosterstore_invalidate( rsa );
+      return rsl;
+    }
+  rsa->indexed = true;
+
+  return STORE_SUCCESS;
+}
+
+
+  static int
+roster_index_find( rosterstore_aux_t *  rsa,
+                   roster_index_t    *  idx,
+                   uint16_t             key,
+                   const uint32_t    ** rows,
+                   uint32_t          *  nrows
+                 )
+{
+  assert( rows != NULL );
+  assert( nrows != NULL );
+
+  *rows  = NULL;
+  *nrows = 0;
+  int rsl = rosterstore_index( rsa );
+  if ( rsl != STORE_SUCCESS ) return rsl;
+
+  uint32_t lo = 0;
+  uint32_t hi = idx->nkeys;
+  while ( lo < hi )
+    {
+      uint32_t mid = ( lo + hi ) / 2;
+      if ( idx->keys[mid] < key ) lo = mid + 1;
+      else                        hi = mid;
+    }
+  if ( ( lo == idx->nkeys ) || ( idx->keys[lo] != key ) )
+    {
+      return STORE_ERROR_NOT_FOUND;
+    }
+
+  *rows  = idx->rows + idx->offsets[lo];
+  *nrows = idx->offsets[lo + 1] - idx->offsets[lo];
+  return STORE_SUCCESS;
+}
+
+
+  int
+rosterstore_rows_by_species( rosterstore_t   *  rosterstore,
+                             uint16_t           dex_num,
+                             const uint32_t  ** rows,
+                             uint32_t        *  nrows
+                           )
+{
+  assert( rosterstore != NULL );
+  rosterstore_aux_t * rsa = as_rsa( rosterstore );
+  return roster_index_find( rsa, & rsa->by_species, dex_num, rows, nrows );
+}
+
+
+  int
+rosterstore_rows_by_family( rosterstore_t   *  rosterstore,
+                            uint16_t           family,
+                            const uint32_t  ** rows,
+                            uint32_t        *  nrows
+                          )
+{
+  assert( rosterstore != NULL );
+  rosterstore_aux_t * rsa = as_rsa( rosterstore );
+  return roster_index_find( rsa, & rsa->by_family, family, rows, nrows );
+}
+
+
+  int
+rosterstore_rows_by_move( rosterstore_t   *  rosterstore,
+                          uint16_t           move_id,
+                          const uint32_t  ** rows,
+                          uint32_t        *  nrows
+                        )
+{
+  assert( rosterstore != NULL );
+  rosterstore_aux_t * rsa = as_rsa( rosterstore );
+  return roster_index_find( rsa, & rsa->by_move, move_id, rows, nrows );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+struct iv_product_s {
+  double   product;
+  uint16_t ivs;
+};
+
+  static int
+cmp_iv_product( const void * a, const void * b )
+{
+  double x = ( (const struct iv_product_s *) a )->product;
+  double y = ( (const struct iv_product_s *) b )->product;
+  return ( x < y ) - ( x > y );
+}
+
+
+  void
+rank_ivs_stat_product( const pdex_mon_t * mon,
+                       uint16_t           cp_cap,
+                       uint16_t         * ranks
+                     )
+{
+  assert( mon != NULL );
+  assert( ranks != NULL );
+
+  struct iv_product_s products[NUM_IV_COMBOS];
+  const stats_t       base = mon->base_stats;
+
+  for ( uint16_t i = 0; i < NUM_IV_COMBOS; i++ )
+    {
+      stats_t ivs = rosterstore_ivs_unpack( i );
+      products[i].ivs     = i;
+      products[i].product = 0.0;
+
+      float level = get_max_level_for_cp( base, ivs, cp_cap );
+      if ( level == 0.0 ) continue;
+
+      double cpm = get_cpm_for_level( level );
+      products[i].product = ( base.attack + ivs.attack ) * cpm *
+                            ( base.defense + ivs.defense ) * cpm *
+                            floor( ( base.stamina + ivs.stamina ) * cpm );
+    }
+
+  qsort( products, NUM_IV_COMBOS, sizeof( products[0] ), cmp_iv_product );
+
+  /* Ties share a rank */
+  uint16_t rank = 1;
+  for ( uint16_t i = 0; i < NUM_IV_COMBOS; i++ )
+    {
+      if ( ( 0 < i ) && ( products[i].product != products[i - 1].product ) )
+        {
+          rank = i + 1;
+        }
+      ranks[products[i].ivs] = ( products[i].product == 0.0 ) ? 0 : rank;
+    }
+}
+
+
+  uint32_t
+rosterstore_query_iv_rank( rosterstore_t * rosterstore,
+                           uint16_t        cp_cap,
+                           uint16_t        max_rank,
+                           uint32_t      * rows,
+                           uint32_t        nrows
+                         )
+{
+  assert( rosterstore != NULL );
+  assert( ( rows != NULL ) || ( nrows == 0 ) );
+
+  rosterstore_aux_t * rsa   = as_rsa( rosterstore );
+  uint32_t            found = 0;
+  uint16_t            ranks[NUM_IV_COMBOS];
+  pdex_mon_t        * mon   = NULL;
+
+  if ( rsa->cnt == 0 ) return 0;
+  if ( rosterstore_index( rsa ) != STORE_SUCCESS ) return 0;
+
+  uint64_t * match = (uint64_t *) calloc( ( rsa->cnt + 63 ) / 64,
+                                          sizeof( uint64_t )
+                                        );
+  if ( match == NULL ) return 0;
+
+  /* Walk each species' rows once per form, ranking that form's IVs once */
+  roster_index_t * idx = & rsa->by_species;
+  for ( uint32_t k = 0; k < idx->nkeys; k++ )
+    {
+      uint32_t begin = idx->offsets[k];
+      uint32_t end   = idx->offsets[k + 1];
+      uint64_t done  = 0;  /* Forms already ranked, by bit */
+
+      for ( uint32_t i = begin; i < end; i++ )
+        {
+          uint8_t form = rsa->form[idx->rows[i]];
+          if ( ( form < 64 ) && ( done & ( ( (uint64_t) 1 ) << form ) ) )
+            {
+              continue;
+            }
+          if ( form < 64 ) done |= ( (uint64_t) 1 ) << form;
+
+          if ( rsa->base->get( rsa->base,
+                               dex_form_store_key( idx->keys[k], form ),
+                               (void **) & mon
+                             ) != STORE_SUCCESS ) continue;
+          rank_ivs_stat_product( mon, cp_cap, ranks );
+
+          for ( uint32_t j = i; j < end; j++ )
+            {
+              uint32_t row  = idx->rows[j];
+              uint16_t rank = ranks[rsa->ivs[row]];
+              if ( ( rsa->form[row] == form ) && ( 0 < rank ) &&
+                   ( rank <= max_rank ) )
+                {
+                  match[row / 64] |= ( (uint64_t) 1 ) << ( row % 64 );
+                }
+            }
+        }
+    }
+
+  for ( uint32_t w = 0; w < ( rsa->cnt + 63 ) / 64; w++ )
+    {
+      for ( uint64_t bits = match[w]; bits != 0; bits &= bits - 1 )
+        {
+          if ( found < nrows ) rows[found] = w * 64 + __builtin_ctzll( bits );
+          found++;
+        }
+    }
+  free( match );
+
+  return found;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
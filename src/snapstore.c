@@ -0,0 +1,978 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "snapstore.h"
+#include "moves.h"
+#include "pokedex.h"
+#include "store.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* -------------------------------------------------------------------------- */
+
+/* Marks a `NULL' string in a record */
+#define SNAP_NULL_STR  UINT32_MAX
+
+#define snap_align8( N )  ( ( ( N ) + 7 ) & ~( (size_t) 7 ) )
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * FNV-1a, these must never change without bumping `SNAPSTORE_VERSION' since
+ * indices are baked into the snapshot.
+ */
+  static inline uint32_t
+snap_hash_str( const char * str )
+{
+  uint32_t h = 2166136261u;
+  while ( *str != '\0' )
+    {
+      h ^= (uint8_t) *str++;
+      h *= 16777619u;
+    }
+  return h;
+}
+
+  static inline uint32_t
+snap_hash_u32( uint32_t x )
+{
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+#define snap_mon_key( DEX, FORM )                                             \
+  ( ( ( (uint32_t) ( DEX ) ) << 8 ) | ( FORM ) )
+
+  static uint32_t
+snap_idx_cap( uint32_t cnt )
+{
+  uint32_t cap = 8;
+  while ( cap < ( cnt * 2 ) ) cap <<= 1;
+  return cap;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Writer */
+
+struct snap_pool_s {
+  char   * data;
+  size_t   size;
+  size_t   cap;
+};
+typedef struct snap_pool_s  snap_pool_t;
+
+  static uint32_t
+snap_pool_push( snap_pool_t * pool, const void * data, size_t size )
+{
+  if ( pool->cap < ( pool->size + size ) )
+    {
+      size_t new_cap = ( pool->cap == 0 ) ? 4096 : pool->cap;
+      while ( new_cap < ( pool->size + size ) ) new_cap *= 2;
+      char * new_data = (char *) realloc( pool->data, new_cap );
+      if ( new_data == NULL ) return SNAP_NULL_STR;
+      pool->data = new_data;
+      pool->cap  = new_cap;
+    }
+  uint32_t off = (uint32_t) pool->size;
+  memcpy( pool->data + pool->size, data, size );
+  pool->size += size;
+  return off;
+}
+
+  static uint32_t
+snap_pool_push_str( snap_pool_t * pool, const char * str )
+{
+  if ( str == NULL ) return SNAP_NULL_STR;
+  return snap_pool_push( pool, str, strlen( str ) + 1 );
+}
+
+
+  static void
+snap_idx_insert( uint32_t * idx, uint32_t cap, uint32_t hash, uint32_t rec )
+{
+  uint32_t h = hash & ( cap - 1 );
+  while ( idx[h] != SNAPSTORE_EMPTY_SLOT ) h = ( h + 1 ) & ( cap - 1 );
+  idx[h] = rec + 1;
+}
+
+
+  int
+snapstore_write( FILE          *  ostream,
+                 pdex_mon_t   **  mons,
+                 uint32_t         mons_cnt,
+                 store_move_t **  moves,
+                 uint32_t         moves_cnt
+               )
+{
+  assert( ostream != NULL );
+  assert( ( mons != NULL ) || ( mons_cnt == 0 ) );
+  assert( ( moves != NULL ) || ( moves_cnt == 0 ) );
+
+  int           status      = STORE_SUCCESS;
+  uint32_t      recs_cnt    = 0;
+  snap_mon_t  * mon_recs    = NULL;
+  snap_move_t * move_recs   = NULL;
+  snap_pool_t   strings     = { .data = NULL, .size = 0, .cap = 0 };
+  snap_pool_t   move_ids    = { .data = NULL, .size = 0, .cap = 0 };
+  char        * buffer      = NULL;
+
+  /* Count all forms */
+  for ( uint32_t i = 0; i < mons_cnt; i++ )
+    {
+      for ( pdex_mon_t * m = mons[i]; m != NULL; m = m->next_form )
+        {
+          recs_cnt++;
+        }
+    }
+
+  mon_recs  = (snap_mon_t *) calloc( max( recs_cnt, 1 ), sizeof( snap_mon_t ) );
+  move_recs =
+    (snap_move_t *) calloc( max( moves_cnt, 1 ), sizeof( snap_move_t ) );
+  if ( ( mon_recs == NULL ) || ( move_recs == NULL ) )
+    {
+      status = STORE_ERROR_NOMEM;
+      goto cleanup;
+    }
+
+  /* Pokedex records, forms are stored contiguously */
+  uint32_t r = 0;
+  for ( uint32_t i = 0; i < mons_cnt; i++ )
+    {
+      for ( pdex_mon_t * m = mons[i]; m != NULL; m = m->next_form, r++ )
+        {
+          snap_mon_t * rec = mon_recs + r;
+          rec->name              = snap_pool_push_str( & strings, m->name );
+          rec->form_name         = snap_pool_push_str( & strings,
+                                                       m->form_name
+                                                     );
+          rec->fast_move_ids     =
+            (uint32_t) ( move_ids.size / sizeof( int16_t ) );
+          snap_pool_push( & move_ids,
+                          m->fast_move_ids,
+                          m->fast_moves_cnt * sizeof( int16_t )
+                        );
+          rec->charged_move_ids  =
+            (uint32_t) ( move_ids.size / sizeof( int16_t ) );
+          snap_pool_push( & move_ids,
+                          m->charged_move_ids,
+                          m->charged_moves_cnt * sizeof( int16_t )
+                        );
+          rec->types             = (uint32_t) m->types;
+          rec->next_form         = ( m->next_form != NULL ) ? ( r + 2 ) : 0;
+          rec->dex_number        = m->dex_number;
+          rec->family            = m->family;
+          rec->attack            = m->base_stats.attack;
+          rec->stamina           = m->base_stats.stamina;
+          rec->defense           = m->base_stats.defense;
+          rec->tags              = (uint16_t) m->tags;
+          rec->fast_moves_cnt    = m->fast_moves_cnt;
+          rec->charged_moves_cnt = m->charged_moves_cnt;
+          rec->form_idx          = m->form_idx;
+        }
+    }
+
+  for ( uint32_t i = 0; i < moves_cnt; i++ )
+    {
+      snap_move_t  * rec  = move_recs + i;
+      store_move_t * move = moves[i];
+      rec->name        = snap_pool_push_str( & strings, move->name );
+      rec->move_id     = move->move_id;
+      rec->cooldown    = move->cooldown;
+      rec->type        = (uint8_t) move->type;
+      rec->is_fast     = move->is_fast;
+      rec->pve_power   = move->pve_power;
+      rec->pvp_power   = move->pvp_power;
+      rec->pve_energy  = move->pve_energy;
+      rec->pvp_energy  = move->pvp_energy;
+      rec->buff_chance = (uint8_t) move->buff.chance;
+      memcpy( & rec->buff_atk, & move->buff.atk_buff, sizeof( uint8_t ) );
+      memcpy( & rec->buff_def, & move->buff.def_buff, sizeof( uint8_t ) );
+    }
+
+  /* Make sure the pools were actually allocated */
+  snap_pool_push( & strings, "", 1 );
+  snap_pool_push( & move_ids, "\0\0", sizeof( int16_t ) );
+  if ( ( strings.data == NULL ) || ( move_ids.data == NULL ) )
+    {
+      status = STORE_ERROR_NOMEM;
+      goto cleanup;
+    }
+
+  /* Layout */
+  snap_header_t header;
+  memset( & header, 0, sizeof( snap_header_t ) );
+  memcpy( header.magic, SNAPSTORE_MAGIC, sizeof( SNAPSTORE_MAGIC ) );
+  header.version       = SNAPSTORE_VERSION;
+  header.byte_order    = SNAPSTORE_BYTE_ORDER;
+  header.mons_cnt      = recs_cnt;
+  header.moves_cnt     = moves_cnt;
+  header.move_ids_cnt  = (uint32_t) ( move_ids.size / sizeof( int16_t ) );
+  header.strings_size  = (uint32_t) strings.size;
+  header.mon_idx_cap   = snap_idx_cap( recs_cnt );
+  header.move_idx_cap  = snap_idx_cap( moves_cnt );
+
+  size_t off = snap_align8( sizeof( snap_header_t ) );
+  header.mons_off          = off;
+  off = snap_align8( off + recs_cnt * sizeof( snap_mon_t ) );
+  header.moves_off         = off;
+  off = snap_align8( off + moves_cnt * sizeof( snap_move_t ) );
+  header.move_ids_off      = off;
+  off = snap_align8( off + move_ids.size );
+  header.strings_off       = off;
+  off = snap_align8( off + strings.size );
+  header.mon_key_idx_off   = off;
+  off = snap_align8( off + header.mon_idx_cap * sizeof( uint32_t ) );
+  header.mon_name_idx_off  = off;
+  off = snap_align8( off + header.mon_idx_cap * sizeof( uint32_t ) );
+  header.move_key_idx_off  = off;
+  off = snap_align8( off + header.move_idx_cap * sizeof( uint32_t ) );
+  header.move_name_idx_off = off;
+  off = snap_align8( off + header.move_idx_cap * sizeof( uint32_t ) );
+
+  if ( UINT32_MAX < off )
+    {
+      status = STORE_ERROR_BAD_VALUE;
+      goto cleanup;
+    }
+  header.size = (uint32_t) off;
+
+  buffer = (char *) calloc( off, sizeof( char ) );
+  if ( buffer == NULL )
+    {
+      status = STORE_ERROR_NOMEM;
+      goto cleanup;
+    }
+
+  memcpy( buffer, & header, sizeof( snap_header_t ) );
+  memcpy( buffer + header.mons_off, mon_recs, recs_cnt * sizeof( snap_mon_t ) );
+  memcpy( buffer + header.moves_off,
+          move_recs,
+          moves_cnt * sizeof( snap_move_t )
+        );
+  memcpy( buffer + header.move_ids_off, move_ids.data, move_ids.size );
+  memcpy( buffer + header.strings_off, strings.data, strings.size );
+
+  /* Indices */
+  uint32_t * mon_key_idx   = (uint32_t *) ( buffer + header.mon_key_idx_off );
+  uint32_t * mon_name_idx  = (uint32_t *) ( buffer + header.mon_name_idx_off );
+  uint32_t * move_key_idx  = (uint32_t *) ( buffer + header.move_key_idx_off );
+  uint32_t * move_name_idx = (uint32_t *) ( buffer + header.move_name_idx_off );
+
+  for ( uint32_t i = 0; i < recs_cnt; i++ )
+    {
+      snap_idx_insert( mon_key_idx,
+                       header.mon_idx_cap,
+                       snap_hash_u32( snap_mon_key( mon_recs[i].dex_number,
+                                                    mon_recs[i].form_idx
+                                                  )
+                                    ),
+                       i
+                     );
+      /* Like other stores, names refer to the "base" form */
+      if ( ( mon_recs[i].form_idx == 0 ) &&
+           ( mon_recs[i].name != SNAP_NULL_STR )
+         )
+        {
+          snap_idx_insert( mon_name_idx,
+                           header.mon_idx_cap,
+                           snap_hash_str( strings.data + mon_recs[i].name ),
+                           i
+                         );
+        }
+    }
+
+  for ( uint32_t i = 0; i < moves_cnt; i++ )
+    {
+      snap_idx_insert( move_key_idx,
+                       header.move_idx_cap,
+                       snap_hash_u32( move_recs[i].move_id ),
+                       i
+                     );
+      if ( move_recs[i].name != SNAP_NULL_STR )
+        {
+          snap_idx_insert( move_name_idx,
+                           header.move_idx_cap,
+                           snap_hash_str( strings.data + move_recs[i].name ),
+                           i
+                         );
+        }
+    }
+
+  if ( fwrite( buffer, sizeof( char ), off, ostream ) != off )
+    {
+      perror( __func__ );
+      status = STORE_ERROR_FAIL;
+    }
+
+cleanup:
+  free( buffer );
+  free( strings.data );
+  free( move_ids.data );
+  free( mon_recs );
+  free( move_recs );
+  return status;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Reader */
+
+  static bool
+snap_section_ok( const snap_header_t * header,
+                 uint32_t              off,
+                 size_t                size
+               )
+{
+  return ( ( off % 8 ) == 0 ) && ( ( (size_t) off + size ) <= header->size );
+}
+
+
+  static int
+snap_validate( const void * map, size_t map_size )
+{
+  const snap_header_t * header = (const snap_header_t *) map;
+
+  if ( map_size < sizeof( snap_header_t ) ) return STORE_ERROR_BAD_VALUE;
+  if ( memcmp( header->magic, SNAPSTORE_MAGIC, sizeof( SNAPSTORE_MAGIC ) ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( ( header->version    != SNAPSTORE_VERSION    ) ||
+       ( header->byte_order != SNAPSTORE_BYTE_ORDER ) ||
+       ( header->size       != map_size             )
+     )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  if ( ( header->mon_idx_cap  & ( header->mon_idx_cap  - 1 ) ) ||
+       ( header->move_idx_cap & ( header->move_idx_cap - 1 ) ) ||
+       ( header->mon_idx_cap  <= header->mons_cnt  )           ||
+       ( header->move_idx_cap <= header->moves_cnt )
+     )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  size_t mon_idx_size  = header->mon_idx_cap * sizeof( uint32_t );
+  size_t move_idx_size = header->move_idx_cap * sizeof( uint32_t );
+  bool   ok            = true;
+  ok &= snap_section_ok( header,
+                         header->mons_off,
+                         header->mons_cnt * sizeof( snap_mon_t )
+                       );
+  ok &= snap_section_ok( header,
+                         header->moves_off,
+                         header->moves_cnt * sizeof( snap_move_t )
+                       );
+  ok &= snap_section_ok( header,
+                         header->move_ids_off,
+                         header->move_ids_cnt * sizeof( int16_t )
+                       );
+  ok &= snap_section_ok( header, header->strings_off, header->strings_size );
+  ok &= snap_section_ok( header, header->mon_key_idx_off, mon_idx_size );
+  ok &= snap_section_ok( header, header->mon_name_idx_off, mon_idx_size );
+  ok &= snap_section_ok( header, header->move_key_idx_off, move_idx_size );
+  ok &= snap_section_ok( header, header->move_name_idx_off, move_idx_size );
+  ok &= ( 0 < header->strings_size );
+  if ( ! ok ) return STORE_ERROR_BAD_VALUE;
+
+  /* Pool must be terminated so a corrupt offset can't run off the end */
+  const char * strings = (const char *) map + header->strings_off;
+  if ( strings[header->strings_size - 1] != '\0' ) return STORE_ERROR_BAD_VALUE;
+
+  return STORE_SUCCESS;
+}
+
+
+  static const char *
+snap_str( const snap_header_t * header, uint32_t off )
+{
+  if ( ( off == SNAP_NULL_STR ) || ( header->strings_size <= off ) )
+    {
+      return NULL;
+    }
+  return ( (const char *) header ) + header->strings_off + off;
+}
+
+
+  static int16_t *
+snap_move_ids( const snap_header_t * header, uint32_t off, uint8_t cnt )
+{
+  if ( cnt == 0 ) return NULL;
+  if ( header->move_ids_cnt < ( (size_t) off + cnt ) ) return NULL;
+  return ( (int16_t *) ( ( (char *) header ) + header->move_ids_off ) ) + off;
+}
+
+
+  static void
+snap_close( snapstore_snap_t * snap )
+{
+  if ( snap == NULL ) return;
+  if ( snap->mons != NULL )
+    {
+      for ( uint32_t i = 0; i < snap->mons_cnt; i++ ) free( snap->mons[i] );
+    }
+  if ( snap->moves != NULL )
+    {
+      for ( uint32_t i = 0; i < snap->moves_cnt; i++ ) free( snap->moves[i] );
+    }
+  free( snap->mons );
+  free( snap->moves );
+  if ( snap->map != NULL ) munmap( snap->map, snap->map_size );
+  free( snap );
+}
+
+
+  static int
+snap_open( const char * fpath, snapstore_snap_t ** out )
+{
+  assert( fpath != NULL );
+  assert( out != NULL );
+
+  struct stat        st;
+  void             * map    = MAP_FAILED;
+  int                status = STORE_SUCCESS;
+  int                fd     = open( fpath, O_RDONLY );
+  snapstore_snap_t * ssa    = NULL;
+
+  *out = NULL;
+
+  if ( fd == -1 )
+    {
+      perror( __func__ );
+      return STORE_ERROR_FAIL;
+    }
+  if ( ( fstat( fd, & st ) != 0 ) || ( st.st_size <= 0 ) )
+    {
+      close( fd );
+      return STORE_ERROR_BAD_VALUE;
+    }
+  map = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  close( fd );
+  if ( map == MAP_FAILED )
+    {
+      perror( __func__ );
+      return STORE_ERROR_FAIL;
+    }
+
+  status = snap_validate( map, st.st_size );
+  if ( status != STORE_SUCCESS )
+    {
+      munmap( map, st.st_size );
+      return status;
+    }
+
+  ssa = (snapstore_snap_t *) calloc( 1, sizeof( snapstore_snap_t ) );
+  if ( ssa == NULL )
+    {
+      munmap( map, st.st_size );
+      return STORE_ERROR_NOMEM;
+    }
+
+  const snap_header_t * header = (const snap_header_t *) map;
+  ssa->map       = map;
+  ssa->map_size  = st.st_size;
+  ssa->header    = header;
+  ssa->mons_cnt  = header->mons_cnt;
+  ssa->moves_cnt = header->moves_cnt;
+  ssa->mon_recs  = (const snap_mon_t *) ( (char *) map + header->mons_off );
+  ssa->move_recs = (const snap_move_t *) ( (char *) map + header->moves_off );
+  ssa->mons      = calloc( max( header->mons_cnt, 1 ), sizeof( ssa->mons[0] ) );
+  ssa->moves     = calloc( max( header->moves_cnt, 1 ),
+                           sizeof( ssa->moves[0] )
+                         );
+  if ( ( ssa->mons == NULL ) || ( ssa->moves == NULL ) )
+    {
+      snap_close( ssa );
+      return STORE_ERROR_NOMEM;
+    }
+
+  *out = ssa;
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Resolve the Pokedex record at index `i', and the forms after it.
+ * The writer always puts forms after their base, so `next_form' only ever
+ * moves forward, and a corrupt file can't send this around in a loop.
+ * Returns `NULL' when out of memory.
+ */
+  static pdex_mon_t *
+snap_mon( snapstore_snap_t * snap, uint32_t i )
+{
+  pdex_mon_t * mon = atomic_load_explicit( snap->mons + i,
+                                           memory_order_acquire
+                                         );
+  if ( mon != NULL ) return mon;
+
+  const snap_header_t * header    = snap->header;
+  const snap_mon_t    * rec       = snap->mon_recs + i;
+  pdex_mon_t          * next_form = NULL;
+  if ( ( ( i + 1 ) < rec->next_form ) && ( rec->next_form <= snap->mons_cnt ) )
+    {
+      next_form = snap_mon( snap, rec->next_form - 1 );
+      if ( next_form == NULL ) return NULL;
+    }
+
+  mon = (pdex_mon_t *) malloc( sizeof( pdex_mon_t ) );
+  if ( mon == NULL ) return NULL;
+  mon->dex_number        = rec->dex_number;
+  mon->name              = (char *) snap_str( header, rec->name );
+  mon->form_name         = (char *) snap_str( header, rec->form_name );
+  mon->family            = rec->family;
+  mon->types             = (ptype_mask_t) rec->types;
+  mon->base_stats        = (stats_t) { .attack  = rec->attack,
+                                       .stamina = rec->stamina,
+                                       .defense = rec->defense
+                                     };
+  mon->tags              = (pdex_tag_mask_t) rec->tags;
+  mon->fast_move_ids     = snap_move_ids( header,
+                                          rec->fast_move_ids,
+                                          rec->fast_moves_cnt
+                                        );
+  mon->fast_moves_cnt    = ( mon->fast_move_ids == NULL ) ? 0 :
+                                                   rec->fast_moves_cnt;
+  mon->charged_move_ids  = snap_move_ids( header,
+                                          rec->charged_move_ids,
+                                          rec->charged_moves_cnt
+                                        );
+  mon->charged_moves_cnt = ( mon->charged_move_ids == NULL ) ? 0 :
+                                                   rec->charged_moves_cnt;
+  mon->form_idx          = rec->form_idx;
+  mon->next_form         = next_form;
+
+  /* Another reader may have resolved it first, theirs is kept */
+  pdex_mon_t * expected = NULL;
+  if ( atomic_compare_exchange_strong_explicit( snap->mons + i,
+                                                & expected,
+                                                mon,
+                                                memory_order_acq_rel,
+                                                memory_order_acquire
+                                              ) )
+    {
+      return mon;
+    }
+  free( mon );
+  return expected;
+}
+
+
+/* Resolve the Move record at index `i', returns `NULL' when out of memory */
+  static store_move_t *
+snap_move( snapstore_snap_t * snap, uint32_t i )
+{
+  store_move_t * move = atomic_load_explicit( snap->moves + i,
+                                              memory_order_acquire
+                                            );
+  if ( move != NULL ) return move;
+
+  const snap_move_t * rec = snap->move_recs + i;
+  move = (store_move_t *) malloc( sizeof( store_move_t ) );
+  if ( move == NULL ) return NULL;
+  move->name        = (char *) snap_str( snap->header, rec->name );
+  move->type        = (ptype_t) rec->type;
+  move->is_fast     = rec->is_fast;
+  move->move_id     = rec->move_id;
+  move->cooldown    = rec->cooldown;
+  move->pve_power   = rec->pve_power;
+  move->pvp_power   = rec->pvp_power;
+  move->pve_energy  = rec->pve_energy;
+  move->pvp_energy  = rec->pvp_energy;
+  move->buff.chance = (buff_chance_t) rec->buff_chance;
+  memcpy( & move->buff.atk_buff, & rec->buff_atk, sizeof( uint8_t ) );
+  memcpy( & move->buff.def_buff, & rec->buff_def, sizeof( uint8_t ) );
+
+  store_move_t * expected = NULL;
+  if ( atomic_compare_exchange_strong_explicit( snap->moves + i,
+                                                & expected,
+                                                move,
+                                                memory_order_acq_rel,
+                                                memory_order_acquire
+                                              ) )
+    {
+      return move;
+    }
+  free( move );
+  return expected;
+}
+
+
+/* Hand a resolved record to the caller */
+  static int
+snap_found( void * rec, void ** val )
+{
+  if ( val != NULL ) *val = rec;
+  return ( rec == NULL ) ? STORE_ERROR_NOMEM : STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+snapstore_init( store_t * snapstore, void * fpath )
+{
+  assert( snapstore != NULL );
+  assert( fpath != NULL );
+
+  snapstore_snap_t * snap   = NULL;
+  int                status = snap_open( (const char *) fpath, & snap );
+  if ( status != STORE_SUCCESS ) return status;
+
+  snapstore->aux = calloc( 1, sizeof( snapstore_aux_t ) );
+  if ( snapstore->aux == NULL )
+    {
+      snap_close( snap );
+      return STORE_ERROR_NOMEM;
+    }
+  pthread_mutex_init( & as_ssa( snapstore )->lock, NULL );
+  as_ssa( snapstore )->retired = NULL;
+  atomic_init( & as_ssa( snapstore )->snap, snap );
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+snapstore_reload( store_t * snapstore, const char * fpath )
+{
+  assert( snapstore != NULL );
+  assert( snapstore->aux != NULL );
+  assert( fpath != NULL );
+
+  snapstore_snap_t * snap   = NULL;
+  int                status = snap_open( fpath, & snap );
+  if ( status != STORE_SUCCESS ) return status;
+
+  snapstore_aux_t  * ssa = as_ssa( snapstore );
+  pthread_mutex_lock( & ssa->lock );
+  snapstore_snap_t * old = atomic_exchange_explicit( & ssa->snap,
+                                                     snap,
+                                                     memory_order_acq_rel
+                                                   );
+  old->retired_next = ssa->retired;
+  ssa->retired      = old;
+  store_touch( snapstore );
+  pthread_mutex_unlock( & ssa->lock );
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  void
+snapstore_reclaim( store_t * snapstore )
+{
+  assert( snapstore != NULL );
+  if ( snapstore->aux == NULL ) return;
+
+  pthread_mutex_lock( & as_ssa( snapstore )->lock );
+  snapstore_snap_t * snap = as_ssa( snapstore )->retired;
+  as_ssa( snapstore )->retired = NULL;
+  pthread_mutex_unlock( & as_ssa( snapstore )->lock );
+
+  while ( snap != NULL )
+    {
+      snapstore_snap_t * next = snap->retired_next;
+      snap_close( snap );
+      snap = next;
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  void
+snapstore_free( store_t * snapstore )
+{
+  assert( snapstore != NULL );
+  if ( snapstore->aux == NULL ) return;
+  snapstore_reclaim( snapstore );
+  snap_close( atomic_load( & as_ssa( snapstore )->snap ) );
+  pthread_mutex_destroy( & as_ssa( snapstore )->lock );
+  free( snapstore->aux );
+  snapstore->aux = NULL;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+snapstore_has( store_t * snapstore, store_key_t key )
+{
+  return STORE_ERROR_NOT_FOUND != snapstore_get( snapstore, key, NULL );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#define snap_idx( SSA, FIELD )                                                \
+  ( (const uint32_t *) ( ( (const char *) ( SSA )->header ) +                 \
+                         ( SSA )->header->FIELD                               \
+                       ) )
+
+
+  int
+snapstore_get_pokemon( snapstore_t *  snapstore,
+                       uint16_t       dex_num,
+                       uint8_t        form_idx,
+                       pdex_mon_t  ** val
+                     )
+{
+  snapstore_snap_t * ssa  = snapstore_snap( snapstore );
+  const uint32_t   * idx  = snap_idx( ssa, mon_key_idx_off );
+  uint32_t           mask = ssa->header->mon_idx_cap - 1;
+  uint32_t           h    =
+    snap_hash_u32( snap_mon_key( dex_num, form_idx ) );
+
+  for ( h &= mask; idx[h] != SNAPSTORE_EMPTY_SLOT; h = ( h + 1 ) & mask )
+    {
+      if ( ssa->mons_cnt < idx[h] ) break;
+      const snap_mon_t * rec = ssa->mon_recs + idx[h] - 1;
+      if ( ( rec->dex_number == dex_num ) && ( rec->form_idx == form_idx ) )
+        {
+          return snap_found( snap_mon( ssa, idx[h] - 1 ), (void **) val );
+        }
+    }
+
+  if ( val != NULL ) *val = NULL;
+  return STORE_ERROR_NOT_FOUND;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+snapstore_get_pokemon_by_name( snapstore_t *  snapstore,
+                               const char  *  name,
+                               pdex_mon_t  ** val
+                             )
+{
+  snapstore_snap_t * ssa  = snapstore_snap( snapstore );
+  const uint32_t   * idx  = snap_idx( ssa, mon_name_idx_off );
+  uint32_t           mask = ssa->header->mon_idx_cap - 1;
+  uint32_t           h    = snap_hash_str( name );
+
+  for ( h &= mask; idx[h] != SNAPSTORE_EMPTY_SLOT; h = ( h + 1 ) & mask )
+    {
+      if ( ssa->mons_cnt < idx[h] ) break;
+      const char * rec_name =
+        snap_str( ssa->header, ssa->mon_recs[idx[h] - 1].name );
+      if ( ( rec_name != NULL ) && ( strcmp( rec_name, name ) == 0 ) )
+        {
+          return snap_found( snap_mon( ssa, idx[h] - 1 ), (void **) val );
+        }
+    }
+
+  if ( val != NULL ) *val = NULL;
+  return STORE_ERROR_NOT_FOUND;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+snapstore_get_move( snapstore_t  *  snapstore,
+                    uint16_t        move_id,
+                    store_move_t ** val
+                  )
+{
+  snapstore_snap_t * ssa  = snapstore_snap( snapstore );
+  const uint32_t   * idx  = snap_idx( ssa, move_key_idx_off );
+  uint32_t           mask = ssa->header->move_idx_cap - 1;
+  uint32_t           h    = snap_hash_u32( move_id );
+
+  for ( h &= mask; idx[h] != SNAPSTORE_EMPTY_SLOT; h = ( h + 1 ) & mask )
+    {
+      if ( ssa->moves_cnt < idx[h] ) break;
+      if ( ssa->move_recs[idx[h] - 1].move_id == move_id )
+        {
+          return snap_found( snap_move( ssa, idx[h] - 1 ), (void **) val );
+        }
+    }
+
+  if ( val != NULL ) *val = NULL;
+  return STORE_ERROR_NOT_FOUND;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+snapstore_get_move_by_name( snapstore_t  *  snapstore,
+                            const char   *  name,
+                            store_move_t ** val
+                          )
+{
+  snapstore_snap_t * ssa  = snapstore_snap( snapstore );
+  const uint32_t   * idx  = snap_idx( ssa, move_name_idx_off );
+  uint32_t           mask = ssa->header->move_idx_cap - 1;
+  uint32_t           h    = snap_hash_str( name );
+
+  for ( h &= mask; idx[h] != SNAPSTORE_EMPTY_SLOT; h = ( h + 1 ) & mask )
+    {
+      if ( ssa->moves_cnt < idx[h] ) break;
+      const char * rec_name =
+        snap_str( ssa->header, ssa->move_recs[idx[h] - 1].name );
+      if ( ( rec_name != NULL ) && ( strcmp( rec_name, name ) == 0 ) )
+        {
+          return snap_found( snap_move( ssa, idx[h] - 1 ), (void **) val );
+        }
+    }
+
+  if ( val != NULL ) *val = NULL;
+  return STORE_ERROR_NOT_FOUND;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+snapstore_get( store_t * snapstore, store_key_t key, void ** val )
+{
+  assert( snapstore != NULL );
+
+  if ( ( key.key_type == STORE_NUM  ) && ( key.val_type == STORE_MOVE ) )
+    {
+      return snapstore_get_move( snapstore,
+                                 key.data_h0,
+                                 (store_move_t **) val
+                               );
+    }
+  else if ( ( key.key_type == STORE_NUM ) &&
+            ( key.val_type == STORE_POKEDEX )
+          )
+    {
+      return snapstore_get_pokemon( snapstore,
+                                    key.data_h0,
+                                    key.data_q2,
+                                    (pdex_mon_t **) val
+                                  );
+    }
+  return STORE_ERROR_BAD_VALUE;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+snapstore_each( store_t       * snapstore,
+                store_type_t    val_type,
+                store_each_cb   cb,
+                void          * ctx
+              )
+{
+  assert( snapstore != NULL );
+  assert( cb != NULL );
+
+  snapstore_snap_t * ssa = snapstore_snap( snapstore );
+  int                rsl = STORE_SUCCESS;
+
+  if ( val_type == STORE_POKEDEX )
+    {
+      for ( uint32_t i = 0; i < ssa->mons_cnt; i++ )
+        {
+          pdex_mon_t * mon = snap_mon( ssa, i );
+          if ( mon == NULL ) return STORE_ERROR_NOMEM;
+          rsl = cb( ctx, pdex_store_key( mon ), mon );
+          if ( rsl != STORE_SUCCESS ) return rsl;
+        }
+      return STORE_SUCCESS;
+    }
+
+  if ( val_type == STORE_MOVE )
+    {
+      for ( uint32_t i = 0; i < ssa->moves_cnt; i++ )
+        {
+          store_move_t * move = snap_move( ssa, i );
+          if ( move == NULL ) return STORE_ERROR_NOMEM;
+          rsl = cb( ctx, move_store_key( move ), move );
+          if ( rsl != STORE_SUCCESS ) return rsl;
+        }
+      return STORE_SUCCESS;
+    }
+
+  return STORE_ERROR_BAD_VALUE;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+snapstore_get_str( store_t * snapstore, const char * str, void ** val )
+{
+  assert( snapstore != NULL );
+
+  if ( snapstore_get_move_by_name( snapstore,
+                                   str,
+                                   (store_move_t **) val
+                                 ) == STORE_SUCCESS )
+    {
+      return STORE_SUCCESS;
+    }
+  return snapstore_get_pokemon_by_name( snapstore, str, (pdex_mon_t **) val );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+snapstore_get_str_t( store_t      *  snapstore,
+                     store_type_t    val_type,
+                     const char   *  str,
+                     void         ** val
+                   )
+{
+  assert( snapstore != NULL );
+
+  if ( val_type == STORE_MOVE )
+    {
+      return snapstore_get_move_by_name( snapstore,
+                                         str,
+                                         (store_move_t **) val
+                                       );
+    }
+
+  if ( val_type == STORE_POKEDEX )
+    {
+      return snapstore_get_pokemon_by_name( snapstore,
+                                            str,
+                                            (pdex_mon_t **) val
+                                          );
+    }
+
+  return STORE_ERROR_BAD_VALUE;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,834 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "ext/uthash.h"
+#include "moves.h"
+#include "pokedex.h"
+#include "sqlstore.h"
+#include "store.h"
+#include <assert.h>
+#include <sqlite3.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* -------------------------------------------------------------------------- */
+
+static const char SQLSTORE_SCHEMA[] =
+  "CREATE TABLE IF NOT EXISTS moves ("
+  "  move_id integer primary key,"
+  "  name text not null unique,"
+  "  type integer not null,"
+  "  is_fast integer not null,"
+  "  cooldown integer not null,"
+  "  pve_power integer not null,"
+  "  pvp_power integer not null,"
+  "  pve_energy integer not null,"
+  "  pvp_energy integer not null,"
+  "  buff_chance integer not null,"
+  "  buff_atk integer not null,"
+  "  buff_def integer not null"
+  ");"
+  "CREATE TABLE IF NOT EXISTS pokedex ("
+  "  dex integer not null,"
+  "  form_idx integer not null,"
+  "  name text not null,"
+  "  form_name text,"
+  "  family integer not null,"
+  "  types integer not null,"
+  "  attack integer not null,"
+  "  stamina integer not null,"
+  "  defense integer not null,"
+  "  tags integer not null,"
+  "  primary key ( dex, form_idx )"
+  ");"
+  "CREATE INDEX IF NOT EXISTS pokedex_by_name ON pokedex ( name, form_idx );"
+  "CREATE TABLE IF NOT EXISTS pokedex_moves ("
+  "  dex integer not null,"
+  "  form_idx integer not null,"
+  "  is_fast integer not null,"
+  "  idx integer not null,"
+  "  move_id integer not null,"
+  "  primary key ( dex, form_idx, is_fast, idx )"
+  ");"
+  "CREATE INDEX IF NOT EXISTS pokedex_moves_by_move"
+  "  ON pokedex_moves ( abs( move_id ) );";
+
+static const char * SQLSTORE_STMTS[SQLS_STMT_CNT] = {
+  [SQLS_GET_MON] =
+    "SELECT name, form_name, family, types, attack, stamina, defense, tags "
+    "FROM pokedex WHERE dex = ?1 AND form_idx = ?2",
+  [SQLS_GET_MON_MOVES] =
+    "SELECT is_fast, move_id FROM pokedex_moves "
+    "WHERE dex = ?1 AND form_idx = ?2 ORDER BY is_fast DESC, idx",
+  [SQLS_GET_MON_BY_NAME] =
+    "SELECT dex FROM pokedex WHERE name = ?1 AND form_idx = 0",
+  [SQLS_GET_MOVE] =
+    "SELECT name, type, is_fast, cooldown, pve_power, pvp_power, pve_energy, "
+    "pvp_energy, buff_chance, buff_atk, buff_def FROM moves WHERE move_id = ?1",
+  [SQLS_GET_MOVE_BY_NAME] =
+    "SELECT move_id FROM moves WHERE name = ?1",
+  [SQLS_EACH_MON] =
+    "SELECT dex, form_idx FROM pokedex ORDER BY dex, form_idx",
+  [SQLS_EACH_MOVE] =
+    "SELECT move_id FROM moves ORDER BY move_id"
+};
+
+#define sqls_mon_key( DEX, FORM )                                             \
+  ( ( ( (uint32_t) STORE_POKEDEX ) << 24 ) | ( ( (uint32_t) ( DEX ) ) << 8 ) |\
+    ( FORM ) )
+
+#define sqls_move_key( MOVE_ID )                                              \
+  ( ( ( (uint32_t) STORE_MOVE ) << 24 ) | ( MOVE_ID ) )
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Writer */
+
+  static int
+sqls_exec( sqlite3 * db, const char * sql )
+{
+  char * err = NULL;
+  if ( sqlite3_exec( db, sql, NULL, NULL, & err ) != SQLITE_OK )
+    {
+      fprintf( stderr, "sqlstore: %s\n", err );
+      sqlite3_free( err );
+      return STORE_ERROR_FAIL;
+    }
+  return STORE_SUCCESS;
+}
+
+
+  static int
+sqls_step_reset( sqlite3_stmt * stmt )
+{
+  int rc = sqlite3_step( stmt );
+  sqlite3_reset( stmt );
+  sqlite3_clear_bindings( stmt );
+  return ( rc == SQLITE_DONE ) ? STORE_SUCCESS : STORE_ERROR_FAIL;
+}
+
+
+  int
+sqlstore_write( const char    *  db_path,
+                pdex_mon_t   **  mons,
+                uint32_t         mons_cnt,
+                store_move_t **  moves,
+                uint32_t         moves_cnt
+              )
+{
+  assert( db_path != NULL );
+  assert( ( mons != NULL ) || ( mons_cnt == 0 ) );
+  assert( ( moves != NULL ) || ( moves_cnt == 0 ) );
+
+  sqlite3      * db         = NULL;
+  sqlite3_stmt * ins_move   = NULL;
+  sqlite3_stmt * ins_mon    = NULL;
+  sqlite3_stmt * ins_mon_mv = NULL;
+  int            status     = STORE_SUCCESS;
+
+  if ( sqlite3_open( db_path, & db ) != SQLITE_OK )
+    {
+      fprintf( stderr, "sqlstore: %s\n", sqlite3_errmsg( db ) );
+      sqlite3_close( db );
+      return STORE_ERROR_FAIL;
+    }
+
+  status = sqls_exec( db, SQLSTORE_SCHEMA );
+  if ( status != STORE_SUCCESS ) goto cleanup;
+
+  if ( ( sqlite3_prepare_v2( db,
+                             "INSERT INTO moves VALUES "
+                             "( ?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11, "
+                             "?12 )",
+                             -1, & ins_move, NULL
+                           ) != SQLITE_OK ) ||
+       ( sqlite3_prepare_v2( db,
+                             "INSERT INTO pokedex VALUES "
+                             "( ?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10 )",
+                             -1, & ins_mon, NULL
+                           ) != SQLITE_OK ) ||
+       ( sqlite3_prepare_v2( db,
+                             "INSERT INTO pokedex_moves VALUES "
+                             "( ?1, ?2, ?3, ?4, ?5 )",
+                             -1, & ins_mon_mv, NULL
+                           ) != SQLITE_OK )
+     )
+    {
+      fprintf( stderr, "sqlstore: %s\n", sqlite3_errmsg( db ) );
+      status = STORE_ERROR_FAIL;
+      goto cleanup;
+    }
+
+  /* Old rows are replaced in one transaction, a failed write changes nothing */
+  status = sqls_exec( db, "BEGIN" );
+  if ( status != STORE_SUCCESS ) goto cleanup;
+
+  status = sqls_exec( db,
+                      "DELETE FROM pokedex_moves; DELETE FROM pokedex; "
+                      "DELETE FROM moves;"
+                    );
+  if ( status != STORE_SUCCESS ) goto rollback;
+
+  for ( uint32_t i = 0; i < moves_cnt; i++ )
+    {
+      store_move_t * move = moves[i];
+      uint8_t        atk  = 0;
+      uint8_t        def  = 0;
+      memcpy( & atk, & move->buff.atk_buff, sizeof( uint8_t ) );
+      memcpy( & def, & move->buff.def_buff, sizeof( uint8_t ) );
+      sqlite3_bind_int( ins_move, 1, move->move_id );
+      sqlite3_bind_text( ins_move, 2, move->name, -1, SQLITE_STATIC );
+      sqlite3_bind_int( ins_move, 3, move->type );
+      sqlite3_bind_int( ins_move, 4, move->is_fast );
+      sqlite3_bind_int( ins_move, 5, move->cooldown );
+      sqlite3_bind_int( ins_move, 6, move->pve_power );
+      sqlite3_bind_int( ins_move, 7, move->pvp_power );
+      sqlite3_bind_int( ins_move, 8, move->pve_energy );
+      sqlite3_bind_int( ins_move, 9, move->pvp_energy );
+      sqlite3_bind_int( ins_move, 10, move->buff.chance );
+      sqlite3_bind_int( ins_move, 11, atk );
+      sqlite3_bind_int( ins_move, 12, def );
+      status = sqls_step_reset( ins_move );
+      if ( status != STORE_SUCCESS ) goto rollback;
+    }
+
+  for ( uint32_t i = 0; i < mons_cnt; i++ )
+    {
+      for ( pdex_mon_t * mon = mons[i]; mon != NULL; mon = mon->next_form )
+        {
+          sqlite3_bind_int( ins_mon, 1, mon->dex_number );
+          sqlite3_bind_int( ins_mon, 2, mon->form_idx );
+          sqlite3_bind_text( ins_mon, 3, mon->name, -1, SQLITE_STATIC );
+          sqlite3_bind_text( ins_mon, 4, mon->form_name, -1, SQLITE_STATIC );
+          sqlite3_bind_int( ins_mon, 5, mon->family );
+          sqlite3_bind_int( ins_mon, 6, mon->types );
+          sqlite3_bind_int( ins_mon, 7, mon->base_stats.attack );
+          sqlite3_bind_int( ins_mon, 8, mon->base_stats.stamina );
+          sqlite3_bind_int( ins_mon, 9, mon->base_stats.defense );
+          sqlite3_bind_int( ins_mon, 10, mon->tags );
+          status = sqls_step_reset( ins_mon );
+          if ( status != STORE_SUCCESS ) goto rollback;
+
+          for ( uint16_t m = 0;
+                m < ( mon->fast_moves_cnt + mon->charged_moves_cnt );
+                m++
+              )
+            {
+              bool is_fast = m < mon->fast_moves_cnt;
+              sqlite3_bind_int( ins_mon_mv, 1, mon->dex_number );
+              sqlite3_bind_int( ins_mon_mv, 2, mon->form_idx );
+              sqlite3_bind_int( ins_mon_mv, 3, is_fast );
+              if ( is_fast )
+                {
+                  sqlite3_bind_int( ins_mon_mv, 4, m );
+                  sqlite3_bind_int( ins_mon_mv, 5, mon->fast_move_ids[m] );
+                }
+              else
+                {
+                  uint16_t c = m - mon->fast_moves_cnt;
+                  sqlite3_bind_int( ins_mon_mv, 4, c );
+                  sqlite3_bind_int( ins_mon_mv, 5, mon->charged_move_ids[c] );
+                }
+              status = sqls_step_reset( ins_mon_mv );
+              if ( status != STORE_SUCCESS ) goto rollback;
+            }
+        }
+    }
+
+  status = sqls_exec( db, "COMMIT" );
+  goto cleanup;
+
+rollback:
+  fprintf( stderr, "sqlstore: %s\n", sqlite3_errmsg( db ) );
+  sqls_exec( db, "ROLLBACK" );
+  status = STORE_ERROR_FAIL;
+
+cleanup:
+  sqlite3_finalize( ins_move );
+  sqlite3_finalize( ins_mon );
+  sqlite3_finalize( ins_mon_mv );
+  sqlite3_close( db );
+  return status;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Reader */
+
+/**
+ * Fetch a cached statement, preparing it on first use.
+ */
+  static sqlite3_stmt *
+sqls_stmt( sqlstore_t * sqlstore, sqlstore_stmt_t which )
+{
+  sqlite3_stmt ** stmt = as_sqla( sqlstore )->stmts + which;
+  if ( *stmt == NULL )
+    {
+      if ( sqlite3_prepare_v3( as_sqla( sqlstore )->db,
+                               SQLSTORE_STMTS[which],
+                               -1,
+                               SQLITE_PREPARE_PERSISTENT,
+                               stmt,
+                               NULL
+                             ) != SQLITE_OK )
+        {
+          fprintf( stderr,
+                   "sqlstore: %s\n",
+                   sqlite3_errmsg( as_sqla( sqlstore )->db )
+                 );
+          *stmt = NULL;
+        }
+    }
+  return *stmt;
+}
+
+
+  static void
+sqls_stmt_done( sqlite3_stmt * stmt )
+{
+  sqlite3_reset( stmt );
+  sqlite3_clear_bindings( stmt );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static sqlstore_entry_t *
+sqls_lru_find( sqlstore_t * sqlstore, uint32_t key )
+{
+  sqlstore_entry_t * entry = NULL;
+  HASH_FIND( hh, as_sqla( sqlstore )->lru, & key, sizeof( uint32_t ), entry );
+  if ( entry != NULL )
+    {
+      /* Move to the back of the line */
+      HASH_DELETE( hh, as_sqla( sqlstore )->lru, entry );
+      HASH_ADD( hh, as_sqla( sqlstore )->lru, key, sizeof( uint32_t ), entry );
+      as_sqla( sqlstore )->hits++;
+    }
+  else
+    {
+      as_sqla( sqlstore )->misses++;
+    }
+  return entry;
+}
+
+
+  static void
+sqls_lru_add( sqlstore_t * sqlstore, sqlstore_entry_t * entry )
+{
+  sqlstore_aux_t   * sqla   = as_sqla( sqlstore );
+  sqlstore_entry_t * oldest = NULL;
+  sqlstore_entry_t * tmp    = NULL;
+
+  /* Iteration order is insertion order, so the oldest entries come first */
+  HASH_ITER( hh, sqla->lru, oldest, tmp )
+    {
+      if ( sqla->pinned ) break;
+      if ( HASH_COUNT( sqla->lru ) < sqla->lru_cap ) break;
+      HASH_DELETE( hh, sqla->lru, oldest );
+      free( oldest );
+    }
+  HASH_ADD( hh, sqla->lru, key, sizeof( uint32_t ), entry );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Strings from SQLite are only valid until the next step, so they are copied
+ * into the tail of the entry.
+ */
+  static char *
+sqls_copy_col( sqlite3_stmt * stmt, int col, char ** tail )
+{
+  if ( sqlite3_column_type( stmt, col ) == SQLITE_NULL ) return NULL;
+  const char * text = (const char *) sqlite3_column_text( stmt, col );
+  size_t       len  = sqlite3_column_bytes( stmt, col );
+  char       * dst  = *tail;
+  memcpy( dst, text, len );
+  dst[len] = '\0';
+  *tail += len + 1;
+  return dst;
+}
+
+
+  static int
+sqls_load_pokemon( sqlstore_t        *  sqlstore,
+                   uint16_t             dex_num,
+                   uint8_t              form_idx,
+                   sqlstore_entry_t  ** out
+                 )
+{
+  sqlite3_stmt * row  = sqls_stmt( sqlstore, SQLS_GET_MON );
+  sqlite3_stmt * mvs  = sqls_stmt( sqlstore, SQLS_GET_MON_MOVES );
+  int            rc   = SQLITE_OK;
+  uint16_t       nmvs = 0;
+  size_t         size = sizeof( sqlstore_entry_t );
+
+  if ( ( row == NULL ) || ( mvs == NULL ) ) return STORE_ERROR_FAIL;
+
+  sqlite3_bind_int( row, 1, dex_num );
+  sqlite3_bind_int( row, 2, form_idx );
+  rc = sqlite3_step( row );
+  if ( rc != SQLITE_ROW )
+    {
+      sqls_stmt_done( row );
+      return ( rc == SQLITE_DONE ) ? STORE_ERROR_NOT_FOUND : STORE_ERROR_FAIL;
+    }
+
+  /* Count moves first so everything fits in one allocation */
+  sqlite3_bind_int( mvs, 1, dex_num );
+  sqlite3_bind_int( mvs, 2, form_idx );
+  while ( sqlite3_step( mvs ) == SQLITE_ROW ) nmvs++;
+  sqlite3_reset( mvs );
+
+  size += nmvs * sizeof( int16_t );
+  size += sqlite3_column_bytes( row, 0 ) + 1;
+  size += sqlite3_column_bytes( row, 1 ) + 1;
+
+  sqlstore_entry_t * entry = (sqlstore_entry_t *) calloc( 1, size );
+  if ( entry == NULL )
+    {
+      sqls_stmt_done( row );
+      sqls_stmt_done( mvs );
+      return STORE_ERROR_NOMEM;
+    }
+
+  pdex_mon_t * mon      = & entry->mon;
+  int16_t    * move_ids = (int16_t *) ( entry + 1 );
+  char       * tail     = (char *) ( move_ids + nmvs );
+
+  entry->key              = sqls_mon_key( dex_num, form_idx );
+  mon->dex_number         = dex_num;
+  mon->form_idx           = form_idx;
+  mon->name               = sqls_copy_col( row, 0, & tail );
+  mon->form_name          = sqls_copy_col( row, 1, & tail );
+  mon->family             = sqlite3_column_int( row, 2 );
+  mon->types              = (ptype_mask_t) sqlite3_column_int( row, 3 );
+  mon->base_stats.attack  = sqlite3_column_int( row, 4 );
+  mon->base_stats.stamina = sqlite3_column_int( row, 5 );
+  mon->base_stats.defense = sqlite3_column_int( row, 6 );
+  mon->tags               = (pdex_tag_mask_t) sqlite3_column_int( row, 7 );
+  mon->next_form          = NULL;
+  sqls_stmt_done( row );
+
+  /* Fast moves are sorted first */
+  uint16_t m = 0;
+  while ( ( m < nmvs ) && ( sqlite3_step( mvs ) == SQLITE_ROW ) )
+    {
+      if ( sqlite3_column_int( mvs, 0 ) ) mon->fast_moves_cnt++;
+      else                                mon->charged_moves_cnt++;
+      move_ids[m++] = (int16_t) sqlite3_column_int( mvs, 1 );
+    }
+  sqls_stmt_done( mvs );
+  mon->fast_move_ids    = ( 0 < mon->fast_moves_cnt ) ? move_ids : NULL;
+  mon->charged_move_ids = ( 0 < mon->charged_moves_cnt ) ?
+                          ( move_ids + mon->fast_moves_cnt ) : NULL;
+
+  *out = entry;
+  return STORE_SUCCESS;
+}
+
+
+  static int
+sqls_load_move( sqlstore_t        *  sqlstore,
+                uint16_t             move_id,
+                sqlstore_entry_t  ** out
+              )
+{
+  sqlite3_stmt * row = sqls_stmt( sqlstore, SQLS_GET_MOVE );
+  int            rc  = SQLITE_OK;
+
+  if ( row == NULL ) return STORE_ERROR_FAIL;
+
+  sqlite3_bind_int( row, 1, move_id );
+  rc = sqlite3_step( row );
+  if ( rc != SQLITE_ROW )
+    {
+      sqls_stmt_done( row );
+      return ( rc == SQLITE_DONE ) ? STORE_ERROR_NOT_FOUND : STORE_ERROR_FAIL;
+    }
+
+  sqlstore_entry_t * entry =
+    (sqlstore_entry_t *) calloc( 1, sizeof( sqlstore_entry_t ) +
+                                    sqlite3_column_bytes( row, 0 ) + 1
+                               );
+  if ( entry == NULL )
+    {
+      sqls_stmt_done( row );
+      return STORE_ERROR_NOMEM;
+    }
+
+  store_move_t * move = & entry->move;
+  char         * tail = (char *) ( entry + 1 );
+  uint8_t        atk  = sqlite3_column_int( row, 9 );
+  uint8_t        def  = sqlite3_column_int( row, 10 );
+
+  entry->key        = sqls_move_key( move_id );
+  move->move_id     = move_id;
+  move->name        = sqls_copy_col( row, 0, & tail );
+  move->type        = (ptype_t) sqlite3_column_int( row, 1 );
+  move->is_fast     = sqlite3_column_int( row, 2 );
+  move->cooldown    = sqlite3_column_int( row, 3 );
+  move->pve_power   = sqlite3_column_int( row, 4 );
+  move->pvp_power   = sqlite3_column_int( row, 5 );
+  move->pve_energy  = sqlite3_column_int( row, 6 );
+  move->pvp_energy  = sqlite3_column_int( row, 7 );
+  move->buff.chance = (buff_chance_t) sqlite3_column_int( row, 8 );
+  memcpy( & move->buff.atk_buff, & atk, sizeof( uint8_t ) );
+  memcpy( & move->buff.def_buff, & def, sizeof( uint8_t ) );
+  sqls_stmt_done( row );
+
+  *out = entry;
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+sqlstore_init( store_t * sqlstore, void * db_path )
+{
+  assert( sqlstore != NULL );
+  assert( db_path != NULL );
+
+  sqlite3 * db = NULL;
+  if ( sqlite3_open_v2( (const char *) db_path,
+                        & db,
+                        SQLITE_OPEN_READONLY,
+                        NULL
+                      ) != SQLITE_OK )
+    {
+      fprintf( stderr, "sqlstore: %s\n", sqlite3_errmsg( db ) );
+      sqlite3_close( db );
+      return STORE_ERROR_FAIL;
+    }
+
+  sqlstore->aux = calloc( 1, sizeof( sqlstore_aux_t ) );
+  if ( sqlstore->aux == NULL )
+    {
+      sqlite3_close( db );
+      return STORE_ERROR_NOMEM;
+    }
+  as_sqla( sqlstore )->db      = db;
+  as_sqla( sqlstore )->lru     = NULL;
+  as_sqla( sqlstore )->lru_cap = SQLSTORE_LRU_CAP;
+
+  /* Catch a missing schema now rather than on the first lookup */
+  if ( ( sqls_stmt( sqlstore, SQLS_GET_MON ) == NULL ) ||
+       ( sqls_stmt( sqlstore, SQLS_GET_MOVE ) == NULL )
+     )
+    {
+      sqlstore_free( sqlstore );
+      return STORE_ERROR_BAD_VALUE;
+    }
+
+  return STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  void
+sqlstore_free( store_t * sqlstore )
+{
+  assert( sqlstore != NULL );
+  if ( sqlstore->aux == NULL ) return;
+
+  sqlstore_entry_t * curr = NULL;
+  sqlstore_entry_t * tmp  = NULL;
+  HASH_ITER( hh, as_sqla( sqlstore )->lru, curr, tmp )
+    {
+      HASH_DELETE( hh, as_sqla( sqlstore )->lru, curr );
+      free( curr );
+    }
+
+  for ( int i = 0; i < SQLS_STMT_CNT; i++ )
+    {
+      sqlite3_finalize( as_sqla( sqlstore )->stmts[i] );
+    }
+  sqlite3_close( as_sqla( sqlstore )->db );
+  free( sqlstore->aux );
+  sqlstore->aux = NULL;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+sqlstore_has( store_t * sqlstore, store_key_t key )
+{
+  return STORE_ERROR_NOT_FOUND != sqlstore_get( sqlstore, key, NULL );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+sqlstore_get_pokemon( sqlstore_t  *  sqlstore,
+                      uint16_t       dex_num,
+                      uint8_t        form_idx,
+                      pdex_mon_t  ** val
+                    )
+{
+  assert( sqlstore != NULL );
+
+  int                status = STORE_SUCCESS;
+  sqlstore_entry_t * entry  = sqls_lru_find( sqlstore,
+                                             sqls_mon_key( dex_num, form_idx )
+                                           );
+  if ( entry == NULL )
+    {
+      status = sqls_load_pokemon( sqlstore, dex_num, form_idx, & entry );
+      if ( status == STORE_SUCCESS ) sqls_lru_add( sqlstore, entry );
+    }
+
+  if ( val != NULL ) *val = ( entry != NULL ) ? & entry->mon : NULL;
+  return status;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+sqlstore_get_pokemon_by_name( sqlstore_t  *  sqlstore,
+                              const char  *  name,
+                              pdex_mon_t  ** val
+                            )
+{
+  assert( sqlstore != NULL );
+
+  sqlite3_stmt * stmt = sqls_stmt( sqlstore, SQLS_GET_MON_BY_NAME );
+  int            dex  = 0;
+
+  if ( stmt == NULL ) return STORE_ERROR_FAIL;
+  sqlite3_bind_text( stmt, 1, name, -1, SQLITE_STATIC );
+  if ( sqlite3_step( stmt ) == SQLITE_ROW ) dex = sqlite3_column_int( stmt, 0 );
+  sqls_stmt_done( stmt );
+
+  if ( dex == 0 )
+    {
+      if ( val != NULL ) *val = NULL;
+      return STORE_ERROR_NOT_FOUND;
+    }
+  return sqlstore_get_pokemon( sqlstore, dex, 0, val );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+sqlstore_get_move( sqlstore_t   *  sqlstore,
+                   uint16_t        move_id,
+                   store_move_t ** val
+                 )
+{
+  assert( sqlstore != NULL );
+
+  int                status = STORE_SUCCESS;
+  sqlstore_entry_t * entry  = sqls_lru_find( sqlstore,
+                                             sqls_move_key( move_id )
+                                           );
+  if ( entry == NULL )
+    {
+      status = sqls_load_move( sqlstore, move_id, & entry );
+      if ( status == STORE_SUCCESS ) sqls_lru_add( sqlstore, entry );
+    }
+
+  if ( val != NULL ) *val = ( entry != NULL ) ? & entry->move : NULL;
+  return status;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+sqlstore_get_move_by_name( sqlstore_t   *  sqlstore,
+                           const char   *  name,
+                           store_move_t ** val
+                         )
+{
+  assert( sqlstore != NULL );
+
+  sqlite3_stmt * stmt    = sqls_stmt( sqlstore, SQLS_GET_MOVE_BY_NAME );
+  int            move_id = 0;
+
+  if ( stmt == NULL ) return STORE_ERROR_FAIL;
+  sqlite3_bind_text( stmt, 1, name, -1, SQLITE_STATIC );
+  if ( sqlite3_step( stmt ) == SQLITE_ROW )
+    {
+      move_id = sqlite3_column_int( stmt, 0 );
+    }
+  sqls_stmt_done( stmt );
+
+  if ( move_id == 0 )
+    {
+      if ( val != NULL ) *val = NULL;
+      return STORE_ERROR_NOT_FOUND;
+    }
+  return sqlstore_get_move( sqlstore, move_id, val );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+sqlstore_get( store_t * sqlstore, store_key_t key, void ** val )
+{
+  assert( sqlstore != NULL );
+
+  if ( ( key.key_type == STORE_NUM  ) && ( key.val_type == STORE_MOVE ) )
+    {
+      return sqlstore_get_move( sqlstore,
+                                key.data_h0,
+                                (store_move_t **) val
+                              );
+    }
+  else if ( ( key.key_type == STORE_NUM ) &&
+            ( key.val_type == STORE_POKEDEX )
+          )
+    {
+      return sqlstore_get_pokemon( sqlstore,
+                                   key.data_h0,
+                                   key.data_q2,
+                                   (pdex_mon_t **) val
+                                 );
+    }
+  return STORE_ERROR_BAD_VALUE;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Values handed back earlier in the batch must outlive later loads, so the
+ * cache is allowed to grow past `lru_cap' until the batch is done.
+ */
+  int
+sqlstore_get_many( store_t           *  sqlstore,
+                   const store_key_t *  keys,
+                   size_t               n,
+                   void              ** vals,
+                   int               *  status
+                 )
+{
+  assert( sqlstore != NULL );
+  assert( ! as_sqla( sqlstore )->pinned );
+
+  as_sqla( sqlstore )->pinned = true;
+  int rsl = store_get_many_generic( sqlstore, keys, n, vals, status );
+  as_sqla( sqlstore )->pinned = false;
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Values are loaded through the cache one at a time, so a value passed to
+ * `cb' is only valid until the cache evicts it.
+ */
+  int
+sqlstore_each( store_t       * sqlstore,
+               store_type_t    val_type,
+               store_each_cb   cb,
+               void          * ctx
+             )
+{
+  assert( sqlstore != NULL );
+  assert( cb != NULL );
+
+  sqlite3_stmt * stmt = NULL;
+  store_key_t    key;
+  void         * val  = NULL;
+  int            rsl  = STORE_SUCCESS;
+
+  if ( ( val_type != STORE_POKEDEX ) && ( val_type != STORE_MOVE ) )
+    {
+      return STORE_ERROR_BAD_VALUE;
+    }
+  stmt = sqls_stmt( sqlstore,
+                    ( val_type == STORE_POKEDEX ) ? SQLS_EACH_MON
+                                                  : SQLS_EACH_MOVE
+                  );
+  if ( stmt == NULL ) return STORE_ERROR_FAIL;
+
+  while ( ( rsl == STORE_SUCCESS ) && ( sqlite3_step( stmt ) == SQLITE_ROW ) )
+    {
+      key = ( val_type == STORE_POKEDEX )
+            ? dex_form_store_key( sqlite3_column_int( stmt, 0 ),
+                                  sqlite3_column_int( stmt, 1 )
+                                )
+            : move_id_store_key( sqlite3_column_int( stmt, 0 ) );
+      rsl = sqlstore_get( sqlstore, key, & val );
+      if ( rsl == STORE_SUCCESS ) rsl = cb( ctx, key, val );
+    }
+  sqls_stmt_done( stmt );
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+sqlstore_get_str( store_t * sqlstore, const char * str, void ** val )
+{
+  assert( sqlstore != NULL );
+
+  if ( sqlstore_get_move_by_name( sqlstore,
+                                  str,
+                                  (store_move_t **) val
+                                ) == STORE_SUCCESS )
+    {
+      return STORE_SUCCESS;
+    }
+  return sqlstore_get_pokemon_by_name( sqlstore, str, (pdex_mon_t **) val );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+sqlstore_get_str_t( store_t      *  sqlstore,
+                    store_type_t    val_type,
+                    const char   *  str,
+                    void         ** val
+                  )
+{
+  assert( sqlstore != NULL );
+
+  if ( val_type == STORE_MOVE )
+    {
+      return sqlstore_get_move_by_name( sqlstore,
+                                        str,
+                                        (store_move_t **) val
+                                      );
+    }
+
+  if ( val_type == STORE_POKEDEX )
+    {
+      return sqlstore_get_pokemon_by_name( sqlstore,
+                                           str,
+                                           (pdex_mon_t **) val
+                                         );
+    }
+
+  return STORE_ERROR_BAD_VALUE;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
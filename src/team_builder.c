@@ -0,0 +1,634 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "ai/naive_ai.h"
+#include "matchup.h"
+#include "pokemon.h"
+#include "team_builder.h"
+#include "util/macros.h"
+#include "util/parallel.h"
+#include <assert.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Scores are kept as integers so that they add up the same way no matter
+ * which thread computes them: each column's weight is scaled so that the
+ * heaviest column gets `TB_WEIGHT_MAX', and a score is the weighted sum of
+ * best answers.
+ * A 1000 column meta in all 9 scenarios sums to less than 2^40.
+ */
+#define TB_WEIGHT_MAX  65535
+
+struct tb_team_s {
+  uint64_t score;
+  uint32_t rows[3];  /* Ascending matrix rows */
+};
+typedef struct tb_team_s  tb_team_t;
+
+/* Top `k' teams found by one worker, a min-heap on `tb_team_worse' */
+struct tb_heap_s {
+  tb_team_t * teams;
+  uint32_t    len;
+};
+typedef struct tb_heap_s  tb_heap_t;
+
+struct tb_search_s {
+  const matchup_matrix_t * matrix;
+  size_t                   ncells;   /* Ratings per row */
+  const uint32_t         * weights;  /* Per cell */
+  const uint32_t         * order;    /* Rows, strongest alone first */
+  const uint16_t         * sufmax;   /* Best of `order[i..]', per cell */
+  uint32_t                 k;
+  tb_heap_t              * heaps;    /* Per thread */
+  uint16_t               * scratch;  /* `ncells' per thread */
+  atomic_uint_fast64_t     threshold;
+};
+typedef struct tb_search_s  tb_search_t;
+
+
+/* -------------------------------------------------------------------------- */
+
+  static inline const uint16_t *
+tb_row( const tb_search_t * search, uint32_t row )
+{
+  return search->matrix->ratings + (size_t) row * search->ncells;
+}
+
+
+/* `a' is worse than `b': lower scoring, or tied with larger rows. */
+  static inline bool
+tb_team_worse( const tb_team_t * a, const tb_team_t * b )
+{
+  if ( a->score != b->score ) return a->score < b->score;
+  for ( uint8_t i = 0; i < 3; i++ )
+    {
+      if ( a->rows[i] != b->rows[i] ) return a->rows[i] > b->rows[i];
+    }
+  return false;
+}
+
+
+  static int
+tb_team_cmp( const void * a, const void * b )
+{
+  if ( tb_team_worse( (const tb_team_t *) b, (const tb_team_t *) a ) )
+    {
+      return -1;
+    }
+  if ( tb_team_worse( (const tb_team_t *) a, (const tb_team_t *) b ) )
+    {
+      return 1;
+    }
+  return 0;
+}
+
+
+  static void
+tb_heap_sift_down( tb_heap_t * heap, uint32_t i )
+{
+  while ( true )
+    {
+      uint32_t least = i;
+      uint32_t l     = 2 * i + 1;
+      uint32_t r     = l + 1;
+      if ( ( l < heap->len ) &&
+           tb_team_worse( heap->teams + l, heap->teams + least ) )
+        {
+          least = l;
+        }
+      if ( ( r < heap->len ) &&
+           tb_team_worse( heap->teams + r, heap->teams + least ) )
+        {
+          least = r;
+        }
+      if ( least == i ) return;
+      tb_team_t tmp      = heap->teams[i];
+      heap->teams[i]     = heap->teams[least];
+      heap->teams[least] = tmp;
+      i = least;
+    }
+}
+
+
+  static void
+tb_heap_sift_up( tb_heap_t * heap, uint32_t i )
+{
+  while ( 0 < i )
+    {
+      uint32_t parent = ( i - 1 ) / 2;
+      if ( ! tb_team_worse( heap->teams + i, heap->teams + parent ) ) return;
+      tb_team_t tmp       = heap->teams[i];
+      heap->teams[i]      = heap->teams[parent];
+      heap->teams[parent] = tmp;
+      i = parent;
+    }
+}
+
+
+/**
+ * Offer a team to a worker's heap, and once the heap is full raise the shared
+ * threshold to its k-th best score.
+ */
+  static void
+tb_offer( tb_search_t * search, tb_heap_t * heap, const tb_team_t * team )
+{
+  if ( heap->len < search->k )
+    {
+      heap->teams[heap->len] = * team;
+      tb_heap_sift_up( heap, heap->len++ );
+    }
+  else if ( tb_team_worse( heap->teams, team ) )
+    {
+      heap->teams[0] = * team;
+      tb_heap_sift_down( heap, 0 );
+    }
+  else
+    {
+      return;
+    }
+
+  if ( heap->len < search->k ) return;
+  uint_fast64_t thr  = heap->teams[0].score;
+  uint_fast64_t seen = atomic_load_explicit( & search->threshold,
+                                             memory_order_relaxed
+                                           );
+  while ( ( seen < thr ) &&
+          ( ! atomic_compare_exchange_weak_explicit( & search->threshold,
+                                                     & seen,
+                                                     thr,
+                                                     memory_order_relaxed,
+                                                     memory_order_relaxed
+                                                   ) ) );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Weighted sum of `max( a, b )' per cell, `b' may be `NULL'. */
+  static inline uint64_t
+tb_score( const tb_search_t * search, const uint16_t * a, const uint16_t * b )
+{
+  uint64_t score = 0;
+  if ( b == NULL )
+    {
+      for ( size_t c = 0; c < search->ncells; c++ )
+        {
+          score += (uint64_t) search->weights[c] * a[c];
+        }
+    }
+  else
+    {
+      for ( size_t c = 0; c < search->ncells; c++ )
+        {
+          score += (uint64_t) search->weights[c] * max( a[c], b[c] );
+        }
+    }
+  return score;
+}
+
+
+  static inline bool
+tb_pruned( tb_search_t * search, uint64_t bound )
+{
+  return bound < atomic_load_explicit( & search->threshold,
+                                       memory_order_relaxed
+                                     );
+}
+
+
+  static inline void
+tb_sort3( uint32_t rows[3] )
+{
+  uint32_t tmp;
+  if ( rows[1] < rows[0] ) { tmp = rows[0]; rows[0] = rows[1]; rows[1] = tmp; }
+  if ( rows[2] < rows[1] ) { tmp = rows[1]; rows[1] = rows[2]; rows[2] = tmp; }
+  if ( rows[1] < rows[0] ) { tmp = rows[0]; rows[0] = rows[1]; rows[1] = tmp; }
+}
+
+
+/**
+ * Search every team whose strongest member is `order[i]' for `i' in
+ * `[begin, end)'.
+ * Teammates are only taken from later in `order', so each team is visited
+ * once, and `sufmax' bounds what they can add.
+ */
+  static void
+tb_search_first( void * vsearch, uint32_t begin, uint32_t end, uint32_t t )
+{
+  tb_search_t    * search = (tb_search_t *) vsearch;
+  tb_heap_t      * heap   = search->heaps + t;
+  uint16_t       * pair   = search->scratch + (size_t) t * search->ncells;
+  const uint32_t   n      = search->matrix->nrows;
+  const size_t     nc     = search->ncells;
+
+  for ( uint32_t i = begin; i < end; i++ )
+    {
+      const uint16_t * ri = tb_row( search, search->order[i] );
+      if ( tb_pruned( search, tb_score( search, ri, search->sufmax +
+                                                    ( i + 1 ) * nc ) ) )
+        {
+          continue;
+        }
+      for ( uint32_t j = i + 1; j < n - 1; j++ )
+        {
+          const uint16_t * rj = tb_row( search, search->order[j] );
+          for ( size_t c = 0; c < nc; c++ ) pair[c] = max( ri[c], rj[c] );
+          if ( tb_pruned( search, tb_score( search, pair, search->sufmax +
+                                                          ( j + 1 ) * nc ) ) )
+            {
+              continue;
+            }
+          for ( uint32_t l = j + 1; l < n; l++ )
+            {
+              tb_team_t team = {
+                .score = tb_score( search, pair,
+                                   tb_row( search, search->order[l] )
+                                 ),
+                .rows  = { search->order[i],
+                           search->order[j],
+                           search->order[l]
+                         }
+              };
+              if ( tb_pruned( search, team.score ) ) continue;
+              tb_sort3( team.rows );
+              tb_offer( search, heap, & team );
+            }
+        }
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Scale per column `weights' to integers, repeated across scenarios.
+ * Missing, negative, or all zero weights count every column evenly.
+ */
+  static void
+tb_scale_weights( const matchup_matrix_t * matrix,
+                  const float            * weights,
+                  uint32_t               * out
+                )
+{
+  float heaviest = 0.0;
+  if ( weights != NULL )
+    {
+      for ( uint32_t c = 0; c < matrix->ncols; c++ )
+        {
+          if ( heaviest < weights[c] ) heaviest = weights[c];
+        }
+    }
+  for ( uint32_t c = 0; c < matrix->ncols; c++ )
+    {
+      uint32_t w = TB_WEIGHT_MAX;
+      if ( 0.0 < heaviest )
+        {
+          w = ( weights[c] <= 0.0 ) ? 0
+            : (uint32_t) lroundf( weights[c] / heaviest * TB_WEIGHT_MAX );
+        }
+      for ( uint8_t s = 0; s < matrix->nscenarios; s++ )
+        {
+          out[(size_t) s * matrix->ncols + c] = w;
+        }
+    }
+}
+
+
+struct tb_solo_s {
+  uint64_t score;
+  uint32_t row;
+};
+
+  static int
+tb_solo_cmp( const void * a, const void * b )
+{
+  const struct tb_solo_s * sa = (const struct tb_solo_s *) a;
+  const struct tb_solo_s * sb = (const struct tb_solo_s *) b;
+  if ( sa->score != sb->score ) return ( sa->score < sb->score ) ? 1 : -1;
+  return ( sa->row < sb->row ) ? -1 : ( sa->row > sb->row );
+}
+
+
+  int
+team_builder_search( const matchup_matrix_t    * matrix,
+                     const team_builder_opts_t * opts,
+                     team_pick_t               * teams,
+                     uint32_t                  * nteams
+                   )
+{
+  assert( matrix != NULL );
+  assert( matrix->ratings != NULL );
+  assert( nteams != NULL );
+
+  const team_builder_opts_t defaults = TEAM_BUILDER_OPTS_DEFAULT;
+  if ( opts == NULL ) opts = & defaults;
+  assert( ( teams != NULL ) || ( opts->k == 0 ) );
+
+  * nteams = 0;
+  if ( matrix->nrows < 3 ) return STORE_ERROR_BAD_VALUE;
+  if ( opts->k == 0 ) return STORE_SUCCESS;
+
+  const uint32_t n        = matrix->nrows;
+  const size_t   nc       = matchup_matrix_row_len( matrix );
+  const uint32_t nthreads = parallel_threads( n - 2, opts->nthreads );
+
+  tb_search_t search = {
+    .matrix = matrix,
+    .ncells = nc,
+    .k      = opts->k
+  };
+  atomic_init( & search.threshold, 0 );
+
+  uint32_t         * weights = (uint32_t *) malloc( sizeof( uint32_t ) *
+                                                    max( nc, 1 ) );
+  uint32_t         * order   = (uint32_t *) malloc( sizeof( uint32_t ) * n );
+  struct tb_solo_s * solo    =
+    (struct tb_solo_s *) malloc( sizeof( struct tb_solo_s ) * n );
+  uint16_t         * sufmax  =
+    (uint16_t *) malloc( sizeof( uint16_t ) * max( ( n + 1 ) * nc, 1 ) );
+  tb_heap_t        * heaps   =
+    (tb_heap_t *) calloc( nthreads, sizeof( tb_heap_t ) );
+  tb_team_t        * found   =
+    (tb_team_t *) malloc( sizeof( tb_team_t ) * nthreads * opts->k );
+  uint16_t         * scratch =
+    (uint16_t *) malloc( sizeof( uint16_t ) * max( nthreads * nc, 1 ) );
+  int                rsl     = STORE_SUCCESS;
+
+  if ( ( weights == NULL ) || ( order == NULL ) || ( solo == NULL ) ||
+       ( sufmax == NULL ) || ( heaps == NULL ) || ( found == NULL ) ||
+       ( scratch == NULL )
+     )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+
+  tb_scale_weights( matrix, opts->weights, weights );
+  search.weights = weights;
+
+  /* Strong Pokemon first, so good teams are found early and prune more */
+  for ( uint32_t r = 0; r < n; r++ )
+    {
+      solo[r].score = tb_score( & search, tb_row( & search, r ), NULL );
+      solo[r].row   = r;
+    }
+  qsort( solo, n, sizeof( struct tb_solo_s ), tb_solo_cmp );
+  for ( uint32_t i = 0; i < n; i++ ) order[i] = solo[i].row;
+  search.order = order;
+
+  memset( sufmax + (size_t) n * nc, 0, sizeof( uint16_t ) * nc );
+  for ( uint32_t i = n; 0 < i; i-- )
+    {
+      const uint16_t * r    = tb_row( & search, order[i - 1] );
+      const uint16_t * next = sufmax + (size_t) i * nc;
+      uint16_t       * cur  = sufmax + (size_t) ( i - 1 ) * nc;
+      for ( size_t c = 0; c < nc; c++ ) cur[c] = max( r[c], next[c] );
+    }
+  search.sufmax = sufmax;
+
+  for ( uint32_t t = 0; t < nthreads; t++ )
+    {
+      heaps[t].teams = found + (size_t) t * opts->k;
+    }
+  search.heaps   = heaps;
+  search.scratch = scratch;
+
+  /* Early first members have far more teammates to try, so go one by one */
+  if ( parallel_for( n - 2, 1, nthreads, tb_search_first, & search ) != 0 )
+    {
+      rsl = STORE_ERROR_NOMEM;
+      goto done;
+    }
+
+  /* Heaps sit back to back in `found', close the gaps and take the best */
+  uint32_t nfound = 0;
+  for ( uint32_t t = 0; t < nthreads; t++ )
+    {
+      memmove( found + nfound, heaps[t].teams,
+               sizeof( tb_team_t ) * heaps[t].len
+             );
+      nfound += heaps[t].len;
+    }
+  qsort( found, nfound, sizeof( tb_team_t ), tb_team_cmp );
+  nfound = min( nfound, opts->k );
+
+  uint64_t total = 0;
+  for ( size_t c = 0; c < nc; c++ ) total += weights[c];
+  for ( uint32_t i = 0; i < nfound; i++ )
+    {
+      team_builder_assign_roles( matrix, opts, found[i].rows, teams + i );
+      teams[i].score = ( total == 0 ) ? 0.0
+                       : (float) ( (double) found[i].score / total );
+    }
+  * nteams = nfound;
+
+done:
+  free( weights );
+  free( order );
+  free( solo );
+  free( sufmax );
+  free( heaps );
+  free( found );
+  free( scratch );
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Weighted mean of `row' in `scenario' over columns where `only_losses' is
+ * `NULL' or under `MATCHUP_RATING_TIE'.
+ * Returns -1 if no column qualifies.
+ */
+  static float
+tb_role_score( const matchup_matrix_t * matrix,
+               const float            * weights,
+               uint32_t                 row,
+               uint8_t                  s,
+               const uint16_t         * only_losses
+             )
+{
+  const uint16_t * r     = matchup_matrix_row( matrix, row, s );
+  double           sum   = 0.0;
+  double           total = 0.0;
+  for ( uint32_t c = 0; c < matrix->ncols; c++ )
+    {
+      if ( ( only_losses != NULL ) &&
+           ( MATCHUP_RATING_TIE <= only_losses[c] ) )
+        {
+          continue;
+        }
+      double w = ( weights == NULL ) ? 1.0 : max( weights[c], 0.0 );
+      sum   += w * r[c];
+      total += w;
+    }
+  return ( total == 0.0 ) ? -1.0 : (float) ( sum / total );
+}
+
+
+  static uint8_t
+tb_scenario_idx( const matchup_matrix_t * matrix, uint8_t scenario )
+{
+  int s = matchup_matrix_scenario_idx( matrix, scenario );
+  return ( s < 0 ) ? 0 : (uint8_t) s;
+}
+
+
+  void
+team_builder_assign_roles( const matchup_matrix_t    * matrix,
+                           const team_builder_opts_t * opts,
+                           const uint32_t              members[3],
+                           team_pick_t               * pick
+                         )
+{
+  static const uint8_t perms[6][3] = {
+    { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 },
+    { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 }
+  };
+
+  assert( matrix != NULL );
+  assert( members != NULL );
+  assert( pick != NULL );
+
+  const team_builder_opts_t defaults = TEAM_BUILDER_OPTS_DEFAULT;
+  if ( opts == NULL ) opts = & defaults;
+
+  const uint8_t lead_s   = tb_scenario_idx( matrix, opts->lead_scenario );
+  const uint8_t swap_s   = tb_scenario_idx( matrix, opts->swap_scenario );
+  const uint8_t closer_s = tb_scenario_idx( matrix, opts->closer_scenario );
+
+  float best = -1.0;
+  for ( uint8_t p = 0; p < 6; p++ )
+    {
+      uint32_t lead   = members[perms[p][TEAM_LEAD]];
+      uint32_t swap   = members[perms[p][TEAM_SWAP]];
+      uint32_t closer = members[perms[p][TEAM_CLOSER]];
+
+      float lead_score = tb_role_score( matrix, opts->weights, lead, lead_s,
+                                        NULL
+                                      );
+      /* The swap is judged on the matchups the lead loses, if any */
+      float swap_score = tb_role_score( matrix, opts->weights, swap, swap_s,
+                                        matchup_matrix_row( matrix, lead,
+                                                            lead_s
+                                                          )
+                                      );
+      if ( swap_score < 0.0 )
+        {
+          swap_score = tb_role_score( matrix, opts->weights, swap, swap_s,
+                                      NULL
+                                    );
+        }
+      float closer_score = tb_role_score( matrix, opts->weights, closer,
+                                          closer_s, NULL
+                                        );
+
+      float sum = lead_score + swap_score + closer_score;
+      if ( best < sum )
+        {
+          best                           = sum;
+          pick->members[TEAM_LEAD]       = lead;
+          pick->members[TEAM_SWAP]       = swap;
+          pick->members[TEAM_CLOSER]     = closer;
+          pick->role_scores[TEAM_LEAD]   = max( lead_score, 0.0 );
+          pick->role_scores[TEAM_SWAP]   = max( swap_score, 0.0 );
+          pick->role_scores[TEAM_CLOSER] = max( closer_score, 0.0 );
+        }
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  ai_status_t
+team_builder_select_team( roster_t      * our_roster,
+                          roster_t      * their_roster,
+                          pvp_pokemon_t * team, /* EXACTLY 3 ELEMENTS */
+                          store_t       * store,
+                          void          * aux
+                        )
+{
+  if ( our_roster == NULL ) return AI_ERROR_BAD_VALUE;
+  if ( team == NULL ) return AI_ERROR_BAD_VALUE;
+
+  if ( ( our_roster->roster_length < 3 ) || ( their_roster == NULL ) ||
+       ( their_roster->roster_length == 0 )
+     )
+    {
+      return naive_ai_select_team( our_roster, their_roster, team, store,
+                                   aux
+                                 );
+    }
+
+  const team_builder_opts_t defaults = TEAM_BUILDER_OPTS_DEFAULT;
+  team_builder_opts_t opts = ( aux == NULL ) ? defaults
+                                             : * (team_builder_opts_t *) aux;
+  opts.k = 1;
+
+  const matchup_opts_t mopts = {
+    .scenarios = MATCHUP_STANDARD_SCENARIOS_M |
+                 matchup_scenario_mask( opts.lead_scenario ) |
+                 matchup_scenario_mask( opts.swap_scenario ) |
+                 matchup_scenario_mask( opts.closer_scenario ),
+    .nthreads  = opts.nthreads,
+    .cache     = opts.cache
+  };
+
+  const size_t     nours   = our_roster->roster_length;
+  const size_t     ntheirs = their_roster->roster_length;
+  pvp_pokemon_t  * mons    =
+    (pvp_pokemon_t *) malloc( sizeof( pvp_pokemon_t ) * ( nours + ntheirs ) );
+  matchup_matrix_t matrix  = MATCHUP_MATRIX_INIT;
+  team_pick_t      pick;
+  uint32_t         npicks  = 0;
+  ai_status_t      rsl     = AI_SUCCESS;
+  int              srsl    = STORE_SUCCESS;
+
+  if ( mons == NULL ) return AI_ERROR_NOMEM;
+
+  srsl = pvp_pokemon_init_many( mons, our_roster->roster_pokemon, nours,
+                                store
+                              );
+  if ( srsl != STORE_SUCCESS ) goto done;
+  srsl = pvp_pokemon_init_many( mons + nours, their_roster->roster_pokemon,
+                                ntheirs, store
+                              );
+  if ( srsl != STORE_SUCCESS ) goto done;
+
+  srsl = matchup_matrix_build( & matrix, mons, nours, mons + nours, ntheirs,
+                               & mopts
+                             );
+  if ( srsl != STORE_SUCCESS ) goto done;
+
+  srsl = team_builder_search( & matrix, & opts, & pick, & npicks );
+  if ( srsl != STORE_SUCCESS ) goto done;
+  assert( npicks == 1 );
+
+  for ( uint8_t i = 0; i < 3; i++ ) team[i] = mons[pick.members[i]];
+
+done:
+  if ( srsl == STORE_ERROR_NOMEM )       rsl = AI_ERROR_NOMEM;
+  else if ( srsl != STORE_SUCCESS )      rsl = AI_ERROR_FAIL;
+  matchup_matrix_free( & matrix );
+  free( mons );
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -24,6 +24,25 @@ test_all( void )
   rsl &= do_test( naive_ai );
   rsl &= do_test( filter );
   rsl &= do_test( fuzzy );
+  rsl &= do_test( snapstore );
+  rsl &= do_test( sqlstore );
+  rsl &= do_test( overlay_store );
+  rsl &= do_test( name_index );
+  rsl &= do_test( parse_csv );
+  rsl &= do_test( rosterstore );
+  rsl &= do_test( filter_index );
+  rsl &= do_test( cupstore );
+  rsl &= do_test( dense_index );
+  rsl &= do_test( team_builder );
+  rsl &= do_test( ranking );
+  rsl &= do_test( moveset );
+  rsl &= do_test( matchup_cache );
+  rsl &= do_test( matchup_file );
+  rsl &= do_test( counter );
+  rsl &= do_test( coverage );
+  rsl &= do_test( nash );
+  rsl &= do_test( replicator );
+  rsl &= do_test( ladder );
   return rsl;
 }
 
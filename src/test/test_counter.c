@@ -0,0 +1,328 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "counter.h"
+#include "cupstore.h"
+#include "matchup.h"
+#include "moveset.h"
+#include "pokedex.h"
+#include "pokemon.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+static store_t CUPS = def_cupstore();
+
+/* The Kanto Pokedex */
+#define TEST_CUP_QUERY  "dex:1-151"
+#define TEST_CP_CAP     1500
+#define TEST_NTEAM      3
+#define TEST_K          5
+#define TEST_NMONS      256
+
+/* Venusaur, Charizard, and Blastoise */
+static const uint16_t TEAM_DEX[TEST_NTEAM] = { 3, 6, 9 };
+
+
+/**
+ * Every Fast Move of species `dex', each with its first Charged Moves,
+ * appended to `mons' at `level'.
+ */
+  static bool
+add_mons( pvp_pokemon_t * mons,
+          uint32_t      * n,
+          uint16_t        dex,
+          uint8_t         level
+        )
+{
+  roster_pokemon_t rmon;
+  base_pokemon_t   base;
+
+  if ( base_mon_from_store( & CSTORE, dex, 0, level, 15, 15, 15, & base )
+       != STORE_SUCCESS )
+    {
+      return true;
+    }
+  const pdex_mon_t * pdex = base.pdex_mon;
+  if ( pdex->charged_moves_cnt == 0 ) return true;
+  for ( uint8_t f = 0; ( f < pdex->fast_moves_cnt ) && ( * n < TEST_NMONS );
+        f++ )
+    {
+      rmon = (roster_pokemon_t) {
+        .base             = & base,
+        .fast_move_id     = abs( pdex->fast_move_ids[f] ),
+        .charged_move_ids = {
+          abs( pdex->charged_move_ids[0] ),
+          ( 1 < pdex->charged_moves_cnt ) ? abs( pdex->charged_move_ids[1] )
+                                          : 0
+        }
+      };
+      if ( pvp_pokemon_init_many( mons + * n, & rmon, 1, & CSTORE ) !=
+           STORE_SUCCESS )
+        {
+          return false;
+        }
+      ( * n )++;
+    }
+  return true;
+}
+
+
+  static bool
+make_team( pvp_pokemon_t * team )
+{
+  pvp_pokemon_t mons[TEST_NMONS];
+  for ( uint32_t i = 0; i < TEST_NTEAM; i++ )
+    {
+      uint32_t n = 0;
+      if ( ! add_mons( mons, & n, TEAM_DEX[i], 20 ) || ( n == 0 ) )
+        {
+          return false;
+        }
+      team[i] = mons[0];
+    }
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_counter_bound( void )
+{
+  pvp_pokemon_t team[TEST_NTEAM];
+  pvp_pokemon_t mons[TEST_NMONS];
+  uint32_t      n        = 0;
+  uint32_t      nlosing  = 0;
+  uint32_t      ntotal   = 0;
+
+  expect( make_team( team ) );
+  for ( uint16_t dex = 1; dex <= 151; dex++ )
+    {
+      expect( add_mons( mons, & n, dex, 20 + dex % 11 ) );
+    }
+  expect( 151 < n );
+
+  /* Never below the real rating */
+  for ( uint32_t m = 0; m < n; m++ )
+    {
+      for ( uint32_t o = 0; o < TEST_NTEAM; o++ )
+        {
+          for ( uint8_t s = 0; s < MATCHUP_NSCENARIOS; s++ )
+            {
+              uint16_t bound  = counter_bound( mons + m, team + o, s );
+              uint16_t rating = matchup_battle( mons + m, team + o, s );
+              expect( rating <= bound );
+              expect( bound <= MATCHUP_RATING_MAX );
+              nlosing += ( bound < MATCHUP_RATING_TIE );
+              ntotal++;
+            }
+        }
+    }
+  /* And often low enough to rule out a win */
+  expect( ntotal / 10 < nlosing );
+
+  /* Shields only help */
+  for ( uint32_t m = 0; m < n; m++ )
+    {
+      expect( counter_bound( mons + m, team, matchup_scenario( 0, 2 ) ) <=
+              counter_bound( mons + m, team, matchup_scenario( 2, 0 ) )
+            );
+    }
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+struct brute_s {
+  float    score;
+  uint32_t species;
+};
+
+  static int
+brute_cmp( const void * a, const void * b )
+{
+  const struct brute_s * ba = (const struct brute_s *) a;
+  const struct brute_s * bb = (const struct brute_s *) b;
+  if ( ba->score != bb->score ) return ( ba->score < bb->score ) ? 1 : -1;
+  return ( ba->species > bb->species ) - ( ba->species < bb->species );
+}
+
+
+  static bool
+test_counter_search( void )
+{
+  cup_t            * cup     = NULL;
+  pvp_pokemon_t      team[TEST_NTEAM];
+  counter_search_t   search  = COUNTER_SEARCH_INIT;
+  counter_search_t   threads = COUNTER_SEARCH_INIT;
+  counter_opts_t     opts    = COUNTER_OPTS_DEFAULT;
+  moveset_league_t   league  = MOVESET_LEAGUE_INIT;
+  moveset_opts_t     mopts   = MOVESET_OPTS_DEFAULT;
+
+  expect( cupstore_get_str( & CUPS, "TEST_CUP", (void **) & cup ) ==
+          STORE_SUCCESS
+        );
+  expect( make_team( team ) );
+
+  opts.nthreads = 1;
+  expect( counter_search( & search, cup, team, TEST_NTEAM, TEST_K, & opts )
+          == STORE_SUCCESS
+        );
+  expect( search.ncounters == TEST_K );
+  expect( ( 0 < search.nspecies ) && ( search.nspecies <= cup->pool_size ) );
+  expect( search.nspecies < search.ncandidates );
+  /* Most candidates are never simulated */
+  expect( search.nsimulated < search.ncandidates / 2 );
+
+  /* The same as simulating everything */
+  mopts.prune = false;
+  expect( moveset_optimize( & league, cup, team, TEST_NTEAM, & mopts ) ==
+          STORE_SUCCESS
+        );
+  expect( league.nspecies == search.nspecies );
+  expect( league.nsimulated == search.ncandidates );
+  struct brute_s * brute = (struct brute_s *)
+    malloc( sizeof( struct brute_s ) * league.nspecies );
+  expect( brute != NULL );
+  for ( uint32_t s = 0; s < league.nspecies; s++ )
+    {
+      brute[s] = (struct brute_s) {
+        .score   = league.best[s].score,
+        .species = s
+      };
+    }
+  qsort( brute, league.nspecies, sizeof( struct brute_s ), brute_cmp );
+  for ( uint32_t i = 0; i < search.ncounters; i++ )
+    {
+      const counter_t      * c = search.counters + i;
+      const moveset_best_t * b = league.best + brute[i].species;
+      expect( fabsf( c->score - b->score ) < 0.01 );
+      if ( ( i + 1 < league.nspecies ) &&
+           ( 0.01 < brute[i].score - brute[i + 1].score ) &&
+           ( ( i == 0 ) || ( 0.01 < brute[i - 1].score - brute[i].score ) ) )
+        {
+          expect( ( c->dex_number == b->dex_number ) &&
+                  ( c->form_idx == b->form_idx ) && ( c->level == b->level )
+                );
+        }
+      if ( 0 < i ) expect( c->score <= search.counters[i - 1].score );
+    }
+  free( brute );
+  moveset_league_free( & league );
+
+  /* Threads change nothing */
+  opts.nthreads = 4;
+  expect( counter_search( & threads, cup, team, TEST_NTEAM, TEST_K, & opts )
+          == STORE_SUCCESS
+        );
+  expect( threads.nsimulated == search.nsimulated );
+  expect( memcmp( threads.counters, search.counters,
+                  sizeof( counter_t ) * TEST_K
+                ) == 0
+        );
+  counter_search_free( & threads );
+  counter_search_free( & search );
+  expect( search.counters == NULL );
+
+  /* Asking for every species simulates them all */
+  expect( counter_search( & search, cup, team, TEST_NTEAM, UINT32_MAX,
+                          & opts
+                        ) == STORE_SUCCESS
+        );
+  expect( search.ncounters == search.nspecies );
+  counter_search_free( & search );
+
+  return true;
+}
+
+
+  static bool
+test_counter_errors( void )
+{
+  cup_t            * cup    = NULL;
+  cup_t            * empty  = NULL;
+  pvp_pokemon_t      team[TEST_NTEAM];
+  counter_search_t   search = COUNTER_SEARCH_INIT;
+  counter_opts_t     opts   = COUNTER_OPTS_DEFAULT;
+
+  expect( cupstore_get_str( & CUPS, "TEST_CUP", (void **) & cup ) ==
+          STORE_SUCCESS
+        );
+  expect( cupstore_get_str( & CUPS, "EMPTY_CUP", (void **) & empty ) ==
+          STORE_SUCCESS
+        );
+  expect( make_team( team ) );
+
+  expect( counter_search( & search, cup, team, 0, TEST_K, NULL ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  expect( counter_search( & search, cup, team, TEST_NTEAM, 0, NULL ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  opts.scenarios = 0;
+  expect( counter_search( & search, cup, team, TEST_NTEAM, TEST_K, & opts )
+          == STORE_ERROR_BAD_VALUE
+        );
+  expect( counter_search( & search, empty, team, TEST_NTEAM, TEST_K, NULL )
+          == STORE_ERROR_NOT_FOUND
+        );
+  expect( search.counters == NULL );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_counter( void )
+{
+  bool rsl = true;
+
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= CUPS.init( & CUPS, & CSTORE ) == STORE_SUCCESS;
+  rsl &= cupstore_add_cup( & CUPS, "TEST_CUP", TEST_CP_CAP, TEST_CUP_QUERY )
+         == STORE_SUCCESS;
+  rsl &= cupstore_add_cup( & CUPS, "EMPTY_CUP", TEST_CP_CAP, "!all" )
+         == STORE_SUCCESS;
+  rsl &= do_test( counter_bound );
+  rsl &= do_test( counter_search );
+  rsl &= do_test( counter_errors );
+  CUPS.free( & CUPS );
+  CS_free();
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_counter() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,306 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "coverage.h"
+#include "matchup.h"
+#include "util/macros.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/test_util.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+/* More than a word of columns, so scenarios end mid word */
+#define TEST_NROWS  40
+#define TEST_NCOLS  90
+
+
+/**
+ * Made up ratings, with some rows much stronger than others.
+ * Ratings of exactly `MATCHUP_RATING_TIE' show up too, and are not wins.
+ */
+  static bool
+make_matrix( matchup_matrix_t * matrix )
+{
+  uint32_t seed = 12345;
+
+  * matrix = (matchup_matrix_t) {
+    .nrows      = TEST_NROWS,
+    .ncols      = TEST_NCOLS,
+    .nscenarios = 3,
+    .scenarios  = { matchup_scenario( 0, 0 ), matchup_scenario( 1, 1 ),
+                    matchup_scenario( 2, 2 )
+                  },
+    .ratings    = (uint16_t *)
+      malloc( sizeof( uint16_t ) * TEST_NROWS * 3 * TEST_NCOLS )
+  };
+  if ( matrix->ratings == NULL ) return false;
+
+  for ( uint32_t i = 0; i < TEST_NROWS * 3 * TEST_NCOLS; i++ )
+    {
+      uint32_t r = i / ( 3 * TEST_NCOLS );
+      seed = seed * 1103515245 + 12345;
+      uint32_t rating = ( ( seed >> 16 ) % 1001 ) * ( 40 + r % 7 ) / 50;
+      if ( ( seed >> 8 ) % 97 == 0 ) rating = MATCHUP_RATING_TIE;
+      matrix->ratings[i] = (uint16_t) min( rating, MATCHUP_RATING_MAX );
+    }
+  return true;
+}
+
+
+/* Weight of `rows' counted the slow way */
+  static uint64_t
+brute_weight( const matchup_matrix_t * matrix,
+              const uint32_t         * weights,
+              const uint32_t         * rows,
+              uint8_t                  n
+            )
+{
+  uint64_t weight = 0;
+  for ( uint8_t s = 0; s < matrix->nscenarios; s++ )
+    {
+      for ( uint32_t c = 0; c < matrix->ncols; c++ )
+        {
+          for ( uint8_t m = 0; m < n; m++ )
+            {
+              if ( MATCHUP_RATING_TIE <
+                   matchup_matrix_get( matrix, rows[m], s, c ) )
+                {
+                  weight += ( weights == NULL ) ? 1 : weights[c];
+                  break;
+                }
+            }
+        }
+    }
+  return weight;
+}
+
+
+/* The best team, lowest rows on ties, by trying them all */
+  static uint64_t
+brute_best( const coverage_t * cov, uint32_t best[3] )
+{
+  uint64_t most = 0;
+  for ( uint32_t i = 0; i < cov->nrows; i++ )
+    {
+      for ( uint32_t j = i + 1; j < cov->nrows; j++ )
+        {
+          for ( uint32_t l = j + 1; l < cov->nrows; l++ )
+            {
+              uint32_t rows[3] = { i, j, l };
+              uint64_t weight  = coverage_weight( cov, rows, 3 );
+              if ( most < weight )
+                {
+                  most = weight;
+                  memcpy( best, rows, sizeof( rows ) );
+                }
+            }
+        }
+    }
+  return most;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_coverage_weights( void )
+{
+  matchup_matrix_t matrix  = MATCHUP_MATRIX_INIT;
+  coverage_t       cov     = COVERAGE_INIT;
+  float            weights[TEST_NCOLS];
+  uint32_t         scaled[TEST_NCOLS];
+
+  expect( make_matrix( & matrix ) );
+
+  /* Unweighted, every column counts 1 */
+  expect( coverage_init( & cov, & matrix, NULL, MATCHUP_RATING_TIE ) ==
+          STORE_SUCCESS
+        );
+  expect( cov.nplanes == 1 );
+  expect( cov.total == 3 * TEST_NCOLS );
+  for ( uint32_t r = 0; r + 2 < TEST_NROWS; r++ )
+    {
+      uint32_t rows[3] = { r, r + 1, r + 2 };
+      for ( uint8_t n = 1; n <= 3; n++ )
+        {
+          expect( coverage_weight( & cov, rows, n ) ==
+                  brute_weight( & matrix, NULL, rows, n )
+                );
+        }
+    }
+  coverage_free( & cov );
+  expect( cov.wins == NULL );
+
+  /* Weighted, rounded to `COVERAGE_WEIGHT_BITS' */
+  for ( uint32_t c = 0; c < TEST_NCOLS; c++ )
+    {
+      weights[c] = ( c % 10 == 0 ) ? -1.0 : (float) ( c % 13 ) / 2;
+      scaled[c]  = ( weights[c] <= 0.0 ) ? 0 :
+                   (uint32_t) lroundf( weights[c] / 6.0 * COVERAGE_WEIGHT_MAX );
+    }
+  expect( coverage_init( & cov, & matrix, weights, MATCHUP_RATING_TIE ) ==
+          STORE_SUCCESS
+        );
+  expect( cov.nplanes == COVERAGE_WEIGHT_BITS );
+  for ( uint32_t r = 0; r + 2 < TEST_NROWS; r++ )
+    {
+      uint32_t rows[3] = { r, r + 1, r + 2 };
+      expect( coverage_weight( & cov, rows, 3 ) ==
+              brute_weight( & matrix, scaled, rows, 3 )
+            );
+    }
+  coverage_free( & cov );
+
+  /* A threshold over every rating covers nothing */
+  expect( coverage_init( & cov, & matrix, NULL, MATCHUP_RATING_MAX ) ==
+          STORE_SUCCESS
+        );
+  uint32_t all[3] = { 0, 1, 2 };
+  expect( coverage_weight( & cov, all, 3 ) == 0 );
+  coverage_free( & cov );
+
+  matchup_matrix_free( & matrix );
+  return true;
+}
+
+
+  static bool
+test_coverage_search( void )
+{
+  matchup_matrix_t matrix  = MATCHUP_MATRIX_INIT;
+  coverage_t       cov     = COVERAGE_INIT;
+  coverage_opts_t  opts    = COVERAGE_OPTS_DEFAULT;
+  coverage_team_t  exact;
+  coverage_team_t  threads;
+  coverage_team_t  greedy;
+  uint32_t         best[3];
+  float            weights[TEST_NCOLS];
+  const uint64_t   nteams  = TEST_NROWS * ( TEST_NROWS - 1 ) *
+                             ( TEST_NROWS - 2 ) / 6;
+
+  expect( make_matrix( & matrix ) );
+  for ( uint32_t c = 0; c < TEST_NCOLS; c++ )
+    {
+      weights[c] = 1.0 + c % 5;
+    }
+
+  for ( uint8_t weighted = 0; weighted < 2; weighted++ )
+    {
+      expect( coverage_init( & cov, & matrix, weighted ? weights : NULL,
+                             MATCHUP_RATING_TIE
+                           ) == STORE_SUCCESS
+            );
+      uint64_t most = brute_best( & cov, best );
+
+      /* Exact matches trying every team, without scoring them all */
+      opts.mode     = COVERAGE_EXACT;
+      opts.nthreads = 1;
+      expect( coverage_search( & cov, & opts, & exact ) == STORE_SUCCESS );
+      expect( exact.weight == most );
+      expect( memcmp( exact.members, best, sizeof( best ) ) == 0 );
+      expect( exact.share == (float) ( (double) most / cov.total ) );
+      expect( exact.nscored < nteams );
+
+      opts.nthreads = 4;
+      expect( coverage_search( & cov, & opts, & threads ) == STORE_SUCCESS );
+      expect( memcmp( threads.members, exact.members, sizeof( best ) ) == 0 );
+      expect( threads.weight == exact.weight );
+
+      /* Greedy is no better, and no single swap improves it */
+      opts.mode = COVERAGE_GREEDY;
+      expect( coverage_search( & cov, & opts, & greedy ) == STORE_SUCCESS );
+      expect( greedy.weight <= exact.weight );
+      expect( greedy.weight == coverage_weight( & cov, greedy.members, 3 ) );
+      expect( ( greedy.members[0] < greedy.members[1] ) &&
+              ( greedy.members[1] < greedy.members[2] )
+            );
+      for ( uint8_t m = 0; m < 3; m++ )
+        {
+          for ( uint32_t r = 0; r < TEST_NROWS; r++ )
+            {
+              uint32_t rows[3] = { greedy.members[0], greedy.members[1],
+                                   greedy.members[2]
+                                 };
+              rows[m] = r;
+              expect( coverage_weight( & cov, rows, 3 ) <= greedy.weight );
+            }
+        }
+      coverage_free( & cov );
+    }
+
+  matchup_matrix_free( & matrix );
+  return true;
+}
+
+
+  static bool
+test_coverage_errors( void )
+{
+  matchup_matrix_t matrix = MATCHUP_MATRIX_INIT;
+  coverage_t       cov    = COVERAGE_INIT;
+  coverage_team_t  team;
+
+  expect( make_matrix( & matrix ) );
+  matrix.nrows = 2;
+  expect( coverage_init( & cov, & matrix, NULL, MATCHUP_RATING_TIE ) ==
+          STORE_SUCCESS
+        );
+  expect( coverage_search( & cov, NULL, & team ) == STORE_ERROR_BAD_VALUE );
+  coverage_free( & cov );
+
+  /* Exactly 3 rows is the only team */
+  matrix.nrows = 3;
+  expect( coverage_init( & cov, & matrix, NULL, MATCHUP_RATING_TIE ) ==
+          STORE_SUCCESS
+        );
+  expect( coverage_search( & cov, NULL, & team ) == STORE_SUCCESS );
+  expect( ( team.members[0] == 0 ) && ( team.members[1] == 1 ) &&
+          ( team.members[2] == 2 )
+        );
+  coverage_free( & cov );
+
+  matchup_matrix_free( & matrix );
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_coverage( void )
+{
+  bool rsl = true;
+
+  rsl &= do_test( coverage_weights );
+  rsl &= do_test( coverage_search );
+  rsl &= do_test( coverage_errors );
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_coverage() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -4,6 +4,7 @@
 
 #include "pokedex.h"
 #include "pokemon.h"
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -12,6 +13,13 @@
 #define CSTORE_GLOBAL_STORE
 #include "cstore.h"
 
+extern pdex_mon_t * POKEDEX[];
+extern store_move_t MOVES[];
+extern uint16_t     NUM_POKEMON;
+extern uint16_t     NUM_MOVES;
+
+#define CSTORE_TEST_THREADS  8
+
 
 /* -------------------------------------------------------------------------- */
 
@@ -61,6 +69,26 @@ test_cstore_get_pokemon( void )
   expect( mon->dex_number == 649 );
   expect( mon->form_idx   == 0 );
 
+  /* Past Meltan and Melmetal */
+  rsl = cstore_get_pokemon( & CSTORE, 862, 0, & mon );
+  expect( rsl == STORE_SUCCESS );
+  expect( mon != NULL );
+  expect( mon->dex_number == 862 );
+  expect( mon->form_idx   == 0 );
+
+  rsl = cstore_get_pokemon( & CSTORE, 0, 0, & mon );
+  expect( rsl == STORE_ERROR_NOT_FOUND );
+  expect( mon == NULL );
+
+  rsl = cstore_get_pokemon( & CSTORE, 750, 0, & mon );
+  expect( rsl == STORE_ERROR_NOT_FOUND );
+
+  rsl = cstore_get_pokemon( & CSTORE, 9999, 0, & mon );
+  expect( rsl == STORE_ERROR_NOT_FOUND );
+
+  rsl = cstore_get_pokemon( & CSTORE, 1, 200, & mon );
+  expect( rsl == STORE_ERROR_NOT_FOUND );
+
   return true;
 }
 
@@ -140,6 +168,139 @@ test_cstore_get( void )
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_cstore_get_many( void )
+{
+  const store_key_t keys[] = {
+    dex_form_store_key( 1, 0 ),
+    move_id_store_key( 13 ),
+    move_id_store_key( 13 ),
+    dex_form_store_key( 1, 200 ),
+    { .key_type = STORE_STRING, .val_type = STORE_MOVE }
+  };
+  void * vals[5]   = { NULL };
+  void * slow[5]   = { NULL };
+  int    status[5] = { STORE_NULL_STATUS };
+
+  int rsl = cstore_get_many( & CSTORE, keys, 5, vals, status );
+  expect( rsl == STORE_ERROR_NOT_FOUND );
+  expect( status[0] == STORE_SUCCESS );
+  expect( ( (pdex_mon_t *) vals[0] )->dex_number == 1 );
+  expect( status[1] == STORE_SUCCESS );
+  expect( ( (store_move_t *) vals[1] )->move_id == 13 );
+  expect( status[2] == STORE_SUCCESS );
+  expect( vals[2] == vals[1] );
+  expect( status[3] == STORE_ERROR_NOT_FOUND );
+  expect( vals[3] == NULL );
+  expect( status[4] == STORE_ERROR_BAD_VALUE );
+
+  /* The generic fallback should agree */
+  store_get_many_generic( & CSTORE, keys, 4, slow, NULL );
+  for ( int i = 0; i < 4; i++ ) expect( vals[i] == slow[i] );
+
+  expect( cstore_get_many( & CSTORE, keys, 3, vals, NULL ) == STORE_SUCCESS );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Look up every Pokemon and Move by name, and by key. */
+  static bool
+cstore_read_all( store_t * cstore )
+{
+  pdex_mon_t   * mon  = NULL;
+  store_move_t * move = NULL;
+
+  for ( uint16_t i = 0; i < NUM_POKEMON; i++ )
+    {
+      for ( pdex_mon_t * m = POKEDEX[i]; m != NULL; m = m->next_form )
+        {
+          expect( cstore_get_pokemon( cstore,
+                                      m->dex_number,
+                                      m->form_idx,
+                                      & mon
+                                    ) == STORE_SUCCESS
+                );
+          expect( mon == m );
+        }
+    }
+
+  for ( uint16_t i = 0; i < NUM_POKEMON; i++ )
+    {
+      expect( cstore_get_pokemon_by_name( cstore, POKEDEX[i]->name, & mon ) ==
+              STORE_SUCCESS
+            );
+      expect( mon == POKEDEX[i] );
+    }
+
+  for ( uint16_t i = 0; i < NUM_MOVES; i++ )
+    {
+      expect( cstore_get_move( cstore, MOVES[i].move_id, & move ) ==
+              STORE_SUCCESS
+            );
+      expect( move == MOVES + i );
+      expect( cstore_get_move_by_name( cstore, MOVES[i].name, & move ) ==
+              STORE_SUCCESS
+            );
+      expect( move == MOVES + i );
+    }
+
+  return true;
+}
+
+
+  static void *
+cstore_reader( void * cstore )
+{
+  bool rsl = true;
+  for ( int i = 0; ( i < 16 ) && rsl; i++ ) rsl = cstore_read_all( cstore );
+  return rsl ? cstore : NULL;
+}
+
+
+/**
+ * Readers share `CSTORE' without any locking, while a second `cstore' comes
+ * and goes; it shares the same index so this must not disturb them.
+ */
+  static bool
+test_cstore_concurrent_read( void )
+{
+  pthread_t threads[CSTORE_TEST_THREADS];
+  void    * rsl[CSTORE_TEST_THREADS];
+  store_t   other = def_cstore();
+
+  expect( !! ( CSTORE.flags & SF_THREAD_SAFE_M ) );
+
+  for ( int i = 0; i < CSTORE_TEST_THREADS; i++ )
+    {
+      expect( pthread_create( threads + i, NULL, cstore_reader, & CSTORE ) ==
+              0
+            );
+    }
+
+  expect( cstore_init( & other, NULL ) == STORE_SUCCESS );
+  expect( as_csa( & other ) == as_csa( & CSTORE ) );
+  bool other_ok = cstore_read_all( & other );
+  cstore_free( & other );
+
+  for ( int i = 0; i < CSTORE_TEST_THREADS; i++ )
+    {
+      pthread_join( threads[i], rsl + i );
+    }
+
+  expect( other_ok );
+  for ( int i = 0; i < CSTORE_TEST_THREADS; i++ ) expect( rsl[i] != NULL );
+  /* Freeing `other' must not have cleared the shared index */
+  expect( cstore_read_all( & CSTORE ) );
+
+  return true;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   bool
@@ -152,6 +313,8 @@ test_cstore( void )
   rsl &= do_test( cstore_get_move );
   rsl &= do_test( cstore_get_move_by_name );
   rsl &= do_test( cstore_get );
+  rsl &= do_test( cstore_get_many );
+  rsl &= do_test( cstore_concurrent_read );
   CS_free();
   return rsl;
 }
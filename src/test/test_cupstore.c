@@ -0,0 +1,363 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "cup.h"
+#include "cupstore.h"
+#include "filter.h"
+#include "filter_index.h"
+#include "overlay_store.h"
+#include "pokedex.h"
+#include "util/bitset.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+static filter_index_t   IDX;
+static pdex_mon_t    ** MONS = NULL;  /* By dense index */
+
+
+/* Fill `MONS' from `store_each', without going through `get'. */
+  static int
+collect_cb( void * ctx, store_key_t key, void * val )
+{
+  pdex_mon_t * mon = (pdex_mon_t *) val;
+  uint32_t     i   = 0;
+  int rsl = filter_index_find( & IDX, mon->dex_number, mon->form_idx, & i );
+  if ( rsl == STORE_SUCCESS ) MONS[i] = mon;
+  return rsl;
+}
+
+
+/* A move the store can find by name, but which isn't in `IDX' */
+static store_move_t UNINDEXED_MOVE = {
+  .name = "UNINDEXED", .type = NORMAL, .move_id = 9999
+};
+
+  static int
+unindexed_get_str_t( store_t      *  store,
+                     store_type_t    val_type,
+                     const char   *  str,
+                     void         ** val
+                   )
+{
+  if ( ( val_type == STORE_MOVE ) && ( strcmp( str, "UNINDEXED" ) == 0 ) )
+    {
+      *val = & UNINDEXED_MOVE;
+      return STORE_SUCCESS;
+    }
+  return CSTORE.get_str_t( & CSTORE, val_type, str, val );
+}
+
+
+/* Compile `QUERY' and check it against `PRED_EXPR' for every Pokemon. */
+#define expect_query( QUERY, PRED_EXPR )                                      \
+  do {                                                                        \
+    cup_program_t _prog = CUP_PROGRAM_INIT;                                   \
+    expect( cup_compile( & IDX, ( QUERY ), & _prog, NULL ) ==                 \
+            STORE_SUCCESS                                                     \
+          );                                                                  \
+    cup_program_eval( & IDX, & _prog, set );                                  \
+    cup_program_free( & _prog );                                              \
+    for ( uint32_t _i = 0; _i < IDX.nmons; _i++ )                             \
+      {                                                                       \
+        pdex_mon_t * mon = MONS[_i];                                          \
+        (void) mon;                                                           \
+        expect( bitset_test( set, _i ) == ( PRED_EXPR ) );                    \
+      }                                                                       \
+  } while ( 0 )
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_cup_compile( void )
+{
+  uint64_t * set = filter_index_alloc_set( & IDX );
+  expect( set != NULL );
+
+  expect_query( "all", true );
+  expect_query( "!all", false );
+  expect_query( "Kanto", pdex_mon_kanto_p( mon ) );
+  expect_query( "dex:1-151", pdex_mon_kanto_p( mon ) );
+  expect_query( "type:fire and type:flying",
+                pdex_mon_types_all_p( mon, FIRE_M | FLYING_M )
+              );
+
+  /* The example from the docs */
+  expect_query( "( kanto + johto ), no legendary, no mythic,"
+                " no ( fairy | steel )",
+                ( pdex_mon_kanto_p( mon ) || pdex_mon_johto_p( mon ) ) &&
+                ! pdex_mon_legendary_p( mon ) && ! pdex_mon_mythic_p( mon ) &&
+                ! pdex_mon_types_any_p( mon, FAIRY_M | STEEL_M )
+              );
+
+  /* `&' binds tighter than `|', `!' tighter than both */
+  expect_query( "kanto | johto & fire",
+                pdex_mon_kanto_p( mon ) ||
+                ( pdex_mon_johto_p( mon ) && pdex_mon_fire_p( mon ) )
+              );
+  expect_query( "!kanto & !johto",
+                ! pdex_mon_kanto_p( mon ) && ! pdex_mon_johto_p( mon )
+              );
+
+  /* Species and families, by name or Dex # */
+  expect_query( "mon:stunfisk", mon->dex_number == 618 );
+  expect_query( "species:618", mon->dex_number == 618 );
+  expect_query( "family:ivysaur", pdex_mon_family_p( mon, 1 ) );
+  expect_query( "all, no mon:mr_mime", mon->dex_number != 122 );
+  expect_query( "tag:alolan | tag:galarian",
+                pdex_mon_alolan_p( mon ) || pdex_mon_galarian_p( mon )
+              );
+
+  /* Moves */
+  store_move_t * counter = NULL;
+  expect( CS_get_move_by_name( "COUNTER", & counter ) == STORE_SUCCESS );
+  expect_query( "move:counter",
+                pdex_mon_has_fast_p( mon, counter->move_id ) ||
+                pdex_mon_has_charged_p( mon, counter->move_id )
+              );
+  expect_query( "fighting, !move:counter",
+                pdex_mon_fighting_p( mon ) &&
+                ! pdex_mon_has_fast_p( mon, counter->move_id ) &&
+                ! pdex_mon_has_charged_p( mon, counter->move_id )
+              );
+  cup_program_t prog = CUP_PROGRAM_INIT;
+  expect( cup_compile( & IDX, "steel & charged:fairy", & prog, NULL ) ==
+          STORE_SUCCESS
+        );
+  cup_program_eval( & IDX, & prog, set );
+  cup_program_free( & prog );
+  pdex_filter_t steel_fairy = PDEX_FILTER_ANY;
+  steel_fairy.types_all         = STEEL_M;
+  steel_fairy.charged_types_any = FAIRY_M;
+  uint64_t * want = filter_index_alloc_set( & IDX );
+  expect( filter_index_eval( & IDX, & steel_fairy, want ) == STORE_SUCCESS );
+  expect( memcmp( set, want, sizeof( uint64_t ) * IDX.nwords ) == 0 );
+  free( want );
+
+  /* A move the store knows, but the index doesn't, is learned by nobody */
+  store_t        stub = CSTORE;
+  filter_index_t idx  = IDX;
+  stub.get_str_t = unindexed_get_str_t;
+  idx.store      = & stub;
+  expect( cup_compile( & idx, "fighting | move:unindexed", & prog, NULL ) ==
+          STORE_SUCCESS
+        );
+  cup_program_eval( & idx, & prog, set );
+  cup_program_free( & prog );
+  for ( uint32_t i = 0; i < IDX.nmons; i++ )
+    {
+      expect( bitset_test( set, i ) == pdex_mon_fighting_p( MONS[i] ) );
+    }
+
+  free( set );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_cup_compile_errors( void )
+{
+  cup_program_t prog = CUP_PROGRAM_INIT;
+  size_t        pos  = 0;
+
+#define expect_bad( QUERY, POS )                                              \
+  expect( cup_compile( & IDX, ( QUERY ), & prog, & pos ) ==                   \
+          STORE_ERROR_BAD_VALUE                                               \
+        );                                                                    \
+  expect( pos == ( POS ) );                                                   \
+  expect( ( prog.ops == NULL ) && ( prog.nops == 0 ) )
+
+  expect_bad( "", 0 );
+  expect_bad( "kanto &", 7 );
+  expect_bad( "( kanto", 7 );
+  expect_bad( "kanto & bogus", 8 );
+  expect_bad( "type:kanto", 0 );
+  expect_bad( "kanto johto", 6 );
+  expect_bad( "dex:151-1", 0 );
+  expect_bad( "mon:notamon", 0 );
+  expect_bad( "mon:9999", 0 );
+  expect_bad( "kanto ; johto", 6 );
+  expect_bad( "move:notamove", 0 );
+  expect_bad( "charged:kanto", 0 );
+
+#undef expect_bad
+
+  /* Too deep for the evaluation stack */
+  char query[512] = "";
+  for ( int i = 0; i < CUP_MAX_DEPTH; i++ ) strcat( query, "all | ( " );
+  strcat( query, "all" );
+  for ( int i = 0; i < CUP_MAX_DEPTH; i++ ) strcat( query, " )" );
+  expect( cup_compile( & IDX, query, & prog, NULL ) == STORE_ERROR_BAD_VALUE );
+
+  /* Nesting is rejected before it can exhaust the C stack */
+  char * deep = (char *) malloc( 100001 );
+  expect( deep != NULL );
+  memset( deep, '(', 100000 );
+  deep[100000] = '\0';
+  pos = 0;
+  expect( cup_compile( & IDX, deep, & prog, & pos ) == STORE_ERROR_BAD_VALUE );
+  expect( pos == CUP_MAX_DEPTH );
+  memset( deep, '!', 100000 );
+  expect( cup_compile( & IDX, deep, & prog, & pos ) == STORE_ERROR_BAD_VALUE );
+  expect( pos == CUP_MAX_DEPTH );
+  free( deep );
+
+  /* Nesting right up to the limit is still fine */
+  memset( query, '!', CUP_MAX_DEPTH );
+  strcpy( query + CUP_MAX_DEPTH, "all" );
+  expect( cup_compile( & IDX, query, & prog, NULL ) == STORE_SUCCESS );
+  cup_program_free( & prog );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_cupstore_pools( void )
+{
+  store_t   overlay = def_overlay_store();
+  store_t   cups    = def_cupstore();
+  cup_t   * cup     = NULL;
+  cup_t   * again   = NULL;
+
+  expect( overlay.init( & overlay, & CSTORE ) == STORE_SUCCESS );
+  expect( cups.init( & cups, & overlay ) == STORE_SUCCESS );
+  expect( cupstore_add_defaults( & cups ) == STORE_SUCCESS );
+  expect( cupstore_count( & cups ) == array_size( CUP_DEFAULTS ) );
+
+  /* Duplicate names and bad queries are refused */
+  expect( cupstore_add_cup( & cups, "KANTO_CUP", 1500, "all" ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  expect( cupstore_add_cup( & cups, "BROKEN", 1500, "kanto &" ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  expect( cupstore_count( & cups ) == array_size( CUP_DEFAULTS ) );
+
+  expect( cups.get_str( & cups, "GREAT_LEAGUE", (void **) & cup ) ==
+          STORE_SUCCESS
+        );
+  expect( cup->cp_cap == 1500 );
+  expect( cup->pool_size == cup->index->nmons );
+
+  expect( cups.get_str_t( & cups, STORE_CUP, "KANTO_CUP", (void **) & cup ) ==
+          STORE_SUCCESS
+        );
+  uint32_t kanto = cup->pool_size;
+  uint32_t mew   = 0;
+  expect( 151 <= kanto );
+  expect( filter_index_find( cup->index, 151, 0, & mew ) == STORE_SUCCESS );
+  expect( ! bitset_test( cup->pool, mew ) );
+
+  /* Pools are cached while the Pokedex is unchanged */
+  const uint64_t * pool = cup->pool;
+  expect( cups.get( & cups, cup_store_key( 3 ), (void **) & again ) ==
+          STORE_SUCCESS
+        );
+  expect( ( again == cup ) && ( again->pool == pool ) );
+
+  /* Editing the Pokedex beneath the cups invalidates them */
+  pdex_mon_t * mon = NULL;
+  expect( overlay_store_edit_pokemon( & overlay, 1, 0, & mon ) ==
+          STORE_SUCCESS
+        );
+  mon->tags |= TAG_MYTHIC_M;
+  cup_t * great = NULL;
+  expect( cups.get_str( & cups, "GREAT_LEAGUE", (void **) & great ) ==
+          STORE_SUCCESS
+        );
+  /* The rebuild clears cups handed out before it, rather than leaving them
+   * pointing at the old index */
+  expect( ( cup->index == NULL ) && ( cup->pool == NULL ) );
+  expect( cup->pool_size == 0 );
+  expect( great->index != NULL );
+  expect( cups.get_str( & cups, "KANTO_CUP", (void **) & again ) ==
+          STORE_SUCCESS
+        );
+  expect( again == cup );
+  expect( cup->pool_size == kanto - 1 );
+  expect( cup->index == great->index );
+  expect( bitset_test( cup->pool, mew ) == false );
+
+  /* `set' replaces a cup's rules */
+  cup_t water = {
+    .name = "KANTO_CUP", .query = "kanto, water", .cp_cap = 500
+  };
+  expect( cups.set( & cups, cup_store_key( 3 ), & water ) == STORE_SUCCESS );
+  expect( cups.get( & cups, cup_store_key( 3 ), (void **) & cup ) ==
+          STORE_SUCCESS
+        );
+  expect( ( cup->cp_cap == 500 ) && ( cup->pool_size < kanto ) );
+  expect( cups.set( & cups, cup_store_key( 0 ), & water ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+
+  expect( cups.get_str( & cups, "NOPE", (void **) & cup ) ==
+          STORE_ERROR_NOT_FOUND
+        );
+  expect( ! cups.has( & cups, cup_store_key( 99 ) ) );
+
+  cups.free( & cups );
+  overlay.free( & overlay );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_cupstore( void )
+{
+  bool rsl = true;
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= filter_index_init( & IDX, & CSTORE ) == STORE_SUCCESS;
+  MONS = (pdex_mon_t **) calloc( IDX.nmons, sizeof( pdex_mon_t * ) );
+  rsl &= store_each( & CSTORE, STORE_POKEDEX, collect_cb, NULL ) ==
+         STORE_SUCCESS;
+  if ( rsl )
+    {
+      rsl &= do_test( cup_compile );
+      rsl &= do_test( cup_compile_errors );
+      rsl &= do_test( cupstore_pools );
+    }
+  free( MONS );
+  filter_index_free( & IDX );
+  CS_free();
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_cupstore() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
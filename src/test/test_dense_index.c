@@ -0,0 +1,235 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "dense_index.h"
+#include "moves.h"
+#include "overlay_store.h"
+#include "pokedex.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_dense_index_keys( void )
+{
+  /* Unsorted, with a duplicate, and a gap in the forms of #7 */
+  const uint32_t mon_keys[] = {
+    ( 7 << 8 ) | 2, ( 3 << 8 ) | 0, ( 7 << 8 ) | 0, ( 3 << 8 ) | 1,
+    ( 3 << 8 ) | 0, ( 10 << 8 ) | 0
+  };
+  const uint16_t move_ids[] = { 300, 13, 250, 13 };
+  dense_index_t  idx;
+  uint32_t       i = 0;
+  uint16_t       m = 0;
+
+  expect( dense_index_init_keys( & idx,
+                                 mon_keys,
+                                 array_size( mon_keys ),
+                                 move_ids,
+                                 array_size( move_ids )
+                               ) == STORE_SUCCESS
+        );
+  expect( idx.nmons == 5 );
+  expect( idx.max_dex == 10 );
+  expect( idx.nmoves == 3 );
+  expect( idx.max_move_id == 300 );
+
+  expect( dense_mon_idx( & idx, 3, 0, & i ) == STORE_SUCCESS );
+  expect( i == 0 );
+  expect( dense_mon_idx( & idx, 3, 1, & i ) == STORE_SUCCESS );
+  expect( i == 1 );
+  expect( dense_mon_idx( & idx, 7, 0, & i ) == STORE_SUCCESS );
+  expect( i == 2 );
+  expect( dense_mon_idx( & idx, 7, 2, & i ) == STORE_SUCCESS );
+  expect( i == 3 );
+  expect( dense_mon_idx( & idx, 10, 0, & i ) == STORE_SUCCESS );
+  expect( i == 4 );
+
+  expect( dense_mon_idx( & idx, 7, 1, & i ) == STORE_ERROR_NOT_FOUND );
+  expect( dense_mon_idx( & idx, 0, 0, & i ) == STORE_ERROR_NOT_FOUND );
+  expect( dense_mon_idx( & idx, 5, 0, & i ) == STORE_ERROR_NOT_FOUND );
+  expect( dense_mon_idx( & idx, 11, 0, & i ) == STORE_ERROR_NOT_FOUND );
+
+  expect( dense_forms_cnt( & idx, 3 ) == 2 );
+  expect( dense_forms_cnt( & idx, 5 ) == 0 );
+  expect( dense_forms_cnt( & idx, 10 ) == 1 );
+  expect( dense_forms_cnt( & idx, 11 ) == 0 );
+
+  store_key_t key = dense_mon_key( & idx, 3 );
+  expect( ( key.val_type == STORE_POKEDEX ) && ( key.data_h0 == 7 ) &&
+          ( key.data_q2 == 2 )
+        );
+
+  expect( dense_move_idx( & idx, 13, & m ) == STORE_SUCCESS );
+  expect( m == 0 );
+  expect( dense_move_idx( & idx, 300, & m ) == STORE_SUCCESS );
+  expect( m == 2 );
+  expect( dense_move_idx( & idx, 14, & m ) == STORE_ERROR_NOT_FOUND );
+  expect( dense_move_idx( & idx, 301, & m ) == STORE_ERROR_NOT_FOUND );
+  key = dense_move_key( & idx, 1 );
+  expect( ( key.val_type == STORE_MOVE ) && ( key.data_h0 == 250 ) );
+
+  dense_index_free( & idx );
+
+  /* Empty stores are fine too */
+  expect( dense_index_init_keys( & idx, NULL, 0, NULL, 0 ) == STORE_SUCCESS );
+  expect( dense_mon_idx( & idx, 0, 0, & i ) == STORE_ERROR_NOT_FOUND );
+  expect( dense_move_idx( & idx, 0, & m ) == STORE_ERROR_NOT_FOUND );
+  dense_index_free( & idx );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static int
+check_mon_cb( void * ctx, store_key_t key, void * val )
+{
+  const dense_index_t * idx = (const dense_index_t *) ctx;
+  const pdex_mon_t    * mon = (const pdex_mon_t *) val;
+  uint32_t              i   = 0;
+  if ( dense_mon_idx( idx, mon->dex_number, mon->form_idx, & i ) !=
+       STORE_SUCCESS )
+    {
+      return STORE_ERROR_NOT_FOUND;
+    }
+  if ( ( idx->dex[i] != mon->dex_number ) || ( idx->form[i] != mon->form_idx ) )
+    {
+      return STORE_ERROR_FAIL;
+    }
+  return STORE_SUCCESS;
+}
+
+
+  static int
+check_move_cb( void * ctx, store_key_t key, void * val )
+{
+  const dense_index_t * idx  = (const dense_index_t *) ctx;
+  const store_move_t  * move = (const store_move_t *) val;
+  uint16_t              i    = 0;
+  if ( dense_move_idx( idx, move->move_id, & i ) != STORE_SUCCESS )
+    {
+      return STORE_ERROR_NOT_FOUND;
+    }
+  return ( idx->move_id[i] == move->move_id ) ? STORE_SUCCESS
+                                              : STORE_ERROR_FAIL;
+}
+
+
+  static bool
+test_dense_index_cstore( void )
+{
+  const dense_index_t * cidx = cstore_dense_index( & CSTORE );
+  dense_index_t         idx;
+
+  /* Every Pokemon and move maps to a dense index and back */
+  expect( store_each( & CSTORE, STORE_POKEDEX, check_mon_cb, (void *) cidx ) ==
+          STORE_SUCCESS
+        );
+  expect( store_each( & CSTORE, STORE_MOVE, check_move_cb, (void *) cidx ) ==
+          STORE_SUCCESS
+        );
+  for ( uint32_t i = 1; i < cidx->nmons; i++ )
+    {
+      expect( ( cidx->dex[i - 1] < cidx->dex[i] ) ||
+              ( ( cidx->dex[i - 1] == cidx->dex[i] ) &&
+                ( cidx->form[i - 1] < cidx->form[i] ) )
+            );
+    }
+
+  /* Building from `store_each' agrees with the prebuilt index */
+  expect( dense_index_init( & idx, & CSTORE ) == STORE_SUCCESS );
+  expect( idx.nmons == cidx->nmons );
+  expect( idx.nmoves == cidx->nmoves );
+  expect( idx.max_dex == cidx->max_dex );
+  expect( memcmp( idx.dex, cidx->dex, sizeof( uint16_t ) * idx.nmons ) == 0 );
+  expect( memcmp( idx.form, cidx->form, idx.nmons ) == 0 );
+  expect( memcmp( idx.move_id,
+                  cidx->move_id,
+                  sizeof( uint16_t ) * idx.nmoves
+                ) == 0
+        );
+  dense_index_free( & idx );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_dense_index_overlay( void )
+{
+  store_t        overlay = def_overlay_store();
+  store_move_t   move    = NO_MOVE_STORE;
+  dense_index_t  idx;
+  uint16_t       m       = 0;
+
+  expect( overlay.init( & overlay, & CSTORE ) == STORE_SUCCESS );
+
+  move.name    = "TEST_MOVE";
+  move.move_id = 0x1ff0;
+  expect( overlay.add( & overlay, move_store_key( & move ), & move ) ==
+          STORE_SUCCESS
+        );
+
+  expect( dense_index_init( & idx, & overlay ) == STORE_SUCCESS );
+  expect( idx.version == store_version( & overlay ) );
+  expect( idx.nmons == cstore_dense_index( & CSTORE )->nmons );
+  expect( idx.nmoves == cstore_dense_index( & CSTORE )->nmoves + 1 );
+  expect( dense_move_idx( & idx, 0x1ff0, & m ) == STORE_SUCCESS );
+  expect( m == idx.nmoves - 1 );
+  expect( store_each( & overlay, STORE_MOVE, check_move_cb, & idx ) ==
+          STORE_SUCCESS
+        );
+  dense_index_free( & idx );
+
+  overlay.free( & overlay );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_dense_index( void )
+{
+  bool rsl = true;
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= do_test( dense_index_keys );
+  rsl &= do_test( dense_index_cstore );
+  rsl &= do_test( dense_index_overlay );
+  CS_free();
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_dense_index() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
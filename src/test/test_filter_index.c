@@ -0,0 +1,300 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "filter.h"
+#include "filter_index.h"
+#include "pokedex.h"
+#include "util/bitset.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_bitset( void )
+{
+  const size_t   nbits  = 130;
+  const size_t   nwords = bitset_nwords( nbits );
+  uint64_t     * a      = bitset_alloc( nbits );
+  uint64_t     * b      = bitset_alloc( nbits );
+  uint64_t     * c      = bitset_alloc( nbits );
+  size_t         n      = 0;
+
+  expect( nwords == 3 );
+  expect( ( a != NULL ) && ( b != NULL ) && ( c != NULL ) );
+  expect( bitset_empty( a, nwords ) );
+  expect( bitset_next( a, nwords, 0 ) == SIZE_MAX );
+
+  bitset_set( a, 0 );
+  bitset_set( a, 63 );
+  bitset_set( a, 64 );
+  bitset_set( a, 129 );
+  expect( bitset_test( a, 63 ) && bitset_test( a, 64 ) );
+  expect( ! bitset_test( a, 65 ) );
+  expect( bitset_count( a, nwords ) == 4 );
+  expect( bitset_next( a, nwords, 1 ) == 63 );
+  expect( bitset_next( a, nwords, 65 ) == 129 );
+  expect( bitset_next( a, nwords, 130 ) == SIZE_MAX );
+
+  /* NOT must leave the tail clear */
+  bitset_not( b, a, nbits );
+  expect( bitset_count( b, nwords ) == nbits - 4 );
+  bitset_and( c, a, b, nwords );
+  expect( bitset_empty( c, nwords ) );
+  bitset_or( c, a, b, nwords );
+  expect( bitset_count( c, nwords ) == nbits );
+  bitset_fill( b, nbits );
+  expect( memcmp( b, c, sizeof( uint64_t ) * nwords ) == 0 );
+  bitset_andnot( c, c, a, nwords );
+  expect( bitset_count( c, nwords ) == nbits - 4 );
+  bitset_clear( a, 63 );
+  expect( ! bitset_test( a, 63 ) );
+
+  bitset_foreach( bit, a, nwords )
+    {
+      expect( ( bit == 0 ) || ( bit == 64 ) || ( bit == 129 ) );
+      n++;
+    }
+  expect( n == 3 );
+
+  free( a );
+  free( b );
+  free( c );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Check `filter' against the predicate it should agree with, mon by mon. */
+#define expect_filter( FILTER, PRED_EXPR )                                    \
+  do {                                                                        \
+    expect( filter_index_eval( & idx, ( FILTER ), set ) == STORE_SUCCESS );   \
+    size_t _cnt = 0;                                                          \
+    for ( uint32_t _i = 0; _i < idx.nmons; _i++ )                             \
+      {                                                                       \
+        mon = mons[_i];                                                       \
+        bool _want = ( PRED_EXPR );                                           \
+        expect( bitset_test( set, _i ) == _want );                            \
+        _cnt += _want;                                                        \
+      }                                                                       \
+    expect( filter_index_count( & idx, set ) == _cnt );                       \
+  } while ( 0 )
+
+
+/* Whether `mon' has a fast ( or charged ) move of type `type'. */
+  static bool
+mon_has_move_type( const pdex_mon_t * mon, bool charged, ptype_t type )
+{
+  const int16_t * ids = charged ? mon->charged_move_ids : mon->fast_move_ids;
+  uint8_t         cnt = charged ? mon->charged_moves_cnt : mon->fast_moves_cnt;
+  store_move_t  * move = NULL;
+  for ( uint8_t i = 0; i < cnt; i++ )
+    {
+      if ( ( CS_get_move( abs( ids[i] ), & move ) == STORE_SUCCESS ) &&
+           ( move->type == type ) )
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+
+struct collect_ctx_s {
+  filter_index_t  * idx;
+  pdex_mon_t     ** mons;
+  uint32_t          cnt;
+};
+
+/* Place each Pokemon at its dense index, without going through `get'. */
+  static int
+collect_cb( void * vctx, store_key_t key, void * val )
+{
+  struct collect_ctx_s * ctx = (struct collect_ctx_s *) vctx;
+  pdex_mon_t           * mon = (pdex_mon_t *) val;
+  uint32_t               i   = 0;
+
+  if ( filter_index_find( ctx->idx, mon->dex_number, mon->form_idx, & i ) !=
+       STORE_SUCCESS
+     )
+    {
+      return STORE_ERROR_NOT_FOUND;
+    }
+  ctx->mons[i] = mon;
+  ctx->cnt++;
+  return STORE_SUCCESS;
+}
+
+
+  static bool
+test_filter_index_eval( void )
+{
+  filter_index_t   idx;
+  uint64_t       * set  = NULL;
+  pdex_mon_t     * mon  = NULL;
+  pdex_mon_t    ** mons = NULL;
+  uint32_t         i    = 0;
+
+  expect( filter_index_init( & idx, & CSTORE ) == STORE_SUCCESS );
+  mons = (pdex_mon_t **) calloc( idx.nmons, sizeof( pdex_mon_t * ) );
+  expect( mons != NULL );
+  struct collect_ctx_s ctx = { .idx = & idx, .mons = mons, .cnt = 0 };
+  expect( store_each( & CSTORE, STORE_POKEDEX, collect_cb, & ctx ) ==
+          STORE_SUCCESS
+        );
+  expect( idx.nmons == ctx.cnt );
+  set = filter_index_alloc_set( & idx );
+  expect( set != NULL );
+
+  /* Dense indices follow Dex # */
+  expect( filter_index_find( & idx, 1, 0, & i ) == STORE_SUCCESS );
+  expect( i == 0 );
+  expect( filter_index_find( & idx, 618, 1, & i ) == STORE_SUCCESS );
+  expect( filter_index_get( & idx, i, & mon ) == STORE_SUCCESS );
+  expect( ( mon->dex_number == 618 ) && ( mon->form_idx == 1 ) );
+  expect( filter_index_find( & idx, 0, 0, & i ) == STORE_ERROR_NOT_FOUND );
+
+  pdex_filter_t any = PDEX_FILTER_ANY;
+  expect_filter( & any, true );
+
+  pdex_filter_t legends = PDEX_FILTER_ANY;
+  legends.tags_any = TAG_LEGENDARY_M | TAG_MYTHIC_M;
+  expect_filter( & legends,
+                 pdex_mon_legendary_p( mon ) || pdex_mon_mythic_p( mon )
+               );
+  expect( 0 < filter_index_count( & idx, set ) );
+
+  pdex_filter_t grass_poison = PDEX_FILTER_ANY;
+  grass_poison.types_all = GRASS_M | POISON_M;
+  expect_filter( & grass_poison,
+                 pdex_mon_types_all_p( mon, GRASS_M | POISON_M )
+               );
+  expect( filter_index_find( & idx, 1, 0, & i ) == STORE_SUCCESS );
+  expect( bitset_test( set, i ) );
+
+  pdex_filter_t kanto_common = PDEX_FILTER_ANY;
+  kanto_common.regions   = ( 1 << R_KANTO ) | ( 1 << R_JOHTO );
+  kanto_common.tags_none = TAG_LEGENDARY_M | TAG_MYTHIC_M;
+  kanto_common.types_any = FIRE_M | WATER_M;
+  expect_filter( & kanto_common,
+                 ( pdex_mon_kanto_p( mon ) || pdex_mon_johto_p( mon ) ) &&
+                 ( ! pdex_mon_legendary_p( mon ) ) &&
+                 ( ! pdex_mon_mythic_p( mon ) ) &&
+                 pdex_mon_types_any_p( mon, FIRE_M | WATER_M )
+               );
+
+  pdex_filter_t family = PDEX_FILTER_ANY;
+  family.family = 1;
+  expect_filter( & family, pdex_mon_family_p( mon, 1 ) );
+  expect( 3 <= filter_index_count( & idx, set ) );
+  family.family = UINT16_MAX;
+  expect_filter( & family, false );
+
+  /* Predicates from `filter.h' are the slow path */
+  pdex_filter_t slow = PDEX_FILTER_ANY;
+  slow.types_any = GROUND_M;
+  slow.pred      = pdex_mon_alolan_pred;
+  expect_filter( & slow,
+                 pdex_mon_types_any_p( mon, GROUND_M ) &&
+                 pdex_mon_alolan_p( mon )
+               );
+
+  /* Inverted indices: learners of a move, and move types */
+  store_move_t * counter = NULL;
+  expect( CS_get_move_by_name( "COUNTER", & counter ) == STORE_SUCCESS );
+  pdex_filter_t learns = PDEX_FILTER_ANY;
+  learns.learns = counter->move_id;
+  expect_filter( & learns,
+                 pdex_mon_has_fast_p( mon, counter->move_id ) ||
+                 pdex_mon_has_charged_p( mon, counter->move_id )
+               );
+  expect( 0 < filter_index_count( & idx, set ) );
+  learns.learns = UINT16_MAX;
+  expect_filter( & learns, false );
+
+  pdex_filter_t steel_fairy = PDEX_FILTER_ANY;
+  steel_fairy.types_all         = STEEL_M;
+  steel_fairy.charged_types_any = FAIRY_M;
+  expect_filter( & steel_fairy,
+                 pdex_mon_types_all_p( mon, STEEL_M ) &&
+                 mon_has_move_type( mon, true, FAIRY )
+               );
+  expect( 0 < filter_index_count( & idx, set ) );
+
+  pdex_filter_t fast_ghost = PDEX_FILTER_ANY;
+  fast_ghost.fast_types_any = GHOST_M | DARK_M;
+  expect_filter( & fast_ghost,
+                 mon_has_move_type( mon, false, GHOST ) ||
+                 mon_has_move_type( mon, false, DARK )
+               );
+
+  /* Family members as a list agree with the family's set */
+  const uint32_t * members = NULL;
+  uint32_t         nmembers = filter_index_family_members( & idx,
+                                                           133,
+                                                           & members
+                                                         );
+  family.family = 133;
+  expect_filter( & family, pdex_mon_family_p( mon, 133 ) );
+  expect( 8 <= nmembers );
+  expect( nmembers == filter_index_count( & idx, set ) );
+  for ( uint32_t m = 0; m < nmembers; m++ )
+    {
+      expect( bitset_test( set, members[m] ) );
+      expect( ( m == 0 ) || ( members[m - 1] < members[m] ) );
+    }
+  expect( filter_index_family_members( & idx, UINT16_MAX, & members ) == 0 );
+  expect( members == NULL );
+
+  free( mons );
+  free( set );
+  filter_index_free( & idx );
+
+  return true;
+}
+
+#undef expect_filter
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_filter_index( void )
+{
+  bool rsl = true;
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= do_test( bitset );
+  rsl &= do_test( filter_index_eval );
+  CS_free();
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_filter_index() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -6,6 +6,8 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "util/bktree.h"
 #include "util/test_util.h"
 #include "util/fuzzy.h"
 
@@ -52,6 +54,154 @@ test_rank_lev_dist( void )
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_levenshtein_bounded( void )
+{
+  expect( levenshtein_bounded( "kitten", 6, "sitting", 7, 3 ) == 3 );
+  expect( levenshtein_bounded( "kitten", 6, "sitting", 7, 2 ) == 3 );
+  expect( levenshtein_bounded( "kitten", 6, "kitten", 6, 0 ) == 0 );
+  expect( levenshtein_bounded( "", 0, "abc", 3, 5 ) == 3 );
+  expect( levenshtein_bounded( "a", 1, "abcdef", 6, 2 ) == 3 );
+
+  /* Longer than the stack buffer */
+  char s[FUZZY_STACK_LEN * 2 + 1];
+  char t[FUZZY_STACK_LEN * 2 + 1];
+  memset( s, 'a', sizeof( s ) - 1 );
+  memset( t, 'a', sizeof( t ) - 1 );
+  s[sizeof( s ) - 1] = t[sizeof( t ) - 1] = '\0';
+  t[7] = 'b';
+  expect( levenshtein_bounded( s, strlen( s ), t, strlen( t ), 4 ) == 1 );
+  expect( levenshtein( s, t ) == 1 );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Bit-parallel scores should agree with the plain DP, with and without SIMD */
+  static bool
+test_lev_pattern( void )
+{
+  enum { NSTRINGS = 103, MAX_LEN = LEV_PATTERN_MAX_LEN };
+  char          buffers[NSTRINGS][MAX_LEN + 1];
+  const char  * strings[NSTRINGS];
+  int           dists[NSTRINGS];
+  lev_pattern_t pat;
+  char          query[MAX_LEN + 1];
+
+  srand( 42 );
+  for ( size_t i = 0; i < NSTRINGS; i++ )
+    {
+      /* A small alphabet makes for plenty of near misses */
+      size_t len = (size_t) rand() % ( MAX_LEN + 1 );
+      for ( size_t j = 0; j < len; j++ ) buffers[i][j] = 'A' + rand() % 4;
+      buffers[i][len] = '\0';
+      strings[i] = buffers[i];
+    }
+
+  for ( int q = 0; q < 16; q++ )
+    {
+      size_t qlen = ( q == 0 ) ? 0 : ( q == 1 ) ? MAX_LEN : rand() % MAX_LEN;
+      for ( size_t j = 0; j < qlen; j++ ) query[j] = 'A' + rand() % 4;
+      query[qlen] = '\0';
+      expect( lev_pattern_init( & pat, query, qlen ) );
+
+      for ( int max = 0; max <= MAX_LEN; max += 7 )
+        {
+          lev_pattern_dist_many( & pat, strings, NSTRINGS, max, dists );
+          for ( size_t i = 0; i < NSTRINGS; i++ )
+            {
+              size_t len = strlen( strings[i] );
+              int    dp  = levenshtein_dp( query, qlen, strings[i], len, max );
+              expect( lev_pattern_dist( & pat, strings[i], len, max ) == dp );
+              expect( dists[i] == dp );
+            }
+        }
+    }
+
+  memset( query, 'A', sizeof( query ) );
+  expect( ! lev_pattern_init( & pat, query, MAX_LEN + 1 ) );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_bktree( void )
+{
+  const char * words[] = {
+    "BULBASAUR", "IVYSAUR", "VENUSAUR", "CHARMANDER", "CHARMELEON",
+    "CHARIZARD", "SQUIRTLE", "WARTORTLE", "BLASTOISE", "STUNFISK",
+    "STUNFISK_GALARIAN", "GALARIAN_STUNFISK", "MEOWTH", "MEOWTH_ALOLA",
+    "WRAP", "HYPER_BEAM", "VINE_WHIP", "WATER_GUN", "EMBER", "EMBER"
+  };
+  size_t         nwords = sizeof( words ) / sizeof( words[0] );
+  bktree_t       tree   = BKTREE_INIT;
+  bktree_match_t matches[4];
+  size_t         n      = 0;
+
+  for ( size_t i = 0; i < nwords - 1; i++ )
+    {
+      expect( bktree_insert( & tree, words[i], (void *) words[i] ) == 0 );
+    }
+  /* Duplicates keep the first value */
+  expect( bktree_insert( & tree, words[nwords - 1], NULL ) == 1 );
+  expect( tree.cnt == nwords - 1 );
+
+  n = bktree_find( & tree, "BULBASAUR", 0, matches, 4 );
+  expect( n == 1 );
+  expect( matches[0].dist == 0 );
+  expect( matches[0].data == (void *) words[0] );
+
+  n = bktree_find( & tree, "GALARAIN_STUNFSK", 3, matches, 1 );
+  expect( n == 1 );
+  expect( strcmp( matches[0].key, "GALARIAN_STUNFISK" ) == 0 );
+  expect( matches[0].dist == 3 );
+
+  n = bktree_find( & tree, "CHARMANDR", 4, matches, 4 );
+  expect( 1 < n );
+  expect( strcmp( matches[0].key, "CHARMANDER" ) == 0 );
+  for ( size_t i = 1; i < n; i++ )
+    {
+      expect( matches[i - 1].dist <= matches[i].dist );
+    }
+
+  /* Every query should agree with scoring every word */
+  const char * queries[] = { "SAUR", "EMBRE", "MEOWHT", "WATR_GNU", "XYZZY" };
+  for ( size_t q = 0; q < sizeof( queries ) / sizeof( queries[0] ); q++ )
+    {
+      int best = 4;
+      for ( size_t i = 0; i < nwords - 1; i++ )
+        {
+          int d = levenshtein( queries[q], words[i] );
+          if ( d < best ) best = d;
+        }
+      n = bktree_find( & tree, queries[q], 3, matches, 4 );
+      if ( 3 < best )
+        {
+          expect( n == 0 );
+        }
+      else
+        {
+          expect( 0 < n );
+          expect( matches[0].dist == best );
+        }
+    }
+
+  expect( bktree_find( & tree, "WRAP", -1, matches, 4 ) == 0 );
+  bktree_free( & tree );
+  expect( tree.cnt == 0 );
+  expect( bktree_find( & tree, "WRAP", 3, matches, 4 ) == 0 );
+
+  return true;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   bool
@@ -60,6 +210,9 @@ test_fuzzy( void )
   bool rsl = true;
   rsl &= do_test( levenshtein );
   rsl &= do_test( rank_lev_dist );
+  rsl &= do_test( levenshtein_bounded );
+  rsl &= do_test( lev_pattern );
+  rsl &= do_test( bktree );
   return rsl;
 }
 
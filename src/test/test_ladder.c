@@ -0,0 +1,385 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "ladder.h"
+#include "pokedex.h"
+#include "pokemon.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+#define TEST_NTEAMS    12
+#define TEST_NPLAYERS  301
+
+
+/* `TEST_NTEAMS' teams of consecutive species, each with its first moveset */
+  static bool
+make_teams( roster_pokemon_t * rmons, base_pokemon_t * bases )
+{
+  uint16_t dex = 1;
+  for ( uint32_t i = 0; i < 3 * TEST_NTEAMS; dex++ )
+    {
+      if ( dex == 0 ) return false;
+      if ( base_mon_from_store( & CSTORE, dex, 0, 20.0, 15, 15, 15,
+                                bases + i
+                              ) != STORE_SUCCESS
+         )
+        {
+          continue;
+        }
+      const pdex_mon_t * pdex = bases[i].pdex_mon;
+      if ( ( pdex->fast_moves_cnt == 0 ) || ( pdex->charged_moves_cnt == 0 ) )
+        {
+          continue;
+        }
+      rmons[i] = (roster_pokemon_t) {
+        .base             = bases + i,
+        .fast_move_id     = abs( pdex->fast_move_ids[0] ),
+        .charged_move_ids = {
+          abs( pdex->charged_move_ids[0] ),
+          ( 1 < pdex->charged_moves_cnt ) ? abs( pdex->charged_move_ids[1] )
+                                          : 0
+        }
+      };
+      i++;
+    }
+  return true;
+}
+
+
+/* Every count adds up, and players hold the teams they were dealt */
+  static bool
+check_totals( const ladder_t * ladder, const roster_pokemon_t * rmons )
+{
+  uint64_t battles = 0;
+  uint64_t wins    = 0;
+  uint64_t draws   = 0;
+  uint32_t players = 0;
+
+  for ( uint32_t t = 0; t < ladder->nteams; t++ )
+    {
+      battles += ladder->stats[t].battles;
+      wins    += ladder->stats[t].wins;
+      draws   += ladder->stats[t].draws;
+      players += ladder->stats[t].players;
+    }
+  expect( players == ladder->nplayers );
+  expect( battles == 2 * ladder->nbattles );
+  expect( 2 * wins + draws == 2 * ladder->nbattles );
+  expect( ladder->nbattles ==
+          (uint64_t) ladder->round * ( ladder->nplayers / 2 )
+        );
+  expect( ladder->nsimulated <= ladder->nbattles );
+  expect( ladder->nsimulated <= ladder->nteams * ladder->nteams );
+
+  battles = 0;
+  for ( uint32_t p = 0; p < ladder->nplayers; p++ )
+    {
+      const ladder_player_t * player = ladder->players + p;
+      battles += player->player.battles;
+      expect( player->player.wins + player->draws <= player->player.battles );
+      expect( player->player.roster.roster_length == 3 );
+      expect( memcmp( player->player.roster.roster_pokemon,
+                      rmons + 3 * player->team,
+                      3 * sizeof( roster_pokemon_t )
+                    ) == 0
+            );
+    }
+  expect( battles == 2 * ladder->nbattles );
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_ladder_elo( void )
+{
+  roster_pokemon_t rmons[3 * TEST_NTEAMS];
+  base_pokemon_t   bases[3 * TEST_NTEAMS];
+  ladder_t         ladder = LADDER_INIT;
+  ladder_opts_t    opts   = LADDER_OPTS_DEFAULT;
+
+  expect( make_teams( rmons, bases ) );
+  opts.rating = LADDER_ELO;
+  opts.seed   = 7;
+  expect( ladder_init( & ladder, rmons, TEST_NTEAMS, NULL, TEST_NPLAYERS,
+                       & CSTORE, & opts
+                     ) == STORE_SUCCESS
+        );
+  expect( ladder_run( & ladder, 40 ) == STORE_SUCCESS );
+  expect( ladder.round == 40 );
+  expect( check_totals( & ladder, rmons ) );
+
+  /* Elo only moves points between players */
+  double total = 0.0;
+  for ( uint32_t p = 0; p < ladder.nplayers; p++ )
+    {
+      total += ladder.players[p].rating;
+    }
+  expect( fabs( total - TEST_NPLAYERS * opts.initial_rating ) < 1e-6 );
+
+  /* Each pairing of teams was only simulated once */
+  uint32_t seen = 0;
+  for ( uint32_t i = 0; i < TEST_NTEAMS * TEST_NTEAMS; i++ )
+    {
+      seen += ( ladder.results[i] != 0 );
+    }
+  expect( ladder.nsimulated == seen );
+  expect( ladder.nsimulated < ladder.nbattles );
+
+  ladder_free( & ladder );
+  expect( ladder.players == NULL );
+  return true;
+}
+
+
+  static bool
+test_ladder_glicko( void )
+{
+  roster_pokemon_t rmons[3 * TEST_NTEAMS];
+  base_pokemon_t   bases[3 * TEST_NTEAMS];
+  ladder_t         ladder = LADDER_INIT;
+  ladder_opts_t    opts   = LADDER_OPTS_DEFAULT;
+
+  expect( make_teams( rmons, bases ) );
+  opts.seed = 11;
+  expect( ladder_init( & ladder, rmons, TEST_NTEAMS, NULL, TEST_NPLAYERS,
+                       & CSTORE, & opts
+                     ) == STORE_SUCCESS
+        );
+  expect( ladder_run( & ladder, 40 ) == STORE_SUCCESS );
+  expect( check_totals( & ladder, rmons ) );
+
+  for ( uint32_t p = 0; p < ladder.nplayers; p++ )
+    {
+      expect( ladder.players[p].rd < opts.glicko_rd );
+    }
+
+  /* The best team climbs, and the worst sinks */
+  double   ratings[TEST_NTEAMS] = { 0.0 };
+  uint32_t best  = 0;
+  uint32_t worst = 0;
+  for ( uint32_t p = 0; p < ladder.nplayers; p++ )
+    {
+      ratings[ladder.players[p].team] += ladder.players[p].rating;
+    }
+  for ( uint32_t t = 1; t < TEST_NTEAMS; t++ )
+    {
+      double rate = ladder_team_win_rate( ladder.stats + t );
+      if ( ladder_team_win_rate( ladder.stats + best ) < rate ) best = t;
+      if ( rate < ladder_team_win_rate( ladder.stats + worst ) ) worst = t;
+    }
+  expect( 0.5 < ladder_team_win_rate( ladder.stats + best ) );
+  expect( ladder_team_win_rate( ladder.stats + worst ) < 0.5 );
+  expect( opts.initial_rating <
+          ratings[best] / ladder.stats[best].players
+        );
+  expect( ratings[worst] / ladder.stats[worst].players <
+          opts.initial_rating
+        );
+
+  ladder_free( & ladder );
+  return true;
+}
+
+
+  static bool
+test_ladder_deterministic( void )
+{
+  roster_pokemon_t rmons[3 * TEST_NTEAMS];
+  base_pokemon_t   bases[3 * TEST_NTEAMS];
+  float            weights[TEST_NTEAMS];
+  ladder_t         one    = LADDER_INIT;
+  ladder_t         many   = LADDER_INIT;
+  ladder_t         other  = LADDER_INIT;
+  ladder_opts_t    opts   = LADDER_OPTS_DEFAULT;
+
+  expect( make_teams( rmons, bases ) );
+  for ( uint32_t t = 0; t < TEST_NTEAMS; t++ )
+    {
+      weights[t] = ( t == 3 ) ? 0.0 : 1.0 + t;
+    }
+
+  /* The same seed plays the same ladder on any number of threads */
+  opts.seed     = 99;
+  opts.nthreads = 1;
+  expect( ladder_init( & one, rmons, TEST_NTEAMS, weights, TEST_NPLAYERS,
+                       & CSTORE, & opts
+                     ) == STORE_SUCCESS
+        );
+  opts.nthreads = 4;
+  expect( ladder_init( & many, rmons, TEST_NTEAMS, weights, TEST_NPLAYERS,
+                       & CSTORE, & opts
+                     ) == STORE_SUCCESS
+        );
+  expect( ladder_run( & one, 25 ) == STORE_SUCCESS );
+  expect( ladder_run( & many, 10 ) == STORE_SUCCESS );
+  expect( ladder_run( & many, 15 ) == STORE_SUCCESS );
+  expect( check_totals( & many, rmons ) );
+  expect( one.stats[3].players == 0 );
+  expect( one.stats[3].battles == 0 );
+  expect( one.nbattles == many.nbattles );
+  expect( memcmp( one.stats, many.stats,
+                  sizeof( ladder_team_stats_t ) * TEST_NTEAMS
+                ) == 0
+        );
+  for ( uint32_t p = 0; p < TEST_NPLAYERS; p++ )
+    {
+      const ladder_player_t * a = one.players + p;
+      const ladder_player_t * b = many.players + p;
+      expect( a->team == b->team );
+      expect( a->rating == b->rating );
+      expect( a->rd == b->rd );
+      expect( a->player.wins == b->player.wins );
+      expect( a->player.battles == b->player.battles );
+    }
+
+  /* Another seed deals other teams */
+  opts.seed = 100;
+  expect( ladder_init( & other, rmons, TEST_NTEAMS, weights, TEST_NPLAYERS,
+                       & CSTORE, & opts
+                     ) == STORE_SUCCESS
+        );
+  bool same = true;
+  for ( uint32_t p = 0; p < TEST_NPLAYERS; p++ )
+    {
+      same &= ( one.players[p].team == other.players[p].team );
+    }
+  expect( ! same );
+
+  ladder_free( & other );
+  ladder_free( & many );
+  ladder_free( & one );
+  return true;
+}
+
+
+  static bool
+test_ladder_stats( void )
+{
+  roster_pokemon_t rmons[3 * TEST_NTEAMS];
+  base_pokemon_t   bases[3 * TEST_NTEAMS];
+  ladder_t         ladder = LADDER_INIT;
+  ladder_opts_t    opts   = LADDER_OPTS_DEFAULT;
+  char             line[256];
+  uint32_t         nlines = 0;
+  FILE           * stream = tmpfile();
+
+  expect( stream != NULL );
+  expect( make_teams( rmons, bases ) );
+  opts.report_every = 5;
+  opts.stats        = stream;
+  expect( ladder_init( & ladder, rmons, TEST_NTEAMS, NULL, 20, & CSTORE,
+                       & opts
+                     ) == STORE_SUCCESS
+        );
+  expect( ladder_run( & ladder, 12 ) == STORE_SUCCESS );
+  expect( ladder_run( & ladder, 8 ) == STORE_SUCCESS );
+
+  /* A header, then every team at rounds 5, 10, 15, and 20 */
+  rewind( stream );
+  expect( fgets( line, sizeof( line ), stream ) != NULL );
+  expect( strcmp( line,
+                  "round,team,players,battles,wins,draws,win_rate,rating\n"
+                ) == 0
+        );
+  while ( fgets( line, sizeof( line ), stream ) != NULL )
+    {
+      uint32_t round = 0;
+      uint32_t team  = 0;
+      expect( sscanf( line, "%u,%u,", & round, & team ) == 2 );
+      expect( round == 5 * ( nlines / TEST_NTEAMS + 1 ) );
+      expect( team == nlines % TEST_NTEAMS );
+      nlines++;
+    }
+  expect( nlines == 4 * TEST_NTEAMS );
+  fclose( stream );
+
+  ladder_free( & ladder );
+  return true;
+}
+
+
+  static bool
+test_ladder_errors( void )
+{
+  roster_pokemon_t rmons[3 * TEST_NTEAMS];
+  base_pokemon_t   bases[3 * TEST_NTEAMS];
+  ladder_t         ladder   = LADDER_INIT;
+  const float      none[2]  = { 0.0, -1.0 };
+
+  expect( make_teams( rmons, bases ) );
+  expect( ladder_init( & ladder, rmons, TEST_NTEAMS, NULL, 1, & CSTORE,
+                       NULL
+                     ) == STORE_ERROR_BAD_VALUE
+        );
+  expect( ladder_init( & ladder, rmons, 0, NULL, 10, & CSTORE, NULL ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  expect( ladder_init( & ladder, rmons, 2, none, 10, & CSTORE, NULL ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  expect( ladder.players == NULL );
+
+  /* Two players always meet, and one team plays itself */
+  expect( ladder_init( & ladder, rmons, 1, NULL, 2, & CSTORE, NULL ) ==
+          STORE_SUCCESS
+        );
+  expect( ladder_run( & ladder, 3 ) == STORE_SUCCESS );
+  expect( ladder.nbattles == 3 );
+  expect( ladder.nsimulated == 1 );
+  expect( ladder.stats[0].battles == 6 );
+  ladder_free( & ladder );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_ladder( void )
+{
+  bool rsl = true;
+
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= do_test( ladder_elo );
+  rsl &= do_test( ladder_glicko );
+  rsl &= do_test( ladder_deterministic );
+  rsl &= do_test( ladder_stats );
+  rsl &= do_test( ladder_errors );
+  CS_free();
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_ladder() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
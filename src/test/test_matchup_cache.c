@@ -0,0 +1,430 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "matchup.h"
+#include "matchup_cache.h"
+#include "pokedex.h"
+#include "pokemon.h"
+#include "util/parallel.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+#define TEST_DATA_VERSION  20201231
+#define TEST_NMONS         6
+#define TEST_NKEYS         300
+
+
+/* A made up Pokemon, distinct for every `i' */
+  static matchup_mon_key_t
+fake_key( uint32_t i )
+{
+  return (matchup_mon_key_t) {
+    .stats     = { .attack = 100 + i, .stamina = 100, .defense = 100 },
+    .level     = 20,
+    .reserved0 = 0,
+    .types     = 1,
+    .move_ids  = { 1, 2, (uint16_t) ( i % 7 ) },
+    .reserved1 = 0
+  };
+}
+
+#define fake_rating( I, J )  ( (uint16_t) ( ( ( I ) * 31 + ( J ) ) % 1001 ) )
+
+
+/* The first moveset of the first `n' species with moves, at level 20. */
+  static bool
+make_mons( pvp_pokemon_t * mons, uint32_t n )
+{
+  roster_pokemon_t rmons[TEST_NMONS];
+  base_pokemon_t   bases[TEST_NMONS];
+  uint16_t         dex = 1;
+
+  if ( TEST_NMONS < n ) return false;
+  for ( uint32_t i = 0; i < n; dex++ )
+    {
+      if ( dex == 0 ) return false;
+      if ( base_mon_from_store( & CSTORE, dex, 0, 20.0, 15, 15, 15,
+                                bases + i
+                              ) != STORE_SUCCESS
+         )
+        {
+          continue;
+        }
+      const pdex_mon_t * pdex = bases[i].pdex_mon;
+      if ( ( pdex->fast_moves_cnt == 0 ) || ( pdex->charged_moves_cnt == 0 ) )
+        {
+          continue;
+        }
+      rmons[i] = (roster_pokemon_t) {
+        .base             = bases + i,
+        .fast_move_id     = abs( pdex->fast_move_ids[0] ),
+        .charged_move_ids = {
+          abs( pdex->charged_move_ids[0] ),
+          ( 1 < pdex->charged_moves_cnt ) ? abs( pdex->charged_move_ids[1] )
+                                          : 0
+        }
+      };
+      i++;
+    }
+  return pvp_pokemon_init_many( mons, rmons, n, & CSTORE ) == STORE_SUCCESS;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_matchup_cache_table( void )
+{
+  matchup_cache_t       cache;
+  matchup_cache_stats_t stats;
+  uint16_t              rating = 0;
+  matchup_mon_key_t     k1     = fake_key( 1 );
+  matchup_mon_key_t     k2     = fake_key( 2 );
+
+  matchup_cache_init( & cache, TEST_DATA_VERSION );
+  expect( ! matchup_cache_get( & cache, & k1, & k2, 0, & rating ) );
+  expect( matchup_cache_put( & cache, & k1, & k2, 0, 700 ) == STORE_SUCCESS );
+  expect( matchup_cache_get( & cache, & k1, & k2, 0, & rating ) );
+  expect( rating == 700 );
+  expect( ! matchup_cache_get( & cache, & k2, & k1, 0, & rating ) );
+  expect( ! matchup_cache_get( & cache, & k1, & k2, 4, & rating ) );
+
+  /* A matchup's rating never changes, the first is kept */
+  expect( matchup_cache_put( & cache, & k1, & k2, 0, 300 ) == STORE_SUCCESS );
+  expect( matchup_cache_get( & cache, & k1, & k2, 0, & rating ) );
+  expect( rating == 700 );
+
+  /* A rating of 0 is a rating */
+  expect( matchup_cache_put( & cache, & k2, & k1, 0, 0 ) == STORE_SUCCESS );
+  rating = 1;
+  expect( matchup_cache_get( & cache, & k2, & k1, 0, & rating ) );
+  expect( rating == 0 );
+
+  matchup_cache_stats( & cache, & stats );
+  expect( ( stats.entries == 2 ) && ( stats.hits == 3 ) );
+  expect( ( stats.misses == 3 ) && ( stats.file_hits == 0 ) );
+  matchup_cache_reset_stats( & cache );
+  matchup_cache_stats( & cache, & stats );
+  expect( ( stats.hits == 0 ) && ( stats.misses == 0 ) );
+  expect( stats.entries == 2 );
+
+  /* Growing keeps every rating */
+  for ( uint32_t i = 0; i < TEST_NKEYS; i++ )
+    {
+      matchup_mon_key_t a = fake_key( i );
+      matchup_mon_key_t b = fake_key( i + 1000 );
+      expect( matchup_cache_put( & cache, & a, & b, 3, fake_rating( i, 3 ) )
+              == STORE_SUCCESS
+            );
+    }
+  matchup_cache_stats( & cache, & stats );
+  uint32_t cap = stats.cap;
+  expect( matchup_cache_reserve( & cache, cap ) == STORE_SUCCESS );
+  matchup_cache_stats( & cache, & stats );
+  expect( cap < stats.cap );
+  expect( stats.entries == TEST_NKEYS + 2 );
+  for ( uint32_t i = 0; i < TEST_NKEYS; i++ )
+    {
+      matchup_mon_key_t a = fake_key( i );
+      matchup_mon_key_t b = fake_key( i + 1000 );
+      expect( matchup_cache_get( & cache, & a, & b, 3, & rating ) );
+      expect( rating == fake_rating( i, 3 ) );
+    }
+  expect( matchup_cache_get( & cache, & k1, & k2, 0, & rating ) );
+  expect( rating == 700 );
+
+  /* A full table drops inserts rather than growing */
+  cap = stats.cap;
+  for ( uint32_t i = 0; i < cap; i++ )
+    {
+      matchup_mon_key_t a = fake_key( i );
+      expect( matchup_cache_put( & cache, & a, & a, 8, 1 ) == STORE_SUCCESS );
+    }
+  matchup_cache_stats( & cache, & stats );
+  expect( stats.cap == cap );
+  expect( 0 < stats.dropped );
+  expect( stats.entries + stats.dropped == cap + TEST_NKEYS + 2 );
+  expect( stats.entries < cap );
+
+  matchup_cache_free( & cache );
+  matchup_cache_stats( & cache, & stats );
+  expect( ( stats.entries == 0 ) && ( stats.cap == 0 ) );
+  expect( cache.data_version == TEST_DATA_VERSION );
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+struct cache_job_s {
+  matchup_cache_t * cache;
+  bool              bad;
+};
+typedef struct cache_job_s  cache_job_t;
+
+
+/* Every item inserts and reads back a window of keys other items share. */
+  static void
+cache_job_fn( void * vjob, uint32_t begin, uint32_t end, uint32_t t )
+{
+  cache_job_t * job = (cache_job_t *) vjob;
+  for ( uint32_t i = begin; i < end; i++ )
+    {
+      for ( uint32_t j = i; j < i + 16; j++ )
+        {
+          matchup_mon_key_t a      = fake_key( j % TEST_NKEYS );
+          matchup_mon_key_t b      = fake_key( 0 );
+          uint16_t          rating = 0;
+          matchup_cache_put( job->cache, & a, & b, 1,
+                             fake_rating( j % TEST_NKEYS, 1 )
+                           );
+          if ( ! matchup_cache_get( job->cache, & a, & b, 1, & rating ) )
+            {
+              /* Only possible while another thread is writing it */
+              continue;
+            }
+          if ( rating != fake_rating( j % TEST_NKEYS, 1 ) ) job->bad = true;
+        }
+    }
+}
+
+
+  static bool
+test_matchup_cache_threads( void )
+{
+  matchup_cache_t       cache;
+  matchup_cache_stats_t stats;
+  cache_job_t           job = { .cache = & cache, .bad = false };
+
+  matchup_cache_init( & cache, TEST_DATA_VERSION );
+  expect( matchup_cache_reserve( & cache, TEST_NKEYS ) == STORE_SUCCESS );
+  expect( parallel_for( TEST_NKEYS * 4, 7, 8, cache_job_fn, & job ) == 0 );
+  expect( ! job.bad );
+
+  matchup_cache_stats( & cache, & stats );
+  expect( stats.entries == TEST_NKEYS );
+  expect( stats.dropped == 0 );
+  for ( uint32_t i = 0; i < TEST_NKEYS; i++ )
+    {
+      matchup_mon_key_t a      = fake_key( i );
+      matchup_mon_key_t b      = fake_key( 0 );
+      uint16_t          rating = 0;
+      expect( matchup_cache_get( & cache, & a, & b, 1, & rating ) );
+      expect( rating == fake_rating( i, 1 ) );
+    }
+
+  matchup_cache_free( & cache );
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_matchup_cache_build( void )
+{
+  const uint32_t        n      = TEST_NMONS;
+  pvp_pokemon_t         mons[TEST_NMONS];
+  matchup_cache_t       cache;
+  matchup_cache_stats_t stats;
+  matchup_matrix_t      plain  = MATCHUP_MATRIX_INIT;
+  matchup_matrix_t      cached = MATCHUP_MATRIX_INIT;
+  matchup_opts_t        opts   = MATCHUP_OPTS_DEFAULT;
+
+  expect( make_mons( mons, n ) );
+  matchup_cache_init( & cache, TEST_DATA_VERSION );
+
+  /* Cached builds match plain ones, and only simulate what's new */
+  opts.nthreads = 3;
+  expect( matchup_matrix_build( & plain, mons, n, mons, n, & opts ) ==
+          STORE_SUCCESS
+        );
+  opts.cache = & cache;
+  expect( matchup_matrix_build( & cached, mons, n - 2, mons, n, & opts ) ==
+          STORE_SUCCESS
+        );
+  matchup_cache_stats( & cache, & stats );
+  expect( stats.entries == ( n - 2 ) * n * 3 );
+  expect( ( stats.hits == 0 ) && ( stats.misses == stats.entries ) );
+  matchup_matrix_free( & cached );
+
+  expect( matchup_matrix_build( & cached, mons, n, mons, n, & opts ) ==
+          STORE_SUCCESS
+        );
+  matchup_cache_stats( & cache, & stats );
+  expect( stats.entries == n * n * 3 );
+  expect( stats.hits == ( n - 2 ) * n * 3 );
+  expect( memcmp( plain.ratings, cached.ratings,
+                  sizeof( uint16_t ) * n * n * 3
+                ) == 0
+        );
+
+  /* Column updates use the cache too */
+  const uint32_t col  = 0;
+  matchup_cache_reset_stats( & cache );
+  expect( matchup_matrix_update_cols( & cached, mons, & col, mons + 1, 1, 2,
+                                      & cache
+                                    ) == STORE_SUCCESS
+        );
+  matchup_cache_stats( & cache, & stats );
+  expect( ( stats.hits == n * 3 ) && ( stats.misses == 0 ) );
+  expect( matchup_matrix_get( & cached, 2, 0, 0 ) ==
+          matchup_matrix_get( & plain, 2, 0, 1 )
+        );
+
+  /* Another scenario is another matchup */
+  matchup_matrix_free( & cached );
+  opts.scenarios = matchup_scenario_mask( matchup_scenario( 1, 0 ) );
+  expect( matchup_matrix_build( & cached, mons, n, mons, n, & opts ) ==
+          STORE_SUCCESS
+        );
+  matchup_cache_stats( & cache, & stats );
+  expect( stats.entries == n * n * 4 );
+  expect( matchup_matrix_get( & cached, 0, 0, 1 ) ==
+          matchup_battle( mons, mons + 1, matchup_scenario( 1, 0 ) )
+        );
+
+  matchup_matrix_free( & plain );
+  matchup_matrix_free( & cached );
+  matchup_cache_free( & cache );
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_matchup_cache_file( void )
+{
+  char                  path[] = "/tmp/cpoke_test_matchup_cache_XXXXXX";
+  matchup_cache_t       cache;
+  matchup_cache_t       other;
+  matchup_cache_stats_t stats;
+  uint16_t              rating = 0;
+  int                   fd     = mkstemp( path );
+
+  expect( fd != -1 );
+  close( fd );
+  matchup_cache_init( & cache, TEST_DATA_VERSION );
+  matchup_cache_init( & other, TEST_DATA_VERSION + 1 );
+
+  /* Empty and garbage files don't load */
+  expect( matchup_cache_load( & cache, path ) == STORE_ERROR_BAD_VALUE );
+  FILE * ostream = fopen( path, "w" );
+  expect( ostream != NULL );
+  fputs( "Not a cache file, though it is long enough to hold a header.",
+         ostream
+       );
+  fclose( ostream );
+  expect( matchup_cache_load( & cache, path ) == STORE_ERROR_BAD_VALUE );
+
+  for ( uint32_t i = 0; i < TEST_NKEYS; i++ )
+    {
+      matchup_mon_key_t a = fake_key( i );
+      matchup_mon_key_t b = fake_key( i + 1 );
+      expect( matchup_cache_put( & cache, & a, & b, 2, fake_rating( i, 2 ) )
+              == STORE_SUCCESS
+            );
+    }
+  expect( matchup_cache_save( & cache, path ) == STORE_SUCCESS );
+  matchup_cache_free( & cache );
+
+  /* Only the same data version loads */
+  expect( matchup_cache_load( & other, path ) == STORE_ERROR_BAD_VALUE );
+  matchup_cache_stats( & other, & stats );
+  expect( stats.file_entries == 0 );
+  expect( matchup_cache_load( & cache, path ) == STORE_SUCCESS );
+  matchup_cache_stats( & cache, & stats );
+  expect( ( stats.file_entries == TEST_NKEYS ) && ( stats.entries == 0 ) );
+  for ( uint32_t i = 0; i < TEST_NKEYS; i++ )
+    {
+      matchup_mon_key_t a = fake_key( i );
+      matchup_mon_key_t b = fake_key( i + 1 );
+      expect( matchup_cache_get( & cache, & a, & b, 2, & rating ) );
+      expect( rating == fake_rating( i, 2 ) );
+    }
+  matchup_mon_key_t a = fake_key( 0 );
+  expect( ! matchup_cache_get( & cache, & a, & a, 2, & rating ) );
+  matchup_cache_stats( & cache, & stats );
+  expect( ( stats.file_hits == TEST_NKEYS ) && ( stats.hits == 0 ) );
+  expect( stats.misses == 1 );
+
+  /* Saving merges both tiers */
+  expect( matchup_cache_put( & cache, & a, & a, 2, 42 ) == STORE_SUCCESS );
+  expect( matchup_cache_save( & cache, path ) == STORE_SUCCESS );
+  expect( matchup_cache_load( & cache, path ) == STORE_SUCCESS );
+  matchup_cache_stats( & cache, & stats );
+  expect( stats.file_entries == TEST_NKEYS + 1 );
+  matchup_cache_free( & cache );
+  expect( matchup_cache_load( & cache, path ) == STORE_SUCCESS );
+  expect( matchup_cache_get( & cache, & a, & a, 2, & rating ) );
+  expect( rating == 42 );
+  matchup_cache_free( & cache );
+
+  /* A count that disagrees with the slots doesn't load */
+  matchup_cache_header_t header;
+  FILE * iostream = fopen( path, "r+" );
+  expect( iostream != NULL );
+  expect( fread( & header, sizeof( header ), 1, iostream ) == 1 );
+  header.cnt = 1;
+  rewind( iostream );
+  expect( fwrite( & header, sizeof( header ), 1, iostream ) == 1 );
+  fclose( iostream );
+  expect( matchup_cache_load( & cache, path ) == STORE_ERROR_BAD_VALUE );
+  matchup_cache_stats( & cache, & stats );
+  expect( stats.file_entries == 0 );
+
+  unlink( path );
+  expect( matchup_cache_load( & cache, path ) == STORE_ERROR_NOT_FOUND );
+  matchup_cache_free( & other );
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_matchup_cache( void )
+{
+  bool rsl = true;
+
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= do_test( matchup_cache_table );
+  rsl &= do_test( matchup_cache_threads );
+  rsl &= do_test( matchup_cache_build );
+  rsl &= do_test( matchup_cache_file );
+  CS_free();
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_matchup_cache() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
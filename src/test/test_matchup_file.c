@@ -0,0 +1,297 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "matchup.h"
+#include "matchup_file.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "util/test_util.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+#define TEST_DATA_VERSION  20201231
+
+/* Partial tiles on both edges */
+#define TEST_NROWS  ( MATCHUP_FILE_TILE_ROWS * 2 + 5 )
+#define TEST_NCOLS  ( MATCHUP_FILE_TILE_COLS + 7 )
+
+#define fake_rating( R, S, C )                                                \
+  ( (uint16_t) ( ( ( R ) * 7 + ( S ) * 131 + ( C ) * 3 ) % 1001 ) )
+
+
+/* A matrix of made up ratings, with rows and columns to name them. */
+  static bool
+make_matrix( matchup_matrix_t   * matrix,
+             matchup_file_mon_t * rows,
+             matchup_file_mon_t * cols
+           )
+{
+  * matrix = (matchup_matrix_t) {
+    .nrows      = TEST_NROWS,
+    .ncols      = TEST_NCOLS,
+    .nscenarios = 3,
+    .scenarios  = { matchup_scenario( 0, 0 ), matchup_scenario( 1, 1 ),
+                    matchup_scenario( 2, 2 )
+                  },
+    .ratings    = (uint16_t *)
+      malloc( sizeof( uint16_t ) * TEST_NROWS * 3 * TEST_NCOLS )
+  };
+  if ( matrix->ratings == NULL ) return false;
+
+  for ( uint32_t r = 0; r < TEST_NROWS; r++ )
+    {
+      for ( uint8_t s = 0; s < 3; s++ )
+        {
+          for ( uint32_t c = 0; c < TEST_NCOLS; c++ )
+            {
+              matrix->ratings[( r * 3 + s ) * TEST_NCOLS + c] =
+                fake_rating( r, s, c );
+            }
+        }
+      rows[r] = (matchup_file_mon_t) {
+        .dex_number       = 1 + r / 4,
+        .form_idx         = 0,
+        .level            = 40,
+        .fast_move_id     = 200 + r % 4,
+        .charged_move_ids = { 90, 0 },
+        .reserved         = 0
+      };
+    }
+  for ( uint32_t c = 0; c < TEST_NCOLS; c++ )
+    {
+      cols[c] = (matchup_file_mon_t) {
+        .dex_number       = 1 + c,
+        .form_idx         = 1,
+        .level            = 30,
+        .fast_move_id     = 200,
+        .charged_move_ids = { 90, 91 },
+        .reserved         = 0
+      };
+    }
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_matchup_file_queries( void )
+{
+  char               path[] = "/tmp/cpoke_test_matchup_file_XXXXXX";
+  matchup_matrix_t   matrix = MATCHUP_MATRIX_INIT;
+  matchup_matrix_t   copy   = MATCHUP_MATRIX_INIT;
+  matchup_file_t     file   = MATCHUP_FILE_INIT;
+  matchup_file_mon_t rows[TEST_NROWS];
+  matchup_file_mon_t cols[TEST_NCOLS];
+  uint16_t           row[3 * TEST_NCOLS];
+  uint16_t           col[3 * TEST_NROWS];
+  uint32_t           idx    = 0;
+  int                fd     = mkstemp( path );
+
+  expect( fd != -1 );
+  close( fd );
+  expect( make_matrix( & matrix, rows, cols ) );
+  expect( matchup_file_save( & matrix, rows, cols, TEST_DATA_VERSION, path )
+          == STORE_SUCCESS
+        );
+  expect( matchup_file_open( & file, path, TEST_DATA_VERSION ) ==
+          STORE_SUCCESS
+        );
+
+  /* Tiles are pages, after the header */
+  expect( file.header->nrows == TEST_NROWS );
+  expect( file.header->ncols == TEST_NCOLS );
+  expect( file.header->nscenarios == 3 );
+  expect( memcmp( file.header->scenarios, matrix.scenarios,
+                  sizeof( matrix.scenarios )
+                ) == 0
+        );
+  expect( file.header->tiles_offset % MATCHUP_FILE_ALIGN == 0 );
+  expect( ( file.nbands == 3 ) && ( file.ntile_cols == 2 ) );
+  expect( file.header->size ==
+          file.header->tiles_offset + MATCHUP_FILE_TILE_SIZE * 3 * 3 * 2
+        );
+  expect( memcmp( file.rows, rows, sizeof( rows ) ) == 0 );
+  expect( memcmp( file.cols, cols, sizeof( cols ) ) == 0 );
+
+  for ( uint32_t r = 0; r < TEST_NROWS; r++ )
+    {
+      for ( uint8_t s = 0; s < 3; s++ )
+        {
+          for ( uint32_t c = 0; c < TEST_NCOLS; c++ )
+            {
+              expect( matchup_file_get( & file, r, s, c ) ==
+                      matchup_matrix_get( & matrix, r, s, c )
+                    );
+            }
+        }
+    }
+
+  /* Row scans are laid out like matrix rows */
+  for ( uint32_t r = 0; r < TEST_NROWS; r++ )
+    {
+      matchup_file_row( & file, r, row );
+      expect( memcmp( row, matchup_matrix_row( & matrix, r, 0 ),
+                      sizeof( row )
+                    ) == 0
+            );
+    }
+
+  for ( uint32_t c = 0; c < TEST_NCOLS; c++ )
+    {
+      matchup_file_col( & file, c, col );
+      for ( uint8_t s = 0; s < 3; s++ )
+        {
+          for ( uint32_t r = 0; r < TEST_NROWS; r++ )
+            {
+              expect( col[s * TEST_NROWS + r] == fake_rating( r, s, c ) );
+            }
+        }
+    }
+
+  expect( matchup_file_read_matrix( & file, & copy ) == STORE_SUCCESS );
+  expect( ( copy.nrows == TEST_NROWS ) && ( copy.ncols == TEST_NCOLS ) );
+  expect( copy.nscenarios == 3 );
+  expect( matchup_matrix_scenario_idx( & copy, matchup_scenario( 2, 2 ) )
+          == 2
+        );
+  expect( memcmp( copy.ratings, matrix.ratings,
+                  sizeof( uint16_t ) * TEST_NROWS * 3 * TEST_NCOLS
+                ) == 0
+        );
+  matchup_matrix_free( & copy );
+
+  /* Rows and columns are found by Pokemon and moveset */
+  expect( matchup_file_find( file.rows, TEST_NROWS, rows + 42, & idx ) );
+  expect( idx == 42 );
+  expect( matchup_file_find( file.cols, TEST_NCOLS, cols + 70, & idx ) );
+  expect( idx == 70 );
+  expect( ! matchup_file_find( file.cols, TEST_NCOLS, rows, & idx ) );
+
+  matchup_file_close( & file );
+  expect( file.header == NULL );
+  matchup_matrix_free( & matrix );
+  unlink( path );
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_matchup_file_errors( void )
+{
+  char               path[] = "/tmp/cpoke_test_matchup_file_XXXXXX";
+  matchup_matrix_t   matrix = MATCHUP_MATRIX_INIT;
+  matchup_file_t     file   = MATCHUP_FILE_INIT;
+  matchup_file_mon_t rows[TEST_NROWS];
+  matchup_file_mon_t cols[TEST_NCOLS];
+  int                fd     = mkstemp( path );
+
+  expect( fd != -1 );
+  close( fd );
+  expect( make_matrix( & matrix, rows, cols ) );
+
+  /* Empty, garbage, and truncated files don't open */
+  expect( matchup_file_open( & file, path, TEST_DATA_VERSION ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  FILE * ostream = fopen( path, "w" );
+  expect( ostream != NULL );
+  fputs( "Not a matrix file, though it is long enough to hold a header.",
+         ostream
+       );
+  fclose( ostream );
+  expect( matchup_file_open( & file, path, TEST_DATA_VERSION ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+
+  expect( matchup_file_save( & matrix, rows, cols, TEST_DATA_VERSION, path )
+          == STORE_SUCCESS
+        );
+  expect( truncate( path, MATCHUP_FILE_ALIGN * 2 ) == 0 );
+  expect( matchup_file_open( & file, path, TEST_DATA_VERSION ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+
+  /* Only the same data version opens */
+  expect( matchup_file_save( & matrix, rows, cols, TEST_DATA_VERSION, path )
+          == STORE_SUCCESS
+        );
+  expect( matchup_file_open( & file, path, TEST_DATA_VERSION + 1 ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  expect( file.header == NULL );
+
+  /* Nor does one naming an unknown scenario */
+  matchup_file_header_t header;
+  FILE * iostream = fopen( path, "r+" );
+  expect( iostream != NULL );
+  expect( fread( & header, sizeof( header ), 1, iostream ) == 1 );
+  header.scenarios[matrix.nscenarios - 1] = MATCHUP_NSCENARIOS;
+  rewind( iostream );
+  expect( fwrite( & header, sizeof( header ), 1, iostream ) == 1 );
+  fclose( iostream );
+  expect( matchup_file_open( & file, path, TEST_DATA_VERSION ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  expect( file.header == NULL );
+
+  /* An empty matrix is still a matrix */
+  matchup_matrix_free( & matrix );
+  matrix.nscenarios = 1;
+  expect( matchup_file_save( & matrix, NULL, NULL, TEST_DATA_VERSION, path )
+          == STORE_SUCCESS
+        );
+  expect( matchup_file_open( & file, path, TEST_DATA_VERSION ) ==
+          STORE_SUCCESS
+        );
+  expect( ( file.header->nrows == 0 ) && ( file.nbands == 0 ) );
+  matchup_file_close( & file );
+
+  unlink( path );
+  expect( matchup_file_open( & file, path, TEST_DATA_VERSION ) ==
+          STORE_ERROR_NOT_FOUND
+        );
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_matchup_file( void )
+{
+  bool rsl = true;
+
+  rsl &= do_test( matchup_file_queries );
+  rsl &= do_test( matchup_file_errors );
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_matchup_file() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
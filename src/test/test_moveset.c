@@ -0,0 +1,487 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "cupstore.h"
+#include "matchup.h"
+#include "moves.h"
+#include "moveset.h"
+#include "pokedex.h"
+#include "pokemon.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+static store_t CUPS = def_cupstore();
+
+/* The Kanto starters and their evolutions */
+#define TEST_CUP_QUERY  "dex:1-9"
+#define TEST_CP_CAP     1500
+/* The meta, see `make_meta' */
+#define TEST_NMETA      12
+
+/* Room for any species' movesets */
+static moveset_t ALL[UINT8_MAX * UINT8_MAX];
+static moveset_t KEPT[UINT8_MAX * UINT8_MAX];
+
+
+  static store_move_t *
+get_move( uint16_t move_id )
+{
+  store_move_t * move = NULL;
+  if ( CSTORE.get( & CSTORE, move_id_store_key( move_id ), (void **) & move )
+       != STORE_SUCCESS )
+    {
+      return NULL;
+    }
+  return move;
+}
+
+
+/* The first moveset of the first `n' species with moves, at level 20. */
+  static bool
+make_meta( pvp_pokemon_t * mons, uint32_t n )
+{
+  roster_pokemon_t rmons[TEST_NMETA];
+  base_pokemon_t   bases[TEST_NMETA];
+  uint16_t         dex = 1;
+
+  if ( TEST_NMETA < n ) return false;
+  for ( uint32_t i = 0; i < n; dex++ )
+    {
+      if ( dex == 0 ) return false;
+      if ( base_mon_from_store( & CSTORE, dex, 0, 20.0, 15, 15, 15,
+                                bases + i
+                              ) != STORE_SUCCESS
+         )
+        {
+          continue;
+        }
+      const pdex_mon_t * pdex = bases[i].pdex_mon;
+      if ( ( pdex->fast_moves_cnt == 0 ) || ( pdex->charged_moves_cnt == 0 ) )
+        {
+          continue;
+        }
+      rmons[i] = (roster_pokemon_t) {
+        .base             = bases + i,
+        .fast_move_id     = abs( pdex->fast_move_ids[0] ),
+        .charged_move_ids = {
+          abs( pdex->charged_move_ids[0] ),
+          ( 1 < pdex->charged_moves_cnt ) ? abs( pdex->charged_move_ids[1] )
+                                          : 0
+        }
+      };
+      i++;
+    }
+  return pvp_pokemon_init_many( mons, rmons, n, & CSTORE ) == STORE_SUCCESS;
+}
+
+
+  static bool
+same_moveset( const moveset_t * a, const moveset_t * b )
+{
+  return ( a->fast_move_id == b->fast_move_id ) &&
+         ( a->charged_move_ids[0] == b->charged_move_ids[0] ) &&
+         ( a->charged_move_ids[1] == b->charged_move_ids[1] );
+}
+
+
+  static bool
+has_moveset( const moveset_t * movesets, uint32_t n, const moveset_t * ms )
+{
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      if ( same_moveset( movesets + i, ms ) ) return true;
+    }
+  return false;
+}
+
+
+/* `a' is as good as `b': the same, dominating, or with equal stats */
+  static bool
+move_covers( uint16_t a, uint16_t b )
+{
+  if ( a == b ) return true;
+  store_move_t * ma = get_move( a );
+  store_move_t * mb = get_move( b );
+  return store_move_dominates( ma, mb ) || store_move_pvp_equal( ma, mb );
+}
+
+
+  static bool
+moveset_covers( const moveset_t * a, const moveset_t * b )
+{
+  if ( ! move_covers( a->fast_move_id, b->fast_move_id ) ) return false;
+  if ( b->charged_move_ids[1] == 0 )
+    {
+      return move_covers( a->charged_move_ids[0], b->charged_move_ids[0] );
+    }
+  return ( move_covers( a->charged_move_ids[0], b->charged_move_ids[0] ) &&
+           move_covers( a->charged_move_ids[1], b->charged_move_ids[1] ) ) ||
+         ( move_covers( a->charged_move_ids[0], b->charged_move_ids[1] ) &&
+           move_covers( a->charged_move_ids[1], b->charged_move_ids[0] ) );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_move_dominates( void )
+{
+  store_move_t fast1 = NO_MOVE_STORE;
+  fast1.type       = FIRE;
+  fast1.is_fast    = true;
+  fast1.move_id    = 1;
+  fast1.cooldown   = 1;
+  fast1.pvp_power  = 3;
+  fast1.pvp_energy = 9;
+
+  /* Same damage per turn, less energy */
+  store_move_t fast2 = fast1;
+  fast2.move_id    = 2;
+  fast2.cooldown   = 2;
+  fast2.pvp_power  = 6;
+  fast2.pvp_energy = 12;
+  expect( store_move_dominates( & fast1, & fast2 ) );
+  expect( ! store_move_dominates( & fast2, & fast1 ) );
+  expect( ! store_move_pvp_equal( & fast1, & fast2 ) );
+
+  /* More damage, less energy: neither is better */
+  fast2.pvp_power = 8;
+  expect( ! store_move_dominates( & fast1, & fast2 ) );
+  expect( ! store_move_dominates( & fast2, & fast1 ) );
+
+  /* Equal moves, and other types, are never dominated */
+  fast2 = fast1;
+  fast2.move_id = 2;
+  expect( store_move_pvp_equal( & fast1, & fast2 ) );
+  expect( ! store_move_dominates( & fast1, & fast2 ) );
+  fast2.type      = WATER;
+  fast2.pvp_power = 1;
+  expect( ! store_move_dominates( & fast1, & fast2 ) );
+
+  store_move_t charged1 = NO_MOVE_STORE;
+  charged1.type       = FIRE;
+  charged1.move_id    = 3;
+  charged1.pvp_power  = 90;
+  charged1.pvp_energy = 45;
+
+  /* Same energy, less power */
+  store_move_t charged2 = charged1;
+  charged2.move_id   = 4;
+  charged2.pvp_power = 80;
+  expect( store_move_dominates( & charged1, & charged2 ) );
+  expect( ! store_move_dominates( & charged2, & charged1 ) );
+  expect( ! store_move_dominates( & charged1, & fast1 ) );
+
+  /* A buff is worth keeping */
+  charged2.buff = (buff_t) {
+    .chance   = bc_1000,
+    .atk_buff = { .target = 0, .debuffp = 0, .amount = 1 },
+    .def_buff = { .target = 0, .debuffp = 0, .amount = 0 }
+  };
+  expect( ! store_move_dominates( & charged1, & charged2 ) );
+  charged1.buff = charged2.buff;
+  expect( store_move_dominates( & charged1, & charged2 ) );
+
+  /* Cheaper and stronger */
+  charged2.pvp_power  = 90;
+  charged2.pvp_energy = 50;
+  expect( store_move_dominates( & charged1, & charged2 ) );
+  charged2.pvp_power = 100;
+  expect( ! store_move_dominates( & charged1, & charged2 ) );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_moveset_candidates( void )
+{
+  moveset_t * all      = ALL;
+  moveset_t * kept     = KEPT;
+  uint32_t    total    = 0;
+  uint32_t    nkept    = 0;
+  uint32_t    nspecies = 0;
+
+  for ( uint16_t dex = 1; dex <= 151; dex++ )
+    {
+      pdex_mon_t * pdex = NULL;
+      if ( CSTORE.get( & CSTORE, dex_form_store_key( dex, 0 ),
+                       (void **) & pdex
+                     ) != STORE_SUCCESS )
+        {
+          continue;
+        }
+      uint32_t nall = 0;
+      uint32_t n    = 0;
+      expect( moveset_candidates( & CSTORE, pdex, false, all, & nall ) ==
+              STORE_SUCCESS
+            );
+      expect( moveset_candidates( & CSTORE, pdex, true, kept, & n ) ==
+              STORE_SUCCESS
+            );
+      if ( ( pdex->fast_moves_cnt == 0 ) || ( pdex->charged_moves_cnt == 0 ) )
+        {
+          expect( ( nall == 0 ) && ( n == 0 ) );
+          continue;
+        }
+      expect( nall == moveset_count( pdex ) );
+      expect( ( 0 < n ) && ( n <= nall ) );
+      nspecies++;
+      total += nall;
+      nkept += n;
+
+      /* Survivors keep Pokedex order, and don't dominate each other */
+      uint32_t a = 0;
+      for ( uint32_t k = 0; k < n; k++ )
+        {
+          while ( ( a < nall ) && ! same_moveset( all + a, kept + k ) ) a++;
+          expect( a < nall );
+          for ( uint32_t j = 0; j < n; j++ )
+            {
+              if ( j == k ) continue;
+              expect( ! moveset_covers( kept + j, kept + k ) );
+            }
+        }
+
+      /* Every moveset left out is no better than one kept */
+      for ( uint32_t i = 0; i < nall; i++ )
+        {
+          if ( has_moveset( kept, n, all + i ) ) continue;
+          bool covered = false;
+          for ( uint32_t k = 0; ( k < n ) && ( ! covered ); k++ )
+            {
+              covered = moveset_covers( kept + k, all + i );
+            }
+          expect( covered );
+        }
+    }
+
+  expect( 0 < nspecies );
+  expect( nkept < total );
+
+  /* Pruning needs moves, listing doesn't */
+  pdex_mon_t * pdex = NULL;
+  uint32_t     n    = 0;
+  expect( CSTORE.get( & CSTORE, dex_form_store_key( 1, 0 ), (void **) & pdex )
+          == STORE_SUCCESS
+        );
+  expect( moveset_candidates( NULL, pdex, true, kept, & n ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  expect( moveset_candidates( NULL, pdex, false, kept, & n ) ==
+          STORE_SUCCESS
+        );
+  expect( n == moveset_count( pdex ) );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_moveset_optimize( void )
+{
+  cup_t                 * cup    = NULL;
+  pvp_pokemon_t           meta[TEST_NMETA];
+  moveset_league_t        pruned = MOVESET_LEAGUE_INIT;
+  moveset_league_t        full   = MOVESET_LEAGUE_INIT;
+  moveset_league_t        again  = MOVESET_LEAGUE_INIT;
+  moveset_opts_t          opts   = MOVESET_OPTS_DEFAULT;
+  matchup_cache_t         cache  = MATCHUP_CACHE_INIT;
+  matchup_cache_stats_t   stats;
+  moveset_t             * kept   = KEPT;
+
+  expect( cupstore_get_str( & CUPS, "TEST_CUP", (void **) & cup ) ==
+          STORE_SUCCESS
+        );
+  expect( make_meta( meta, TEST_NMETA ) );
+
+  opts.nthreads = 1;
+  opts.cache    = & cache;
+  expect( moveset_optimize( & pruned, cup, meta, TEST_NMETA, & opts ) ==
+          STORE_SUCCESS
+        );
+  expect( pruned.cp_cap == TEST_CP_CAP );
+  expect( ( 0 < pruned.nspecies ) && ( pruned.nspecies <= cup->pool_size ) );
+  expect( pruned.nsimulated < pruned.nmovesets );
+  matchup_cache_stats( & cache, & stats );
+  expect( stats.hits + stats.misses == pruned.nsimulated * TEST_NMETA * 3 );
+  expect( stats.entries == stats.misses );
+  /* Costumes battle like their base form, and share ratings */
+  expect( 0 < stats.hits );
+
+  /* Without pruning, only the extra movesets are simulated */
+  opts.prune    = false;
+  opts.nthreads = 3;
+  expect( moveset_optimize( & full, cup, meta, TEST_NMETA, & opts ) ==
+          STORE_SUCCESS
+        );
+  expect( full.nspecies == pruned.nspecies );
+  expect( full.nsimulated == full.nmovesets );
+  expect( full.nmovesets == pruned.nmovesets );
+  uint64_t hits = stats.hits;
+  matchup_cache_stats( & cache, & stats );
+  expect( stats.hits + stats.misses ==
+          ( pruned.nsimulated + full.nmovesets ) * TEST_NMETA * 3
+        );
+  expect( pruned.nsimulated * TEST_NMETA * 3 <= stats.hits - hits );
+
+  for ( uint32_t s = 0; s < pruned.nspecies; s++ )
+    {
+      const moveset_best_t * p = pruned.best + s;
+      const moveset_best_t * f = full.best + s;
+      pdex_mon_t           * pdex = NULL;
+      uint32_t               n    = 0;
+
+      expect( ( p->dex_number == f->dex_number ) &&
+              ( p->form_idx == f->form_idx ) && ( p->level == f->level )
+            );
+      expect( ( 0.0 <= p->score ) && ( p->score <= MATCHUP_RATING_MAX ) );
+      expect( p->score <= f->score );
+      expect( CSTORE.get( & CSTORE,
+                          dex_form_store_key( p->dex_number, p->form_idx ),
+                          (void **) & pdex
+                        ) == STORE_SUCCESS
+            );
+      expect( moveset_candidates( & CSTORE, pdex, true, kept, & n ) ==
+              STORE_SUCCESS
+            );
+      expect( p->nsimulated == n );
+      expect( has_moveset( kept, n, & p->moveset ) );
+      /* When the best moveset survives pruning it is found */
+      if ( has_moveset( kept, n, & f->moveset ) )
+        {
+          expect( same_moveset( & p->moveset, & f->moveset ) );
+          expect( fabsf( p->score - f->score ) < 0.01 );
+        }
+    }
+
+  /* Repeating a league is free, and gives the same answer */
+  uint64_t misses = stats.misses;
+  opts.prune = true;
+  expect( moveset_optimize( & again, cup, meta, TEST_NMETA, & opts ) ==
+          STORE_SUCCESS
+        );
+  matchup_cache_stats( & cache, & stats );
+  expect( stats.misses == misses );
+  expect( again.nspecies == pruned.nspecies );
+  for ( uint32_t s = 0; s < pruned.nspecies; s++ )
+    {
+      expect( same_moveset( & again.best[s].moveset,
+                            & pruned.best[s].moveset
+                          )
+            );
+      expect( again.best[s].score == pruned.best[s].score );
+    }
+  moveset_league_free( & again );
+  expect( again.best == NULL );
+
+  /* Weighting the meta changes scores, but not the candidates */
+  float weights[TEST_NMETA] = { 0.0 };
+  weights[0]   = 1.0;
+  opts.weights = weights;
+  expect( moveset_optimize( & again, cup, meta, TEST_NMETA, & opts ) ==
+          STORE_SUCCESS
+        );
+  expect( again.nsimulated == pruned.nsimulated );
+  matchup_cache_stats( & cache, & stats );
+  expect( stats.misses == misses );
+  moveset_league_free( & again );
+
+  moveset_league_free( & pruned );
+  moveset_league_free( & full );
+  matchup_cache_free( & cache );
+  return true;
+}
+
+
+  static bool
+test_moveset_errors( void )
+{
+  cup_t            * cup    = NULL;
+  pvp_pokemon_t      meta[TEST_NMETA];
+  moveset_league_t   league = MOVESET_LEAGUE_INIT;
+  moveset_opts_t     opts   = MOVESET_OPTS_DEFAULT;
+  float              zeros[TEST_NMETA] = { 0.0 };
+
+  expect( make_meta( meta, TEST_NMETA ) );
+  expect( cupstore_get_str( & CUPS, "TEST_CUP", (void **) & cup ) ==
+          STORE_SUCCESS
+        );
+  expect( moveset_optimize( & league, cup, meta, 0, NULL ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  opts.weights = zeros;
+  expect( moveset_optimize( & league, cup, meta, TEST_NMETA, & opts ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  expect( league.best == NULL );
+
+  expect( cupstore_get_str( & CUPS, "EMPTY_CUP", (void **) & cup ) ==
+          STORE_SUCCESS
+        );
+  expect( moveset_optimize( & league, cup, meta, TEST_NMETA, NULL ) ==
+          STORE_ERROR_NOT_FOUND
+        );
+  expect( ( league.best == NULL ) && ( league.nspecies == 0 ) );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_moveset( void )
+{
+  bool rsl = true;
+
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= CUPS.init( & CUPS, & CSTORE ) == STORE_SUCCESS;
+  rsl &= cupstore_add_cup( & CUPS, "TEST_CUP", TEST_CP_CAP, TEST_CUP_QUERY )
+         == STORE_SUCCESS;
+  rsl &= cupstore_add_cup( & CUPS, "EMPTY_CUP", TEST_CP_CAP, "!all" )
+         == STORE_SUCCESS;
+  rsl &= do_test( move_dominates );
+  rsl &= do_test( moveset_candidates );
+  rsl &= do_test( moveset_optimize );
+  rsl &= do_test( moveset_errors );
+  CUPS.free( & CUPS );
+  CS_free();
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_moveset() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,202 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "moves.h"
+#include "name_index.h"
+#include "overlay_store.h"
+#include "pokedex.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+static name_index_t NAME_INDEX;
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_name_index_normalize( void )
+{
+  char buffer[NAME_INDEX_MAX_LEN + 1];
+
+  expect( name_index_normalize( "galarain stunfsk", buffer ) == 16 );
+  expect( strcmp( buffer, "GALARAIN_STUNFSK" ) == 0 );
+  expect( name_index_normalize( "  Mr. Mime!", buffer ) == 7 );
+  expect( strcmp( buffer, "MR_MIME" ) == 0 );
+  expect( name_index_normalize( "", buffer ) == 0 );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_name_index_pokemon( void )
+{
+  pdex_mon_t * mon  = NULL;
+  int          dist = -1;
+
+  expect( name_index_init( & NAME_INDEX, & CSTORE ) == STORE_SUCCESS );
+
+  /* Exact names resolve to the base form */
+  expect( name_index_lookup( & NAME_INDEX,
+                             STORE_POKEDEX,
+                             "stunfisk",
+                             0,
+                             (void **) & mon,
+                             & dist
+                           ) == STORE_SUCCESS
+        );
+  expect( mon->dex_number == 618 );
+  expect( mon->form_idx == 0 );
+  expect( dist == 0 );
+
+  /* Misspelled, with the form first */
+  expect( name_index_lookup( & NAME_INDEX,
+                             STORE_POKEDEX,
+                             "galarain stunfsk",
+                             3,
+                             (void **) & mon,
+                             & dist
+                           ) == STORE_SUCCESS
+        );
+  expect( mon->dex_number == 618 );
+  expect( strcmp( mon->form_name, "GALARIAN" ) == 0 );
+  expect( dist == 3 );
+
+  /* And with the form last */
+  expect( name_index_lookup( & NAME_INDEX,
+                             STORE_POKEDEX,
+                             "Meowth-Alola",
+                             0,
+                             (void **) & mon,
+                             NULL
+                           ) == STORE_SUCCESS
+        );
+  expect( mon->dex_number == 52 );
+  expect( strcmp( mon->form_name, "ALOLA" ) == 0 );
+
+  expect( name_index_lookup( & NAME_INDEX,
+                             STORE_POKEDEX,
+                             "zzzzzzzzzzzz",
+                             2,
+                             (void **) & mon,
+                             NULL
+                           ) == STORE_ERROR_NOT_FOUND
+        );
+  expect( mon == NULL );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_name_index_move( void )
+{
+  store_move_t * move = NULL;
+  int            dist = -1;
+
+  expect( name_index_lookup( & NAME_INDEX,
+                             STORE_MOVE,
+                             "hyperbeem",
+                             2,
+                             (void **) & move,
+                             & dist
+                           ) == STORE_SUCCESS
+        );
+  expect( strcmp( move->name, "HYPER_BEAM" ) == 0 );
+  expect( dist == 2 );
+
+  expect( name_index_lookup( & NAME_INDEX,
+                             STORE_ROSTER,
+                             "WRAP",
+                             2,
+                             (void **) & move,
+                             NULL
+                           ) == STORE_ERROR_BAD_VALUE
+        );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* An index over an overlay returns the overlay's values. */
+  static bool
+test_name_index_overlay( void )
+{
+  store_t        overlay = def_overlay_store();
+  name_index_t   idx;
+  store_move_t * edited  = NULL;
+  store_move_t * move    = NULL;
+
+  expect( overlay_store_init( & overlay, & CSTORE ) == STORE_SUCCESS );
+  expect( overlay_store_edit_move( & overlay, 13, & edited ) == STORE_SUCCESS );
+  expect( name_index_init( & idx, & overlay ) == STORE_SUCCESS );
+  expect( idx.moves.cnt == NAME_INDEX.moves.cnt );
+
+  expect( name_index_lookup( & idx,
+                             STORE_MOVE,
+                             "wrpa",
+                             2,
+                             (void **) & move,
+                             NULL
+                           ) == STORE_SUCCESS
+        );
+  expect( move == edited );
+
+  name_index_free( & idx );
+  overlay_store_free( & overlay );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_name_index( void )
+{
+  bool rsl = true;
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= do_test( name_index_normalize );
+  rsl &= do_test( name_index_pokemon );
+  rsl &= do_test( name_index_move );
+  rsl &= do_test( name_index_overlay );
+  name_index_free( & NAME_INDEX );
+  CS_free();
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_name_index() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,461 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "matchup.h"
+#include "nash.h"
+#include "pokedex.h"
+#include "pokemon.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+#define TEST_TOLERANCE  1e-3
+
+static const nash_method_t METHODS[] = {
+  NASH_LP, NASH_REGRET, NASH_FICTITIOUS
+};
+#define NMETHODS  ( sizeof( METHODS ) / sizeof( METHODS[0] ) )
+
+
+  static bool
+make_game( nash_game_t * game, uint32_t m, uint32_t n, const double * p )
+{
+  if ( nash_game_init( game, m, n ) != STORE_SUCCESS ) return false;
+  memcpy( game->payoff, p, sizeof( double ) * m * n );
+  return true;
+}
+
+
+/* Lopsided made up Battle Ratings, scaled to 0 - 1 */
+  static bool
+make_random_game( nash_game_t * game, uint32_t m, uint32_t n )
+{
+  uint32_t seed = 4242;
+  if ( nash_game_init( game, m, n ) != STORE_SUCCESS ) return false;
+  for ( size_t i = 0; i < (size_t) m * n; i++ )
+    {
+      seed = seed * 1103515245 + 12345;
+      game->payoff[i] = ( ( seed >> 16 ) % 1001 ) / 1000.0;
+    }
+  return true;
+}
+
+
+/* Neither side gains more than `tol' by deviating */
+  static bool
+is_equilibrium( const nash_game_t * game, const nash_eq_t * eq, double tol )
+{
+  double row_best = 0.0;
+  double col_best = 0.0;
+  double rsum     = 0.0;
+  double csum     = 0.0;
+  nash_best_row( game, eq->col, & row_best );
+  nash_best_col( game, eq->row, & col_best );
+  for ( uint32_t r = 0; r < game->nrows; r++ ) rsum += eq->row[r];
+  for ( uint32_t c = 0; c < game->ncols; c++ ) csum += eq->col[c];
+  return ( fabs( rsum - 1.0 ) < 1e-9 ) && ( fabs( csum - 1.0 ) < 1e-9 ) &&
+         ( row_best <= eq->value + tol ) && ( eq->value - tol <= col_best ) &&
+         ( fabs( row_best - col_best - eq->gap ) < 1e-9 );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_nash_small( void )
+{
+  /* Rock, Paper, Scissors */
+  const double rps[9] = { 0.5, 0.0, 1.0, 1.0, 0.5, 0.0, 0.0, 1.0, 0.5 };
+  /* Mixed, with row 0 played 2/5 of the time, worth 1/5 */
+  const double mix[4] = { 2.0, -1.0, -1.0, 1.0 };
+  /* A saddle point at row 1, column 0, and a dominated row */
+  const double saddle[6] = { 0.2, 0.9, 0.6, 0.7, 0.1, 0.3 };
+  /* Every strategy is the same */
+  const double flat[12] = { 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5,
+                            0.5, 0.5, 0.5 };
+  nash_game_t game = NASH_GAME_INIT;
+  nash_opts_t opts = NASH_OPTS_DEFAULT;
+  nash_eq_t   eq   = NASH_EQ_INIT;
+
+  for ( uint8_t i = 0; i < NMETHODS; i++ )
+    {
+      /* Fictitious Play closes its gap slowly, but iterations are cheap */
+      const bool   fp  = METHODS[i] == NASH_FICTITIOUS;
+      const double tol = fp ? 1e-2 : TEST_TOLERANCE;
+      opts.method    = METHODS[i];
+      opts.tolerance = tol;
+      opts.max_iters = fp ? 200000 : 10000;
+
+      expect( make_game( & game, 3, 3, rps ) );
+      expect( nash_solve( & game, & opts, & eq ) == STORE_SUCCESS );
+      expect( fabs( eq.value - 0.5 ) < tol );
+      expect( is_equilibrium( & game, & eq, tol ) );
+      for ( uint8_t s = 0; s < 3; s++ )
+        {
+          expect( fabs( eq.row[s] - 1.0 / 3 ) < 0.05 );
+        }
+      nash_eq_free( & eq );
+      nash_game_free( & game );
+
+      expect( make_game( & game, 2, 2, mix ) );
+      expect( nash_solve( & game, & opts, & eq ) == STORE_SUCCESS );
+      expect( fabs( eq.value - 0.2 ) < tol );
+      expect( fabs( eq.row[0] - 0.4 ) < 0.05 );
+      expect( fabs( eq.col[0] - 0.4 ) < 0.05 );
+      expect( is_equilibrium( & game, & eq, tol ) );
+      nash_eq_free( & eq );
+      nash_game_free( & game );
+
+      expect( make_game( & game, 3, 2, saddle ) );
+      expect( nash_solve( & game, & opts, & eq ) == STORE_SUCCESS );
+      expect( fabs( eq.value - 0.6 ) < tol );
+      expect( eq.row[1] > 0.95 );
+      expect( eq.col[0] > 0.95 );
+      expect( is_equilibrium( & game, & eq, tol ) );
+      nash_eq_free( & eq );
+      nash_game_free( & game );
+
+      expect( make_game( & game, 3, 4, flat ) );
+      expect( nash_solve( & game, & opts, & eq ) == STORE_SUCCESS );
+      expect( fabs( eq.value - 0.5 ) < 1e-9 );
+      expect( eq.gap < 1e-9 );
+      nash_eq_free( & eq );
+      nash_game_free( & game );
+    }
+
+  /* No iterations still runs one, and fills in the strategies */
+  expect( make_game( & game, 3, 3, rps ) );
+  for ( uint8_t i = 0; i < NMETHODS; i++ )
+    {
+      opts.method    = METHODS[i];
+      opts.max_iters = 0;
+      expect( nash_solve( & game, & opts, & eq ) == STORE_SUCCESS );
+      double row = 0.0;
+      double col = 0.0;
+      for ( uint8_t s = 0; s < 3; s++ )
+        {
+          expect( ( 0.0 <= eq.row[s] ) && ( 0.0 <= eq.col[s] ) );
+          row += eq.row[s];
+          col += eq.col[s];
+        }
+      expect( ( fabs( row - 1.0 ) < 1e-9 ) && ( fabs( col - 1.0 ) < 1e-9 ) );
+      expect( isfinite( eq.gap ) );
+      nash_eq_free( & eq );
+    }
+  nash_game_free( & game );
+
+  /* The LP is exact */
+  opts.method = NASH_LP;
+  expect( make_game( & game, 2, 2, mix ) );
+  expect( nash_solve( & game, & opts, & eq ) == STORE_SUCCESS );
+  expect( fabs( eq.row[0] - 0.4 ) < 1e-9 );
+  expect( fabs( eq.value - 0.2 ) < 1e-9 );
+  expect( eq.gap < 1e-9 );
+  nash_eq_free( & eq );
+  nash_game_free( & game );
+
+  return true;
+}
+
+
+  static bool
+test_nash_large( void )
+{
+  nash_game_t game  = NASH_GAME_INIT;
+  nash_opts_t opts  = NASH_OPTS_DEFAULT;
+  nash_eq_t   exact = NASH_EQ_INIT;
+  nash_eq_t   eq    = NASH_EQ_INIT;
+
+  /* The iterative solvers agree with the LP */
+  expect( make_random_game( & game, 40, 30 ) );
+  opts.method = NASH_LP;
+  expect( nash_solve( & game, & opts, & exact ) == STORE_SUCCESS );
+  expect( is_equilibrium( & game, & exact, 1e-9 ) );
+  expect( 0 < exact.iters );
+
+  opts.method    = NASH_REGRET;
+  opts.tolerance = TEST_TOLERANCE;
+  expect( nash_solve( & game, & opts, & eq ) == STORE_SUCCESS );
+  expect( eq.gap <= TEST_TOLERANCE );
+  expect( eq.iters < opts.max_iters );
+  expect( fabs( eq.value - exact.value ) < TEST_TOLERANCE );
+  nash_eq_free( & eq );
+
+  opts.method    = NASH_FICTITIOUS;
+  opts.max_iters = 200000;
+  opts.tolerance = 1e-2;
+  expect( nash_solve( & game, & opts, & eq ) == STORE_SUCCESS );
+  expect( eq.gap <= 1e-2 );
+  expect( fabs( eq.value - exact.value ) < 1e-2 );
+  nash_eq_free( & eq );
+  nash_eq_free( & exact );
+  nash_game_free( & game );
+
+  /* Hundreds of strategies a side go to Regret Matching+ */
+  expect( make_random_game( & game, 300, 250 ) );
+  opts = (nash_opts_t) NASH_OPTS_DEFAULT;
+  expect( nash_solve( & game, & opts, & eq ) == STORE_SUCCESS );
+  expect( eq.gap <= opts.tolerance );
+  expect( is_equilibrium( & game, & eq, opts.tolerance ) );
+  nash_eq_free( & eq );
+
+  /* Running out of iterations still gives an answer */
+  opts.method    = NASH_REGRET;
+  opts.max_iters = 3;
+  opts.tolerance = 0.0;
+  expect( nash_solve( & game, & opts, & eq ) == STORE_SUCCESS );
+  expect( ( eq.iters == 3 ) && ( 0.0 < eq.gap ) );
+  nash_eq_free( & eq );
+  nash_game_free( & game );
+
+  return true;
+}
+
+
+  static bool
+test_nash_matrix( void )
+{
+  matchup_matrix_t matrix = {
+    .nrows      = 3,
+    .ncols      = 2,
+    .nscenarios = 2,
+    .scenarios  = { matchup_scenario( 0, 0 ), matchup_scenario( 2, 2 ) },
+    .ratings    = (uint16_t[]) { 100, 200, 300, 400,
+                                 500, 600, 700, 800,
+                                 900, 1000, 0, 50
+                               }
+  };
+  nash_game_t game    = NASH_GAME_INIT;
+  nash_eq_t   eq      = NASH_EQ_INIT;
+  uint32_t    rows[2] = { 2, 0 };
+
+  expect( nash_game_from_matrix( & game, & matrix, matchup_scenario( 2, 2 ),
+                                 NULL, 0
+                               ) == STORE_SUCCESS
+        );
+  expect( ( game.nrows == 3 ) && ( game.ncols == 2 ) );
+  expect( nash_payoff( & game, 1, 0 ) == 0.7 );
+  expect( nash_payoff( & game, 2, 1 ) == 0.05 );
+  nash_game_free( & game );
+
+  expect( nash_game_from_matrix( & game, & matrix, matchup_scenario( 0, 0 ),
+                                 rows, 2
+                               ) == STORE_SUCCESS
+        );
+  expect( ( game.nrows == 2 ) && ( nash_payoff( & game, 0, 1 ) == 1.0 ) );
+  expect( nash_solve( & game, NULL, & eq ) == STORE_SUCCESS );
+  expect( eq.row[0] == 1.0 );
+  expect( nash_best_row( & game, eq.col, NULL ) == 0 );
+  nash_eq_free( & eq );
+  nash_game_free( & game );
+
+  /* Scenarios that weren't built, and empty games */
+  expect( nash_game_from_matrix( & game, & matrix, matchup_scenario( 1, 1 ),
+                                 NULL, 0
+                               ) == STORE_ERROR_BAD_VALUE
+        );
+  expect( nash_game_from_matrix( & game, & matrix, matchup_scenario( 0, 0 ),
+                                 rows, 0
+                               ) == STORE_ERROR_BAD_VALUE
+        );
+  expect( nash_solve( & game, NULL, & eq ) == STORE_ERROR_BAD_VALUE );
+  expect( eq.row == NULL );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* The first `n' species with moves, each with its first moveset */
+  static bool
+make_roster( roster_pokemon_t * rmons, base_pokemon_t * bases, uint32_t n )
+{
+  uint16_t dex = 1;
+  for ( uint32_t i = 0; i < n; dex++ )
+    {
+      if ( dex == 0 ) return false;
+      if ( base_mon_from_store( & CSTORE, dex, 0, 20.0, 15, 15, 15,
+                                bases + i
+                              ) != STORE_SUCCESS
+         )
+        {
+          continue;
+        }
+      const pdex_mon_t * pdex = bases[i].pdex_mon;
+      if ( ( pdex->fast_moves_cnt == 0 ) || ( pdex->charged_moves_cnt == 0 ) )
+        {
+          continue;
+        }
+      rmons[i] = (roster_pokemon_t) {
+        .base             = bases + i,
+        .fast_move_id     = abs( pdex->fast_move_ids[0] ),
+        .charged_move_ids = {
+          abs( pdex->charged_move_ids[0] ),
+          ( 1 < pdex->charged_moves_cnt ) ? abs( pdex->charged_move_ids[1] )
+                                          : 0
+        }
+      };
+      i++;
+    }
+  return true;
+}
+
+
+  static bool
+same_mon( const pvp_pokemon_t * a, const pvp_pokemon_t * b )
+{
+  return ( a->stats.attack == b->stats.attack ) &&
+         ( a->stats.stamina == b->stats.stamina ) &&
+         ( a->stats.defense == b->stats.defense ) &&
+         ( a->fast_move.move_id == b->fast_move.move_id ) &&
+         ( a->charged_moves[0].move_id == b->charged_moves[0].move_id ) &&
+         ( a->charged_moves[1].move_id == b->charged_moves[1].move_id );
+}
+
+
+  static bool
+test_nash_select_team( void )
+{
+  const uint32_t     nours   = 6;
+  const uint32_t     ntheirs = 5;
+  roster_pokemon_t   rmons[11];
+  base_pokemon_t     bases[11];
+  pvp_pokemon_t      mons[11];
+  pvp_pokemon_t      team[3];
+  pvp_pokemon_t      built[3];
+  roster_t           ours    = {
+    .roster_pokemon = rmons, .roster_length = nours
+  };
+  roster_t           theirs  = {
+    .roster_pokemon = rmons + nours, .roster_length = ntheirs
+  };
+  nash_select_opts_t opts    = NASH_SELECT_OPTS_DEFAULT;
+  uint32_t           leads[3] = { 0, 0, 0 };
+  double             support[3];
+
+  expect( make_roster( rmons, bases, nours + ntheirs ) );
+  expect( pvp_pokemon_init_many( mons, rmons, nours + ntheirs, & CSTORE )
+          == STORE_SUCCESS
+        );
+
+  /* The same members as the team builder, the lead in front */
+  opts.team.nthreads = 2;
+  expect( team_builder_select_team( & ours, & theirs, built, & CSTORE,
+                                    & opts.team
+                                  ) == AI_SUCCESS
+        );
+  expect( nash_select_team( & ours, & theirs, team, & CSTORE, & opts ) ==
+          AI_SUCCESS
+        );
+  for ( uint8_t t = 0; t < 3; t++ )
+    {
+      uint8_t found = 0;
+      for ( uint8_t b = 0; b < 3; b++ )
+        {
+          found += same_mon( team + t, built + b );
+        }
+      expect( found == 1 );
+    }
+  expect( opts.seed == 0 );
+
+  /* The lead is the likeliest of the lead game */
+  const matchup_opts_t mopts = {
+    .scenarios = matchup_scenario_mask( opts.team.lead_scenario ),
+    .nthreads  = 1,
+    .cache     = NULL
+  };
+  matchup_matrix_t matrix = MATCHUP_MATRIX_INIT;
+  nash_game_t      game   = NASH_GAME_INIT;
+  nash_eq_t        eq     = NASH_EQ_INIT;
+  expect( matchup_matrix_build( & matrix, built, 3, mons + nours, ntheirs,
+                                & mopts
+                              ) == STORE_SUCCESS
+        );
+  expect( nash_game_from_matrix( & game, & matrix, opts.team.lead_scenario,
+                                 NULL, 0
+                               ) == STORE_SUCCESS
+        );
+  expect( nash_solve( & game, NULL, & eq ) == STORE_SUCCESS );
+  uint32_t likeliest = 0;
+  for ( uint32_t r = 1; r < 3; r++ )
+    {
+      if ( eq.row[likeliest] < eq.row[r] ) likeliest = r;
+    }
+  expect( same_mon( team, built + likeliest ) );
+  memcpy( support, eq.row, sizeof( support ) );
+  nash_eq_free( & eq );
+  nash_game_free( & game );
+  matchup_matrix_free( & matrix );
+
+  /* Drawn leads advance the seed, and only lead with support */
+  opts.sample = true;
+  opts.seed   = 7;
+  for ( uint32_t i = 0; i < 20; i++ )
+    {
+      expect( nash_select_team( & ours, & theirs, team, & CSTORE, & opts ) ==
+              AI_SUCCESS
+            );
+      for ( uint8_t b = 0; b < 3; b++ ) leads[b] += same_mon( team, built + b );
+    }
+  expect( opts.seed != 7 );
+  expect( leads[0] + leads[1] + leads[2] == 20 );
+  for ( uint8_t b = 0; b < 3; b++ ) expect( ( leads[b] == 0 ) || support[b] );
+
+  /* Without an opponent the first 3 are taken */
+  theirs.roster_length = 0;
+  expect( nash_select_team( & ours, & theirs, team, & CSTORE, NULL ) ==
+          AI_SUCCESS
+        );
+  for ( uint8_t t = 0; t < 3; t++ ) expect( same_mon( team + t, mons + t ) );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_nash( void )
+{
+  bool rsl = true;
+
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= do_test( nash_small );
+  rsl &= do_test( nash_large );
+  rsl &= do_test( nash_matrix );
+  rsl &= do_test( nash_select_team );
+  CS_free();
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_nash() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,222 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "moves.h"
+#include "overlay_store.h"
+#include "pokedex.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+static store_t OVERLAY = def_overlay_store();
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_overlay_store_edit_move( void )
+{
+  store_move_t * base_move = NULL;
+  store_move_t * move      = NULL;
+
+  expect( CS_get_move( 13, & base_move ) == STORE_SUCCESS );
+  uint8_t energy = base_move->pvp_energy;
+
+  expect( overlay_store_edit_move( & OVERLAY, 13, & move ) == STORE_SUCCESS );
+  expect( move != base_move );
+  move->pvp_energy++;
+
+  /* The base is untouched, and lookups in the overlay see the change */
+  expect( base_move->pvp_energy == energy );
+  expect( overlay_store_get( & OVERLAY,
+                             move_id_store_key( 13 ),
+                             (void **) & move
+                           ) == STORE_SUCCESS
+        );
+  expect( move->pvp_energy == energy + 1 );
+  expect( overlay_store_get_str_t( & OVERLAY,
+                                   STORE_MOVE,
+                                   "WRAP",
+                                   (void **) & move
+                                 ) == STORE_SUCCESS
+        );
+  expect( move->pvp_energy == energy + 1 );
+  expect( strcmp( move->name, "WRAP" ) == 0 );
+
+  /* Editing again returns the same copy */
+  store_move_t * again = NULL;
+  expect( overlay_store_edit_move( & OVERLAY, 13, & again ) == STORE_SUCCESS );
+  expect( again == move );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_overlay_store_fall_through( void )
+{
+  pdex_mon_t   * base_mon  = NULL;
+  pdex_mon_t   * mon       = NULL;
+  store_move_t * base_move = NULL;
+  store_move_t * move      = NULL;
+
+  expect( CS_get_pokemon( 1, 0, & base_mon ) == STORE_SUCCESS );
+  expect( overlay_store_get( & OVERLAY,
+                             dex_form_store_key( 1, 0 ),
+                             (void **) & mon
+                           ) == STORE_SUCCESS
+        );
+  expect( mon == base_mon );
+
+  expect( CS_get_move( 14, & base_move ) == STORE_SUCCESS );
+  expect( overlay_store_get_str( & OVERLAY,
+                                 base_move->name,
+                                 (void **) & move
+                               ) == STORE_SUCCESS
+        );
+  expect( move == base_move );
+
+  expect( overlay_store_get( & OVERLAY,
+                             dex_form_store_key( 1, 200 ),
+                             (void **) & mon
+                           ) == STORE_ERROR_NOT_FOUND
+        );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_overlay_store_add_set( void )
+{
+  store_move_t   move = NO_MOVE_STORE;
+  store_move_t * got  = NULL;
+  pdex_mon_t   * mon  = NULL;
+
+  /* `add' is only for new keys, and `set' only for existing ones */
+  move.name    = "TEST_MOVE";
+  move.move_id = 0xfff0;
+  expect( overlay_store_set( & OVERLAY, move_store_key( & move ), & move ) ==
+          STORE_ERROR_NOT_FOUND
+        );
+  expect( overlay_store_add( & OVERLAY, move_store_key( & move ), & move ) ==
+          STORE_SUCCESS
+        );
+  expect( overlay_store_add( & OVERLAY, move_store_key( & move ), & move ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  move.pvp_power = 42;
+  expect( overlay_store_set( & OVERLAY, move_store_key( & move ), & move ) ==
+          STORE_SUCCESS
+        );
+  expect( overlay_store_get( & OVERLAY,
+                             move_store_key( & move ),
+                             (void **) & got
+                           ) == STORE_SUCCESS
+        );
+  expect( got->pvp_power == 42 );
+
+  /* Replace a Pokemon's stats */
+  expect( overlay_store_edit_pokemon( & OVERLAY, 1, 0, & mon ) ==
+          STORE_SUCCESS
+        );
+  uint16_t attack = mon->base_stats.attack;
+  mon->base_stats.attack += 10;
+  expect( overlay_store_get_str_t( & OVERLAY,
+                                   STORE_POKEDEX,
+                                   "BULBASAUR",
+                                   (void **) & mon
+                                 ) == STORE_SUCCESS
+        );
+  expect( mon->base_stats.attack == attack + 10 );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Two overlays over the same base don't see each other's changes. */
+  static bool
+test_overlay_store_independent( void )
+{
+  store_t        other = def_overlay_store();
+  store_move_t * a     = NULL;
+  store_move_t * b     = NULL;
+
+  expect( overlay_store_init( & other, & CSTORE ) == STORE_SUCCESS );
+  expect( overlay_store_get( & OVERLAY,
+                             move_id_store_key( 13 ),
+                             (void **) & a
+                           ) == STORE_SUCCESS
+        );
+  expect( overlay_store_get( & other,
+                             move_id_store_key( 13 ),
+                             (void **) & b
+                           ) == STORE_SUCCESS
+        );
+  expect( a->pvp_energy == b->pvp_energy + 1 );
+  overlay_store_free( & other );
+
+  /* After a reset we're back to the base data */
+  overlay_store_reset( & OVERLAY );
+  expect( overlay_store_get( & OVERLAY,
+                             move_id_store_key( 13 ),
+                             (void **) & a
+                           ) == STORE_SUCCESS
+        );
+  expect( a->pvp_energy == b->pvp_energy );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_overlay_store( void )
+{
+  bool rsl = true;
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= overlay_store_init( & OVERLAY, & CSTORE ) == STORE_SUCCESS;
+  rsl &= do_test( overlay_store_edit_move );
+  rsl &= do_test( overlay_store_fall_through );
+  rsl &= do_test( overlay_store_add_set );
+  rsl &= do_test( overlay_store_independent );
+  overlay_store_free( & OVERLAY );
+  CS_free();
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_overlay_store() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
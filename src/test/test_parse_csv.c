@@ -0,0 +1,313 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "parse_csv.h"
+#include "pokedex.h"
+#include "pokemon.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+#define CSV_TEST_FILE    "data/test/pokebattler.csv"
+#define CALCY_TEST_FILE  "data/test/calcy.csv"
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_parse_pokebattler_name( void )
+{
+  const pdex_mon_t * mon = NULL;
+
+#define expect_name( STR, DEX, FORM )                                         \
+  expect( parse_pokebattler_name( ( STR ), strlen( STR ), & CSTORE, & mon )   \
+          == STORE_SUCCESS                                                    \
+        );                                                                    \
+  expect( mon->dex_number == ( DEX ) );                                       \
+  expect( strcmp( mon->form_name, ( FORM ) ) == 0 )
+
+  expect_name( "BULBASAUR", 1, "BASE" );
+  expect_name( "VENUSAUR_SHADOW_FORM", 3, "BASE" );
+  expect_name( "VENUSAUR_PURIFIED_FORM", 3, "BASE" );
+  expect_name( "STUNFISK_GALARIAN_FORM", 618, "GALARIAN" );
+  expect_name( "MEOWTH_ALOLA_FORM", 52, "ALOLA" );
+  expect_name( "HO_OH", 250, "BASE" );
+  expect_name( "NIDORAN_FEMALE", 29, "BASE" );
+  expect_name( "MR_MIME", 122, "BASE" );
+
+#undef expect_name
+
+  expect( parse_pokebattler_name( "NOTAMON", 7, & CSTORE, & mon ) ==
+          STORE_ERROR_NOT_FOUND
+        );
+  expect( mon == NULL );
+  expect( parse_pokebattler_name( "MEOWTH_PLAID_FORM", 17, & CSTORE, & mon ) ==
+          STORE_ERROR_NOT_FOUND
+        );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_parse_csv_roster( void )
+{
+  roster_t           roster = { .roster_pokemon = NULL, .roster_length = 0 };
+  roster_pokemon_t * rmon   = NULL;
+  store_move_t     * move   = NULL;
+
+  expect( parse_csv_roster( CSV_TEST_FILE, & CSTORE, & roster ) ==
+          STORE_SUCCESS
+        );
+  expect( roster.roster_length == 5 );
+  expect( roster.roster_bases != NULL );
+
+  /* Galarian Stunfisk */
+  rmon = roster.roster_pokemon;
+  expect( rmon->base == roster.roster_bases );
+  expect( rmon->base->pdex_mon->dex_number == 618 );
+  expect( rmon->base->level == 20.0 );
+  expect( rmon->base->ivs.attack == 15 );
+  expect( CS_get_move( rmon->fast_move_id, & move ) == STORE_SUCCESS );
+  expect( strcmp( move->name, "MUD_SHOT" ) == 0 );
+  expect( CS_get_move( rmon->charged_move_ids[1], & move ) == STORE_SUCCESS );
+  expect( strcmp( move->name, "ROCK_SLIDE" ) == 0 );
+
+  /* Shadow Venusaur, with a comma in its nickname */
+  rmon = roster.roster_pokemon + 1;
+  expect( rmon->base->pdex_mon->dex_number == 3 );
+  expect( rmon->base->level == 25.5 );
+  expect( rmon->base->ivs.attack == 1 );
+  expect( rmon->base->ivs.defense == 14 );
+  expect( rmon->base->ivs.stamina == 7 );
+
+  /* Ho-Oh, without a second charged move */
+  rmon = roster.roster_pokemon + 2;
+  expect( rmon->base->pdex_mon->dex_number == 250 );
+  expect( rmon->charged_move_ids[1] == 0 );
+
+  /* CRLF line ending */
+  rmon = roster.roster_pokemon + 3;
+  expect( rmon->base->pdex_mon->dex_number == 29 );
+  expect( rmon->charged_move_ids[1] == 0 );
+
+  /* After a blank line */
+  rmon = roster.roster_pokemon + 4;
+  expect( rmon->base->pdex_mon->dex_number == 52 );
+  expect( rmon->base->level == 18.5 );
+
+  /* A roster only owns one block of bases */
+  expect( parse_csv_roster( CSV_TEST_FILE, & CSTORE, & roster ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+
+  roster_free( & roster );
+  expect( roster.roster_pokemon == NULL );
+  expect( roster.roster_length == 0 );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_parse_csv_bad_line( void )
+{
+  roster_t     roster = { .roster_pokemon = NULL, .roster_length = 0 };
+  const char * bad[]  = {
+    "1,,BULBASAUR,,10,20,15,15,15,VINE_WHIP_FAST,NOTAMOVE,false,false,",
+    "1,,BULBASAUR,,10,20,16,15,15,VINE_WHIP_FAST,SLUDGE_BOMB,false,false,",
+    "1,,BULBASAUR,,10,20.3,15,15,15,VINE_WHIP_FAST,SLUDGE_BOMB,false,false,",
+    "1,,BULBASAUR,,10,99,15,15,15,VINE_WHIP_FAST,SLUDGE_BOMB,false,false,",
+    "1,,BULBASAUR,,10,20,15,15,15,VINE_WHIP_FAST",
+    "1,,BULBASAUR,,10,20,15,15,15,,SLUDGE_BOMB,false,false,"
+  };
+
+  for ( size_t i = 0; i < sizeof( bad ) / sizeof( bad[0] ); i++ )
+    {
+      expect( parse_csv_roster_buffer( bad[i],
+                                       strlen( bad[i] ),
+                                       & CSTORE,
+                                       & roster
+                                     ) != STORE_SUCCESS
+            );
+      expect( roster.roster_length == 0 );
+      expect( roster.roster_bases == NULL );
+    }
+
+  roster_free( & roster );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* A large collection, to exercise growth and counting. */
+  static bool
+test_parse_csv_large( void )
+{
+  const char line[] =
+    "5616504,,STUNFISK_GALARIAN_FORM,,1235,20,15,15,15,MUD_SHOT_FAST,"
+    "EARTHQUAKE,false,false,ROCK_SLIDE\n";
+  const size_t nmons = 50000;
+  const size_t len   = ( sizeof( line ) - 1 ) * nmons;
+  char       * buf   = (char *) malloc( len );
+  roster_t     roster = { .roster_pokemon = NULL, .roster_length = 0 };
+
+  expect( buf != NULL );
+  for ( size_t i = 0; i < nmons; i++ )
+    {
+      memcpy( buf + i * ( sizeof( line ) - 1 ), line, sizeof( line ) - 1 );
+    }
+
+  expect( parse_csv_roster_buffer( buf, len, & CSTORE, & roster ) ==
+          STORE_SUCCESS
+        );
+  free( buf );
+  expect( roster.roster_length == nmons );
+  expect( nmons <= roster.roster_capacity );
+  for ( size_t i = 0; i < nmons; i++ )
+    {
+      expect( roster.roster_pokemon[i].base == roster.roster_bases + i );
+      expect( roster.roster_bases[i].pdex_mon->dex_number == 618 );
+    }
+  roster_free( & roster );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_parse_calcy_roster( void )
+{
+  roster_t           roster = { .roster_pokemon = NULL, .roster_length = 0 };
+  roster_pokemon_t * rmon   = NULL;
+  store_move_t     * move   = NULL;
+
+  expect( parse_calcy_roster( CALCY_TEST_FILE, & CSTORE, & roster ) ==
+          STORE_SUCCESS
+        );
+  expect( roster.roster_length == 4 );
+
+  /* Galarian Stunfisk, by Dex # and form */
+  rmon = roster.roster_pokemon;
+  expect( rmon->base->pdex_mon->dex_number == 618 );
+  expect( strcmp( rmon->base->pdex_mon->form_name, "GALARIAN" ) == 0 );
+  expect( rmon->base->level == 20.0 );
+  expect( CS_get_move( rmon->fast_move_id, & move ) == STORE_SUCCESS );
+  expect( strcmp( move->name, "MUD_SHOT" ) == 0 );
+
+  /* Quoted nickname, no second charged move */
+  rmon = roster.roster_pokemon + 1;
+  expect( rmon->base->pdex_mon->dex_number == 3 );
+  expect( rmon->base->ivs.defense == 14 );
+  expect( rmon->charged_move_ids[1] == 0 );
+
+  /* "Alolan" form, a range of IVs, and a misread move */
+  rmon = roster.roster_pokemon + 2;
+  expect( strcmp( rmon->base->pdex_mon->form_name, "ALOLA" ) == 0 );
+  expect( rmon->base->ivs.attack == 5 );
+  expect( CS_get_move( rmon->charged_move_ids[1], & move ) == STORE_SUCCESS );
+  expect( strcmp( move->name, "DARK_PULSE" ) == 0 );
+
+  /* No Dex #, found by name */
+  rmon = roster.roster_pokemon + 3;
+  expect( rmon->base->pdex_mon->dex_number == 250 );
+
+  roster_free( & roster );
+
+  return true;
+}
+
+
+  static bool
+test_parse_calcy_buffer( void )
+{
+  roster_t     roster = { .roster_pokemon = NULL, .roster_length = 0 };
+  const char   semi[] =
+    "Nr;Name;Level;\xc3\x98" "ATT IV;\xc3\x98" "DEF IV;\xc3\x98" "HP IV;"
+    "Fast move;Special move\n"
+    "1;Bulbasaur;20,5;0;15;15;Vine Whip;Sludge Bomb\n";
+  const char   no_header[] = "1,Bulbasaur,20,0,15,15,Vine Whip,Sludge Bomb\n";
+  const char   bad_iv[] =
+    "Nr,Level,ATK IV,DEF IV,STA IV,Fast move,Special move\n"
+    "1,20,16,15,15,Vine Whip,Sludge Bomb\n";
+
+  expect( parse_calcy_roster_buffer( semi, strlen( semi ), & CSTORE, & roster )
+          == STORE_SUCCESS
+        );
+  expect( roster.roster_length == 1 );
+  expect( roster.roster_pokemon->base->level == 20.5 );
+  expect( roster.roster_pokemon->base->ivs.defense == 15 );
+  roster_free( & roster );
+
+  expect( parse_calcy_roster_buffer( no_header,
+                                     strlen( no_header ),
+                                     & CSTORE,
+                                     & roster
+                                   ) != STORE_SUCCESS
+        );
+  expect( parse_calcy_roster_buffer( bad_iv,
+                                     strlen( bad_iv ),
+                                     & CSTORE,
+                                     & roster
+                                   ) != STORE_SUCCESS
+        );
+  expect( roster.roster_length == 0 );
+  roster_free( & roster );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_parse_csv( void )
+{
+  bool rsl = true;
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= do_test( parse_pokebattler_name );
+  rsl &= do_test( parse_csv_roster );
+  rsl &= do_test( parse_csv_bad_line );
+  rsl &= do_test( parse_csv_large );
+  rsl &= do_test( parse_calcy_roster );
+  rsl &= do_test( parse_calcy_buffer );
+  CS_free();
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_parse_csv() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -4,11 +4,14 @@
 
 #include "ext/jsmn.h"
 #include "ext/jsmn_iterator.h"
-#include "ext/uthash.h"
+#include "gm_store.h"
 #include "parse_gm.h"
 #include "ptypes.h"
 #include "util/json_util.h"
+#include "util/arena.h"
 #include "util/macros.h"
+#include "util/strmap.h"
+#include "util/strpool.h"
 #include "util/test_util.h"
 #include <pcre.h>
 #include <stdbool.h>
@@ -23,6 +26,8 @@
 #include "../data/test/parse_gm_1.h"
 #include "../data/test/parse_gm_2.h"
 
+#define GM_TEST_FILE  "data/test/gm_mini.json"
+
 
 /* -------------------------------------------------------------------------- */
 
@@ -356,9 +361,7 @@ test_lookup_move_id( void )
       .atk_buff = { .target = 1, .debuffp = 1, .amount = 1 },
       .def_buff = { 0, 0, 0 },
       .chance   = bc_0300
-    },
-    .hh_name    = 0,
-    .hh_move_id = 0
+    }
   };
 
   store_move_t charm = {
@@ -371,42 +374,165 @@ test_lookup_move_id( void )
     .pve_energy = 0,
     .pvp_power  = 16,
     .pvp_energy = 6,
-    .buff       = NO_BUFF,
-    .hh_name    = 0,
-    .hh_move_id = 0
+    .buff       = NO_BUFF
   };
 
-  store_move_t * moves_by_name = NULL;
-  HASH_ADD_KEYPTR( hh_name,
-                   moves_by_name,
-                   mirror_shot.name,
-                   strlen( mirror_shot.name ),
-                   & mirror_shot
-                 );
-  HASH_ADD_KEYPTR( hh_name,
-                   moves_by_name,
-                   charm.name,
-                   strlen( charm.name ),
-                   & charm
-                 );
-
-  expect( lookup_move_id( moves_by_name, mirror_shot.name )
+  strmap_t moves_by_name = STRMAP_INIT;
+  expect( strmap_put( & moves_by_name, mirror_shot.name, & mirror_shot ) == 0 );
+  expect( strmap_put( & moves_by_name, charm.name, & charm ) == 0 );
+  expect( strmap_put( & moves_by_name, "CHARM", & mirror_shot ) == 1 );
+
+  expect( lookup_move_id( & moves_by_name, mirror_shot.name )
           == mirror_shot.move_id
         );
 
-  /* Confirm that HASH_FIND checked the actual string, not the address */
+  /* Confirm that the map checked the actual string, not the address */
   char * mirror_shot_str = strdup( "MIRROR_SHOT" );
-  expect( lookup_move_id( moves_by_name, mirror_shot_str )
+  expect( lookup_move_id( & moves_by_name, mirror_shot_str )
           == mirror_shot.move_id
           );
   free( mirror_shot_str );
   mirror_shot_str = NULL;
 
-  expect( lookup_move_id( moves_by_name, charm.name )
+  expect( lookup_move_id( & moves_by_name, charm.name )
           == charm.move_id
         );
+  /* Lookups by length don't need a terminated key */
+  expect( lookup_move_idn( & moves_by_name, "CHARMING", 5 ) == charm.move_id );
   /* Cleanup */
-  HASH_CLEAR( hh_name, moves_by_name );
+  strmap_free( & moves_by_name );
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_strpool( void )
+{
+  strpool_t pool = STRPOOL_INIT;
+
+  char * base = strpool_intern( & pool, "BASE" );
+  expect( base != NULL );
+  expect( strcmp( base, "BASE" ) == 0 );
+  expect( strpool_internn( & pool, "BASEMENT", 4 ) == base );
+  expect( strpool_findn( & pool, "BASE", 4 ) == base );
+  expect( strpool_findn( & pool, "ALOLA", 5 ) == NULL );
+  expect( pool.bytes == 5 );
+
+  /* Oversized strings don't disturb the current block */
+  char * big = (char *) malloc( STRPOOL_BLOCK_SIZE * 2 );
+  memset( big, 'A', STRPOOL_BLOCK_SIZE * 2 );
+  char * pooled_big = strpool_internn( & pool, big, STRPOOL_BLOCK_SIZE * 2 );
+  free( big );
+  expect( pooled_big != NULL );
+  expect( pooled_big[STRPOOL_BLOCK_SIZE * 2] == '\0' );
+  char * alola = strpool_intern( & pool, "ALOLA" );
+  expect( alola == base + 5 );
+
+  strpool_free( & pool );
+  expect( pool.blocks == NULL );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_arena( void )
+{
+  arena_t arena = ARENA_INIT;
+
+  char * a = (char *) arena_alloc( & arena, 3 );
+  char * b = (char *) arena_calloc( & arena, 40 );
+  expect( ( a != NULL ) && ( b != NULL ) );
+  expect( ( (uintptr_t) b % _Alignof( max_align_t ) ) == 0 );
+  expect( ( b[0] == 0 ) && ( b[39] == 0 ) );
+
+  /* Only the newest allocation can be given back */
+  expect( ! arena_pop( & arena, a ) );
+  expect( arena_pop( & arena, b ) );
+  expect( ! arena_pop( & arena, b ) );
+#ifndef ARENA_USE_MALLOC
+  expect( arena_alloc( & arena, 40 ) == b );
+  expect( arena.blocks->next == NULL );
+#endif
+
+  /* Oversized allocations still work */
+  char * big = (char *) arena_alloc( & arena, ARENA_BLOCK_SIZE * 2 );
+  expect( big != NULL );
+  memset( big, 'A', ARENA_BLOCK_SIZE * 2 );
+
+  arena_free( & arena );
+  expect( ( arena.blocks == NULL ) && ( arena.bytes == 0 ) );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_gm_tables( void )
+{
+  gm_parser_t gm_parser;
+  store_t     gm_store = def_gm_store();
+  memset( & gm_parser, 0, sizeof( gm_parser_t ) );
+  expect( 0 < gm_parser_init( & gm_parser, GM_TEST_FILE ) );
+  expect( gm_store_init( & gm_store, & gm_parser ) == STORE_SUCCESS );
+  gm_parser_free( & gm_parser );
+
+  const gm_tables_t * tables = & as_gmsa( & gm_store )->tables;
+  expect( tables->mons_cnt == 3 );
+  expect( tables->moves_cnt == 7 );
+
+  pdex_mon_t * bulbasaur = NULL;
+  pdex_mon_t * ivysaur   = NULL;
+  pdex_mon_t * alola     = NULL;
+  expect( gm_store_get_pokemon( & gm_store, 1, 0, & bulbasaur ) ==
+          STORE_SUCCESS
+        );
+  expect( gm_store_get_pokemon_by_name( & gm_store, "IVYSAUR", & ivysaur ) ==
+          STORE_SUCCESS
+        );
+  expect( gm_store_get_pokemon( & gm_store, 3, 0, & alola ) ==
+          STORE_ERROR_NOT_FOUND
+        );
+  expect( gm_store_get_pokemon( & gm_store, 4, 1, & alola ) == STORE_SUCCESS );
+
+  /* Duplicate `NORMAL' and `SHADOW' forms are folded into the base */
+  expect( bulbasaur->next_form == NULL );
+  expect( strcmp( alola->form_name, "ALOLA" ) == 0 );
+
+  /* Form names are shared, and move lists are packed end to end */
+  expect( bulbasaur->form_name == ivysaur->form_name );
+  expect( bulbasaur->fast_moves_cnt == 2 );
+  expect( bulbasaur->charged_moves_cnt == 3 );
+  expect( bulbasaur->charged_move_ids ==
+          bulbasaur->fast_move_ids + bulbasaur->fast_moves_cnt
+        );
+  expect( bulbasaur->charged_move_ids[2] == 118 );
+
+  /* Legacy moves are negated */
+  pdex_mon_t * charmander = NULL;
+  expect( gm_store_get_pokemon( & gm_store, 4, 0, & charmander ) ==
+          STORE_SUCCESS
+        );
+  expect( charmander->next_form == alola );
+  expect( charmander->fast_moves_cnt == 2 );
+  expect( charmander->fast_move_ids[1] == -221 );
+
+  store_move_t * move = NULL;
+  expect( gm_store_get_move_by_name( & gm_store, "POWER_WHIP", & move ) ==
+          STORE_SUCCESS
+        );
+  expect( ( move->move_id == 118 ) && ( move->pvp_power == 90 ) );
+  expect( gm_store_get_move( & gm_store, 118, & move ) == STORE_SUCCESS );
+  expect( strcmp( move->name, "POWER_WHIP" ) == 0 );
+
+  gm_store_free( & gm_store );
+
   return true;
 }
 
@@ -425,6 +551,9 @@ test_parse_gm( void )
   rsl &= do_test( parse_pvp_charged_move );
   rsl &= do_test( parse_pvp_fast_move );
   rsl &= do_test( lookup_move_id );
+  rsl &= do_test( strpool );
+  rsl &= do_test( arena );
+  rsl &= do_test( gm_tables );
   return rsl;
 }
 
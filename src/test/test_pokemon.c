@@ -161,15 +161,15 @@ test_roster_append( void )
     }
   };
 
-  roster_append( & roster, & bulbasaur );
+  expect( roster_append( & roster, & bulbasaur ) == & roster );
   expect( roster.roster_pokemon != NULL );
   expect( roster.roster_length == 1 );
 
-  roster_append( & roster, & charmander );
+  expect( roster_append( & roster, & charmander ) == & roster );
   expect( roster.roster_pokemon != NULL );
   expect( roster.roster_length == 2 );
 
-  roster_append( & roster, & squirtle );
+  expect( roster_append( & roster, & squirtle ) == & roster );
   expect( roster.roster_pokemon != NULL );
   expect( roster.roster_length == 3 );
 
@@ -179,6 +179,71 @@ test_roster_append( void )
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+/* Enough Pokemon to span a few batches. */
+  static bool
+test_pvp_pokemon_init_many( void )
+{
+  store_t            cstore            = CSTORE;
+  base_pokemon_t     USER1_BASE_MONS[] = def_user1_base_mons();
+  const size_t       n                 = 3 * PVP_INIT_BATCH_SIZE + 7;
+  roster_pokemon_t * rmons = calloc( n, sizeof( roster_pokemon_t ) );
+  pvp_pokemon_t    * mons  = calloc( n, sizeof( pvp_pokemon_t ) );
+  expect( rmons != NULL );
+  expect( mons != NULL );
+
+  for ( size_t i = 0; i < n; i++ )
+    {
+      base_pokemon_t * base = USER1_BASE_MONS + ( i % 3 );
+      rmons[i].base                = base;
+      rmons[i].fast_move_id        = base->pdex_mon->fast_move_ids[0];
+      rmons[i].charged_move_ids[0] = base->pdex_mon->charged_move_ids[0];
+      /* Leave the second charged move empty for some */
+      rmons[i].charged_move_ids[1] =
+        ( ( i % 5 ) == 0 ) ? 0 : base->pdex_mon->charged_move_ids[1];
+    }
+
+  expect( pvp_pokemon_init_many( mons, rmons, n, & cstore ) == STORE_SUCCESS );
+
+  for ( size_t i = 0; i < n; i++ )
+    {
+      pvp_pokemon_t mon = PVP_MON_NULL;
+      pvp_pokemon_init( & mon, rmons + i, & cstore );
+      /* Bit-fields leave padding in moves, so compare fields */
+      expect( mon.level == mons[i].level );
+      expect( mon.stats.attack == mons[i].stats.attack );
+      expect( mon.stats.stamina == mons[i].stats.stamina );
+      expect( mon.stats.defense == mons[i].stats.defense );
+      expect( mon.types == mons[i].types );
+      expect( mon.hp == mons[i].hp );
+      for ( pmove_idx_t m = M_CHARGED1; m <= M_FAST; m++ )
+        {
+          expect( get_pvp_mon_move_id( mon, m ) ==
+                  get_pvp_mon_move_id( mons[i], m )
+                );
+          expect( get_pvp_mon_move_power( mon, m ) ==
+                  get_pvp_mon_move_power( mons[i], m )
+                );
+          expect( get_pvp_mon_move_energy( mon, m ) ==
+                  get_pvp_mon_move_energy( mons[i], m )
+                );
+        }
+    }
+
+  /* An unknown move should be reported rather than asserted */
+  rmons[n - 1].fast_move_id = 0xfff0;
+  expect( pvp_pokemon_init_many( mons, rmons, n, & cstore ) ==
+          STORE_ERROR_NOT_FOUND
+        );
+
+  free( rmons );
+  free( mons );
+
+  return true;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   static bool
@@ -236,6 +301,29 @@ test_get_cp_from_stats( void )
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_get_max_level_for_cp( void )
+{
+  const stats_t ven_base = { .attack = 198, .stamina = 190, .defense = 189 };
+  const stats_t ven_ivs  = { .attack = 0, .stamina = 8, .defense = 0 };
+  float         lv       = get_max_level_for_cp( ven_base, ven_ivs, 1500 );
+
+  /* Half levels count */
+  expect( lv == 21.5 );
+  expect( get_cp_from_stats( ven_base, ven_ivs, lv ) <= 1500 );
+  expect( 1500 < get_cp_from_stats( ven_base, ven_ivs, lv + 0.5 ) );
+
+  expect( get_max_level_for_cp( ven_base, ven_ivs, UINT16_MAX ) ==
+          MAX_LEVEL
+        );
+  expect( get_max_level_for_cp( ven_base, ven_ivs, 5 ) == 0.0 );
+
+  return true;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
   static bool
@@ -330,8 +418,10 @@ test_pokemon( void )
   rsl &= do_test( cstore_roster );
   rsl &= do_test( cstore_base_mon_from_store );
   rsl &= do_test( roster_append );
+  rsl &= do_test( pvp_pokemon_init_many );
   rsl &= do_test( get_pvp_mon_move );
   rsl &= do_test( get_cp_from_stats );
+  rsl &= do_test( get_max_level_for_cp );
   rsl &= do_test( get_effective_stats );
   rsl &= do_test( get_pvp_damage );
   rsl &= do_test( brute_maximize_ivs );
@@ -0,0 +1,395 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "cupstore.h"
+#include "matchup.h"
+#include "matchup_file.h"
+#include "pokedex.h"
+#include "pokemon.h"
+#include "ranking.h"
+#include "rankstore.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+static store_t CUPS = def_cupstore();
+
+/* The Kanto starters and their evolutions */
+#define TEST_CUP_QUERY  "dex:1-9"
+#define TEST_CP_CAP     1500
+
+
+  static bool
+close_to( float a, float b )
+{
+  return fabsf( a - b ) < 0.01;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_ranking_build( void )
+{
+  cup_t          * cup     = NULL;
+  ranking_t        ranking = RANKING_INIT;
+  ranking_t        threads = RANKING_INIT;
+  ranking_opts_t   opts    = RANKING_OPTS_DEFAULT;
+
+  expect( cupstore_get_str( & CUPS, "TEST_CUP", (void **) & cup ) ==
+          STORE_SUCCESS
+        );
+
+  opts.nthreads = 1;
+  expect( ranking_build( & ranking, cup, & opts ) == STORE_SUCCESS );
+  expect( 0 < ranking.nspecies );
+  expect( ranking.nspecies <= cup->pool_size );
+  expect( ranking.nspecies < ranking.nentries );
+  expect( ranking.matrix.nrows == ranking.nentries );
+  expect( ranking.matrix.ncols == ranking.nspecies );
+  expect( ranking.matrix.nscenarios == 3 );
+  expect( ranking.converged );
+
+  for ( uint32_t s = 0; s < ranking.nspecies; s++ )
+    {
+      const ranking_species_t * species = ranking.species + s;
+      const ranking_entry_t   * best    = ranking.entries + species->best;
+      pdex_mon_t              * pdex    = NULL;
+
+      /* Raised as high as the cap allows */
+      expect( CSTORE.get( & CSTORE,
+                          dex_form_store_key( best->dex_number,
+                                              best->form_idx
+                                            ),
+                          (void **) & pdex
+                        ) == STORE_SUCCESS
+            );
+      expect( get_cp_from_stats( pdex->base_stats, ranking.ivs, best->level )
+              <= TEST_CP_CAP
+            );
+      expect( ( best->level == MAX_LEVEL ) ||
+              ( TEST_CP_CAP < get_cp_from_stats( pdex->base_stats,
+                                                 ranking.ivs,
+                                                 best->level + 1
+                                               ) )
+            );
+
+      /* Best of its movesets, and the one it was ranked against */
+      for ( uint32_t e = species->first;
+            e < species->first + species->nentries;
+            e++ )
+        {
+          expect( ranking.entries[e].species == s );
+          expect( ranking.entries[e].score <= best->score );
+          expect( ranking.entries[e].score <= MATCHUP_RATING_MAX );
+        }
+      if ( ranking.rounds < opts.max_rounds )
+        {
+          expect( species->opponent == species->best );
+        }
+    }
+
+  /* Ranked best first */
+  for ( uint32_t r = 0; r < ranking.nspecies; r++ )
+    {
+      expect( ranking.species[ranking.order[r]].rank == r );
+      if ( 0 < r )
+        {
+          expect( ranking_get_rank( & ranking, r )->score <=
+                  ranking_get_rank( & ranking, r - 1 )->score
+                );
+        }
+    }
+  expect( ranking_get_rank( & ranking, ranking.nspecies ) == NULL );
+
+  /* The thread count changes nothing */
+  opts.nthreads = 3;
+  expect( ranking_build( & threads, cup, & opts ) == STORE_SUCCESS );
+  expect( threads.nentries == ranking.nentries );
+  expect( threads.iterations == ranking.iterations );
+  expect( memcmp( threads.order, ranking.order,
+                  sizeof( uint32_t ) * ranking.nspecies
+                ) == 0
+        );
+  for ( uint32_t e = 0; e < ranking.nentries; e++ )
+    {
+      expect( threads.entries[e].score == ranking.entries[e].score );
+    }
+  ranking_free( & threads );
+
+  /* Rescoring reads the matrix, even weights are a plain mean */
+  expect( ranking_score( & ranking, NULL, 1 ) == STORE_SUCCESS );
+  double sum = 0.0;
+  for ( uint8_t s = 0; s < ranking.matrix.nscenarios; s++ )
+    {
+      for ( uint32_t c = 0; c < ranking.matrix.ncols; c++ )
+        {
+          sum += matchup_matrix_get( & ranking.matrix, 0, s, c );
+        }
+    }
+  expect( close_to( ranking.entries[0].score,
+                    sum / matchup_matrix_row_len( & ranking.matrix )
+                  )
+        );
+  float * weights = (float *) calloc( ranking.nspecies, sizeof( float ) );
+  expect( ranking_score( & ranking, weights, 1 ) == STORE_ERROR_BAD_VALUE );
+  weights[0] = 1.0;
+  expect( ranking_score( & ranking, weights, 1 ) == STORE_SUCCESS );
+  expect( close_to( ranking.entries[0].scenario_scores[0],
+                    matchup_matrix_get( & ranking.matrix, 0, 0, 0 )
+                  )
+        );
+  free( weights );
+
+  /* The matrix saves with its rows and columns named */
+  char           path[] = "/tmp/cpoke_test_ranking_XXXXXX";
+  matchup_file_t file   = MATCHUP_FILE_INIT;
+  uint32_t       idx    = 0;
+  int            fd     = mkstemp( path );
+  expect( fd != -1 );
+  close( fd );
+  expect( ranking_save_matrix( & ranking, 1, path ) == STORE_SUCCESS );
+  expect( matchup_file_open( & file, path, 1 ) == STORE_SUCCESS );
+  unlink( path );
+  expect( file.header->nrows == ranking.nentries );
+  expect( file.header->ncols == ranking.nspecies );
+  for ( uint32_t e = 0; e < ranking.nentries; e++ )
+    {
+      expect( file.rows[e].dex_number == ranking.entries[e].dex_number );
+      expect( file.rows[e].fast_move_id == ranking.entries[e].fast_move_id );
+      expect( matchup_file_get( & file, e, 1, e % ranking.nspecies ) ==
+              matchup_matrix_get( & ranking.matrix, e, 1,
+                                  e % ranking.nspecies
+                                )
+            );
+    }
+  const ranking_species_t * first = ranking.species;
+  expect( matchup_file_find( file.rows, ranking.nentries, file.cols, & idx ) );
+  expect( ranking.entries[idx].species == 0 );
+  expect( idx == first->opponent );
+  matchup_file_close( & file );
+
+  ranking_free( & ranking );
+  expect( ranking.entries == NULL );
+
+  /* One moveset each */
+  opts.max_movesets = 1;
+  expect( ranking_build( & ranking, cup, & opts ) == STORE_SUCCESS );
+  expect( ranking.nentries == ranking.nspecies );
+  ranking_free( & ranking );
+
+  return true;
+}
+
+
+  static bool
+test_ranking_empty( void )
+{
+  cup_t     * cup     = NULL;
+  ranking_t   ranking = RANKING_INIT;
+
+  expect( cupstore_get_str( & CUPS, "EMPTY_CUP", (void **) & cup ) ==
+          STORE_SUCCESS
+        );
+  expect( ranking_build( & ranking, cup, NULL ) == STORE_ERROR_NOT_FOUND );
+  expect( ranking.entries == NULL );
+
+  /* Nothing fits under a CP cap of 9, the least a Pokemon can have is 10 */
+  expect( cupstore_get_str( & CUPS, "TINY_CUP", (void **) & cup ) ==
+          STORE_SUCCESS
+        );
+  expect( ranking_build( & ranking, cup, NULL ) == STORE_ERROR_NOT_FOUND );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+struct each_ctx_s {
+  uint32_t next_rank;
+  uint32_t movesets;
+};
+
+  static int
+rank_order_cb( void * vctx, store_key_t key, void * val )
+{
+  struct each_ctx_s * ctx = (struct each_ctx_s *) vctx;
+  pvp_mon_rank_t    * mon = (pvp_mon_rank_t *) val;
+  if ( mon->rank != ctx->next_rank++ ) return STORE_ERROR_FAIL;
+  if ( key.data_h0 != mon->dex_number ) return STORE_ERROR_FAIL;
+  return STORE_SUCCESS;
+}
+
+  static int
+count_movesets_cb( void * vctx, store_key_t key, void * val )
+{
+  ( (struct each_ctx_s *) vctx )->movesets++;
+  return ( key.val_type == STORE_PVP_MOVE_RANKING ) ? STORE_SUCCESS
+                                                    : STORE_ERROR_FAIL;
+}
+
+
+  static bool
+test_rankstore( void )
+{
+  cup_t              * cup     = NULL;
+  ranking_t            ranking = RANKING_INIT;
+  store_t              ranks   = def_rankstore();
+  pvp_mon_rank_t     * mon     = NULL;
+  pvp_moveset_rank_t * moveset = NULL;
+  struct each_ctx_s    ctx     = { .next_rank = 0, .movesets = 0 };
+
+  expect( cupstore_get_str( & CUPS, "TEST_CUP", (void **) & cup ) ==
+          STORE_SUCCESS
+        );
+  expect( ranking_build( & ranking, cup, NULL ) == STORE_SUCCESS );
+  expect( ranks.init( & ranks, NULL ) == STORE_SUCCESS );
+  expect( rankstore_add_ranking( & ranks, & ranking ) == STORE_SUCCESS );
+  expect( rankstore_count( & ranks ) == ranking.nspecies );
+  expect( 0 < store_version( & ranks ) );
+
+  /* By rank, and by species */
+  for ( uint32_t r = 0; r < ranking.nspecies; r++ )
+    {
+      const ranking_entry_t * best = ranking_get_rank( & ranking, r );
+      expect( rankstore_get_rank( & ranks, r, & mon ) == STORE_SUCCESS );
+      expect( mon->rank == r );
+      expect( mon->dex_number == best->dex_number );
+      expect( mon->form_idx == best->form_idx );
+      expect( mon->score == best->score );
+      expect( mon->level == best->level );
+      expect( mon->scenarios == MATCHUP_STANDARD_SCENARIOS_M );
+      expect( mon->scenario_scores[matchup_scenario( 1, 1 )] ==
+              best->scenario_scores[1]
+            );
+      expect( mon->movesets[0].fast_move_id == best->fast_move_id );
+      expect( mon->movesets[0].score == best->score );
+      for ( uint8_t m = 1; m < mon->nmovesets; m++ )
+        {
+          expect( mon->movesets[m].score <= mon->movesets[m - 1].score );
+        }
+
+      pvp_mon_rank_t * by_key = NULL;
+      expect( ranks.get( & ranks,
+                         mon_rank_store_key( best->dex_number,
+                                             best->form_idx
+                                           ),
+                         (void **) & by_key
+                       ) == STORE_SUCCESS
+            );
+      expect( by_key == mon );
+      expect( ranks.get( & ranks,
+                         moveset_rank_store_key( best->dex_number,
+                                                 best->form_idx,
+                                                 0
+                                               ),
+                         (void **) & moveset
+                       ) == STORE_SUCCESS
+            );
+      expect( moveset == mon->movesets );
+      expect( ! ranks.has( & ranks,
+                           moveset_rank_store_key( best->dex_number,
+                                                   best->form_idx,
+                                                   mon->nmovesets
+                                                 )
+                         )
+            );
+    }
+  expect( rankstore_get_rank( & ranks, ranking.nspecies, & mon ) ==
+          STORE_ERROR_NOT_FOUND
+        );
+  expect( ranks.get( & ranks, mon_rank_store_key( 150, 0 ), (void **) & mon )
+          == STORE_ERROR_NOT_FOUND
+        );
+  expect( ranks.get( & ranks, dex_form_store_key( 1, 0 ), (void **) & mon )
+          == STORE_ERROR_BAD_VALUE
+        );
+
+  /* Rank order, and every moveset */
+  expect( store_each( & ranks, STORE_PVP_POKEMON_RANKING, rank_order_cb,
+                      & ctx
+                    ) == STORE_SUCCESS
+        );
+  expect( ctx.next_rank == ranking.nspecies );
+  expect( store_each( & ranks, STORE_PVP_MOVE_RANKING, count_movesets_cb,
+                      & ctx
+                    ) == STORE_SUCCESS
+        );
+  expect( ctx.movesets == ranking.nentries );
+
+  /* Species are unique, and `set' keeps the rank */
+  expect( rankstore_get_rank( & ranks, 1, & mon ) == STORE_SUCCESS );
+  pvp_mon_rank_t edit = * mon;
+  store_key_t    key  = mon_rank_store_key( edit.dex_number, edit.form_idx );
+  expect( ranks.add( & ranks, key, & edit ) == STORE_ERROR_BAD_VALUE );
+  edit.score     = 1.0;
+  edit.nmovesets = 0;
+  edit.movesets  = NULL;
+  expect( ranks.set( & ranks, key, & edit ) == STORE_SUCCESS );
+  expect( ranks.get( & ranks, key, (void **) & mon ) == STORE_SUCCESS );
+  expect( ( mon->rank == 1 ) && ( mon->score == 1.0 ) );
+  expect( mon->nmovesets == 0 );
+  key.data_h0 = 150;
+  expect( ranks.set( & ranks, key, & edit ) == STORE_ERROR_BAD_VALUE );
+
+  ranks.free( & ranks );
+  ranking_free( & ranking );
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_ranking( void )
+{
+  bool rsl = true;
+
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= CUPS.init( & CUPS, & CSTORE ) == STORE_SUCCESS;
+  rsl &= cupstore_add_cup( & CUPS, "TEST_CUP", TEST_CP_CAP, TEST_CUP_QUERY )
+         == STORE_SUCCESS;
+  rsl &= cupstore_add_cup( & CUPS, "EMPTY_CUP", TEST_CP_CAP, "!all" )
+         == STORE_SUCCESS;
+  rsl &= cupstore_add_cup( & CUPS, "TINY_CUP", 9, TEST_CUP_QUERY )
+         == STORE_SUCCESS;
+  rsl &= do_test( ranking_build );
+  rsl &= do_test( ranking_empty );
+  rsl &= do_test( rankstore );
+  CUPS.free( & CUPS );
+  CS_free();
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_ranking() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,464 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "matchup.h"
+#include "replicator.h"
+#include "util/macros.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "util/test_util.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+/* More than a tile of columns, so the last tile is partial */
+#define TEST_NSPECIES  600
+/* Species that lose to everyone, and die out */
+#define TEST_NWEAK     20
+
+
+/* A `nrows' by `ncols' matrix in the standard scenarios, all zeroes */
+  static bool
+make_matrix( matchup_matrix_t * matrix, uint32_t nrows, uint32_t ncols )
+{
+  * matrix = (matchup_matrix_t) {
+    .nrows      = nrows,
+    .ncols      = ncols,
+    .nscenarios = 3,
+    .scenarios  = { matchup_scenario( 0, 0 ), matchup_scenario( 1, 1 ),
+                    matchup_scenario( 2, 2 )
+                  },
+    .ratings    = (uint16_t *)
+      calloc( (size_t) nrows * 3 * ncols, sizeof( uint16_t ) )
+  };
+  return matrix->ratings != NULL;
+}
+
+
+/* Set a rating in every scenario */
+  static void
+set_rating( matchup_matrix_t * matrix,
+            uint32_t           row,
+            uint32_t           col,
+            uint16_t           rating
+          )
+{
+  for ( uint8_t s = 0; s < matrix->nscenarios; s++ )
+    {
+      matrix->ratings[( (size_t) row * matrix->nscenarios + s ) *
+                      matrix->ncols + col] = rating;
+    }
+}
+
+
+/**
+ * Made up ratings for twice as many rows as columns, with only the odd rows
+ * played.
+ * The first `TEST_NWEAK' species lose everything.
+ */
+  static bool
+make_random( matchup_matrix_t * matrix, uint32_t * rows )
+{
+  uint32_t seed = 4242;
+
+  if ( ! make_matrix( matrix, 2 * TEST_NSPECIES, TEST_NSPECIES ) )
+    {
+      return false;
+    }
+  for ( uint32_t r = 0; r < matrix->nrows; r++ )
+    {
+      for ( uint32_t i = 0; i < 3 * TEST_NSPECIES; i++ )
+        {
+          seed = seed * 1103515245 + 12345;
+          uint16_t rating = 300 + ( seed >> 16 ) % 401;
+          if ( r / 2 < TEST_NWEAK ) rating = 0;
+          matrix->ratings[(size_t) r * 3 * TEST_NSPECIES + i] = rating;
+        }
+    }
+  for ( uint32_t i = 0; i < TEST_NSPECIES; i++ )
+    {
+      rows[i] = 2 * i + 1;
+    }
+  return true;
+}
+
+
+/**
+ * The dynamics the slow way, in doubles over every species, for `ngens'
+ * generations from even usage.
+ */
+  static void
+naive_run( const matchup_matrix_t  * matrix,
+           const uint32_t          * rows,
+           const replicator_opts_t * opts,
+           uint32_t                  ngens,
+           double                  * usage
+         )
+{
+  const uint32_t   n       = matrix->ncols;
+  double         * fitness = (double *) malloc( sizeof( double ) * n );
+
+  for ( uint32_t i = 0; i < n; i++ ) usage[i] = 1.0 / n;
+  for ( uint32_t g = 0; g < ngens; g++ )
+    {
+      double fbar = 0.0;
+      for ( uint32_t i = 0; i < n; i++ )
+        {
+          fitness[i] = 0.0;
+          for ( uint32_t j = 0; j < n; j++ )
+            {
+              double payoff = 0.0;
+              for ( uint8_t s = 0; s < matrix->nscenarios; s++ )
+                {
+                  payoff += matchup_matrix_get( matrix, rows[i], s, j );
+                }
+              fitness[i] += payoff / ( 3.0 * MATCHUP_RATING_MAX ) * usage[j];
+            }
+          fbar += usage[i] * fitness[i];
+        }
+      double total = 0.0;
+      for ( uint32_t i = 0; i < n; i++ )
+        {
+          usage[i] *= ( 1.0 - opts->rate ) + opts->rate * fitness[i] / fbar;
+          if ( usage[i] < opts->extinct ) usage[i] = 0.0;
+          total += usage[i];
+        }
+      for ( uint32_t i = 0; i < n; i++ ) usage[i] /= total;
+    }
+  free( fitness );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_replicator_dominant( void )
+{
+  matchup_matrix_t matrix = MATCHUP_MATRIX_INIT;
+  replicator_t     rep    = REPLICATOR_INIT;
+  const uint32_t   n      = 5;
+
+  /* Species 2 beats everyone, the rest are even */
+  expect( make_matrix( & matrix, n, n ) );
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      for ( uint32_t j = 0; j < n; j++ )
+        {
+          uint16_t rating = MATCHUP_RATING_TIE;
+          if ( ( i == 2 ) && ( j != 2 ) ) rating = 800;
+          if ( ( i != 2 ) && ( j == 2 ) ) rating = 200;
+          set_rating( & matrix, i, j, rating );
+        }
+    }
+
+  expect( replicator_init( & rep, & matrix, NULL, NULL, NULL ) ==
+          STORE_SUCCESS
+        );
+  expect( rep.nactive == n );
+  expect( fabs( rep.usage[0] - 0.2 ) < 1e-6 );
+  int ngens = replicator_run( & rep, 10000 );
+  expect( ( 0 < ngens ) && ( ngens < 10000 ) );
+  expect( rep.converged );
+  expect( rep.generation == (uint32_t) ngens );
+  expect( rep.nactive == 1 );
+  expect( rep.active[0] == 2 );
+  expect( rep.usage[2] == 1.0 );
+  for ( uint32_t i = 0; i < n; i++ )
+    {
+      if ( i != 2 ) expect( rep.usage[i] == 0.0 );
+    }
+
+  /* Once converged, nothing more runs */
+  expect( replicator_run( & rep, 10 ) == 0 );
+  replicator_free( & rep );
+  expect( rep.usage == NULL );
+
+  matchup_matrix_free( & matrix );
+  return true;
+}
+
+
+  static bool
+test_replicator_mixed( void )
+{
+  matchup_matrix_t  matrix = MATCHUP_MATRIX_INIT;
+  replicator_t      rep    = REPLICATOR_INIT;
+  replicator_opts_t opts   = REPLICATOR_OPTS_DEFAULT;
+  const float       start[2] = { 0.9, 0.1 };
+
+  /**
+   * Hawk and Dove: neither is stable alone, and usage settles where both
+   * do as well, at 5/9 Hawks.
+   * Only the first scenario counts, the others would make Dove dominant.
+   */
+  expect( make_matrix( & matrix, 2, 2 ) );
+  set_rating( & matrix, 1, 0, 1000 );
+  set_rating( & matrix, 1, 1, 1000 );
+  matrix.ratings[0] = 200;
+  matrix.ratings[1] = 1000;
+  matrix.ratings[6] = 600;
+  matrix.ratings[7] = 500;
+
+  opts.scenarios = matchup_scenario_mask( matchup_scenario( 0, 0 ) );
+  opts.rate      = 0.5;
+  opts.tolerance = 1e-7;
+  expect( replicator_init( & rep, & matrix, NULL, start, & opts ) ==
+          STORE_SUCCESS
+        );
+  expect( fabs( rep.usage[0] - 0.9 ) < 1e-6 );
+  expect( 0 < replicator_run( & rep, 10000 ) );
+  expect( fabs( rep.usage[0] - 5.0 / 9.0 ) < 1e-4 );
+  expect( fabsf( rep.fitness[0] - rep.fitness[1] ) < 1e-4 );
+  expect( rep.nactive == 2 );
+  replicator_free( & rep );
+
+  matchup_matrix_free( & matrix );
+  return true;
+}
+
+
+  static bool
+test_replicator_naive( void )
+{
+  matchup_matrix_t  matrix = MATCHUP_MATRIX_INIT;
+  replicator_t      rep    = REPLICATOR_INIT;
+  replicator_t      other  = REPLICATOR_INIT;
+  replicator_opts_t opts   = REPLICATOR_OPTS_DEFAULT;
+  uint32_t          rows[TEST_NSPECIES];
+  double            usage[TEST_NSPECIES];
+  const uint32_t    ngens  = 40;
+
+  expect( make_random( & matrix, rows ) );
+  opts.rate             = 0.5;
+  opts.tolerance        = 0.0;
+  opts.checkpoint_every = 0;
+
+  /* Close to doubles, with the losers gone */
+  opts.nthreads = 1;
+  expect( replicator_init( & rep, & matrix, rows, NULL, & opts ) ==
+          STORE_SUCCESS
+        );
+  expect( rep.ncheckpoints == 0 );
+  expect( replicator_run( & rep, ngens ) == (int) ngens );
+  expect( ! rep.converged );
+  expect( rep.nactive == TEST_NSPECIES - TEST_NWEAK );
+  expect( rep.active[0] == TEST_NWEAK );
+  naive_run( & matrix, rows, & opts, ngens, usage );
+  for ( uint32_t i = 0; i < TEST_NSPECIES; i++ )
+    {
+      expect( fabs( rep.usage[i] - usage[i] ) < 1e-6 );
+      expect( ( rep.usage[i] == 0.0 ) == ( usage[i] == 0.0 ) );
+    }
+
+  /* The same to the bit on more threads */
+  opts.nthreads = 4;
+  expect( replicator_init( & other, & matrix, rows, NULL, & opts ) ==
+          STORE_SUCCESS
+        );
+  expect( replicator_run( & other, ngens ) == (int) ngens );
+  expect( other.nactive == rep.nactive );
+  expect( memcmp( other.usage, rep.usage, sizeof( float ) * TEST_NSPECIES )
+          == 0
+        );
+  expect( memcmp( other.fitness, rep.fitness,
+                  sizeof( float ) * TEST_NSPECIES
+                ) == 0
+        );
+  replicator_free( & other );
+  replicator_free( & rep );
+
+  matchup_matrix_free( & matrix );
+  return true;
+}
+
+
+  static bool
+test_replicator_checkpoints( void )
+{
+  char              path[] = "/tmp/cpoke_test_replicator_XXXXXX";
+  matchup_matrix_t  matrix = MATCHUP_MATRIX_INIT;
+  replicator_t      rep    = REPLICATOR_INIT;
+  replicator_t      other  = REPLICATOR_INIT;
+  replicator_opts_t opts   = REPLICATOR_OPTS_DEFAULT;
+  uint32_t          rows[TEST_NSPECIES];
+  int               fd     = mkstemp( path );
+
+  expect( fd != -1 );
+  close( fd );
+  expect( make_random( & matrix, rows ) );
+  opts.rate             = 0.5;
+  opts.tolerance        = 0.0;
+  opts.checkpoint_every = 5;
+
+  /* Generation 0, then every 5 */
+  expect( replicator_init( & rep, & matrix, rows, NULL, & opts ) ==
+          STORE_SUCCESS
+        );
+  expect( rep.ncheckpoints == 1 );
+  expect( replicator_run( & rep, 23 ) == 23 );
+  expect( rep.ncheckpoints == 5 );
+  for ( uint32_t c = 0; c < rep.ncheckpoints; c++ )
+    {
+      expect( rep.checkpoint_gens[c] == 5 * c );
+    }
+  expect( replicator_checkpoint( & rep, 0 )[0] ==
+          (float) ( 1.0 / TEST_NSPECIES )
+        );
+  expect( replicator_checkpoint( & rep, 4 )[0] == 0.0 );
+  expect( replicator_checkpoint( & rep, 1 )[TEST_NWEAK] !=
+          replicator_checkpoint( & rep, 2 )[TEST_NWEAK]
+        );
+
+  /* Resuming from a save matches having kept going */
+  expect( replicator_save( & rep, path ) == STORE_SUCCESS );
+  expect( replicator_run( & rep, 27 ) == 27 );
+  expect( rep.ncheckpoints == 11 );
+
+  opts.checkpoint_every = 5;
+  expect( replicator_init( & other, & matrix, rows, NULL, & opts ) ==
+          STORE_SUCCESS
+        );
+  expect( replicator_load( & other, path ) == STORE_SUCCESS );
+  expect( other.generation == 23 );
+  expect( other.ncheckpoints == 5 );
+  expect( other.nactive == TEST_NSPECIES - TEST_NWEAK );
+  expect( replicator_run( & other, 27 ) == 27 );
+  expect( other.generation == rep.generation );
+  expect( other.ncheckpoints == rep.ncheckpoints );
+  expect( memcmp( other.checkpoint_gens, rep.checkpoint_gens,
+                  sizeof( uint32_t ) * rep.ncheckpoints
+                ) == 0
+        );
+  expect( memcmp( other.checkpoints, rep.checkpoints,
+                  sizeof( float ) * TEST_NSPECIES * rep.ncheckpoints
+                ) == 0
+        );
+  expect( memcmp( other.usage, rep.usage, sizeof( float ) * TEST_NSPECIES )
+          == 0
+        );
+  replicator_free( & other );
+  replicator_free( & rep );
+
+  unlink( path );
+  matchup_matrix_free( & matrix );
+  return true;
+}
+
+
+  static bool
+test_replicator_errors( void )
+{
+  char              path[] = "/tmp/cpoke_test_replicator_XXXXXX";
+  matchup_matrix_t  matrix = MATCHUP_MATRIX_INIT;
+  replicator_t      rep    = REPLICATOR_INIT;
+  replicator_t      other  = REPLICATOR_INIT;
+  replicator_opts_t opts   = REPLICATOR_OPTS_DEFAULT;
+  const float       none[3] = { 0.0, -1.0, 0.0 };
+  int               fd     = mkstemp( path );
+
+  expect( fd != -1 );
+  close( fd );
+  expect( make_matrix( & matrix, 3, 2 ) );
+
+  /* Not square, and no rows to say who plays each column */
+  expect( replicator_init( & rep, & matrix, NULL, NULL, NULL ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  matrix.nrows = 2;
+  expect( replicator_init( & rep, & matrix, NULL, none, NULL ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  expect( rep.usage == NULL );
+  opts.scenarios = matchup_scenario_mask( matchup_scenario( 0, 1 ) );
+  expect( replicator_init( & rep, & matrix, NULL, NULL, & opts ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+
+  /* Nobody scores, so nothing changes */
+  expect( replicator_init( & rep, & matrix, NULL, NULL, NULL ) ==
+          STORE_SUCCESS
+        );
+  expect( replicator_run( & rep, 5 ) == 1 );
+  expect( rep.converged );
+  expect( rep.usage[0] == 0.5 );
+
+  /* Empty, garbage, and other sized saves don't load */
+  expect( replicator_load( & rep, path ) == STORE_ERROR_BAD_VALUE );
+  FILE * ostream = fopen( path, "w" );
+  expect( ostream != NULL );
+  fputs( "Not a replicator save, though it is long enough to hold a header.",
+         ostream
+       );
+  fclose( ostream );
+  expect( replicator_load( & rep, path ) == STORE_ERROR_BAD_VALUE );
+
+  matrix.nrows = 3;
+  expect( replicator_init( & other, & matrix, (uint32_t []) { 2, 0 }, NULL,
+                           NULL
+                         ) == STORE_SUCCESS
+        );
+  expect( replicator_save( & other, path ) == STORE_SUCCESS );
+  expect( replicator_load( & rep, path ) == STORE_SUCCESS );
+  matrix.ncols = 1;
+  replicator_free( & other );
+  expect( replicator_init( & other, & matrix, NULL, NULL, NULL ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  expect( replicator_init( & other, & matrix, (uint32_t []) { 1 }, NULL,
+                           NULL
+                         ) == STORE_SUCCESS
+        );
+  expect( replicator_load( & other, path ) == STORE_ERROR_BAD_VALUE );
+  matrix.ncols = 2;
+  replicator_free( & other );
+
+  unlink( path );
+  expect( replicator_load( & rep, path ) == STORE_ERROR_NOT_FOUND );
+  replicator_free( & rep );
+
+  matchup_matrix_free( & matrix );
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_replicator( void )
+{
+  bool rsl = true;
+
+  rsl &= do_test( replicator_dominant );
+  rsl &= do_test( replicator_mixed );
+  rsl &= do_test( replicator_naive );
+  rsl &= do_test( replicator_checkpoints );
+  rsl &= do_test( replicator_errors );
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_replicator() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,304 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "battle.h"
+#include "parse_csv.h"
+#include "pokedex.h"
+#include "pokemon.h"
+#include "rosterstore.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+#define CALCY_TEST_FILE  "data/test/calcy.csv"
+#define CSV_TEST_FILE    "data/test/pokebattler.csv"
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_rosterstore_import( void )
+{
+  rosterstore_t      rs   = def_rosterstore();
+  roster_pokemon_t * rmon = NULL;
+  store_move_t     * move = NULL;
+
+  expect( rs.init( & rs, & CSTORE ) == STORE_SUCCESS );
+  expect( rosterstore_import_calcy( & rs, CALCY_TEST_FILE ) == STORE_SUCCESS );
+  expect( rosterstore_import_pokebattler( & rs, CSV_TEST_FILE ) ==
+          STORE_SUCCESS
+        );
+  expect( rosterstore_count( & rs ) == 9 );
+
+  /* Columns */
+  expect( as_rsa( & rs )->dex[0] == 618 );
+  expect( as_rsa( & rs )->lvi[0] == 38 );
+  expect( as_rsa( & rs )->ivs[1] == 0x1e7 );
+  expect( as_rsa( & rs )->charged2[1] == 0 );
+
+  /* Rows are rebuilt on request */
+  expect( rs.has( & rs, roster_row_store_key( 8 ) ) );
+  expect( ! rs.has( & rs, roster_row_store_key( 9 ) ) );
+  expect( rs.get( & rs, roster_row_store_key( 2 ), (void **) & rmon ) ==
+          STORE_SUCCESS
+        );
+  expect( rmon->base->pdex_mon->dex_number == 52 );
+  expect( strcmp( rmon->base->pdex_mon->form_name, "ALOLA" ) == 0 );
+  expect( rmon->base->level == 18.5 );
+  expect( rmon->base->ivs.attack == 5 );
+  expect( rmon->base->ivs.defense == 5 );
+  expect( rmon->base->ivs.stamina == 6 );
+  expect( CS_get_move( rmon->charged_move_ids[1], & move ) == STORE_SUCCESS );
+  expect( strcmp( move->name, "DARK_PULSE" ) == 0 );
+  expect( rs.get( & rs, roster_row_store_key( 9 ), (void **) & rmon ) ==
+          STORE_ERROR_NOT_FOUND
+        );
+
+  /* `set' overwrites a row, `add' only appends */
+  expect( rs.get( & rs, roster_row_store_key( 4 ), (void **) & rmon ) ==
+          STORE_SUCCESS
+        );
+  roster_pokemon_t copy = *rmon;
+  base_pokemon_t   base = *rmon->base;
+  copy.base = & base;
+  base.level = 30.0;
+  expect( rs.set( & rs, roster_row_store_key( 0 ), & copy ) ==
+          STORE_SUCCESS
+        );
+  expect( rs.add( & rs, roster_row_store_key( 0 ), & copy ) ==
+          STORE_ERROR_BAD_VALUE
+        );
+  expect( rs.add( & rs, roster_row_store_key( 9 ), & copy ) ==
+          STORE_SUCCESS
+        );
+  expect( rs.get( & rs, roster_row_store_key( 0 ), (void **) & rmon ) ==
+          STORE_SUCCESS
+        );
+  expect( rmon->base->pdex_mon->dex_number == 618 );
+  expect( rmon->base->level == 30.0 );
+  expect( rosterstore_count( & rs ) == 10 );
+
+  rs.free( & rs );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_rosterstore_indices( void )
+{
+  rosterstore_t    rs    = def_rosterstore();
+  const uint32_t * rows  = NULL;
+  uint32_t         nrows = 0;
+  store_move_t   * move  = NULL;
+  pdex_mon_t     * mon   = NULL;
+
+  expect( rs.init( & rs, & CSTORE ) == STORE_SUCCESS );
+  expect( rosterstore_import_calcy( & rs, CALCY_TEST_FILE ) == STORE_SUCCESS );
+  expect( rosterstore_import_pokebattler( & rs, CSV_TEST_FILE ) ==
+          STORE_SUCCESS
+        );
+
+  /* Stunfisk and Venusaur appear in both files */
+  expect( rosterstore_rows_by_species( & rs, 618, & rows, & nrows ) ==
+          STORE_SUCCESS
+        );
+  expect( nrows == 2 );
+  expect( ( rows[0] == 0 ) && ( rows[1] == 4 ) );
+  expect( rosterstore_rows_by_species( & rs, 1, & rows, & nrows ) ==
+          STORE_ERROR_NOT_FOUND
+        );
+  expect( nrows == 0 );
+
+  expect( CS_get_pokemon( 3, 0, & mon ) == STORE_SUCCESS );
+  expect( rosterstore_rows_by_family( & rs, mon->family, & rows, & nrows ) ==
+          STORE_SUCCESS
+        );
+  expect( nrows == 2 );
+  expect( ( rows[0] == 1 ) && ( rows[1] == 5 ) );
+
+  /* Sludge Bomb is a second charged move for Venusaur and Nidoran */
+  expect( CS_get_move_by_name( "SLUDGE_BOMB", & move ) == STORE_SUCCESS );
+  expect( rosterstore_rows_by_move( & rs, move->move_id, & rows, & nrows ) ==
+          STORE_SUCCESS
+        );
+  expect( nrows == 2 );
+  expect( ( rows[0] == 5 ) && ( rows[1] == 7 ) );
+
+  /* Indices follow additions */
+  roster_pokemon_t * rmon = NULL;
+  expect( rs.get( & rs, roster_row_store_key( 0 ), (void **) & rmon ) ==
+          STORE_SUCCESS
+        );
+  expect( rs.add( & rs, roster_row_store_key( 9 ), rmon ) == STORE_SUCCESS );
+  expect( rosterstore_rows_by_species( & rs, 618, & rows, & nrows ) ==
+          STORE_SUCCESS
+        );
+  expect( nrows == 3 );
+  expect( rows[2] == 9 );
+
+  rs.free( & rs );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_rank_ivs_stat_product( void )
+{
+  uint16_t     ranks[4096];
+  pdex_mon_t * mon  = NULL;
+  stats_t      low  = { .attack = 0, .stamina = 15, .defense = 15 };
+  stats_t      high = { .attack = 15, .stamina = 0, .defense = 0 };
+  stats_t      all  = { .attack = 15, .stamina = 15, .defense = 15 };
+  uint32_t     nbest = 0;
+
+  expect( CS_get_pokemon( 3, 0, & mon ) == STORE_SUCCESS );
+  rank_ivs_stat_product( mon, GREAT_LEAGUE, ranks );
+  for ( int i = 0; i < 4096; i++ )
+    {
+      expect( ( 1 <= ranks[i] ) && ( ranks[i] <= 4096 ) );
+      if ( ranks[i] == 1 ) nbest++;
+    }
+  expect( 1 <= nbest );
+
+  /* Low Attack is favoured under a cap */
+  expect( ranks[rosterstore_ivs_pack( low )] <
+          ranks[rosterstore_ivs_pack( high )]
+        );
+
+  /* Without a cap the best IVs are simply best */
+  rank_ivs_stat_product( mon, UINT16_MAX, ranks );
+  expect( ranks[rosterstore_ivs_pack( all )] == 1 );
+
+  /* Nothing fits under a tiny cap */
+  rank_ivs_stat_product( mon, 5, ranks );
+  expect( ranks[0] == 0 );
+  expect( ranks[4095] == 0 );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_rosterstore_query_iv_rank( void )
+{
+  rosterstore_t      rs   = def_rosterstore();
+  roster_pokemon_t   rmon = { .base = NULL };
+  base_pokemon_t     base = BASE_MON_NULL;
+  pdex_mon_t       * mon  = NULL;
+  uint16_t           ranks[4096];
+  uint32_t           rows[4096];
+  uint32_t           nexpect = 0;
+  const uint16_t     dexes[] = { 3, 618 };
+
+  expect( rs.init( & rs, & CSTORE ) == STORE_SUCCESS );
+
+  /* Every IV combination of two species */
+  rmon.base = & base;
+  base.level = 20.0;
+  for ( int d = 0; d < 2; d++ )
+    {
+      expect( CS_get_pokemon( dexes[d], 0, & mon ) == STORE_SUCCESS );
+      base.pdex_mon = mon;
+      rmon.fast_move_id        = abs( mon->fast_move_ids[0] );
+      rmon.charged_move_ids[0] = abs( mon->charged_move_ids[0] );
+      for ( uint16_t i = 0; i < 4096; i += 2 )
+        {
+          base.ivs = rosterstore_ivs_unpack( i );
+          expect( rs.add( & rs,
+                          roster_row_store_key( rosterstore_count( & rs ) ),
+                          & rmon
+                        ) == STORE_SUCCESS
+                );
+        }
+    }
+
+  /* Compare against ranking each row by hand */
+  uint32_t found = rosterstore_query_iv_rank( & rs,
+                                              GREAT_LEAGUE,
+                                              100,
+                                              rows,
+                                              4096
+                                            );
+  for ( int d = 0; d < 2; d++ )
+    {
+      expect( CS_get_pokemon( dexes[d], 0, & mon ) == STORE_SUCCESS );
+      rank_ivs_stat_product( mon, GREAT_LEAGUE, ranks );
+      for ( uint16_t i = 0; i < 4096; i += 2 )
+        {
+          uint32_t row = d * 2048 + i / 2;
+          if ( ( 0 < ranks[i] ) && ( ranks[i] <= 100 ) )
+            {
+              expect( nexpect < found );
+              expect( rows[nexpect] == row );
+              nexpect++;
+            }
+        }
+    }
+  expect( found == nexpect );
+  expect( 0 < found );
+
+  /* Only as many rows as fit are written */
+  expect( rosterstore_query_iv_rank( & rs, GREAT_LEAGUE, 100, rows, 1 ) ==
+          found
+        );
+  expect( rosterstore_query_iv_rank( & rs, GREAT_LEAGUE, 0, rows, 4096 ) ==
+          0
+        );
+
+  rs.free( & rs );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_rosterstore( void )
+{
+  bool rsl = true;
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= do_test( rosterstore_import );
+  rsl &= do_test( rosterstore_indices );
+  rsl &= do_test( rank_ivs_stat_product );
+  rsl &= do_test( rosterstore_query_iv_rank );
+  CS_free();
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_rosterstore() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,337 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "moves.h"
+#include "pokedex.h"
+#include "snapstore.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "util/test_util.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+extern pdex_mon_t * POKEDEX[];
+extern store_move_t MOVES[];
+extern uint16_t     NUM_POKEMON;
+extern uint16_t     NUM_MOVES;
+
+static char    SNAP_PATH[] = "/tmp/cpoke_test_snapstore_XXXXXX";
+static store_t SNAPSTORE   = def_snapstore();
+
+#define SNAPSTORE_TEST_THREADS  8
+#define SNAPSTORE_TEST_RELOADS  32
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Dump `cstore' data to a snapshot file, and load it. */
+  static bool
+test_snapstore_write( void )
+{
+  store_move_t ** moves = malloc( sizeof( store_move_t * ) * NUM_MOVES );
+  expect( moves != NULL );
+  for ( uint16_t i = 0; i < NUM_MOVES; i++ ) moves[i] = MOVES + i;
+
+  int fd = mkstemp( SNAP_PATH );
+  expect( fd != -1 );
+  FILE * ostream = fdopen( fd, "w" );
+  expect( ostream != NULL );
+  int rsl = snapstore_write( ostream, POKEDEX, NUM_POKEMON, moves, NUM_MOVES );
+  fclose( ostream );
+  free( moves );
+  expect( rsl == STORE_SUCCESS );
+
+  expect( snapstore_init( & SNAPSTORE, SNAP_PATH ) == STORE_SUCCESS );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_snapstore_get_pokemon( void )
+{
+  pdex_mon_t * mon   = NULL;
+  uint32_t     forms = 0;
+  int          rsl   = STORE_SUCCESS;
+
+  /* Every form of every Pokemon should match `cstore' */
+  for ( uint16_t i = 0; i < NUM_POKEMON; i++ )
+    {
+      pdex_mon_t * cmon = NULL;
+      for ( cmon = POKEDEX[i]; cmon != NULL; cmon = cmon->next_form )
+        {
+          rsl = snapstore_get_pokemon( & SNAPSTORE,
+                                       cmon->dex_number,
+                                       cmon->form_idx,
+                                       & mon
+                                     );
+          expect( rsl == STORE_SUCCESS );
+          expect( cmp_pdex_mon( cmon, mon ) == 0 );
+          expect( ( cmon->next_form == NULL ) == ( mon->next_form == NULL ) );
+          forms++;
+        }
+    }
+  expect( snapstore_snap( & SNAPSTORE )->mons_cnt == forms );
+
+  rsl = snapstore_get_pokemon( & SNAPSTORE, 1, 1, & mon );
+  expect( rsl == STORE_SUCCESS );
+  expect( mon->dex_number == 1 );
+  expect( mon->form_idx == 1 );
+
+  rsl = snapstore_get_pokemon( & SNAPSTORE, 1, 200, & mon );
+  expect( rsl == STORE_ERROR_NOT_FOUND );
+  expect( mon == NULL );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_snapstore_get_pokemon_by_name( void )
+{
+  pdex_mon_t * mon = NULL;
+  int          rsl = snapstore_get_pokemon_by_name( & SNAPSTORE,
+                                                    "BULBASAUR",
+                                                    & mon
+                                                  );
+  expect( rsl == STORE_SUCCESS );
+  expect( mon != NULL );
+  expect( mon->dex_number == 1 );
+  expect( mon->form_idx == 0 );
+
+  /* Records are resolved once, and their strings stay in the mapping */
+  pdex_mon_t       * again = NULL;
+  snapstore_snap_t * snap  = snapstore_snap( & SNAPSTORE );
+  expect( snapstore_get_pokemon( & SNAPSTORE, 1, 0, & again ) ==
+          STORE_SUCCESS
+        );
+  expect( again == mon );
+  expect( ( (char *) snap->map < mon->name ) &&
+          ( mon->name < ( (char *) snap->map + snap->map_size ) )
+        );
+
+  rsl = snapstore_get_pokemon_by_name( & SNAPSTORE, "MISSINGNO", & mon );
+  expect( rsl == STORE_ERROR_NOT_FOUND );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_snapstore_get_move( void )
+{
+  store_move_t * move  = NULL;
+  store_move_t * cmove = NULL;
+
+  for ( uint16_t i = 0; i < NUM_MOVES; i++ )
+    {
+      expect( snapstore_get_move( & SNAPSTORE, MOVES[i].move_id, & move ) ==
+              STORE_SUCCESS
+            );
+      cmove = MOVES + i;
+      expect( move->move_id == cmove->move_id );
+      expect( strcmp( move->name, cmove->name ) == 0 );
+      expect( move->type == cmove->type );
+      expect( move->is_fast == cmove->is_fast );
+      expect( move->cooldown == cmove->cooldown );
+      expect( move->pvp_power == cmove->pvp_power );
+      expect( move->pvp_energy == cmove->pvp_energy );
+      expect( memcmp( & move->buff, & cmove->buff, sizeof( buff_t ) ) == 0 );
+    }
+
+  expect( snapstore_get_move_by_name( & SNAPSTORE, "WRAP", & move ) ==
+          STORE_SUCCESS
+        );
+  expect( move->move_id == 13 );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_snapstore_get( void )
+{
+  pdex_mon_t   * mon  = NULL;
+  store_move_t * move = NULL;
+  int rsl             = snapstore_get( & SNAPSTORE,
+                                       dex_form_store_key( 1, 0 ),
+                                       (void **) & mon
+                                     );
+  expect( rsl == STORE_SUCCESS );
+  expect( mon != NULL );
+  expect( mon->dex_number == 1 );
+
+  rsl = snapstore_get( & SNAPSTORE, move_id_store_key( 13 ), (void **) & move );
+  expect( rsl == STORE_SUCCESS );
+  expect( move != NULL );
+  expect( move->move_id == 13 );
+
+  rsl = snapstore_get_str_t( & SNAPSTORE,
+                             STORE_MOVE,
+                             "WRAP",
+                             (void **) & move
+                           );
+  expect( rsl == STORE_SUCCESS );
+  expect( move->move_id == 13 );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+static atomic_bool SNAP_RELOADING;
+
+  static void *
+snapstore_reader( void * snapstore )
+{
+  pdex_mon_t   * mon  = NULL;
+  store_move_t * move = NULL;
+
+  do {
+    for ( uint16_t i = 0; i < NUM_POKEMON; i++ )
+      {
+        if ( snapstore_get_pokemon( snapstore,
+                                    POKEDEX[i]->dex_number,
+                                    0,
+                                    & mon
+                                  ) != STORE_SUCCESS
+           ) return NULL;
+        if ( strcmp( mon->name, POKEDEX[i]->name ) != 0 ) return NULL;
+      }
+    for ( uint16_t i = 0; i < NUM_MOVES; i++ )
+      {
+        if ( snapstore_get_move( snapstore, MOVES[i].move_id, & move ) !=
+             STORE_SUCCESS
+           ) return NULL;
+        if ( move->pvp_power != MOVES[i].pvp_power ) return NULL;
+      }
+  } while ( atomic_load( & SNAP_RELOADING ) );
+
+  return snapstore;
+}
+
+
+/* Swap snapshots out from under readers. */
+  static bool
+test_snapstore_reload( void )
+{
+  pthread_t          threads[SNAPSTORE_TEST_THREADS];
+  void             * rsl[SNAPSTORE_TEST_THREADS];
+  snapstore_snap_t * first   = snapstore_snap( & SNAPSTORE );
+  uint32_t           version = store_version( & SNAPSTORE );
+
+  atomic_store( & SNAP_RELOADING, true );
+  for ( int i = 0; i < SNAPSTORE_TEST_THREADS; i++ )
+    {
+      expect( pthread_create( threads + i,
+                              NULL,
+                              snapstore_reader,
+                              & SNAPSTORE
+                            ) == 0
+            );
+    }
+
+  int status = STORE_SUCCESS;
+  for ( int i = 0; ( i < SNAPSTORE_TEST_RELOADS ) &&
+                   ( status == STORE_SUCCESS ); i++ )
+    {
+      status = snapstore_reload( & SNAPSTORE, SNAP_PATH );
+    }
+  atomic_store( & SNAP_RELOADING, false );
+
+  for ( int i = 0; i < SNAPSTORE_TEST_THREADS; i++ )
+    {
+      pthread_join( threads[i], rsl + i );
+    }
+
+  expect( status == STORE_SUCCESS );
+  for ( int i = 0; i < SNAPSTORE_TEST_THREADS; i++ ) expect( rsl[i] != NULL );
+  expect( snapstore_snap( & SNAPSTORE ) != first );
+  expect( store_version( & SNAPSTORE ) ==
+          ( version + SNAPSTORE_TEST_RELOADS )
+        );
+
+  /* A failed reload keeps the current snapshot */
+  first   = snapstore_snap( & SNAPSTORE );
+  version = store_version( & SNAPSTORE );
+  expect( snapstore_reload( & SNAPSTORE, "/nonexistent" ) != STORE_SUCCESS );
+  expect( snapstore_snap( & SNAPSTORE ) == first );
+  expect( store_version( & SNAPSTORE ) == version );
+
+  snapstore_reclaim( & SNAPSTORE );
+  expect( as_ssa( & SNAPSTORE )->retired == NULL );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_snapstore_bad_file( void )
+{
+  store_t bad    = def_snapstore();
+  char    path[] = "/tmp/cpoke_test_snapstore_bad_XXXXXX";
+  int     fd     = mkstemp( path );
+  expect( fd != -1 );
+  expect( write( fd, "NOTASNAPSHOT", 12 ) == 12 );
+  close( fd );
+  expect( snapstore_init( & bad, path ) == STORE_ERROR_BAD_VALUE );
+  unlink( path );
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_snapstore( void )
+{
+  bool rsl = true;
+  rsl &= do_test( snapstore_write );
+  rsl &= do_test( snapstore_get_pokemon );
+  rsl &= do_test( snapstore_get_pokemon_by_name );
+  rsl &= do_test( snapstore_get_move );
+  rsl &= do_test( snapstore_get );
+  rsl &= do_test( snapstore_reload );
+  rsl &= do_test( snapstore_bad_file );
+  snapstore_free( & SNAPSTORE );
+  unlink( SNAP_PATH );
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_snapstore() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
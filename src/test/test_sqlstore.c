@@ -0,0 +1,258 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "moves.h"
+#include "pokedex.h"
+#include "sqlstore.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "util/test_util.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+extern pdex_mon_t * POKEDEX[];
+extern store_move_t MOVES[];
+extern uint16_t     NUM_POKEMON;
+extern uint16_t     NUM_MOVES;
+
+static char    SQL_PATH[] = "/tmp/cpoke_test_sqlstore_XXXXXX";
+static store_t SQLSTORE   = def_sqlstore();
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Dump `cstore' data to a database, and load it. */
+  static bool
+test_sqlstore_write( void )
+{
+  store_move_t ** moves = malloc( sizeof( store_move_t * ) * NUM_MOVES );
+  expect( moves != NULL );
+  for ( uint16_t i = 0; i < NUM_MOVES; i++ ) moves[i] = MOVES + i;
+
+  int fd = mkstemp( SQL_PATH );
+  expect( fd != -1 );
+  close( fd );
+  int rsl = sqlstore_write( SQL_PATH, POKEDEX, NUM_POKEMON, moves, NUM_MOVES );
+  expect( rsl == STORE_SUCCESS );
+  /* Rewriting should replace rows rather than collide with them */
+  rsl = sqlstore_write( SQL_PATH, POKEDEX, NUM_POKEMON, moves, NUM_MOVES );
+  expect( rsl == STORE_SUCCESS );
+  /* A failed write keeps the old rows, which the tests below rely on */
+  moves[NUM_MOVES - 1] = MOVES;
+  rsl = sqlstore_write( SQL_PATH, POKEDEX, NUM_POKEMON, moves, NUM_MOVES );
+  free( moves );
+  expect( rsl == STORE_ERROR_FAIL );
+
+  expect( sqlstore_init( & SQLSTORE, SQL_PATH ) == STORE_SUCCESS );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_sqlstore_get_pokemon( void )
+{
+  pdex_mon_t * mon  = NULL;
+  pdex_mon_t * cmon = NULL;
+  int          rsl  = STORE_SUCCESS;
+
+  for ( uint16_t i = 0; i < NUM_POKEMON; i++ )
+    {
+      for ( cmon = POKEDEX[i]; cmon != NULL; cmon = cmon->next_form )
+        {
+          rsl = sqlstore_get_pokemon( & SQLSTORE,
+                                      cmon->dex_number,
+                                      cmon->form_idx,
+                                      & mon
+                                    );
+          expect( rsl == STORE_SUCCESS );
+          expect( cmp_pdex_mon( cmon, mon ) == 0 );
+        }
+    }
+
+  rsl = sqlstore_get_pokemon( & SQLSTORE, 1, 200, & mon );
+  expect( rsl == STORE_ERROR_NOT_FOUND );
+  expect( mon == NULL );
+
+  rsl = sqlstore_get_pokemon_by_name( & SQLSTORE, "BULBASAUR", & mon );
+  expect( rsl == STORE_SUCCESS );
+  expect( mon->dex_number == 1 );
+  expect( mon->form_idx == 0 );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_sqlstore_get_move( void )
+{
+  store_move_t * move  = NULL;
+  store_move_t * cmove = NULL;
+
+  for ( uint16_t i = 0; i < NUM_MOVES; i++ )
+    {
+      expect( sqlstore_get_move( & SQLSTORE, MOVES[i].move_id, & move ) ==
+              STORE_SUCCESS
+            );
+      cmove = MOVES + i;
+      expect( move->move_id == cmove->move_id );
+      expect( strcmp( move->name, cmove->name ) == 0 );
+      expect( move->type == cmove->type );
+      expect( move->is_fast == cmove->is_fast );
+      expect( move->cooldown == cmove->cooldown );
+      expect( move->pvp_power == cmove->pvp_power );
+      expect( move->pvp_energy == cmove->pvp_energy );
+      expect( memcmp( & move->buff, & cmove->buff, sizeof( buff_t ) ) == 0 );
+    }
+
+  expect( sqlstore_get_str_t( & SQLSTORE,
+                              STORE_MOVE,
+                              "WRAP",
+                              (void **) & move
+                            ) == STORE_SUCCESS
+        );
+  expect( move->move_id == 13 );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_sqlstore_lru( void )
+{
+  store_move_t * move   = NULL;
+  uint32_t       hits   = 0;
+  uint32_t       misses = 0;
+
+  /* Start with an empty cache */
+  sqlstore_free( & SQLSTORE );
+  expect( sqlstore_init( & SQLSTORE, SQL_PATH ) == STORE_SUCCESS );
+  as_sqla( & SQLSTORE )->lru_cap = 8;
+  for ( uint16_t i = 0; i < 16; i++ )
+    {
+      expect( sqlstore_get_move( & SQLSTORE, MOVES[i].move_id, & move ) ==
+              STORE_SUCCESS
+            );
+    }
+  expect( HASH_COUNT( as_sqla( & SQLSTORE )->lru ) <= 8 );
+
+  /* The most recent lookup should still be cached */
+  hits = as_sqla( & SQLSTORE )->hits;
+  expect( sqlstore_get_move( & SQLSTORE, MOVES[15].move_id, & move ) ==
+          STORE_SUCCESS
+        );
+  expect( as_sqla( & SQLSTORE )->hits == hits + 1 );
+
+  /* While the first was evicted */
+  misses = as_sqla( & SQLSTORE )->misses;
+  expect( sqlstore_get_move( & SQLSTORE, MOVES[0].move_id, & move ) ==
+          STORE_SUCCESS
+        );
+  expect( as_sqla( & SQLSTORE )->misses == misses + 1 );
+  expect( move->move_id == MOVES[0].move_id );
+
+  /* A batch bigger than the cache must not evict its own results */
+  store_key_t    keys[32];
+  store_move_t * vals[32];
+  for ( uint16_t i = 0; i < 32; i++ )
+    {
+      keys[i] = move_id_store_key( MOVES[16 + i].move_id );
+    }
+  expect( sqlstore_get_many( & SQLSTORE, keys, 32, (void **) vals, NULL ) ==
+          STORE_SUCCESS
+        );
+  for ( uint16_t i = 0; i < 32; i++ )
+    {
+      expect( vals[i]->move_id == MOVES[16 + i].move_id );
+    }
+  expect( sqlstore_get_move( & SQLSTORE, MOVES[48].move_id, & move ) ==
+          STORE_SUCCESS
+        );
+  expect( HASH_COUNT( as_sqla( & SQLSTORE )->lru ) <= 8 );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static int
+count_each( void * ctx, store_key_t key, void * val )
+{
+  ( *(size_t *) ctx )++;
+  return ( val == NULL ) ? STORE_ERROR_FAIL : STORE_SUCCESS;
+}
+
+
+  static bool
+test_sqlstore_each( void )
+{
+  size_t cnt   = 0;
+  size_t forms = 0;
+
+  expect( sqlstore_each( & SQLSTORE, STORE_MOVE, count_each, & cnt ) ==
+          STORE_SUCCESS
+        );
+  expect( cnt == NUM_MOVES );
+
+  for ( uint16_t i = 0; i < NUM_POKEMON; i++ )
+    {
+      for ( pdex_mon_t * m = POKEDEX[i]; m != NULL; m = m->next_form ) forms++;
+    }
+  cnt = 0;
+  expect( sqlstore_each( & SQLSTORE, STORE_POKEDEX, count_each, & cnt ) ==
+          STORE_SUCCESS
+        );
+  expect( cnt == forms );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_sqlstore( void )
+{
+  bool rsl = true;
+  rsl &= do_test( sqlstore_write );
+  rsl &= do_test( sqlstore_get_pokemon );
+  rsl &= do_test( sqlstore_get_move );
+  rsl &= do_test( sqlstore_lru );
+  rsl &= do_test( sqlstore_each );
+  sqlstore_free( & SQLSTORE );
+  unlink( SQL_PATH );
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_sqlstore() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
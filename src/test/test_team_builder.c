@@ -0,0 +1,533 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include "matchup.h"
+#include "pokemon.h"
+#include "team_builder.h"
+#include "util/parallel.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/test_util.h"
+#define CSTORE_GLOBAL_STORE
+#include "cstore.h"
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Fill `rmons' with the first `n' Pokemon from the store that have moves,
+ * using their first fast and charged moves.
+ */
+  static bool
+make_roster( roster_pokemon_t * rmons, base_pokemon_t * bases, uint32_t n )
+{
+  uint16_t dex = 1;
+  for ( uint32_t i = 0; i < n; dex++ )
+    {
+      if ( dex == 0 ) return false;
+      if ( base_mon_from_store( & CSTORE, dex, 0, 20.0, 15, 15, 15,
+                                bases + i
+                              ) != STORE_SUCCESS
+         )
+        {
+          continue;
+        }
+      const pdex_mon_t * pdex = bases[i].pdex_mon;
+      if ( ( pdex->fast_moves_cnt == 0 ) || ( pdex->charged_moves_cnt == 0 ) )
+        {
+          continue;
+        }
+      rmons[i] = (roster_pokemon_t) {
+        .base             = bases + i,
+        .fast_move_id     = abs( pdex->fast_move_ids[0] ),
+        .charged_move_ids = {
+          abs( pdex->charged_move_ids[0] ),
+          ( 1 < pdex->charged_moves_cnt ) ? abs( pdex->charged_move_ids[1] )
+                                          : 0
+        }
+      };
+      i++;
+    }
+  return true;
+}
+
+
+  static bool
+make_mons( pvp_pokemon_t * mons, uint32_t n )
+{
+  roster_pokemon_t * rmons = (roster_pokemon_t *)
+                             malloc( sizeof( roster_pokemon_t ) * n );
+  base_pokemon_t   * bases = (base_pokemon_t *)
+                             malloc( sizeof( base_pokemon_t ) * n );
+  bool               rsl   = ( rmons != NULL ) && ( bases != NULL ) &&
+                             make_roster( rmons, bases, n ) &&
+                             ( pvp_pokemon_init_many( mons, rmons, n,
+                                                      & CSTORE
+                                                    ) == STORE_SUCCESS );
+  free( rmons );
+  free( bases );
+  return rsl;
+}
+
+
+  static bool
+same_mon( const pvp_pokemon_t * a, const pvp_pokemon_t * b )
+{
+  return ( a->stats.attack == b->stats.attack ) &&
+         ( a->stats.stamina == b->stats.stamina ) &&
+         ( a->stats.defense == b->stats.defense ) &&
+         ( a->fast_move.move_id == b->fast_move.move_id ) &&
+         ( a->charged_moves[0].move_id == b->charged_moves[0].move_id ) &&
+         ( a->charged_moves[1].move_id == b->charged_moves[1].move_id );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+struct count_job_s {
+  atomic_uint  * hits;
+  atomic_uint    calls;
+  uint32_t       nthreads;
+  atomic_bool    bad_thread;
+};
+
+  static void
+count_hits( void * vjob, uint32_t begin, uint32_t end, uint32_t thread )
+{
+  struct count_job_s * job = (struct count_job_s *) vjob;
+  if ( job->nthreads <= thread ) atomic_store( & job->bad_thread, true );
+  atomic_fetch_add( & job->calls, 1 );
+  for ( uint32_t i = begin; i < end; i++ ) atomic_fetch_add( job->hits + i, 1 );
+}
+
+
+  static bool
+test_parallel_for( void )
+{
+  const uint32_t     n    = 1000;
+  atomic_uint      * hits = (atomic_uint *) calloc( n, sizeof( atomic_uint ) );
+  struct count_job_s job  = { .hits = hits };
+
+  expect( hits != NULL );
+
+  /* Every item is visited exactly once, whatever the chunk size */
+  const uint32_t chunks[] = { 1, 7, 0, 5000 };
+  for ( uint8_t c = 0; c < array_size( chunks ); c++ )
+    {
+      for ( uint32_t i = 0; i < n; i++ ) atomic_store( hits + i, 0 );
+      atomic_store( & job.calls, 0 );
+      atomic_store( & job.bad_thread, false );
+      job.nthreads = parallel_threads( n, 4 );
+      expect( parallel_for( n, chunks[c], 4, count_hits, & job ) == 0 );
+      for ( uint32_t i = 0; i < n; i++ ) expect( atomic_load( hits + i ) == 1 );
+      expect( ! atomic_load( & job.bad_thread ) );
+      if ( chunks[c] != 0 )
+        {
+          expect( atomic_load( & job.calls ) ==
+                  ( n + chunks[c] - 1 ) / chunks[c]
+                );
+        }
+    }
+
+  /* Nothing to do, and more threads than items */
+  atomic_store( & job.calls, 0 );
+  expect( parallel_for( 0, 1, 4, count_hits, & job ) == 0 );
+  expect( atomic_load( & job.calls ) == 0 );
+  expect( parallel_threads( 2, 8 ) == 2 );
+  expect( parallel_threads( 0, 8 ) == 1 );
+  expect( 1 <= parallel_threads( 100, 0 ) );
+
+  free( hits );
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static bool
+test_matchup_matrix( void )
+{
+  const uint32_t   nrows  = 6;
+  const uint32_t   ncols  = 4;
+  pvp_pokemon_t    mons[6];
+  matchup_matrix_t matrix = MATCHUP_MATRIX_INIT;
+  matchup_opts_t   opts   = MATCHUP_OPTS_DEFAULT;
+
+  expect( make_mons( mons, nrows ) );
+  pvp_pokemon_t before = mons[0];
+
+  opts.scenarios = MATCHUP_ALL_SCENARIOS_M;
+  opts.nthreads  = 3;
+  expect( matchup_matrix_build( & matrix, mons, nrows, mons, ncols, & opts )
+          == STORE_SUCCESS
+        );
+  expect( matrix.nrows == nrows );
+  expect( matrix.ncols == ncols );
+  expect( matrix.nscenarios == MATCHUP_NSCENARIOS );
+  expect( matchup_matrix_row_len( & matrix ) == MATCHUP_NSCENARIOS * ncols );
+
+  /* Threads fill the same ratings a single caller would */
+  for ( uint32_t r = 0; r < nrows; r++ )
+    {
+      for ( uint8_t s = 0; s < matrix.nscenarios; s++ )
+        {
+          for ( uint32_t c = 0; c < ncols; c++ )
+            {
+              uint16_t rating = matchup_matrix_get( & matrix, r, s, c );
+              expect( rating <= MATCHUP_RATING_MAX );
+              expect( rating == matchup_battle( mons + r, mons + c,
+                                                matrix.scenarios[s]
+                                              )
+                    );
+            }
+        }
+    }
+  expect( same_mon( & before, mons ) && ( before.hp == mons[0].hp ) );
+
+  /* Shields only ever help their owner */
+  for ( uint32_t r = 0; r < nrows; r++ )
+    {
+      for ( uint32_t c = 0; c < ncols; c++ )
+        {
+          expect( matchup_battle( mons + r, mons + c,
+                                  matchup_scenario( 0, 2 ) ) <=
+                  matchup_battle( mons + r, mons + c,
+                                  matchup_scenario( 2, 0 ) )
+                );
+        }
+    }
+
+  /* Swapping opponents only touches their columns */
+  const uint32_t swap[2]  = { 3, 1 };
+  pvp_pokemon_t  with[2]  = { mons[5], mons[4] };
+  uint16_t       kept     = matchup_matrix_get( & matrix, 2, 4, 0 );
+  expect( matchup_matrix_update_cols( & matrix, mons, swap, with, 2, 2, NULL )
+          == STORE_SUCCESS
+        );
+  expect( matchup_matrix_get( & matrix, 2, 4, 0 ) == kept );
+  for ( uint32_t r = 0; r < nrows; r++ )
+    {
+      for ( uint8_t s = 0; s < matrix.nscenarios; s++ )
+        {
+          expect( matchup_matrix_get( & matrix, r, s, 3 ) ==
+                  matchup_battle( mons + r, mons + 5, matrix.scenarios[s] )
+                );
+          expect( matchup_matrix_get( & matrix, r, s, 1 ) ==
+                  matchup_battle( mons + r, mons + 4, matrix.scenarios[s] )
+                );
+        }
+    }
+  const uint32_t bad = ncols;
+  expect( matchup_matrix_update_cols( & matrix, mons, & bad, with, 1, 1, NULL )
+          == STORE_ERROR_BAD_VALUE
+        );
+
+  matchup_matrix_free( & matrix );
+  expect( matrix.ratings == NULL );
+
+  /* Only the asked for scenarios are built */
+  opts.scenarios = matchup_scenario_mask( matchup_scenario( 1, 1 ) );
+  expect( matchup_matrix_build( & matrix, mons, nrows, mons, ncols, & opts )
+          == STORE_SUCCESS
+        );
+  expect( matrix.nscenarios == 1 );
+  expect( matchup_matrix_scenario_idx( & matrix, matchup_scenario( 1, 1 ) )
+          == 0
+        );
+  expect( matchup_matrix_scenario_idx( & matrix, matchup_scenario( 0, 0 ) )
+          == -1
+        );
+  matchup_matrix_free( & matrix );
+
+  opts.scenarios = 0;
+  expect( matchup_matrix_build( & matrix, mons, nrows, mons, ncols, & opts )
+          == STORE_ERROR_BAD_VALUE
+        );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Every team's unweighted sum of best answers, the best `k' kept in order. */
+  static uint32_t
+brute_force( const matchup_matrix_t * matrix,
+             uint32_t                 k,
+             uint32_t                 best[][3],
+             uint64_t               * scores
+           )
+{
+  const size_t nc    = matchup_matrix_row_len( matrix );
+  uint32_t     found = 0;
+  for ( uint32_t a = 0; a < matrix->nrows; a++ )
+    for ( uint32_t b = a + 1; b < matrix->nrows; b++ )
+      for ( uint32_t c = b + 1; c < matrix->nrows; c++ )
+        {
+          const uint16_t * ra = matrix->ratings + a * nc;
+          const uint16_t * rb = matrix->ratings + b * nc;
+          const uint16_t * rc = matrix->ratings + c * nc;
+          uint64_t         sc = 0;
+          for ( size_t i = 0; i < nc; i++ )
+            {
+              sc += max( max( ra[i], rb[i] ), rc[i] );
+            }
+          /* Rows are visited in order, so ties keep the earlier team */
+          uint32_t pos = found;
+          while ( ( 0 < pos ) && ( scores[pos - 1] < sc ) ) pos--;
+          if ( k <= pos ) continue;
+          if ( found < k ) found++;
+          for ( uint32_t i = found - 1; pos < i; i-- )
+            {
+              scores[i] = scores[i - 1];
+              memcpy( best[i], best[i - 1], sizeof( best[i] ) );
+            }
+          scores[pos]  = sc;
+          best[pos][0] = a;
+          best[pos][1] = b;
+          best[pos][2] = c;
+        }
+  return found;
+}
+
+
+  static bool
+same_members( const uint32_t a[3], const uint32_t b[3] )
+{
+  for ( uint8_t i = 0; i < 3; i++ )
+    {
+      if ( ( a[i] != b[0] ) && ( a[i] != b[1] ) && ( a[i] != b[2] ) )
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+
+  static bool
+test_team_builder_search( void )
+{
+  const uint32_t      nrows  = 14;
+  const uint32_t      ncols  = 8;
+  const uint32_t      k      = 6;
+  pvp_pokemon_t       mons[14];
+  matchup_matrix_t    matrix = MATCHUP_MATRIX_INIT;
+  matchup_opts_t      mopts  = MATCHUP_OPTS_DEFAULT;
+  team_builder_opts_t opts   = TEAM_BUILDER_OPTS_DEFAULT;
+  team_pick_t         picks[6];
+  team_pick_t         picks1[6];
+  uint32_t            best[6][3];
+  uint64_t            scores[6];
+  uint32_t            npicks = 0;
+
+  expect( make_mons( mons, nrows ) );
+  expect( matchup_matrix_build( & matrix, mons, nrows, mons + nrows - ncols,
+                                ncols, & mopts
+                              ) == STORE_SUCCESS
+        );
+
+  /* Matches an exhaustive search, in order */
+  opts.k        = k;
+  opts.nthreads = 4;
+  expect( team_builder_search( & matrix, & opts, picks, & npicks )
+          == STORE_SUCCESS
+        );
+  expect( npicks == k );
+  expect( brute_force( & matrix, k, best, scores ) == k );
+  for ( uint32_t i = 0; i < k; i++ )
+    {
+      expect( same_members( picks[i].members, best[i] ) );
+      float expected = (float) scores[i] / matchup_matrix_row_len( & matrix );
+      expect( ( picks[i].score - expected ) < 0.01 );
+      expect( ( expected - picks[i].score ) < 0.01 );
+      if ( 0 < i ) expect( picks[i].score <= picks[i - 1].score );
+      for ( uint8_t r = 0; r < 3; r++ )
+        {
+          expect( picks[i].role_scores[r] <= MATCHUP_RATING_MAX );
+        }
+    }
+
+  /* The thread count changes nothing */
+  opts.nthreads = 1;
+  expect( team_builder_search( & matrix, & opts, picks1, & npicks )
+          == STORE_SUCCESS
+        );
+  expect( npicks == k );
+  expect( memcmp( picks, picks1, sizeof( team_pick_t ) * k ) == 0 );
+
+  /* Asking for more teams than exist returns all of them */
+  team_pick_t all[6];
+  matchup_matrix_t small = matrix;
+  small.nrows = 4;
+  opts.k      = 6;
+  expect( team_builder_search( & small, & opts, all, & npicks )
+          == STORE_SUCCESS
+        );
+  expect( npicks == 4 );
+
+  /* A meta of one Pokemon, only its best answer matters */
+  const float weights[8] = { 0, 0, 0, 1, 0, 0, 0, 0 };
+  uint16_t    answer     = 0;
+  opts.k       = 1;
+  opts.weights = weights;
+  for ( uint32_t r = 0; r < nrows; r++ )
+    {
+      uint32_t sum = 0;
+      for ( uint8_t s = 0; s < matrix.nscenarios; s++ )
+        {
+          sum += matchup_matrix_get( & matrix, r, s, 3 );
+        }
+      answer = max( answer, sum );
+    }
+  expect( team_builder_search( & matrix, & opts, picks, & npicks )
+          == STORE_SUCCESS
+        );
+  expect( npicks == 1 );
+  expect( ( (float) answer / matrix.nscenarios - picks[0].score ) < 0.01 );
+
+  /* Too small a roster */
+  small.nrows = 2;
+  expect( team_builder_search( & small, & opts, picks, & npicks )
+          == STORE_ERROR_BAD_VALUE
+        );
+  expect( npicks == 0 );
+
+  matchup_matrix_free( & matrix );
+  return true;
+}
+
+
+  static bool
+test_team_builder_roles( void )
+{
+  /* Hand made ratings in 0v0, 1v1, and 2v2 against two meta Pokemon */
+  uint16_t ratings[3 * 3 * 2] = {
+    /*        0v0         1v1         2v2    */
+    /* 0 */   100, 100,   900, 100,   900, 300,
+    /* 1 */   900, 900,   100, 100,   100, 100,
+    /* 2 */   100, 100,   100, 900,   100, 100
+  };
+  matchup_matrix_t matrix = {
+    .nrows      = 3,
+    .ncols      = 2,
+    .nscenarios = 3,
+    .scenarios  = { matchup_scenario( 0, 0 ),
+                    matchup_scenario( 1, 1 ),
+                    matchup_scenario( 2, 2 )
+                  },
+    .ratings    = ratings
+  };
+  const uint32_t members[3] = { 2, 1, 0 };
+  team_pick_t    pick;
+
+  /* 0 leads in 2v2, 2 covers its loss in 1v1, and 1 closes in 0v0 */
+  team_builder_assign_roles( & matrix, NULL, members, & pick );
+  expect( pick.members[TEAM_LEAD] == 0 );
+  expect( pick.members[TEAM_SWAP] == 2 );
+  expect( pick.members[TEAM_CLOSER] == 1 );
+  expect( pick.role_scores[TEAM_LEAD] == 600.0 );
+  expect( pick.role_scores[TEAM_SWAP] == 900.0 );
+  expect( pick.role_scores[TEAM_CLOSER] == 900.0 );
+
+  return true;
+}
+
+
+  static bool
+test_team_builder_select_team( void )
+{
+  const uint32_t   nours   = 6;
+  const uint32_t   ntheirs = 4;
+  roster_pokemon_t rmons[10];
+  base_pokemon_t   bases[10];
+  pvp_pokemon_t    mons[10];
+  pvp_pokemon_t    team[3];
+  roster_t         ours    = {
+    .roster_pokemon = rmons, .roster_length = nours
+  };
+  roster_t         theirs  = {
+    .roster_pokemon = rmons + nours, .roster_length = ntheirs
+  };
+  team_builder_opts_t opts = TEAM_BUILDER_OPTS_DEFAULT;
+
+  expect( make_roster( rmons, bases, nours + ntheirs ) );
+  expect( pvp_pokemon_init_many( mons, rmons, nours + ntheirs, & CSTORE )
+          == STORE_SUCCESS
+        );
+
+  opts.nthreads = 2;
+  expect( team_builder_select_team( & ours, & theirs, team, & CSTORE,
+                                    & opts
+                                  ) == AI_SUCCESS
+        );
+  /* Three different members of our roster */
+  uint8_t from[3] = { 0xff, 0xff, 0xff };
+  for ( uint8_t t = 0; t < 3; t++ )
+    {
+      for ( uint8_t m = 0; m < nours; m++ )
+        {
+          if ( same_mon( team + t, mons + m ) )
+            {
+              from[t] = m;
+            }
+        }
+      expect( from[t] != 0xff );
+    }
+  expect( ( from[0] != from[1] ) && ( from[1] != from[2] ) &&
+          ( from[0] != from[2] )
+        );
+
+  /* Without an opponent the first 3 are taken */
+  theirs.roster_length = 0;
+  expect( team_builder_select_team( & ours, & theirs, team, & CSTORE, NULL )
+          == AI_SUCCESS
+        );
+  for ( uint8_t t = 0; t < 3; t++ ) expect( same_mon( team + t, mons + t ) );
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+test_team_builder( void )
+{
+  bool rsl = true;
+
+  rsl &= CS_init() == STORE_SUCCESS;
+  rsl &= do_test( parallel_for );
+  rsl &= do_test( matchup_matrix );
+  rsl &= do_test( team_builder_search );
+  rsl &= do_test( team_builder_roles );
+  rsl &= do_test( team_builder_select_team );
+  CS_free();
+
+  return rsl;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef MK_TEST_BINARY
+int
+main( int argc, char * argv[], char ** envp )
+{
+  return test_team_builder() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,132 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/arena.h"
+
+/* -------------------------------------------------------------------------- */
+
+#define ARENA_ALIGN  ( _Alignof( max_align_t ) )
+
+  static inline size_t
+arena_round( size_t size )
+{
+  return ( size + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  void
+arena_init( arena_t * arena )
+{
+  assert( arena != NULL );
+  arena->blocks = NULL;
+  arena->last   = 0;
+  arena->bytes  = 0;
+}
+
+
+  void
+arena_free( arena_t * arena )
+{
+  assert( arena != NULL );
+  arena_block_t * block = arena->blocks;
+  while ( block != NULL )
+    {
+      arena_block_t * next = block->next;
+      free( block );
+      block = next;
+    }
+  arena_init( arena );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  void *
+arena_alloc( arena_t * arena, size_t size )
+{
+  assert( arena != NULL );
+
+  size = arena_round( ( size == 0 ) ? 1 : size );
+  if ( size < ARENA_ALIGN ) return NULL;  /* Rounding overflowed */
+
+  arena_block_t * block = arena->blocks;
+#ifdef ARENA_USE_MALLOC
+  /* Every allocation is a block of its own */
+  block = NULL;
+#endif
+  if ( ( block == NULL ) || ( block->cap - block->used < size ) )
+    {
+#ifdef ARENA_USE_MALLOC
+      size_t cap = size;
+#else
+      size_t cap = ( size < ARENA_BLOCK_SIZE ) ? ARENA_BLOCK_SIZE : size;
+#endif
+      if ( SIZE_MAX - sizeof( arena_block_t ) < cap ) return NULL;
+      block = (arena_block_t *) malloc( sizeof( arena_block_t ) + cap );
+      if ( block == NULL ) return NULL;
+      block->next   = arena->blocks;
+      block->used   = 0;
+      block->cap    = cap;
+      arena->blocks = block;
+    }
+
+  arena->last  = block->used;
+  block->used += size;
+  arena->bytes += size;
+
+  return (char *) block->data + arena->last;
+}
+
+
+  void *
+arena_calloc( arena_t * arena, size_t size )
+{
+  void * ptr = arena_alloc( arena, size );
+  if ( ptr != NULL ) memset( ptr, 0, size );
+  return ptr;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  bool
+arena_pop( arena_t * arena, void * ptr )
+{
+  assert( arena != NULL );
+  arena_block_t * block = arena->blocks;
+  if ( ( block == NULL ) || ( ptr != (char *) block->data + arena->last ) ||
+       ( block->used == arena->last ) )
+    {
+      return false;
+    }
+
+  arena->bytes -= block->used - arena->last;
+#ifdef ARENA_USE_MALLOC
+  arena->blocks = block->next;
+  free( block );
+  /* Blocks hold exactly one allocation, so pops may continue down the list */
+  arena->last = 0;
+#else
+  block->used = arena->last;
+#endif
+
+  return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
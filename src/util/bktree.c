@@ -0,0 +1,232 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/bktree.h"
+#include "util/fuzzy.h"
+
+/* -------------------------------------------------------------------------- */
+
+/* Pending nodes fit here for all but very large trees */
+#define BKTREE_STACK_LEN  256
+
+
+/* -------------------------------------------------------------------------- */
+
+  void
+bktree_init( bktree_t * tree )
+{
+  assert( tree != NULL );
+  tree->nodes = NULL;
+  tree->cnt   = 0;
+  tree->cap   = 0;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  void
+bktree_free( bktree_t * tree )
+{
+  assert( tree != NULL );
+  for ( uint32_t i = 0; i < tree->cnt; i++ ) free( tree->nodes[i].key );
+  free( tree->nodes );
+  bktree_init( tree );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static int
+bktree_push_node( bktree_t * tree, const char * key, size_t len, void * data )
+{
+  if ( tree->cnt == tree->cap )
+    {
+      uint32_t        cap   = ( tree->cap == 0 ) ? 64 : tree->cap * 2;
+      bktree_node_t * nodes =
+        (bktree_node_t *) realloc( tree->nodes, sizeof( bktree_node_t ) * cap );
+      if ( nodes == NULL ) return -1;
+      tree->nodes = nodes;
+      tree->cap   = cap;
+    }
+
+  bktree_node_t * node = tree->nodes + tree->cnt;
+  node->key = (char *) malloc( len + 1 );
+  if ( node->key == NULL ) return -1;
+  memcpy( node->key, key, len + 1 );
+  node->data     = data;
+  node->child    = 0;
+  node->sibling  = 0;
+  node->len      = (uint8_t) len;
+  node->edge     = 0;
+  node->max_edge = 0;
+
+  return (int) tree->cnt++;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+bktree_insert( bktree_t * tree, const char * key, void * data )
+{
+  assert( tree != NULL );
+  assert( key != NULL );
+
+  size_t len = strlen( key );
+  if ( BKTREE_MAX_KEY_LEN < len ) return -1;
+
+  if ( tree->cnt == 0 )
+    {
+      return ( bktree_push_node( tree, key, len, data ) < 0 ) ? -1 : 0;
+    }
+
+  uint32_t curr = 0;
+  while ( true )
+    {
+      bktree_node_t * node = tree->nodes + curr;
+      int dist = levenshtein_bounded( key,
+                                      len,
+                                      node->key,
+                                      node->len,
+                                      BKTREE_MAX_KEY_LEN
+                                    );
+      if ( dist == 0 ) return 1;
+
+      uint32_t child = node->child;
+      uint32_t last  = 0;
+      while ( ( child != 0 ) && ( tree->nodes[child].edge != dist ) )
+        {
+          last  = child;
+          child = tree->nodes[child].sibling;
+        }
+
+      if ( child != 0 )
+        {
+          curr = child;
+          continue;
+        }
+
+      /* `nodes' may move, so only hold onto indices from here on */
+      int idx = bktree_push_node( tree, key, len, data );
+      if ( idx < 0 ) return -1;
+      tree->nodes[idx].edge = (uint8_t) dist;
+      if ( last == 0 ) tree->nodes[curr].child   = (uint32_t) idx;
+      else             tree->nodes[last].sibling = (uint32_t) idx;
+      if ( tree->nodes[curr].max_edge < dist )
+        {
+          tree->nodes[curr].max_edge = (uint8_t) dist;
+        }
+      return 0;
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Insert into `matches' keeping it sorted by distance, after any equal ones.
+ * When `matches' is full the worst match is dropped.
+ */
+  static void
+bktree_add_match( bktree_match_t       * matches,
+                  size_t               * nfound,
+                  size_t                 nmatches,
+                  const bktree_node_t  * node,
+                  int                    dist
+                )
+{
+  size_t pos = *nfound;
+  while ( ( 0 < pos ) && ( dist < matches[pos - 1].dist ) ) pos--;
+  if ( nmatches <= pos ) return;
+
+  size_t end = ( *nfound < nmatches ) ? ( *nfound )++ : nmatches - 1;
+  memmove( matches + pos + 1,
+           matches + pos,
+           sizeof( bktree_match_t ) * ( end - pos )
+         );
+  matches[pos].key  = node->key;
+  matches[pos].data = node->data;
+  matches[pos].dist = dist;
+}
+
+
+  size_t
+bktree_find( const bktree_t       * tree,
+             const char           * query,
+             int                    max_dist,
+             bktree_match_t       * matches,
+             size_t                 nmatches
+           )
+{
+  assert( tree != NULL );
+  assert( query != NULL );
+  assert( matches != NULL );
+
+  if ( ( tree->cnt == 0 ) || ( nmatches == 0 ) || ( max_dist < 0 ) ) return 0;
+
+  uint32_t   buf[BKTREE_STACK_LEN];
+  uint32_t * stack  = buf;
+  size_t     cap    = BKTREE_STACK_LEN;
+  size_t     top    = 0;
+  size_t     nfound = 0;
+  size_t     qlen   = strlen( query );
+  int        r      = max_dist;
+
+  /* The query is scored against every node visited, so prepare it once */
+  lev_pattern_t pat;
+  bool          use_pat = lev_pattern_init( & pat, query, qlen );
+
+  stack[top++] = 0;
+  while ( 0 < top )
+    {
+      const bktree_node_t * node = tree->nodes + stack[--top];
+
+      /* No child can be in range unless `dist <= r + max_edge' */
+      int bound = r + node->max_edge;
+      int dist  = use_pat
+                  ? lev_pattern_dist( & pat, node->key, node->len, bound )
+                  : levenshtein_dp( query, qlen, node->key, node->len, bound );
+      if ( dist <= r )
+        {
+          bktree_add_match( matches, & nfound, nmatches, node, dist );
+          if ( nfound == nmatches ) r = matches[nmatches - 1].dist;
+        }
+      if ( r + node->max_edge < dist ) continue;
+
+      for ( uint32_t c = node->child; c != 0; c = tree->nodes[c].sibling )
+        {
+          int edge = tree->nodes[c].edge;
+          if ( ( edge < dist - r ) || ( dist + r < edge ) ) continue;
+          if ( top == cap )
+            {
+              uint32_t * grown = (uint32_t *)
+                malloc( sizeof( uint32_t ) * cap * 2 );
+              if ( grown == NULL ) goto done;
+              memcpy( grown, stack, sizeof( uint32_t ) * top );
+              if ( stack != buf ) free( stack );
+              stack  = grown;
+              cap   *= 2;
+            }
+          stack[top++] = c;
+        }
+    }
+
+done:
+  if ( stack != buf ) free( stack );
+  return nfound;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
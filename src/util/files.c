@@ -7,8 +7,11 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
+#include "store.h"
 #include "util/files.h"
 
 /* -------------------------------------------------------------------------- */
@@ -85,6 +88,43 @@ fread_malloc( const char * fpath, char ** buffer )
 }
 
 
+/* -------------------------------------------------------------------------- */
+
+  int
+fwrite_atomic( const char * fpath, fwrite_cb_t writer, const void * ctx )
+{
+  assert( fpath != NULL );
+  assert( writer != NULL );
+
+  size_t len  = strlen( fpath );
+  char * tmp  = (char *) malloc( len + sizeof( ".tmp" ) );
+  if ( tmp == NULL ) return STORE_ERROR_NOMEM;
+  memcpy( tmp, fpath, len );
+  memcpy( tmp + len, ".tmp", sizeof( ".tmp" ) );
+
+  FILE * ostream = fopen( tmp, "wb" );
+  if ( ostream == NULL )
+    {
+      perror( __func__ );
+      free( tmp );
+      return STORE_ERROR_FAIL;
+    }
+  int rsl = writer( ostream, ctx );
+  if ( ( fclose( ostream ) != 0 ) && ( rsl == STORE_SUCCESS ) )
+    {
+      rsl = STORE_ERROR_FAIL;
+    }
+  if ( ( rsl == STORE_SUCCESS ) && ( rename( tmp, fpath ) != 0 ) )
+    {
+      perror( __func__ );
+      rsl = STORE_ERROR_FAIL;
+    }
+  if ( rsl != STORE_SUCCESS ) unlink( tmp );
+  free( tmp );
+  return rsl;
+}
+
+
 /* -------------------------------------------------------------------------- */
 
 
@@ -0,0 +1,147 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "util/parallel.h"
+
+/* -------------------------------------------------------------------------- */
+
+/* Chunks handed to each thread when the caller doesn't pick a size */
+#define PARALLEL_CHUNKS_PER_THREAD  8
+
+
+struct parallel_job_s {
+  parallel_fn        fn;
+  void             * ctx;
+  uint32_t           n;
+  uint32_t           chunk;
+  atomic_uint_fast32_t next;
+};
+typedef struct parallel_job_s  parallel_job_t;
+
+struct parallel_worker_s {
+  parallel_job_t * job;
+  uint32_t         thread;
+};
+typedef struct parallel_worker_s  parallel_worker_t;
+
+
+/* -------------------------------------------------------------------------- */
+
+  uint32_t
+parallel_default_threads( void )
+{
+  long ncpu = sysconf( _SC_NPROCESSORS_ONLN );
+  return ( ncpu < 1 ) ? 1 : (uint32_t) ncpu;
+}
+
+
+  uint32_t
+parallel_threads( uint32_t n, uint32_t nthreads )
+{
+  if ( nthreads == 0 ) nthreads = parallel_default_threads();
+  if ( n < nthreads )  nthreads = n;
+  return ( nthreads == 0 ) ? 1 : nthreads;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  static void *
+parallel_work( void * vworker )
+{
+  parallel_worker_t * worker = (parallel_worker_t *) vworker;
+  parallel_job_t    * job    = worker->job;
+  while ( true )
+    {
+      uint_fast32_t begin = atomic_fetch_add( & job->next, job->chunk );
+      if ( job->n <= begin ) break;
+      uint32_t end = ( job->n - begin < job->chunk ) ? job->n
+                                                     : begin + job->chunk;
+      job->fn( job->ctx, (uint32_t) begin, end, worker->thread );
+    }
+  return NULL;
+}
+
+
+  int
+parallel_for( uint32_t      n,
+              uint32_t      chunk,
+              uint32_t      nthreads,
+              parallel_fn   fn,
+              void        * ctx
+            )
+{
+  assert( fn != NULL );
+  if ( n == 0 ) return 0;
+
+  nthreads = parallel_threads( n, nthreads );
+  if ( chunk == 0 )
+    {
+      chunk = n / ( nthreads * PARALLEL_CHUNKS_PER_THREAD );
+      if ( chunk == 0 ) chunk = 1;
+    }
+
+  parallel_job_t job = { .fn = fn, .ctx = ctx, .n = n, .chunk = chunk };
+  atomic_init( & job.next, 0 );
+
+  if ( nthreads == 1 )
+    {
+      parallel_worker_t self = { .job = & job, .thread = 0 };
+      parallel_work( & self );
+      return 0;
+    }
+
+  pthread_t         * threads =
+    (pthread_t *) malloc( sizeof( pthread_t ) * nthreads );
+  parallel_worker_t * workers =
+    (parallel_worker_t *) malloc( sizeof( parallel_worker_t ) * nthreads );
+  bool              * started = (bool *) calloc( nthreads, sizeof( bool ) );
+  if ( ( threads == NULL ) || ( workers == NULL ) || ( started == NULL ) )
+    {
+      free( threads );
+      free( workers );
+      free( started );
+      return -1;
+    }
+
+  for ( uint32_t t = 0; t < nthreads; t++ )
+    {
+      workers[t] = (parallel_worker_t) { .job = & job, .thread = t };
+    }
+  for ( uint32_t t = 1; t < nthreads; t++ )
+    {
+      started[t] = pthread_create( threads + t,
+                                   NULL,
+                                   parallel_work,
+                                   workers + t
+                                 ) == 0;
+    }
+  parallel_work( workers );
+  for ( uint32_t t = 1; t < nthreads; t++ )
+    {
+      if ( started[t] ) pthread_join( threads[t], NULL );
+    }
+
+  free( threads );
+  free( workers );
+  free( started );
+
+  return 0;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
@@ -0,0 +1,155 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/strmap.h"
+
+/* -------------------------------------------------------------------------- */
+
+/* Tables are kept at most half full, probes stay short */
+#define STRMAP_MIN_CAP  64
+
+
+/* -------------------------------------------------------------------------- */
+
+  uint32_t
+strmap_hash( const char * key, size_t len )
+{
+  uint32_t hash = 2166136261u;
+  for ( size_t i = 0; i < len; i++ )
+    {
+      hash ^= (uint8_t) key[i];
+      hash *= 16777619u;
+    }
+  return hash;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  void
+strmap_init( strmap_t * map )
+{
+  assert( map != NULL );
+  map->slots = NULL;
+  map->cap   = 0;
+  map->cnt   = 0;
+}
+
+
+  void
+strmap_free( strmap_t * map )
+{
+  assert( map != NULL );
+  free( map->slots );
+  strmap_init( map );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Index of the slot holding `key', or the empty slot it would go in. */
+  static uint32_t
+strmap_probe( const strmap_t * map,
+              const char     * key,
+              size_t           len,
+              uint32_t         hash
+            )
+{
+  uint32_t mask = map->cap - 1;
+  uint32_t i    = hash & mask;
+  while ( map->slots[i].key != NULL )
+    {
+      const strmap_slot_t * slot = map->slots + i;
+      if ( ( slot->hash == hash ) && ( slot->len == len ) &&
+           ( memcmp( slot->key, key, len ) == 0 ) )
+        {
+          break;
+        }
+      i = ( i + 1 ) & mask;
+    }
+  return i;
+}
+
+
+  int
+strmap_reserve( strmap_t * map, uint32_t cnt )
+{
+  assert( map != NULL );
+
+  uint32_t cap = ( map->cap == 0 ) ? STRMAP_MIN_CAP : map->cap;
+  while ( cap / 2 < cnt ) cap *= 2;
+  if ( cap == map->cap ) return 0;
+
+  strmap_slot_t * old     = map->slots;
+  uint32_t        old_cap = map->cap;
+  map->slots = (strmap_slot_t *) calloc( cap, sizeof( strmap_slot_t ) );
+  if ( map->slots == NULL )
+    {
+      map->slots = old;
+      return -1;
+    }
+  map->cap = cap;
+
+  for ( uint32_t i = 0; i < old_cap; i++ )
+    {
+      if ( old[i].key == NULL ) continue;
+      map->slots[strmap_probe( map, old[i].key, old[i].len, old[i].hash )] =
+        old[i];
+    }
+  free( old );
+
+  return 0;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+  int
+strmap_putn( strmap_t * map, const char * key, size_t len, void * val )
+{
+  assert( map != NULL );
+  assert( key != NULL );
+
+  if ( UINT32_MAX <= len ) return -1;
+  if ( strmap_reserve( map, map->cnt + 1 ) != 0 ) return -1;
+
+  uint32_t        hash = strmap_hash( key, len );
+  strmap_slot_t * slot = map->slots + strmap_probe( map, key, len, hash );
+  if ( slot->key != NULL ) return 1;
+
+  slot->key  = key;
+  slot->val  = val;
+  slot->hash = hash;
+  slot->len  = (uint32_t) len;
+  map->cnt++;
+
+  return 0;
+}
+
+
+  void *
+strmap_getn( const strmap_t * map, const char * key, size_t len )
+{
+  assert( map != NULL );
+  assert( key != NULL );
+
+  if ( map->cnt == 0 ) return NULL;
+  const strmap_slot_t * slot =
+    map->slots + strmap_probe( map, key, len, strmap_hash( key, len ) );
+  return ( slot->key == NULL ) ? NULL : slot->val;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */
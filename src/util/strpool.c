@@ -0,0 +1,102 @@
+/* -*- mode: c; -*- */
+
+/* ========================================================================== */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/strmap.h"
+#include "util/strpool.h"
+
+/* -------------------------------------------------------------------------- */
+
+  void
+strpool_init( strpool_t * pool )
+{
+  assert( pool != NULL );
+  pool->blocks = NULL;
+  pool->bytes  = 0;
+  strmap_init( & pool->strs );
+}
+
+
+  void
+strpool_free( strpool_t * pool )
+{
+  assert( pool != NULL );
+  strpool_block_t * block = pool->blocks;
+  while ( block != NULL )
+    {
+      strpool_block_t * next = block->next;
+      free( block );
+      block = next;
+    }
+  strmap_free( & pool->strs );
+  strpool_init( pool );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+/* Room for `size' bytes, starting a new block if the current one is full. */
+  static char *
+strpool_alloc( strpool_t * pool, size_t size )
+{
+  strpool_block_t * block = pool->blocks;
+  if ( ( block == NULL ) || ( block->cap - block->used < size ) )
+    {
+      size_t cap = ( size < STRPOOL_BLOCK_SIZE ) ? STRPOOL_BLOCK_SIZE : size;
+      block = (strpool_block_t *) malloc( sizeof( strpool_block_t ) + cap );
+      if ( block == NULL ) return NULL;
+      block->used = 0;
+      block->cap  = cap;
+      /* An oversized string shouldn't strand the current block's free space */
+      if ( ( cap == size ) && ( pool->blocks != NULL ) )
+        {
+          block->next        = pool->blocks->next;
+          pool->blocks->next = block;
+        }
+      else
+        {
+          block->next  = pool->blocks;
+          pool->blocks = block;
+        }
+    }
+
+  char * str = block->data + block->used;
+  block->used += size;
+  return str;
+}
+
+
+  char *
+strpool_internn( strpool_t * pool, const char * str, size_t len )
+{
+  assert( pool != NULL );
+  assert( ( str != NULL ) || ( len == 0 ) );
+
+  char * pooled = strpool_findn( pool, ( str == NULL ) ? "" : str, len );
+  if ( pooled != NULL ) return pooled;
+
+  pooled = strpool_alloc( pool, len + 1 );
+  if ( pooled == NULL ) return NULL;
+  if ( 0 < len ) memcpy( pooled, str, len );
+  pooled[len] = '\0';
+
+  /* A failed insert just leaves a few unreachable bytes in the block */
+  if ( strmap_putn( & pool->strs, pooled, len, pooled ) != 0 ) return NULL;
+  pool->bytes += len + 1;
+
+  return pooled;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+
+/* ========================================================================== */
+
+/* vim: set filetype=c : */